@@ -32,8 +32,12 @@ GTEST_DEX_DIRECTORIES := \
   MyClassNatives \
   Nested \
   NonStaticLeafMethods \
+  ProfiledDispatch \
   ProtoCompare \
   ProtoCompare2 \
+  ReuseA \
+  ReuseA2 \
+  ReuseB \
   StaticLeafMethods \
   Statics \
   StaticsFromCode \
@@ -47,7 +51,7 @@ $(foreach dir,$(GTEST_DEX_DIRECTORIES), $(eval $(call build-art-test-dex,art-gte
 
 # Dex file dependencies for each gtest.
 ART_GTEST_class_linker_test_DEX_DEPS := Interfaces MyClass Nested Statics StaticsFromCode
-ART_GTEST_compiler_driver_test_DEX_DEPS := AbstractMethod
+ART_GTEST_compiler_driver_test_DEX_DEPS := AbstractMethod ProfiledDispatch
 ART_GTEST_dex_file_test_DEX_DEPS := GetMethodSignature
 ART_GTEST_exception_test_DEX_DEPS := ExceptionHandle
 ART_GTEST_jni_compiler_test_DEX_DEPS := MyClassNatives
@@ -55,6 +59,7 @@ ART_GTEST_jni_internal_test_DEX_DEPS := AllFields StaticLeafMethods
 ART_GTEST_object_test_DEX_DEPS := ProtoCompare ProtoCompare2 StaticsFromCode XandY
 ART_GTEST_proxy_test_DEX_DEPS := Interfaces
 ART_GTEST_reflection_test_DEX_DEPS := Main NonStaticLeafMethods StaticLeafMethods
+ART_GTEST_reusable_oat_file_test_DEX_DEPS := ReuseA ReuseA2 ReuseB
 ART_GTEST_stub_test_DEX_DEPS := AllFields
 ART_GTEST_transaction_test_DEX_DEPS := Transaction
 
@@ -95,13 +100,17 @@ RUNTIME_GTEST_COMMON_SRC_FILES := \
   runtime/exception_test.cc \
   runtime/gc/accounting/card_table_test.cc \
   runtime/gc/accounting/space_bitmap_test.cc \
+  runtime/gc/collector/concurrent_copying_test.cc \
+  runtime/gc/collector/semi_space_test.cc \
   runtime/gc/heap_test.cc \
+  runtime/gc/space/bump_pointer_space_test.cc \
   runtime/gc/space/dlmalloc_space_base_test.cc \
   runtime/gc/space/dlmalloc_space_static_test.cc \
   runtime/gc/space/dlmalloc_space_random_test.cc \
   runtime/gc/space/rosalloc_space_base_test.cc \
   runtime/gc/space/rosalloc_space_static_test.cc \
   runtime/gc/space/rosalloc_space_random_test.cc \
+  runtime/gc/space/rosalloc_space_threads_test.cc \
   runtime/gc/space/large_object_space_test.cc \
   runtime/gtest_test.cc \
   runtime/handle_scope_test.cc \
@@ -116,6 +125,7 @@ RUNTIME_GTEST_COMMON_SRC_FILES := \
   runtime/monitor_pool_test.cc \
   runtime/monitor_test.cc \
   runtime/parsed_options_test.cc \
+  runtime/profiler_test.cc \
   runtime/reference_table_test.cc \
   runtime/thread_pool_test.cc \
   runtime/transaction_test.cc \
@@ -129,11 +139,13 @@ COMPILER_GTEST_COMMON_SRC_FILES := \
   runtime/proxy_test.cc \
   runtime/reflection_test.cc \
   compiler/dex/global_value_numbering_test.cc \
+  compiler/dex/quick/dex_file_method_inliner_test.cc \
   compiler/dex/local_value_numbering_test.cc \
   compiler/dex/mir_graph_test.cc \
   compiler/dex/mir_optimization_test.cc \
   compiler/dex/reference_map_calculator_test.cc \
   compiler/driver/compiler_driver_test.cc \
+  compiler/driver/reusable_oat_file_test.cc \
   compiler/elf_writer_test.cc \
   compiler/image_test.cc \
   compiler/jni/jni_compiler_test.cc \
@@ -142,6 +154,8 @@ COMPILER_GTEST_COMMON_SRC_FILES := \
   compiler/optimizing/dominator_test.cc \
   compiler/optimizing/find_loops_test.cc \
   compiler/optimizing/graph_test.cc \
+  compiler/optimizing/gvn_test.cc \
+  compiler/optimizing/licm_test.cc \
   compiler/optimizing/linearize_test.cc \
   compiler/optimizing/liveness_test.cc \
   compiler/optimizing/live_interval_test.cc \
@@ -149,6 +163,7 @@ COMPILER_GTEST_COMMON_SRC_FILES := \
   compiler/optimizing/parallel_move_test.cc \
   compiler/optimizing/pretty_printer_test.cc \
   compiler/optimizing/register_allocator_test.cc \
+  compiler/optimizing/scalar_replacement_test.cc \
   compiler/optimizing/ssa_test.cc \
   compiler/optimizing/stack_map_test.cc \
   compiler/output_stream_test.cc \
@@ -501,6 +516,7 @@ ART_GTEST_jni_internal_test_DEX_DEPS :=
 ART_GTEST_object_test_DEX_DEPS :=
 ART_GTEST_proxy_test_DEX_DEPS :=
 ART_GTEST_reflection_test_DEX_DEPS :=
+ART_GTEST_reusable_oat_file_test_DEX_DEPS :=
 ART_GTEST_stub_test_DEX_DEPS :=
 ART_GTEST_transaction_test_DEX_DEPS :=
 $(foreach dir,$(GTEST_DEX_DIRECTORIES), $(eval ART_TEST_TARGET_GTEST_$(dir)_DEX :=))
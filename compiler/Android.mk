@@ -61,6 +61,9 @@ LIBART_COMPILER_SRC_FILES := \
 	dex/mir_dataflow.cc \
 	dex/mir_field_info.cc \
 	dex/mir_method_info.cc \
+	dex/loop_vectorization.cc \
+	dex/bounds_check_elimination.cc \
+	dex/loop_unrolling.cc \
 	dex/mir_optimization.cc \
 	dex/bb_optimizations.cc \
 	dex/compiler_ir.cc \
@@ -77,8 +80,12 @@ LIBART_COMPILER_SRC_FILES := \
 	dex/ssa_transformation.cc \
 	dex/quick_compiler_callbacks.cc \
 	dex/selectivity.cc \
+	driver/compile_cache.cc \
+	driver/compile_stats.cc \
+	driver/compile_time_budget.cc \
 	driver/compiler_driver.cc \
 	driver/dex_compilation_unit.cc \
+	driver/reusable_oat_file.cc \
 	jni/quick/arm/calling_convention_arm.cc \
 	jni/quick/arm64/calling_convention_arm64.cc \
 	jni/quick/mips/calling_convention_mips.cc \
@@ -93,11 +100,15 @@ LIBART_COMPILER_SRC_FILES := \
 	optimizing/code_generator_x86.cc \
 	optimizing/code_generator_x86_64.cc \
 	optimizing/graph_visualizer.cc \
+	optimizing/gvn.cc \
+	optimizing/licm.cc \
 	optimizing/locations.cc \
 	optimizing/nodes.cc \
 	optimizing/optimizing_compiler.cc \
 	optimizing/parallel_move_resolver.cc \
 	optimizing/register_allocator.cc \
+	optimizing/scalar_replacement.cc \
+	optimizing/side_effects_analysis.cc \
 	optimizing/ssa_builder.cc \
 	optimizing/ssa_liveness_analysis.cc \
 	optimizing/ssa_phi_elimination.cc \
@@ -136,6 +136,89 @@ class CodeLayout : public PassME {
   bool Worker(PassDataHolder* data) const;
 };
 
+/**
+ * @class LoopVectorization
+ * @brief Vectorize simple counted loops over arrays, keeping the scalar loop for the remainder.
+ */
+class LoopVectorization : public PassME {
+ public:
+  LoopVectorization()
+    : PassME("LoopVectorization", kNoNodes, kOptimizationBasicBlockChange,
+             "2_post_vectorization_cfg") {
+  }
+
+  bool Gate(const PassDataHolder* data) const {
+    DCHECK(data != nullptr);
+    CompilationUnit* c_unit = down_cast<const PassMEDataHolder*>(data)->c_unit;
+    DCHECK(c_unit != nullptr);
+    return c_unit->mir_graph->VectorizeLoopsGate();
+  }
+
+  void Start(PassDataHolder* data) const {
+    DCHECK(data != nullptr);
+    PassMEDataHolder* pass_me_data_holder = down_cast<PassMEDataHolder*>(data);
+    CompilationUnit* c_unit = pass_me_data_holder->c_unit;
+    DCHECK(c_unit != nullptr);
+    // The CFG only needs to be rebuilt if a loop was vectorized.
+    pass_me_data_holder->dirty = c_unit->mir_graph->VectorizeLoops();
+  }
+};
+
+/**
+ * @class BoundsCheckElimination
+ * @brief Remove the range checks of array accesses indexed by loop induction variables, and
+ *        hoist the remaining ones out of simple loops by versioning them.
+ */
+class BoundsCheckElimination : public PassME {
+ public:
+  BoundsCheckElimination()
+    : PassME("BCE", kNoNodes, kOptimizationBasicBlockChange, "2_post_bce_cfg") {
+  }
+
+  bool Gate(const PassDataHolder* data) const {
+    DCHECK(data != nullptr);
+    CompilationUnit* c_unit = down_cast<const PassMEDataHolder*>(data)->c_unit;
+    DCHECK(c_unit != nullptr);
+    return c_unit->mir_graph->EliminateBoundsChecksGate();
+  }
+
+  void Start(PassDataHolder* data) const {
+    DCHECK(data != nullptr);
+    PassMEDataHolder* pass_me_data_holder = down_cast<PassMEDataHolder*>(data);
+    CompilationUnit* c_unit = pass_me_data_holder->c_unit;
+    DCHECK(c_unit != nullptr);
+    // The CFG only needs to be rebuilt if a loop was versioned.
+    pass_me_data_holder->dirty = c_unit->mir_graph->EliminateBoundsChecks();
+  }
+};
+
+/**
+ * @class LoopUnrolling
+ * @brief Unroll small counted loops, keeping the original loop for the remaining iterations.
+ */
+class LoopUnrolling : public PassME {
+ public:
+  LoopUnrolling()
+    : PassME("LoopUnrolling", kNoNodes, kOptimizationBasicBlockChange, "2_post_unrolling_cfg") {
+  }
+
+  bool Gate(const PassDataHolder* data) const {
+    DCHECK(data != nullptr);
+    CompilationUnit* c_unit = down_cast<const PassMEDataHolder*>(data)->c_unit;
+    DCHECK(c_unit != nullptr);
+    return c_unit->mir_graph->UnrollLoopsGate();
+  }
+
+  void Start(PassDataHolder* data) const {
+    DCHECK(data != nullptr);
+    PassMEDataHolder* pass_me_data_holder = down_cast<PassMEDataHolder*>(data);
+    CompilationUnit* c_unit = pass_me_data_holder->c_unit;
+    DCHECK(c_unit != nullptr);
+    // The CFG only needs to be rebuilt if a loop was unrolled.
+    pass_me_data_holder->dirty = c_unit->mir_graph->UnrollLoops();
+  }
+};
+
 /**
  * @class NullCheckElimination
  * @brief Null check elimination pass.
@@ -0,0 +1,624 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+
+#include "compiler_internals.h"
+#include "dataflow_iterator-inl.h"
+#include "utils/scoped_arena_containers.h"
+
+namespace art {
+
+/*
+ * Bounds check elimination.
+ *
+ * Removes the range checks of array accesses a[i] in loops where i is a basic induction variable
+ * that provably stays within the bounds of a. The loop head H must end with the loop condition,
+ * and its edge into the loop must go to a block S without other predecessors, so that the
+ * condition holds in all blocks dominated by S:
+ *
+ *   for (int i = 0; i < a.length; i++)        0 <= i < a.length
+ *   for (int i = a.length - 1; i >= 0; i--)   0 <= i <= a.length - 1
+ *
+ * The induction variable is a phi of H. Its back edge values must be computed from the phi in
+ * blocks dominated by S. With a step of 1 and i < n <= INT_MAX the increment cannot overflow,
+ * and with a negative step and i >= 0 the decrement cannot underflow.
+ *
+ * In loops made of the head and a single body block, the range checks that cannot be proven
+ * this way, such as b[i] in "for (int i = start; i < a.length; i++) { b[i] = a[i]; }", are
+ * hoisted out of the loop. The loop is versioned by a chain of checks in front of it
+ *
+ *   P -> [if-ltz vI -> H]
+ *        [if-eqz vA -> H; array-length vN, vA]     (the bound is the length of an array)
+ *        for each array: if-eqz vArr -> H; array-length vT, vArr; if-gt vN, vT -> H
+ *        -> H', B'
+ *
+ * where H' and B' are a copy of the loop without these range checks. The quick backend cannot
+ * deoptimize, so when any of the checks fails the original loop runs instead and throws exactly
+ * where it did before.
+ */
+
+// Loops with more MIRs in the head and body are not versioned.
+static constexpr size_t kMaxVersionedLoopSize = 48u;
+
+static bool IsArrayAccess(MIR* mir, int* array_sreg, int* index_sreg) {
+  Instruction::Code opcode = mir->dalvikInsn.opcode;
+  if (opcode < Instruction::AGET || opcode > Instruction::APUT_SHORT || mir->ssa_rep == nullptr) {
+    return false;
+  }
+  // The array and index follow the stored value, if any.
+  uint32_t start = SSARepresentation::GetStartUseIndex(opcode);
+  *array_sreg = mir->ssa_rep->uses[start];
+  *index_sreg = mir->ssa_rep->uses[start + 1u];
+  return true;
+}
+
+static bool IsConditionalBranch(Instruction::Code opcode) {
+  return opcode >= Instruction::IF_EQ && opcode <= Instruction::IF_LEZ;
+}
+
+// Returns the condition that holds when the branch of "opcode" is not taken.
+static Instruction::Code NegateCondition(Instruction::Code opcode) {
+  switch (opcode) {
+    case Instruction::IF_EQ: return Instruction::IF_NE;
+    case Instruction::IF_NE: return Instruction::IF_EQ;
+    case Instruction::IF_LT: return Instruction::IF_GE;
+    case Instruction::IF_GE: return Instruction::IF_LT;
+    case Instruction::IF_GT: return Instruction::IF_LE;
+    case Instruction::IF_LE: return Instruction::IF_GT;
+    case Instruction::IF_EQZ: return Instruction::IF_NEZ;
+    case Instruction::IF_NEZ: return Instruction::IF_EQZ;
+    case Instruction::IF_LTZ: return Instruction::IF_GEZ;
+    case Instruction::IF_GEZ: return Instruction::IF_LTZ;
+    case Instruction::IF_GTZ: return Instruction::IF_LEZ;
+    case Instruction::IF_LEZ: return Instruction::IF_GTZ;
+    default:
+      LOG(FATAL) << "Unexpected opcode " << opcode;
+      return opcode;
+  }
+}
+
+class BoundsCheckEliminator {
+ public:
+  BoundsCheckEliminator(MIRGraph* mir_graph, ScopedArenaAllocator* allocator);
+
+  // Returns true if a loop was versioned and the CFG must be rebuilt.
+  bool Run();
+
+  size_t NumRangeChecks() const {
+    return num_range_checks_;
+  }
+
+  size_t NumEliminated() const {
+    return num_eliminated_;
+  }
+
+  size_t NumHoisted() const {
+    return num_hoisted_;
+  }
+
+ private:
+  static constexpr size_t kNotInOrder = static_cast<size_t>(-1);
+
+  BasicBlock* BlockAt(size_t idx) const {
+    return mir_graph_->GetBasicBlock(order_->Get(idx));
+  }
+
+  bool InLoop(BasicBlockId id) const {
+    if (id == NullBasicBlockId || id >= topological_index_.size()) {
+      return false;
+    }
+    size_t idx = topological_index_[id];
+    return idx != kNotInOrder && idx >= head_idx_ && idx < end_idx_;
+  }
+
+  bool IsInvariant(int s_reg) const {
+    return def_mirs_[s_reg] == nullptr || !InLoop(def_mirs_[s_reg]->bb);
+  }
+
+  bool IsDominatedByEntry(BasicBlockId id) const {
+    BasicBlock* bb = mir_graph_->GetBasicBlock(id);
+    return bb == entry_ || (bb->dominators != nullptr && bb->dominators->IsBitSet(entry_->id));
+  }
+
+  void ProcessLoop(size_t head_idx, size_t end_idx);
+  void ProcessIncreasing(int iv_sreg, int bound_sreg);
+  void ProcessDecreasing(int iv_sreg);
+  MIR* GetInductionPhi(int s_reg) const;
+  bool IsStep(int s_reg, int iv_sreg, int32_t* step) const;
+  bool IsNonNegative(int s_reg) const;
+  int GetLengthArray(int s_reg) const;
+  void EliminateChecks(int iv_sreg, int array_sreg);
+  void VersionLoop(int iv_sreg, int bound_sreg, int bound_array_sreg, bool non_negative);
+  void AppendCheck(MIR* mir);
+  void CopyBlock(BasicBlock* bb, BasicBlock* copy_of_head, BasicBlock* copy_of_body,
+                 int iv_sreg);
+  MIR* NewMIR(int opcode, uint32_t v_a, uint32_t v_b, NarrowDexOffset offset);
+
+  MIRGraph* const mir_graph_;
+  GrowableArray<BasicBlockId>* const order_;
+
+  // Index of each block in the topological sort order, or kNotInOrder.
+  ScopedArenaVector<size_t> topological_index_;
+  // The MIR defining each SSA register, nullptr for the values on method entry.
+  ScopedArenaVector<MIR*> def_mirs_;
+
+  // The loop being processed, made of the blocks at [head_idx_, end_idx_) in the order.
+  size_t head_idx_;
+  size_t end_idx_;
+  BasicBlock* head_;
+  // The successor of the head inside the loop.
+  BasicBlock* entry_;
+
+  // Arrays whose range checks are hoisted out of the loop being versioned.
+  ScopedArenaVector<int> hoisted_arrays_;
+  // The chain of checks in front of the loop being versioned.
+  BasicBlock* preheader_;
+  BasicBlock* last_check_;
+  BasicBlock* open_check_;
+  BasicBlock* first_check_;
+  // Scratch registers of the checks, shared by all versioned loops.
+  int temp_vreg_;
+  int length_vreg_;
+
+  size_t num_range_checks_;
+  size_t num_eliminated_;
+  size_t num_hoisted_;
+  bool changed_;
+
+  DISALLOW_COPY_AND_ASSIGN(BoundsCheckEliminator);
+};
+
+constexpr size_t BoundsCheckEliminator::kNotInOrder;
+
+BoundsCheckEliminator::BoundsCheckEliminator(MIRGraph* mir_graph,
+                                             ScopedArenaAllocator* allocator)
+    : mir_graph_(mir_graph),
+      order_(mir_graph->GetTopologicalSortOrder()),
+      topological_index_(mir_graph->GetNumBlocks(), kNotInOrder, allocator->Adapter()),
+      def_mirs_(mir_graph->GetNumSSARegs(), nullptr, allocator->Adapter()),
+      head_idx_(0u),
+      end_idx_(0u),
+      head_(nullptr),
+      entry_(nullptr),
+      hoisted_arrays_(allocator->Adapter()),
+      preheader_(nullptr),
+      last_check_(nullptr),
+      open_check_(nullptr),
+      first_check_(nullptr),
+      temp_vreg_(-1),
+      length_vreg_(-1),
+      num_range_checks_(0u),
+      num_eliminated_(0u),
+      num_hoisted_(0u),
+      changed_(false) {
+}
+
+bool BoundsCheckEliminator::Run() {
+  for (size_t idx = 0; idx != order_->Size(); idx++) {
+    topological_index_[order_->Get(idx)] = idx;
+  }
+  AllNodesIterator iter(mir_graph_);
+  for (BasicBlock* bb = iter.Next(); bb != nullptr; bb = iter.Next()) {
+    for (MIR* mir = bb->first_mir_insn; mir != nullptr; mir = mir->next) {
+      if (mir->ssa_rep == nullptr) {
+        continue;
+      }
+      for (int i = 0; i < mir->ssa_rep->num_defs; i++) {
+        def_mirs_[mir->ssa_rep->defs[i]] = mir;
+      }
+      if ((MIRGraph::GetDataFlowAttributes(mir) & DF_HAS_RANGE_CHKS) != 0) {
+        num_range_checks_++;
+      }
+    }
+  }
+
+  GrowableArray<BasicBlockId>* loop_ends = mir_graph_->GetTopologicalSortOrderLoopEnds();
+  size_t num_blocks = order_->Size();
+  for (size_t idx = 0; idx != num_blocks; idx++) {
+    if (loop_ends->Get(idx) != 0u) {
+      ProcessLoop(idx, loop_ends->Get(idx));
+    }
+  }
+  return changed_;
+}
+
+void BoundsCheckEliminator::ProcessLoop(size_t head_idx, size_t end_idx) {
+  head_idx_ = head_idx;
+  end_idx_ = end_idx;
+  head_ = BlockAt(head_idx);
+  MIR* branch = head_->last_mir_insn;
+  if (branch == nullptr || branch->ssa_rep == nullptr ||
+      !IsConditionalBranch(branch->dalvikInsn.opcode)) {
+    return;
+  }
+
+  // Find the edge into the loop and the condition that holds on it.
+  Instruction::Code condition;
+  if (InLoop(head_->taken) && !InLoop(head_->fall_through)) {
+    entry_ = mir_graph_->GetBasicBlock(head_->taken);
+    condition = branch->dalvikInsn.opcode;
+  } else if (InLoop(head_->fall_through) && !InLoop(head_->taken)) {
+    entry_ = mir_graph_->GetBasicBlock(head_->fall_through);
+    condition = NegateCondition(branch->dalvikInsn.opcode);
+  } else {
+    return;
+  }
+  if (entry_->predecessors->Size() != 1u) {
+    return;
+  }
+
+  const int32_t* uses = branch->ssa_rep->uses;
+  switch (condition) {
+    case Instruction::IF_LT:
+      ProcessIncreasing(uses[0], uses[1]);
+      break;
+    case Instruction::IF_GT:
+      ProcessIncreasing(uses[1], uses[0]);
+      break;
+    case Instruction::IF_GEZ:
+    case Instruction::IF_GTZ:
+      ProcessDecreasing(uses[0]);
+      break;
+    default:
+      break;
+  }
+}
+
+// i < n, with i incremented by 1 on every back edge.
+void BoundsCheckEliminator::ProcessIncreasing(int iv_sreg, int bound_sreg) {
+  MIR* phi = GetInductionPhi(iv_sreg);
+  if (phi == nullptr) {
+    return;
+  }
+  bool non_negative = true;
+  size_t num_entry_values = 0u;
+  for (int i = 0; i < phi->ssa_rep->num_uses; i++) {
+    int value = phi->ssa_rep->uses[i];
+    int32_t step;
+    if (InLoop(phi->meta.phi_incoming[i])) {
+      if (!IsStep(value, iv_sreg, &step) || step != 1) {
+        return;
+      }
+    } else {
+      non_negative = non_negative && IsNonNegative(value);
+      num_entry_values++;
+    }
+  }
+
+  int bound_array_sreg = GetLengthArray(bound_sreg);
+  if (non_negative && bound_array_sreg != INVALID_SREG) {
+    EliminateChecks(iv_sreg, bound_array_sreg);
+  }
+  if (num_entry_values == 1u) {
+    VersionLoop(iv_sreg, bound_sreg, bound_array_sreg, non_negative);
+  }
+}
+
+// i >= 0, with i starting below the length of an array and decremented on every back edge.
+void BoundsCheckEliminator::ProcessDecreasing(int iv_sreg) {
+  MIR* phi = GetInductionPhi(iv_sreg);
+  if (phi == nullptr) {
+    return;
+  }
+  int array_sreg = INVALID_SREG;
+  for (int i = 0; i < phi->ssa_rep->num_uses; i++) {
+    int value = phi->ssa_rep->uses[i];
+    int32_t step;
+    if (InLoop(phi->meta.phi_incoming[i])) {
+      if (!IsStep(value, iv_sreg, &step) || step >= 0) {
+        return;
+      }
+      continue;
+    }
+    // The entry value must be "array.length - k" with k > 0.
+    MIR* def = def_mirs_[value];
+    if (def == nullptr ||
+        (def->dalvikInsn.opcode != Instruction::ADD_INT_LIT8 &&
+         def->dalvikInsn.opcode != Instruction::ADD_INT_LIT16) ||
+        static_cast<int32_t>(def->dalvikInsn.vC) >= 0) {
+      return;
+    }
+    int entry_array_sreg = GetLengthArray(def->ssa_rep->uses[0]);
+    if (entry_array_sreg == INVALID_SREG ||
+        (array_sreg != INVALID_SREG && array_sreg != entry_array_sreg)) {
+      return;
+    }
+    array_sreg = entry_array_sreg;
+  }
+  if (array_sreg != INVALID_SREG) {
+    EliminateChecks(iv_sreg, array_sreg);
+  }
+}
+
+// Returns the phi of the loop head defining "s_reg", or nullptr.
+MIR* BoundsCheckEliminator::GetInductionPhi(int s_reg) const {
+  MIR* def = def_mirs_[s_reg];
+  if (def == nullptr || def->bb != head_->id ||
+      def->dalvikInsn.opcode != static_cast<Instruction::Code>(kMirOpPhi)) {
+    return nullptr;
+  }
+  return def;
+}
+
+// Checks that "s_reg" is "iv + step", computed where the loop condition holds.
+bool BoundsCheckEliminator::IsStep(int s_reg, int iv_sreg, int32_t* step) const {
+  MIR* def = def_mirs_[s_reg];
+  if (def == nullptr ||
+      (def->dalvikInsn.opcode != Instruction::ADD_INT_LIT8 &&
+       def->dalvikInsn.opcode != Instruction::ADD_INT_LIT16) ||
+      def->ssa_rep->uses[0] != iv_sreg ||
+      !IsDominatedByEntry(def->bb)) {
+    return false;
+  }
+  *step = static_cast<int32_t>(def->dalvikInsn.vC);
+  return true;
+}
+
+bool BoundsCheckEliminator::IsNonNegative(int s_reg) const {
+  if (mir_graph_->IsConst(s_reg)) {
+    return mir_graph_->ConstantValue(s_reg) >= 0;
+  }
+  return GetLengthArray(s_reg) != INVALID_SREG;
+}
+
+// Returns the array "s_reg" is the length of, or INVALID_SREG.
+int BoundsCheckEliminator::GetLengthArray(int s_reg) const {
+  MIR* def = def_mirs_[s_reg];
+  if (def == nullptr || def->dalvikInsn.opcode != Instruction::ARRAY_LENGTH) {
+    return INVALID_SREG;
+  }
+  return def->ssa_rep->uses[0];
+}
+
+// Removes the range checks of "array[iv]" where the loop condition holds.
+void BoundsCheckEliminator::EliminateChecks(int iv_sreg, int array_sreg) {
+  for (size_t idx = head_idx_ + 1u; idx != end_idx_; idx++) {
+    BasicBlock* bb = BlockAt(idx);
+    if (!IsDominatedByEntry(bb->id)) {
+      continue;
+    }
+    for (MIR* mir = bb->first_mir_insn; mir != nullptr; mir = mir->next) {
+      int access_array_sreg;
+      int access_index_sreg;
+      if (IsArrayAccess(mir, &access_array_sreg, &access_index_sreg) &&
+          access_array_sreg == array_sreg && access_index_sreg == iv_sreg &&
+          (mir->optimization_flags & MIR_IGNORE_RANGE_CHECK) == 0) {
+        mir->optimization_flags |= MIR_IGNORE_RANGE_CHECK;
+        num_eliminated_++;
+      }
+    }
+  }
+}
+
+void BoundsCheckEliminator::VersionLoop(int iv_sreg, int bound_sreg, int bound_array_sreg,
+                                        bool non_negative) {
+  // Only loops made of the head and a single body block.
+  if (end_idx_ != head_idx_ + 2u || BlockAt(head_idx_ + 1u) != entry_) {
+    return;
+  }
+  BasicBlock* body = entry_;
+  if (head_->block_type != kDalvikByteCode || body->block_type != kDalvikByteCode ||
+      head_->catch_entry || body->catch_entry ||
+      head_->successor_block_list_type != kNotUsed ||
+      body->successor_block_list_type != kNotUsed ||
+      head_->predecessors->Size() != 2u) {
+    return;
+  }
+  BasicBlockId preheader_id = head_->predecessors->Get(0);
+  if (preheader_id == body->id) {
+    preheader_id = head_->predecessors->Get(1);
+  } else if (head_->predecessors->Get(1) != body->id) {
+    return;
+  }
+  preheader_ = mir_graph_->GetBasicBlock(preheader_id);
+
+  // The bound must be known in front of the loop.
+  if (bound_array_sreg != INVALID_SREG ? !IsInvariant(bound_array_sreg)
+                                       : !IsInvariant(bound_sreg)) {
+    return;
+  }
+
+  size_t size = 0u;
+  for (BasicBlock* bb : { head_, body }) {
+    for (MIR* mir = bb->first_mir_insn; mir != nullptr; mir = mir->next) {
+      size++;
+    }
+  }
+  if (size > kMaxVersionedLoopSize) {
+    return;
+  }
+
+  // Collect the arrays whose checks are hoisted.
+  hoisted_arrays_.clear();
+  size_t num_hoisted = 0u;
+  for (MIR* mir = body->first_mir_insn; mir != nullptr; mir = mir->next) {
+    int array_sreg;
+    int index_sreg;
+    if (!IsArrayAccess(mir, &array_sreg, &index_sreg) || index_sreg != iv_sreg ||
+        (mir->optimization_flags & MIR_IGNORE_RANGE_CHECK) != 0) {
+      continue;
+    }
+    if (array_sreg != bound_array_sreg) {
+      if (!IsInvariant(array_sreg)) {
+        continue;
+      }
+      if (std::find(hoisted_arrays_.begin(), hoisted_arrays_.end(), array_sreg) ==
+          hoisted_arrays_.end()) {
+        hoisted_arrays_.push_back(array_sreg);
+      }
+    }
+    num_hoisted++;
+  }
+  if (num_hoisted == 0u) {
+    return;
+  }
+  if (temp_vreg_ < 0) {
+    if (mir_graph_->GetNumAvailableVRTemps() < 2u) {
+      return;
+    }
+    temp_vreg_ = mir_graph_->GetNewCompilerTemp(kCompilerTempVR, false)->v_reg;
+    length_vreg_ = mir_graph_->GetNewCompilerTemp(kCompilerTempVR, false)->v_reg;
+  }
+
+  // Build the checks.
+  NarrowDexOffset offset = head_->last_mir_insn->offset;
+  first_check_ = nullptr;
+  last_check_ = nullptr;
+  open_check_ = nullptr;
+  int iv_vreg = mir_graph_->SRegToVReg(iv_sreg);
+  if (!non_negative) {
+    AppendCheck(NewMIR(Instruction::IF_LTZ, iv_vreg, 0u, offset));
+  }
+  int bound_vreg;
+  if (bound_array_sreg != INVALID_SREG) {
+    int bound_array_vreg = mir_graph_->SRegToVReg(bound_array_sreg);
+    AppendCheck(NewMIR(Instruction::IF_EQZ, bound_array_vreg, 0u, offset));
+    MIR* length = NewMIR(Instruction::ARRAY_LENGTH, length_vreg_, bound_array_vreg, offset);
+    length->optimization_flags |= MIR_IGNORE_NULL_CHECK;
+    AppendCheck(length);
+    bound_vreg = length_vreg_;
+  } else {
+    bound_vreg = mir_graph_->SRegToVReg(bound_sreg);
+  }
+  for (int array_sreg : hoisted_arrays_) {
+    int array_vreg = mir_graph_->SRegToVReg(array_sreg);
+    AppendCheck(NewMIR(Instruction::IF_EQZ, array_vreg, 0u, offset));
+    MIR* length = NewMIR(Instruction::ARRAY_LENGTH, temp_vreg_, array_vreg, offset);
+    length->optimization_flags |= MIR_IGNORE_NULL_CHECK;
+    AppendCheck(length);
+    AppendCheck(NewMIR(Instruction::IF_GT, bound_vreg, temp_vreg_, offset));
+  }
+  DCHECK(first_check_ != nullptr);
+  DCHECK(open_check_ == nullptr);
+
+  // Copy the loop. The range checks hoisted into the chain are dropped from the copy.
+  hoisted_arrays_.push_back(bound_array_sreg);
+  BasicBlock* head_copy = mir_graph_->CreateNewBB(kDalvikByteCode);
+  BasicBlock* body_copy = mir_graph_->CreateNewBB(kDalvikByteCode);
+  CopyBlock(head_, head_copy, body_copy, iv_sreg);
+  CopyBlock(body, head_copy, body_copy, iv_sreg);
+  last_check_->fall_through = head_copy->id;
+  head_copy->predecessors->Insert(last_check_->id);
+
+  // Enter the checks instead of the original loop.
+  preheader_->ReplaceChild(head_->id, first_check_->id);
+  head_->predecessors->Delete(preheader_->id);
+  first_check_->predecessors->Insert(preheader_->id);
+
+  num_hoisted_ += num_hoisted;
+  changed_ = true;
+}
+
+// Appends "mir" to the chain of checks. A branch ends its block, the original loop runs when
+// it is taken.
+void BoundsCheckEliminator::AppendCheck(MIR* mir) {
+  if (open_check_ == nullptr) {
+    open_check_ = mir_graph_->CreateNewBB(kDalvikByteCode);
+    open_check_->start_offset = head_->start_offset;
+    open_check_->nesting_depth = preheader_->nesting_depth;
+    if (last_check_ != nullptr) {
+      last_check_->fall_through = open_check_->id;
+      open_check_->predecessors->Insert(last_check_->id);
+    } else {
+      first_check_ = open_check_;
+    }
+  }
+  open_check_->AppendMIR(mir);
+  if (IsConditionalBranch(mir->dalvikInsn.opcode)) {
+    // The checks branch to the loop head but must not suspend, the loop does.
+    mir->optimization_flags |= MIR_IGNORE_SUSPEND_CHECK;
+    open_check_->taken = head_->id;
+    open_check_->conditional_branch = true;
+    head_->predecessors->Insert(open_check_->id);
+    last_check_ = open_check_;
+    open_check_ = nullptr;
+  }
+}
+
+// Fills "copy" with the MIRs of "bb" from the loop, redirecting edges within the loop to the
+// copies of the head and body. Phis are left to the SSA rebuild.
+void BoundsCheckEliminator::CopyBlock(BasicBlock* bb, BasicBlock* copy_of_head,
+                                      BasicBlock* copy_of_body, int iv_sreg) {
+  BasicBlock* copy = (bb == head_) ? copy_of_head : copy_of_body;
+  copy->start_offset = bb->start_offset;
+  copy->nesting_depth = bb->nesting_depth;
+  copy->conditional_branch = bb->conditional_branch;
+  for (MIR* mir = bb->first_mir_insn; mir != nullptr; mir = mir->next) {
+    if (mir->dalvikInsn.opcode == static_cast<Instruction::Code>(kMirOpPhi)) {
+      continue;
+    }
+    MIR* mir_copy = mir->Copy(mir_graph_);
+    int array_sreg;
+    int index_sreg;
+    if (bb != head_ && IsArrayAccess(mir, &array_sreg, &index_sreg) && index_sreg == iv_sreg &&
+        std::find(hoisted_arrays_.begin(), hoisted_arrays_.end(), array_sreg) !=
+            hoisted_arrays_.end()) {
+      mir_copy->optimization_flags |= MIR_IGNORE_RANGE_CHECK;
+    }
+    copy->AppendMIR(mir_copy);
+  }
+  for (BasicBlockId* successor : { &copy->taken, &copy->fall_through }) {
+    BasicBlockId original = (successor == &copy->taken) ? bb->taken : bb->fall_through;
+    if (original == head_->id) {
+      *successor = copy_of_head->id;
+    } else if (original == entry_->id) {
+      *successor = copy_of_body->id;
+    } else {
+      *successor = original;
+    }
+    if (*successor != NullBasicBlockId) {
+      mir_graph_->GetBasicBlock(*successor)->predecessors->Insert(copy->id);
+    }
+  }
+}
+
+MIR* BoundsCheckEliminator::NewMIR(int opcode, uint32_t v_a, uint32_t v_b,
+                                   NarrowDexOffset offset) {
+  MIR* mir = mir_graph_->NewMIR();
+  mir->dalvikInsn.opcode = static_cast<Instruction::Code>(opcode);
+  mir->dalvikInsn.vA = v_a;
+  mir->dalvikInsn.vB = v_b;
+  mir->offset = offset;
+  return mir;
+}
+
+bool MIRGraph::EliminateBoundsChecksGate() {
+  if ((cu_->disable_opt & (1 << kBoundsCheckElimination)) != 0 ||
+      (merged_df_flags_ & DF_HAS_RANGE_CHKS) == 0) {
+    return false;
+  }
+  return true;
+}
+
+bool MIRGraph::EliminateBoundsChecks() {
+  ScopedArenaAllocator allocator(&cu_->arena_stack);
+  BoundsCheckEliminator eliminator(this, &allocator);
+  bool changed = eliminator.Run();
+  if (cu_->verbose && (eliminator.NumEliminated() != 0u || eliminator.NumHoisted() != 0u)) {
+    LOG(INFO) << "Eliminated " << eliminator.NumEliminated() << " and hoisted "
+              << eliminator.NumHoisted() << " of " << eliminator.NumRangeChecks()
+              << " range checks in " << PrettyMethod(cu_->method_idx, *cu_->dex_file);
+  }
+  if (cu_->compiler_driver != nullptr) {
+    cu_->compiler_driver->ProcessedBoundsChecks(eliminator.NumRangeChecks(),
+                                                eliminator.NumEliminated(),
+                                                eliminator.NumHoisted());
+  }
+  return changed;
+}
+
+}  // namespace art
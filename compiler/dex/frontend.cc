@@ -58,6 +58,9 @@ static uint32_t kCompilerOptimizerDisableFlags = 0 |  // Disable specific optimi
   // (1 << kSuppressExceptionEdges) |
   // (1 << kSuppressMethodInlining) |
   (1 << kSuppressCodeMotionAcrossSafepoint) |
+  // (1 << kLoopVectorization) |
+  // (1 << kBoundsCheckElimination) |
+  // (1 << kLoopUnrolling) |
   0;
 
 static uint32_t kCompilerDebugFlags = 0 |     // Enable debug/testing modes
@@ -226,6 +229,12 @@ static CompiledMethod* CompileMethod(CompilerDriver& driver,
       LOG(INFO) << PrettyMethod(method_idx, dex_file) << " " << Dumpable<MemStats>(stack_stats);
     }
   }
+  CompileStats* compile_stats = driver.GetCompileStats();
+  if (compile_stats != nullptr) {
+    compile_stats->RecordArenaUsage(MethodReference(&dex_file, method_idx),
+                                    cu.arena_stack.BytesReserved(),
+                                    cu.arena_stack.GetPeakAllocatorStats());
+  }
   cu.arena_stack.Reset();
 
   CompiledMethod* result = NULL;
@@ -255,6 +264,16 @@ static CompiledMethod* CompileMethod(CompilerDriver& driver,
     }
   }
 
+  if (compile_stats != nullptr) {
+    compile_stats->RecordArenaUsage(MethodReference(&dex_file, method_idx),
+                                    cu.arena.BytesReserved(), cu.arena.GetStats());
+    if (result != nullptr) {
+      compile_stats->RecordBackend((llvm_compilation_unit != nullptr)
+                                   ? CompileStats::kBackendPortable
+                                   : CompileStats::kBackendQuick);
+    }
+  }
+
   if (cu.enable_debug & (1 << kDebugShowSummaryMemoryUsage)) {
     LOG(INFO) << "MEMINFO " << cu.arena.BytesAllocated() << " " << cu.mir_graph->GetNumBlocks()
               << " " << PrettyMethod(method_idx, dex_file);
@@ -51,6 +51,9 @@ enum opt_control_vector {
   kSuppressExceptionEdges,
   kSuppressMethodInlining,
   kSuppressCodeMotionAcrossSafepoint,    /**!< Used to prevent optimizers from moving instructions across safepoints. */
+  kLoopVectorization,
+  kBoundsCheckElimination,
+  kLoopUnrolling,
 };
 
 // Force code generation paths for testing.
@@ -49,6 +49,7 @@ static constexpr uint16_t kMergeBlockAliasingArrayVersionBumpOp = Instruction::A
 static constexpr uint16_t kMergeBlockAliasingArrayMergeLocationOp = Instruction::APUT_BOOLEAN;
 static constexpr uint16_t kMergeBlockNonAliasingIFieldVersionBumpOp = Instruction::APUT_BYTE;
 static constexpr uint16_t kMergeBlockSFieldVersionBumpOp = Instruction::APUT_CHAR;
+static constexpr uint16_t kPackedArrayPutValueOp = Instruction::APUT_SHORT;
 
 }  // anonymous namespace
 
@@ -1114,6 +1115,11 @@ void LocalValueNumbering::HandleAPut(MIR* mir, uint16_t opcode) {
   uint16_t value = (opcode == Instruction::APUT_WIDE)
                    ? GetOperandValueWide(mir->ssa_rep->uses[0])
                    : GetOperandValue(mir->ssa_rep->uses[0]);
+  HandleArrayStore(array, index, type, value);
+}
+
+void LocalValueNumbering::HandleArrayStore(uint16_t array, uint16_t index, uint16_t type,
+                                           uint16_t value) {
   if (IsNonAliasing(array)) {
     bool put_is_live = HandleAliasingValuesPut<NonAliasingArrayVersions>(
         &non_aliasing_array_value_map_, array, index, value);
@@ -1140,6 +1146,34 @@ void LocalValueNumbering::HandleAPut(MIR* mir, uint16_t opcode) {
   }
 }
 
+void LocalValueNumbering::HandlePackedArrayPut(MIR* mir) {
+  uint16_t array = GetOperandValue(mir->ssa_rep->uses[0]);
+  HandleNullCheck(mir, array);
+  uint16_t index = GetOperandValue(mir->ssa_rep->uses[1]);
+  uint16_t type;
+  switch (static_cast<OpSize>(mir->dalvikInsn.arg[0] >> 16)) {
+    case kSignedByte:
+      type = Instruction::APUT_BYTE - Instruction::APUT;
+      break;
+    case kUnsignedByte:
+      type = Instruction::APUT_BOOLEAN - Instruction::APUT;
+      break;
+    case kSignedHalf:
+      type = Instruction::APUT_SHORT - Instruction::APUT;
+      break;
+    case kUnsignedHalf:
+      type = Instruction::APUT_CHAR - Instruction::APUT;
+      break;
+    default:
+      type = 0u;  // APUT, int or float.
+      break;
+  }
+  // The store writes a whole vector of elements starting at the index. Treat it as a store of
+  // a value unique to this insn at the index, which forgets all other values of the array.
+  uint16_t value = gvn_->LookupValue(kPackedArrayPutValueOp, array, index, mir->offset);
+  HandleArrayStore(array, index, type, value);
+}
+
 uint16_t LocalValueNumbering::HandleIGet(MIR* mir, uint16_t opcode) {
   uint16_t base = GetOperandValue(mir->ssa_rep->uses[0]);
   HandleNullCheck(mir, base);
@@ -1770,6 +1804,15 @@ uint16_t LocalValueNumbering::GetValueNumber(MIR* mir) {
       HandleAPut(mir, opcode);
       break;
 
+    case kMirOpPackedArrayGet:
+      // Only null check the array, the vector register contents are not numbered.
+      HandleNullCheck(mir, GetOperandValue(mir->ssa_rep->uses[0]));
+      break;
+
+    case kMirOpPackedArrayPut:
+      HandlePackedArrayPut(mir);
+      break;
+
     case Instruction::IGET_OBJECT:
     case Instruction::IGET:
     case Instruction::IGET_WIDE:
@@ -303,6 +303,8 @@ class LocalValueNumbering {
   uint16_t HandlePhi(MIR* mir);
   uint16_t HandleAGet(MIR* mir, uint16_t opcode);
   void HandleAPut(MIR* mir, uint16_t opcode);
+  void HandleArrayStore(uint16_t array, uint16_t index, uint16_t type, uint16_t value);
+  void HandlePackedArrayPut(MIR* mir);
   uint16_t HandleIGet(MIR* mir, uint16_t opcode);
   void HandleIPut(MIR* mir, uint16_t opcode);
   uint16_t HandleSGet(MIR* mir, uint16_t opcode);
@@ -0,0 +1,408 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "compiler_internals.h"
+#include "driver/compiler_options.h"
+#include "utils/scoped_arena_containers.h"
+
+namespace art {
+
+/*
+ * Loop unrolling.
+ *
+ * A counted loop made of a head block H and a single body block B, such as
+ *
+ *   H: phis; [array-length vN, vArr]; if-ge vI, vN -> exit
+ *   B: <work>; add-int/lit8 vI, vI, #1; goto H
+ *
+ * pays for the loop condition, the suspend check on the back edge and a jump in every
+ * iteration. An unrolled copy of the loop runs "factor" iterations of the body per trip and is
+ * entered as long as that many iterations are left. The original loop is kept unchanged and runs
+ * the remaining iterations:
+ *
+ *   P -> C0: add-int/lit8 vT, vI, #(factor - 1); if-ltz vT -> H
+ *        C1: if-ge vT, vN -> H                            (bound is a plain register)
+ *        or: if-eqz vArr -> H; array-length vL, vArr; if-ge vT, vL -> H
+ *        UB: <work>; add-int/lit8 vI, vI, #1; ... (factor times); goto C0
+ *
+ * The checks make sure that the loop condition holds for vI, ..., vI + factor - 1, so the
+ * unrolled body runs exactly the iterations the original loop would have run, in the same order,
+ * and its instructions keep the flags of the original ones, including the range checks removed
+ * by bounds check elimination. The single back edge of UB carries the only suspend check.
+ *
+ * UB is entered without running H, so the body must not use the vN defined by the array-length
+ * of the head: only the phis of the head are also defined on the way into UB.
+ *
+ * Unrolling is limited to small bodies without calls, and the number of MIRs it adds to a method
+ * is bounded, so that it is only worth doing under the speed oriented compiler filters.
+ */
+
+// Loops are unrolled by at most this factor, a power of two.
+static constexpr size_t kMaxUnrollFactor = 4u;
+
+// The unrolled body holds at most this many MIRs, not counting the final goto.
+static constexpr size_t kMaxUnrolledBodySize = 32u;
+
+// At most this many MIRs are added to a method by unrolling its loops.
+static constexpr size_t kMaxUnrolledMIRsPerMethod = 128u;
+
+// Methods with more code units are not considered.
+static constexpr size_t kMaxUnrolledMethodSize = 2000u;
+
+static bool IsGoto(Instruction::Code opcode) {
+  return opcode == Instruction::GOTO || opcode == Instruction::GOTO_16 ||
+      opcode == Instruction::GOTO_32;
+}
+
+class LoopUnroller {
+ public:
+  LoopUnroller(MIRGraph* mir_graph, ScopedArenaAllocator* allocator)
+      : mir_graph_(mir_graph),
+        head_(nullptr),
+        body_(nullptr),
+        preheader_(nullptr),
+        head_branch_(nullptr),
+        increment_(nullptr),
+        iv_vreg_(-1),
+        iv_sreg_(INVALID_SREG),
+        bound_vreg_(-1),
+        bound_array_vreg_(-1),
+        head_length_sreg_(INVALID_SREG),
+        body_size_(0u),
+        factor_(0u),
+        defined_in_loop_(mir_graph->GetNumOfCodeAndTempVRs(), false, allocator->Adapter()) {
+  }
+
+  // Checks that the loop made of "head" and "body" can be unrolled and picks the unroll factor.
+  // Returns false if the loop is not unrolled; the graph is not modified either way.
+  bool Prepare(BasicBlock* head, BasicBlock* body);
+
+  // Returns the number of MIRs the unrolled copy of the loop adds to the method.
+  size_t AddedSize() const {
+    return (body_size_ + 1u) * factor_ + 5u;
+  }
+
+  size_t Factor() const {
+    return factor_;
+  }
+
+  // Inserts the checks and the unrolled loop in front of the loop head. "temp_vreg" and
+  // "length_vreg" are scratch virtual registers.
+  void Transform(int temp_vreg, int length_vreg);
+
+ private:
+  bool IsInvariant(int s_reg) const {
+    return !defined_in_loop_[mir_graph_->SRegToVReg(s_reg)];
+  }
+
+  bool MatchLoop();
+  bool MatchBody();
+
+  MIR* NewMIR(int opcode, uint32_t v_a, uint32_t v_b, uint32_t v_c, NarrowDexOffset offset);
+  BasicBlock* NewCheckBlock(BasicBlock* pred, MIR* first, MIR* branch);
+
+  MIRGraph* const mir_graph_;
+
+  BasicBlock* head_;
+  BasicBlock* body_;
+  BasicBlock* preheader_;
+  MIR* head_branch_;
+  MIR* increment_;
+  int iv_vreg_;
+  // The value of the induction variable in the body, defined by its phi in the head.
+  int iv_sreg_;
+  // The loop bound is either a register or the length of an array.
+  int bound_vreg_;
+  int bound_array_vreg_;
+  // The array length defined in the head, if any.
+  int head_length_sreg_;
+  // Number of MIRs of the body in front of the increment.
+  size_t body_size_;
+  size_t factor_;
+
+  ScopedArenaVector<bool> defined_in_loop_;
+};
+
+bool LoopUnroller::Prepare(BasicBlock* head, BasicBlock* body) {
+  head_ = head;
+  body_ = body;
+  if (!MatchLoop() || !MatchBody()) {
+    return false;
+  }
+  factor_ = kMaxUnrollFactor;
+  while (factor_ > 1u && (body_size_ + 1u) * factor_ > kMaxUnrolledBodySize) {
+    factor_ /= 2u;
+  }
+  return factor_ > 1u;
+}
+
+bool LoopUnroller::MatchLoop() {
+  if (head_->block_type != kDalvikByteCode || body_->block_type != kDalvikByteCode ||
+      head_->catch_entry || body_->catch_entry ||
+      head_->successor_block_list_type != kNotUsed ||
+      body_->successor_block_list_type != kNotUsed) {
+    return false;
+  }
+
+  // The body must be a single block ending with "add-int/lit vI, vI, #1; goto head".
+  MIR* last = body_->last_mir_insn;
+  if (body_->predecessors->Size() != 1u || body_->predecessors->Get(0) != head_->id ||
+      body_->taken != head_->id || body_->fall_through != NullBasicBlockId ||
+      last == nullptr || !IsGoto(last->dalvikInsn.opcode)) {
+    return false;
+  }
+  for (MIR* mir = body_->first_mir_insn; mir != last; mir = mir->next) {
+    if (mir->next == last) {
+      increment_ = mir;
+    }
+  }
+  if (increment_ == nullptr ||
+      (increment_->dalvikInsn.opcode != Instruction::ADD_INT_LIT8 &&
+       increment_->dalvikInsn.opcode != Instruction::ADD_INT_LIT16) ||
+      increment_->dalvikInsn.vA != increment_->dalvikInsn.vB ||
+      static_cast<int32_t>(increment_->dalvikInsn.vC) != 1) {
+    return false;
+  }
+  iv_vreg_ = increment_->dalvikInsn.vA;
+  iv_sreg_ = increment_->ssa_rep->uses[0];
+
+  // The head has the preheader and the body as predecessors.
+  if (head_->predecessors->Size() != 2u) {
+    return false;
+  }
+  BasicBlockId preheader_id = head_->predecessors->Get(0);
+  if (preheader_id == body_->id) {
+    preheader_id = head_->predecessors->Get(1);
+  } else if (head_->predecessors->Get(1) != body_->id) {
+    return false;
+  }
+  preheader_ = mir_graph_->GetBasicBlock(preheader_id);
+
+  // Registers defined in the loop. Phis define nothing new for this purpose.
+  for (BasicBlock* bb : { head_, body_ }) {
+    for (MIR* mir = bb->first_mir_insn; mir != nullptr; mir = mir->next) {
+      if (mir->dalvikInsn.opcode == static_cast<Instruction::Code>(kMirOpPhi)) {
+        continue;
+      }
+      for (int i = 0; i < mir->ssa_rep->num_defs; i++) {
+        defined_in_loop_[mir_graph_->SRegToVReg(mir->ssa_rep->defs[i])] = true;
+      }
+    }
+  }
+
+  // The head holds phis, an optional array-length and the loop condition.
+  MIR* array_length = nullptr;
+  for (MIR* mir = head_->first_mir_insn; mir != nullptr; mir = mir->next) {
+    Instruction::Code opcode = mir->dalvikInsn.opcode;
+    if (opcode == static_cast<Instruction::Code>(kMirOpPhi)) {
+      continue;
+    }
+    if (opcode == Instruction::ARRAY_LENGTH && array_length == nullptr &&
+        mir->next == head_->last_mir_insn) {
+      array_length = mir;
+      continue;
+    }
+    if (mir != head_->last_mir_insn) {
+      return false;
+    }
+    head_branch_ = mir;
+  }
+  if (head_branch_ == nullptr) {
+    return false;
+  }
+  BasicBlockId exit;
+  if (head_branch_->dalvikInsn.opcode == Instruction::IF_GE && head_->fall_through == body_->id) {
+    exit = head_->taken;
+  } else if (head_branch_->dalvikInsn.opcode == Instruction::IF_LT &&
+             head_->taken == body_->id) {
+    exit = head_->fall_through;
+  } else {
+    return false;
+  }
+  if (exit == NullBasicBlockId || exit == head_->id ||
+      head_branch_->ssa_rep->uses[0] != iv_sreg_) {
+    return false;
+  }
+
+  int bound_sreg = head_branch_->ssa_rep->uses[1];
+  if (array_length != nullptr) {
+    if (array_length->ssa_rep->defs[0] != bound_sreg ||
+        !IsInvariant(array_length->ssa_rep->uses[0])) {
+      return false;
+    }
+    bound_array_vreg_ = array_length->dalvikInsn.vB;
+    head_length_sreg_ = bound_sreg;
+  } else {
+    if (!IsInvariant(bound_sreg)) {
+      return false;
+    }
+    bound_vreg_ = head_branch_->dalvikInsn.vB;
+  }
+  return true;
+}
+
+bool LoopUnroller::MatchBody() {
+  // Calls dominate the cost of the iteration; other MIRs are copied as they are, as long as
+  // they do not read the array length computed by the head.
+  for (MIR* mir = body_->first_mir_insn; mir != increment_; mir = mir->next) {
+    if (++body_size_ > kMaxUnrolledBodySize / 2u) {
+      return false;
+    }
+    Instruction::Code opcode = mir->dalvikInsn.opcode;
+    if (MIR::DecodedInstruction::IsPseudoMirOp(opcode) ||
+        (Instruction::FlagsOf(opcode) & Instruction::kInvoke) != 0) {
+      return false;
+    }
+    for (int i = 0; i < mir->ssa_rep->num_uses; i++) {
+      if (mir->ssa_rep->uses[i] == head_length_sreg_) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+MIR* LoopUnroller::NewMIR(int opcode, uint32_t v_a, uint32_t v_b, uint32_t v_c,
+                          NarrowDexOffset offset) {
+  MIR* mir = mir_graph_->NewMIR();
+  mir->dalvikInsn.opcode = static_cast<Instruction::Code>(opcode);
+  mir->dalvikInsn.vA = v_a;
+  mir->dalvikInsn.vB = v_b;
+  mir->dalvikInsn.vC = v_c;
+  mir->offset = offset;
+  return mir;
+}
+
+// Appends a block holding "first" (if any) and the check "branch" to the chain after "pred".
+// A failed check continues in the loop head.
+BasicBlock* LoopUnroller::NewCheckBlock(BasicBlock* pred, MIR* first, MIR* branch) {
+  BasicBlock* bb = mir_graph_->CreateNewBB(kDalvikByteCode);
+  bb->start_offset = head_->start_offset;
+  bb->nesting_depth = body_->nesting_depth;
+  if (first != nullptr) {
+    bb->AppendMIR(first);
+  }
+  // The checks branch back to the loop head but must not suspend, the original loop does.
+  branch->optimization_flags |= MIR_IGNORE_SUSPEND_CHECK;
+  bb->AppendMIR(branch);
+  bb->taken = head_->id;
+  bb->conditional_branch = true;
+  head_->predecessors->Insert(bb->id);
+  if (pred != nullptr) {
+    pred->fall_through = bb->id;
+    bb->predecessors->Insert(pred->id);
+  }
+  return bb;
+}
+
+void LoopUnroller::Transform(int temp_vreg, int length_vreg) {
+  NarrowDexOffset offset = head_branch_->offset;
+
+  // Check that vI, ..., vI + factor - 1 are all below the bound. A negative vT means that vI
+  // is negative or that vI + factor - 1 overflows; the original loop handles both.
+  MIR* last_index = NewMIR(Instruction::ADD_INT_LIT8, temp_vreg, iv_vreg_, factor_ - 1u, offset);
+  BasicBlock* first_check = NewCheckBlock(nullptr, last_index,
+                                          NewMIR(Instruction::IF_LTZ, temp_vreg, 0u, 0u, offset));
+  BasicBlock* check;
+  if (bound_vreg_ >= 0) {
+    check = NewCheckBlock(first_check, nullptr,
+                          NewMIR(Instruction::IF_GE, temp_vreg, bound_vreg_, 0u, offset));
+  } else {
+    // A null array makes the array-length of the original loop head throw.
+    check = NewCheckBlock(first_check, nullptr,
+                          NewMIR(Instruction::IF_EQZ, bound_array_vreg_, 0u, 0u, offset));
+    MIR* length = NewMIR(Instruction::ARRAY_LENGTH, length_vreg, bound_array_vreg_, 0u, offset);
+    length->optimization_flags |= MIR_IGNORE_NULL_CHECK;
+    check = NewCheckBlock(check, length,
+                          NewMIR(Instruction::IF_GE, temp_vreg, length_vreg, 0u, offset));
+  }
+
+  // The copies of the body follow each other in a single block. Only its back edge suspends.
+  BasicBlock* unrolled_body = mir_graph_->CreateNewBB(kDalvikByteCode);
+  unrolled_body->start_offset = body_->start_offset;
+  unrolled_body->nesting_depth = body_->nesting_depth;
+  for (size_t i = 0u; i != factor_; ++i) {
+    for (MIR* mir = body_->first_mir_insn; mir != body_->last_mir_insn; mir = mir->next) {
+      unrolled_body->AppendMIR(mir->Copy(mir_graph_));
+    }
+  }
+  unrolled_body->AppendMIR(body_->last_mir_insn->Copy(mir_graph_));
+  unrolled_body->taken = first_check->id;
+  check->fall_through = unrolled_body->id;
+  unrolled_body->predecessors->Insert(check->id);
+  first_check->predecessors->Insert(unrolled_body->id);
+
+  // Enter the unrolled loop instead of the original loop.
+  preheader_->ReplaceChild(head_->id, first_check->id);
+  head_->predecessors->Delete(preheader_->id);
+  first_check->predecessors->Insert(preheader_->id);
+}
+
+bool MIRGraph::UnrollLoopsGate() {
+  if ((cu_->disable_opt & (1 << kLoopUnrolling)) != 0 ||
+      cu_->compiler_driver == nullptr ||
+      GetNumDalvikInsns() > kMaxUnrolledMethodSize ||
+      GetNumAvailableVRTemps() < 2u) {
+    return false;
+  }
+  // Unrolling trades code size for speed.
+  CompilerOptions::CompilerFilter compiler_filter =
+      cu_->compiler_driver->GetCompilerOptions().GetCompilerFilter();
+  return compiler_filter == CompilerOptions::kSpeed ||
+      compiler_filter == CompilerOptions::kEverything;
+}
+
+bool MIRGraph::UnrollLoops() {
+  ScopedArenaAllocator allocator(&cu_->arena_stack);
+  int temp_vreg = -1;
+  int length_vreg = -1;
+  size_t added_size = 0u;
+  bool changed = false;
+  GrowableArray<BasicBlockId>* order = GetTopologicalSortOrder();
+  GrowableArray<BasicBlockId>* loop_ends = GetTopologicalSortOrderLoopEnds();
+  for (size_t idx = 0; idx + 1u < order->Size(); idx++) {
+    // Only loops made of the head and a single body block.
+    if (loop_ends->Get(idx) != idx + 2u) {
+      continue;
+    }
+    BasicBlock* head = GetBasicBlock(order->Get(idx));
+    BasicBlock* body = GetBasicBlock(order->Get(idx + 1u));
+    LoopUnroller unroller(this, &allocator);
+    if (!unroller.Prepare(head, body) ||
+        added_size + unroller.AddedSize() > kMaxUnrolledMIRsPerMethod) {
+      continue;
+    }
+    if (temp_vreg < 0) {
+      if (GetNumAvailableVRTemps() < 2u) {
+        break;
+      }
+      // The scratch registers of the checks are shared by all loops.
+      temp_vreg = GetNewCompilerTemp(kCompilerTempVR, false)->v_reg;
+      length_vreg = GetNewCompilerTemp(kCompilerTempVR, false)->v_reg;
+    }
+    unroller.Transform(temp_vreg, length_vreg);
+    added_size += unroller.AddedSize();
+    changed = true;
+    if (cu_->verbose) {
+      LOG(INFO) << "Unrolled loop at 0x" << std::hex << head->start_offset << " by "
+                << std::dec << unroller.Factor() << " in "
+                << PrettyMethod(cu_->method_idx, *cu_->dex_file);
+    }
+  }
+  return changed;
+}
+
+}  // namespace art
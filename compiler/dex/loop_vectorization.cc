@@ -0,0 +1,977 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+
+#include "backend.h"
+#include "compiler_internals.h"
+#include "utils/scoped_arena_containers.h"
+
+namespace art {
+
+/*
+ * Loop vectorization.
+ *
+ * A counted loop made of a head block H and a single body block B, such as
+ *
+ *   H: phis; [array-length vN, vArr]; if-ge vI, vN -> exit
+ *   B: <elementwise work on a[vI], b[vI], ...>; add-int/lit8 vI, vI, #1; goto H
+ *
+ * is given a vector version of its body that processes as many elements per iteration as fit
+ * into a 128-bit vector register. The vector loop runs in front of the original loop, which is
+ * kept unchanged as the remainder loop:
+ *
+ *   P -> C0: if-ltz vI -> H
+ *        C1: add-int/lit8 vT, vI, #(lanes - 1); if-ltz vT -> H
+ *        C2: if-ge vT, vN -> H                            (bound is a plain register)
+ *        for each array: if-eqz vArr -> H; array-length vL, vArr; if-ge vT, vL -> H
+ *        VB: <packed MIRs>; add-int/lit8 vI, vI, #lanes; goto C0
+ *
+ * All array accesses of the body are at index vI, so the iterations are independent and running
+ * "lanes" of them at once is the same as running them one after the other. The checks make sure
+ * that none of these iterations would throw or leave the loop. When any of them fails, the
+ * remaining iterations run in the original loop, which raises exceptions exactly as before.
+ *
+ * Vector values never live across blocks. The only loop-carried values besides vI are int sum
+ * reductions, which are added to their virtual register at the end of every vector iteration,
+ * so that the suspend check on the back edge sees the same state as in the scalar loop.
+ *
+ * Narrow lanes (char, short, byte and boolean arrays) are only used with operations whose low
+ * bits do not depend on the high bits of their operands, since the scalar code computes them on
+ * sign or zero extended ints.
+ */
+
+// Size of the vector registers, in bits.
+static constexpr int kVectorBits = 128;
+
+// Loops with a larger body are not vectorized.
+static constexpr size_t kMaxVectorizedBodySize = 32u;
+
+// Returns the size of the elements accessed by a vectorizable AGET or APUT, or 0.
+static size_t ArrayAccessWidth(Instruction::Code opcode) {
+  switch (opcode) {
+    case Instruction::AGET:
+    case Instruction::APUT:
+      return 4u;
+    case Instruction::AGET_CHAR:
+    case Instruction::AGET_SHORT:
+    case Instruction::APUT_CHAR:
+    case Instruction::APUT_SHORT:
+      return 2u;
+    case Instruction::AGET_BYTE:
+    case Instruction::AGET_BOOLEAN:
+    case Instruction::APUT_BYTE:
+    case Instruction::APUT_BOOLEAN:
+      return 1u;
+    default:
+      return 0u;
+  }
+}
+
+// Returns the operand size of a packed array access replacing an AGET or APUT.
+static OpSize ArrayAccessOpSize(Instruction::Code opcode) {
+  switch (opcode) {
+    case Instruction::AGET_CHAR:
+    case Instruction::APUT_CHAR:
+      return kUnsignedHalf;
+    case Instruction::AGET_SHORT:
+    case Instruction::APUT_SHORT:
+      return kSignedHalf;
+    case Instruction::AGET_BYTE:
+    case Instruction::APUT_BYTE:
+      return kSignedByte;
+    case Instruction::AGET_BOOLEAN:
+    case Instruction::APUT_BOOLEAN:
+      return kUnsignedByte;
+    default:
+      return k32;
+  }
+}
+
+static bool IsArrayPut(Instruction::Code opcode) {
+  return opcode >= Instruction::APUT && opcode <= Instruction::APUT_SHORT;
+}
+
+static bool IsGoto(Instruction::Code opcode) {
+  return opcode == Instruction::GOTO || opcode == Instruction::GOTO_16 ||
+      opcode == Instruction::GOTO_32;
+}
+
+static uint32_t VectorTypeSize(OpSize opsize) {
+  return (static_cast<uint32_t>(opsize) << 16) | kVectorBits;
+}
+
+// How an arithmetic instruction of the loop body maps to a packed operation.
+struct VectorOpInfo {
+  enum Kind {
+    kBinary,      // vA = vB op vC, vA = vA op vB (2addr) or vA = vB op #lit.
+    kReverse,     // vA = #lit - vB.
+    kShift,       // vA = vB << #lit.
+    kTruncate,    // vA = (narrow) vB, a plain copy when the lanes have the narrow width.
+  };
+  Kind kind;
+  int packed_opcode;
+  bool commutative;
+  bool is_float;
+  bool has_literal;
+  // For kTruncate, the lane width the conversion is a copy for.
+  size_t truncate_width;
+};
+
+static bool GetVectorOpInfo(Instruction::Code opcode, VectorOpInfo* info) {
+  info->kind = VectorOpInfo::kBinary;
+  info->commutative = true;
+  info->is_float = false;
+  info->has_literal = false;
+  info->truncate_width = 0u;
+  switch (opcode) {
+    case Instruction::ADD_INT_LIT16:
+    case Instruction::ADD_INT_LIT8:
+      info->has_literal = true;
+      // Intentional fall-through.
+    case Instruction::ADD_INT:
+    case Instruction::ADD_INT_2ADDR:
+      info->packed_opcode = kMirOpPackedAddition;
+      return true;
+    case Instruction::SUB_INT:
+    case Instruction::SUB_INT_2ADDR:
+      info->packed_opcode = kMirOpPackedSubtract;
+      info->commutative = false;
+      return true;
+    case Instruction::RSUB_INT:
+    case Instruction::RSUB_INT_LIT8:
+      info->kind = VectorOpInfo::kReverse;
+      info->packed_opcode = kMirOpPackedSubtract;
+      info->commutative = false;
+      info->has_literal = true;
+      return true;
+    case Instruction::MUL_INT_LIT16:
+    case Instruction::MUL_INT_LIT8:
+      info->has_literal = true;
+      // Intentional fall-through.
+    case Instruction::MUL_INT:
+    case Instruction::MUL_INT_2ADDR:
+      info->packed_opcode = kMirOpPackedMultiply;
+      return true;
+    case Instruction::AND_INT_LIT16:
+    case Instruction::AND_INT_LIT8:
+      info->has_literal = true;
+      // Intentional fall-through.
+    case Instruction::AND_INT:
+    case Instruction::AND_INT_2ADDR:
+      info->packed_opcode = kMirOpPackedAnd;
+      return true;
+    case Instruction::OR_INT_LIT16:
+    case Instruction::OR_INT_LIT8:
+      info->has_literal = true;
+      // Intentional fall-through.
+    case Instruction::OR_INT:
+    case Instruction::OR_INT_2ADDR:
+      info->packed_opcode = kMirOpPackedOr;
+      return true;
+    case Instruction::XOR_INT_LIT16:
+    case Instruction::XOR_INT_LIT8:
+      info->has_literal = true;
+      // Intentional fall-through.
+    case Instruction::XOR_INT:
+    case Instruction::XOR_INT_2ADDR:
+      info->packed_opcode = kMirOpPackedXor;
+      return true;
+    case Instruction::SHL_INT_LIT8:
+      info->kind = VectorOpInfo::kShift;
+      info->packed_opcode = kMirOpPackedShiftLeft;
+      info->commutative = false;
+      info->has_literal = true;
+      return true;
+    case Instruction::ADD_FLOAT:
+    case Instruction::ADD_FLOAT_2ADDR:
+      info->packed_opcode = kMirOpPackedAddition;
+      info->is_float = true;
+      return true;
+    case Instruction::SUB_FLOAT:
+    case Instruction::SUB_FLOAT_2ADDR:
+      info->packed_opcode = kMirOpPackedSubtract;
+      info->commutative = false;
+      info->is_float = true;
+      return true;
+    case Instruction::MUL_FLOAT:
+    case Instruction::MUL_FLOAT_2ADDR:
+      info->packed_opcode = kMirOpPackedMultiply;
+      info->is_float = true;
+      return true;
+    case Instruction::INT_TO_BYTE:
+      info->kind = VectorOpInfo::kTruncate;
+      info->packed_opcode = kMirOpMoveVector;
+      info->truncate_width = 1u;
+      return true;
+    case Instruction::INT_TO_CHAR:
+    case Instruction::INT_TO_SHORT:
+      info->kind = VectorOpInfo::kTruncate;
+      info->packed_opcode = kMirOpMoveVector;
+      info->truncate_width = 2u;
+      return true;
+    default:
+      return false;
+  }
+}
+
+class LoopVectorizer {
+ public:
+  LoopVectorizer(MIRGraph* mir_graph, ScopedArenaAllocator* allocator, int max_vector_regs)
+      : mir_graph_(mir_graph),
+        max_vector_regs_(max_vector_regs),
+        head_(nullptr),
+        body_(nullptr),
+        preheader_(nullptr),
+        exit_(NullBasicBlockId),
+        head_branch_(nullptr),
+        increment_(nullptr),
+        iv_vreg_(-1),
+        iv_sreg_(INVALID_SREG),
+        bound_vreg_(-1),
+        bound_array_vreg_(-1),
+        width_(0u),
+        defined_in_loop_(mir_graph->GetNumOfCodeAndTempVRs(), false, allocator->Adapter()),
+        arrays_(allocator->Adapter()),
+        reduction_sregs_(std::less<int>(), allocator->Adapter()),
+        remaining_uses_(std::less<int>(), allocator->Adapter()),
+        vector_regs_(std::less<int>(), allocator->Adapter()),
+        vector_reg_in_use_(max_vector_regs, false, allocator->Adapter()),
+        num_vector_regs_used_(0),
+        vector_insns_(allocator->Adapter()) {
+  }
+
+  // Checks that the loop made of "head" and "body" can be vectorized and generates its vector
+  // body. Returns false if the loop cannot be vectorized; the graph is not modified either way.
+  bool Prepare(BasicBlock* head, BasicBlock* body);
+
+  // Inserts the checks and the vector loop in front of the loop head. "temp_vreg" and
+  // "length_vreg" are scratch virtual registers.
+  void Transform(int temp_vreg, int length_vreg);
+
+ private:
+  // An operand of a packed operation: an SSA register or a literal.
+  struct Operand {
+    bool is_literal;
+    int32_t value;
+  };
+
+  static Operand SRegOperand(int s_reg) {
+    Operand operand = { false, s_reg };
+    return operand;
+  }
+
+  static Operand LiteralOperand(int32_t literal) {
+    Operand operand = { true, literal };
+    return operand;
+  }
+
+  bool IsInvariant(int s_reg) const {
+    return !defined_in_loop_[mir_graph_->SRegToVReg(s_reg)];
+  }
+
+  size_t Lanes() const {
+    return kVectorBits / 8u / width_;
+  }
+
+  OpSize LaneOpSize(bool is_float) const {
+    switch (width_) {
+      case 4u:
+        return is_float ? kSingle : k32;
+      case 2u:
+        return kSignedHalf;
+      default:
+        return kSignedByte;
+    }
+  }
+
+  bool MatchLoop();
+  bool MatchBody();
+  bool CheckValueOperand(int s_reg);
+  bool SetWidth(size_t width);
+  bool IsReduction(MIR* mir, int* sum_use_index);
+  bool GenerateVectorBody();
+  bool GenerateInsn(MIR* mir);
+
+  MIR* NewMIR(int opcode, uint32_t v_a, uint32_t v_b, uint32_t v_c, NarrowDexOffset offset);
+  MIR* AppendVectorInsn(int opcode, uint32_t v_a, uint32_t v_b, uint32_t v_c,
+                        NarrowDexOffset offset);
+  int AllocVectorReg();
+  void FreeVectorReg(int reg);
+  int Materialize(Operand operand, NarrowDexOffset offset);
+  bool IsDead(Operand operand) const;
+  void ConsumeUse(Operand operand);
+  void Release(Operand operand, int reg);
+  int TakeForWrite(Operand operand, int reg, NarrowDexOffset offset);
+  void Bind(int s_reg, int reg);
+  BasicBlock* NewCheckBlock(BasicBlock* pred, MIR* first, MIR* branch);
+
+  MIRGraph* const mir_graph_;
+  const int max_vector_regs_;
+
+  BasicBlock* head_;
+  BasicBlock* body_;
+  BasicBlock* preheader_;
+  BasicBlockId exit_;
+  MIR* head_branch_;
+  MIR* increment_;
+  int iv_vreg_;
+  // The value of the induction variable in the body, defined by its phi in the head.
+  int iv_sreg_;
+  // The loop bound is either a register or the length of an array.
+  int bound_vreg_;
+  int bound_array_vreg_;
+  // Size of the array elements, and thus of the vector lanes.
+  size_t width_;
+
+  ScopedArenaVector<bool> defined_in_loop_;
+  ScopedArenaVector<int> arrays_;
+  // Phi definitions of the sum registers of int add reductions.
+  ScopedArenaSet<int> reduction_sregs_;
+  // Number of value operand uses in the body not yet translated, by SSA register.
+  ScopedArenaSafeMap<int, uint32_t> remaining_uses_;
+  // Vector register holding the value of an SSA register.
+  ScopedArenaSafeMap<int, int> vector_regs_;
+  ScopedArenaVector<bool> vector_reg_in_use_;
+  int num_vector_regs_used_;
+  ScopedArenaVector<MIR*> vector_insns_;
+};
+
+bool LoopVectorizer::Prepare(BasicBlock* head, BasicBlock* body) {
+  head_ = head;
+  body_ = body;
+  return MatchLoop() && MatchBody() && GenerateVectorBody();
+}
+
+bool LoopVectorizer::MatchLoop() {
+  if (head_->block_type != kDalvikByteCode || body_->block_type != kDalvikByteCode ||
+      head_->catch_entry || body_->catch_entry ||
+      head_->successor_block_list_type != kNotUsed ||
+      body_->successor_block_list_type != kNotUsed) {
+    return false;
+  }
+
+  // The body must be a single block ending with "add-int/lit vI, vI, #1; goto head".
+  MIR* last = body_->last_mir_insn;
+  if (body_->predecessors->Size() != 1u || body_->predecessors->Get(0) != head_->id ||
+      body_->taken != head_->id || body_->fall_through != NullBasicBlockId ||
+      last == nullptr || !IsGoto(last->dalvikInsn.opcode)) {
+    return false;
+  }
+  for (MIR* mir = body_->first_mir_insn; mir != last; mir = mir->next) {
+    if (mir->next == last) {
+      increment_ = mir;
+    }
+  }
+  if (increment_ == nullptr ||
+      (increment_->dalvikInsn.opcode != Instruction::ADD_INT_LIT8 &&
+       increment_->dalvikInsn.opcode != Instruction::ADD_INT_LIT16) ||
+      increment_->dalvikInsn.vA != increment_->dalvikInsn.vB ||
+      static_cast<int32_t>(increment_->dalvikInsn.vC) != 1) {
+    return false;
+  }
+  iv_vreg_ = increment_->dalvikInsn.vA;
+  iv_sreg_ = increment_->ssa_rep->uses[0];
+
+  // The head has the preheader and the body as predecessors.
+  if (head_->predecessors->Size() != 2u) {
+    return false;
+  }
+  BasicBlockId preheader_id = head_->predecessors->Get(0);
+  if (preheader_id == body_->id) {
+    preheader_id = head_->predecessors->Get(1);
+  } else if (head_->predecessors->Get(1) != body_->id) {
+    return false;
+  }
+  preheader_ = mir_graph_->GetBasicBlock(preheader_id);
+
+  // Registers defined in the loop. Phis define nothing new for this purpose.
+  for (BasicBlock* bb : { head_, body_ }) {
+    for (MIR* mir = bb->first_mir_insn; mir != nullptr; mir = mir->next) {
+      if (mir->dalvikInsn.opcode == static_cast<Instruction::Code>(kMirOpPhi)) {
+        continue;
+      }
+      for (int i = 0; i < mir->ssa_rep->num_defs; i++) {
+        defined_in_loop_[mir_graph_->SRegToVReg(mir->ssa_rep->defs[i])] = true;
+      }
+    }
+  }
+
+  // The head holds phis, an optional array-length and the loop condition.
+  MIR* array_length = nullptr;
+  for (MIR* mir = head_->first_mir_insn; mir != nullptr; mir = mir->next) {
+    Instruction::Code opcode = mir->dalvikInsn.opcode;
+    if (opcode == static_cast<Instruction::Code>(kMirOpPhi)) {
+      continue;
+    }
+    if (opcode == Instruction::ARRAY_LENGTH && array_length == nullptr &&
+        mir->next == head_->last_mir_insn) {
+      array_length = mir;
+      continue;
+    }
+    if (mir != head_->last_mir_insn) {
+      return false;
+    }
+    head_branch_ = mir;
+  }
+  if (head_branch_ == nullptr) {
+    return false;
+  }
+  if (head_branch_->dalvikInsn.opcode == Instruction::IF_GE && head_->fall_through == body_->id) {
+    exit_ = head_->taken;
+  } else if (head_branch_->dalvikInsn.opcode == Instruction::IF_LT &&
+             head_->taken == body_->id) {
+    exit_ = head_->fall_through;
+  } else {
+    return false;
+  }
+  if (exit_ == NullBasicBlockId || exit_ == head_->id ||
+      head_branch_->ssa_rep->uses[0] != iv_sreg_) {
+    return false;
+  }
+
+  int bound_sreg = head_branch_->ssa_rep->uses[1];
+  if (array_length != nullptr) {
+    if (array_length->ssa_rep->defs[0] != bound_sreg ||
+        !IsInvariant(array_length->ssa_rep->uses[0])) {
+      return false;
+    }
+    bound_array_vreg_ = array_length->dalvikInsn.vB;
+    arrays_.push_back(bound_array_vreg_);
+  } else {
+    if (!IsInvariant(bound_sreg)) {
+      return false;
+    }
+    bound_vreg_ = head_branch_->dalvikInsn.vB;
+  }
+  return true;
+}
+
+bool LoopVectorizer::SetWidth(size_t width) {
+  if (width_ == 0u) {
+    width_ = width;
+  }
+  return width_ == width;
+}
+
+// A value operand must be an invariant or computed by the body, not the induction variable.
+bool LoopVectorizer::CheckValueOperand(int s_reg) {
+  if (s_reg == iv_sreg_ || reduction_sregs_.find(s_reg) != reduction_sregs_.end()) {
+    return false;
+  }
+  auto it = remaining_uses_.find(s_reg);
+  if (it != remaining_uses_.end()) {
+    ++it->second;
+  } else if (IsInvariant(s_reg)) {
+    remaining_uses_.Put(s_reg, 1u);
+  } else {
+    // Computed in the body, but by an instruction that does not produce a vector value.
+    return false;
+  }
+  return true;
+}
+
+// Returns whether "mir" is "vS = vS + vX" for the sum register of an int add reduction.
+bool LoopVectorizer::IsReduction(MIR* mir, int* sum_use_index) {
+  Instruction::Code opcode = mir->dalvikInsn.opcode;
+  if (opcode != Instruction::ADD_INT && opcode != Instruction::ADD_INT_2ADDR) {
+    return false;
+  }
+  for (int i = 0; i < 2; i++) {
+    if (reduction_sregs_.find(mir->ssa_rep->uses[i]) != reduction_sregs_.end() &&
+        mir_graph_->SRegToVReg(mir->ssa_rep->defs[0]) ==
+            mir_graph_->SRegToVReg(mir->ssa_rep->uses[i])) {
+      *sum_use_index = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool LoopVectorizer::MatchBody() {
+  // Every phi of the head is for the induction variable or the sum of a reduction. A sum
+  // register is defined once in the body, by "vS = vS + vX", and used nowhere else in the loop.
+  // Any other register defined in the body and live around the back edge, such as a temporary
+  // read after the loop, would not be written back by the vector loop.
+  int iv_phis = 0;
+  for (MIR* mir = head_->first_mir_insn; mir != nullptr; mir = mir->next) {
+    if (mir->dalvikInsn.opcode != static_cast<Instruction::Code>(kMirOpPhi)) {
+      continue;
+    }
+    int def = mir->ssa_rep->defs[0];
+    if (def == iv_sreg_) {
+      ++iv_phis;
+    } else {
+      reduction_sregs_.insert(def);
+    }
+  }
+  if (iv_phis != 1) {
+    return false;
+  }
+  for (int sum_sreg : reduction_sregs_) {
+    int sum_vreg = mir_graph_->SRegToVReg(sum_sreg);
+    size_t uses = 0u;
+    size_t defs = 0u;
+    for (BasicBlock* bb : { head_, body_ }) {
+      for (MIR* mir = bb->first_mir_insn; mir != nullptr; mir = mir->next) {
+        if (mir->dalvikInsn.opcode == static_cast<Instruction::Code>(kMirOpPhi)) {
+          continue;
+        }
+        for (int i = 0; i < mir->ssa_rep->num_uses; i++) {
+          if (mir_graph_->SRegToVReg(mir->ssa_rep->uses[i]) == sum_vreg) {
+            ++uses;
+          }
+        }
+        for (int i = 0; i < mir->ssa_rep->num_defs; i++) {
+          if (mir_graph_->SRegToVReg(mir->ssa_rep->defs[i]) == sum_vreg) {
+            ++defs;
+          }
+        }
+      }
+    }
+    if (uses != 1u || defs != 1u) {
+      return false;
+    }
+  }
+
+  size_t size = 0u;
+  size_t num_reductions = 0u;
+  for (MIR* mir = body_->first_mir_insn; mir != increment_; mir = mir->next) {
+    if (++size > kMaxVectorizedBodySize) {
+      return false;
+    }
+    Instruction::Code opcode = mir->dalvikInsn.opcode;
+    if (MIR::DecodedInstruction::IsPseudoMirOp(opcode)) {
+      return false;
+    }
+    SSARepresentation* ssa_rep = mir->ssa_rep;
+    size_t width = ArrayAccessWidth(opcode);
+    if (width != 0u) {
+      // An element at the induction variable of an invariant array.
+      int array_index = IsArrayPut(opcode) ? 1 : 0;
+      if (!SetWidth(width) ||
+          ssa_rep->uses[array_index + 1] != iv_sreg_ ||
+          !IsInvariant(ssa_rep->uses[array_index]) ||
+          (IsArrayPut(opcode) && !CheckValueOperand(ssa_rep->uses[0]))) {
+        return false;
+      }
+      int array_vreg = mir->dalvikInsn.vB;
+      if (std::find(arrays_.begin(), arrays_.end(), array_vreg) == arrays_.end()) {
+        arrays_.push_back(array_vreg);
+      }
+      if (!IsArrayPut(opcode)) {
+        remaining_uses_.Put(ssa_rep->defs[0], 0u);
+      }
+      continue;
+    }
+    int sum_use_index;
+    if (IsReduction(mir, &sum_use_index)) {
+      // The added value must be a vector of ints.
+      int value_sreg = ssa_rep->uses[1 - sum_use_index];
+      if (!SetWidth(4u) || IsInvariant(value_sreg) || !CheckValueOperand(value_sreg)) {
+        return false;
+      }
+      ++num_reductions;
+      continue;
+    }
+    VectorOpInfo info;
+    if (!GetVectorOpInfo(opcode, &info)) {
+      return false;
+    }
+    if (info.is_float && !SetWidth(4u)) {
+      return false;
+    }
+    if (info.kind == VectorOpInfo::kShift &&
+        static_cast<int32_t>(mir->dalvikInsn.vC) < 0) {
+      return false;
+    }
+    bool has_second_operand = !info.has_literal && info.kind != VectorOpInfo::kTruncate;
+    if (!CheckValueOperand(ssa_rep->uses[0]) ||
+        (has_second_operand && !CheckValueOperand(ssa_rep->uses[1]))) {
+      return false;
+    }
+    remaining_uses_.Put(ssa_rep->defs[0], 0u);
+  }
+  if (width_ == 0u) {
+    // No array access.
+    return false;
+  }
+  if (num_reductions != reduction_sregs_.size()) {
+    // The single definition of a phi register is not the add of a reduction.
+    return false;
+  }
+
+  // Checks that depend on the lane width, now that it is known.
+  for (MIR* mir = body_->first_mir_insn; mir != increment_; mir = mir->next) {
+    VectorOpInfo info;
+    if (GetVectorOpInfo(mir->dalvikInsn.opcode, &info)) {
+      if (info.kind == VectorOpInfo::kShift &&
+          static_cast<int32_t>(mir->dalvikInsn.vC) >= static_cast<int32_t>(width_ * 8u)) {
+        return false;
+      }
+      if (info.kind == VectorOpInfo::kTruncate && info.truncate_width != width_) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+MIR* LoopVectorizer::NewMIR(int opcode, uint32_t v_a, uint32_t v_b, uint32_t v_c,
+                            NarrowDexOffset offset) {
+  MIR* mir = mir_graph_->NewMIR();
+  mir->dalvikInsn.opcode = static_cast<Instruction::Code>(opcode);
+  mir->dalvikInsn.vA = v_a;
+  mir->dalvikInsn.vB = v_b;
+  mir->dalvikInsn.vC = v_c;
+  mir->offset = offset;
+  return mir;
+}
+
+MIR* LoopVectorizer::AppendVectorInsn(int opcode, uint32_t v_a, uint32_t v_b, uint32_t v_c,
+                                      NarrowDexOffset offset) {
+  MIR* mir = NewMIR(opcode, v_a, v_b, v_c, offset);
+  vector_insns_.push_back(mir);
+  return mir;
+}
+
+int LoopVectorizer::AllocVectorReg() {
+  for (int reg = 0; reg < max_vector_regs_; reg++) {
+    if (!vector_reg_in_use_[reg]) {
+      vector_reg_in_use_[reg] = true;
+      num_vector_regs_used_ = std::max(num_vector_regs_used_, reg + 1);
+      return reg;
+    }
+  }
+  return -1;
+}
+
+void LoopVectorizer::FreeVectorReg(int reg) {
+  DCHECK(vector_reg_in_use_[reg]);
+  vector_reg_in_use_[reg] = false;
+}
+
+// Returns the vector register holding "operand", broadcasting invariants and literals on first
+// use. Returns -1 if no vector register is left.
+int LoopVectorizer::Materialize(Operand operand, NarrowDexOffset offset) {
+  if (!operand.is_literal) {
+    auto it = vector_regs_.find(operand.value);
+    if (it != vector_regs_.end()) {
+      return it->second;
+    }
+  }
+  int reg = AllocVectorReg();
+  if (reg < 0) {
+    return -1;
+  }
+  if (operand.is_literal) {
+    uint32_t lane_value = static_cast<uint32_t>(operand.value);
+    if (width_ == 2u) {
+      lane_value = (lane_value & 0xffffu) * 0x00010001u;
+    } else if (width_ == 1u) {
+      lane_value = (lane_value & 0xffu) * 0x01010101u;
+    }
+    MIR* mir = AppendVectorInsn(kMirOpConstVector, reg, kVectorBits, 0u, offset);
+    for (size_t i = 0; i < 4u; i++) {
+      mir->dalvikInsn.arg[i] = lane_value;
+    }
+  } else {
+    DCHECK(IsInvariant(operand.value));
+    AppendVectorInsn(kMirOpPackedSet, reg, mir_graph_->SRegToVReg(operand.value),
+                     VectorTypeSize(LaneOpSize(false)), offset);
+    vector_regs_.Put(operand.value, reg);
+  }
+  return reg;
+}
+
+bool LoopVectorizer::IsDead(Operand operand) const {
+  return operand.is_literal || remaining_uses_.Get(operand.value) == 0u;
+}
+
+void LoopVectorizer::ConsumeUse(Operand operand) {
+  if (!operand.is_literal) {
+    auto it = remaining_uses_.find(operand.value);
+    DCHECK(it != remaining_uses_.end());
+    DCHECK_NE(it->second, 0u);
+    --it->second;
+  }
+}
+
+// Frees the vector register of an operand that has no uses left.
+void LoopVectorizer::Release(Operand operand, int reg) {
+  if (IsDead(operand)) {
+    if (!operand.is_literal) {
+      vector_regs_.erase(operand.value);
+    }
+    FreeVectorReg(reg);
+  }
+}
+
+// Returns a vector register that holds the value of "operand" and may be overwritten: its own
+// register if the operand has no uses left, a copy otherwise. Returns -1 if no register is left.
+int LoopVectorizer::TakeForWrite(Operand operand, int reg, NarrowDexOffset offset) {
+  if (IsDead(operand)) {
+    if (!operand.is_literal) {
+      vector_regs_.erase(operand.value);
+    }
+    return reg;
+  }
+  int copy = AllocVectorReg();
+  if (copy >= 0) {
+    AppendVectorInsn(kMirOpMoveVector, copy, reg, VectorTypeSize(LaneOpSize(false)), offset);
+  }
+  return copy;
+}
+
+void LoopVectorizer::Bind(int s_reg, int reg) {
+  if (remaining_uses_.Get(s_reg) == 0u) {
+    FreeVectorReg(reg);
+  } else {
+    vector_regs_.Put(s_reg, reg);
+  }
+}
+
+bool LoopVectorizer::GenerateInsn(MIR* mir) {
+  Instruction::Code opcode = mir->dalvikInsn.opcode;
+  SSARepresentation* ssa_rep = mir->ssa_rep;
+  NarrowDexOffset offset = mir->offset;
+
+  if (ArrayAccessWidth(opcode) != 0u) {
+    uint32_t access_type_size = VectorTypeSize(ArrayAccessOpSize(opcode));
+    MIR* access;
+    int reg;
+    if (IsArrayPut(opcode)) {
+      Operand value = SRegOperand(ssa_rep->uses[0]);
+      reg = Materialize(value, offset);
+      if (reg < 0) {
+        return false;
+      }
+      ConsumeUse(value);
+      access = AppendVectorInsn(kMirOpPackedArrayPut, reg, mir->dalvikInsn.vB, iv_vreg_, offset);
+      Release(value, reg);
+    } else {
+      reg = AllocVectorReg();
+      if (reg < 0) {
+        return false;
+      }
+      access = AppendVectorInsn(kMirOpPackedArrayGet, reg, mir->dalvikInsn.vB, iv_vreg_, offset);
+      Bind(ssa_rep->defs[0], reg);
+    }
+    access->dalvikInsn.arg[0] = access_type_size;
+    // The checks in front of the vector loop guarantee that the accesses are in bounds.
+    access->optimization_flags |= MIR_IGNORE_NULL_CHECK | MIR_IGNORE_RANGE_CHECK;
+    return true;
+  }
+
+  int sum_use_index;
+  if (IsReduction(mir, &sum_use_index)) {
+    Operand value = SRegOperand(ssa_rep->uses[1 - sum_use_index]);
+    int reg = Materialize(value, offset);
+    if (reg < 0) {
+      return false;
+    }
+    ConsumeUse(value);
+    // The horizontal add clobbers its source.
+    reg = TakeForWrite(value, reg, offset);
+    if (reg < 0) {
+      return false;
+    }
+    AppendVectorInsn(kMirOpPackedAddReduce, mir->dalvikInsn.vA, reg, VectorTypeSize(k32),
+                     offset);
+    FreeVectorReg(reg);
+    return true;
+  }
+
+  VectorOpInfo info;
+  bool success = GetVectorOpInfo(opcode, &info);
+  DCHECK(success);
+  OpSize opsize = LaneOpSize(info.is_float);
+  Operand lhs = SRegOperand(ssa_rep->uses[0]);
+  int lhs_reg = Materialize(lhs, offset);
+  if (lhs_reg < 0) {
+    return false;
+  }
+  if (info.kind == VectorOpInfo::kTruncate || info.kind == VectorOpInfo::kShift) {
+    ConsumeUse(lhs);
+    int dest_reg = TakeForWrite(lhs, lhs_reg, offset);
+    if (dest_reg < 0) {
+      return false;
+    }
+    if (info.kind == VectorOpInfo::kShift) {
+      AppendVectorInsn(info.packed_opcode, dest_reg, mir->dalvikInsn.vC, VectorTypeSize(opsize),
+                       offset);
+    }
+    Bind(ssa_rep->defs[0], dest_reg);
+    return true;
+  }
+
+  Operand rhs = info.has_literal ? LiteralOperand(static_cast<int32_t>(mir->dalvikInsn.vC))
+                                 : SRegOperand(ssa_rep->uses[1]);
+  int rhs_reg = Materialize(rhs, offset);
+  if (rhs_reg < 0) {
+    return false;
+  }
+  if (info.kind == VectorOpInfo::kReverse) {
+    std::swap(lhs, rhs);
+    std::swap(lhs_reg, rhs_reg);
+  }
+  ConsumeUse(lhs);
+  ConsumeUse(rhs);
+  if (info.commutative && !IsDead(lhs) && IsDead(rhs)) {
+    std::swap(lhs, rhs);
+    std::swap(lhs_reg, rhs_reg);
+  }
+  int dest_reg = TakeForWrite(lhs, lhs_reg, offset);
+  if (dest_reg < 0) {
+    return false;
+  }
+  AppendVectorInsn(info.packed_opcode, dest_reg, rhs_reg, VectorTypeSize(opsize), offset);
+  if (rhs_reg != dest_reg) {
+    Release(rhs, rhs_reg);
+  }
+  Bind(ssa_rep->defs[0], dest_reg);
+  return true;
+}
+
+bool LoopVectorizer::GenerateVectorBody() {
+  NarrowDexOffset start_offset = body_->first_mir_insn->offset;
+  for (MIR* mir = body_->first_mir_insn; mir != increment_; mir = mir->next) {
+    if (!GenerateInsn(mir)) {
+      return false;
+    }
+  }
+  DCHECK(vector_regs_.empty());
+  DCHECK_NE(num_vector_regs_used_, 0);
+
+  MIR* reserve = NewMIR(kMirOpReserveVectorRegisters, 0u, num_vector_regs_used_ - 1, 0u,
+                        start_offset);
+  vector_insns_.insert(vector_insns_.begin(), reserve);
+  AppendVectorInsn(kMirOpReturnVectorRegisters, 0u, num_vector_regs_used_ - 1, 0u,
+                   increment_->offset);
+  AppendVectorInsn(Instruction::ADD_INT_LIT8, iv_vreg_, iv_vreg_, Lanes(), increment_->offset);
+  AppendVectorInsn(Instruction::GOTO, 0u, 0u, 0u, body_->last_mir_insn->offset);
+  return true;
+}
+
+// Appends a block holding "first" (if any) and the check "branch" to the chain after "pred".
+// A failed check continues in the loop head.
+BasicBlock* LoopVectorizer::NewCheckBlock(BasicBlock* pred, MIR* first, MIR* branch) {
+  BasicBlock* bb = mir_graph_->CreateNewBB(kDalvikByteCode);
+  bb->start_offset = head_->start_offset;
+  bb->nesting_depth = body_->nesting_depth;
+  if (first != nullptr) {
+    bb->AppendMIR(first);
+  }
+  // The checks branch back to the loop head but must not suspend, the scalar loop does.
+  branch->optimization_flags |= MIR_IGNORE_SUSPEND_CHECK;
+  bb->AppendMIR(branch);
+  bb->taken = head_->id;
+  bb->conditional_branch = true;
+  head_->predecessors->Insert(bb->id);
+  if (pred != nullptr) {
+    pred->fall_through = bb->id;
+    bb->predecessors->Insert(pred->id);
+  }
+  return bb;
+}
+
+void LoopVectorizer::Transform(int temp_vreg, int length_vreg) {
+  NarrowDexOffset offset = head_branch_->offset;
+  int32_t lanes = Lanes();
+
+  // Check that vI, ..., vI + lanes - 1 are valid indexes below the bound.
+  BasicBlock* first_check =
+      NewCheckBlock(nullptr, nullptr, NewMIR(Instruction::IF_LTZ, iv_vreg_, 0u, 0u, offset));
+  MIR* last_index = NewMIR(Instruction::ADD_INT_LIT8, temp_vreg, iv_vreg_, lanes - 1, offset);
+  BasicBlock* check = NewCheckBlock(first_check, last_index,
+                                    NewMIR(Instruction::IF_LTZ, temp_vreg, 0u, 0u, offset));
+  if (bound_vreg_ >= 0) {
+    check = NewCheckBlock(check, nullptr,
+                          NewMIR(Instruction::IF_GE, temp_vreg, bound_vreg_, 0u, offset));
+  }
+  for (int array_vreg : arrays_) {
+    check = NewCheckBlock(check, nullptr,
+                          NewMIR(Instruction::IF_EQZ, array_vreg, 0u, 0u, offset));
+    MIR* length = NewMIR(Instruction::ARRAY_LENGTH, length_vreg, array_vreg, 0u, offset);
+    length->optimization_flags |= MIR_IGNORE_NULL_CHECK;
+    check = NewCheckBlock(check, length,
+                          NewMIR(Instruction::IF_GE, temp_vreg, length_vreg, 0u, offset));
+  }
+
+  BasicBlock* vector_body = mir_graph_->CreateNewBB(kDalvikByteCode);
+  vector_body->start_offset = body_->start_offset;
+  vector_body->nesting_depth = body_->nesting_depth;
+  for (MIR* mir : vector_insns_) {
+    vector_body->AppendMIR(mir);
+  }
+  vector_body->taken = first_check->id;
+  check->fall_through = vector_body->id;
+  vector_body->predecessors->Insert(check->id);
+  first_check->predecessors->Insert(vector_body->id);
+
+  // Enter the vector loop instead of the scalar loop.
+  preheader_->ReplaceChild(head_->id, first_check->id);
+  head_->predecessors->Delete(preheader_->id);
+  first_check->predecessors->Insert(preheader_->id);
+}
+
+bool MIRGraph::VectorizeLoopsGate() {
+  if ((cu_->disable_opt & (1 << kLoopVectorization)) != 0 ||
+      (merged_df_flags_ & DF_HAS_RANGE_CHKS) == 0 ||
+      cu_->cg == nullptr ||
+      cu_->cg->VectorRegisterSize() != kVectorBits ||
+      cu_->cg->NumReservableVectorRegisters(true) <= 0 ||
+      GetNumAvailableVRTemps() < 2u) {
+    return false;
+  }
+  return true;
+}
+
+bool MIRGraph::VectorizeLoops() {
+  ScopedArenaAllocator allocator(&cu_->arena_stack);
+  int max_vector_regs = cu_->cg->NumReservableVectorRegisters(true);
+  int temp_vreg = -1;
+  int length_vreg = -1;
+  bool changed = false;
+  GrowableArray<BasicBlockId>* order = GetTopologicalSortOrder();
+  GrowableArray<BasicBlockId>* loop_ends = GetTopologicalSortOrderLoopEnds();
+  for (size_t idx = 0; idx + 1u < order->Size(); idx++) {
+    // Only loops made of the head and a single body block.
+    if (loop_ends->Get(idx) != idx + 2u) {
+      continue;
+    }
+    BasicBlock* head = GetBasicBlock(order->Get(idx));
+    BasicBlock* body = GetBasicBlock(order->Get(idx + 1u));
+    LoopVectorizer vectorizer(this, &allocator, max_vector_regs);
+    if (!vectorizer.Prepare(head, body)) {
+      continue;
+    }
+    if (temp_vreg < 0) {
+      // The scratch registers of the checks are shared by all loops.
+      temp_vreg = GetNewCompilerTemp(kCompilerTempVR, false)->v_reg;
+      length_vreg = GetNewCompilerTemp(kCompilerTempVR, false)->v_reg;
+    }
+    vectorizer.Transform(temp_vreg, length_vreg);
+    changed = true;
+    if (cu_->verbose) {
+      LOG(INFO) << "Vectorized loop at 0x" << std::hex << head->start_offset << " of "
+                << PrettyMethod(cu_->method_idx, *cu_->dex_file);
+    }
+  }
+  return changed;
+}
+
+}  // namespace art
@@ -1080,6 +1080,12 @@ class MIRGraph {
   bool ApplyGlobalValueNumberingGate();
   bool ApplyGlobalValueNumbering(BasicBlock* bb);
   void ApplyGlobalValueNumberingEnd();
+  bool VectorizeLoopsGate();
+  bool VectorizeLoops();
+  bool EliminateBoundsChecksGate();
+  bool EliminateBoundsChecks();
+  bool UnrollLoopsGate();
+  bool UnrollLoops();
   /*
    * Type inference handling helpers.  Because Dalvik's bytecode is not fully typed,
    * we have to do some work to figure out the sreg type.  For some operations it is
@@ -1488,6 +1494,7 @@ class MIRGraph {
 
   friend class MirOptimizationTest;
   friend class ClassInitCheckEliminationTest;
+  friend class BoundsCheckEliminationTest;
   friend class GlobalValueNumberingTest;
   friend class LocalValueNumberingTest;
 
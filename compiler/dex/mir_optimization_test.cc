@@ -23,15 +23,8 @@
 
 namespace art {
 
-class ClassInitCheckEliminationTest : public testing::Test {
+class MirOptimizationTest : public testing::Test {
  protected:
-  struct SFieldDef {
-    uint16_t field_idx;
-    uintptr_t declaring_dex_file;
-    uint16_t declaring_class_idx;
-    uint16_t declaring_field_idx;
-  };
-
   struct BBDef {
     static constexpr size_t kMaxSuccessors = 4;
     static constexpr size_t kMaxPredecessors = 4;
@@ -43,12 +36,6 @@ class ClassInitCheckEliminationTest : public testing::Test {
     BasicBlockId predecessors[kMaxPredecessors];
   };
 
-  struct MIRDef {
-    Instruction::Code opcode;
-    BasicBlockId bbid;
-    uint32_t field_or_method_info;
-  };
-
 #define DEF_SUCC0() \
     0u, { }
 #define DEF_SUCC1(s1) \
@@ -72,32 +59,6 @@ class ClassInitCheckEliminationTest : public testing::Test {
 #define DEF_BB(type, succ, pred) \
     { type, succ, pred }
 
-#define DEF_MIR(opcode, bb, field_info) \
-    { opcode, bb, field_info }
-
-  void DoPrepareSFields(const SFieldDef* defs, size_t count) {
-    cu_.mir_graph->sfield_lowering_infos_.Reset();
-    cu_.mir_graph->sfield_lowering_infos_.Resize(count);
-    for (size_t i = 0u; i != count; ++i) {
-      const SFieldDef* def = &defs[i];
-      MirSFieldLoweringInfo field_info(def->field_idx);
-      if (def->declaring_dex_file != 0u) {
-        field_info.declaring_dex_file_ = reinterpret_cast<const DexFile*>(def->declaring_dex_file);
-        field_info.declaring_class_idx_ = def->declaring_class_idx;
-        field_info.declaring_field_idx_ = def->declaring_field_idx;
-        field_info.flags_ = MirSFieldLoweringInfo::kFlagIsStatic;
-      }
-      ASSERT_EQ(def->declaring_dex_file != 0u, field_info.IsResolved());
-      ASSERT_FALSE(field_info.IsInitialized());
-      cu_.mir_graph->sfield_lowering_infos_.Insert(field_info);
-    }
-  }
-
-  template <size_t count>
-  void PrepareSFields(const SFieldDef (&defs)[count]) {
-    DoPrepareSFields(defs, count);
-  }
-
   void DoPrepareBasicBlocks(const BBDef* defs, size_t count) {
     cu_.mir_graph->block_id_map_.clear();
     cu_.mir_graph->block_list_.Reset();
@@ -153,6 +114,63 @@ class ClassInitCheckEliminationTest : public testing::Test {
     DoPrepareBasicBlocks(defs, count);
   }
 
+  MirOptimizationTest()
+      : pool_(),
+        cu_(&pool_),
+        mir_count_(0u),
+        mirs_(nullptr),
+        code_item_(nullptr) {
+    cu_.mir_graph.reset(new MIRGraph(&cu_, &cu_.arena));
+  }
+
+  ArenaPool pool_;
+  CompilationUnit cu_;
+  size_t mir_count_;
+  MIR* mirs_;
+  DexFile::CodeItem* code_item_;
+};
+
+class ClassInitCheckEliminationTest : public MirOptimizationTest {
+ protected:
+  struct SFieldDef {
+    uint16_t field_idx;
+    uintptr_t declaring_dex_file;
+    uint16_t declaring_class_idx;
+    uint16_t declaring_field_idx;
+  };
+
+  struct MIRDef {
+    Instruction::Code opcode;
+    BasicBlockId bbid;
+    uint32_t field_or_method_info;
+  };
+
+#define DEF_MIR(opcode, bb, field_info) \
+    { opcode, bb, field_info }
+
+  void DoPrepareSFields(const SFieldDef* defs, size_t count) {
+    cu_.mir_graph->sfield_lowering_infos_.Reset();
+    cu_.mir_graph->sfield_lowering_infos_.Resize(count);
+    for (size_t i = 0u; i != count; ++i) {
+      const SFieldDef* def = &defs[i];
+      MirSFieldLoweringInfo field_info(def->field_idx);
+      if (def->declaring_dex_file != 0u) {
+        field_info.declaring_dex_file_ = reinterpret_cast<const DexFile*>(def->declaring_dex_file);
+        field_info.declaring_class_idx_ = def->declaring_class_idx;
+        field_info.declaring_field_idx_ = def->declaring_field_idx;
+        field_info.flags_ = MirSFieldLoweringInfo::kFlagIsStatic;
+      }
+      ASSERT_EQ(def->declaring_dex_file != 0u, field_info.IsResolved());
+      ASSERT_FALSE(field_info.IsInitialized());
+      cu_.mir_graph->sfield_lowering_infos_.Insert(field_info);
+    }
+  }
+
+  template <size_t count>
+  void PrepareSFields(const SFieldDef (&defs)[count]) {
+    DoPrepareSFields(defs, count);
+  }
+
   void DoPrepareMIRs(const MIRDef* defs, size_t count) {
     mir_count_ = count;
     mirs_ = reinterpret_cast<MIR*>(cu_.arena.Alloc(sizeof(MIR) * count, kArenaAllocMIR));
@@ -203,20 +221,6 @@ class ClassInitCheckEliminationTest : public testing::Test {
     cu_.mir_graph->EliminateClassInitChecksEnd();
   }
 
-  ClassInitCheckEliminationTest()
-      : pool_(),
-        cu_(&pool_),
-        mir_count_(0u),
-        mirs_(nullptr),
-        code_item_(nullptr) {
-    cu_.mir_graph.reset(new MIRGraph(&cu_, &cu_.arena));
-  }
-
-  ArenaPool pool_;
-  CompilationUnit cu_;
-  size_t mir_count_;
-  MIR* mirs_;
-  DexFile::CodeItem* code_item_;
 };
 
 TEST_F(ClassInitCheckEliminationTest, SingleBlock) {
@@ -423,4 +427,586 @@ TEST_F(ClassInitCheckEliminationTest, Catch) {
   }
 }
 
+class BoundsCheckEliminationTest : public MirOptimizationTest {
+ protected:
+  struct MIRDef {
+    BasicBlockId bbid;
+    Instruction::Code opcode;
+    int32_t value;
+    size_t num_uses;
+    int32_t uses[3];
+    size_t num_defs;
+    int32_t defs[1];
+  };
+
+#define DEF_CONST(bb, reg, value) \
+    { bb, Instruction::CONST, value, 0u, { }, 1u, { reg } }
+#define DEF_ARRAY_LENGTH(bb, reg, array) \
+    { bb, Instruction::ARRAY_LENGTH, 0, 1u, { array }, 1u, { reg } }
+#define DEF_ADD_LIT(bb, reg, src, value) \
+    { bb, Instruction::ADD_INT_LIT8, value, 1u, { src }, 1u, { reg } }
+#define DEF_IF(bb, opcode, src1, src2) \
+    { bb, opcode, 0, 2u, { src1, src2 }, 0u, { } }
+#define DEF_IFZ(bb, opcode, src) \
+    { bb, opcode, 0, 1u, { src }, 0u, { } }
+#define DEF_AGET(bb, reg, array, index) \
+    { bb, Instruction::AGET, 0, 2u, { array, index }, 1u, { reg } }
+#define DEF_APUT(bb, src, array, index) \
+    { bb, Instruction::APUT, 0, 3u, { src, array, index }, 0u, { } }
+#define DEF_PHI2(bb, reg, src1, src2) \
+    { bb, static_cast<Instruction::Code>(kMirOpPhi), 0, 2u, { src1, src2 }, 1u, { reg } }
+#define DEF_GOTO(bb) \
+    { bb, Instruction::GOTO, 0, 0u, { }, 0u, { } }
+
+  void DoPrepareMIRs(const MIRDef* defs, size_t count) {
+    mir_count_ = count;
+    mirs_ = reinterpret_cast<MIR*>(cu_.arena.Alloc(sizeof(MIR) * count, kArenaAllocMIR));
+    ssa_reps_.resize(count);
+    cu_.mir_graph->SetNumSSARegs(kMaxSsaRegs);
+    cu_.mir_graph->is_constant_v_ =
+        new (&cu_.arena) ArenaBitVector(&cu_.arena, kMaxSsaRegs, false, kBitMapMisc);
+    cu_.mir_graph->constant_values_ =
+        static_cast<int*>(cu_.arena.Alloc(sizeof(int) * kMaxSsaRegs, kArenaAllocDFInfo));
+    uint64_t merged_df_flags = 0u;
+    for (size_t i = 0u; i != count; ++i) {
+      const MIRDef* def = &defs[i];
+      MIR* mir = &mirs_[i];
+      ASSERT_LT(def->bbid, cu_.mir_graph->block_list_.Size());
+      BasicBlock* bb = cu_.mir_graph->block_list_.Get(def->bbid);
+      bb->AppendMIR(mir);
+      mir->dalvikInsn.opcode = def->opcode;
+      mir->dalvikInsn.vB = static_cast<int32_t>(def->value);
+      mir->dalvikInsn.vC = static_cast<int32_t>(def->value);
+      if (def->opcode == static_cast<Instruction::Code>(kMirOpPhi)) {
+        mir->meta.phi_incoming = static_cast<BasicBlockId*>(
+            cu_.arena.Alloc(def->num_uses * sizeof(BasicBlockId), kArenaAllocDFInfo));
+        for (size_t j = 0; j != def->num_uses; ++j) {
+          mir->meta.phi_incoming[j] = bb->predecessors->Get(j);
+        }
+      } else if (def->opcode == Instruction::CONST) {
+        cu_.mir_graph->is_constant_v_->SetBit(def->defs[0]);
+        cu_.mir_graph->constant_values_[def->defs[0]] = def->value;
+      }
+      mir->ssa_rep = &ssa_reps_[i];
+      mir->ssa_rep->num_uses = def->num_uses;
+      mir->ssa_rep->uses = const_cast<int32_t*>(def->uses);  // Not modified by BCE.
+      mir->ssa_rep->fp_use = nullptr;
+      mir->ssa_rep->num_defs = def->num_defs;
+      mir->ssa_rep->defs = const_cast<int32_t*>(def->defs);  // Not modified by BCE.
+      mir->ssa_rep->fp_def = nullptr;
+      mir->offset = 2 * i;  // All insns need to be at least 2 code units long.
+      mir->optimization_flags = 0u;
+      merged_df_flags |= MIRGraph::GetDataFlowAttributes(def->opcode);
+    }
+    mirs_[count - 1u].next = nullptr;
+    cu_.mir_graph->merged_df_flags_ = merged_df_flags;
+
+    code_item_ = static_cast<DexFile::CodeItem*>(
+        cu_.arena.Alloc(sizeof(DexFile::CodeItem), kArenaAllocMisc));
+    memset(code_item_, 0, sizeof(DexFile::CodeItem));
+    code_item_->registers_size_ = kNumVRegs;
+    code_item_->insns_size_in_code_units_ = 2u * count;
+    cu_.mir_graph->current_code_item_ = code_item_;
+  }
+
+  template <size_t count>
+  void PrepareMIRs(const MIRDef (&defs)[count]) {
+    DoPrepareMIRs(defs, count);
+  }
+
+  bool PerformBoundsCheckElimination() {
+    cu_.mir_graph->SSATransformationStart();
+    cu_.mir_graph->ComputeDFSOrders();
+    cu_.mir_graph->ComputeDominators();
+    cu_.mir_graph->ComputeTopologicalSortOrder();
+    cu_.mir_graph->SSATransformationEnd();
+    EXPECT_TRUE(cu_.mir_graph->EliminateBoundsChecksGate());
+    return cu_.mir_graph->EliminateBoundsChecks();
+  }
+
+  void ExpectIgnoreRangeCheck(const bool* expected, size_t count) {
+    ASSERT_EQ(count, mir_count_);
+    for (size_t i = 0u; i != count; ++i) {
+      EXPECT_EQ(expected[i], (mirs_[i].optimization_flags & MIR_IGNORE_RANGE_CHECK) != 0) << i;
+    }
+  }
+
+  bool HasPredecessor(BasicBlockId bb_id, BasicBlockId pred_id) {
+    GrowableArray<BasicBlockId>* predecessors = cu_.mir_graph->GetBasicBlock(bb_id)->predecessors;
+    for (size_t i = 0u; i != predecessors->Size(); ++i) {
+      if (predecessors->Get(i) == pred_id) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  BoundsCheckEliminationTest()
+      : MirOptimizationTest(),
+        ssa_reps_() {
+    cu_.access_flags = kAccStatic;  // Don't let "this" interfere with this test.
+    // Each sreg has its own vreg; compiler temps get sregs and vregs past these.
+    cu_.mir_graph->ssa_base_vregs_ = new (&cu_.arena) GrowableArray<int>(&cu_.arena, kMaxSsaRegs);
+    cu_.mir_graph->ssa_subscripts_ = new (&cu_.arena) GrowableArray<int>(&cu_.arena, kMaxSsaRegs);
+    for (unsigned int i = 0; i < kMaxSsaRegs; i++) {
+      cu_.mir_graph->ssa_base_vregs_->Insert(i);
+      cu_.mir_graph->ssa_subscripts_->Insert(0);
+    }
+    cu_.mir_graph->ssa_last_defs_ =
+        static_cast<int*>(cu_.arena.Alloc(sizeof(int) * 2u * kNumVRegs, kArenaAllocDFInfo));
+  }
+
+  static constexpr size_t kMaxSsaRegs = 32u;
+  static constexpr size_t kNumVRegs = kMaxSsaRegs;
+
+  std::vector<SSARepresentation> ssa_reps_;
+};
+
+// A loop of two blocks, the head #4 exits to #6 and enters the body #5 that jumps back.
+#define DEF_LOOP_BBS() \
+    DEF_BB(kNullBlock, DEF_SUCC0(), DEF_PRED0()), \
+    DEF_BB(kEntryBlock, DEF_SUCC1(3), DEF_PRED0()), \
+    DEF_BB(kExitBlock, DEF_SUCC0(), DEF_PRED1(6)), \
+    DEF_BB(kDalvikByteCode, DEF_SUCC1(4), DEF_PRED1(1)), \
+    DEF_BB(kDalvikByteCode, DEF_SUCC2(5, 6), DEF_PRED2(3, 5)), \
+    DEF_BB(kDalvikByteCode, DEF_SUCC1(4), DEF_PRED1(4)), \
+    DEF_BB(kDalvikByteCode, DEF_SUCC1(2), DEF_PRED1(4))
+
+TEST_F(BoundsCheckEliminationTest, IncreasingLoop) {
+  // for (int i = 0; i < a.length; i++) { x = a[i]; y = b[i]; a[i] = y; }
+  static const BBDef bbs[] = {
+      DEF_LOOP_BBS(),
+  };
+  static const MIRDef mirs[] = {
+      DEF_CONST(3u, 2, 0),
+      DEF_PHI2(4u, 3, 2, 8),
+      DEF_ARRAY_LENGTH(4u, 4, 0),
+      DEF_IF(4u, Instruction::IF_GE, 3, 4),
+      DEF_AGET(5u, 5, 0, 3),
+      DEF_AGET(5u, 6, 1, 3),      // Different array, not eliminated.
+      DEF_APUT(5u, 6, 0, 3),
+      DEF_AGET(5u, 7, 0, 2),      // Not indexed by the induction variable.
+      DEF_ADD_LIT(5u, 8, 3, 1),
+      DEF_GOTO(5u),
+  };
+  static const bool expected_ignore_range_check[] = {
+      false, false, false, false, true, false, true, false, false, false
+  };
+
+  PrepareBasicBlocks(bbs);
+  PrepareMIRs(mirs);
+  EXPECT_FALSE(PerformBoundsCheckElimination());  // No compiler temps for loop versioning.
+  ExpectIgnoreRangeCheck(expected_ignore_range_check, arraysize(expected_ignore_range_check));
+}
+
+TEST_F(BoundsCheckEliminationTest, IncreasingLoopReversedCondition) {
+  // for (int i = 0; a.length > i; i++) { x = a[i]; }, with the body on the taken edge.
+  static const BBDef bbs[] = {
+      DEF_BB(kNullBlock, DEF_SUCC0(), DEF_PRED0()),
+      DEF_BB(kEntryBlock, DEF_SUCC1(3), DEF_PRED0()),
+      DEF_BB(kExitBlock, DEF_SUCC0(), DEF_PRED1(6)),
+      DEF_BB(kDalvikByteCode, DEF_SUCC1(4), DEF_PRED1(1)),
+      DEF_BB(kDalvikByteCode, DEF_SUCC2(6, 5), DEF_PRED2(3, 5)),
+      DEF_BB(kDalvikByteCode, DEF_SUCC1(4), DEF_PRED1(4)),
+      DEF_BB(kDalvikByteCode, DEF_SUCC1(2), DEF_PRED1(4)),
+  };
+  static const MIRDef mirs[] = {
+      DEF_CONST(3u, 2, 0),
+      DEF_PHI2(4u, 3, 2, 6),
+      DEF_ARRAY_LENGTH(4u, 4, 0),
+      DEF_IF(4u, Instruction::IF_GT, 4, 3),
+      DEF_AGET(5u, 5, 0, 3),
+      DEF_ADD_LIT(5u, 6, 3, 1),
+      DEF_GOTO(5u),
+  };
+  static const bool expected_ignore_range_check[] = {
+      false, false, false, false, true, false, false
+  };
+
+  PrepareBasicBlocks(bbs);
+  PrepareMIRs(mirs);
+  PerformBoundsCheckElimination();
+  ExpectIgnoreRangeCheck(expected_ignore_range_check, arraysize(expected_ignore_range_check));
+}
+
+TEST_F(BoundsCheckEliminationTest, DecreasingLoop) {
+  // for (int i = a.length - 1; i >= 0; i -= 2) { x = a[i]; y = a[a.length - 1]; }
+  static const BBDef bbs[] = {
+      DEF_LOOP_BBS(),
+  };
+  static const MIRDef mirs[] = {
+      DEF_ARRAY_LENGTH(3u, 2, 0),
+      DEF_ADD_LIT(3u, 3, 2, -1),
+      DEF_PHI2(4u, 4, 3, 7),
+      DEF_IFZ(4u, Instruction::IF_LTZ, 4),
+      DEF_AGET(5u, 5, 0, 4),
+      DEF_AGET(5u, 6, 0, 3),      // Not indexed by the induction variable.
+      DEF_ADD_LIT(5u, 7, 4, -2),
+      DEF_GOTO(5u),
+  };
+  static const bool expected_ignore_range_check[] = {
+      false, false, false, false, true, false, false, false
+  };
+
+  PrepareBasicBlocks(bbs);
+  PrepareMIRs(mirs);
+  EXPECT_FALSE(PerformBoundsCheckElimination());
+  ExpectIgnoreRangeCheck(expected_ignore_range_check, arraysize(expected_ignore_range_check));
+}
+
+TEST_F(BoundsCheckEliminationTest, DecreasingLoopOtherArray) {
+  // for (int i = a.length - 1; i >= 0; i--) { x = b[i]; }
+  static const BBDef bbs[] = {
+      DEF_LOOP_BBS(),
+  };
+  static const MIRDef mirs[] = {
+      DEF_ARRAY_LENGTH(3u, 2, 0),
+      DEF_ADD_LIT(3u, 3, 2, -1),
+      DEF_PHI2(4u, 4, 3, 6),
+      DEF_IFZ(4u, Instruction::IF_LTZ, 4),
+      DEF_AGET(5u, 5, 1, 4),
+      DEF_ADD_LIT(5u, 6, 4, -1),
+      DEF_GOTO(5u),
+  };
+  static const bool expected_ignore_range_check[] = {
+      false, false, false, false, false, false, false
+  };
+
+  PrepareBasicBlocks(bbs);
+  PrepareMIRs(mirs);
+  EXPECT_FALSE(PerformBoundsCheckElimination());
+  ExpectIgnoreRangeCheck(expected_ignore_range_check, arraysize(expected_ignore_range_check));
+}
+
+TEST_F(BoundsCheckEliminationTest, UnknownStart) {
+  // for (int i = start; i < a.length; i++) { x = a[i]; }
+  static const BBDef bbs[] = {
+      DEF_LOOP_BBS(),
+  };
+  static const MIRDef mirs[] = {
+      DEF_PHI2(4u, 3, 2, 6),      // s2 is the incoming "start".
+      DEF_ARRAY_LENGTH(4u, 4, 0),
+      DEF_IF(4u, Instruction::IF_GE, 3, 4),
+      DEF_AGET(5u, 5, 0, 3),
+      DEF_ADD_LIT(5u, 6, 3, 1),
+      DEF_GOTO(5u),
+  };
+  static const bool expected_ignore_range_check[] = {
+      false, false, false, false, false, false
+  };
+
+  PrepareBasicBlocks(bbs);
+  PrepareMIRs(mirs);
+  EXPECT_FALSE(PerformBoundsCheckElimination());
+  ExpectIgnoreRangeCheck(expected_ignore_range_check, arraysize(expected_ignore_range_check));
+}
+
+TEST_F(BoundsCheckEliminationTest, StepTwo) {
+  // for (int i = 0; i < a.length; i += 2) { x = a[i]; }
+  static const BBDef bbs[] = {
+      DEF_LOOP_BBS(),
+  };
+  static const MIRDef mirs[] = {
+      DEF_CONST(3u, 2, 0),
+      DEF_PHI2(4u, 3, 2, 6),
+      DEF_ARRAY_LENGTH(4u, 4, 0),
+      DEF_IF(4u, Instruction::IF_GE, 3, 4),
+      DEF_AGET(5u, 5, 0, 3),
+      DEF_ADD_LIT(5u, 6, 3, 2),
+      DEF_GOTO(5u),
+  };
+  static const bool expected_ignore_range_check[] = {
+      false, false, false, false, false, false, false
+  };
+
+  PrepareBasicBlocks(bbs);
+  PrepareMIRs(mirs);
+  EXPECT_FALSE(PerformBoundsCheckElimination());
+  ExpectIgnoreRangeCheck(expected_ignore_range_check, arraysize(expected_ignore_range_check));
+}
+
+TEST_F(BoundsCheckEliminationTest, AccessBeforeCondition) {
+  // i = 0; do { x = a[i]; i++; } while (i < a.length); the access is not guarded.
+  static const BBDef bbs[] = {
+      DEF_BB(kNullBlock, DEF_SUCC0(), DEF_PRED0()),
+      DEF_BB(kEntryBlock, DEF_SUCC1(3), DEF_PRED0()),
+      DEF_BB(kExitBlock, DEF_SUCC0(), DEF_PRED1(5)),
+      DEF_BB(kDalvikByteCode, DEF_SUCC1(4), DEF_PRED1(1)),
+      DEF_BB(kDalvikByteCode, DEF_SUCC2(5, 4), DEF_PRED2(3, 4)),  // "taken" loops to self.
+      DEF_BB(kDalvikByteCode, DEF_SUCC1(2), DEF_PRED1(4)),
+  };
+  static const MIRDef mirs[] = {
+      DEF_CONST(3u, 2, 0),
+      DEF_PHI2(4u, 3, 2, 5),
+      DEF_AGET(4u, 4, 0, 3),
+      DEF_ADD_LIT(4u, 5, 3, 1),
+      DEF_ARRAY_LENGTH(4u, 6, 0),
+      DEF_IF(4u, Instruction::IF_LT, 5, 6),
+  };
+  static const bool expected_ignore_range_check[] = {
+      false, false, false, false, false, false
+  };
+
+  PrepareBasicBlocks(bbs);
+  PrepareMIRs(mirs);
+  EXPECT_FALSE(PerformBoundsCheckElimination());
+  ExpectIgnoreRangeCheck(expected_ignore_range_check, arraysize(expected_ignore_range_check));
+}
+
+TEST_F(BoundsCheckEliminationTest, VersionedLoop) {
+  // for (int i = start; i < a.length; i++) { b[i] = a[i]; }
+  static const BBDef bbs[] = {
+      DEF_LOOP_BBS(),
+  };
+  static const MIRDef mirs[] = {
+      DEF_PHI2(4u, 3, 2, 6),      // s2 is the incoming "start".
+      DEF_ARRAY_LENGTH(4u, 4, 0),
+      DEF_IF(4u, Instruction::IF_GE, 3, 4),
+      DEF_AGET(5u, 5, 0, 3),
+      DEF_APUT(5u, 5, 1, 3),
+      DEF_ADD_LIT(5u, 6, 3, 1),
+      DEF_GOTO(5u),
+  };
+  static const bool expected_ignore_range_check[] = {
+      false, false, false, false, false, false, false
+  };
+
+  PrepareBasicBlocks(bbs);
+  PrepareMIRs(mirs);
+  ASSERT_TRUE(cu_.mir_graph->SetMaxAvailableNonSpecialCompilerTemps(2u));
+  ASSERT_TRUE(PerformBoundsCheckElimination());
+  // The original loop keeps its checks and runs when any of the hoisted checks fails.
+  ExpectIgnoreRangeCheck(expected_ignore_range_check, arraysize(expected_ignore_range_check));
+
+  // The preheader enters the chain of checks: if-ltz start; if-eqz a; if-eqz b;
+  // if-gt a.length, b.length; each of them branches to the original loop head.
+  const size_t num_original_blocks = arraysize(bbs);
+  ASSERT_EQ(num_original_blocks + 6u, cu_.mir_graph->GetNumBlocks());
+  BasicBlock* check = cu_.mir_graph->GetBasicBlock(cu_.mir_graph->GetBasicBlock(3u)->fall_through);
+  static const Instruction::Code expected_branches[] = {
+      Instruction::IF_LTZ, Instruction::IF_EQZ, Instruction::IF_EQZ, Instruction::IF_GT
+  };
+  for (Instruction::Code opcode : expected_branches) {
+    ASSERT_GE(check->id, num_original_blocks);
+    ASSERT_TRUE(check->last_mir_insn != nullptr);
+    EXPECT_EQ(opcode, check->last_mir_insn->dalvikInsn.opcode);
+    EXPECT_EQ(4u, check->taken);
+    EXPECT_TRUE(HasPredecessor(4u, check->id));
+    check = cu_.mir_graph->GetBasicBlock(check->fall_through);
+  }
+  EXPECT_FALSE(HasPredecessor(4u, 3u));
+
+  // The copy of the loop accesses both arrays without range checks.
+  BasicBlock* head_copy = check;
+  ASSERT_GE(head_copy->id, num_original_blocks);
+  EXPECT_EQ(6u, head_copy->taken);
+  BasicBlock* body_copy = cu_.mir_graph->GetBasicBlock(head_copy->fall_through);
+  ASSERT_GE(body_copy->id, num_original_blocks);
+  EXPECT_EQ(head_copy->id, body_copy->fall_through);
+  size_t num_unchecked_accesses = 0u;
+  for (MIR* mir = body_copy->first_mir_insn; mir != nullptr; mir = mir->next) {
+    if (mir->dalvikInsn.opcode == Instruction::AGET ||
+        mir->dalvikInsn.opcode == Instruction::APUT) {
+      EXPECT_NE(0, mir->optimization_flags & MIR_IGNORE_RANGE_CHECK);
+      num_unchecked_accesses++;
+    }
+  }
+  EXPECT_EQ(2u, num_unchecked_accesses);
+}
+
+TEST_F(BoundsCheckEliminationTest, VersionedLoopWithoutTemps) {
+  // for (int i = start; i < a.length; i++) { b[i] = a[i]; }, no compiler temps left.
+  static const BBDef bbs[] = {
+      DEF_LOOP_BBS(),
+  };
+  static const MIRDef mirs[] = {
+      DEF_PHI2(4u, 3, 2, 6),      // s2 is the incoming "start".
+      DEF_ARRAY_LENGTH(4u, 4, 0),
+      DEF_IF(4u, Instruction::IF_GE, 3, 4),
+      DEF_AGET(5u, 5, 0, 3),
+      DEF_APUT(5u, 5, 1, 3),
+      DEF_ADD_LIT(5u, 6, 3, 1),
+      DEF_GOTO(5u),
+  };
+
+  PrepareBasicBlocks(bbs);
+  PrepareMIRs(mirs);
+  EXPECT_FALSE(PerformBoundsCheckElimination());
+  EXPECT_EQ(arraysize(bbs), cu_.mir_graph->GetNumBlocks());
+}
+
+class LoopUnrollingTest : public BoundsCheckEliminationTest {
+ protected:
+  bool PerformLoopUnrolling() {
+    cu_.mir_graph->SSATransformationStart();
+    cu_.mir_graph->ComputeDFSOrders();
+    cu_.mir_graph->ComputeDominators();
+    cu_.mir_graph->ComputeTopologicalSortOrder();
+    cu_.mir_graph->SSATransformationEnd();
+    // Without a compiler driver there is no compiler filter asking for speed.
+    EXPECT_FALSE(cu_.mir_graph->UnrollLoopsGate());
+    return cu_.mir_graph->UnrollLoops();
+  }
+
+  size_t CountMIRs(BasicBlock* bb, Instruction::Code opcode) {
+    size_t count = 0u;
+    for (MIR* mir = bb->first_mir_insn; mir != nullptr; mir = mir->next) {
+      if (mir->dalvikInsn.opcode == opcode) {
+        count++;
+      }
+    }
+    return count;
+  }
+};
+
+TEST_F(LoopUnrollingTest, UnrolledLoop) {
+  // for (int i = 0; i < a.length; i++) { b[i] = a[i]; }
+  static const BBDef bbs[] = {
+      DEF_LOOP_BBS(),
+  };
+  static const MIRDef mirs[] = {
+      DEF_CONST(3u, 2, 0),
+      DEF_PHI2(4u, 3, 2, 6),
+      DEF_ARRAY_LENGTH(4u, 4, 0),
+      DEF_IF(4u, Instruction::IF_GE, 3, 4),
+      DEF_AGET(5u, 5, 0, 3),
+      DEF_APUT(5u, 5, 1, 3),
+      DEF_ADD_LIT(5u, 6, 3, 1),
+      DEF_GOTO(5u),
+  };
+
+  PrepareBasicBlocks(bbs);
+  PrepareMIRs(mirs);
+  mirs_[4].optimization_flags |= MIR_IGNORE_RANGE_CHECK;  // As if eliminated by BCE.
+  ASSERT_TRUE(cu_.mir_graph->SetMaxAvailableNonSpecialCompilerTemps(2u));
+  ASSERT_TRUE(PerformLoopUnrolling());
+
+  // The preheader enters the chain of checks: if-ltz i + 3; if-eqz a; if-ge i + 3, a.length;
+  // each of them branches to the original loop head.
+  const size_t num_original_blocks = arraysize(bbs);
+  ASSERT_EQ(num_original_blocks + 4u, cu_.mir_graph->GetNumBlocks());
+  BasicBlock* first_check =
+      cu_.mir_graph->GetBasicBlock(cu_.mir_graph->GetBasicBlock(3u)->fall_through);
+  BasicBlock* check = first_check;
+  static const Instruction::Code expected_branches[] = {
+      Instruction::IF_LTZ, Instruction::IF_EQZ, Instruction::IF_GE
+  };
+  for (Instruction::Code opcode : expected_branches) {
+    ASSERT_GE(check->id, num_original_blocks);
+    ASSERT_TRUE(check->last_mir_insn != nullptr);
+    EXPECT_EQ(opcode, check->last_mir_insn->dalvikInsn.opcode);
+    EXPECT_NE(0, check->last_mir_insn->optimization_flags & MIR_IGNORE_SUSPEND_CHECK);
+    EXPECT_EQ(4u, check->taken);
+    EXPECT_TRUE(HasPredecessor(4u, check->id));
+    check = cu_.mir_graph->GetBasicBlock(check->fall_through);
+  }
+  EXPECT_FALSE(HasPredecessor(4u, 3u));
+
+  // The unrolled body holds four copies of the body and a single back edge.
+  BasicBlock* unrolled_body = check;
+  ASSERT_GE(unrolled_body->id, num_original_blocks);
+  EXPECT_EQ(first_check->id, unrolled_body->taken);
+  EXPECT_TRUE(HasPredecessor(first_check->id, unrolled_body->id));
+  EXPECT_EQ(4u, CountMIRs(unrolled_body, Instruction::AGET));
+  EXPECT_EQ(4u, CountMIRs(unrolled_body, Instruction::APUT));
+  EXPECT_EQ(4u, CountMIRs(unrolled_body, Instruction::ADD_INT_LIT8));
+  EXPECT_EQ(1u, CountMIRs(unrolled_body, Instruction::GOTO));
+  EXPECT_EQ(Instruction::GOTO, unrolled_body->last_mir_insn->dalvikInsn.opcode);
+  for (MIR* mir = unrolled_body->first_mir_insn; mir != nullptr; mir = mir->next) {
+    if (mir->dalvikInsn.opcode == Instruction::AGET) {
+      EXPECT_NE(0, mir->optimization_flags & MIR_IGNORE_RANGE_CHECK);
+    } else if (mir->dalvikInsn.opcode == Instruction::APUT) {
+      EXPECT_EQ(0, mir->optimization_flags & MIR_IGNORE_RANGE_CHECK);
+    }
+  }
+}
+
+TEST_F(LoopUnrollingTest, LoopWithCall) {
+  // for (int i = 0; i < a.length; i++) { foo(); }
+  static const BBDef bbs[] = {
+      DEF_LOOP_BBS(),
+  };
+  static const MIRDef mirs[] = {
+      DEF_CONST(3u, 2, 0),
+      DEF_PHI2(4u, 3, 2, 5),
+      DEF_ARRAY_LENGTH(4u, 4, 0),
+      DEF_IF(4u, Instruction::IF_GE, 3, 4),
+      { 5u, Instruction::INVOKE_STATIC, 0, 0u, { }, 0u, { } },
+      DEF_ADD_LIT(5u, 5, 3, 1),
+      DEF_GOTO(5u),
+  };
+
+  PrepareBasicBlocks(bbs);
+  PrepareMIRs(mirs);
+  ASSERT_TRUE(cu_.mir_graph->SetMaxAvailableNonSpecialCompilerTemps(2u));
+  EXPECT_FALSE(PerformLoopUnrolling());
+  EXPECT_EQ(arraysize(bbs), cu_.mir_graph->GetNumBlocks());
+}
+
+TEST_F(LoopUnrollingTest, StepTwo) {
+  // for (int i = 0; i < a.length; i += 2) { x = a[i]; }
+  static const BBDef bbs[] = {
+      DEF_LOOP_BBS(),
+  };
+  static const MIRDef mirs[] = {
+      DEF_CONST(3u, 2, 0),
+      DEF_PHI2(4u, 3, 2, 6),
+      DEF_ARRAY_LENGTH(4u, 4, 0),
+      DEF_IF(4u, Instruction::IF_GE, 3, 4),
+      DEF_AGET(5u, 5, 0, 3),
+      DEF_ADD_LIT(5u, 6, 3, 2),
+      DEF_GOTO(5u),
+  };
+
+  PrepareBasicBlocks(bbs);
+  PrepareMIRs(mirs);
+  ASSERT_TRUE(cu_.mir_graph->SetMaxAvailableNonSpecialCompilerTemps(2u));
+  EXPECT_FALSE(PerformLoopUnrolling());
+  EXPECT_EQ(arraysize(bbs), cu_.mir_graph->GetNumBlocks());
+}
+
+TEST_F(LoopUnrollingTest, BodyUsesLength) {
+  // for (int i = 0; i < (n = a.length); i++) { b[i] = n; }
+  static const BBDef bbs[] = {
+      DEF_LOOP_BBS(),
+  };
+  static const MIRDef mirs[] = {
+      DEF_CONST(3u, 2, 0),
+      DEF_PHI2(4u, 3, 2, 5),
+      DEF_ARRAY_LENGTH(4u, 4, 0),
+      DEF_IF(4u, Instruction::IF_GE, 3, 4),
+      DEF_APUT(5u, 4, 1, 3),
+      DEF_ADD_LIT(5u, 5, 3, 1),
+      DEF_GOTO(5u),
+  };
+
+  PrepareBasicBlocks(bbs);
+  PrepareMIRs(mirs);
+  ASSERT_TRUE(cu_.mir_graph->SetMaxAvailableNonSpecialCompilerTemps(2u));
+  // The unrolled body would be entered without the array-length of the head defining n.
+  EXPECT_FALSE(PerformLoopUnrolling());
+  EXPECT_EQ(arraysize(bbs), cu_.mir_graph->GetNumBlocks());
+}
+
+TEST_F(LoopUnrollingTest, UnrolledLoopWithoutTemps) {
+  // for (int i = 0; i < a.length; i++) { x = a[i]; }, no compiler temps left.
+  static const BBDef bbs[] = {
+      DEF_LOOP_BBS(),
+  };
+  static const MIRDef mirs[] = {
+      DEF_CONST(3u, 2, 0),
+      DEF_PHI2(4u, 3, 2, 6),
+      DEF_ARRAY_LENGTH(4u, 4, 0),
+      DEF_IF(4u, Instruction::IF_GE, 3, 4),
+      DEF_AGET(5u, 5, 0, 3),
+      DEF_ADD_LIT(5u, 6, 3, 1),
+      DEF_GOTO(5u),
+  };
+
+  PrepareBasicBlocks(bbs);
+  PrepareMIRs(mirs);
+  EXPECT_FALSE(PerformLoopUnrolling());
+  EXPECT_EQ(arraysize(bbs), cu_.mir_graph->GetNumBlocks());
+}
+
 }  // namespace art
@@ -42,6 +42,9 @@ const Pass* const PassDriver<PassDriverMEOpts>::g_passes[] = {
   GetPassInstance<CacheMethodLoweringInfo>(),
   GetPassInstance<SpecialMethodInliner>(),
   GetPassInstance<CodeLayout>(),
+  GetPassInstance<LoopVectorization>(),
+  GetPassInstance<BoundsCheckElimination>(),
+  GetPassInstance<LoopUnrolling>(),
   GetPassInstance<NullCheckElimination>(),
   GetPassInstance<TypeInference>(),
   GetPassInstance<ClassInitCheckElimination>(),
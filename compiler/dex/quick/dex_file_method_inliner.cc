@@ -84,6 +84,10 @@ static constexpr bool kIntrinsicIsStatic[] = {
     false,  // kIntrinsicUnsafeGet
     false,  // kIntrinsicUnsafePut
     true,   // kIntrinsicSystemArrayCopyCharArray
+    false,  // kIntrinsicStringEquals
+    false,  // kIntrinsicStringHashCode
+    true,   // kIntrinsicArraysEquals
+    true,   // kIntrinsicArraysFill
 };
 COMPILE_ASSERT(arraysize(kIntrinsicIsStatic) == kInlineOpNop, check_arraysize_kIntrinsicIsStatic);
 COMPILE_ASSERT(kIntrinsicIsStatic[kIntrinsicDoubleCvt], DoubleCvt_must_be_static);
@@ -134,6 +138,10 @@ COMPILE_ASSERT(!kIntrinsicIsStatic[kIntrinsicUnsafeGet], UnsafeGet_must_not_be_s
 COMPILE_ASSERT(!kIntrinsicIsStatic[kIntrinsicUnsafePut], UnsafePut_must_not_be_static);
 COMPILE_ASSERT(kIntrinsicIsStatic[kIntrinsicSystemArrayCopyCharArray],
                SystemArrayCopyCharArray_must_be_static);
+COMPILE_ASSERT(!kIntrinsicIsStatic[kIntrinsicStringEquals], StringEquals_must_not_be_static);
+COMPILE_ASSERT(!kIntrinsicIsStatic[kIntrinsicStringHashCode], StringHashCode_must_not_be_static);
+COMPILE_ASSERT(kIntrinsicIsStatic[kIntrinsicArraysEquals], ArraysEquals_must_be_static);
+COMPILE_ASSERT(kIntrinsicIsStatic[kIntrinsicArraysFill], ArraysFill_must_be_static);
 
 MIR* AllocReplacementMIR(MIRGraph* mir_graph, MIR* invoke, MIR* move_return) {
   MIR* insn = mir_graph->NewMIR();
@@ -187,7 +195,10 @@ const char* const DexFileMethodInliner::kClassCacheNames[] = {
     "Llibcore/io/Memory;",     // kClassCacheLibcoreIoMemory
     "Lsun/misc/Unsafe;",       // kClassCacheSunMiscUnsafe
     "Ljava/lang/System;",      // kClassCacheJavaLangSystem
-    "[C"                       // kClassCacheJavaLangCharArray
+    "[C",                      // kClassCacheJavaLangCharArray
+    "[B",                      // kClassCacheJavaLangByteArray
+    "[I",                      // kClassCacheJavaLangIntArray
+    "Ljava/util/Arrays;",      // kClassCacheJavaUtilArrays
 };
 
 const char* const DexFileMethodInliner::kNameCacheNames[] = {
@@ -256,6 +267,9 @@ const char* const DexFileMethodInliner::kNameCacheNames[] = {
     "putObjectVolatile",     // kNameCachePutObjectVolatile
     "putOrderedObject",      // kNameCachePutOrderedObject
     "arraycopy",             // kNameCacheArrayCopy
+    "equals",                // kNameCacheEquals
+    "hashCode",              // kNameCacheHashCode
+    "fill",                  // kNameCacheFill
 };
 
 const DexFileMethodInliner::ProtoDef DexFileMethodInliner::kProtoCacheDefs[] = {
@@ -335,7 +349,21 @@ const DexFileMethodInliner::ProtoDef DexFileMethodInliner::kProtoCacheDefs[] = {
         kClassCacheJavaLangObject } },
     // kProtoCacheCharArrayICharArrayII_V
     { kClassCacheVoid, 5, {kClassCacheJavaLangCharArray, kClassCacheInt,
-                kClassCacheJavaLangCharArray, kClassCacheInt, kClassCacheInt}}
+                kClassCacheJavaLangCharArray, kClassCacheInt, kClassCacheInt}},
+    // kProtoCacheObject_Z
+    { kClassCacheBoolean, 1, { kClassCacheJavaLangObject } },
+    // kProtoCacheByteArrayByteArray_Z
+    { kClassCacheBoolean, 2, { kClassCacheJavaLangByteArray, kClassCacheJavaLangByteArray } },
+    // kProtoCacheCharArrayCharArray_Z
+    { kClassCacheBoolean, 2, { kClassCacheJavaLangCharArray, kClassCacheJavaLangCharArray } },
+    // kProtoCacheIntArrayIntArray_Z
+    { kClassCacheBoolean, 2, { kClassCacheJavaLangIntArray, kClassCacheJavaLangIntArray } },
+    // kProtoCacheByteArrayB_V
+    { kClassCacheVoid, 2, { kClassCacheJavaLangByteArray, kClassCacheByte } },
+    // kProtoCacheCharArrayC_V
+    { kClassCacheVoid, 2, { kClassCacheJavaLangCharArray, kClassCacheChar } },
+    // kProtoCacheIntArrayI_V
+    { kClassCacheVoid, 2, { kClassCacheJavaLangIntArray, kClassCacheInt } },
 };
 
 const DexFileMethodInliner::IntrinsicDef DexFileMethodInliner::kIntrinsicMethods[] = {
@@ -417,6 +445,8 @@ const DexFileMethodInliner::IntrinsicDef DexFileMethodInliner::kIntrinsicMethods
     INTRINSIC(JavaLangString, IndexOf, II_I, kIntrinsicIndexOf, kIntrinsicFlagNone),
     INTRINSIC(JavaLangString, IndexOf, I_I, kIntrinsicIndexOf, kIntrinsicFlagBase0),
     INTRINSIC(JavaLangString, Length, _I, kIntrinsicIsEmptyOrLength, kIntrinsicFlagLength),
+    INTRINSIC(JavaLangString, Equals, Object_Z, kIntrinsicStringEquals, 0),
+    INTRINSIC(JavaLangString, HashCode, _I, kIntrinsicStringHashCode, 0),
 
     INTRINSIC(JavaLangThread, CurrentThread, _Thread, kIntrinsicCurrentThread, 0),
 
@@ -456,6 +486,13 @@ const DexFileMethodInliner::IntrinsicDef DexFileMethodInliner::kIntrinsicMethods
     INTRINSIC(JavaLangSystem, ArrayCopy, CharArrayICharArrayII_V , kIntrinsicSystemArrayCopyCharArray,
               0),
 
+    INTRINSIC(JavaUtilArrays, Equals, ByteArrayByteArray_Z, kIntrinsicArraysEquals, kSignedByte),
+    INTRINSIC(JavaUtilArrays, Equals, CharArrayCharArray_Z, kIntrinsicArraysEquals, kUnsignedHalf),
+    INTRINSIC(JavaUtilArrays, Equals, IntArrayIntArray_Z, kIntrinsicArraysEquals, k32),
+    INTRINSIC(JavaUtilArrays, Fill, ByteArrayB_V, kIntrinsicArraysFill, kSignedByte),
+    INTRINSIC(JavaUtilArrays, Fill, CharArrayC_V, kIntrinsicArraysFill, kUnsignedHalf),
+    INTRINSIC(JavaUtilArrays, Fill, IntArrayI_V, kIntrinsicArraysFill, k32),
+
 
 #undef INTRINSIC
 };
@@ -605,6 +642,14 @@ bool DexFileMethodInliner::GenIntrinsic(Mir2Lir* backend, CallInfo* info) {
                                           intrinsic.d.data & kIntrinsicFlagIsOrdered);
     case kIntrinsicSystemArrayCopyCharArray:
       return backend->GenInlinedArrayCopyCharArray(info);
+    case kIntrinsicStringEquals:
+      return backend->GenInlinedStringEquals(info);
+    case kIntrinsicStringHashCode:
+      return backend->GenInlinedStringHashCode(info);
+    case kIntrinsicArraysEquals:
+      return backend->GenInlinedArraysEquals(info, static_cast<OpSize>(intrinsic.d.data));
+    case kIntrinsicArraysFill:
+      return backend->GenInlinedArraysFill(info, static_cast<OpSize>(intrinsic.d.data));
     default:
       LOG(FATAL) << "Unexpected intrinsic opcode: " << intrinsic.opcode;
       return false;  // avoid warning "control reaches end of non-void function"
@@ -121,6 +121,9 @@ class DexFileMethodInliner {
       kClassCacheSunMiscUnsafe,
       kClassCacheJavaLangSystem,
       kClassCacheJavaLangCharArray,
+      kClassCacheJavaLangByteArray,
+      kClassCacheJavaLangIntArray,
+      kClassCacheJavaUtilArrays,
       kClassCacheLast
     };
 
@@ -196,6 +199,9 @@ class DexFileMethodInliner {
       kNameCachePutObjectVolatile,
       kNameCachePutOrderedObject,
       kNameCacheArrayCopy,
+      kNameCacheEquals,
+      kNameCacheHashCode,
+      kNameCacheFill,
       kNameCacheLast
     };
 
@@ -242,6 +248,13 @@ class DexFileMethodInliner {
       kProtoCacheObjectJ_Object,
       kProtoCacheObjectJObject_V,
       kProtoCacheCharArrayICharArrayII_V,
+      kProtoCacheObject_Z,
+      kProtoCacheByteArrayByteArray_Z,
+      kProtoCacheCharArrayCharArray_Z,
+      kProtoCacheIntArrayIntArray_Z,
+      kProtoCacheByteArrayB_V,
+      kProtoCacheCharArrayC_V,
+      kProtoCacheIntArrayI_V,
       kProtoCacheLast
     };
 
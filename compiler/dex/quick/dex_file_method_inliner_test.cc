@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "class_linker.h"
+#include "common_compiler_test.h"
+#include "dex/quick/dex_file_method_inliner.h"
+#include "dex/quick/dex_file_to_method_inliner_map.h"
+#include "mirror/art_method-inl.h"
+#include "mirror/class-inl.h"
+#include "scoped_thread_state_change.h"
+
+namespace art {
+
+// Checks that the intrinsics bind to the methods libcore actually declares. An intrinsic whose
+// signature does not match a libcore method is silently never used, the calls then resolve to
+// a more general overload.
+class DexFileMethodInlinerTest : public CommonCompilerTest {
+ protected:
+  void CheckIntrinsic(const char* descriptor, const char* name, const char* signature,
+                      bool is_static, InlineMethodOpcode expected_opcode,
+                      uint64_t expected_data) {
+    ScopedObjectAccess soa(Thread::Current());
+    mirror::Class* klass = class_linker_->FindSystemClass(soa.Self(), descriptor);
+    ASSERT_TRUE(klass != nullptr) << descriptor;
+    mirror::ArtMethod* method = is_static ? klass->FindDeclaredDirectMethod(name, signature)
+                                          : klass->FindDeclaredVirtualMethod(name, signature);
+    ASSERT_TRUE(method != nullptr) << descriptor << "." << name << signature;
+    DexFileMethodInliner* inliner = method_inliner_map_->GetMethodInliner(method->GetDexFile());
+    InlineMethod intrinsic;
+    ASSERT_TRUE(inliner->IsIntrinsic(method->GetDexMethodIndex(), &intrinsic))
+        << descriptor << "." << name << signature;
+    EXPECT_EQ(expected_opcode, intrinsic.opcode) << descriptor << "." << name << signature;
+    EXPECT_EQ(expected_data, intrinsic.d.data) << descriptor << "." << name << signature;
+  }
+};
+
+TEST_F(DexFileMethodInlinerTest, String) {
+  CheckIntrinsic("Ljava/lang/String;", "equals", "(Ljava/lang/Object;)Z", false,
+                 kIntrinsicStringEquals, 0u);
+  CheckIntrinsic("Ljava/lang/String;", "hashCode", "()I", false,
+                 kIntrinsicStringHashCode, 0u);
+}
+
+TEST_F(DexFileMethodInlinerTest, Arrays) {
+  CheckIntrinsic("Ljava/util/Arrays;", "equals", "([B[B)Z", true,
+                 kIntrinsicArraysEquals, kSignedByte);
+  CheckIntrinsic("Ljava/util/Arrays;", "equals", "([C[C)Z", true,
+                 kIntrinsicArraysEquals, kUnsignedHalf);
+  CheckIntrinsic("Ljava/util/Arrays;", "equals", "([I[I)Z", true,
+                 kIntrinsicArraysEquals, k32);
+  CheckIntrinsic("Ljava/util/Arrays;", "fill", "([BB)V", true,
+                 kIntrinsicArraysFill, kSignedByte);
+  CheckIntrinsic("Ljava/util/Arrays;", "fill", "([CC)V", true,
+                 kIntrinsicArraysFill, kUnsignedHalf);
+  CheckIntrinsic("Ljava/util/Arrays;", "fill", "([II)V", true,
+                 kIntrinsicArraysFill, k32);
+}
+
+TEST_F(DexFileMethodInlinerTest, SystemArrayCopy) {
+  CheckIntrinsic("Ljava/lang/System;", "arraycopy", "([CI[CII)V", true,
+                 kIntrinsicSystemArrayCopyCharArray, 0u);
+}
+
+}  // namespace art
@@ -649,6 +649,30 @@ static int NextInterfaceCallInsn(CompilationUnit* cu, CallInfo* info, int state,
   return state + 1;
 }
 
+/*
+ * Emit the next instruction in the sequence that precedes the class guards of an invoke
+ * guarded by the profiled classes of its receiver. The class of the receiver stays in kArg0
+ * for the unguarded dispatch, so we load the first argument ("this") into kArg1 here rather
+ * than the standard LoadArgRegs.
+ */
+static int NextGuardedCallInsn(CompilationUnit* cu, CallInfo* info, int state,
+                               const MethodReference& unused, uint32_t unused2,
+                               uintptr_t unused3, uintptr_t unused4, InvokeType unused5) {
+  Mir2Lir* cg = static_cast<Mir2Lir*>(cu->cg.get());
+  switch (state) {
+    case 0:
+      CommonCallCodeLoadThisIntoArg1(info, cg);   // kArg1 := this
+      break;
+    case 1:
+      CommonCallCodeLoadClassIntoArg0(info, cg);  // kArg0 := kArg1->class
+                                                  // Includes a null-check.
+      break;
+    default:
+      return -1;
+  }
+  return state + 1;
+}
+
 static int NextInvokeInsnSP(CompilationUnit* cu, CallInfo* info,
                             QuickEntrypointEnum trampoline, int state,
                             const MethodReference& target_method, uint32_t method_idx) {
@@ -1493,6 +1517,352 @@ bool Mir2Lir::GenInlinedArrayCopyCharArray(CallInfo* info) {
   return false;
 }
 
+/*
+ * Compares r_count elements of 1 << shift bytes at the start of the arrays r_a and r_b, a word
+ * at a time where possible.  Leaves 1 in r_t1 if they are all equal and 0 otherwise.  r_count
+ * and r_t2 are clobbered.  The labels that materialize the two results are returned through
+ * equal and not_equal so that the caller's early outs can share them.
+ */
+void Mir2Lir::GenArrayRegionEquals(RegStorage r_a, RegStorage r_b, RegStorage r_count,
+                                   RegStorage r_t1, RegStorage r_t2, int shift,
+                                   LIR** equal, LIR** not_equal) {
+  int data_offset = mirror::Array::DataOffset(1 << shift).Int32Value();
+  // The word loop below relies on the data starting word aligned.
+  DCHECK_EQ(data_offset & 3, 0);
+  // r_count becomes the offset just past the last element; compare backwards from there.
+  if (shift != 0) {
+    OpRegRegImm(kOpLsl, r_count, r_count, shift);
+  }
+  OpRegImm(kOpAdd, r_count, data_offset);
+
+  // Compare a trailing byte and half-word so that a whole number of words remains.
+  LIR* tail_byte_mismatch = nullptr;
+  if (shift == 0) {
+    OpRegRegImm(kOpAnd, r_t1, r_count, 1);
+    LIR* no_tail_byte = OpCmpImmBranch(kCondEq, r_t1, 0, nullptr);
+    OpRegImm(kOpSub, r_count, 1);
+    LoadBaseIndexed(r_a, r_count, r_t1, 0, kUnsignedByte);
+    LoadBaseIndexed(r_b, r_count, r_t2, 0, kUnsignedByte);
+    tail_byte_mismatch = OpCmpBranch(kCondNe, r_t1, r_t2, nullptr);
+    no_tail_byte->target = NewLIR0(kPseudoTargetLabel);
+  }
+  LIR* tail_half_mismatch = nullptr;
+  if (shift <= 1) {
+    OpRegRegImm(kOpAnd, r_t1, r_count, 2);
+    LIR* no_tail_half = OpCmpImmBranch(kCondEq, r_t1, 0, nullptr);
+    OpRegImm(kOpSub, r_count, 2);
+    LoadBaseIndexed(r_a, r_count, r_t1, 0, kUnsignedHalf);
+    LoadBaseIndexed(r_b, r_count, r_t2, 0, kUnsignedHalf);
+    tail_half_mismatch = OpCmpBranch(kCondNe, r_t1, r_t2, nullptr);
+    no_tail_half->target = NewLIR0(kPseudoTargetLabel);
+  }
+
+  // Compare the remaining words.
+  LIR* loop = NewLIR0(kPseudoTargetLabel);
+  LIR* loop_done = OpCmpImmBranch(kCondEq, r_count, data_offset, nullptr);
+  OpRegImm(kOpSub, r_count, 4);
+  LoadBaseIndexed(r_a, r_count, r_t1, 0, k32);
+  LoadBaseIndexed(r_b, r_count, r_t2, 0, k32);
+  OpCmpBranch(kCondEq, r_t1, r_t2, loop);
+
+  *not_equal = NewLIR0(kPseudoTargetLabel);
+  LoadConstant(r_t1, 0);
+  LIR* not_equal_done = OpUnconditionalBranch(nullptr);
+  *equal = NewLIR0(kPseudoTargetLabel);
+  LoadConstant(r_t1, 1);
+  LIR* done = NewLIR0(kPseudoTargetLabel);
+
+  if (tail_byte_mismatch != nullptr) {
+    tail_byte_mismatch->target = *not_equal;
+  }
+  if (tail_half_mismatch != nullptr) {
+    tail_half_mismatch->target = *not_equal;
+  }
+  loop_done->target = *equal;
+  not_equal_done->target = done;
+}
+
+// The loops of the String and Arrays intrinsics below have no suspend check, so longer data
+// bails to the library code as the arraycopy intrinsics do.
+static constexpr int kLargeArrayThreshold = 256;
+
+/*
+ * Fast String.equals(Object).  Compares the char data in place when neither string has
+ * an offset into its char array and the strings are short, otherwise bails to the standard
+ * library code.
+ */
+bool Mir2Lir::GenInlinedStringEquals(CallInfo* info) {
+  if (cu_->instruction_set == kMips || cu_->instruction_set == kX86) {
+    // TODO - add Mips implementation; x86 does not have enough temps for the compare loop.
+    return false;
+  }
+  int value_offset = mirror::String::ValueOffset().Int32Value();
+  int count_offset = mirror::String::CountOffset().Int32Value();
+  int offset_offset = mirror::String::OffsetOffset().Int32Value();
+  int class_offset = mirror::Object::ClassOffset().Int32Value();
+
+  RegStorage reg_this = AllocTempRef();
+  RegStorage reg_cmp = AllocTempRef();
+  RegStorage reg_count = AllocTemp();
+  RegStorage reg_t1 = AllocTemp();
+  RegStorage reg_t2 = AllocTemp();
+  LoadValueDirectFixed(info->args[0], reg_this);
+  LoadValueDirectFixed(info->args[1], reg_cmp);
+  // Touch this before the identity check so that a null receiver still throws.
+  GenNullCheck(reg_this, info->opt_flags);
+  Load32Disp(reg_this, count_offset, reg_count);
+  MarkPossibleNullPointerException(info->opt_flags);
+  LIR* same_string = OpCmpBranch(kCondEq, reg_this, reg_cmp, nullptr);
+  LIR* cmp_null = OpCmpImmBranch(kCondEq, reg_cmp, 0, nullptr);
+  // String is final, so the argument is a String exactly when the classes match.
+  LoadRefDisp(reg_this, class_offset, reg_t1, kNotVolatile);
+  LoadRefDisp(reg_cmp, class_offset, reg_t2, kNotVolatile);
+  LIR* class_mismatch = OpCmpBranch(kCondNe, reg_t1, reg_t2, nullptr);
+  Load32Disp(reg_cmp, count_offset, reg_t1);
+  LIR* count_mismatch = OpCmpBranch(kCondNe, reg_count, reg_t1, nullptr);
+  // Leave long strings and substrings to the library.
+  LIR* too_long = OpCmpImmBranch(kCondHi, reg_count, kLargeArrayThreshold, nullptr);
+  Load32Disp(reg_this, offset_offset, reg_t1);
+  Load32Disp(reg_cmp, offset_offset, reg_t2);
+  OpRegReg(kOpOr, reg_t1, reg_t2);
+  LIR* substring = OpCmpImmBranch(kCondNe, reg_t1, 0, nullptr);
+  LoadRefDisp(reg_this, value_offset, reg_this, kNotVolatile);
+  LoadRefDisp(reg_cmp, value_offset, reg_cmp, kNotVolatile);
+
+  LIR* equal;
+  LIR* not_equal;
+  GenArrayRegionEquals(reg_this, reg_cmp, reg_count, reg_t1, reg_t2, 1, &equal, &not_equal);
+  same_string->target = equal;
+  cmp_null->target = not_equal;
+  class_mismatch->target = not_equal;
+  count_mismatch->target = not_equal;
+  FreeTemp(reg_this);
+  FreeTemp(reg_cmp);
+  FreeTemp(reg_count);
+  FreeTemp(reg_t2);
+
+  RegLocation rl_dest = InlineTarget(info);
+  RegLocation rl_result = EvalLoc(rl_dest, kCoreReg, true);
+  OpRegCopy(rl_result.reg, reg_t1);
+  FreeTemp(reg_t1);
+  StoreValue(rl_dest, rl_result);
+
+  LIR* finish_branch = OpUnconditionalBranch(nullptr);
+  LIR* check_failed = NewLIR0(kPseudoTargetLabel);
+  LIR* slow_path_branch = OpUnconditionalBranch(nullptr);
+  LIR* intrinsic_finish = NewLIR0(kPseudoTargetLabel);
+  too_long->target = check_failed;
+  substring->target = check_failed;
+  finish_branch->target = intrinsic_finish;
+  info->opt_flags |= MIR_IGNORE_NULL_CHECK;  // Record that we've already null checked.
+  AddIntrinsicSlowPath(info, slow_path_branch, intrinsic_finish);
+  ClobberCallerSave();  // We must clobber everything because slow path will return here
+  return true;
+}
+
+/*
+ * Fast String.hashCode().  Returns the cached hash code if there is one, otherwise computes
+ * it with the same recurrence as the library and caches it.  Long strings bail to the
+ * standard library code.
+ */
+bool Mir2Lir::GenInlinedStringHashCode(CallInfo* info) {
+  if (cu_->instruction_set == kMips || cu_->instruction_set == kX86) {
+    // TODO - add Mips implementation; x86 does not have enough temps for the hash loop.
+    return false;
+  }
+  int value_offset = mirror::String::ValueOffset().Int32Value();
+  int count_offset = mirror::String::CountOffset().Int32Value();
+  int offset_offset = mirror::String::OffsetOffset().Int32Value();
+  int hash_code_offset = mirror::String::HashCodeOffset().Int32Value();
+  int data_offset = mirror::Array::DataOffset(sizeof(uint16_t)).Int32Value();
+
+  RegLocation rl_this = info->args[0];
+  RegStorage reg_ptr = AllocTempRef();
+  RegStorage reg_hash = AllocTemp();
+  RegStorage reg_idx = AllocTemp();
+  RegStorage reg_end = AllocTemp();
+  RegStorage reg_char = AllocTemp();
+  LoadValueDirectFixed(rl_this, reg_ptr);
+  GenNullCheck(reg_ptr, info->opt_flags);
+  Load32Disp(reg_ptr, hash_code_offset, reg_hash);
+  MarkPossibleNullPointerException(info->opt_flags);
+  LIR* cached = OpCmpImmBranch(kCondNe, reg_hash, 0, nullptr);
+  Load32Disp(reg_ptr, count_offset, reg_end);
+  LIR* empty = OpCmpImmBranch(kCondEq, reg_end, 0, nullptr);
+  LIR* slow_path_branch = OpCmpImmBranch(kCondHi, reg_end, kLargeArrayThreshold, nullptr);
+  Load32Disp(reg_ptr, offset_offset, reg_idx);
+  LoadRefDisp(reg_ptr, value_offset, reg_ptr, kNotVolatile);
+  // Turn offset and offset + count into byte offsets into the char array.
+  OpRegReg(kOpAdd, reg_end, reg_idx);
+  OpRegRegImm(kOpLsl, reg_idx, reg_idx, 1);
+  OpRegImm(kOpAdd, reg_idx, data_offset);
+  OpRegRegImm(kOpLsl, reg_end, reg_end, 1);
+  OpRegImm(kOpAdd, reg_end, data_offset);
+
+  // hash = 31 * hash + c, computed as (hash << 5) + (c - hash) to avoid a multiply.
+  LIR* loop = NewLIR0(kPseudoTargetLabel);
+  LoadBaseIndexed(reg_ptr, reg_idx, reg_char, 0, kUnsignedHalf);
+  OpRegReg(kOpSub, reg_char, reg_hash);
+  OpRegRegImm(kOpLsl, reg_hash, reg_hash, 5);
+  OpRegReg(kOpAdd, reg_hash, reg_char);
+  OpRegImm(kOpAdd, reg_idx, sizeof(uint16_t));
+  OpCmpBranch(kCondLt, reg_idx, reg_end, loop);
+  // Cache the result as the library does; racing threads store the same value.
+  LoadValueDirectFixed(rl_this, reg_ptr);
+  Store32Disp(reg_ptr, hash_code_offset, reg_hash);
+
+  LIR* done = NewLIR0(kPseudoTargetLabel);
+  cached->target = done;
+  empty->target = done;
+  FreeTemp(reg_ptr);
+  FreeTemp(reg_idx);
+  FreeTemp(reg_end);
+  FreeTemp(reg_char);
+
+  RegLocation rl_dest = InlineTarget(info);
+  RegLocation rl_result = EvalLoc(rl_dest, kCoreReg, true);
+  OpRegCopy(rl_result.reg, reg_hash);
+  FreeTemp(reg_hash);
+  StoreValue(rl_dest, rl_result);
+
+  LIR* intrinsic_finish = NewLIR0(kPseudoTargetLabel);
+  info->opt_flags |= MIR_IGNORE_NULL_CHECK;  // Record that we've already null checked.
+  AddIntrinsicSlowPath(info, slow_path_branch, intrinsic_finish);
+  ClobberCallerSave();  // We must clobber everything because slow path will return here
+  return true;
+}
+
+/*
+ * Fast Arrays.equals() for byte[], char[] and int[].  Long arrays bail to the standard
+ * library code.
+ */
+bool Mir2Lir::GenInlinedArraysEquals(CallInfo* info, OpSize size) {
+  if (cu_->instruction_set == kMips || cu_->instruction_set == kX86) {
+    // TODO - add Mips implementation; x86 does not have enough temps for the compare loop.
+    return false;
+  }
+  int len_offset = mirror::Array::LengthOffset().Int32Value();
+
+  RegStorage reg_a = AllocTempRef();
+  RegStorage reg_b = AllocTempRef();
+  RegStorage reg_count = AllocTemp();
+  RegStorage reg_t1 = AllocTemp();
+  RegStorage reg_t2 = AllocTemp();
+  LoadValueDirectFixed(info->args[0], reg_a);
+  LoadValueDirectFixed(info->args[1], reg_b);
+  // Also covers both arrays being null.
+  LIR* same_array = OpCmpBranch(kCondEq, reg_a, reg_b, nullptr);
+  LIR* a_null = OpCmpImmBranch(kCondEq, reg_a, 0, nullptr);
+  LIR* b_null = OpCmpImmBranch(kCondEq, reg_b, 0, nullptr);
+  Load32Disp(reg_a, len_offset, reg_count);
+  Load32Disp(reg_b, len_offset, reg_t1);
+  LIR* length_mismatch = OpCmpBranch(kCondNe, reg_count, reg_t1, nullptr);
+  LIR* slow_path_branch = OpCmpImmBranch(kCondHi, reg_count, kLargeArrayThreshold, nullptr);
+
+  LIR* equal;
+  LIR* not_equal;
+  GenArrayRegionEquals(reg_a, reg_b, reg_count, reg_t1, reg_t2, ArrayElementShift(size),
+                       &equal, &not_equal);
+  same_array->target = equal;
+  a_null->target = not_equal;
+  b_null->target = not_equal;
+  length_mismatch->target = not_equal;
+  FreeTemp(reg_a);
+  FreeTemp(reg_b);
+  FreeTemp(reg_count);
+  FreeTemp(reg_t2);
+
+  RegLocation rl_dest = InlineTarget(info);
+  RegLocation rl_result = EvalLoc(rl_dest, kCoreReg, true);
+  OpRegCopy(rl_result.reg, reg_t1);
+  FreeTemp(reg_t1);
+  StoreValue(rl_dest, rl_result);
+
+  LIR* intrinsic_finish = NewLIR0(kPseudoTargetLabel);
+  AddIntrinsicSlowPath(info, slow_path_branch, intrinsic_finish);
+  ClobberCallerSave();  // We must clobber everything because slow path will return here
+  return true;
+}
+
+/*
+ * Fast Arrays.fill() of a whole byte[], char[] or int[].  Narrow values are replicated across
+ * a word so that the bulk of the array is filled a word at a time.  Long arrays bail to the
+ * standard library code.
+ */
+bool Mir2Lir::GenInlinedArraysFill(CallInfo* info, OpSize size) {
+  if (cu_->instruction_set == kMips) {
+    // TODO - add Mips implementation
+    return false;
+  }
+  int shift = ArrayElementShift(size);
+  int len_offset = mirror::Array::LengthOffset().Int32Value();
+  int data_offset = mirror::Array::DataOffset(1 << shift).Int32Value();
+  // The word loop below relies on the data starting word aligned.
+  DCHECK_EQ(data_offset & 3, 0);
+
+  RegStorage reg_ptr = AllocTempRef();
+  RegStorage reg_idx = AllocTemp();
+  RegStorage reg_value = AllocTemp();
+  RegStorage reg_tmp = AllocTemp();
+  LoadValueDirectFixed(info->args[0], reg_ptr);
+  GenNullCheck(reg_ptr, info->opt_flags);
+  Load32Disp(reg_ptr, len_offset, reg_idx);
+  MarkPossibleNullPointerException(info->opt_flags);
+  LIR* slow_path_branch = OpCmpImmBranch(kCondHi, reg_idx, kLargeArrayThreshold, nullptr);
+  LoadValueDirectFixed(info->args[1], reg_value);
+  if (shift == 0) {
+    OpRegImm(kOpAnd, reg_value, 0xff);
+    OpRegRegImm(kOpLsl, reg_tmp, reg_value, 8);
+    OpRegReg(kOpOr, reg_value, reg_tmp);
+  } else if (shift == 1) {
+    OpRegReg(kOp2Char, reg_value, reg_value);
+  }
+  if (shift <= 1) {
+    OpRegRegImm(kOpLsl, reg_tmp, reg_value, 16);
+    OpRegReg(kOpOr, reg_value, reg_tmp);
+  }
+  // reg_idx becomes the offset just past the last element; fill backwards from there.
+  if (shift != 0) {
+    OpRegRegImm(kOpLsl, reg_idx, reg_idx, shift);
+  }
+  OpRegImm(kOpAdd, reg_idx, data_offset);
+
+  // Store a trailing byte and half-word so that a whole number of words remains.
+  if (shift == 0) {
+    OpRegRegImm(kOpAnd, reg_tmp, reg_idx, 1);
+    LIR* no_tail_byte = OpCmpImmBranch(kCondEq, reg_tmp, 0, nullptr);
+    OpRegImm(kOpSub, reg_idx, 1);
+    StoreBaseIndexed(reg_ptr, reg_idx, reg_value, 0, kUnsignedByte);
+    no_tail_byte->target = NewLIR0(kPseudoTargetLabel);
+  }
+  if (shift <= 1) {
+    OpRegRegImm(kOpAnd, reg_tmp, reg_idx, 2);
+    LIR* no_tail_half = OpCmpImmBranch(kCondEq, reg_tmp, 0, nullptr);
+    OpRegImm(kOpSub, reg_idx, 2);
+    StoreBaseIndexed(reg_ptr, reg_idx, reg_value, 0, kUnsignedHalf);
+    no_tail_half->target = NewLIR0(kPseudoTargetLabel);
+  }
+
+  // Fill the remaining words.
+  LIR* loop = NewLIR0(kPseudoTargetLabel);
+  LIR* loop_done = OpCmpImmBranch(kCondEq, reg_idx, data_offset, nullptr);
+  OpRegImm(kOpSub, reg_idx, 4);
+  StoreBaseIndexed(reg_ptr, reg_idx, reg_value, 0, k32);
+  OpUnconditionalBranch(loop);
+  loop_done->target = NewLIR0(kPseudoTargetLabel);
+
+  FreeTemp(reg_ptr);
+  FreeTemp(reg_idx);
+  FreeTemp(reg_value);
+  FreeTemp(reg_tmp);
+
+  LIR* intrinsic_finish = NewLIR0(kPseudoTargetLabel);
+  info->opt_flags |= MIR_IGNORE_NULL_CHECK;  // Record that we've already null checked.
+  AddIntrinsicSlowPath(info, slow_path_branch, intrinsic_finish);
+  ClobberCallerSave();  // We must clobber everything because slow path will return here
+  return true;
+}
+
 
 /*
  * Fast String.indexOf(I) & (II).  Tests for simple case of char <= 0xFFFF,
@@ -1756,6 +2126,54 @@ static LIR* GenInvokeNoInlineCall(Mir2Lir* mir_to_lir, InvokeType type) {
   return mir_to_lir->InvokeTrampoline(kOpBlx, RegStorage::InvalidReg(), trampoline);
 }
 
+LIR* Mir2Lir::GenGuardedInvokeCalls(CallInfo* info,
+                                    const CompilerDriver::ProfiledInvokeTarget* targets,
+                                    size_t num_targets, const MethodReference& target_method,
+                                    uint32_t vtable_idx, InvokeType original_type,
+                                    LIR** done_branches) {
+  // The call sequences only set kArg0 and kInvokeTgt, which is free to hold the expected class
+  // until then. On x86, kInvokeTgt is not a register.
+  DCHECK(cu_->instruction_set != kX86 && cu_->instruction_set != kX86_64);
+  RegStorage receiver_class = TargetReg(kArg0, kRef);
+  RegStorage expected_class = TargetReg(kInvokeTgt, kRef);
+  for (size_t i = 0; i != num_targets; ++i) {
+    // The class is null in the dex cache of the method until resolved, and the guard fails.
+    LoadCurrMethodDirect(expected_class);
+    LoadRefDisp(expected_class, mirror::ArtMethod::DexCacheResolvedTypesOffset().Int32Value(),
+                expected_class, kNotVolatile);
+    LoadRefDisp(expected_class, ObjArray::OffsetOfElement(targets[i].class_type_idx).Int32Value(),
+                expected_class, kNotVolatile);
+    LIR* miss = OpCmpBranch(kCondNe, receiver_class, expected_class, nullptr);
+    int call_state = 0;
+    while (call_state >= 0) {
+      call_state = NextSDCallInsn(cu_, info, call_state, targets[i].target_method, 0u,
+                                  targets[i].direct_code, targets[i].direct_method,
+                                  original_type);
+    }
+    MarkSafepointPC(OpReg(kOpBlx, TargetPtrReg(kInvokeTgt)));
+    done_branches[i] = OpUnconditionalBranch(nullptr);
+    miss->target = NewLIR0(kPseudoTargetLabel);
+  }
+  // No guard matched: dispatch through the class in kArg0, skipping the states of the
+  // sequence that load it.
+  NextCallInsn next_call_insn;
+  int call_state;
+  if (original_type == kInterface) {
+    next_call_insn = NextInterfaceCallInsn;
+    NextInterfaceCallInsn(cu_, info, 0, target_method, vtable_idx, 0u, 0u, original_type);
+    call_state = 3;
+  } else {
+    DCHECK_EQ(original_type, kVirtual);
+    next_call_insn = NextVCallInsn;
+    call_state = 2;
+  }
+  while (call_state >= 0) {
+    call_state = next_call_insn(cu_, info, call_state, target_method, vtable_idx, 0u, 0u,
+                                original_type);
+  }
+  return OpReg(kOpBlx, TargetPtrReg(kInvokeTgt));
+}
+
 void Mir2Lir::GenInvokeNoInline(CallInfo* info) {
   int call_state = 0;
   LIR* null_ck;
@@ -1793,6 +2211,21 @@ void Mir2Lir::GenInvokeNoInline(CallInfo* info) {
     next_call_insn = fast_path ? NextVCallInsn : NextVCallInsnSP;
     skip_this = fast_path;
   }
+  // Guard the virtual and interface invokes the verifier could not devirtualize with the
+  // receiver classes of the profile.
+  CompilerDriver::ProfiledInvokeTarget guarded_targets[CompilerDriver::kMaxProfiledInvokeTargets];
+  LIR* guarded_done_branches[CompilerDriver::kMaxProfiledInvokeTargets];
+  size_t num_guarded_targets = 0u;
+  if (fast_path && (info->type == kVirtual || info->type == kInterface) &&
+      cu_->instruction_set != kX86 && cu_->instruction_set != kX86_64) {
+    num_guarded_targets = cu_->compiler_driver->ComputeProfiledInvokeTargets(
+        mir_graph_->GetCurrentDexCompilationUnit(), info->offset, method_info.MethodIndex(),
+        info->type, guarded_targets);
+  }
+  if (num_guarded_targets != 0u) {
+    cu_->compiler_driver->ProcessedGuardedInvoke(num_guarded_targets);
+    next_call_insn = NextGuardedCallInsn;
+  }
   MethodReference target_method = method_info.GetTargetMethod();
   if (!info->is_range) {
     call_state = GenDalvikArgsNoRange(info, call_state, p_null_ck,
@@ -1811,7 +2244,11 @@ void Mir2Lir::GenInvokeNoInline(CallInfo* info) {
                                 method_info.DirectCode(), method_info.DirectMethod(), original_type);
   }
   LIR* call_inst;
-  if (cu_->instruction_set != kX86 && cu_->instruction_set != kX86_64) {
+  if (num_guarded_targets != 0u) {
+    call_inst = GenGuardedInvokeCalls(info, guarded_targets, num_guarded_targets, target_method,
+                                      method_info.VTableIndex(), original_type,
+                                      guarded_done_branches);
+  } else if (cu_->instruction_set != kX86 && cu_->instruction_set != kX86_64) {
     call_inst = OpReg(kOpBlx, TargetPtrReg(kInvokeTgt));
   } else {
     if (fast_path) {
@@ -1830,6 +2267,12 @@ void Mir2Lir::GenInvokeNoInline(CallInfo* info) {
   }
   EndInvoke(info);
   MarkSafepointPC(call_inst);
+  if (num_guarded_targets != 0u) {
+    LIR* done = NewLIR0(kPseudoTargetLabel);
+    for (size_t i = 0; i != num_guarded_targets; ++i) {
+      guarded_done_branches[i]->target = done;
+    }
+  }
 
   FreeCallTemps();
   if (info->result.location != kLocInvalid) {
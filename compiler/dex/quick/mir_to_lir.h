@@ -580,6 +580,12 @@ class Mir2Lir : public Backend {
       }
     }
 
+    // Log2 of the element size of a byte, char or int array.
+    static int ArrayElementShift(OpSize size) {
+      DCHECK(size == kSignedByte || size == kUnsignedHalf || size == k32) << size;
+      return (size == kSignedByte) ? 0 : ((size == kUnsignedHalf) ? 1 : 2);
+    }
+
     size_t CodeBufferSizeInBytes() {
       return code_buffer_.size() / sizeof(code_buffer_[0]);
     }
@@ -909,6 +915,15 @@ class Mir2Lir : public Backend {
                                                             bool safepoint_pc);
     void GenInvoke(CallInfo* info);
     void GenInvokeNoInline(CallInfo* info);
+    // Emits the calls of a virtual or interface invoke guarded by the profiled classes of its
+    // receiver, once the arguments are loaded and kArg0 holds the class of the receiver. Each
+    // guard calls its target directly and branches to the end of the invoke, which the branch
+    // stored into done_branches targets. Returns the call of the unguarded dispatch.
+    LIR* GenGuardedInvokeCalls(CallInfo* info,
+                               const CompilerDriver::ProfiledInvokeTarget* targets,
+                               size_t num_targets, const MethodReference& target_method,
+                               uint32_t vtable_idx, InvokeType original_type,
+                               LIR** done_branches);
     virtual void FlushIns(RegLocation* ArgLocs, RegLocation rl_method);
     virtual int GenDalvikArgsNoRange(CallInfo* info, int call_state, LIR** pcrLabel,
                              NextCallInsn next_call_insn,
@@ -957,6 +972,13 @@ class Mir2Lir : public Backend {
     virtual bool GenInlinedRint(CallInfo* info);
     virtual bool GenInlinedRound(CallInfo* info, bool is_double);
     virtual bool GenInlinedArrayCopyCharArray(CallInfo* info);
+    virtual bool GenInlinedStringEquals(CallInfo* info);
+    virtual bool GenInlinedStringHashCode(CallInfo* info);
+    virtual bool GenInlinedArraysEquals(CallInfo* info, OpSize size);
+    virtual bool GenInlinedArraysFill(CallInfo* info, OpSize size);
+    void GenArrayRegionEquals(RegStorage r_a, RegStorage r_b, RegStorage r_count,
+                              RegStorage r_t1, RegStorage r_t2, int shift,
+                              LIR** equal, LIR** not_equal);
     virtual bool GenInlinedIndexOf(CallInfo* info, bool zero_based);
     bool GenInlinedStringCompareTo(CallInfo* info);
     virtual bool GenInlinedCurrentThread(CallInfo* info);
@@ -2407,12 +2407,62 @@ void X86Mir2Lir::GenSetVector(BasicBlock *bb, MIR *mir) {
   }
 }
 
+static int PackedArrayScale(OpSize opsize) {
+  switch (opsize) {
+    case k32:
+    case kSingle:
+      return 2;
+    case kSignedHalf:
+    case kUnsignedHalf:
+      return 1;
+    case kSignedByte:
+    case kUnsignedByte:
+      return 0;
+    default:
+      LOG(FATAL) << "Unsupported packed array access " << opsize;
+      return 0;
+  }
+}
+
 void X86Mir2Lir::GenPackedArrayGet(BasicBlock *bb, MIR *mir) {
-  UNIMPLEMENTED(FATAL) << "Extended opcode kMirOpPackedArrayGet not supported.";
+  // We only support 128 bit registers.
+  DCHECK_EQ(mir->dalvikInsn.arg[0] & 0xFFFF, 128U);
+  // The index is only checked against the length for the first element, so the range check
+  // must have been proven redundant for the whole vector.
+  DCHECK_NE(mir->optimization_flags & MIR_IGNORE_RANGE_CHECK, 0);
+  OpSize opsize = static_cast<OpSize>(mir->dalvikInsn.arg[0] >> 16);
+  int scale = PackedArrayScale(opsize);
+  int data_offset = mirror::Array::DataOffset(sizeof(int32_t)).Int32Value();
+  RegStorage rs_dest = RegStorage::Solo128(mir->dalvikInsn.vA);
+  Clobber(rs_dest);
+
+  RegLocation rl_array = LoadValue(mir_graph_->GetSrc(mir, 0), kRefReg);
+  RegLocation rl_index = LoadValue(mir_graph_->GetSrc(mir, 1), kCoreReg);
+  GenNullCheck(rl_array.reg, mir->optimization_flags);
+
+  // Array data is only 4-byte aligned, so use an unaligned load.
+  NewLIR5(kX86MovupsRA, rs_dest.GetReg(), rl_array.reg.GetReg(), rl_index.reg.GetReg(), scale,
+          data_offset);
 }
 
 void X86Mir2Lir::GenPackedArrayPut(BasicBlock *bb, MIR *mir) {
-  UNIMPLEMENTED(FATAL) << "Extended opcode kMirOpPackedArrayPut not supported.";
+  // We only support 128 bit registers.
+  DCHECK_EQ(mir->dalvikInsn.arg[0] & 0xFFFF, 128U);
+  // The index is only checked against the length for the first element, so the range check
+  // must have been proven redundant for the whole vector.
+  DCHECK_NE(mir->optimization_flags & MIR_IGNORE_RANGE_CHECK, 0);
+  OpSize opsize = static_cast<OpSize>(mir->dalvikInsn.arg[0] >> 16);
+  int scale = PackedArrayScale(opsize);
+  int data_offset = mirror::Array::DataOffset(sizeof(int32_t)).Int32Value();
+  RegStorage rs_src = RegStorage::Solo128(mir->dalvikInsn.vA);
+
+  RegLocation rl_array = LoadValue(mir_graph_->GetSrc(mir, 0), kRefReg);
+  RegLocation rl_index = LoadValue(mir_graph_->GetSrc(mir, 1), kCoreReg);
+  GenNullCheck(rl_array.reg, mir->optimization_flags);
+
+  // Array data is only 4-byte aligned, so use an unaligned store.
+  NewLIR5(kX86MovupsAR, rl_array.reg.GetReg(), rl_index.reg.GetReg(), scale, data_offset,
+          rs_src.GetReg());
 }
 
 LIR* X86Mir2Lir::ScanVectorLiteral(int32_t* constants) {
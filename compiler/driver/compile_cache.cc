@@ -0,0 +1,433 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "compile_cache.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <memory>
+#include <sstream>
+#include <vector>
+
+#include "base/stringprintf.h"
+#include "class_linker.h"
+#include "compiled_method.h"
+#include "dex/verification_results.h"
+#include "dex/verified_method.h"
+#include "dex_instruction-inl.h"
+#include "driver/compiler_driver.h"
+#include "mirror/art_field-inl.h"
+#include "mirror/art_method-inl.h"
+#include "mirror/class-inl.h"
+#include "mirror/dex_cache-inl.h"
+#include "modifiers.h"
+#include "os.h"
+#include "runtime.h"
+#include "scoped_thread_state_change.h"
+#include "utils.h"
+#include "utils/array_ref.h"
+
+namespace art {
+
+static constexpr uint8_t kEntryMagic[] = { 'c', 'c', 'e', '\n' };
+static constexpr uint32_t kEntryVersion = 1u;
+
+// Callees with at most this many code units may be inlined as special methods, their code is
+// part of the key of the caller.
+static constexpr uint32_t kMaxInlinedCalleeCodeUnits = 4u;
+
+static void AppendUint32(std::string* key, uint32_t value) {
+  key->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static void AppendString(std::string* key, const std::string& value) {
+  AppendUint32(key, value.size());
+  key->append(value);
+}
+
+static void AppendCodeItem(std::string* key, const DexFile::CodeItem* code_item) {
+  if (code_item == nullptr) {
+    AppendUint32(key, 0u);
+    return;
+  }
+  size_t size = DexFile::GetCodeItemBodySize(*code_item);
+  AppendUint32(key, size + 1u);
+  AppendUint32(key, code_item->registers_size_);
+  AppendUint32(key, code_item->ins_size_);
+  AppendUint32(key, code_item->outs_size_);
+  AppendUint32(key, code_item->tries_size_);
+  key->append(reinterpret_cast<const char*>(code_item->insns_), size);
+}
+
+static void AppendClass(std::string* key, mirror::Class* klass)
+    SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+  if (klass == nullptr) {
+    AppendUint32(key, 0u);
+    return;
+  }
+  std::string temp;
+  AppendString(key, klass->GetDescriptor(&temp));
+  AppendUint32(key, static_cast<uint32_t>(klass->GetStatus()));
+  AppendUint32(key, klass->GetAccessFlags());
+}
+
+static void AppendField(std::string* key, mirror::ArtField* field)
+    SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+  if (field == nullptr) {
+    AppendUint32(key, 0u);
+    return;
+  }
+  AppendUint32(key, field->GetOffset().Uint32Value());
+  AppendUint32(key, field->GetAccessFlags() & kAccJavaFlagsMask);
+  AppendClass(key, field->GetDeclaringClass());
+}
+
+static void AppendMethod(std::string* key, mirror::ArtMethod* method)
+    SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+  if (method == nullptr) {
+    AppendUint32(key, 0u);
+    return;
+  }
+  AppendUint32(key, method->GetMethodIndex());
+  AppendUint32(key, method->GetAccessFlags() & kAccJavaFlagsMask);
+  AppendClass(key, method->GetDeclaringClass());
+  const DexFile::CodeItem* code_item = method->GetCodeItem();
+  if (code_item != nullptr &&
+      code_item->insns_size_in_code_units_ <= kMaxInlinedCalleeCodeUnits) {
+    AppendCodeItem(key, code_item);
+  } else {
+    AppendUint32(key, 0u);
+  }
+}
+
+// Appends the meaning and the resolution of an index referenced by an instruction.
+static void AppendReference(std::string* key, int verify_type, uint32_t index,
+                            const DexFile& dex_file, mirror::DexCache* dex_cache)
+    SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+  AppendUint32(key, verify_type);
+  AppendUint32(key, index);
+  switch (verify_type) {
+    case Instruction::kVerifyRegBString:
+      AppendString(key, dex_file.StringDataByIdx(index));
+      AppendUint32(key, dex_cache->GetResolvedString(index) != nullptr ? 1u : 0u);
+      break;
+    case Instruction::kVerifyRegBNewInstance:
+    case Instruction::kVerifyRegBType:
+    case Instruction::kVerifyRegCNewArray:
+    case Instruction::kVerifyRegCType:
+      AppendString(key, dex_file.StringByTypeIdx(index));
+      AppendClass(key, dex_cache->GetResolvedType(index));
+      break;
+    case Instruction::kVerifyRegBField:
+    case Instruction::kVerifyRegCField:
+      AppendString(key, PrettyField(index, dex_file));
+      AppendField(key, dex_cache->GetResolvedField(index));
+      break;
+    case Instruction::kVerifyRegBMethod:
+      AppendString(key, PrettyMethod(index, dex_file));
+      AppendMethod(key, dex_cache->GetResolvedMethod(index));
+      break;
+    default:
+      break;
+  }
+}
+
+// Returns a 64-bit FNV-1a hash of the key, used to name its entry.
+static uint64_t HashKey(const std::string& key) {
+  uint64_t hash = UINT64_C(0xcbf29ce484222325);
+  for (char c : key) {
+    hash = (hash ^ static_cast<uint8_t>(c)) * UINT64_C(0x100000001b3);
+  }
+  return hash;
+}
+
+CompileCache::CompileCache(const std::string& directory, const std::string& configuration)
+    : directory_(directory),
+      configuration_(configuration),
+      hits_(0u),
+      misses_(0u),
+      inserts_(0u),
+      failed_inserts_(0u) {
+}
+
+bool CompileCache::GetKey(const CompilerDriver* driver, const DexFile::CodeItem* code_item,
+                          uint32_t access_flags, uint32_t method_idx, const DexFile& dex_file,
+                          std::string* key) const {
+  const VerifiedMethod* verified_method =
+      driver->GetVerificationResults()->GetVerifiedMethod(MethodReference(&dex_file, method_idx));
+  if (code_item == nullptr || verified_method == nullptr) {
+    return false;
+  }
+  key->clear();
+  AppendString(key, configuration_);
+  AppendString(key, PrettyMethod(method_idx, dex_file));
+  AppendUint32(key, access_flags & kAccJavaFlagsMask);
+  AppendCodeItem(key, code_item);
+
+  // The verifier results drive the GC maps, check-cast elision and devirtualization.
+  const std::vector<uint8_t>& dex_gc_map = verified_method->GetDexGcMap();
+  AppendUint32(key, dex_gc_map.size());
+  key->append(reinterpret_cast<const char*>(dex_gc_map.data()), dex_gc_map.size());
+  const VerifiedMethod::SafeCastSet& safe_casts = verified_method->GetSafeCastSet();
+  AppendUint32(key, safe_casts.size());
+  for (uint32_t dex_pc : safe_casts) {
+    AppendUint32(key, dex_pc);
+  }
+  const VerifiedMethod::DevirtualizationMap& devirt_map = verified_method->GetDevirtMap();
+  AppendUint32(key, devirt_map.size());
+  for (const auto& entry : devirt_map) {
+    AppendUint32(key, entry.first);
+    AppendString(key, PrettyMethod(entry.second.dex_method_index, *entry.second.dex_file));
+  }
+
+  ScopedObjectAccess soa(Thread::Current());
+  mirror::DexCache* dex_cache = Runtime::Current()->GetClassLinker()->FindDexCache(dex_file);
+  const DexFile::MethodId& method_id = dex_file.GetMethodId(method_idx);
+  mirror::Class* referrer_class = dex_cache->GetResolvedType(method_id.class_idx_);
+  for (mirror::Class* klass = referrer_class; klass != nullptr; klass = klass->GetSuperClass()) {
+    AppendClass(key, klass);
+  }
+  AppendUint32(key, 0u);
+
+  for (uint32_t dex_pc = 0u; dex_pc < code_item->insns_size_in_code_units_; ) {
+    const Instruction* inst = Instruction::At(code_item->insns_ + dex_pc);
+    int verify_type_b = inst->GetVerifyTypeArgumentB();
+    if (verify_type_b != 0 && verify_type_b != Instruction::kVerifyRegB &&
+        verify_type_b != Instruction::kVerifyRegBWide) {
+      AppendReference(key, verify_type_b, static_cast<uint32_t>(inst->VRegB()), dex_file,
+                      dex_cache);
+    }
+    int verify_type_c = inst->GetVerifyTypeArgumentC();
+    if (verify_type_c != 0 && verify_type_c != Instruction::kVerifyRegC &&
+        verify_type_c != Instruction::kVerifyRegCWide) {
+      AppendReference(key, verify_type_c, static_cast<uint32_t>(inst->VRegC()), dex_file,
+                      dex_cache);
+    }
+    dex_pc += inst->SizeInCodeUnits();
+  }
+  return true;
+}
+
+std::string CompileCache::GetEntryPath(const std::string& key) const {
+  return StringPrintf("%s/%016" PRIx64, directory_.c_str(), HashKey(key));
+}
+
+// Reads the fields of a cache entry, checking that they stay within the entry.
+class EntryReader {
+ public:
+  EntryReader(const uint8_t* begin, const uint8_t* end) : ptr_(begin), end_(end) {}
+
+  bool ReadUint32(uint32_t* value) {
+    if (static_cast<size_t>(end_ - ptr_) < sizeof(*value)) {
+      return false;
+    }
+    memcpy(value, ptr_, sizeof(*value));
+    ptr_ += sizeof(*value);
+    return true;
+  }
+
+  bool ReadBytes(size_t size, const uint8_t** data) {
+    if (static_cast<size_t>(end_ - ptr_) < size) {
+      return false;
+    }
+    *data = ptr_;
+    ptr_ += size;
+    return true;
+  }
+
+  // Reads a table written by AppendTable(), a null table is returned as an empty ArrayRef.
+  bool ReadTable(ArrayRef<const uint8_t>* table) {
+    uint32_t size;
+    const uint8_t* data;
+    if (!ReadUint32(&size)) {
+      return false;
+    }
+    if (size == 0u) {
+      *table = ArrayRef<const uint8_t>();
+      return true;
+    }
+    if (!ReadBytes(size - 1u, &data)) {
+      return false;
+    }
+    // Keep a non-null data pointer for empty tables.
+    *table = ArrayRef<const uint8_t>(data, size - 1u);
+    return true;
+  }
+
+  bool AtEnd() const {
+    return ptr_ == end_;
+  }
+
+ private:
+  const uint8_t* ptr_;
+  const uint8_t* const end_;
+};
+
+static void AppendTable(std::string* entry, const SwapVector<uint8_t>* table) {
+  if (table == nullptr) {
+    AppendUint32(entry, 0u);
+    return;
+  }
+  AppendUint32(entry, table->size() + 1u);
+  entry->append(reinterpret_cast<const char*>(table->data()), table->size());
+}
+
+CompiledMethod* CompileCache::Lookup(CompilerDriver* driver, const std::string& key) {
+  std::string path = GetEntryPath(key);
+  std::unique_ptr<File> file(OS::OpenFileForReading(path.c_str()));
+  if (file.get() == nullptr) {
+    misses_.FetchAndAddSequentiallyConsistent(1u);
+    return nullptr;
+  }
+  int64_t length = file->GetLength();
+  std::vector<uint8_t> data(length > 0 ? length : 0);
+  if (length <= 0 || !file->ReadFully(data.data(), data.size())) {
+    LOG(WARNING) << "Failed to read compile cache entry " << path;
+    misses_.FetchAndAddSequentiallyConsistent(1u);
+    return nullptr;
+  }
+
+  EntryReader reader(data.data(), data.data() + data.size());
+  const uint8_t* magic;
+  uint32_t version;
+  uint32_t key_size;
+  const uint8_t* entry_key;
+  uint32_t instruction_set;
+  uint32_t frame_size_in_bytes;
+  uint32_t core_spill_mask;
+  uint32_t fp_spill_mask;
+  uint32_t src_map_size;
+  if (!reader.ReadBytes(sizeof(kEntryMagic), &magic) ||
+      memcmp(magic, kEntryMagic, sizeof(kEntryMagic)) != 0 ||
+      !reader.ReadUint32(&version) || version != kEntryVersion ||
+      !reader.ReadUint32(&key_size) || key_size != key.size() ||
+      !reader.ReadBytes(key_size, &entry_key) || memcmp(entry_key, key.data(), key_size) != 0 ||
+      !reader.ReadUint32(&instruction_set) ||
+      instruction_set != static_cast<uint32_t>(driver->GetInstructionSet()) ||
+      !reader.ReadUint32(&frame_size_in_bytes) ||
+      !reader.ReadUint32(&core_spill_mask) ||
+      !reader.ReadUint32(&fp_spill_mask) ||
+      !reader.ReadUint32(&src_map_size)) {
+    // A different key with the same hash, or an entry from an older version.
+    misses_.FetchAndAddSequentiallyConsistent(1u);
+    return nullptr;
+  }
+  DefaultSrcMap src_map;
+  for (uint32_t i = 0; i != src_map_size; ++i) {
+    SrcMapElem elem;
+    uint32_t to;
+    if (!reader.ReadUint32(&elem.from_) || !reader.ReadUint32(&to)) {
+      misses_.FetchAndAddSequentiallyConsistent(1u);
+      return nullptr;
+    }
+    elem.to_ = static_cast<int32_t>(to);
+    src_map.push_back(elem);
+  }
+  ArrayRef<const uint8_t> code;
+  ArrayRef<const uint8_t> mapping_table;
+  ArrayRef<const uint8_t> vmap_table;
+  ArrayRef<const uint8_t> gc_map;
+  ArrayRef<const uint8_t> cfi_info;
+  if (!reader.ReadTable(&code) || code.size() == 0u ||
+      !reader.ReadTable(&mapping_table) ||
+      !reader.ReadTable(&vmap_table) ||
+      !reader.ReadTable(&gc_map) ||
+      !reader.ReadTable(&cfi_info) ||
+      !reader.AtEnd()) {
+    LOG(WARNING) << "Corrupt compile cache entry " << path;
+    misses_.FetchAndAddSequentiallyConsistent(1u);
+    return nullptr;
+  }
+  hits_.FetchAndAddSequentiallyConsistent(1u);
+  return CompiledMethod::SwapAllocCompiledMethod(driver,
+                                                 driver->GetInstructionSet(),
+                                                 code,
+                                                 frame_size_in_bytes,
+                                                 core_spill_mask,
+                                                 fp_spill_mask,
+                                                 &src_map,
+                                                 mapping_table,
+                                                 vmap_table,
+                                                 gc_map,
+                                                 cfi_info);
+}
+
+void CompileCache::Insert(const std::string& key, const CompiledMethod& compiled_method) {
+  const SwapVector<uint8_t>* code = compiled_method.GetQuickCode();
+  if (code == nullptr || code->empty()) {
+    return;
+  }
+  std::string entry(reinterpret_cast<const char*>(kEntryMagic), sizeof(kEntryMagic));
+  AppendUint32(&entry, kEntryVersion);
+  AppendString(&entry, key);
+  AppendUint32(&entry, static_cast<uint32_t>(compiled_method.GetInstructionSet()));
+  AppendUint32(&entry, compiled_method.GetFrameSizeInBytes());
+  AppendUint32(&entry, compiled_method.GetCoreSpillMask());
+  AppendUint32(&entry, compiled_method.GetFpSpillMask());
+  const SwapSrcMap& src_map = compiled_method.GetSrcMappingTable();
+  AppendUint32(&entry, src_map.size());
+  for (const SrcMapElem& elem : src_map) {
+    AppendUint32(&entry, elem.from_);
+    AppendUint32(&entry, static_cast<uint32_t>(elem.to_));
+  }
+  AppendTable(&entry, code);
+  AppendTable(&entry, &compiled_method.GetMappingTable());
+  AppendTable(&entry, &compiled_method.GetVmapTable());
+  AppendTable(&entry, &compiled_method.GetGcMap());
+  AppendTable(&entry, compiled_method.GetCFIInfo());
+
+  // Write to a file private to this thread and move it into place, readers in other processes
+  // never see a partial entry.
+  std::string path = GetEntryPath(key);
+  std::string temp_path = StringPrintf("%s.%d.%d.tmp", path.c_str(), getpid(), GetTid());
+  std::unique_ptr<File> file(OS::CreateEmptyFile(temp_path.c_str()));
+  if (file.get() == nullptr) {
+    failed_inserts_.FetchAndAddSequentiallyConsistent(1u);
+    return;
+  }
+  if (!file->WriteFully(entry.data(), entry.size())) {
+    file->Erase();
+    unlink(temp_path.c_str());
+    failed_inserts_.FetchAndAddSequentiallyConsistent(1u);
+    return;
+  }
+  if (file->FlushCloseOrErase() != 0 || rename(temp_path.c_str(), path.c_str()) != 0) {
+    unlink(temp_path.c_str());
+    failed_inserts_.FetchAndAddSequentiallyConsistent(1u);
+    return;
+  }
+  inserts_.FetchAndAddSequentiallyConsistent(1u);
+}
+
+std::string CompileCache::DumpStats() const {
+  size_t hits = hits_.LoadRelaxed();
+  size_t misses = misses_.LoadRelaxed();
+  std::ostringstream oss;
+  oss << "Compile cache " << directory_ << ": " << hits << " hits, " << misses << " misses";
+  if (hits + misses != 0u) {
+    oss << " (" << (hits * 100u / (hits + misses)) << "% hit rate)";
+  }
+  oss << ", " << inserts_.LoadRelaxed() << " entries written";
+  if (failed_inserts_.LoadRelaxed() != 0u) {
+    oss << ", " << failed_inserts_.LoadRelaxed() << " failed";
+  }
+  return oss.str();
+}
+
+}  // namespace art
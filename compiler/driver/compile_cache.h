@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_COMPILER_DRIVER_COMPILE_CACHE_H_
+#define ART_COMPILER_DRIVER_COMPILE_CACHE_H_
+
+#include <string>
+
+#include "atomic.h"
+#include "base/macros.h"
+#include "base/mutex.h"
+#include "dex_file.h"
+
+namespace art {
+
+class CompiledMethod;
+class CompilerDriver;
+
+// A content addressed directory of compiled methods shared between dex2oat invocations, so that
+// library code common to many apps is only compiled once.
+//
+// The key of a method contains its code item and everything the compiler looks at while
+// compiling it: the meaning of every string, type, field and method index the code refers to,
+// the resolved field offsets, vtable indices and class states, the code of small callees that
+// may be inlined, the verifier results and the "configuration" describing the compiler, its
+// options and the boot image. Since the compiled code embeds dex indices, a method only hits
+// entries written for a dex file that numbers the referenced entities the same way.
+//
+// Entries are written to a temporary file and renamed into place, so several dex2oat processes
+// may share a directory. Each entry stores its full key, hash collisions are therefore misses.
+class CompileCache {
+ public:
+  CompileCache(const std::string& directory, const std::string& configuration);
+
+  // Computes the key of a method. Returns false if the method cannot be cached.
+  bool GetKey(const CompilerDriver* driver, const DexFile::CodeItem* code_item,
+              uint32_t access_flags, uint32_t method_idx, const DexFile& dex_file,
+              std::string* key) const
+      LOCKS_EXCLUDED(Locks::mutator_lock_);
+
+  // Returns the cached CompiledMethod for "key", or nullptr if there is none.
+  CompiledMethod* Lookup(CompilerDriver* driver, const std::string& key);
+
+  // Stores a newly compiled method under "key".
+  void Insert(const std::string& key, const CompiledMethod& compiled_method);
+
+  const std::string& GetDirectory() const {
+    return directory_;
+  }
+
+  std::string DumpStats() const;
+
+ private:
+  std::string GetEntryPath(const std::string& key) const;
+
+  const std::string directory_;
+  const std::string configuration_;
+
+  Atomic<size_t> hits_;
+  Atomic<size_t> misses_;
+  Atomic<size_t> inserts_;
+  Atomic<size_t> failed_inserts_;
+
+  DISALLOW_COPY_AND_ASSIGN(CompileCache);
+};
+
+}  // namespace art
+
+#endif  // ART_COMPILER_DRIVER_COMPILE_CACHE_H_
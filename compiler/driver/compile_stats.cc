@@ -0,0 +1,295 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "compile_stats.h"
+
+#include <algorithm>
+
+#include "base/stringprintf.h"
+#include "base/timing_logger.h"
+#include "thread.h"
+#include "utils.h"
+
+namespace art {
+
+constexpr size_t CompileStats::kNumSlowestMethods;
+
+static const char* const kOutcomeNames[] = {
+  "compiled",
+  "jni",
+  "reused",
+  "cached",
+  "interpret_only",
+};
+
+static const char* const kBackendNames[] = {
+  "quick",
+  "optimizing",
+  "portable",
+};
+
+static const char* const kArenaAllocKindNames[] = {
+  "misc",
+  "basic_block",
+  "lir",
+  "lir_resource_mask",
+  "mir",
+  "dataflow",
+  "growable_array",
+  "growable_bitmap",
+  "dalvik_to_ssa_map",
+  "debug_info",
+  "successor",
+  "reg_alloc",
+  "data",
+  "predecessors",
+  "stl",
+  "ref_maps",
+};
+
+// Returns "str" as a quoted JSON string.
+static std::string JsonString(const std::string& str) {
+  std::string result("\"");
+  for (char c : str) {
+    if (c == '"' || c == '\\') {
+      result += '\\';
+      result += c;
+    } else if (static_cast<unsigned char>(c) < 0x20u) {
+      result += StringPrintf("\\u%04x", c);
+    } else {
+      result += c;
+    }
+  }
+  result += '"';
+  return result;
+}
+
+CompileStats::CompileStats()
+    : total_method_ns_(0u),
+      range_checks_(0u),
+      range_checks_eliminated_(0u),
+      range_checks_hoisted_(0u),
+      invokes_(0u),
+      inlined_invokes_(0u),
+      allocations_(0u),
+      eliminated_allocations_(0u),
+      register_allocated_methods_(0u),
+      frame_bytes_(0u),
+      spill_slots_(0u),
+      spills_(0u),
+      reloads_(0u),
+      slowest_methods_lock_("compile stats slowest methods lock"),
+      slowest_methods_threshold_ns_(0u),
+      arena_peak_lock_("compile stats arena peak lock"),
+      arena_peak_bytes_(0u),
+      arena_peak_method_(nullptr, 0u) {
+  COMPILE_ASSERT(arraysize(kOutcomeNames) == kNumOutcomes, check_outcome_names);
+  COMPILE_ASSERT(arraysize(kBackendNames) == kNumBackends, check_backend_names);
+  COMPILE_ASSERT(arraysize(kArenaAllocKindNames) == kNumArenaAllocKinds, check_arena_kind_names);
+}
+
+void CompileStats::RecordMethod(MethodReference method_ref, Outcome outcome,
+                                uint64_t duration_ns) {
+  outcomes_[outcome].FetchAndAddSequentiallyConsistent(1u);
+  total_method_ns_.FetchAndAddSequentiallyConsistent(duration_ns);
+  if (duration_ns <= slowest_methods_threshold_ns_.LoadRelaxed()) {
+    return;
+  }
+  SlowMethod slow_method = { method_ref, outcome, duration_ns };
+  MutexLock mu(Thread::Current(), slowest_methods_lock_);
+  if (slowest_methods_.size() == kNumSlowestMethods) {
+    if (duration_ns <= slowest_methods_.front().duration_ns) {
+      return;
+    }
+    std::pop_heap(slowest_methods_.begin(), slowest_methods_.end(), SlowerThan);
+    slowest_methods_.pop_back();
+  }
+  slowest_methods_.push_back(slow_method);
+  std::push_heap(slowest_methods_.begin(), slowest_methods_.end(), SlowerThan);
+  if (slowest_methods_.size() == kNumSlowestMethods) {
+    slowest_methods_threshold_ns_.StoreRelaxed(slowest_methods_.front().duration_ns);
+  }
+}
+
+void CompileStats::RecordBackend(Backend backend) {
+  backends_[backend].FetchAndAddSequentiallyConsistent(1u);
+}
+
+void CompileStats::RecordBoundsChecks(size_t checks, size_t eliminated, size_t hoisted) {
+  range_checks_.FetchAndAddSequentiallyConsistent(checks);
+  range_checks_eliminated_.FetchAndAddSequentiallyConsistent(eliminated);
+  range_checks_hoisted_.FetchAndAddSequentiallyConsistent(hoisted);
+}
+
+void CompileStats::RecordInlining(size_t invokes, size_t inlined) {
+  invokes_.FetchAndAddSequentiallyConsistent(invokes);
+  inlined_invokes_.FetchAndAddSequentiallyConsistent(inlined);
+}
+
+void CompileStats::RecordScalarReplacement(size_t allocations, size_t eliminated) {
+  allocations_.FetchAndAddSequentiallyConsistent(allocations);
+  eliminated_allocations_.FetchAndAddSequentiallyConsistent(eliminated);
+}
+
+void CompileStats::RecordRegisterAllocation(size_t frame_size, size_t spill_slots, size_t spills,
+                                            size_t reloads) {
+  register_allocated_methods_.FetchAndAddSequentiallyConsistent(1u);
+  frame_bytes_.FetchAndAddSequentiallyConsistent(frame_size);
+  spill_slots_.FetchAndAddSequentiallyConsistent(spill_slots);
+  spills_.FetchAndAddSequentiallyConsistent(spills);
+  reloads_.FetchAndAddSequentiallyConsistent(reloads);
+}
+
+void CompileStats::UpdateMax(Atomic<size_t>* max, size_t value) {
+  size_t old_max = max->LoadRelaxed();
+  while (value > old_max && !max->CompareExchangeWeakRelaxed(old_max, value)) {
+    old_max = max->LoadRelaxed();
+  }
+}
+
+void CompileStats::RecordArenaUsage(MethodReference method_ref, size_t bytes_reserved,
+                                    const ArenaAllocatorStats& stats) {
+  if (kArenaAllocatorCountAllocations) {
+    for (size_t i = 0; i != kNumArenaAllocKinds; ++i) {
+      UpdateMax(&arena_peak_bytes_by_kind_[i],
+                stats.BytesAllocatedByKind(static_cast<ArenaAllocKind>(i)));
+    }
+  }
+  if (bytes_reserved <= arena_peak_bytes_.LoadRelaxed()) {
+    return;
+  }
+  MutexLock mu(Thread::Current(), arena_peak_lock_);
+  if (bytes_reserved > arena_peak_bytes_.LoadRelaxed()) {
+    arena_peak_bytes_.StoreRelaxed(bytes_reserved);
+    arena_peak_method_ = method_ref;
+  }
+}
+
+void CompileStats::RecordArenaPoolPeak(const char* phase, size_t bytes) {
+  MutexLock mu(Thread::Current(), arena_peak_lock_);
+  arena_pool_peaks_.push_back(std::make_pair(phase, bytes));
+}
+
+void CompileStats::DumpJson(std::ostream& os, const TimingLogger& timings,
+                            const std::vector<DedupeStats>& dedupe_stats) const {
+  Thread* self = Thread::Current();
+  os << "{\n";
+
+  os << "  \"total_ns\": " << timings.GetTotalNs() << ",\n";
+  os << "  \"phases\": [";
+  TimingLogger::TimingData timing_data(timings.CalculateTimingData());
+  const std::vector<TimingLogger::Timing>& timing_points = timings.GetTimings();
+  size_t depth = 0u;
+  const char* separator = "\n";
+  for (size_t i = 0; i != timing_points.size(); ++i) {
+    if (timing_points[i].IsEndTiming()) {
+      --depth;
+      continue;
+    }
+    os << separator << "    {\"name\": " << JsonString(timing_points[i].GetName())
+       << ", \"depth\": " << depth
+       << ", \"total_ns\": " << timing_data.GetTotalTime(i)
+       << ", \"exclusive_ns\": " << timing_data.GetExclusiveTime(i) << "}";
+    separator = ",\n";
+    ++depth;
+  }
+  os << "\n  ],\n";
+
+  os << "  \"methods\": {";
+  for (size_t i = 0; i != kNumOutcomes; ++i) {
+    os << "\"" << kOutcomeNames[i] << "\": " << outcomes_[i].LoadRelaxed() << ", ";
+  }
+  for (size_t i = 0; i != kNumBackends; ++i) {
+    os << "\"" << kBackendNames[i] << "\": " << backends_[i].LoadRelaxed() << ", ";
+  }
+  os << "\"total_ns\": " << total_method_ns_.LoadRelaxed() << "},\n";
+
+  os << "  \"range_checks\": {\"total\": " << range_checks_.LoadRelaxed()
+     << ", \"eliminated\": " << range_checks_eliminated_.LoadRelaxed()
+     << ", \"hoisted\": " << range_checks_hoisted_.LoadRelaxed() << "},\n";
+
+  os << "  \"inlining\": {\"invokes\": " << invokes_.LoadRelaxed()
+     << ", \"inlined\": " << inlined_invokes_.LoadRelaxed() << "},\n";
+
+  os << "  \"scalar_replacement\": {\"allocations\": " << allocations_.LoadRelaxed()
+     << ", \"eliminated\": " << eliminated_allocations_.LoadRelaxed() << "},\n";
+
+  os << "  \"register_allocation\": {\"methods\": " << register_allocated_methods_.LoadRelaxed()
+     << ", \"frame_bytes\": " << frame_bytes_.LoadRelaxed()
+     << ", \"spill_slots\": " << spill_slots_.LoadRelaxed()
+     << ", \"spills\": " << spills_.LoadRelaxed()
+     << ", \"reloads\": " << reloads_.LoadRelaxed() << "},\n";
+
+  os << "  \"slowest_methods\": [";
+  {
+    MutexLock mu(self, slowest_methods_lock_);
+    std::vector<SlowMethod> slowest_methods(slowest_methods_);
+    std::sort(slowest_methods.begin(), slowest_methods.end(), SlowerThan);
+    separator = "\n";
+    for (const SlowMethod& slow_method : slowest_methods) {
+      os << separator << "    {\"method\": "
+         << JsonString(PrettyMethod(slow_method.method_ref.dex_method_index,
+                                    *slow_method.method_ref.dex_file))
+         << ", \"outcome\": \"" << kOutcomeNames[slow_method.outcome] << "\""
+         << ", \"ns\": " << slow_method.duration_ns << "}";
+      separator = ",\n";
+    }
+  }
+  os << "\n  ],\n";
+
+  os << "  \"arena\": {\"peak_bytes\": " << arena_peak_bytes_.LoadRelaxed();
+  {
+    MutexLock mu(self, arena_peak_lock_);
+    if (arena_peak_method_.dex_file != nullptr) {
+      os << ", \"peak_method\": "
+         << JsonString(PrettyMethod(arena_peak_method_.dex_method_index,
+                                    *arena_peak_method_.dex_file));
+    }
+    os << ", \"pool_peak_bytes\": {";
+    separator = "";
+    for (const std::pair<const char*, size_t>& phase_peak : arena_pool_peaks_) {
+      os << separator << JsonString(phase_peak.first) << ": " << phase_peak.second;
+      separator = ", ";
+    }
+    os << "}";
+  }
+  if (kArenaAllocatorCountAllocations) {
+    os << ", \"peak_bytes_by_kind\": {";
+    for (size_t i = 0; i != kNumArenaAllocKinds; ++i) {
+      os << (i != 0u ? ", " : "") << "\"" << kArenaAllocKindNames[i] << "\": "
+         << arena_peak_bytes_by_kind_[i].LoadRelaxed();
+    }
+    os << "}";
+  }
+  os << "},\n";
+
+  os << "  \"dedupe\": {";
+  separator = "\n";
+  for (const DedupeStats& dedupe : dedupe_stats) {
+    double hit_rate = (dedupe.adds != 0u)
+        ? static_cast<double>(dedupe.adds - dedupe.keys) / dedupe.adds
+        : 0.0;
+    os << separator << "    \"" << dedupe.name << "\": {\"adds\": " << dedupe.adds
+       << ", \"keys\": " << dedupe.keys
+       << ", \"hit_rate\": " << StringPrintf("%.4f", hit_rate) << "}";
+    separator = ",\n";
+  }
+  os << "\n  }\n";
+
+  os << "}\n";
+}
+
+}  // namespace art
@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_COMPILER_DRIVER_COMPILE_STATS_H_
+#define ART_COMPILER_DRIVER_COMPILE_STATS_H_
+
+#include <ostream>
+#include <utility>
+#include <vector>
+
+#include "atomic.h"
+#include "base/macros.h"
+#include "base/mutex.h"
+#include "method_reference.h"
+#include "utils/arena_allocator.h"
+
+namespace art {
+
+class TimingLogger;
+
+// Machine readable statistics of a compilation, written as JSON by --dump-stats-json.
+//
+// Counters are atomics, and locks are only taken for the rare methods that make it into the
+// list of slowest methods or set a new arena peak, so the statistics are cheap enough to always
+// collect.
+class CompileStats {
+ public:
+  // What the CompilerDriver did with a method.
+  enum Outcome {
+    kOutcomeCompiled,         // Compiled by the compiler backend.
+    kOutcomeJni,              // Native method.
+    kOutcomeReused,           // Code reused from a previous oat file.
+    kOutcomeCached,           // Code taken from the compile cache.
+    kOutcomeInterpretOnly,    // Not compiled, possibly dex-to-dex optimized.
+    kNumOutcomes
+  };
+
+  // The backend that generated the code of a compiled method.
+  enum Backend {
+    kBackendQuick,
+    kBackendOptimizing,
+    kBackendPortable,
+    kNumBackends
+  };
+
+  // Counts of a DedupeSet of the CompilerDriver.
+  struct DedupeStats {
+    const char* name;
+    size_t adds;
+    size_t keys;
+  };
+
+  // Number of the slowest methods listed with their compile time.
+  static constexpr size_t kNumSlowestMethods = 32u;
+
+  CompileStats();
+
+  // Records the outcome and the time the driver spent on a method. Thread-safe.
+  void RecordMethod(MethodReference method_ref, Outcome outcome, uint64_t duration_ns)
+      LOCKS_EXCLUDED(slowest_methods_lock_);
+
+  // Records that a backend generated code for a method. Thread-safe.
+  void RecordBackend(Backend backend);
+
+  // Records the range checks of a method and how many of them bounds check elimination removed
+  // or hoisted out of loops. Thread-safe.
+  void RecordBoundsChecks(size_t checks, size_t eliminated, size_t hoisted);
+
+  // Records the invokes of a method compiled by the optimizing compiler and how many of them
+  // it inlined. Thread-safe.
+  void RecordInlining(size_t invokes, size_t inlined);
+
+  // Records the allocations of a method the optimizing compiler tried to remove and how many
+  // of them it removed. Thread-safe.
+  void RecordScalarReplacement(size_t allocations, size_t eliminated);
+
+  // Records the frame size, spill slots, and spill and reload moves of a method whose
+  // registers the optimizing compiler allocated. Thread-safe.
+  void RecordRegisterAllocation(size_t frame_size, size_t spill_slots, size_t spills,
+                                size_t reloads);
+
+  // Records the arenas used by one allocator while compiling a method. Per kind peaks are only
+  // available when kArenaAllocatorCountAllocations is set. Thread-safe.
+  void RecordArenaUsage(MethodReference method_ref, size_t bytes_reserved,
+                        const ArenaAllocatorStats& stats)
+      LOCKS_EXCLUDED(arena_peak_lock_);
+
+  // Records the peak size of the arenas handed out by the ArenaPool during a compilation phase,
+  // over all threads. Thread-safe.
+  void RecordArenaPoolPeak(const char* phase, size_t bytes) LOCKS_EXCLUDED(arena_peak_lock_);
+
+  size_t GetNumMethods(Outcome outcome) const {
+    return outcomes_[outcome].LoadRelaxed();
+  }
+
+  size_t GetNumMethods(Backend backend) const {
+    return backends_[backend].LoadRelaxed();
+  }
+
+  // Writes the statistics, the phases of "timings" and "dedupe_stats" as a JSON object.
+  void DumpJson(std::ostream& os, const TimingLogger& timings,
+                const std::vector<DedupeStats>& dedupe_stats) const
+      LOCKS_EXCLUDED(slowest_methods_lock_, arena_peak_lock_);
+
+ private:
+  struct SlowMethod {
+    MethodReference method_ref;
+    Outcome outcome;
+    uint64_t duration_ns;
+  };
+
+  static bool SlowerThan(const SlowMethod& lhs, const SlowMethod& rhs) {
+    return lhs.duration_ns > rhs.duration_ns;
+  }
+
+  static void UpdateMax(Atomic<size_t>* max, size_t value);
+
+  Atomic<size_t> outcomes_[kNumOutcomes];
+  Atomic<size_t> backends_[kNumBackends];
+  Atomic<uint64_t> total_method_ns_;
+
+  Atomic<size_t> range_checks_;
+  Atomic<size_t> range_checks_eliminated_;
+  Atomic<size_t> range_checks_hoisted_;
+
+  Atomic<size_t> invokes_;
+  Atomic<size_t> inlined_invokes_;
+
+  Atomic<size_t> allocations_;
+  Atomic<size_t> eliminated_allocations_;
+
+  Atomic<size_t> register_allocated_methods_;
+  Atomic<size_t> frame_bytes_;
+  Atomic<size_t> spill_slots_;
+  Atomic<size_t> spills_;
+  Atomic<size_t> reloads_;
+
+  // The slowest methods, a min-heap on the duration once full.
+  mutable Mutex slowest_methods_lock_;
+  std::vector<SlowMethod> slowest_methods_ GUARDED_BY(slowest_methods_lock_);
+  // Duration a method must exceed to enter slowest_methods_.
+  Atomic<uint64_t> slowest_methods_threshold_ns_;
+
+  mutable Mutex arena_peak_lock_;
+  Atomic<size_t> arena_peak_bytes_;
+  MethodReference arena_peak_method_ GUARDED_BY(arena_peak_lock_);
+  Atomic<size_t> arena_peak_bytes_by_kind_[kNumArenaAllocKinds];
+  std::vector<std::pair<const char*, size_t>> arena_pool_peaks_ GUARDED_BY(arena_peak_lock_);
+
+  DISALLOW_COPY_AND_ASSIGN(CompileStats);
+};
+
+}  // namespace art
+
+#endif  // ART_COMPILER_DRIVER_COMPILE_STATS_H_
@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "compile_time_budget.h"
+
+#include <sstream>
+
+#include "base/logging.h"
+#include "base/stringprintf.h"
+#include "dex_instruction-inl.h"
+#include "thread.h"
+#include "utils.h"
+
+namespace art {
+
+// Each branch target starts a basic block, which most passes of the compiler pay for on top of
+// the instructions themselves.
+static constexpr size_t kCostPerBranchTarget = 8u;
+
+// Predictions are only trusted once this many methods have been compiled.
+static constexpr size_t kMinMethodsForPrediction = 16u;
+
+CompileTimeBudget::CompileTimeBudget(uint64_t budget_ms)
+    : budget_ns_(MsToNs(budget_ms)),
+      start_ns_(0u),
+      compiled_methods_(0u),
+      compiled_cost_(0u),
+      compiled_ns_(0u),
+      exhausted_demotions_(0u),
+      predicted_demotions_(0u),
+      demoted_methods_lock_("compile time budget demoted methods lock") {
+}
+
+size_t CompileTimeBudget::EstimateCost(const DexFile::CodeItem* code_item) {
+  if (code_item == nullptr) {
+    return 0u;
+  }
+  const uint16_t* insns = code_item->insns_;
+  size_t branch_targets = 0u;
+  size_t dex_pc = 0u;
+  while (dex_pc < code_item->insns_size_in_code_units_) {
+    const Instruction* inst = Instruction::At(insns + dex_pc);
+    if (inst->IsSwitch()) {
+      // The second code unit of a switch payload holds the number of cases.
+      const uint16_t* payload = insns + dex_pc + inst->VRegB_31t();
+      branch_targets += payload[1];
+    } else if (inst->IsBranch()) {
+      ++branch_targets;
+    }
+    dex_pc += inst->SizeInCodeUnits();
+  }
+  return code_item->insns_size_in_code_units_ + kCostPerBranchTarget * branch_targets;
+}
+
+void CompileTimeBudget::Start() {
+  start_ns_ = NanoTime();
+}
+
+bool CompileTimeBudget::ShouldCompile(MethodReference method_ref, size_t cost) {
+  uint64_t elapsed_ns = NanoTime() - start_ns_;
+  if (elapsed_ns >= budget_ns_) {
+    exhausted_demotions_.FetchAndAddSequentiallyConsistent(1u);
+    Demote(method_ref, cost, StringPrintf("budget exhausted after %s",
+                                          PrettyDuration(elapsed_ns).c_str()));
+    return false;
+  }
+  size_t compiled_methods = compiled_methods_.LoadRelaxed();
+  uint64_t compiled_cost = compiled_cost_.LoadRelaxed();
+  if (compiled_methods >= kMinMethodsForPrediction && compiled_cost != 0u) {
+    double ns_per_cost = static_cast<double>(compiled_ns_.LoadRelaxed()) / compiled_cost;
+    uint64_t predicted_ns = static_cast<uint64_t>(ns_per_cost * cost);
+    uint64_t remaining_ns = budget_ns_ - elapsed_ns;
+    if (predicted_ns > remaining_ns) {
+      predicted_demotions_.FetchAndAddSequentiallyConsistent(1u);
+      Demote(method_ref, cost, StringPrintf("predicted %s exceeds remaining %s",
+                                            PrettyDuration(predicted_ns).c_str(),
+                                            PrettyDuration(remaining_ns).c_str()));
+      return false;
+    }
+  }
+  return true;
+}
+
+void CompileTimeBudget::RecordCompilation(size_t cost, uint64_t duration_ns) {
+  compiled_methods_.FetchAndAddSequentiallyConsistent(1u);
+  compiled_cost_.FetchAndAddSequentiallyConsistent(cost);
+  compiled_ns_.FetchAndAddSequentiallyConsistent(duration_ns);
+}
+
+void CompileTimeBudget::Demote(MethodReference method_ref, size_t cost,
+                               const std::string& reason) {
+  DemotedMethod demoted = { method_ref, cost, reason };
+  MutexLock mu(Thread::Current(), demoted_methods_lock_);
+  demoted_methods_.push_back(demoted);
+}
+
+size_t CompileTimeBudget::GetNumDemotedMethods() const {
+  MutexLock mu(Thread::Current(), demoted_methods_lock_);
+  return demoted_methods_.size();
+}
+
+void CompileTimeBudget::LogDemotedMethods() const {
+  MutexLock mu(Thread::Current(), demoted_methods_lock_);
+  for (const DemotedMethod& demoted : demoted_methods_) {
+    LOG(INFO) << "Demoted " << PrettyMethod(demoted.method_ref.dex_method_index,
+                                            *demoted.method_ref.dex_file)
+              << " (cost " << demoted.cost << ") to interpret-only: " << demoted.reason;
+  }
+}
+
+std::string CompileTimeBudget::DumpStats() const {
+  std::ostringstream oss;
+  oss << "Compile time budget " << PrettyDuration(budget_ns_) << ": "
+      << compiled_methods_.LoadRelaxed() << " methods compiled in "
+      << PrettyDuration(compiled_ns_.LoadRelaxed()) << " of compiler time, "
+      << exhausted_demotions_.LoadRelaxed() << " demoted after the budget was exhausted, "
+      << predicted_demotions_.LoadRelaxed() << " demoted as predicted to exceed it";
+  return oss.str();
+}
+
+}  // namespace art
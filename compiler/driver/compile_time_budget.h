@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_COMPILER_DRIVER_COMPILE_TIME_BUDGET_H_
+#define ART_COMPILER_DRIVER_COMPILE_TIME_BUDGET_H_
+
+#include <string>
+#include <vector>
+
+#include "atomic.h"
+#include "base/macros.h"
+#include "base/mutex.h"
+#include "dex_file.h"
+#include "method_reference.h"
+
+namespace art {
+
+// Bounds the wall clock time the CompilerDriver spends compiling methods. The driver compiles
+// methods hot in the profile first and otherwise the cheapest first, and asks the budget before
+// each method whether to compile it. Once the budget is exhausted, or once the time a method is
+// predicted to take exceeds what is left of it, the method is demoted to interpret-only.
+//
+// The cost of a method is estimated from its code item alone, and converted to a predicted time
+// using the time per cost unit observed on the methods compiled so far.
+class CompileTimeBudget {
+ public:
+  explicit CompileTimeBudget(uint64_t budget_ms);
+
+  // Returns the estimated cost of compiling "code_item", in code units. Every branch target,
+  // including each case of a switch, adds to the code size.
+  static size_t EstimateCost(const DexFile::CodeItem* code_item);
+
+  // Starts the clock.
+  void Start();
+
+  // Returns true if a method of the given cost should be compiled. Otherwise records why the
+  // method is demoted. Thread-safe.
+  bool ShouldCompile(MethodReference method_ref, size_t cost)
+      LOCKS_EXCLUDED(demoted_methods_lock_);
+
+  // Records that a method of the given cost took "duration_ns" to compile. Thread-safe.
+  void RecordCompilation(size_t cost, uint64_t duration_ns);
+
+  size_t GetNumDemotedMethods() const LOCKS_EXCLUDED(demoted_methods_lock_);
+
+  // Logs every demoted method and the reason for its demotion.
+  void LogDemotedMethods() const LOCKS_EXCLUDED(demoted_methods_lock_);
+
+  std::string DumpStats() const;
+
+ private:
+  struct DemotedMethod {
+    MethodReference method_ref;
+    size_t cost;
+    std::string reason;
+  };
+
+  void Demote(MethodReference method_ref, size_t cost, const std::string& reason)
+      LOCKS_EXCLUDED(demoted_methods_lock_);
+
+  const uint64_t budget_ns_;
+  uint64_t start_ns_;
+
+  Atomic<size_t> compiled_methods_;
+  Atomic<uint64_t> compiled_cost_;
+  Atomic<uint64_t> compiled_ns_;
+  Atomic<size_t> exhausted_demotions_;
+  Atomic<size_t> predicted_demotions_;
+
+  mutable Mutex demoted_methods_lock_;
+  std::vector<DemotedMethod> demoted_methods_ GUARDED_BY(demoted_methods_lock_);
+
+  DISALLOW_COPY_AND_ASSIGN(CompileTimeBudget);
+};
+
+}  // namespace art
+
+#endif  // ART_COMPILER_DRIVER_COMPILE_TIME_BUDGET_H_
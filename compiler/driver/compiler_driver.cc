@@ -19,6 +19,7 @@
 #define ATRACE_TAG ATRACE_TAG_DALVIK
 #include <utils/Trace.h>
 
+#include <algorithm>
 #include <vector>
 #include <unistd.h>
 
@@ -69,6 +70,10 @@ namespace art {
 
 static constexpr bool kTimeCompileMethod = !kIsDebugBuild;
 
+// Bytes of free arenas the driver's pool keeps resident beyond its thread caches, the rest is
+// returned to the system after compiling unusually large methods.
+static constexpr size_t kArenaPoolReleaseWatermark = 16 * MB;
+
 static double Percentage(size_t x, size_t y) {
   return 100.0 * (static_cast<double>(x)) / (static_cast<double>(x + y));
 }
@@ -90,7 +95,11 @@ class CompilerDriver::AOTCompilationStats {
         resolved_instance_fields_(0), unresolved_instance_fields_(0),
         resolved_local_static_fields_(0), resolved_static_fields_(0), unresolved_static_fields_(0),
         type_based_devirtualization_(0),
-        safe_casts_(0), not_safe_casts_(0) {
+        safe_casts_(0), not_safe_casts_(0),
+        range_checks_(0), range_checks_eliminated_(0), range_checks_hoisted_(0),
+        optimizing_invokes_(0), optimizing_inlined_invokes_(0),
+        optimizing_allocations_(0), optimizing_eliminated_allocations_(0),
+        monomorphic_guarded_invokes_(0), bimorphic_guarded_invokes_(0) {
     for (size_t i = 0; i <= kMaxInvokeType; i++) {
       resolved_methods_[i] = 0;
       unresolved_methods_[i] = 0;
@@ -110,6 +119,17 @@ class CompilerDriver::AOTCompilationStats {
     DumpStat(resolved_local_static_fields_, resolved_static_fields_ + unresolved_static_fields_,
              "static fields local to a class");
     DumpStat(safe_casts_, not_safe_casts_, "check-casts removed based on type information");
+    DumpStat(range_checks_eliminated_, range_checks_ - range_checks_eliminated_,
+             "array range checks eliminated");
+    DumpStat(range_checks_hoisted_, range_checks_ - range_checks_hoisted_,
+             "array range checks hoisted out of loops");
+    DumpStat(optimizing_inlined_invokes_, optimizing_invokes_ - optimizing_inlined_invokes_,
+             "invokes inlined by the optimizing compiler");
+    DumpStat(optimizing_eliminated_allocations_,
+             optimizing_allocations_ - optimizing_eliminated_allocations_,
+             "allocations eliminated by the optimizing compiler");
+    DumpStat(monomorphic_guarded_invokes_, bimorphic_guarded_invokes_,
+             "invokes guarded by the profiled receiver class that are monomorphic");
     // Note, the code below subtracts the stat value so that when added to the stat value we have
     // 100% of samples. TODO: clean this up.
     DumpStat(type_based_devirtualization_,
@@ -287,6 +307,38 @@ class CompilerDriver::AOTCompilationStats {
     not_safe_casts_++;
   }
 
+  // Range checks of a method, and the ones bounds check elimination removed.
+  void ProcessedBoundsChecks(size_t checks, size_t eliminated, size_t hoisted) {
+    STATS_LOCK();
+    range_checks_ += checks;
+    range_checks_eliminated_ += eliminated;
+    range_checks_hoisted_ += hoisted;
+  }
+
+  // Invokes seen by the optimizing compiler, and the ones it inlined.
+  void ProcessedInlining(size_t invokes, size_t inlined) {
+    STATS_LOCK();
+    optimizing_invokes_ += invokes;
+    optimizing_inlined_invokes_ += inlined;
+  }
+
+  // Allocations the optimizing compiler tried to remove, and the ones it removed.
+  void ProcessedAllocations(size_t allocations, size_t eliminated) {
+    STATS_LOCK();
+    optimizing_allocations_ += allocations;
+    optimizing_eliminated_allocations_ += eliminated;
+  }
+
+  // An invoke guarded by the profiled classes of its receiver.
+  void ProcessedGuardedInvoke(size_t num_targets) {
+    STATS_LOCK();
+    if (num_targets == 1u) {
+      monomorphic_guarded_invokes_++;
+    } else {
+      bimorphic_guarded_invokes_++;
+    }
+  }
+
  private:
   Mutex stats_lock_;
 
@@ -317,6 +369,19 @@ class CompilerDriver::AOTCompilationStats {
   size_t safe_casts_;
   size_t not_safe_casts_;
 
+  size_t range_checks_;
+  size_t range_checks_eliminated_;
+  size_t range_checks_hoisted_;
+
+  size_t optimizing_invokes_;
+  size_t optimizing_inlined_invokes_;
+
+  size_t optimizing_allocations_;
+  size_t optimizing_eliminated_allocations_;
+
+  size_t monomorphic_guarded_invokes_;
+  size_t bimorphic_guarded_invokes_;
+
   DISALLOW_COPY_AND_ASSIGN(AOTCompilationStats);
 };
 
@@ -330,6 +395,12 @@ extern "C" art::CompiledMethod* ArtCompileDEX(art::CompilerDriver& compiler,
                                               jobject class_loader,
                                               const art::DexFile& dex_file);
 
+// Returns the number of shards of the dedupe sets, enough to keep the compiler threads from
+// contending on the same tables.
+static size_t DedupeShards(size_t thread_count) {
+  return RoundUpToPowerOfTwo(std::max<size_t>(thread_count, 1u) * 4u);
+}
+
 CompilerDriver::CompilerDriver(const CompilerOptions* compiler_options,
                                VerificationResults* verification_results,
                                DexFileToMethodInlinerMap* method_inliner_map,
@@ -342,7 +413,9 @@ CompilerDriver::CompilerDriver(const CompilerOptions* compiler_options,
                                int swap_fd, std::string profile_file)
     : swap_space_(swap_fd == -1 ? nullptr : new SwapSpace(swap_fd, 10 * MB)),
       swap_space_allocator_(new SwapAllocator<void>(swap_space_.get())),
-      profile_present_(false), compiler_options_(compiler_options),
+      profile_present_(false),
+      queued_methods_lock_("queued methods lock"),
+      compiler_options_(compiler_options),
       verification_results_(verification_results),
       method_inliner_map_(method_inliner_map),
       compiler_(Compiler::Create(this, compiler_kind)),
@@ -363,16 +436,17 @@ CompilerDriver::CompilerDriver(const CompilerOptions* compiler_options,
       timings_logger_(timer),
       compiler_library_(nullptr),
       compiler_context_(nullptr),
+      arena_pool_(kArenaPoolReleaseWatermark),
       compiler_enable_auto_elf_loading_(nullptr),
       compiler_get_method_code_addr_(nullptr),
       support_boot_image_fixup_(instruction_set != kMips),
       // Use actual deduping only if we don't use swap.
-      dedupe_code_("dedupe code", *swap_space_allocator_),
-      dedupe_src_mapping_table_("dedupe source mapping table", *swap_space_allocator_),
-      dedupe_mapping_table_("dedupe mapping table", *swap_space_allocator_),
-      dedupe_vmap_table_("dedupe vmap table", *swap_space_allocator_),
-      dedupe_gc_map_("dedupe gc map", *swap_space_allocator_),
-      dedupe_cfi_info_("dedupe cfi info", *swap_space_allocator_) {
+      dedupe_code_(*swap_space_allocator_, DedupeShards(thread_count)),
+      dedupe_src_mapping_table_(*swap_space_allocator_, DedupeShards(thread_count)),
+      dedupe_mapping_table_(*swap_space_allocator_, DedupeShards(thread_count)),
+      dedupe_vmap_table_(*swap_space_allocator_, DedupeShards(thread_count)),
+      dedupe_gc_map_(*swap_space_allocator_, DedupeShards(thread_count)),
+      dedupe_cfi_info_(*swap_space_allocator_, DedupeShards(thread_count)) {
   DCHECK(compiler_options_ != nullptr);
   DCHECK(verification_results_ != nullptr);
   DCHECK(method_inliner_map_ != nullptr);
@@ -510,13 +584,22 @@ void CompilerDriver::CompileAll(jobject class_loader,
   std::unique_ptr<ThreadPool> thread_pool(new ThreadPool("Compiler driver thread pool", thread_count_ - 1));
   VLOG(compiler) << "Before precompile " << GetMemoryUsageString(false);
   PreCompile(class_loader, dex_files, thread_pool.get(), timings);
+  RecordArenaPoolPeak("PreCompile");
   Compile(class_loader, dex_files, thread_pool.get(), timings);
+  RecordArenaPoolPeak("Compile");
   if (dump_stats_) {
     stats_->Dump();
     Selectivity::DumpSelectivityStats();
   }
 }
 
+void CompilerDriver::RecordArenaPoolPeak(const char* phase) {
+  if (compile_stats_.get() != nullptr) {
+    compile_stats_->RecordArenaPoolPeak(phase, arena_pool_.GetPeakBytesInUse());
+  }
+  arena_pool_.ResetPeakBytesInUse();
+}
+
 static DexToDexCompilationLevel GetDexToDexCompilationlevel(
     Thread* self, Handle<mirror::ClassLoader> class_loader, const DexFile& dex_file,
     const DexFile::ClassDef& class_def) SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
@@ -1067,6 +1150,31 @@ void CompilerDriver::ProcessedInvoke(InvokeType invoke_type, int flags) {
   stats_->ProcessedInvoke(invoke_type, flags);
 }
 
+void CompilerDriver::ProcessedBoundsChecks(size_t checks, size_t eliminated, size_t hoisted) {
+  stats_->ProcessedBoundsChecks(checks, eliminated, hoisted);
+  if (compile_stats_ != nullptr) {
+    compile_stats_->RecordBoundsChecks(checks, eliminated, hoisted);
+  }
+}
+
+void CompilerDriver::ProcessedInlining(size_t invokes, size_t inlined) {
+  stats_->ProcessedInlining(invokes, inlined);
+  if (compile_stats_ != nullptr) {
+    compile_stats_->RecordInlining(invokes, inlined);
+  }
+}
+
+void CompilerDriver::ProcessedAllocations(size_t allocations, size_t eliminated) {
+  stats_->ProcessedAllocations(allocations, eliminated);
+  if (compile_stats_ != nullptr) {
+    compile_stats_->RecordScalarReplacement(allocations, eliminated);
+  }
+}
+
+void CompilerDriver::ProcessedGuardedInvoke(size_t num_targets) {
+  stats_->ProcessedGuardedInvoke(num_targets);
+}
+
 mirror::ArtField* CompilerDriver::ComputeInstanceFieldInfo(uint32_t field_idx,
                                                            const DexCompilationUnit* mUnit,
                                                            bool is_put,
@@ -1348,6 +1456,92 @@ bool CompilerDriver::ComputeInvokeInfo(const DexCompilationUnit* mUnit, const ui
   return result;
 }
 
+size_t CompilerDriver::ComputeProfiledInvokeTargets(const DexCompilationUnit* mUnit,
+                                                    uint32_t dex_pc, uint32_t method_idx,
+                                                    InvokeType invoke_type,
+                                                    ProfiledInvokeTarget* targets) {
+  DCHECK(invoke_type == kVirtual || invoke_type == kInterface);
+  if (!profile_present_) {
+    return 0u;
+  }
+  const DexFile* dex_file = mUnit->GetDexFile();
+  const ProfileFile::ReceiverCounts* receivers = profile_file_.GetReceiverCounts(
+      PrettyMethod(mUnit->GetDexMethodIndex(), *dex_file), dex_pc);
+  if (receivers == nullptr) {
+    return 0u;
+  }
+  // Guard the classes that make up most of the samples, most frequent first.
+  static constexpr uint32_t kMinCoveragePercent = 90u;
+  uint64_t total_count = 0u;
+  for (const auto& receiver : *receivers) {
+    total_count += receiver.second;
+  }
+  size_t num_targets = 0u;
+  uint64_t covered_count = 0u;
+  while (num_targets != receivers->size() &&
+         covered_count * 100u < total_count * kMinCoveragePercent) {
+    covered_count += (*receivers)[num_targets].second;
+    ++num_targets;
+  }
+  if (num_targets == 0u || num_targets > kMaxProfiledInvokeTargets) {
+    return 0u;
+  }
+
+  ScopedObjectAccess soa(Thread::Current());
+  StackHandleScope<4> hs(soa.Self());
+  Handle<mirror::DexCache> dex_cache(hs.NewHandle(GetDexCache(mUnit)));
+  Handle<mirror::ClassLoader> class_loader(hs.NewHandle(GetClassLoader(soa, mUnit)));
+  Handle<mirror::ArtMethod> resolved_method(hs.NewHandle(
+      ResolveMethod(soa, dex_cache, class_loader, mUnit, method_idx, invoke_type)));
+  if (resolved_method.Get() == nullptr) {
+    return 0u;
+  }
+  Handle<mirror::Class> referrer_class(hs.NewHandle(
+      ResolveCompilingMethodsClass(soa, dex_cache, class_loader, mUnit)));
+  ClassLinker* class_linker = mUnit->GetClassLinker();
+  for (size_t i = 0; i != num_targets; ++i) {
+    // The guard loads the class from the dex cache of the compiling method, so the class must
+    // be referenced by its dex file.
+    const std::string& descriptor = (*receivers)[i].first;
+    const DexFile::StringId* string_id = dex_file->FindStringId(descriptor.c_str());
+    const DexFile::TypeId* type_id =
+        (string_id != nullptr) ? dex_file->FindTypeId(dex_file->GetIndexForStringId(*string_id))
+                               : nullptr;
+    if (type_id == nullptr) {
+      return 0u;
+    }
+    uint16_t type_idx = dex_file->GetIndexForTypeId(*type_id);
+    mirror::Class* klass = class_linker->ResolveType(*dex_file, type_idx, dex_cache, class_loader);
+    if (klass == nullptr) {
+      soa.Self()->ClearException();
+      return 0u;
+    }
+    if (!klass->IsInstantiable() || klass->IsProxyClass() ||
+        !resolved_method->GetDeclaringClass()->IsAssignableFrom(klass)) {
+      return 0u;
+    }
+    mirror::ArtMethod* called_method =
+        klass->FindVirtualMethodForVirtualOrInterface(resolved_method.Get());
+    if (called_method == nullptr || called_method->IsAbstract()) {
+      return 0u;
+    }
+    // Let IsFastInvoke() sharpen the invoke as it does for a devirtualization proven by the
+    // verifier.
+    MethodReference devirt_target(called_method->GetDexFile(), called_method->GetDexMethodIndex());
+    InvokeType sharp_type = invoke_type;
+    targets[i].class_type_idx = type_idx;
+    targets[i].target_method = MethodReference(dex_file, method_idx);
+    int flags = IsFastInvoke(soa, dex_cache, class_loader, mUnit, referrer_class.Get(),
+                             resolved_method.Get(), &sharp_type, &targets[i].target_method,
+                             &devirt_target, &targets[i].direct_code, &targets[i].direct_method,
+                             nullptr);
+    if (flags == 0 || sharp_type != kDirect) {
+      return 0u;
+    }
+  }
+  return num_targets;
+}
+
 const VerifiedMethod* CompilerDriver::GetVerifiedMethod(const DexFile* dex_file,
                                                         uint32_t method_idx) const {
   MethodReference ref(dex_file, method_idx);
@@ -1453,6 +1647,7 @@ void CompilerDriver::AddStringPatch(const DexFile* dex_file,
 class ParallelCompilationManager {
  public:
   typedef void Callback(const ParallelCompilationManager* manager, size_t index);
+  typedef size_t CostFunction(const DexFile& dex_file, size_t index);
 
   ParallelCompilationManager(ClassLinker* class_linker,
                              jobject class_loader,
@@ -1460,7 +1655,7 @@ class ParallelCompilationManager {
                              const DexFile* dex_file,
                              const std::vector<const DexFile*>& dex_files,
                              ThreadPool* thread_pool)
-    : index_(0),
+    : num_work_queues_(0u),
       class_linker_(class_linker),
       class_loader_(class_loader),
       compiler_(compiler),
@@ -1492,13 +1687,42 @@ class ParallelCompilationManager {
   }
 
   void ForAll(size_t begin, size_t end, Callback callback, size_t work_units) {
+    ForAll(begin, end, callback, nullptr, work_units);
+  }
+
+  // Like ForAll above, but starts the indices with the highest "cost" first so that long running
+  // work items do not end up at the tail of the phase.
+  void ForAll(size_t begin, size_t end, Callback callback, CostFunction* cost, size_t work_units) {
     Thread* self = Thread::Current();
     self->AssertNoPendingException();
     CHECK_GT(work_units, 0U);
+    CHECK_LE(begin, end);
+
+    std::vector<size_t> order;
+    order.reserve(end - begin);
+    for (size_t i = begin; i != end; ++i) {
+      order.push_back(i);
+    }
+    if (cost != nullptr) {
+      std::vector<size_t> costs;
+      costs.reserve(end - begin);
+      for (size_t i = begin; i != end; ++i) {
+        costs.push_back(cost(*dex_file_, i));
+      }
+      std::stable_sort(order.begin(), order.end(), [&costs, begin](size_t lhs, size_t rhs) {
+        return costs[lhs - begin] > costs[rhs - begin];
+      });
+    }
 
-    index_.StoreRelaxed(begin);
+    // Deal the indices to the per-worker queues round-robin, so that every worker starts with its
+    // share of the expensive ones. Workers that run out of work steal from the others.
+    num_work_queues_ = work_units;
+    work_queues_.reset(new WorkQueue[work_units]);
+    for (size_t i = 0; i != order.size(); ++i) {
+      work_queues_[i % work_units].indices.push_back(order[i]);
+    }
     for (size_t i = 0; i < work_units; ++i) {
-      thread_pool_->AddTask(self, new ForAllClosure(this, end, callback));
+      thread_pool_->AddTask(self, new ForAllClosure(this, i, callback));
     }
     thread_pool_->StartWorkers(self);
 
@@ -1508,26 +1732,38 @@ class ParallelCompilationManager {
 
     // Wait for all the worker threads to finish.
     thread_pool_->Wait(self, true, false);
+    work_queues_.reset();
+    num_work_queues_ = 0u;
   }
 
-  size_t NextIndex() {
-    return index_.FetchAndAddSequentiallyConsistent(1);
+  // Claims the next index for the given worker, from its own queue if possible and otherwise from
+  // the queue of another worker. Returns false when all queues are empty.
+  bool NextIndex(size_t worker, size_t* index) {
+    for (size_t i = 0; i != num_work_queues_; ++i) {
+      WorkQueue* queue = &work_queues_[(worker + i) % num_work_queues_];
+      if (queue->next.LoadRelaxed() >= queue->indices.size()) {
+        continue;
+      }
+      size_t position = queue->next.FetchAndAddSequentiallyConsistent(1);
+      if (position < queue->indices.size()) {
+        *index = queue->indices[position];
+        return true;
+      }
+    }
+    return false;
   }
 
  private:
   class ForAllClosure : public Task {
    public:
-    ForAllClosure(ParallelCompilationManager* manager, size_t end, Callback* callback)
+    ForAllClosure(ParallelCompilationManager* manager, size_t worker, Callback* callback)
         : manager_(manager),
-          end_(end),
+          worker_(worker),
           callback_(callback) {}
 
     virtual void Run(Thread* self) {
-      while (true) {
-        const size_t index = manager_->NextIndex();
-        if (UNLIKELY(index >= end_)) {
-          break;
-        }
+      size_t index;
+      while (manager_->NextIndex(worker_, &index)) {
         callback_(manager_, index);
         self->AssertNoPendingException();
       }
@@ -1539,11 +1775,20 @@ class ParallelCompilationManager {
 
    private:
     ParallelCompilationManager* const manager_;
-    const size_t end_;
+    const size_t worker_;
     Callback* const callback_;
   };
 
-  AtomicInteger index_;
+  // Indices assigned to a worker. Claimed from the front by the owner as well as by thieves.
+  struct WorkQueue {
+    WorkQueue() : next(0u) {}
+
+    std::vector<size_t> indices;
+    Atomic<size_t> next;
+  };
+
+  std::unique_ptr<WorkQueue[]> work_queues_;
+  size_t num_work_queues_;
   ClassLinker* const class_linker_;
   const jobject class_loader_;
   CompilerDriver* const compiler_;
@@ -1554,6 +1799,27 @@ class ParallelCompilationManager {
   DISALLOW_COPY_AND_ASSIGN(ParallelCompilationManager);
 };
 
+// Returns the total number of code units of the methods of a class, an estimate of the time
+// needed to verify and compile it.
+static size_t ClassDefCodeSize(const DexFile& dex_file, size_t class_def_index) {
+  const byte* class_data = dex_file.GetClassData(dex_file.GetClassDef(class_def_index));
+  if (class_data == nullptr) {
+    return 0u;
+  }
+  ClassDataItemIterator it(dex_file, class_data);
+  while (it.HasNextStaticField() || it.HasNextInstanceField()) {
+    it.Next();
+  }
+  size_t code_size = 0u;
+  for (; it.HasNext(); it.Next()) {
+    const DexFile::CodeItem* code_item = it.GetMethodCodeItem();
+    if (code_item != nullptr) {
+      code_size += code_item->insns_size_in_code_units_;
+    }
+  }
+  return code_size;
+}
+
 // Return true if the method should be skipped during compilation.
 //
 // The logic that determines if we should skip is a function pointer set
@@ -1860,7 +2126,7 @@ void CompilerDriver::VerifyDexFile(jobject class_loader, const DexFile& dex_file
   ClassLinker* class_linker = Runtime::Current()->GetClassLinker();
   ParallelCompilationManager context(class_linker, class_loader, this, &dex_file, dex_files,
                                      thread_pool);
-  context.ForAll(0, dex_file.NumClassDefs(), VerifyClass, thread_count_);
+  context.ForAll(0, dex_file.NumClassDefs(), VerifyClass, ClassDefCodeSize, thread_count_);
 }
 
 static void SetVerifiedClass(const ParallelCompilationManager* manager, size_t class_def_index)
@@ -2025,11 +2291,26 @@ void CompilerDriver::InitializeClasses(jobject class_loader,
 
 void CompilerDriver::Compile(jobject class_loader, const std::vector<const DexFile*>& dex_files,
                              ThreadPool* thread_pool, TimingLogger* timings) {
+  if (reusable_oat_file_.get() != nullptr) {
+    TimingLogger::ScopedTiming t("Match reusable oat file", timings);
+    reusable_oat_file_->MatchDexFiles(dex_files);
+  }
+  if (compile_time_budget_.get() != nullptr) {
+    compile_time_budget_->Start();
+  }
   for (size_t i = 0; i != dex_files.size(); ++i) {
     const DexFile* dex_file = dex_files[i];
     CHECK(dex_file != nullptr);
     CompileDexFile(class_loader, *dex_file, dex_files, thread_pool, timings);
   }
+  if (compile_time_budget_.get() != nullptr) {
+    CompileQueuedMethods(class_loader, dex_files, thread_pool, timings);
+    compile_time_budget_->LogDemotedMethods();
+    LOG(INFO) << compile_time_budget_->DumpStats();
+  }
+  if (reusable_oat_file_.get() != nullptr) {
+    LOG(INFO) << "Incremental compilation " << reusable_oat_file_->DumpStats();
+  }
   VLOG(compiler) << "Compile: " << GetMemoryUsageString(false);
 }
 
@@ -2100,10 +2381,10 @@ void CompilerDriver::CompileClass(const ParallelCompilationManager* manager, siz
       continue;
     }
     previous_direct_method_idx = method_idx;
-    driver->CompileMethod(it.GetMethodCodeItem(), it.GetMethodAccessFlags(),
-                          it.GetMethodInvokeType(class_def), class_def_index,
-                          method_idx, jclass_loader, dex_file, dex_to_dex_compilation_level,
-                          compilation_enabled);
+    driver->CompileOrQueueMethod(it.GetMethodCodeItem(), it.GetMethodAccessFlags(),
+                                 it.GetMethodInvokeType(class_def), class_def_index,
+                                 method_idx, jclass_loader, dex_file,
+                                 dex_to_dex_compilation_level, compilation_enabled);
     it.Next();
   }
   // Compile virtual methods
@@ -2117,10 +2398,10 @@ void CompilerDriver::CompileClass(const ParallelCompilationManager* manager, siz
       continue;
     }
     previous_virtual_method_idx = method_idx;
-    driver->CompileMethod(it.GetMethodCodeItem(), it.GetMethodAccessFlags(),
-                          it.GetMethodInvokeType(class_def), class_def_index,
-                          method_idx, jclass_loader, dex_file, dex_to_dex_compilation_level,
-                          compilation_enabled);
+    driver->CompileOrQueueMethod(it.GetMethodCodeItem(), it.GetMethodAccessFlags(),
+                                 it.GetMethodInvokeType(class_def), class_def_index,
+                                 method_idx, jclass_loader, dex_file,
+                                 dex_to_dex_compilation_level, compilation_enabled);
     it.Next();
   }
   DCHECK(!it.HasNext());
@@ -2132,7 +2413,98 @@ void CompilerDriver::CompileDexFile(jobject class_loader, const DexFile& dex_fil
   TimingLogger::ScopedTiming t("Compile Dex File", timings);
   ParallelCompilationManager context(Runtime::Current()->GetClassLinker(), class_loader, this,
                                      &dex_file, dex_files, thread_pool);
-  context.ForAll(0, dex_file.NumClassDefs(), CompilerDriver::CompileClass, thread_count_);
+  context.ForAll(0, dex_file.NumClassDefs(), CompilerDriver::CompileClass, ClassDefCodeSize,
+                 thread_count_);
+}
+
+void CompilerDriver::CompileOrQueueMethod(const DexFile::CodeItem* code_item,
+                                          uint32_t access_flags, InvokeType invoke_type,
+                                          uint16_t class_def_idx, uint32_t method_idx,
+                                          jobject class_loader, const DexFile& dex_file,
+                                          DexToDexCompilationLevel dex_to_dex_compilation_level,
+                                          bool compilation_enabled) {
+  if (compile_time_budget_.get() == nullptr) {
+    CompileMethod(code_item, access_flags, invoke_type, class_def_idx, method_idx, class_loader,
+                  dex_file, dex_to_dex_compilation_level, compilation_enabled);
+    return;
+  }
+  QueuedMethod queued_method = {
+      code_item, access_flags, invoke_type, class_def_idx, method_idx, &dex_file,
+      dex_to_dex_compilation_level, compilation_enabled,
+      0u,  // dex_file_index, set by CompileQueuedMethods.
+      GetProfileSampleCount(MethodReference(&dex_file, method_idx)),
+      CompileTimeBudget::EstimateCost(code_item)
+  };
+  MutexLock mu(Thread::Current(), queued_methods_lock_);
+  queued_methods_.push_back(queued_method);
+}
+
+void CompilerDriver::CompileQueuedMethods(jobject class_loader,
+                                          const std::vector<const DexFile*>& dex_files,
+                                          ThreadPool* thread_pool, TimingLogger* timings) {
+  TimingLogger::ScopedTiming t("Compile Queued Methods", timings);
+  size_t num_methods;
+  {
+    MutexLock mu(Thread::Current(), queued_methods_lock_);
+    // Methods sampled by the profile first, hottest first, then the cheapest first. The dex file
+    // and method indices make the order independent of the order the methods were queued in.
+    for (QueuedMethod& queued_method : queued_methods_) {
+      queued_method.dex_file_index =
+          std::find(dex_files.begin(), dex_files.end(), queued_method.dex_file) -
+          dex_files.begin();
+    }
+    std::sort(queued_methods_.begin(), queued_methods_.end(),
+              [](const QueuedMethod& lhs, const QueuedMethod& rhs) {
+      if (lhs.sample_count != rhs.sample_count) {
+        return lhs.sample_count > rhs.sample_count;
+      }
+      if (lhs.cost != rhs.cost) {
+        return lhs.cost < rhs.cost;
+      }
+      if (lhs.dex_file_index != rhs.dex_file_index) {
+        return lhs.dex_file_index < rhs.dex_file_index;
+      }
+      return lhs.method_idx < rhs.method_idx;
+    });
+    num_methods = queued_methods_.size();
+  }
+  // The callbacks only read queued_methods_, which is not modified until all of them are done.
+  ParallelCompilationManager context(Runtime::Current()->GetClassLinker(), class_loader, this,
+                                     nullptr, dex_files, thread_pool);
+  context.ForAll(0, num_methods, CompilerDriver::CompileQueuedMethod, thread_count_);
+  MutexLock mu(Thread::Current(), queued_methods_lock_);
+  queued_methods_.clear();
+  queued_methods_.shrink_to_fit();
+}
+
+void CompilerDriver::CompileQueuedMethod(const ParallelCompilationManager* manager,
+                                         size_t index) NO_THREAD_SAFETY_ANALYSIS {
+  ATRACE_CALL();
+  CompilerDriver* driver = manager->GetCompiler();
+  const QueuedMethod& queued_method = driver->queued_methods_[index];
+  CompileTimeBudget* budget = driver->compile_time_budget_.get();
+  MethodReference method_ref(queued_method.dex_file, queued_method.method_idx);
+  bool compilation_enabled = queued_method.compilation_enabled;
+  // Native methods only get a JNI stub, which is cheap enough to always compile. Abstract methods
+  // and class initializers are never compiled.
+  bool budgeted = compilation_enabled && queued_method.code_item != nullptr &&
+      (queued_method.access_flags & kAccNative) == 0 &&
+      driver->verification_results_->IsCandidateForCompilation(method_ref,
+                                                               queued_method.access_flags);
+  if (budgeted && !budget->ShouldCompile(method_ref, queued_method.cost)) {
+    // Still run the dex-to-dex compiler, as for interpret-only.
+    compilation_enabled = false;
+    budgeted = false;
+  }
+  uint64_t start_ns = budgeted ? NanoTime() : 0u;
+  driver->CompileMethod(queued_method.code_item, queued_method.access_flags,
+                        queued_method.invoke_type, queued_method.class_def_idx,
+                        queued_method.method_idx, manager->GetClassLoader(),
+                        *queued_method.dex_file, queued_method.dex_to_dex_compilation_level,
+                        compilation_enabled);
+  if (budgeted) {
+    budget->RecordCompilation(queued_method.cost, NanoTime() - start_ns);
+  }
 }
 
 void CompilerDriver::CompileMethod(const DexFile::CodeItem* code_item, uint32_t access_flags,
@@ -2142,10 +2514,13 @@ void CompilerDriver::CompileMethod(const DexFile::CodeItem* code_item, uint32_t
                                    DexToDexCompilationLevel dex_to_dex_compilation_level,
                                    bool compilation_enabled) {
   CompiledMethod* compiled_method = nullptr;
-  uint64_t start_ns = kTimeCompileMethod ? NanoTime() : 0;
+  uint64_t start_ns = (kTimeCompileMethod || compile_stats_.get() != nullptr) ? NanoTime() : 0;
   MethodReference method_ref(&dex_file, method_idx);
+  bool is_abstract = (access_flags & kAccAbstract) != 0;
+  CompileStats::Outcome outcome = CompileStats::kOutcomeInterpretOnly;
 
   if ((access_flags & kAccNative) != 0) {
+    outcome = CompileStats::kOutcomeJni;
     // Are we interpreting only and have support for generic JNI down calls?
     if (!compiler_options_->IsCompilationEnabled() &&
         (instruction_set_ == kX86_64 || instruction_set_ == kArm64)) {
@@ -2154,7 +2529,7 @@ void CompilerDriver::CompileMethod(const DexFile::CodeItem* code_item, uint32_t
       compiled_method = compiler_->JniCompile(access_flags, method_idx, dex_file);
       CHECK(compiled_method != nullptr);
     }
-  } else if ((access_flags & kAccAbstract) != 0) {
+  } else if (is_abstract) {
   } else {
     bool has_verified_method = verification_results_->GetVerifiedMethod(method_ref) != nullptr;
     bool compile = compilation_enabled &&
@@ -2167,10 +2542,35 @@ void CompilerDriver::CompileMethod(const DexFile::CodeItem* code_item, uint32_t
       compile = false;
       dex_to_dex_compilation_level = kDontDexToDexCompile;
     }
-    if (compile) {
+    if (compile && reusable_oat_file_.get() != nullptr) {
+      compiled_method = reusable_oat_file_->CreateCompiledMethod(this, method_ref);
+      if (compiled_method != nullptr) {
+        outcome = CompileStats::kOutcomeReused;
+      }
+    }
+    std::string cache_key;
+    bool cacheable = false;
+    if (compile && compiled_method == nullptr && compile_cache_.get() != nullptr) {
+      cacheable = compile_cache_->GetKey(this, code_item, access_flags, method_idx, dex_file,
+                                         &cache_key);
+      if (cacheable) {
+        compiled_method = compile_cache_->Lookup(this, cache_key);
+        cacheable = (compiled_method == nullptr);
+        if (compiled_method != nullptr) {
+          outcome = CompileStats::kOutcomeCached;
+        }
+      }
+    }
+    if (compile && compiled_method == nullptr) {
       // NOTE: if compiler declines to compile this method, it will return nullptr.
       compiled_method = compiler_->Compile(code_item, access_flags, invoke_type, class_def_idx,
                                            method_idx, class_loader, dex_file);
+      if (compiled_method != nullptr) {
+        outcome = CompileStats::kOutcomeCompiled;
+      }
+      if (compiled_method != nullptr && cacheable) {
+        compile_cache_->Insert(cache_key, *compiled_method);
+      }
     }
     if (compiled_method == nullptr && dex_to_dex_compilation_level != kDontDexToDexCompile) {
       // TODO: add a command-line option to disable DEX-to-DEX compilation ?
@@ -2189,6 +2589,9 @@ void CompilerDriver::CompileMethod(const DexFile::CodeItem* code_item, uint32_t
                    << " took " << PrettyDuration(duration_ns);
     }
   }
+  if (compile_stats_.get() != nullptr && !is_abstract) {
+    compile_stats_->RecordMethod(method_ref, outcome, NanoTime() - start_ns);
+  }
 
   Thread* self = Thread::Current();
   if (compiled_method != nullptr) {
@@ -2315,6 +2718,19 @@ void CompilerDriver::InstructionSetToLLVMTarget(InstructionSet instruction_set,
     }
   }
 
+uint32_t CompilerDriver::GetProfileSampleCount(MethodReference method_ref) const {
+  if (!profile_present_) {
+    return 0u;
+  }
+  ProfileFile::ProfileData data;
+  if (!profile_file_.GetProfileData(&data,
+                                    PrettyMethod(method_ref.dex_method_index,
+                                                 *method_ref.dex_file))) {
+    return 0u;
+  }
+  return data.GetCount();
+}
+
 bool CompilerDriver::SkipCompilation(const std::string& method_name) {
   if (!profile_present_) {
     return false;
@@ -2348,11 +2764,26 @@ bool CompilerDriver::SkipCompilation(const std::string& method_name) {
   return !compile;
 }
 
+void CompilerDriver::DumpStatsJson(std::ostream& os, const TimingLogger& timings) const {
+  CHECK(compile_stats_.get() != nullptr);
+  std::vector<CompileStats::DedupeStats> dedupe_stats = {
+    { "code", dedupe_code_.GetNumAdds(), dedupe_code_.GetNumKeys() },
+    { "src_mapping_table", dedupe_src_mapping_table_.GetNumAdds(),
+      dedupe_src_mapping_table_.GetNumKeys() },
+    { "mapping_table", dedupe_mapping_table_.GetNumAdds(), dedupe_mapping_table_.GetNumKeys() },
+    { "vmap_table", dedupe_vmap_table_.GetNumAdds(), dedupe_vmap_table_.GetNumKeys() },
+    { "gc_map", dedupe_gc_map_.GetNumAdds(), dedupe_gc_map_.GetNumKeys() },
+    { "cfi_info", dedupe_cfi_info_.GetNumAdds(), dedupe_cfi_info_.GetNumKeys() },
+  };
+  compile_stats_->DumpJson(os, timings, dedupe_stats);
+}
+
 std::string CompilerDriver::GetMemoryUsageString(bool extended) const {
   std::ostringstream oss;
   const ArenaPool* arena_pool = GetArenaPool();
   gc::Heap* heap = Runtime::Current()->GetHeap();
   oss << "arena alloc=" << PrettySize(arena_pool->GetBytesAllocated());
+  oss << " arena peak=" << PrettySize(arena_pool->GetPeakBytesInUse());
   oss << " java alloc=" << PrettySize(heap->GetBytesAllocated());
 #ifdef HAVE_MALLOC_H
   struct mallinfo info = mallinfo();
@@ -2371,6 +2802,10 @@ std::string CompilerDriver::GetMemoryUsageString(bool extended) const {
     oss << "\nVmap table dedupe: " << dedupe_vmap_table_.DumpStats();
     oss << "\nGC map dedupe: " << dedupe_gc_map_.DumpStats();
     oss << "\nCFI info dedupe: " << dedupe_cfi_info_.DumpStats();
+    // The allocations by kind of all the arena allocators, merged into the pool when they are
+    // destroyed.
+    oss << "\n";
+    arena_pool->DumpStats(oss);
   }
   return oss.str();
 }
@@ -41,6 +41,10 @@
 #include "utils/dedupe_set.h"
 #include "utils/swap_space.h"
 #include "dex/verified_method.h"
+#include "driver/compile_cache.h"
+#include "driver/compile_stats.h"
+#include "driver/compile_time_budget.h"
+#include "driver/reusable_oat_file.h"
 
 namespace art {
 
@@ -137,6 +141,49 @@ class CompilerDriver {
     return profile_present_;
   }
 
+  // Returns the number of times the method was sampled according to the profile, 0 if there is
+  // no profile or the method is not in it.
+  uint32_t GetProfileSampleCount(MethodReference method_ref) const;
+
+  // Use the code of unchanged methods from a previous oat file instead of compiling them.
+  // Takes ownership of "reusable_oat_file".
+  void SetReusableOatFile(ReusableOatFile* reusable_oat_file) {
+    reusable_oat_file_.reset(reusable_oat_file);
+  }
+
+  // Look up compiled methods in and add them to "compile_cache". Takes ownership.
+  void SetCompileCache(CompileCache* compile_cache) {
+    compile_cache_.reset(compile_cache);
+  }
+
+  const CompileCache* GetCompileCache() const {
+    return compile_cache_.get();
+  }
+
+  // Compile hot and cheap methods first and demote the remaining methods to interpret-only once
+  // "compile_time_budget" is exhausted. Takes ownership.
+  void SetCompileTimeBudget(CompileTimeBudget* compile_time_budget) {
+    compile_time_budget_.reset(compile_time_budget);
+  }
+
+  const CompileTimeBudget* GetCompileTimeBudget() const {
+    return compile_time_budget_.get();
+  }
+
+  // Record statistics of the compilation in "compile_stats". Takes ownership.
+  void SetCompileStats(CompileStats* compile_stats) {
+    compile_stats_.reset(compile_stats);
+  }
+
+  // Returns the statistics to record into, or nullptr if they are not collected.
+  CompileStats* GetCompileStats() const {
+    return compile_stats_.get();
+  }
+
+  // Writes the statistics of the compilation and the phases of "timings" as JSON. Must only be
+  // called once compilation is done and all "timings" are closed.
+  void DumpStatsJson(std::ostream& os, const TimingLogger& timings) const;
+
   // Are we compiling and creating an image file?
   bool IsImage() const {
     return image_;
@@ -285,6 +332,17 @@ class CompilerDriver {
   void ProcessedInstanceField(bool resolved);
   void ProcessedStaticField(bool resolved, bool local);
   void ProcessedInvoke(InvokeType invoke_type, int flags);
+  // Record the number of range checks of a method, and how many of them were eliminated or
+  // hoisted out of loops.
+  void ProcessedBoundsChecks(size_t checks, size_t eliminated, size_t hoisted);
+  // Record the number of invokes the optimizing compiler built for a method, and how many of
+  // them it inlined.
+  void ProcessedInlining(size_t invokes, size_t inlined);
+  // Record the number of allocations of a method the optimizing compiler tried to remove, and
+  // how many of them it removed.
+  void ProcessedAllocations(size_t allocations, size_t eliminated);
+  // Record an invoke guarded by the class of the receiver with the given number of targets.
+  void ProcessedGuardedInvoke(size_t num_targets);
 
   // Can we fast path instance field access? Computes field's offset and volatility.
   bool ComputeInstanceFieldInfo(uint32_t field_idx, const DexCompilationUnit* mUnit, bool is_put,
@@ -313,6 +371,31 @@ class CompilerDriver {
                          uintptr_t* direct_code, uintptr_t* direct_method)
       LOCKS_EXCLUDED(Locks::mutator_lock_);
 
+  // A target of a virtual or interface invoke guarded by the class of the receiver: the
+  // invoke calls the target directly when the receiver is an instance of the class at
+  // class_type_idx of the compiling method's dex file.
+  struct ProfiledInvokeTarget {
+    ProfiledInvokeTarget() : class_type_idx(0u), target_method(nullptr, 0u), direct_code(0u),
+        direct_method(0u) {}
+
+    uint16_t class_type_idx;
+    MethodReference target_method;
+    uintptr_t direct_code;
+    uintptr_t direct_method;
+  };
+
+  // The maximum number of guarded targets of an invoke: sites with more receiver classes are
+  // considered megamorphic.
+  static constexpr size_t kMaxProfiledInvokeTargets = 2;
+
+  // Computes the guarded targets of the virtual or interface invoke of method_idx at dex_pc
+  // from the receiver classes of the profile. Returns the number of targets, or 0 if there is
+  // no profile for the site, the site is megamorphic, or a target can't be called directly.
+  size_t ComputeProfiledInvokeTargets(const DexCompilationUnit* mUnit, uint32_t dex_pc,
+                                      uint32_t method_idx, InvokeType invoke_type,
+                                      ProfiledInvokeTarget* targets)
+      LOCKS_EXCLUDED(Locks::mutator_lock_);
+
   const VerifiedMethod* GetVerifiedMethod(const DexFile* dex_file, uint32_t method_idx) const;
   bool IsSafeCast(const DexCompilationUnit* mUnit, uint32_t dex_pc);
 
@@ -375,6 +458,10 @@ class CompilerDriver {
   SwapAllocator<void>& GetSwapSpaceAllocator() {
     return *swap_space_allocator_.get();
   }
+  // Returns the swap space, or nullptr if allocations are not backed by a swap file.
+  const SwapSpace* GetSwapSpace() const {
+    return swap_space_.get();
+  }
 
   bool WriteElf(const std::string& android_root,
                 bool is_host,
@@ -721,6 +808,9 @@ class CompilerDriver {
   // Executes APK wide decisions based on data collected during the PreCompile Stage
   void PreCompileSummary();
 
+  // Records the arena pool peak of the phase that just ended and starts a new measurement.
+  void RecordArenaPoolPeak(const char* phase);
+
   void Compile(jobject class_loader, const std::vector<const DexFile*>& dex_files,
                ThreadPool* thread_pool, TimingLogger* timings);
   void CompileDexFile(jobject class_loader, const DexFile& dex_file,
@@ -737,6 +827,24 @@ class CompilerDriver {
   static void CompileClass(const ParallelCompilationManager* context, size_t class_def_index)
       LOCKS_EXCLUDED(Locks::mutator_lock_);
 
+  // Compiles the method right away or, with a compile time budget, queues it for
+  // CompileQueuedMethods.
+  void CompileOrQueueMethod(const DexFile::CodeItem* code_item, uint32_t access_flags,
+                            InvokeType invoke_type, uint16_t class_def_idx, uint32_t method_idx,
+                            jobject class_loader, const DexFile& dex_file,
+                            DexToDexCompilationLevel dex_to_dex_compilation_level,
+                            bool compilation_enabled)
+      LOCKS_EXCLUDED(queued_methods_lock_);
+
+  // Compiles the queued methods, hot methods first and then the cheapest first, within the
+  // compile time budget.
+  void CompileQueuedMethods(jobject class_loader, const std::vector<const DexFile*>& dex_files,
+                            ThreadPool* thread_pool, TimingLogger* timings)
+      LOCKS_EXCLUDED(Locks::mutator_lock_, queued_methods_lock_);
+
+  static void CompileQueuedMethod(const ParallelCompilationManager* context, size_t index)
+      LOCKS_EXCLUDED(Locks::mutator_lock_);
+
   // Swap pool and allocator used for native allocations. May be file-backed. Needs to be first
   // as other fields rely on this.
   std::unique_ptr<SwapSpace> swap_space_;
@@ -745,6 +853,37 @@ class CompilerDriver {
   ProfileFile profile_file_;
   bool profile_present_;
 
+  // Previous oat file to take the code of unchanged methods from, may be null.
+  std::unique_ptr<ReusableOatFile> reusable_oat_file_;
+
+  // Cache of compiled methods shared with other dex2oat invocations, may be null.
+  std::unique_ptr<CompileCache> compile_cache_;
+
+  // Bound on the time spent compiling methods, may be null.
+  std::unique_ptr<CompileTimeBudget> compile_time_budget_;
+
+  // Statistics for --dump-stats-json, may be null.
+  std::unique_ptr<CompileStats> compile_stats_;
+
+  // A method waiting for CompileQueuedMethods.
+  struct QueuedMethod {
+    const DexFile::CodeItem* code_item;
+    uint32_t access_flags;
+    InvokeType invoke_type;
+    uint16_t class_def_idx;
+    uint32_t method_idx;
+    const DexFile* dex_file;
+    DexToDexCompilationLevel dex_to_dex_compilation_level;
+    bool compilation_enabled;
+    size_t dex_file_index;
+    uint32_t sample_count;
+    size_t cost;
+  };
+
+  // Methods queued by CompileOrQueueMethod when there is a compile time budget.
+  Mutex queued_methods_lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
+  std::vector<QueuedMethod> queued_methods_ GUARDED_BY(queued_methods_lock_);
+
   std::vector<const CallPatchInformation*> code_to_patch_;
   std::vector<const CallPatchInformation*> methods_to_patch_;
   std::vector<const TypePatchInformation*> classes_to_patch_;
@@ -901,17 +1040,17 @@ class CompilerDriver {
   };
 
   DedupeSet<ArrayRef<const uint8_t>,
-            SwapVector<uint8_t>, size_t, DedupeHashFunc<const uint8_t>, 4> dedupe_code_;
+            SwapVector<uint8_t>, size_t, DedupeHashFunc<const uint8_t>> dedupe_code_;
   DedupeSet<ArrayRef<SrcMapElem>,
-            SwapSrcMap, size_t, DedupeHashFunc<SrcMapElem>, 4> dedupe_src_mapping_table_;
+            SwapSrcMap, size_t, DedupeHashFunc<SrcMapElem>> dedupe_src_mapping_table_;
   DedupeSet<ArrayRef<const uint8_t>,
-            SwapVector<uint8_t>, size_t, DedupeHashFunc<const uint8_t>, 4> dedupe_mapping_table_;
+            SwapVector<uint8_t>, size_t, DedupeHashFunc<const uint8_t>> dedupe_mapping_table_;
   DedupeSet<ArrayRef<const uint8_t>,
-            SwapVector<uint8_t>, size_t, DedupeHashFunc<const uint8_t>, 4> dedupe_vmap_table_;
+            SwapVector<uint8_t>, size_t, DedupeHashFunc<const uint8_t>> dedupe_vmap_table_;
   DedupeSet<ArrayRef<const uint8_t>,
-            SwapVector<uint8_t>, size_t, DedupeHashFunc<const uint8_t>, 4> dedupe_gc_map_;
+            SwapVector<uint8_t>, size_t, DedupeHashFunc<const uint8_t>> dedupe_gc_map_;
   DedupeSet<ArrayRef<const uint8_t>,
-            SwapVector<uint8_t>, size_t, DedupeHashFunc<const uint8_t>, 4> dedupe_cfi_info_;
+            SwapVector<uint8_t>, size_t, DedupeHashFunc<const uint8_t>> dedupe_cfi_info_;
 
   DISALLOW_COPY_AND_ASSIGN(CompilerDriver);
 };
@@ -19,10 +19,15 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <memory>
+#include <sstream>
 
+#include "base/unix_file/fd_file.h"
 #include "class_linker.h"
 #include "common_compiler_test.h"
 #include "dex_file.h"
+#include "driver/compile_stats.h"
+#include "driver/compile_time_budget.h"
+#include "driver/dex_compilation_unit.h"
 #include "gc/heap.h"
 #include "mirror/art_method-inl.h"
 #include "mirror/class-inl.h"
@@ -182,6 +187,249 @@ TEST_F(CompilerDriverTest, AbstractMethodErrorStub) {
   }
 }
 
+TEST_F(CompilerDriverTest, DumpStatsJson) {
+  TEST_DISABLED_FOR_PORTABLE();
+  compiler_driver_->SetCompileStats(new CompileStats());
+  jobject class_loader;
+  {
+    ScopedObjectAccess soa(Thread::Current());
+    class_loader = LoadDex("AbstractMethod");
+  }
+  ASSERT_TRUE(class_loader != NULL);
+  TimingLogger timings("CompilerDriverTest::DumpStatsJson", false, false);
+  {
+    TimingLogger::ScopedTiming t("CompileAll", &timings);
+    compiler_driver_->CompileAll(class_loader,
+                                 Runtime::Current()->GetCompileTimeClassPath(class_loader),
+                                 &timings);
+  }
+
+  const CompileStats* stats = compiler_driver_->GetCompileStats();
+  size_t num_methods = stats->GetNumMethods(CompileStats::kOutcomeCompiled) +
+      stats->GetNumMethods(CompileStats::kOutcomeInterpretOnly);
+  EXPECT_NE(0u, num_methods);
+  // Every compiled method is accounted to exactly one backend.
+  EXPECT_EQ(stats->GetNumMethods(CompileStats::kOutcomeCompiled),
+            stats->GetNumMethods(CompileStats::kBackendQuick) +
+            stats->GetNumMethods(CompileStats::kBackendOptimizing) +
+            stats->GetNumMethods(CompileStats::kBackendPortable));
+
+  std::ostringstream oss;
+  compiler_driver_->DumpStatsJson(oss, timings);
+  std::string json = oss.str();
+  EXPECT_NE(std::string::npos, json.find("\"name\": \"CompileAll\", \"depth\": 0")) << json;
+  EXPECT_NE(std::string::npos, json.find("\"slowest_methods\": [\n    {\"method\": ")) << json;
+  EXPECT_NE(std::string::npos, json.find("\"code\": {\"adds\": ")) << json;
+  EXPECT_NE(std::string::npos, json.find("\"arena\": {\"peak_bytes\": ")) << json;
+  EXPECT_EQ('}', json[json.size() - 2u]) << json;
+}
+
+static const DexFile::CodeItem* MakeCodeItem(std::vector<uint16_t>* data,
+                                             const std::vector<uint16_t>& insns) {
+  // registers_size_, ins_size_, outs_size_, tries_size_, debug_info_off_, insns_size_in_code_units_
+  data->assign({1u, 1u, 0u, 0u, 0u, 0u, static_cast<uint16_t>(insns.size()), 0u});
+  data->insert(data->end(), insns.begin(), insns.end());
+  return reinterpret_cast<const DexFile::CodeItem*>(data->data());
+}
+
+TEST_F(CompilerDriverTest, CompileTimeBudgetEstimateCost) {
+  std::vector<uint16_t> data;
+  // return-void; return-void
+  const DexFile::CodeItem* straight = MakeCodeItem(&data, {0x000e, 0x000e});
+  EXPECT_EQ(2u, CompileTimeBudget::EstimateCost(straight));
+
+  // if-eqz v0, +3; return-void; return-void
+  const DexFile::CodeItem* branch = MakeCodeItem(&data, {0x0038, 0x0003, 0x000e, 0x000e});
+  size_t branch_cost = CompileTimeBudget::EstimateCost(branch);
+  ASSERT_GT(branch_cost, 4u);
+  size_t cost_per_target = branch_cost - 4u;
+
+  // if-eqz v0, +3; return-void; packed-switch v0, +5; return-void; nop; then the payload of a
+  // packed switch with 3 cases, all going to the second return-void.
+  const DexFile::CodeItem* switch_item = MakeCodeItem(&data, {
+      0x0038, 0x0003, 0x000e, 0x002b, 0x0005, 0x0000, 0x000e, 0x0000,
+      0x0100, 0x0003, 0x0000, 0x0000, 0x0003, 0x0000, 0x0003, 0x0000, 0x0003, 0x0000});
+  EXPECT_EQ(18u + 4u * cost_per_target, CompileTimeBudget::EstimateCost(switch_item));
+}
+
+TEST_F(CompilerDriverTest, CompileTimeBudgetDemotes) {
+  MethodReference method_ref(java_lang_dex_file_, 0u);
+
+  CompileTimeBudget large_budget(1000000u);
+  large_budget.Start();
+  EXPECT_TRUE(large_budget.ShouldCompile(method_ref, 100u));
+  EXPECT_EQ(0u, large_budget.GetNumDemotedMethods());
+
+  CompileTimeBudget small_budget(1u);
+  small_budget.Start();
+  NanoSleep(MsToNs(2u));
+  EXPECT_FALSE(small_budget.ShouldCompile(method_ref, 1u));
+  EXPECT_EQ(1u, small_budget.GetNumDemotedMethods());
+
+  // After enough methods to trust the prediction, a method predicted to take longer than the
+  // rest of the budget is demoted while cheap ones are still compiled.
+  CompileTimeBudget budget(1000000u);
+  budget.Start();
+  for (size_t i = 0; i != 100u; ++i) {
+    budget.RecordCompilation(1u, MsToNs(1u));
+  }
+  EXPECT_TRUE(budget.ShouldCompile(method_ref, 1u));
+  EXPECT_FALSE(budget.ShouldCompile(method_ref, 10000000u));
+  EXPECT_EQ(1u, budget.GetNumDemotedMethods());
+}
+
+class ProfiledInvokeTargetsTest : public CompilerDriverTest {
+ protected:
+  void SetUp() OVERRIDE {
+    CompilerDriverTest::SetUp();
+    ScopedObjectAccess soa(Thread::Current());
+    class_loader_ = LoadDex("ProfiledDispatch");
+  }
+
+  // Replaces the compiler driver with one that reads the receiver lines from its profile.
+  void LoadReceiverProfile(const std::string& receiver_lines) {
+    ScratchFile profile;
+    std::string contents = "1/0/0\n" + receiver_lines;
+    ASSERT_TRUE(profile.GetFile()->WriteFully(contents.data(), contents.size()));
+    compiler_driver_.reset(new CompilerDriver(compiler_options_.get(),
+                                              verification_results_.get(),
+                                              method_inliner_map_.get(), Compiler::kQuick,
+                                              compiler_driver_->GetInstructionSet(),
+                                              compiler_driver_->GetInstructionSetFeatures(),
+                                              false, nullptr, nullptr, 2, false, false,
+                                              timer_.get(), -1, profile.GetFilename()));
+    compiler_driver_->SetSupportBootImageFixup(false);
+    ASSERT_TRUE(compiler_driver_->ProfilePresent());
+  }
+
+  mirror::Class* FindClass(ScopedObjectAccess& soa, const char* descriptor)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+    StackHandleScope<1> hs(soa.Self());
+    Handle<mirror::ClassLoader> loader(
+        hs.NewHandle(soa.Decode<mirror::ClassLoader*>(class_loader_)));
+    mirror::Class* klass = class_linker_->FindClass(soa.Self(), descriptor, loader);
+    CHECK(klass != nullptr) << descriptor;
+    return klass;
+  }
+
+  uint16_t TypeIndex(const char* descriptor) {
+    ScopedObjectAccess soa(Thread::Current());
+    return FindClass(soa, descriptor)->GetDexTypeIndex();
+  }
+
+  uint32_t MethodIndex(const char* descriptor, const char* name, const char* signature) {
+    ScopedObjectAccess soa(Thread::Current());
+    mirror::ArtMethod* method = FindClass(soa, descriptor)->FindVirtualMethod(name, signature);
+    CHECK(method != nullptr) << descriptor << "." << name << signature;
+    return method->GetDexMethodIndex();
+  }
+
+  // Computes the targets of the invoke at dex pc 0 of the static method of ProfiledDispatch,
+  // which calls the given method of the callee class.
+  size_t ComputeTargets(const char* caller_name, const char* caller_signature,
+                        const char* callee_descriptor, const char* callee_name,
+                        const char* callee_signature, InvokeType invoke_type,
+                        CompilerDriver::ProfiledInvokeTarget* targets) {
+    const DexFile* dex_file;
+    const DexFile::CodeItem* code_item;
+    uint16_t class_def_idx;
+    uint32_t method_idx;
+    uint32_t access_flags;
+    {
+      ScopedObjectAccess soa(Thread::Current());
+      mirror::ArtMethod* caller =
+          FindClass(soa, "LProfiledDispatch;")->FindDirectMethod(caller_name, caller_signature);
+      CHECK(caller != nullptr) << caller_name << caller_signature;
+      dex_file = caller->GetDexFile();
+      code_item = caller->GetCodeItem();
+      class_def_idx = caller->GetDeclaringClass()->GetDexClassDefIndex();
+      method_idx = caller->GetDexMethodIndex();
+      access_flags = caller->GetAccessFlags();
+    }
+    DexCompilationUnit unit(nullptr, class_loader_, class_linker_, *dex_file, code_item,
+                            class_def_idx, method_idx, access_flags, nullptr);
+    return compiler_driver_->ComputeProfiledInvokeTargets(
+        &unit, 0u, MethodIndex(callee_descriptor, callee_name, callee_signature), invoke_type,
+        targets);
+  }
+
+  size_t ComputeAreaTargets(CompilerDriver::ProfiledInvokeTarget* targets) {
+    return ComputeTargets("area", "(LShape;)I", "LShape;", "area", "()I", kInterface, targets);
+  }
+
+  size_t ComputeNextTargets(CompilerDriver::ProfiledInvokeTarget* targets) {
+    return ComputeTargets("next", "(LCounter;I)I", "LCounter;", "next", "(I)I", kVirtual,
+                          targets);
+  }
+
+  jobject class_loader_;
+};
+
+TEST_F(ProfiledInvokeTargetsTest, Monomorphic) {
+  TEST_DISABLED_FOR_PORTABLE();
+  LoadReceiverProfile("@int ProfiledDispatch.area(Shape)/0/Square:100\n"
+                      "@int ProfiledDispatch.next(Counter, int)/0/Incrementer:100\n");
+  CompilerDriver::ProfiledInvokeTarget targets[CompilerDriver::kMaxProfiledInvokeTargets];
+  ASSERT_EQ(1u, ComputeAreaTargets(targets));
+  EXPECT_EQ(TypeIndex("LSquare;"), targets[0].class_type_idx);
+  EXPECT_EQ(MethodIndex("LSquare;", "area", "()I"), targets[0].target_method.dex_method_index);
+
+  ASSERT_EQ(1u, ComputeNextTargets(targets));
+  EXPECT_EQ(TypeIndex("LIncrementer;"), targets[0].class_type_idx);
+  EXPECT_EQ(MethodIndex("LIncrementer;", "next", "(I)I"),
+            targets[0].target_method.dex_method_index);
+}
+
+TEST_F(ProfiledInvokeTargetsTest, Polymorphic) {
+  TEST_DISABLED_FOR_PORTABLE();
+  CompilerDriver::ProfiledInvokeTarget targets[CompilerDriver::kMaxProfiledInvokeTargets];
+
+  // The classes that make up 90% of the samples are guarded, the most frequent first.
+  LoadReceiverProfile("@int ProfiledDispatch.area(Shape)/0/Circle:40#Square:60\n");
+  ASSERT_EQ(2u, ComputeAreaTargets(targets));
+  EXPECT_EQ(TypeIndex("LSquare;"), targets[0].class_type_idx);
+  EXPECT_EQ(MethodIndex("LSquare;", "area", "()I"), targets[0].target_method.dex_method_index);
+  EXPECT_EQ(TypeIndex("LCircle;"), targets[1].class_type_idx);
+  EXPECT_EQ(MethodIndex("LCircle;", "area", "()I"), targets[1].target_method.dex_method_index);
+
+  LoadReceiverProfile("@int ProfiledDispatch.area(Shape)/0/Circle:5#Square:95\n");
+  ASSERT_EQ(1u, ComputeAreaTargets(targets));
+  EXPECT_EQ(TypeIndex("LSquare;"), targets[0].class_type_idx);
+
+  // Tile inherits the target from Square, the guards are still on the classes of the receivers.
+  LoadReceiverProfile("@int ProfiledDispatch.area(Shape)/0/Tile:50#Square:50\n");
+  ASSERT_EQ(2u, ComputeAreaTargets(targets));
+  EXPECT_EQ(TypeIndex("LSquare;"), targets[0].class_type_idx);
+  EXPECT_EQ(TypeIndex("LTile;"), targets[1].class_type_idx);
+  EXPECT_EQ(MethodIndex("LSquare;", "area", "()I"), targets[1].target_method.dex_method_index);
+
+  // Megamorphic.
+  LoadReceiverProfile("@int ProfiledDispatch.area(Shape)/0/Circle:30#Square:40#Tile:30\n");
+  EXPECT_EQ(0u, ComputeAreaTargets(targets));
+}
+
+TEST_F(ProfiledInvokeTargetsTest, NoTargets) {
+  TEST_DISABLED_FOR_PORTABLE();
+  CompilerDriver::ProfiledInvokeTarget targets[CompilerDriver::kMaxProfiledInvokeTargets];
+
+  // No samples for the site, whose dex pc is 0.
+  LoadReceiverProfile("@int ProfiledDispatch.area(Shape)/1/Square:100\n");
+  EXPECT_EQ(0u, ComputeAreaTargets(targets));
+  EXPECT_EQ(0u, ComputeNextTargets(targets));
+
+  // A class that is not referenced by the dex file of the caller.
+  LoadReceiverProfile("@int ProfiledDispatch.area(Shape)/0/java.lang.Thread:100\n");
+  EXPECT_EQ(0u, ComputeAreaTargets(targets));
+
+  // A class that does not implement the method.
+  LoadReceiverProfile("@int ProfiledDispatch.area(Shape)/0/Incrementer:100\n");
+  EXPECT_EQ(0u, ComputeAreaTargets(targets));
+
+  // An abstract class can't be the class of a receiver.
+  LoadReceiverProfile("@int ProfiledDispatch.next(Counter, int)/0/Counter:100\n");
+  EXPECT_EQ(0u, ComputeNextTargets(targets));
+}
+
 // TODO: need check-cast test (when stub complete & we can throw/catch
 
 }  // namespace art
@@ -62,7 +62,8 @@ class CompilerOptions {
     implicit_null_checks_(false),
     implicit_so_checks_(false),
     implicit_suspend_checks_(false),
-    compile_pic_(false)
+    compile_pic_(false),
+    profile_code_layout_(false)
 #ifdef ART_SEA_IR_MODE
     , sea_ir_mode_(false)
 #endif
@@ -81,7 +82,8 @@ class CompilerOptions {
                   bool implicit_null_checks,
                   bool implicit_so_checks,
                   bool implicit_suspend_checks,
-                  bool compile_pic
+                  bool compile_pic,
+                  bool profile_code_layout
 #ifdef ART_SEA_IR_MODE
                   , bool sea_ir_mode
 #endif
@@ -99,7 +101,8 @@ class CompilerOptions {
     implicit_null_checks_(implicit_null_checks),
     implicit_so_checks_(implicit_so_checks),
     implicit_suspend_checks_(implicit_suspend_checks),
-    compile_pic_(compile_pic)
+    compile_pic_(compile_pic),
+    profile_code_layout_(profile_code_layout)
 #ifdef ART_SEA_IR_MODE
     , sea_ir_mode_(sea_ir_mode)
 #endif
@@ -207,6 +210,15 @@ class CompilerOptions {
     return compile_pic_;
   }
 
+  // Should the oat writer place the code of profiled methods first, hottest first?
+  bool GetProfileCodeLayout() const {
+    return profile_code_layout_;
+  }
+
+  void SetProfileCodeLayout(bool new_val) {
+    profile_code_layout_ = new_val;
+  }
+
  private:
   CompilerFilter compiler_filter_;
   size_t huge_method_threshold_;
@@ -223,6 +235,7 @@ class CompilerOptions {
   bool implicit_so_checks_;
   bool implicit_suspend_checks_;
   bool compile_pic_;
+  bool profile_code_layout_;
 #ifdef ART_SEA_IR_MODE
   bool sea_ir_mode_;
 #endif
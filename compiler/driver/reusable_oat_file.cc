@@ -0,0 +1,361 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "reusable_oat_file.h"
+
+#include <string.h>
+
+#include <sstream>
+
+#include "base/stl_util.h"
+#include "base/stringprintf.h"
+#include "compiled_method.h"
+#include "driver/compiler_driver.h"
+#include "leb128.h"
+#include "mirror/art_method.h"
+#include "modifiers.h"
+#include "oat_file-inl.h"
+#include "utils/array_ref.h"
+
+namespace art {
+
+// Methods with at most this many code units may be inlined into their callers by the
+// DexFileMethodInliner (a plain return or a two instruction getter, setter or constant).
+static constexpr uint32_t kMaxSpecialMethodCodeUnits = 4u;
+
+// Returns the size of a mapping table, see Mir2Lir::CreateMappingTables().
+static size_t MappingTableSize(const uint8_t* table) {
+  const uint8_t* ptr = table;
+  uint32_t total_entries = DecodeUnsignedLeb128(&ptr);
+  DecodeUnsignedLeb128(&ptr);  // Number of pc2dex entries, included in the total.
+  for (uint32_t i = 0; i != total_entries; ++i) {
+    DecodeUnsignedLeb128(&ptr);  // Native pc offset delta.
+    DecodeSignedLeb128(&ptr);    // Dex pc delta.
+  }
+  return ptr - table;
+}
+
+// Returns the size of a vmap table, see VmapTable.
+static size_t VmapTableSize(const uint8_t* table) {
+  const uint8_t* ptr = table;
+  uint32_t entries = DecodeUnsignedLeb128(&ptr);
+  for (uint32_t i = 0; i != entries; ++i) {
+    DecodeUnsignedLeb128(&ptr);
+  }
+  return ptr - table;
+}
+
+// Returns the size of a native GC map, see NativePcOffsetToReferenceMap.
+static size_t NativeGcMapSize(const uint8_t* map) {
+  size_t native_offset_width = map[0] & 7;
+  size_t reg_width = (static_cast<size_t>(map[0]) | (static_cast<size_t>(map[1]) << 8)) >> 3;
+  size_t num_entries = map[2] | (map[3] << 8);
+  return 4u + num_entries * (native_offset_width + reg_width);
+}
+
+// Compares two code items, ignoring the debug info offset which depends on the dex file layout.
+static bool SameCodeItem(const DexFile::CodeItem* lhs, const DexFile::CodeItem* rhs) {
+  if (lhs == nullptr || rhs == nullptr) {
+    return lhs == rhs;
+  }
+  if (lhs->registers_size_ != rhs->registers_size_ ||
+      lhs->ins_size_ != rhs->ins_size_ ||
+      lhs->outs_size_ != rhs->outs_size_ ||
+      lhs->tries_size_ != rhs->tries_size_ ||
+      lhs->insns_size_in_code_units_ != rhs->insns_size_in_code_units_) {
+    return false;
+  }
+  size_t size = DexFile::GetCodeItemBodySize(*lhs);
+  return size == DexFile::GetCodeItemBodySize(*rhs) &&
+      memcmp(lhs->insns_, rhs->insns_, size) == 0;
+}
+
+static bool IsSpecialMethodCandidate(const DexFile::CodeItem* code_item) {
+  return code_item != nullptr && code_item->insns_size_in_code_units_ <= kMaxSpecialMethodCodeUnits;
+}
+
+static bool SameTypeList(const DexFile::TypeList* lhs, const DexFile::TypeList* rhs) {
+  uint32_t lhs_size = (lhs == nullptr) ? 0u : lhs->Size();
+  uint32_t rhs_size = (rhs == nullptr) ? 0u : rhs->Size();
+  if (lhs_size != rhs_size) {
+    return false;
+  }
+  for (uint32_t i = 0; i != lhs_size; ++i) {
+    if (lhs->GetTypeItem(i).type_idx_ != rhs->GetTypeItem(i).type_idx_) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Compares raw id sections which only contain indices into other sections.
+template <typename Id>
+static bool SameIds(size_t count, const Id* lhs, const Id* rhs) {
+  return count == 0u || memcmp(lhs, rhs, count * sizeof(Id)) == 0;
+}
+
+// Returns true if both dex files assign the same meaning to every string, type, field, method
+// and prototype index and declare the same classes with the same members. This guarantees that
+// the dex indices, field offsets and vtable indices embedded in compiled code stay valid.
+static bool SameShape(const DexFile& lhs, const DexFile& rhs) {
+  if (lhs.NumStringIds() != rhs.NumStringIds() ||
+      lhs.NumTypeIds() != rhs.NumTypeIds() ||
+      lhs.NumProtoIds() != rhs.NumProtoIds() ||
+      lhs.NumFieldIds() != rhs.NumFieldIds() ||
+      lhs.NumMethodIds() != rhs.NumMethodIds() ||
+      lhs.NumClassDefs() != rhs.NumClassDefs()) {
+    return false;
+  }
+  for (size_t i = 0, e = lhs.NumStringIds(); i != e; ++i) {
+    if (strcmp(lhs.StringDataByIdx(i), rhs.StringDataByIdx(i)) != 0) {
+      return false;
+    }
+  }
+  if (lhs.NumTypeIds() != 0u && !SameIds(lhs.NumTypeIds(), &lhs.GetTypeId(0), &rhs.GetTypeId(0))) {
+    return false;
+  }
+  if (lhs.NumFieldIds() != 0u &&
+      !SameIds(lhs.NumFieldIds(), &lhs.GetFieldId(0), &rhs.GetFieldId(0))) {
+    return false;
+  }
+  if (lhs.NumMethodIds() != 0u &&
+      !SameIds(lhs.NumMethodIds(), &lhs.GetMethodId(0), &rhs.GetMethodId(0))) {
+    return false;
+  }
+  for (size_t i = 0, e = lhs.NumProtoIds(); i != e; ++i) {
+    const DexFile::ProtoId& lhs_proto = lhs.GetProtoId(i);
+    const DexFile::ProtoId& rhs_proto = rhs.GetProtoId(i);
+    if (lhs_proto.shorty_idx_ != rhs_proto.shorty_idx_ ||
+        lhs_proto.return_type_idx_ != rhs_proto.return_type_idx_ ||
+        !SameTypeList(lhs.GetProtoParameters(lhs_proto), rhs.GetProtoParameters(rhs_proto))) {
+      return false;
+    }
+  }
+  for (size_t i = 0, e = lhs.NumClassDefs(); i != e; ++i) {
+    const DexFile::ClassDef& lhs_class_def = lhs.GetClassDef(i);
+    const DexFile::ClassDef& rhs_class_def = rhs.GetClassDef(i);
+    if (lhs_class_def.class_idx_ != rhs_class_def.class_idx_ ||
+        lhs_class_def.access_flags_ != rhs_class_def.access_flags_ ||
+        lhs_class_def.superclass_idx_ != rhs_class_def.superclass_idx_ ||
+        !SameTypeList(lhs.GetInterfacesList(lhs_class_def),
+                      rhs.GetInterfacesList(rhs_class_def))) {
+      return false;
+    }
+    const byte* lhs_class_data = lhs.GetClassData(lhs_class_def);
+    const byte* rhs_class_data = rhs.GetClassData(rhs_class_def);
+    if (lhs_class_data == nullptr || rhs_class_data == nullptr) {
+      if (lhs_class_data != rhs_class_data) {
+        return false;
+      }
+      continue;
+    }
+    ClassDataItemIterator lhs_it(lhs, lhs_class_data);
+    ClassDataItemIterator rhs_it(rhs, rhs_class_data);
+    if (lhs_it.NumStaticFields() != rhs_it.NumStaticFields() ||
+        lhs_it.NumInstanceFields() != rhs_it.NumInstanceFields() ||
+        lhs_it.NumDirectMethods() != rhs_it.NumDirectMethods() ||
+        lhs_it.NumVirtualMethods() != rhs_it.NumVirtualMethods()) {
+      return false;
+    }
+    for (; lhs_it.HasNext(); lhs_it.Next(), rhs_it.Next()) {
+      if (lhs_it.GetMemberIndex() != rhs_it.GetMemberIndex() ||
+          lhs_it.GetRawMemberAccessFlags() != rhs_it.GetRawMemberAccessFlags()) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+ReusableOatFile* ReusableOatFile::Open(const std::string& filename,
+                                       InstructionSet instruction_set,
+                                       const InstructionSetFeatures& instruction_set_features,
+                                       uint32_t image_file_location_oat_checksum,
+                                       std::string* error_msg) {
+  std::unique_ptr<OatFile> oat_file(OatFile::Open(filename, filename, nullptr, nullptr, false,
+                                                  error_msg));
+  if (oat_file.get() == nullptr) {
+    return nullptr;
+  }
+  const OatHeader& oat_header = oat_file->GetOatHeader();
+  if (oat_header.GetInstructionSet() != instruction_set) {
+    *error_msg = StringPrintf("Oat file '%s' was compiled for instruction set %s",
+                              filename.c_str(),
+                              GetInstructionSetString(oat_header.GetInstructionSet()));
+    return nullptr;
+  }
+  if (!(oat_header.GetInstructionSetFeatures() == instruction_set_features)) {
+    *error_msg = StringPrintf("Oat file '%s' was compiled for instruction set features %s",
+                              filename.c_str(),
+                              oat_header.GetInstructionSetFeatures().GetFeatureString().c_str());
+    return nullptr;
+  }
+  if (oat_header.GetImageFileLocationOatChecksum() != image_file_location_oat_checksum) {
+    *error_msg = StringPrintf("Oat file '%s' was compiled against a different boot image",
+                              filename.c_str());
+    return nullptr;
+  }
+  if (oat_header.IsPic()) {
+    *error_msg = StringPrintf("Oat file '%s' contains position independent code",
+                              filename.c_str());
+    return nullptr;
+  }
+  return new ReusableOatFile(oat_file.release());
+}
+
+ReusableOatFile::ReusableOatFile(OatFile* oat_file)
+    : oat_file_(oat_file),
+      unmatched_dex_files_(0u),
+      reused_methods_(0u),
+      compiled_methods_(0u) {
+}
+
+ReusableOatFile::~ReusableOatFile() {
+  STLDeleteElements(&old_dex_files_);
+}
+
+void ReusableOatFile::MatchDexFiles(const std::vector<const DexFile*>& dex_files) {
+  DCHECK(reusable_methods_.empty());
+  if (dex_files.size() != oat_file_->GetOatDexFiles().size()) {
+    // Adding or removing a dex file may change how the classes of the other ones resolve.
+    LOG(INFO) << "Number of dex files changed, not reusing any code from "
+              << oat_file_->GetLocation();
+    unmatched_dex_files_ = dex_files.size();
+    return;
+  }
+  SafeMap<MethodReference, OatFile::OatMethod, MethodReferenceComparator> methods;
+  for (const DexFile* dex_file : dex_files) {
+    const std::string& location = dex_file->GetLocation();
+    const OatFile::OatDexFile* oat_dex_file =
+        oat_file_->GetOatDexFile(location.c_str(), nullptr, false);
+    if (oat_dex_file == nullptr) {
+      LOG(INFO) << "No previous code for " << location << ", not reusing any code from "
+                << oat_file_->GetLocation();
+      unmatched_dex_files_ = dex_files.size();
+      return;
+    }
+    std::string error_msg;
+    const DexFile* old_dex_file = oat_dex_file->OpenDexFile(&error_msg);
+    if (old_dex_file == nullptr) {
+      LOG(WARNING) << "Failed to open previous " << location << " from "
+                   << oat_file_->GetLocation() << ": " << error_msg;
+      unmatched_dex_files_ = dex_files.size();
+      return;
+    }
+    old_dex_files_.push_back(old_dex_file);
+    if (!SameShape(*dex_file, *old_dex_file)) {
+      // Code in the other dex files embeds field offsets and vtable indices of these classes.
+      LOG(INFO) << "Layout of " << location << " changed, not reusing any code from "
+                << oat_file_->GetLocation();
+      unmatched_dex_files_ = dex_files.size();
+      return;
+    }
+    if (!MatchDexFile(*dex_file, *old_dex_file, *oat_dex_file, &methods)) {
+      // Callers in any dex file may have inlined the changed method.
+      LOG(INFO) << "Inlining candidate changed in " << location << ", not reusing any code from "
+                << oat_file_->GetLocation();
+      unmatched_dex_files_ = dex_files.size();
+      return;
+    }
+  }
+  reusable_methods_.swap(methods);
+}
+
+bool ReusableOatFile::MatchDexFile(
+    const DexFile& dex_file, const DexFile& old_dex_file, const OatFile::OatDexFile& oat_dex_file,
+    SafeMap<MethodReference, OatFile::OatMethod, MethodReferenceComparator>* methods) {
+  // The location checksum is that of the original dex file, before any dex-to-dex compilation
+  // modified the copy stored in the oat file.
+  bool unchanged = dex_file.GetLocationChecksum() == oat_dex_file.GetDexFileLocationChecksum();
+  for (size_t class_def_index = 0, e = dex_file.NumClassDefs(); class_def_index != e;
+       ++class_def_index) {
+    const byte* class_data = dex_file.GetClassData(dex_file.GetClassDef(class_def_index));
+    if (class_data == nullptr) {
+      continue;
+    }
+    const byte* old_class_data =
+        old_dex_file.GetClassData(old_dex_file.GetClassDef(class_def_index));
+    const OatFile::OatClass oat_class = oat_dex_file.GetOatClass(class_def_index);
+    ClassDataItemIterator it(dex_file, class_data);
+    ClassDataItemIterator old_it(old_dex_file, old_class_data);
+    while (it.HasNextStaticField() || it.HasNextInstanceField()) {
+      it.Next();
+      old_it.Next();
+    }
+    for (size_t class_def_method_index = 0u; it.HasNext();
+         ++class_def_method_index, it.Next(), old_it.Next()) {
+      const DexFile::CodeItem* code_item = it.GetMethodCodeItem();
+      const DexFile::CodeItem* old_code_item = old_it.GetMethodCodeItem();
+      const OatFile::OatMethod oat_method = oat_class.GetOatMethod(class_def_method_index);
+      // Only compiled methods are guaranteed to have unmodified code items in the old dex file,
+      // the others may have been quickened.
+      bool has_code = oat_method.GetQuickCode() != nullptr;
+      bool same_code = unchanged || SameCodeItem(code_item, old_code_item);
+      if (!same_code &&
+          (IsSpecialMethodCandidate(code_item) || IsSpecialMethodCandidate(old_code_item))) {
+        return false;
+      }
+      MethodReference method_ref(&dex_file, it.GetMemberIndex());
+      if (has_code && same_code && (it.GetRawMemberAccessFlags() & kAccNative) == 0 &&
+          methods->find(method_ref) == methods->end()) {
+        methods->Put(method_ref, oat_method);
+      }
+    }
+  }
+  return true;
+}
+
+CompiledMethod* ReusableOatFile::CreateCompiledMethod(CompilerDriver* driver,
+                                                      MethodReference method_ref) {
+  auto it = reusable_methods_.find(method_ref);
+  if (it == reusable_methods_.end()) {
+    compiled_methods_.FetchAndAddSequentiallyConsistent(1u);
+    return nullptr;
+  }
+  const OatFile::OatMethod& oat_method = it->second;
+  const uint8_t* code = reinterpret_cast<const uint8_t*>(
+      mirror::ArtMethod::EntryPointToCodePointer(oat_method.GetQuickCode()));
+  const uint8_t* mapping_table = oat_method.GetMappingTable();
+  const uint8_t* vmap_table = oat_method.GetVmapTable();
+  const uint8_t* gc_map = oat_method.GetGcMap();
+  reused_methods_.FetchAndAddSequentiallyConsistent(1u);
+  return CompiledMethod::SwapAllocCompiledMethod(
+      driver,
+      driver->GetInstructionSet(),
+      ArrayRef<const uint8_t>(code, oat_method.GetQuickCodeSize()),
+      oat_method.GetFrameSizeInBytes(),
+      oat_method.GetCoreSpillMask(),
+      oat_method.GetFpSpillMask(),
+      nullptr,
+      mapping_table == nullptr ? ArrayRef<const uint8_t>() :
+          ArrayRef<const uint8_t>(mapping_table, MappingTableSize(mapping_table)),
+      vmap_table == nullptr ? ArrayRef<const uint8_t>() :
+          ArrayRef<const uint8_t>(vmap_table, VmapTableSize(vmap_table)),
+      gc_map == nullptr ? ArrayRef<const uint8_t>() :
+          ArrayRef<const uint8_t>(gc_map, NativeGcMapSize(gc_map)),
+      ArrayRef<const uint8_t>());
+}
+
+std::string ReusableOatFile::DumpStats() const {
+  std::ostringstream oss;
+  oss << "reused " << reused_methods_.LoadRelaxed() << " of "
+      << (reused_methods_.LoadRelaxed() + compiled_methods_.LoadRelaxed())
+      << " compiled methods from " << oat_file_->GetLocation()
+      << " (" << unmatched_dex_files_ << " dex files not matched)";
+  return oss.str();
+}
+
+}  // namespace art
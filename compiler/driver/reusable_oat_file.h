@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_COMPILER_DRIVER_REUSABLE_OAT_FILE_H_
+#define ART_COMPILER_DRIVER_REUSABLE_OAT_FILE_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "atomic.h"
+#include "base/macros.h"
+#include "dex_file.h"
+#include "instruction_set.h"
+#include "method_reference.h"
+#include "oat_file.h"
+#include "safe_map.h"
+
+namespace art {
+
+class CompiledMethod;
+class CompilerDriver;
+
+// A previously written oat file whose compiled code is handed back to the CompilerDriver for
+// methods whose dex code has not changed, so that incremental rebuilds of large apps only pay for
+// the classes that were actually modified.
+//
+// Compiled code embeds dex indices (types, strings, fields, methods) as well as field offsets and
+// vtable indices that depend on the layout of classes in any of the dex files. Reuse is therefore
+// only attempted if the shape of every dex file, i.e. its index tables and the member lists of
+// all its classes, is identical to the one stored in the previous oat file. A method then reuses
+// its previous code if its code item is byte-for-byte identical. Methods small enough to be
+// inlined as special methods into their callers may not change at all, since we do not track
+// which callers inlined them.
+class ReusableOatFile {
+ public:
+  // Opens the oat file at "filename" and checks that its code can run with the current target and
+  // boot image. Returns nullptr and sets "error_msg" if the file cannot be reused at all.
+  static ReusableOatFile* Open(const std::string& filename,
+                               InstructionSet instruction_set,
+                               const InstructionSetFeatures& instruction_set_features,
+                               uint32_t image_file_location_oat_checksum,
+                               std::string* error_msg);
+
+  ~ReusableOatFile();
+
+  // Matches the dex files about to be compiled against those of the previous oat file and
+  // records which methods may reuse their previous code. Must be called before compilation.
+  void MatchDexFiles(const std::vector<const DexFile*>& dex_files);
+
+  // Returns a CompiledMethod holding the previously compiled code and maps of the method, or
+  // nullptr if the method needs to be compiled. Thread-safe once MatchDexFiles has run.
+  CompiledMethod* CreateCompiledMethod(CompilerDriver* driver, MethodReference method_ref);
+
+  const std::string& GetLocation() const {
+    return oat_file_->GetLocation();
+  }
+
+  std::string DumpStats() const;
+
+ private:
+  explicit ReusableOatFile(OatFile* oat_file);
+
+  // Matches a single dex file. Returns false if the dex file cannot reuse anything because a
+  // candidate for special method inlining changed.
+  bool MatchDexFile(const DexFile& dex_file, const DexFile& old_dex_file,
+                    const OatFile::OatDexFile& oat_dex_file,
+                    SafeMap<MethodReference, OatFile::OatMethod, MethodReferenceComparator>* methods);
+
+  std::unique_ptr<OatFile> oat_file_;
+
+  // Dex files opened from oat_file_, owned.
+  std::vector<const DexFile*> old_dex_files_;
+
+  // Methods of the dex files being compiled that may reuse their previous code.
+  SafeMap<MethodReference, OatFile::OatMethod, MethodReferenceComparator> reusable_methods_;
+
+  size_t unmatched_dex_files_;
+  Atomic<size_t> reused_methods_;
+  Atomic<size_t> compiled_methods_;
+
+  DISALLOW_COPY_AND_ASSIGN(ReusableOatFile);
+};
+
+}  // namespace art
+
+#endif  // ART_COMPILER_DRIVER_REUSABLE_OAT_FILE_H_
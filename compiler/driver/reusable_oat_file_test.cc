@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "driver/reusable_oat_file.h"
+
+#include <string.h>
+#include <memory>
+#include <ScopedLocalRef.h>
+
+#include "base/unix_file/fd_file.h"
+#include "class_linker.h"
+#include "common_compiler_test.h"
+#include "compiled_method.h"
+#include "dex_file.h"
+#include "driver/compiler_driver.h"
+#include "jni_internal.h"
+#include "oat_writer.h"
+#include "scoped_thread_state_change.h"
+#include "well_known_classes.h"
+
+namespace art {
+
+class ReusableOatFileTest : public CommonCompilerTest {
+ protected:
+  void SetUp() OVERRIDE {
+    CommonCompilerTest::SetUp();
+    ScopedObjectAccess soa(Thread::Current());
+    a_ = OpenTestDexFile("ReuseA");
+    b_ = OpenTestDexFile("ReuseB");
+    // The changed ReuseA, opened under the location of the original one.
+    const DexFile* a2 = OpenTestDexFile("ReuseA2");
+    std::string error_msg;
+    std::vector<const DexFile*> dex_files;
+    ASSERT_TRUE(DexFile::Open(a2->GetLocation().c_str(), a_->GetLocation().c_str(), &error_msg,
+                              &dex_files)) << error_msg;
+    ASSERT_EQ(1u, dex_files.size());
+    a2_.reset(dex_files[0]);
+  }
+
+  void TearDown() OVERRIDE {
+    a2_.reset();
+    CommonCompilerTest::TearDown();
+  }
+
+  // Compiles ReuseA and ReuseB into the oat file.
+  void WriteOatFile() {
+    std::vector<const DexFile*> dex_files;
+    dex_files.push_back(a_);
+    dex_files.push_back(b_);
+    jobject class_loader;
+    {
+      ScopedObjectAccess soa(Thread::Current());
+      for (const DexFile* dex_file : dex_files) {
+        class_linker_->RegisterDexFile(*dex_file);
+      }
+      ScopedLocalRef<jobject> class_loader_local(soa.Env(),
+          soa.Env()->AllocObject(WellKnownClasses::dalvik_system_PathClassLoader));
+      class_loader = soa.Env()->NewGlobalRef(class_loader_local.get());
+      Runtime::Current()->SetCompileTimeClassPath(class_loader, dex_files);
+    }
+    compiler_driver_.reset(new CompilerDriver(compiler_options_.get(),
+                                              verification_results_.get(),
+                                              method_inliner_map_.get(), Compiler::kQuick,
+                                              compiler_driver_->GetInstructionSet(),
+                                              compiler_driver_->GetInstructionSetFeatures(),
+                                              false, nullptr, nullptr, 2, false, false,
+                                              timer_.get()));
+    compiler_driver_->SetSupportBootImageFixup(false);
+    TimingLogger timings("ReusableOatFileTest::WriteOatFile", false, false);
+    compiler_driver_->CompileAll(class_loader, dex_files, &timings);
+
+    ScopedObjectAccess soa(Thread::Current());
+    SafeMap<std::string, std::string> key_value_store;
+    OatWriter oat_writer(dex_files, 42U, 4096U, 0, compiler_driver_.get(), &timings,
+                         &key_value_store);
+    ASSERT_TRUE(compiler_driver_->WriteElf(GetTestAndroidRoot(), !kIsTargetBuild, dex_files,
+                                           &oat_writer, oat_file_.GetFile()));
+  }
+
+  ReusableOatFile* OpenReusableOatFile() {
+    std::string error_msg;
+    ReusableOatFile* reusable_oat_file =
+        ReusableOatFile::Open(oat_file_.GetFilename(), compiler_driver_->GetInstructionSet(),
+                              compiler_driver_->GetInstructionSetFeatures(), 42U, &error_msg);
+    EXPECT_TRUE(reusable_oat_file != nullptr) << error_msg;
+    return reusable_oat_file;
+  }
+
+  // Returns whether the code of ReuseB.sum can be reused when compiling the given dex files.
+  bool CanReuseSum(const std::vector<const DexFile*>& dex_files) {
+    std::unique_ptr<ReusableOatFile> reusable_oat_file(OpenReusableOatFile());
+    if (reusable_oat_file.get() == nullptr) {
+      return false;
+    }
+    reusable_oat_file->MatchDexFiles(dex_files);
+    uint32_t method_idx = DexFile::kDexNoIndex;
+    for (size_t i = 0, e = b_->NumMethodIds(); i != e; ++i) {
+      const DexFile::MethodId& method_id = b_->GetMethodId(i);
+      if (strcmp(b_->GetMethodDeclaringClassDescriptor(method_id), "LReuseB;") == 0 &&
+          strcmp(b_->GetMethodName(method_id), "sum") == 0) {
+        method_idx = i;
+      }
+    }
+    CHECK_NE(method_idx, DexFile::kDexNoIndex);
+    CompiledMethod* compiled_method = reusable_oat_file->CreateCompiledMethod(
+        compiler_driver_.get(), MethodReference(b_, method_idx));
+    if (compiled_method == nullptr) {
+      return false;
+    }
+    CompiledMethod::ReleaseSwapAllocatedCompiledMethod(compiler_driver_.get(), compiled_method);
+    return true;
+  }
+
+  const DexFile* a_;
+  const DexFile* b_;
+  std::unique_ptr<const DexFile> a2_;
+  ScratchFile oat_file_;
+};
+
+TEST_F(ReusableOatFileTest, ReusesUnchangedDexFiles) {
+  TEST_DISABLED_FOR_PORTABLE();
+  WriteOatFile();
+  std::vector<const DexFile*> dex_files;
+  dex_files.push_back(a_);
+  dex_files.push_back(b_);
+  EXPECT_TRUE(CanReuseSum(dex_files));
+}
+
+TEST_F(ReusableOatFileTest, LayoutChangeInOtherDexFile) {
+  TEST_DISABLED_FOR_PORTABLE();
+  WriteOatFile();
+  // ReuseB is unchanged, but code in any dex file may depend on the layout of ReuseA.
+  std::vector<const DexFile*> dex_files;
+  dex_files.push_back(a2_.get());
+  dex_files.push_back(b_);
+  EXPECT_FALSE(CanReuseSum(dex_files));
+}
+
+TEST_F(ReusableOatFileTest, RemovedDexFile) {
+  TEST_DISABLED_FOR_PORTABLE();
+  WriteOatFile();
+  std::vector<const DexFile*> dex_files;
+  dex_files.push_back(b_);
+  EXPECT_FALSE(CanReuseSum(dex_files));
+}
+
+}  // namespace art
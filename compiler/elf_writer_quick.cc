@@ -16,6 +16,8 @@
 
 #include "elf_writer_quick.h"
 
+#include <algorithm>
+#include <functional>
 #include <unordered_map>
 
 #include "base/logging.h"
@@ -43,47 +45,44 @@ static uint8_t MakeStInfo(uint8_t binding, uint8_t type) {
   return ((binding) << 4) + ((type) & 0xf);
 }
 
+// A part of the ELF file at a precomputed offset. The pieces are written front to back through
+// a single buffered stream, see WriteOutFile().
 class ElfFilePiece {
  public:
   virtual ~ElfFilePiece() {}
 
-  virtual bool Write(File* elf_file) {
-    if (static_cast<off_t>(offset_) != lseek(elf_file->Fd(), offset_, SEEK_SET)) {
-      PLOG(ERROR) << "Failed to seek to " << GetDescription() << " offset " << offset_ << " for "
-          << elf_file->GetPath();
-      return false;
-    }
+  Elf32_Word GetOffset() const {
+    return offset_;
+  }
 
-    return DoActualWrite(elf_file);
+  Elf32_Word GetSize() const {
+    return size_;
   }
 
+  virtual std::string GetDescription() = 0;
+
+  // Writes the piece at the current position of "out", which is GetOffset().
+  virtual bool Write(OutputStream* out) = 0;
+
   static bool Compare(ElfFilePiece* a, ElfFilePiece* b) {
     return a->offset_ < b->offset_;
   }
 
  protected:
-  explicit ElfFilePiece(Elf32_Word offset) : offset_(offset) {}
+  ElfFilePiece(Elf32_Word offset, Elf32_Word size) : offset_(offset), size_(size) {}
 
-  virtual std::string GetDescription() = 0;
-  virtual bool DoActualWrite(File* elf_file) = 0;
-
-  Elf32_Word offset_;
+  const Elf32_Word offset_;
+  const Elf32_Word size_;
 };
 
 class ElfFileMemoryPiece : public ElfFilePiece {
  public:
   ElfFileMemoryPiece(const std::string& name, Elf32_Word offset, const void* data, Elf32_Word size)
-      : ElfFilePiece(offset), dbg_name_(name), data_(data), size_(size) {}
+      : ElfFilePiece(offset, size), dbg_name_(name), data_(data) {}
 
-  bool DoActualWrite(File* elf_file) OVERRIDE {
+  bool Write(OutputStream* out) OVERRIDE {
     DCHECK(data_ != nullptr || size_ == 0U) << dbg_name_ << " " << size_;
-
-    if (!elf_file->WriteFully(data_, size_)) {
-      PLOG(ERROR) << "Failed to write " << dbg_name_ << " for " << elf_file->GetPath();
-      return false;
-    }
-
-    return true;
+    return out->WriteFully(data_, size_);
   }
 
   std::string GetDescription() OVERRIDE {
@@ -91,61 +90,88 @@ class ElfFileMemoryPiece : public ElfFilePiece {
   }
 
  private:
-  const std::string& dbg_name_;
+  const std::string dbg_name_;
   const void *data_;
-  Elf32_Word size_;
 };
 
-class ElfFileRodataPiece : public ElfFilePiece {
+// A piece generated while it is written, so that it is never held in memory as a whole.
+class ElfFileStreamPiece : public ElfFilePiece {
  public:
-  ElfFileRodataPiece(Elf32_Word offset, OatWriter* oat_writer) : ElfFilePiece(offset),
-      oat_writer_(oat_writer) {}
-
-  bool DoActualWrite(File* elf_file) OVERRIDE {
-    std::unique_ptr<BufferedOutputStream> output_stream(
-        new BufferedOutputStream(new FileOutputStream(elf_file)));
-    if (!oat_writer_->Write(output_stream.get())) {
-      PLOG(ERROR) << "Failed to write .rodata and .text for " << elf_file->GetPath();
-      return false;
-    }
+  ElfFileStreamPiece(const std::string& name, Elf32_Word offset, Elf32_Word size,
+                     const std::function<bool(OutputStream*)>& write)
+      : ElfFilePiece(offset, size), dbg_name_(name), write_(write) {}
 
-    return true;
+  bool Write(OutputStream* out) OVERRIDE {
+    return write_(out);
   }
 
   std::string GetDescription() OVERRIDE {
-    return ".rodata";
+    return dbg_name_;
   }
 
  private:
-  OatWriter* oat_writer_;
+  const std::string dbg_name_;
+  const std::function<bool(OutputStream*)> write_;
 };
 
-class ElfFileOatTextPiece : public ElfFilePiece {
+// The .rodata and .text sections, both written by the OatWriter.
+class ElfFileRodataPiece : public ElfFilePiece {
  public:
-  ElfFileOatTextPiece(Elf32_Word offset, OatWriter* oat_writer) : ElfFilePiece(offset),
-      oat_writer_(oat_writer) {}
+  ElfFileRodataPiece(Elf32_Word offset, OatWriter* oat_writer)
+      : ElfFilePiece(offset, oat_writer->GetSize()), oat_writer_(oat_writer) {}
 
-  bool DoActualWrite(File* elf_file) OVERRIDE {
-    // All data is written by the ElfFileRodataPiece right now, as the oat writer writes in one
-    // piece. This is for future flexibility.
-    UNUSED(oat_writer_);
-    return true;
+  bool Write(OutputStream* out) OVERRIDE {
+    return oat_writer_->Write(out);
   }
 
   std::string GetDescription() OVERRIDE {
-    return ".text";
+    return ".rodata and .text";
   }
 
  private:
   OatWriter* oat_writer_;
 };
 
-static bool WriteOutFile(const std::vector<ElfFilePiece*>& pieces, File* elf_file) {
-  // TODO It would be nice if this checked for overlap.
-  for (auto it = pieces.begin(); it != pieces.end(); ++it) {
-    if (!(*it)->Write(elf_file)) {
+static bool WritePadding(OutputStream* out, size_t size) {
+  static const uint8_t kZeroes[256] = { 0 };
+  while (size != 0u) {
+    size_t chunk_size = std::min(size, sizeof(kZeroes));
+    if (!out->WriteFully(kZeroes, chunk_size)) {
       return false;
     }
+    size -= chunk_size;
+  }
+  return true;
+}
+
+// Writes all the pieces in one pass in the order of their offsets, filling the gaps with zeroes.
+// Only the stream's buffer is needed on top of the pieces that are kept in memory anyway.
+static bool WriteOutFile(std::vector<ElfFilePiece*>* pieces, File* elf_file) {
+  std::stable_sort(pieces->begin(), pieces->end(), ElfFilePiece::Compare);
+  BufferedOutputStream out(new FileOutputStream(elf_file));
+  if (out.Seek(0, kSeekSet) != 0) {
+    PLOG(ERROR) << "Failed to seek to the start of " << elf_file->GetPath();
+    return false;
+  }
+  Elf32_Word offset = 0u;
+  for (ElfFilePiece* piece : *pieces) {
+    if (piece->GetOffset() < offset) {
+      LOG(ERROR) << piece->GetDescription() << " at offset " << piece->GetOffset()
+          << " overlaps the previous piece ending at " << offset << " in " << elf_file->GetPath();
+      return false;
+    }
+    if (!WritePadding(&out, piece->GetOffset() - offset) || !piece->Write(&out)) {
+      PLOG(ERROR) << "Failed to write " << piece->GetDescription() << " for "
+          << elf_file->GetPath();
+      return false;
+    }
+    offset = piece->GetOffset() + piece->GetSize();
+    DCHECK_EQ(static_cast<off_t>(offset), out.Seek(0, kSeekCurrent)) << piece->GetDescription();
+  }
+  // Flush the buffer.
+  if (out.Seek(0, kSeekCurrent) != static_cast<off_t>(offset)) {
+    PLOG(ERROR) << "Failed to write " << elf_file->GetPath();
+    return false;
   }
   return true;
 }
@@ -452,7 +478,7 @@ bool ElfWriterQuick::ElfBuilder::Init() {
 bool ElfWriterQuick::ElfBuilder::Write() {
   std::vector<ElfFilePiece*> pieces;
   Elf32_Shdr prev = dynamic_builder_.section_;
-  std::string strtab;
+  Elf32_Word strtab_size = 0u;
 
   if (IncludingDebugSymbols()) {
     // Setup .symtab
@@ -465,21 +491,19 @@ bool ElfWriterQuick::ElfBuilder::Write() {
     AssignSectionStr(&symtab_builder_.strtab_, &shstrtab_);
     symtab_builder_.strtab_.section_index_ = section_index_++;
 
-    strtab = symtab_builder_.GenerateStrtab();
+    strtab_size = symtab_builder_.LayoutStrtab();
     if (debug_logging_) {
-      LOG(INFO) << "strtab size (bytes)    =" << strtab.size()
-                << std::hex << " " << strtab.size();
+      LOG(INFO) << "strtab size (bytes)    =" << strtab_size
+                << std::hex << " " << strtab_size;
       LOG(INFO) << "symtab size (elements) =" << symtab_builder_.GetSize()
                 << std::hex << " " << symtab_builder_.GetSize();
     }
   }
 
   // Setup all the other sections.
-  for (ElfRawSectionBuilder *builder = other_builders_.data(),
-                            *end = builder + other_builders_.size();
-       builder != end; ++builder) {
+  for (const std::unique_ptr<ElfRawSectionBuilder>& builder : other_builders_) {
     section_ptrs_.push_back(&builder->section_);
-    AssignSectionStr(builder, &shstrtab_);
+    AssignSectionStr(builder.get(), &shstrtab_);
     builder->section_index_ = section_index_++;
   }
 
@@ -508,7 +532,7 @@ bool ElfWriterQuick::ElfBuilder::Write() {
     symtab_builder_.strtab_.section_.sh_offset = NextOffset(symtab_builder_.strtab_.section_,
                                                             symtab_builder_.section_);
     symtab_builder_.strtab_.section_.sh_addr = 0;
-    symtab_builder_.strtab_.section_.sh_size = strtab.size();
+    symtab_builder_.strtab_.section_.sh_size = strtab_size;
     symtab_builder_.strtab_.section_.sh_link = symtab_builder_.strtab_.GetLink();
 
     prev = symtab_builder_.strtab_.section_;
@@ -522,18 +546,16 @@ bool ElfWriterQuick::ElfBuilder::Write() {
 
   // Get the layout of the extra sections. (This will deal with the debug
   // sections if they are there)
-  for (auto it = other_builders_.begin(); it != other_builders_.end(); ++it) {
-    it->section_.sh_offset = NextOffset(it->section_, prev);
-    it->section_.sh_addr = 0;
-    it->section_.sh_size = it->GetBuffer()->size();
-    it->section_.sh_link = it->GetLink();
+  for (const std::unique_ptr<ElfRawSectionBuilder>& builder : other_builders_) {
+    builder->section_.sh_offset = NextOffset(builder->section_, prev);
+    builder->section_.sh_addr = 0;
+    builder->section_.sh_size = builder->GetBuffer()->size();
+    builder->section_.sh_link = builder->GetLink();
 
-    // We postpone adding an ElfFilePiece to keep the order in "pieces."
-
-    prev = it->section_;
+    prev = builder->section_;
     if (debug_logging_) {
-      LOG(INFO) << it->name_ << " off=" << it->section_.sh_offset
-                << " " << it->name_ << " size=" << it->section_.sh_size;
+      LOG(INFO) << builder->name_ << " off=" << builder->section_.sh_offset
+                << " " << builder->name_ << " size=" << builder->section_.sh_size;
     }
   }
 
@@ -552,15 +574,6 @@ bool ElfWriterQuick::ElfBuilder::Write() {
       shstrtab_builder_.section_.sh_offset + shstrtab_builder_.section_.sh_size,
       sizeof(Elf32_Word));
 
-  // Setup the actual symbol arrays.
-  std::vector<Elf32_Sym> dynsym = dynsym_builder_.GenerateSymtab();
-  CHECK_EQ(dynsym.size() * sizeof(Elf32_Sym), dynsym_builder_.section_.sh_size);
-  std::vector<Elf32_Sym> symtab;
-  if (IncludingDebugSymbols()) {
-    symtab = symtab_builder_.GenerateSymtab();
-    CHECK_EQ(symtab.size() * sizeof(Elf32_Sym), symtab_builder_.section_.sh_size);
-  }
-
   // Setup the dynamic section.
   // This will add the 2 values we cannot know until now time, namely the size
   // and the soname_offset.
@@ -604,25 +617,35 @@ bool ElfWriterQuick::ElfBuilder::Write() {
   elf_header_.e_shnum = section_ptrs_.size();
   elf_header_.e_shstrndx = shstrtab_builder_.section_index_;
 
-  // Add the rest of the pieces to the list.
+  // Add the pieces to the list, WriteOutFile() sorts them by offset.
   pieces.push_back(new ElfFileMemoryPiece("Elf Header", 0, &elf_header_, sizeof(elf_header_)));
   pieces.push_back(new ElfFileMemoryPiece("Program headers", PHDR_OFFSET,
                                           &program_headers_, sizeof(program_headers_)));
   pieces.push_back(new ElfFileMemoryPiece(".dynamic", dynamic_builder_.section_.sh_offset,
                                           dynamic.data(), dynamic_builder_.section_.sh_size));
-  pieces.push_back(new ElfFileMemoryPiece(".dynsym", dynsym_builder_.section_.sh_offset,
-                                          dynsym.data(), dynsym.size() * sizeof(Elf32_Sym)));
+  pieces.push_back(new ElfFileStreamPiece(".dynsym", dynsym_builder_.section_.sh_offset,
+                                          dynsym_builder_.section_.sh_size,
+                                          [this](OutputStream* out) {
+                                            return dynsym_builder_.WriteSymtab(out);
+                                          }));
   pieces.push_back(new ElfFileMemoryPiece(".dynstr", dynsym_builder_.strtab_.section_.sh_offset,
                                           dynstr_.c_str(), dynstr_.size()));
   pieces.push_back(new ElfFileMemoryPiece(".hash", hash_builder_.section_.sh_offset,
                                           hash_.data(), hash_.size() * sizeof(Elf32_Word)));
+  CHECK_EQ(rodata_builder_.section_.sh_offset + oat_writer_->GetSize(),
+           text_builder_.section_.sh_offset + text_builder_.section_.sh_size);
   pieces.push_back(new ElfFileRodataPiece(rodata_builder_.section_.sh_offset, oat_writer_));
-  pieces.push_back(new ElfFileOatTextPiece(text_builder_.section_.sh_offset, oat_writer_));
   if (IncludingDebugSymbols()) {
-    pieces.push_back(new ElfFileMemoryPiece(".symtab", symtab_builder_.section_.sh_offset,
-                                            symtab.data(), symtab.size() * sizeof(Elf32_Sym)));
-    pieces.push_back(new ElfFileMemoryPiece(".strtab", symtab_builder_.strtab_.section_.sh_offset,
-                                            strtab.c_str(), strtab.size()));
+    pieces.push_back(new ElfFileStreamPiece(".symtab", symtab_builder_.section_.sh_offset,
+                                            symtab_builder_.section_.sh_size,
+                                            [this](OutputStream* out) {
+                                              return symtab_builder_.WriteSymtab(out);
+                                            }));
+    pieces.push_back(new ElfFileStreamPiece(".strtab", symtab_builder_.strtab_.section_.sh_offset,
+                                            symtab_builder_.strtab_.section_.sh_size,
+                                            [this](OutputStream* out) {
+                                              return symtab_builder_.WriteStrtab(out);
+                                            }));
   }
   pieces.push_back(new ElfFileMemoryPiece(".shstrtab", shstrtab_builder_.section_.sh_offset,
                                           &shstrtab_[0], shstrtab_.size()));
@@ -634,13 +657,13 @@ bool ElfWriterQuick::ElfBuilder::Write() {
                                             section_ptrs_[i], sizeof(Elf32_Shdr)));
   }
 
-  // Postponed debug info.
-  for (auto it = other_builders_.begin(); it != other_builders_.end(); ++it) {
-    pieces.push_back(new ElfFileMemoryPiece(it->name_, it->section_.sh_offset,
-                                            it->GetBuffer()->data(), it->GetBuffer()->size()));
+  for (const std::unique_ptr<ElfRawSectionBuilder>& builder : other_builders_) {
+    pieces.push_back(new ElfFileMemoryPiece(builder->name_, builder->section_.sh_offset,
+                                            builder->GetBuffer()->data(),
+                                            builder->GetBuffer()->size()));
   }
 
-  if (!WriteOutFile(pieces, elf_file_)) {
+  if (!WriteOutFile(&pieces, elf_file_)) {
     LOG(ERROR) << "Unable to write to file " << elf_file_->GetPath();
 
     STLDeleteElements(&pieces);  // Have to manually clean pieces.
@@ -700,12 +723,13 @@ std::vector<Elf32_Dyn> ElfWriterQuick::ElfDynamicBuilder::GetDynamics(Elf32_Word
   return ret;
 }
 
-std::vector<Elf32_Sym> ElfWriterQuick::ElfSymtabBuilder::GenerateSymtab() {
-  std::vector<Elf32_Sym> ret;
+bool ElfWriterQuick::ElfSymtabBuilder::WriteSymtab(OutputStream* out) const {
   Elf32_Sym undef_sym;
   memset(&undef_sym, 0, sizeof(undef_sym));
   undef_sym.st_shndx = SHN_UNDEF;
-  ret.push_back(undef_sym);
+  if (!out->WriteFully(&undef_sym, sizeof(undef_sym))) {
+    return false;
+  }
 
   for (auto it = symbols_.cbegin(); it != symbols_.cend(); ++it) {
     Elf32_Sym sym;
@@ -721,20 +745,44 @@ std::vector<Elf32_Sym> ElfWriterQuick::ElfSymtabBuilder::GenerateSymtab() {
     sym.st_shndx = it->section_->section_index_;
     sym.st_info = it->info_;
 
-    ret.push_back(sym);
+    if (!out->WriteFully(&sym, sizeof(sym))) {
+      return false;
+    }
   }
-  return ret;
+  return true;
+}
+
+Elf32_Word ElfWriterQuick::ElfSymtabBuilder::LayoutStrtab() {
+  Elf32_Word size = 1u;
+  for (auto it = symbols_.begin(); it != symbols_.end(); ++it) {
+    it->name_idx_ = size;
+    size += it->name_.size() + 1u;
+  }
+  strtab_.section_.sh_size = size;
+  return size;
+}
+
+bool ElfWriterQuick::ElfSymtabBuilder::WriteStrtab(OutputStream* out) const {
+  if (!out->WriteFully("", 1u)) {
+    return false;
+  }
+  for (auto it = symbols_.cbegin(); it != symbols_.cend(); ++it) {
+    if (!out->WriteFully(it->name_.c_str(), it->name_.size() + 1u)) {
+      return false;
+    }
+  }
+  return true;
 }
 
 std::string ElfWriterQuick::ElfSymtabBuilder::GenerateStrtab() {
   std::string tab;
+  tab.reserve(LayoutStrtab());
   tab += '\0';
   for (auto it = symbols_.begin(); it != symbols_.end(); ++it) {
-    it->name_idx_ = tab.size();
+    DCHECK_EQ(it->name_idx_, tab.size());
     tab += it->name_;
     tab += '\0';
   }
-  strtab_.section_.sh_size = tab.size();
   return tab;
 }
 
@@ -1079,10 +1127,11 @@ bool ElfWriterQuick::Write(OatWriter* oat_writer,
   }
 
   if (compiler_driver_->GetCompilerOptions().GetIncludePatchInformation()) {
-    ElfRawSectionBuilder oat_patches(".oat_patches", SHT_OAT_PATCH, 0, NULL, 0,
-                                     sizeof(uintptr_t), sizeof(uintptr_t));
-    ReservePatchSpace(oat_patches.GetBuffer(), debug);
+    ElfRawSectionBuilder* oat_patches = new ElfRawSectionBuilder(".oat_patches", SHT_OAT_PATCH,
+                                                                 0, NULL, 0, sizeof(uintptr_t),
+                                                                 sizeof(uintptr_t));
     builder.RegisterRawSection(oat_patches);
+    ReservePatchSpace(oat_patches->GetBuffer(), debug);
   }
 
   return builder.Write();
@@ -1167,30 +1216,35 @@ void ElfWriterQuick::WriteDebugSymbols(ElfBuilder* builder, OatWriter* oat_write
   }
 
   if (hasLineInfo || hasCFI) {
-    ElfRawSectionBuilder debug_info(".debug_info",     SHT_PROGBITS, 0, nullptr, 0, 1, 0);
-    ElfRawSectionBuilder debug_abbrev(".debug_abbrev", SHT_PROGBITS, 0, nullptr, 0, 1, 0);
-    ElfRawSectionBuilder debug_str(".debug_str",       SHT_PROGBITS, 0, nullptr, 0, 1, 0);
-    ElfRawSectionBuilder debug_line(".debug_line",     SHT_PROGBITS, 0, nullptr, 0, 1, 0);
-
-    FillInCFIInformation(oat_writer, debug_info.GetBuffer(),
-                         debug_abbrev.GetBuffer(), debug_str.GetBuffer(),
-                         hasLineInfo ? debug_line.GetBuffer() : nullptr,
+    std::unique_ptr<ElfRawSectionBuilder> debug_info(
+        new ElfRawSectionBuilder(".debug_info", SHT_PROGBITS, 0, nullptr, 0, 1, 0));
+    std::unique_ptr<ElfRawSectionBuilder> debug_abbrev(
+        new ElfRawSectionBuilder(".debug_abbrev", SHT_PROGBITS, 0, nullptr, 0, 1, 0));
+    std::unique_ptr<ElfRawSectionBuilder> debug_str(
+        new ElfRawSectionBuilder(".debug_str", SHT_PROGBITS, 0, nullptr, 0, 1, 0));
+    std::unique_ptr<ElfRawSectionBuilder> debug_line(
+        new ElfRawSectionBuilder(".debug_line", SHT_PROGBITS, 0, nullptr, 0, 1, 0));
+
+    FillInCFIInformation(oat_writer, debug_info->GetBuffer(),
+                         debug_abbrev->GetBuffer(), debug_str->GetBuffer(),
+                         hasLineInfo ? debug_line->GetBuffer() : nullptr,
                          text_section_address);
 
-    builder->RegisterRawSection(debug_info);
-    builder->RegisterRawSection(debug_abbrev);
+    builder->RegisterRawSection(debug_info.release());
+    builder->RegisterRawSection(debug_abbrev.release());
 
     if (hasCFI) {
-      ElfRawSectionBuilder eh_frame(".eh_frame",  SHT_PROGBITS, SHF_ALLOC, nullptr, 0, 4, 0);
-      eh_frame.SetBuffer(std::move(*cfi_info.get()));
+      ElfRawSectionBuilder* eh_frame =
+          new ElfRawSectionBuilder(".eh_frame", SHT_PROGBITS, SHF_ALLOC, nullptr, 0, 4, 0);
+      eh_frame->SetBuffer(std::move(*cfi_info.get()));
       builder->RegisterRawSection(eh_frame);
     }
 
     if (hasLineInfo) {
-      builder->RegisterRawSection(debug_line);
+      builder->RegisterRawSection(debug_line.release());
     }
 
-    builder->RegisterRawSection(debug_str);
+    builder->RegisterRawSection(debug_str.release());
   }
 }
 
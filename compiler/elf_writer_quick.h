@@ -17,12 +17,16 @@
 #ifndef ART_COMPILER_ELF_WRITER_QUICK_H_
 #define ART_COMPILER_ELF_WRITER_QUICK_H_
 
+#include <memory>
+
 #include "elf_utils.h"
 #include "elf_writer.h"
 #include "instruction_set.h"
 
 namespace art {
 
+class OutputStream;
+
 class ElfWriterQuick FINAL : public ElfWriter {
  public:
   // Write an ELF file. Returns true on success, false on failure.
@@ -124,7 +128,7 @@ class ElfWriterQuick FINAL : public ElfWriter {
         : ElfSectionBuilder(sec_name, type, flags, link, info, align, entsize) {}
     ~ElfRawSectionBuilder() {}
     std::vector<uint8_t>* GetBuffer() { return &buf_; }
-    void SetBuffer(std::vector<uint8_t>&& buf) { buf_ = buf; }
+    void SetBuffer(std::vector<uint8_t>&& buf) { buf_ = std::move(buf); }
 
    protected:
     std::vector<uint8_t> buf_;
@@ -175,7 +179,13 @@ class ElfWriterQuick FINAL : public ElfWriter {
    protected:
     std::vector<Elf32_Word> GenerateHashContents();
     std::string GenerateStrtab();
-    std::vector<Elf32_Sym> GenerateSymtab();
+
+    // Assigns the offsets of the symbol names in the string table and returns its size.
+    Elf32_Word LayoutStrtab();
+
+    // Write the string table and the symbol table, the section offsets and indexes being final.
+    bool WriteStrtab(OutputStream* out) const;
+    bool WriteSymtab(OutputStream* out) const;
 
     Elf32_Word GetSize() {
       // 1 is for the implicit NULL symbol.
@@ -190,7 +200,7 @@ class ElfWriterQuick FINAL : public ElfWriter {
       bool is_relative_;
       uint8_t info_;
       uint8_t other_;
-      // Used during Write() to temporarially hold name index in the strtab.
+      // Assigned by LayoutStrtab(), the index of the name in the strtab.
       Elf32_Word name_idx_;
     };
 
@@ -240,10 +250,9 @@ class ElfWriterQuick FINAL : public ElfWriter {
     bool Init();
     bool Write();
 
-    // Adds the given raw section to the builder. This will copy it. The caller
-    // is responsible for deallocating their copy.
-    void RegisterRawSection(ElfRawSectionBuilder bld) {
-      other_builders_.push_back(bld);
+    // Adds the given raw section to the builder, which takes ownership of it.
+    void RegisterRawSection(ElfRawSectionBuilder* bld) {
+      other_builders_.push_back(std::unique_ptr<ElfRawSectionBuilder>(bld));
     }
 
    private:
@@ -285,7 +294,7 @@ class ElfWriterQuick FINAL : public ElfWriter {
     ElfSectionBuilder hash_builder_;
     ElfDynamicBuilder dynamic_builder_;
     ElfSectionBuilder shstrtab_builder_;
-    std::vector<ElfRawSectionBuilder> other_builders_;
+    std::vector<std::unique_ptr<ElfRawSectionBuilder>> other_builders_;
 
    private:
     void SetISA(InstructionSet isa);
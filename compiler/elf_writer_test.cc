@@ -16,9 +16,18 @@
 
 #include "elf_file.h"
 
+#include <fcntl.h>
+#include <stdlib.h>
+
 #include "base/stringprintf.h"
+#include "class_linker.h"
 #include "common_compiler_test.h"
+#include "dex/quick/dex_file_to_method_inliner_map.h"
+#include "dex/verification_results.h"
+#include "driver/compiler_driver.h"
 #include "oat.h"
+#include "oat_writer.h"
+#include "scoped_thread_state_change.h"
 #include "utils.h"
 
 namespace art {
@@ -113,4 +122,67 @@ TEST_F(ElfWriterTest, dlsym) {
   }
 }
 
+// Returns the peak resident set size of the process in KB, or 0 if it is unknown.
+static size_t GetPeakRss() {
+  std::string status;
+  if (!ReadFileToString("/proc/self/status", &status)) {
+    return 0u;
+  }
+  size_t pos = status.find("VmHWM:");
+  if (pos == std::string::npos) {
+    return 0u;
+  }
+  return strtoul(status.c_str() + pos + strlen("VmHWM:"), nullptr, 10);
+}
+
+// Resets the peak resident set size to the current one. Returns false if the kernel cannot.
+static bool ResetPeakRss() {
+  int fd = TEMP_FAILURE_RETRY(open("/proc/self/clear_refs", O_WRONLY));
+  if (fd == -1) {
+    return false;
+  }
+  bool success = TEMP_FAILURE_RETRY(write(fd, "5", 1)) == 1;
+  close(fd);
+  return success;
+}
+
+TEST_F(ElfWriterTest, PeakMemory) {
+  TEST_DISABLED_FOR_PORTABLE();
+  TimingLogger timings("ElfWriterTest::PeakMemory", false, false);
+  ClassLinker* class_linker = Runtime::Current()->GetClassLinker();
+  InstructionSet insn_set = kIsTargetBuild ? kThumb2 : kX86;
+  InstructionSetFeatures insn_features;
+  std::unique_ptr<CompilerDriver> driver(new CompilerDriver(compiler_options_.get(),
+                                                            verification_results_.get(),
+                                                            method_inliner_map_.get(),
+                                                            Compiler::kQuick, insn_set,
+                                                            insn_features, false, nullptr,
+                                                            nullptr, 2, true, true,
+                                                            timer_.get()));
+  driver->CompileAll(nullptr, class_linker->GetBootClassPath(), &timings);
+
+  ScopedObjectAccess soa(Thread::Current());
+  ScratchFile tmp;
+  SafeMap<std::string, std::string> key_value_store;
+  key_value_store.Put(OatHeader::kImageLocationKey, "lue.art");
+  OatWriter oat_writer(class_linker->GetBootClassPath(), 42U, 4096U, 0, driver.get(), &timings,
+                       &key_value_store);
+  bool peak_reset = ResetPeakRss();
+  size_t peak_before = GetPeakRss();
+  ASSERT_TRUE(driver->WriteElf(GetTestAndroidRoot(), !kIsTargetBuild,
+                               class_linker->GetBootClassPath(), &oat_writer, tmp.GetFile()));
+  size_t peak_after = GetPeakRss();
+  int64_t file_size = tmp.GetFile()->GetLength();
+  ASSERT_LT(0, file_size);
+  LOG(INFO) << "Peak RSS " << peak_before << "KB before and " << peak_after
+      << "KB after writing " << PrettySize(file_size)
+      << (peak_reset ? "" : " (peak RSS not reset)");
+
+  if (peak_reset && peak_before != 0u) {
+    // The sections are streamed to the file, only the symbols and debug information are held
+    // in memory while writing.
+    EXPECT_LT((peak_after - peak_before) * KB, static_cast<size_t>(file_size) / 2u);
+  }
+}
+
 }  // namespace art
@@ -54,6 +54,7 @@
 #include "oat_file.h"
 #include "runtime.h"
 #include "scoped_thread_state_change.h"
+#include "thread_pool.h"
 #include "handle_scope-inl.h"
 
 #include <numeric>
@@ -72,6 +73,9 @@ namespace art {
 // Separate objects into multiple bins to optimize dirty memory use.
 static constexpr bool kBinObjects = true;
 
+// Number of objects copied by a single task, see CopyAndFixupObjects().
+static constexpr size_t kObjectsPerTask = 4096u;
+
 bool ImageWriter::Write(const std::string& image_filename,
                         uintptr_t image_begin,
                         const std::string& oat_filename,
@@ -141,17 +145,26 @@ bool ImageWriter::Write(const std::string& image_filename,
     CheckNonImageClassesRemoved();
   }
 
+  // Create the pool that copies the objects while suspended, since it waits for its workers to
+  // attach.
+  std::unique_ptr<ThreadPool> thread_pool;
+  size_t thread_count = compiler_driver_.GetThreadCount();
+  if (thread_count > 1u) {
+    thread_pool.reset(new ThreadPool("Image writer thread pool", thread_count - 1u));
+  }
+
   Thread::Current()->TransitionFromSuspendedToRunnable();
   size_t oat_loaded_size = 0;
   size_t oat_data_offset = 0;
   ElfWriter::GetOatElfInformation(oat_file.get(), oat_loaded_size, oat_data_offset);
   CalculateNewObjectOffsets(oat_loaded_size, oat_data_offset);
-  CopyAndFixupObjects();
+  CopyAndFixupObjects(thread_pool.get());
 
   PatchOatCodeAndMethods(oat_file.get());
 
   // Before flushing, which might fail, release the mutator lock.
   Thread::Current()->TransitionFromRunnableToSuspended(kNative);
+  thread_pool.reset();
 
   if (oat_file->FlushCloseOrErase() != 0) {
     LOG(ERROR) << "Failed to flush and close oat file " << oat_filename << " for " << oat_location;
@@ -953,15 +966,60 @@ void ImageWriter::CalculateNewObjectOffsets(size_t oat_loaded_size, size_t oat_d
   // Note that image_end_ is left at end of used space
 }
 
-void ImageWriter::CopyAndFixupObjects() {
+// Copies and fixes up a range of the objects collected by CopyAndFixupObjects().
+class ImageWriter::CopyAndFixupObjectsTask FINAL : public Task {
+ public:
+  CopyAndFixupObjectsTask(ImageWriter* image_writer, mirror::Object* const* begin,
+                          mirror::Object* const* end)
+    : image_writer_(image_writer), begin_(begin), end_(end) {
+  }
+
+  void Run(Thread* self) OVERRIDE {
+    ScopedObjectAccess soa(self);
+    for (mirror::Object* const* it = begin_; it != end_; ++it) {
+      image_writer_->CopyAndFixupObject(*it);
+    }
+  }
+
+  void Finalize() OVERRIDE {
+    delete this;
+  }
+
+ private:
+  ImageWriter* const image_writer_;
+  mirror::Object* const* const begin_;
+  mirror::Object* const* const end_;
+
+  DISALLOW_COPY_AND_ASSIGN(CopyAndFixupObjectsTask);
+};
+
+void ImageWriter::CopyAndFixupObjects(ThreadPool* thread_pool) {
   Thread* self = Thread::Current();
   const char* old_cause = self->StartAssertNoThreadSuspension("ImageWriter");
   gc::Heap* heap = Runtime::Current()->GetHeap();
   // TODO: heap validation can't handle this fix up pass
   heap->DisableObjectValidation();
   // TODO: Image spaces only?
-  WriterMutexLock mu(self, *Locks::heap_bitmap_lock_);
-  heap->VisitObjects(CopyAndFixupObjectsCallback, this);
+  std::vector<mirror::Object*> objects;
+  {
+    ReaderMutexLock mu(self, *Locks::heap_bitmap_lock_);
+    heap->VisitObjects(CollectObjectsCallback, &objects);
+  }
+  // Every object is copied to its own place in the image and only the originals are read, so the
+  // objects can be copied and fixed up in any order, on the compiler driver's threads.
+  if (thread_pool != nullptr && objects.size() > kObjectsPerTask) {
+    for (size_t begin = 0u; begin < objects.size(); begin += kObjectsPerTask) {
+      size_t end = std::min(begin + kObjectsPerTask, objects.size());
+      thread_pool->AddTask(self, new CopyAndFixupObjectsTask(this, objects.data() + begin,
+                                                             objects.data() + end));
+    }
+    thread_pool->StartWorkers(self);
+    thread_pool->Wait(self, true, true);
+  } else {
+    for (mirror::Object* obj : objects) {
+      CopyAndFixupObject(obj);
+    }
+  }
   // Fix up the object previously had hash codes.
   for (const std::pair<mirror::Object*, uint32_t>& hash_pair : saved_hashes_) {
     hash_pair.first->SetLockWord(LockWord::FromHashCode(hash_pair.second), false);
@@ -970,13 +1028,16 @@ void ImageWriter::CopyAndFixupObjects() {
   self->EndAssertNoThreadSuspension(old_cause);
 }
 
-void ImageWriter::CopyAndFixupObjectsCallback(Object* obj, void* arg) {
+void ImageWriter::CollectObjectsCallback(Object* obj, void* arg) {
+  DCHECK(obj != nullptr);
+  reinterpret_cast<std::vector<mirror::Object*>*>(arg)->push_back(obj);
+}
+
+void ImageWriter::CopyAndFixupObject(Object* obj) {
   DCHECK(obj != nullptr);
-  DCHECK(arg != nullptr);
-  ImageWriter* image_writer = reinterpret_cast<ImageWriter*>(arg);
   // see GetLocalAddress for similar computation
-  size_t offset = image_writer->GetImageOffset(obj);
-  byte* dst = image_writer->image_->Begin() + offset;
+  size_t offset = GetImageOffset(obj);
+  byte* dst = image_->Begin() + offset;
   const byte* src = reinterpret_cast<const byte*>(obj);
   size_t n;
   if (obj->IsArtMethod()) {
@@ -986,13 +1047,13 @@ void ImageWriter::CopyAndFixupObjectsCallback(Object* obj, void* arg) {
   } else {
     n = obj->SizeOf();
   }
-  DCHECK_LT(offset + n, image_writer->image_->Size());
+  DCHECK_LT(offset + n, image_->Size());
   memcpy(dst, src, n);
   Object* copy = reinterpret_cast<Object*>(dst);
   // Write in a hash code of objects which have inflated monitors or a hash code in their monitor
   // word.
   copy->SetLockWord(LockWord(), false);
-  image_writer->FixupObject(obj, copy);
+  FixupObject(obj, copy);
 }
 
 // Rewrite all the references in the copied object to point to their image address equivalent
@@ -1002,7 +1063,7 @@ class FixupVisitor {
   }
 
   void operator()(Object* obj, MemberOffset offset, bool /*is_static*/) const
-      EXCLUSIVE_LOCKS_REQUIRED(Locks::mutator_lock_, Locks::heap_bitmap_lock_) {
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
     Object* ref = obj->GetFieldObject<Object, kVerifyNone>(offset);
     // Use SetFieldObjectWithoutWriteBarrier to avoid card marking since we are writing to the
     // image.
@@ -1012,8 +1073,7 @@ class FixupVisitor {
 
   // java.lang.ref.Reference visitor.
   void operator()(mirror::Class* /*klass*/, mirror::Reference* ref) const
-      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_)
-      EXCLUSIVE_LOCKS_REQUIRED(Locks::heap_bitmap_lock_) {
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
     copy_->SetFieldObjectWithoutWriteBarrier<false, true, kVerifyNone>(
         mirror::Reference::ReferentOffset(), image_writer_->GetImageAddress(ref->GetReferent()));
   }
@@ -1029,7 +1089,7 @@ class FixupClassVisitor FINAL : public FixupVisitor {
   }
 
   void operator()(Object* obj, MemberOffset offset, bool /*is_static*/) const
-      EXCLUSIVE_LOCKS_REQUIRED(Locks::mutator_lock_, Locks::heap_bitmap_lock_) {
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
     DCHECK(obj->IsClass());
     FixupVisitor::operator()(obj, offset, /*is_static*/false);
 
@@ -1040,8 +1100,7 @@ class FixupClassVisitor FINAL : public FixupVisitor {
   }
 
   void operator()(mirror::Class* /*klass*/, mirror::Reference* ref) const
-      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_)
-      EXCLUSIVE_LOCKS_REQUIRED(Locks::heap_bitmap_lock_) {
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
     LOG(FATAL) << "Reference not expected here.";
   }
 };
@@ -213,9 +213,12 @@ class ImageWriter FINAL {
   static void UnbinObjectsIntoOffsetCallback(mirror::Object* obj, void* arg)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
-  // Creates the contiguous image in memory and adjusts pointers.
-  void CopyAndFixupObjects() SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
-  static void CopyAndFixupObjectsCallback(mirror::Object* obj, void* arg)
+  // Creates the contiguous image in memory and adjusts pointers, on the workers of thread_pool
+  // too unless it is null.
+  void CopyAndFixupObjects(ThreadPool* thread_pool) SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+  static void CollectObjectsCallback(mirror::Object* obj, void* arg)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+  void CopyAndFixupObject(mirror::Object* obj)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
   void FixupMethod(mirror::ArtMethod* orig, mirror::ArtMethod* copy)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
@@ -285,6 +288,8 @@ class ImageWriter FINAL {
   size_t bin_slot_sizes_[kBinSize];  // Number of bytes in a bin
   size_t bin_slot_count_[kBinSize];  // Number of objects in a bin
 
+  class CopyAndFixupObjectsTask;
+
   friend class FixupVisitor;
   friend class FixupClassVisitor;
   DISALLOW_COPY_AND_ASSIGN(ImageWriter);
@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include "base/stringprintf.h"
 #include "class_linker.h"
 #include "common_compiler_test.h"
 #include "compiler.h"
@@ -182,6 +183,176 @@ TEST_F(OatTest, WriteRead) {
   }
 }
 
+// Returns the number of distinct pages touched by the method headers and code of the methods.
+static size_t CountTouchedPages(const OatFile::OatDexFile* oat_dex_file,
+                                const std::vector<std::pair<size_t, size_t>>& methods) {
+  std::set<uintptr_t> pages;
+  for (const std::pair<size_t, size_t>& method : methods) {
+    const OatFile::OatClass oat_class = oat_dex_file->GetOatClass(method.first);
+    const OatFile::OatMethod oat_method = oat_class.GetOatMethod(method.second);
+    uintptr_t code_offset = RoundDown(oat_method.GetCodeOffset(), 2);
+    uintptr_t begin = code_offset - sizeof(OatQuickMethodHeader);
+    uintptr_t end = code_offset + oat_method.GetQuickCodeSize();
+    for (uintptr_t page = RoundDown(begin, kPageSize); page < end; page += kPageSize) {
+      pages.insert(page);
+    }
+  }
+  return pages.size();
+}
+
+TEST_F(OatTest, ProfileCodeLayout) {
+  TEST_DISABLED_FOR_PORTABLE();
+  TimingLogger timings("OatTest::ProfileCodeLayout", false, false);
+  ClassLinker* class_linker = Runtime::Current()->GetClassLinker();
+  const DexFile* dex_file = java_lang_dex_file_;
+
+  // Write a synthetic profile sampling every fourth method of a few large classes, the later
+  // methods being hotter.
+  static const char* const kClasses[] = {
+      "Ljava/lang/String;", "Ljava/lang/Integer;", "Ljava/util/ArrayList;", "Ljava/util/HashMap;"
+  };
+  std::set<std::string> hot_classes(kClasses, kClasses + arraysize(kClasses));
+  std::vector<std::string> hot_method_names;
+  std::vector<std::pair<size_t, size_t>> hot_methods;  // Class def and class def method indexes.
+  for (size_t i = 0; i < dex_file->NumClassDefs(); i++) {
+    const DexFile::ClassDef& class_def = dex_file->GetClassDef(i);
+    if (hot_classes.count(dex_file->GetClassDescriptor(class_def)) == 0u) {
+      continue;
+    }
+    ClassDataItemIterator it(*dex_file, dex_file->GetClassData(class_def));
+    while (it.HasNextStaticField() || it.HasNextInstanceField()) {
+      it.Next();
+    }
+    for (size_t class_def_method_index = 0u; it.HasNextDirectMethod() || it.HasNextVirtualMethod();
+         ++class_def_method_index, it.Next()) {
+      if (it.GetMethodCodeItem() != nullptr && class_def_method_index % 4u == 0u) {
+        hot_method_names.push_back(PrettyMethod(it.GetMemberIndex(), *dex_file));
+        hot_methods.push_back(std::make_pair(i, class_def_method_index));
+      }
+    }
+  }
+  ASSERT_FALSE(hot_methods.empty());
+  size_t total_samples = 0u;
+  std::string profile;
+  for (size_t i = 0; i != hot_method_names.size(); ++i) {
+    size_t samples = 10u * (i + 1u);
+    total_samples += samples;
+    profile += StringPrintf("%s/%zu/0\n", hot_method_names[i].c_str(), samples);
+  }
+  profile = StringPrintf("%zu/0/0\n", total_samples) + profile;
+  ScratchFile profile_file;
+  ASSERT_TRUE(profile_file.GetFile()->WriteFully(profile.data(), profile.size()));
+
+  InstructionSet insn_set = kIsTargetBuild ? kThumb2 : kX86;
+  InstructionSetFeatures insn_features;
+  std::unique_ptr<CompilerDriver> driver(new CompilerDriver(compiler_options_.get(),
+                                                            verification_results_.get(),
+                                                            method_inliner_map_.get(),
+                                                            Compiler::kQuick, insn_set,
+                                                            insn_features, false, nullptr,
+                                                            nullptr, 2, true, true,
+                                                            timer_.get(), -1,
+                                                            profile_file.GetFilename()));
+  ASSERT_TRUE(driver->ProfilePresent());
+  driver->CompileAll(nullptr, class_linker->GetBootClassPath(), &timings);
+
+  // Non-leaf methods sampled too rarely may have been left to the interpreter.
+  std::vector<std::pair<size_t, size_t>> compiled_hot_methods;
+  for (size_t i = 0; i != hot_methods.size(); ++i) {
+    const DexFile::ClassDef& class_def = dex_file->GetClassDef(hot_methods[i].first);
+    ClassDataItemIterator it(*dex_file, dex_file->GetClassData(class_def));
+    while (it.HasNextStaticField() || it.HasNextInstanceField()) {
+      it.Next();
+    }
+    for (size_t j = 0; j != hot_methods[i].second; ++j) {
+      it.Next();
+    }
+    if (driver->GetCompiledMethod(MethodReference(dex_file, it.GetMemberIndex())) != nullptr) {
+      compiled_hot_methods.push_back(hot_methods[i]);
+    }
+  }
+  ASSERT_LT(1u, compiled_hot_methods.size());
+
+  ScopedObjectAccess soa(Thread::Current());
+  size_t touched_pages[2];
+  size_t hot_code_size = 0u;
+  for (size_t layout = 0; layout != 2u; ++layout) {
+    compiler_options_->SetProfileCodeLayout(layout != 0u);
+    ScratchFile tmp;
+    SafeMap<std::string, std::string> key_value_store;
+    key_value_store.Put(OatHeader::kImageLocationKey, "lue.art");
+    OatWriter oat_writer(class_linker->GetBootClassPath(), 42U, 4096U, 0, driver.get(), &timings,
+                         &key_value_store);
+    ASSERT_TRUE(driver->WriteElf(GetTestAndroidRoot(), !kIsTargetBuild,
+                                 class_linker->GetBootClassPath(), &oat_writer, tmp.GetFile()));
+
+    std::string error_msg;
+    std::unique_ptr<OatFile> oat_file(OatFile::Open(tmp.GetFilename(), tmp.GetFilename(), nullptr,
+                                                    nullptr, false, &error_msg));
+    ASSERT_TRUE(oat_file.get() != nullptr) << error_msg;
+    uint32_t dex_file_checksum = dex_file->GetLocationChecksum();
+    const OatFile::OatDexFile* oat_dex_file =
+        oat_file->GetOatDexFile(dex_file->GetLocation().c_str(), &dex_file_checksum);
+    ASSERT_TRUE(oat_dex_file != nullptr);
+    touched_pages[layout] = CountTouchedPages(oat_dex_file, compiled_hot_methods);
+
+    if (layout != 0u) {
+      // The hot code is contiguous, hottest first. Deduplicated code stays with its first use.
+      uint32_t last_code_offset = 0u;
+      std::set<uint32_t> code_offsets;
+      for (auto it = compiled_hot_methods.rbegin(); it != compiled_hot_methods.rend(); ++it) {
+        const OatFile::OatMethod oat_method =
+            oat_dex_file->GetOatClass(it->first).GetOatMethod(it->second);
+        if (!code_offsets.insert(oat_method.GetCodeOffset()).second) {
+          continue;
+        }
+        EXPECT_LT(last_code_offset, oat_method.GetCodeOffset());
+        last_code_offset = oat_method.GetCodeOffset();
+        hot_code_size += sizeof(OatQuickMethodHeader) + oat_method.GetQuickCodeSize() +
+            GetInstructionSetAlignment(insn_set);
+      }
+    }
+  }
+  LOG(INFO) << "Pages touched by " << compiled_hot_methods.size() << " hot methods: "
+      << touched_pages[0] << " in definition order, " << touched_pages[1] << " by profile";
+  EXPECT_LT(touched_pages[1], touched_pages[0]);
+  EXPECT_LE(touched_pages[1], RoundUp(hot_code_size, kPageSize) / kPageSize + 1u);
+}
+
+TEST_F(OatTest, ParallelWriteMatchesSerial) {
+  TEST_DISABLED_FOR_PORTABLE();
+  TimingLogger timings("OatTest::ParallelWriteMatchesSerial", false, false);
+  ClassLinker* class_linker = Runtime::Current()->GetClassLinker();
+  InstructionSet insn_set = kIsTargetBuild ? kThumb2 : kX86;
+  InstructionSetFeatures insn_features;
+
+  // The OatWriter uses as many threads as the compiler driver.
+  static const size_t kThreadCounts[] = { 1u, 4u };
+  std::string contents[arraysize(kThreadCounts)];
+  for (size_t i = 0; i != arraysize(kThreadCounts); ++i) {
+    std::unique_ptr<CompilerDriver> driver(new CompilerDriver(compiler_options_.get(),
+                                                              verification_results_.get(),
+                                                              method_inliner_map_.get(),
+                                                              Compiler::kQuick, insn_set,
+                                                              insn_features, false, nullptr,
+                                                              nullptr, kThreadCounts[i], true,
+                                                              true, timer_.get()));
+    driver->CompileAll(nullptr, class_linker->GetBootClassPath(), &timings);
+
+    ScopedObjectAccess soa(Thread::Current());
+    ScratchFile tmp;
+    SafeMap<std::string, std::string> key_value_store;
+    key_value_store.Put(OatHeader::kImageLocationKey, "lue.art");
+    OatWriter oat_writer(class_linker->GetBootClassPath(), 42U, 4096U, 0, driver.get(), &timings,
+                         &key_value_store);
+    ASSERT_TRUE(driver->WriteElf(GetTestAndroidRoot(), !kIsTargetBuild,
+                                 class_linker->GetBootClassPath(), &oat_writer, tmp.GetFile()));
+    ASSERT_TRUE(ReadFileToString(tmp.GetFilename(), &contents[i]));
+    ASSERT_FALSE(contents[i].empty());
+  }
+  EXPECT_TRUE(contents[0] == contents[1]);
+}
+
 TEST_F(OatTest, OatHeaderSizeCheck) {
   // If this test is failing and you have to update these constants,
   // it is time to update OatHeader::kOatVersion
@@ -16,6 +16,7 @@
 
 #include "oat_writer.h"
 
+#include <algorithm>
 #include <zlib.h>
 
 #include "base/allocator.h"
@@ -35,11 +36,15 @@
 #include "output_stream.h"
 #include "safe_map.h"
 #include "scoped_thread_state_change.h"
+#include "thread_pool.h"
 #include "handle_scope-inl.h"
 #include "verifier/method_verifier.h"
 
 namespace art {
 
+// Number of classes whose OatClasses are created by a single task, see InitOatClasses().
+static constexpr size_t kClassesPerTask = 256u;
+
 #define DCHECK_OFFSET() \
   DCHECK_EQ(static_cast<off_t>(file_offset + relative_offset), out->Seek(0, kSeekCurrent)) \
     << "file_offset=" << file_offset << " relative_offset=" << relative_offset
@@ -253,7 +258,33 @@ class OatWriter::OatDexMethodVisitor : public DexMethodVisitor {
   OatDexMethodVisitor(OatWriter* writer, size_t offset)
     : DexMethodVisitor(writer, offset),
       oat_class_index_(0u),
-      method_offsets_index_(0u) {
+      method_offsets_index_(0u),
+      code_section_(kCodeSectionCold) {
+  }
+
+  // Selects the methods visited by the following VisitDexMethods(), see SkipMethod().
+  void SetCodeSection(CodeSection code_section) {
+    code_section_ = code_section;
+    oat_class_index_ = 0u;
+  }
+
+  // Visits a single method of kCodeSectionHot out of the definition order.
+  bool VisitHotMethod(const HotMethod& hot_method) {
+    DCHECK_EQ(code_section_, kCodeSectionHot);
+    DexMethodVisitor::StartClass(hot_method.dex_file, hot_method.class_def_index);
+    oat_class_index_ = hot_method.oat_class_index;
+    method_offsets_index_ = hot_method.method_offsets_index;
+    const DexFile::ClassDef& class_def = dex_file_->GetClassDef(class_def_index_);
+    ClassDataItemIterator it(*dex_file_, dex_file_->GetClassData(class_def));
+    while (it.HasNextStaticField() || it.HasNextInstanceField()) {
+      it.Next();
+    }
+    for (size_t i = 0; i != hot_method.class_def_method_index; ++i) {
+      it.Next();
+    }
+    bool success = VisitMethod(hot_method.class_def_method_index, it);
+    DexMethodVisitor::EndClass();
+    return success;
   }
 
   bool StartClass(const DexFile* dex_file, size_t class_def_index) {
@@ -269,23 +300,50 @@ class OatWriter::OatDexMethodVisitor : public DexMethodVisitor {
   }
 
  protected:
+  // Returns true if the method's code is in a different section than the one being visited.
+  // The method's OatMethodOffsets are skipped as well.
+  bool SkipMethod(OatClass* oat_class, size_t class_def_method_index) {
+    if (code_section_ == kCodeSectionHot ||
+        oat_class->GetCodeSection(class_def_method_index) == code_section_) {
+      return false;
+    }
+    if (oat_class->GetCompiledMethod(class_def_method_index) != nullptr) {
+      ++method_offsets_index_;
+    }
+    return true;
+  }
+
   size_t oat_class_index_;
   size_t method_offsets_index_;
+  CodeSection code_section_;
 };
 
+// Creates the OatClasses of consecutive classes, starting at oat_classes_[oat_class_index]. The
+// offsets of the OatClasses are relative to the first one, see InitOatClasses().
 class OatWriter::InitOatClassesMethodVisitor : public DexMethodVisitor {
  public:
-  InitOatClassesMethodVisitor(OatWriter* writer, size_t offset)
-    : DexMethodVisitor(writer, offset),
+  InitOatClassesMethodVisitor(OatWriter* writer, size_t oat_class_index)
+    : DexMethodVisitor(writer, 0u),
+      oat_class_index_(oat_class_index),
+      hot_methods_(),
       compiled_methods_(),
-      num_non_null_compiled_methods_(0u) {
+      num_non_null_compiled_methods_(0u),
+      profile_code_layout_(writer->compiler_driver_->GetCompilerOptions().GetProfileCodeLayout() &&
+                           writer->compiler_driver_->ProfilePresent()),
+      code_sections_(),
+      num_non_cold_methods_(0u) {
     compiled_methods_.reserve(256u);
+    if (profile_code_layout_) {
+      code_sections_.reserve(256u);
+    }
   }
 
   bool StartClass(const DexFile* dex_file, size_t class_def_index) {
     DexMethodVisitor::StartClass(dex_file, class_def_index);
     compiled_methods_.clear();
     num_non_null_compiled_methods_ = 0u;
+    code_sections_.clear();
+    num_non_cold_methods_ = 0u;
     return true;
   }
 
@@ -298,6 +356,27 @@ class OatWriter::InitOatClassesMethodVisitor : public DexMethodVisitor {
     CompiledMethod* compiled_method =
         writer_->compiler_driver_->GetCompiledMethod(MethodReference(dex_file_, method_idx));
     compiled_methods_.push_back(compiled_method);
+    if (profile_code_layout_) {
+      CodeSection code_section = kCodeSectionCold;
+      if (compiled_method != nullptr) {
+        MethodReference method_ref(dex_file_, method_idx);
+        uint32_t sample_count = writer_->compiler_driver_->GetProfileSampleCount(method_ref);
+        if (sample_count != 0u) {
+          code_section = kCodeSectionHot;
+          HotMethod hot_method = {
+              dex_file_, class_def_index_, class_def_method_index, oat_class_index_,
+              num_non_null_compiled_methods_, sample_count
+          };
+          hot_methods_.push_back(hot_method);
+        } else if (it.MemberIsNative()) {
+          code_section = kCodeSectionStubs;
+        }
+      }
+      code_sections_.push_back(code_section);
+      if (code_section != kCodeSectionCold) {
+        ++num_non_cold_methods_;
+      }
+    }
     if (compiled_method != nullptr) {
         ++num_non_null_compiled_methods_;
     }
@@ -318,14 +397,82 @@ class OatWriter::InitOatClassesMethodVisitor : public DexMethodVisitor {
 
     OatClass* oat_class = new OatClass(offset_, compiled_methods_,
                                        num_non_null_compiled_methods_, status);
-    writer_->oat_classes_.push_back(oat_class);
+    if (num_non_cold_methods_ != 0u) {
+      oat_class->code_sections_ = code_sections_;
+    }
+    DCHECK(writer_->oat_classes_[oat_class_index_] == nullptr);
+    writer_->oat_classes_[oat_class_index_] = oat_class;
+    ++oat_class_index_;
     offset_ += oat_class->SizeOf();
     return DexMethodVisitor::EndClass();
   }
 
+  // The hot methods of the visited classes in definition order.
+  const std::vector<HotMethod>& GetHotMethods() const {
+    return hot_methods_;
+  }
+
  private:
+  size_t oat_class_index_;
+  std::vector<HotMethod> hot_methods_;
   std::vector<CompiledMethod*> compiled_methods_;
   size_t num_non_null_compiled_methods_;
+  const bool profile_code_layout_;
+  std::vector<CodeSection> code_sections_;
+  size_t num_non_cold_methods_;
+};
+
+// Creates the OatClasses of the classes [class_def_begin, class_def_end) of a dex file.
+class OatWriter::InitOatClassesTask FINAL : public Task {
+ public:
+  InitOatClassesTask(OatWriter* writer, const DexFile* dex_file, size_t class_def_begin,
+                     size_t class_def_end, size_t oat_class_index)
+    : writer_(writer),
+      dex_file_(dex_file),
+      class_def_begin_(class_def_begin),
+      class_def_end_(class_def_end),
+      oat_class_index_(oat_class_index),
+      visitor_(writer, oat_class_index) {
+  }
+
+  void Run(Thread* self) OVERRIDE {
+    for (size_t class_def_index = class_def_begin_; class_def_index != class_def_end_;
+         ++class_def_index) {
+      bool success = writer_->VisitDexClass(&visitor_, dex_file_, class_def_index);
+      CHECK(success);
+    }
+  }
+
+  void Finalize() OVERRIDE {
+    // Owned by InitOatClasses().
+  }
+
+  size_t GetOatClassBegin() const {
+    return oat_class_index_;
+  }
+
+  size_t GetOatClassEnd() const {
+    return oat_class_index_ + (class_def_end_ - class_def_begin_);
+  }
+
+  // The size of the OatClasses created by Run().
+  size_t GetSize() const {
+    return visitor_.GetOffset();
+  }
+
+  const std::vector<HotMethod>& GetHotMethods() const {
+    return visitor_.GetHotMethods();
+  }
+
+ private:
+  OatWriter* const writer_;
+  const DexFile* const dex_file_;
+  const size_t class_def_begin_;
+  const size_t class_def_end_;
+  const size_t oat_class_index_;
+  InitOatClassesMethodVisitor visitor_;
+
+  DISALLOW_COPY_AND_ASSIGN(InitOatClassesTask);
 };
 
 class OatWriter::InitCodeMethodVisitor : public OatDexMethodVisitor {
@@ -337,6 +484,9 @@ class OatWriter::InitCodeMethodVisitor : public OatDexMethodVisitor {
   bool VisitMethod(size_t class_def_method_index, const ClassDataItemIterator& it)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
     OatClass* oat_class = writer_->oat_classes_[oat_class_index_];
+    if (SkipMethod(oat_class, class_def_method_index)) {
+      return true;
+    }
     CompiledMethod* compiled_method = oat_class->GetCompiledMethod(class_def_method_index);
 
     if (compiled_method != nullptr) {
@@ -554,6 +704,9 @@ class OatWriter::WriteCodeMethodVisitor : public OatDexMethodVisitor {
 
   bool VisitMethod(size_t class_def_method_index, const ClassDataItemIterator& it) {
     OatClass* oat_class = writer_->oat_classes_[oat_class_index_];
+    if (SkipMethod(oat_class, class_def_method_index)) {
+      return true;
+    }
     const CompiledMethod* compiled_method = oat_class->GetCompiledMethod(class_def_method_index);
 
     if (compiled_method != NULL) {  // ie. not an abstract method
@@ -679,41 +832,64 @@ bool OatWriter::VisitDexMethods(DexMethodVisitor* visitor) {
   for (const DexFile* dex_file : *dex_files_) {
     const size_t class_def_count = dex_file->NumClassDefs();
     for (size_t class_def_index = 0; class_def_index != class_def_count; ++class_def_index) {
-      if (UNLIKELY(!visitor->StartClass(dex_file, class_def_index))) {
+      if (UNLIKELY(!VisitDexClass(visitor, dex_file, class_def_index))) {
         return false;
       }
-      const DexFile::ClassDef& class_def = dex_file->GetClassDef(class_def_index);
-      const byte* class_data = dex_file->GetClassData(class_def);
-      if (class_data != NULL) {  // ie not an empty class, such as a marker interface
-        ClassDataItemIterator it(*dex_file, class_data);
-        while (it.HasNextStaticField()) {
-          it.Next();
-        }
-        while (it.HasNextInstanceField()) {
-          it.Next();
-        }
-        size_t class_def_method_index = 0u;
-        while (it.HasNextDirectMethod()) {
-          if (!visitor->VisitMethod(class_def_method_index, it)) {
-            return false;
-          }
-          ++class_def_method_index;
-          it.Next();
-        }
-        while (it.HasNextVirtualMethod()) {
-          if (UNLIKELY(!visitor->VisitMethod(class_def_method_index, it))) {
-            return false;
-          }
-          ++class_def_method_index;
-          it.Next();
-        }
+    }
+  }
+  return true;
+}
+
+bool OatWriter::VisitDexClass(DexMethodVisitor* visitor, const DexFile* dex_file,
+                              size_t class_def_index) {
+  if (UNLIKELY(!visitor->StartClass(dex_file, class_def_index))) {
+    return false;
+  }
+  const DexFile::ClassDef& class_def = dex_file->GetClassDef(class_def_index);
+  const byte* class_data = dex_file->GetClassData(class_def);
+  if (class_data != NULL) {  // ie not an empty class, such as a marker interface
+    ClassDataItemIterator it(*dex_file, class_data);
+    while (it.HasNextStaticField()) {
+      it.Next();
+    }
+    while (it.HasNextInstanceField()) {
+      it.Next();
+    }
+    size_t class_def_method_index = 0u;
+    while (it.HasNextDirectMethod()) {
+      if (!visitor->VisitMethod(class_def_method_index, it)) {
+        return false;
       }
-      if (UNLIKELY(!visitor->EndClass())) {
+      ++class_def_method_index;
+      it.Next();
+    }
+    while (it.HasNextVirtualMethod()) {
+      if (UNLIKELY(!visitor->VisitMethod(class_def_method_index, it))) {
         return false;
       }
+      ++class_def_method_index;
+      it.Next();
     }
   }
-  return true;
+  return visitor->EndClass();
+}
+
+bool OatWriter::VisitDexMethodsInCodeOrder(OatDexMethodVisitor* visitor) {
+  if (hot_methods_.empty()) {
+    return VisitDexMethods(visitor);
+  }
+  visitor->SetCodeSection(kCodeSectionHot);
+  for (const HotMethod& hot_method : hot_methods_) {
+    if (UNLIKELY(!visitor->VisitHotMethod(hot_method))) {
+      return false;
+    }
+  }
+  visitor->SetCodeSection(kCodeSectionCold);
+  if (UNLIKELY(!VisitDexMethods(visitor))) {
+    return false;
+  }
+  visitor->SetCodeSection(kCodeSectionStubs);
+  return VisitDexMethods(visitor);
 }
 
 size_t OatWriter::InitOatHeader() {
@@ -757,11 +933,48 @@ size_t OatWriter::InitDexFiles(size_t offset) {
 }
 
 size_t OatWriter::InitOatClasses(size_t offset) {
-  // calculate the offsets within OatDexFiles to OatClasses
-  InitOatClassesMethodVisitor visitor(this, offset);
-  bool success = VisitDexMethods(&visitor);
-  CHECK(success);
-  offset = visitor.GetOffset();
+  // Create the OatClasses in chunks of consecutive classes, on the compiler driver's threads.
+  // Each chunk computes offsets relative to its own start, a prefix sum over the chunk sizes
+  // then gives the same offsets as creating all the OatClasses in definition order.
+  std::vector<std::unique_ptr<InitOatClassesTask>> tasks;
+  size_t num_classes = 0u;
+  for (const DexFile* dex_file : *dex_files_) {
+    const size_t class_def_count = dex_file->NumClassDefs();
+    for (size_t begin = 0u; begin < class_def_count; begin += kClassesPerTask) {
+      size_t end = std::min(begin + kClassesPerTask, class_def_count);
+      tasks.emplace_back(new InitOatClassesTask(this, dex_file, begin, end, num_classes));
+      num_classes += end - begin;
+    }
+  }
+  DCHECK(oat_classes_.empty());
+  oat_classes_.resize(num_classes, nullptr);
+
+  Thread* self = Thread::Current();
+  size_t thread_count = compiler_driver_->GetThreadCount();
+  if (thread_count > 1u && tasks.size() > 1u) {
+    // Creating the pool waits for the workers to attach, which must not be done while runnable.
+    // The tasks do not need the mutator lock, release it until the workers are gone.
+    ScopedThreadStateChange tsc(self, kNative);
+    ThreadPool thread_pool("Oat writer thread pool", thread_count - 1u);
+    for (const std::unique_ptr<InitOatClassesTask>& task : tasks) {
+      thread_pool.AddTask(self, task.get());
+    }
+    thread_pool.StartWorkers(self);
+    thread_pool.Wait(self, true, false);
+  } else {
+    for (const std::unique_ptr<InitOatClassesTask>& task : tasks) {
+      task->Run(self);
+    }
+  }
+
+  for (const std::unique_ptr<InitOatClassesTask>& task : tasks) {
+    for (size_t i = task->GetOatClassBegin(), end = task->GetOatClassEnd(); i != end; ++i) {
+      oat_classes_[i]->offset_ += offset;
+    }
+    offset += task->GetSize();
+    const std::vector<HotMethod>& hot_methods = task->GetHotMethods();
+    hot_methods_.insert(hot_methods_.end(), hot_methods.begin(), hot_methods.end());
+  }
 
   // Update oat_dex_files_.
   auto oat_class_it = oat_classes_.begin();
@@ -775,6 +988,19 @@ size_t OatWriter::InitOatClasses(size_t offset) {
   }
   CHECK(oat_class_it == oat_classes_.end());
 
+  if (hot_methods_.empty()) {
+    // Without profiled methods, keep all the code in definition order.
+    for (OatClass* oat_class : oat_classes_) {
+      oat_class->code_sections_.clear();
+    }
+  } else {
+    // Hottest first. Methods with equal counts stay in definition order.
+    std::stable_sort(hot_methods_.begin(), hot_methods_.end(),
+                     [](const HotMethod& lhs, const HotMethod& rhs) {
+                       return lhs.sample_count > rhs.sample_count;
+                     });
+  }
+
   return offset;
 }
 
@@ -852,7 +1078,12 @@ size_t OatWriter::InitOatCodeDexFiles(size_t offset) {
       offset = visitor.GetOffset();                   \
     } while (false)
 
-  VISIT(InitCodeMethodVisitor);
+  {
+    InitCodeMethodVisitor visitor(this, offset);
+    bool success = VisitDexMethodsInCodeOrder(&visitor);
+    DCHECK(success);
+    offset = visitor.GetOffset();
+  }
   if (compiler_driver_->IsImage()) {
     VISIT(InitImageMethodVisitor);
   }
@@ -1057,7 +1288,7 @@ size_t OatWriter::WriteCodeDexFiles(OutputStream* out,
   #define VISIT(VisitorType)                                              \
     do {                                                                  \
       VisitorType visitor(this, out, file_offset, relative_offset);       \
-      if (UNLIKELY(!VisitDexMethods(&visitor))) {                         \
+      if (UNLIKELY(!VisitDexMethodsInCodeOrder(&visitor))) {              \
         return 0;                                                         \
       }                                                                   \
       relative_offset = visitor.GetOffset();                              \
@@ -75,6 +75,11 @@ class OutputStream;
 // OatMethodHeader
 // MethodCode
 //
+// With CompilerOptions::GetProfileCodeLayout(), the (OatMethodHeader, MethodCode) pairs of the
+// methods sampled in the profile come first, ordered by decreasing sample count. They are
+// followed by the remaining methods and then by the JNI stubs of native methods, both in
+// definition order. Otherwise all the code is in definition order.
+//
 class OatWriter {
  public:
   OatWriter(const std::vector<const DexFile*>& dex_files,
@@ -133,6 +138,7 @@ class OatWriter {
   class DexMethodVisitor;
   class OatDexMethodVisitor;
   class InitOatClassesMethodVisitor;
+  class InitOatClassesTask;
   class InitCodeMethodVisitor;
   template <typename DataAccess>
   class InitMapMethodVisitor;
@@ -145,6 +151,29 @@ class OatWriter {
   // with a given DexMethodVisitor.
   bool VisitDexMethods(DexMethodVisitor* visitor);
 
+  // Visit the methods of a single class with a given DexMethodVisitor.
+  bool VisitDexClass(DexMethodVisitor* visitor, const DexFile* dex_file, size_t class_def_index);
+
+  // Visit all the methods with code in the order of their code, see CodeSection.
+  bool VisitDexMethodsInCodeOrder(OatDexMethodVisitor* visitor);
+
+  // The parts of the code, in the order they are laid out.
+  enum CodeSection : uint8_t {
+    kCodeSectionHot,    // Methods sampled in the profile, in hot_methods_ order.
+    kCodeSectionCold,   // Other methods, in definition order.
+    kCodeSectionStubs,  // JNI stubs of native methods not sampled in the profile.
+  };
+
+  // A method whose code is in kCodeSectionHot.
+  struct HotMethod {
+    const DexFile* dex_file;
+    size_t class_def_index;
+    size_t class_def_method_index;
+    size_t oat_class_index;
+    size_t method_offsets_index;
+    uint32_t sample_count;
+  };
+
   size_t InitOatHeader();
   size_t InitOatDexFiles(size_t offset);
   size_t InitDexFiles(size_t offset);
@@ -200,6 +229,14 @@ class OatWriter {
       return compiled_methods_[class_def_method_index];
     }
 
+    CodeSection GetCodeSection(size_t class_def_method_index) const {
+      if (code_sections_.empty()) {
+        return kCodeSectionCold;
+      }
+      DCHECK_LT(class_def_method_index, code_sections_.size());
+      return code_sections_[class_def_method_index];
+    }
+
     // Offset of start of OatClass from beginning of OatHeader. It is
     // used to validate file position when writing. For Portable, it
     // is also used to calculate the position of the OatMethodOffsets
@@ -210,6 +247,10 @@ class OatWriter {
     // CompiledMethods for each class_def_method_index, or NULL if no method is available.
     std::vector<CompiledMethod*> compiled_methods_;
 
+    // CodeSection for each class_def_method_index. Empty if all methods are in
+    // kCodeSectionCold, i.e. when the code is laid out in definition order.
+    std::vector<CodeSection> code_sections_;
+
     // Offset from OatClass::offset_ to the OatMethodOffsets for the
     // class_def_method_index. If 0, it means the corresponding
     // CompiledMethod entry in OatClass::compiled_methods_ should be
@@ -265,6 +306,8 @@ class OatWriter {
   OatHeader* oat_header_;
   std::vector<OatDexFile*> oat_dex_files_;
   std::vector<OatClass*> oat_classes_;
+  // Methods laid out first, hottest first. Empty unless laying out code by profile.
+  std::vector<HotMethod> hot_methods_;
   std::unique_ptr<const std::vector<uint8_t>> interpreter_to_interpreter_bridge_;
   std::unique_ptr<const std::vector<uint8_t>> interpreter_to_compiled_code_bridge_;
   std::unique_ptr<const std::vector<uint8_t>> jni_dlsym_lookup_;
@@ -25,6 +25,8 @@
 #include "driver/compiler_driver-inl.h"
 #include "mirror/art_field.h"
 #include "mirror/art_field-inl.h"
+#include "mirror/art_method-inl.h"
+#include "mirror/class-inl.h"
 #include "mirror/class_loader.h"
 #include "mirror/dex_cache.h"
 #include "nodes.h"
@@ -65,20 +67,74 @@ class Temporaries : public ValueObject {
   size_t index_;
 };
 
+// Methods with more code units are not inlined.
+static constexpr size_t kMaxInlineCodeUnits = 32;
+// Invokes in methods inlined that deep are not inlined.
+static constexpr size_t kMaxInlineDepth = 5;
+// The total size of the methods inlined into the method being compiled.
+static constexpr size_t kMaxInlinedCodeUnits = 256;
+// The locals of inlined methods are part of the frame of the method being compiled.
+static constexpr size_t kMaxInlinedVRegs = 64;
+
+// Returns whether the method of `code_item` only returns, like the constructor of
+// java.lang.Object.
+static bool IsEmptyMethod(const DexFile::CodeItem& code_item) {
+  return code_item.insns_size_in_code_units_ == 1
+      && Instruction::At(code_item.insns_)->Opcode() == Instruction::RETURN_VOID;
+}
+
 static bool IsTypeSupported(Primitive::Type type) {
   return type != Primitive::kPrimFloat && type != Primitive::kPrimDouble;
 }
 
+// The type to use when loading a local holding a value of type `type`.
+static Primitive::Type GetLocalType(Primitive::Type type) {
+  switch (type) {
+    case Primitive::kPrimLong:
+    case Primitive::kPrimNot:
+      return type;
+    default:
+      return Primitive::kPrimInt;
+  }
+}
+
 void HGraphBuilder::InitializeLocals(uint16_t count) {
-  graph_->SetNumberOfVRegs(count);
+  uint16_t first_local = 0;
+  if (IsInlining()) {
+    first_local = AllocateInlinedVRegs(count);
+  } else {
+    graph_->SetNumberOfVRegs(count);
+  }
   locals_.SetSize(count);
   for (int i = 0; i < count; i++) {
-    HLocal* local = new (arena_) HLocal(i);
-    entry_block_->AddInstruction(local);
+    HLocal* local = new (arena_) HLocal(first_local + i);
+    AddToEntryBlock(local);
     locals_.Put(i, local);
   }
 }
 
+uint16_t HGraphBuilder::AllocateInlinedVRegs(size_t count) {
+  uint16_t first_vreg = outermost_->number_of_inlined_vregs_;
+  outermost_->number_of_inlined_vregs_ += count;
+  return first_vreg;
+}
+
+void HGraphBuilder::AddBlock(HBasicBlock* block) {
+  if (IsInlining()) {
+    inlined_blocks_.Add(block);
+  } else {
+    graph_->AddBlock(block);
+  }
+}
+
+void HGraphBuilder::AddToEntryBlock(HInstruction* instruction) {
+  if (IsInlining()) {
+    inlined_entry_instructions_.Add(instruction);
+  } else {
+    entry_block_->AddInstruction(instruction);
+  }
+}
+
 bool HGraphBuilder::InitializeParameters(uint16_t number_of_parameters) {
   // dex_compilation_unit_ is null only when unit testing.
   if (dex_compilation_unit_ == nullptr) {
@@ -174,9 +230,6 @@ HGraph* HGraphBuilder::BuildGraph(const DexFile::CodeItem& code_item) {
     return nullptr;
   }
 
-  const uint16_t* code_ptr = code_item.insns_;
-  const uint16_t* code_end = code_item.insns_ + code_item.insns_size_in_code_units_;
-
   // Setup the graph with the entry block and exit block.
   graph_ = new (arena_) HGraph(arena_);
   entry_block_ = new (arena_) HBasicBlock(graph_);
@@ -190,27 +243,55 @@ HGraph* HGraphBuilder::BuildGraph(const DexFile::CodeItem& code_item) {
 
   // To avoid splitting blocks, we compute ahead of time the instructions that
   // start a new block, and create these blocks.
-  ComputeBranchTargets(code_ptr, code_end);
+  ComputeBranchTargets(code_item.insns_, code_item.insns_ + code_item.insns_size_in_code_units_);
 
   if (!InitializeParameters(code_item.ins_size_)) {
     return nullptr;
   }
 
+  if (!BuildInstructions(code_item)) {
+    return nullptr;
+  }
+
+  if (number_of_inlined_vregs_ != 0) {
+    // The locals of inlined methods take the lowest register numbers, so that the dex
+    // registers of this method keep the stack slots the runtime expects.
+    for (size_t i = 0; i < locals_.Size(); i++) {
+      locals_.Get(i)->SetRegNumber(number_of_inlined_vregs_ + i);
+    }
+    graph_->SetNumberOfVRegs(code_item.registers_size_ + number_of_inlined_vregs_);
+  }
+
+  // Add the exit block at the end to give it the highest id.
+  graph_->AddBlock(exit_block_);
+  exit_block_->AddInstruction(new (arena_) HExit());
+  entry_block_->AddInstruction(new (arena_) HGoto());
+  return graph_;
+}
+
+bool HGraphBuilder::BuildInlinedCode(const DexFile::CodeItem& code_item) {
+  if (!CanHandleCodeItem(code_item)) {
+    return false;
+  }
+  InitializeLocals(code_item.registers_size_);
+  ComputeBranchTargets(code_item.insns_, code_item.insns_ + code_item.insns_size_in_code_units_);
+  // A method without returns always throws, the code following the invoke is dead.
+  return BuildInstructions(code_item) && number_of_returns_ != 0;
+}
+
+bool HGraphBuilder::BuildInstructions(const DexFile::CodeItem& code_item) {
+  const uint16_t* code_ptr = code_item.insns_;
+  const uint16_t* code_end = code_item.insns_ + code_item.insns_size_in_code_units_;
   size_t dex_offset = 0;
   while (code_ptr < code_end) {
     // Update the current block if dex_offset starts a new block.
     MaybeUpdateCurrentBlock(dex_offset);
     const Instruction& instruction = *Instruction::At(code_ptr);
-    if (!AnalyzeDexInstruction(instruction, dex_offset)) return nullptr;
+    if (!AnalyzeDexInstruction(instruction, dex_offset)) return false;
     dex_offset += instruction.SizeInCodeUnits();
     code_ptr += instruction.SizeInCodeUnits();
   }
-
-  // Add the exit block at the end to give it the highest id.
-  graph_->AddBlock(exit_block_);
-  exit_block_->AddInstruction(new (arena_) HExit());
-  entry_block_->AddInstruction(new (arena_) HGoto());
-  return graph_;
+  return true;
 }
 
 void HGraphBuilder::MaybeUpdateCurrentBlock(size_t index) {
@@ -226,7 +307,7 @@ void HGraphBuilder::MaybeUpdateCurrentBlock(size_t index) {
     current_block_->AddInstruction(new (arena_) HGoto());
     current_block_->AddSuccessor(block);
   }
-  graph_->AddBlock(block);
+  AddBlock(block);
   current_block_ = block;
 }
 
@@ -235,9 +316,12 @@ void HGraphBuilder::ComputeBranchTargets(const uint16_t* code_ptr, const uint16_
   branch_targets_.SetSize(code_end - code_ptr);
 
   // Create the first block for the dex instructions, single successor of the entry block.
+  // The first block of an inlined method is entered from the invoke instead.
   HBasicBlock* block = new (arena_) HBasicBlock(graph_);
   branch_targets_.Put(0, block);
-  entry_block_->AddSuccessor(block);
+  if (!IsInlining()) {
+    entry_block_->AddSuccessor(block);
+  }
 
   // Iterate over all instructions and find branching instructions. Create blocks for
   // the locations these instructions branch to.
@@ -308,7 +392,16 @@ void HGraphBuilder::Binop_22b(const Instruction& instruction, bool reverse) {
 }
 
 void HGraphBuilder::BuildReturn(const Instruction& instruction, Primitive::Type type) {
-  if (type == Primitive::kPrimVoid) {
+  if (IsInlining()) {
+    // Pass the returned value to the code following the invoke.
+    if (type != Primitive::kPrimVoid) {
+      DCHECK(result_local_ != nullptr);
+      HInstruction* value = LoadLocal(instruction.VRegA(), type);
+      current_block_->AddInstruction(new (arena_) HStoreLocal(result_local_, value));
+    }
+    current_block_->AddInstruction(new (arena_) HGoto());
+    number_of_returns_++;
+  } else if (type == Primitive::kPrimVoid) {
     current_block_->AddInstruction(new (arena_) HReturnVoid());
   } else {
     HInstruction* value = LoadLocal(instruction.VRegA(), type);
@@ -334,6 +427,27 @@ bool HGraphBuilder::BuildInvoke(const Instruction& instruction,
       && instruction.Opcode() != Instruction::INVOKE_STATIC_RANGE;
   const size_t number_of_arguments = strlen(descriptor) - (is_instance_call ? 0 : 1);
 
+  outermost_->number_of_invokes_++;
+  if (TryInline(instruction, dex_offset, method_idx, number_of_vreg_arguments, is_range, args,
+                register_index)) {
+    outermost_->number_of_inlined_invokes_++;
+    return true;
+  }
+  if (IsInlining()) {
+    // Calls are GC points, and the locals of inlined methods are not in the GC map of the
+    // method being compiled.
+    return false;
+  }
+  if (GetInvokeType(instruction) == kVirtual) {
+    // Virtual calls are only supported when the compiler can bind them to a single method.
+    MethodReference target_method(dex_file_, method_idx);
+    if (!CanInvokeDirectly(dex_offset, kVirtual, &target_method)
+        || target_method.dex_file != dex_file_
+        || target_method.dex_method_index != method_idx) {
+      return false;
+    }
+  }
+
   // Treat invoke-direct like static calls for now.
   HInvoke* invoke = new (arena_) HInvokeStatic(
       arena_, number_of_arguments, return_type, dex_offset, method_idx);
@@ -378,6 +492,220 @@ bool HGraphBuilder::BuildInvoke(const Instruction& instruction,
   return true;
 }
 
+InvokeType HGraphBuilder::GetInvokeType(const Instruction& instruction) {
+  switch (instruction.Opcode()) {
+    case Instruction::INVOKE_STATIC:
+    case Instruction::INVOKE_STATIC_RANGE:
+      return kStatic;
+    case Instruction::INVOKE_DIRECT:
+    case Instruction::INVOKE_DIRECT_RANGE:
+      return kDirect;
+    default:
+      DCHECK(instruction.Opcode() == Instruction::INVOKE_VIRTUAL
+             || instruction.Opcode() == Instruction::INVOKE_VIRTUAL_RANGE);
+      return kVirtual;
+  }
+}
+
+bool HGraphBuilder::CanInvokeDirectly(uint32_t dex_offset,
+                                      InvokeType invoke_type,
+                                      MethodReference* target_method) {
+  // dex_compilation_unit_ is null only when unit testing.
+  if (dex_compilation_unit_ == nullptr) {
+    return invoke_type != kVirtual;
+  }
+  InvokeType sharp_type = invoke_type;
+  int vtable_idx;
+  uintptr_t direct_code;
+  uintptr_t direct_method;
+  bool enable_devirtualization = dex_compilation_unit_->GetVerifiedMethod() != nullptr;
+  return compiler_driver_->ComputeInvokeInfo(dex_compilation_unit_, dex_offset, false,
+                                             enable_devirtualization, &sharp_type, target_method,
+                                             &vtable_idx, &direct_code, &direct_method)
+      && (sharp_type == kStatic || sharp_type == kDirect);
+}
+
+bool HGraphBuilder::TryInline(const Instruction& instruction,
+                              uint32_t dex_offset,
+                              uint32_t method_idx,
+                              uint32_t number_of_vreg_arguments,
+                              bool is_range,
+                              uint32_t* args,
+                              uint32_t register_index) {
+  // dex_compilation_unit_ is null only when unit testing.
+  if (dex_compilation_unit_ == nullptr || inlining_depth_ >= kMaxInlineDepth) {
+    return false;
+  }
+
+  // Only calls the compiler can bind to a single method, in the same dex file, are inlined.
+  // Empty methods of other dex files, like the constructor of java.lang.Object, are also
+  // inlined so that the allocations they initialize can be eliminated.
+  InvokeType invoke_type = GetInvokeType(instruction);
+  MethodReference target_method(dex_file_, method_idx);
+  if (!CanInvokeDirectly(dex_offset, invoke_type, &target_method)
+      || target_method.dex_file != dex_file_) {
+    return false;
+  }
+
+  const DexFile::CodeItem* code_item;
+  uint32_t callee_method_idx;
+  uint32_t callee_access_flags;
+  uint16_t callee_class_def_idx;
+  bool is_empty_method;
+  {
+    ScopedObjectAccess soa(Thread::Current());
+    StackHandleScope<2> hs(soa.Self());
+    Handle<mirror::DexCache> dex_cache(hs.NewHandle(
+        dex_compilation_unit_->GetClassLinker()->FindDexCache(*dex_file_)));
+    Handle<mirror::ClassLoader> class_loader(hs.NewHandle(
+        soa.Decode<mirror::ClassLoader*>(dex_compilation_unit_->GetClassLoader())));
+    mirror::ArtMethod* callee = compiler_driver_->ResolveMethod(
+        soa, dex_cache, class_loader, dex_compilation_unit_, target_method.dex_method_index,
+        invoke_type);
+    if (callee == nullptr
+        || callee->IsNative()
+        || callee->IsAbstract()
+        || callee->IsSynchronized()) {
+      return false;
+    }
+    if (callee->IsStatic()) {
+      // The inlined code does not trigger the initialization of the callee's class.
+      mirror::Class* declaring_class = callee->GetDeclaringClass();
+      if (!declaring_class->IsInitialized()
+          && declaring_class != compiler_driver_->ResolveCompilingMethodsClass(
+              soa, dex_cache, class_loader, outermost_->dex_compilation_unit_)) {
+        return false;
+      }
+    }
+    code_item = callee->GetCodeItem();
+    is_empty_method = code_item != nullptr && IsEmptyMethod(*code_item);
+    if (callee->GetDexFile() != dex_file_ && !is_empty_method) {
+      return false;
+    }
+    callee_method_idx = callee->GetDexMethodIndex();
+    callee_access_flags = callee->GetAccessFlags();
+    callee_class_def_idx = callee->GetDeclaringClass()->GetDexClassDefIndex();
+  }
+
+  bool is_instance_call = invoke_type != kStatic;
+  if (is_empty_method) {
+    // Only the null check of the receiver remains of the call.
+    if (is_instance_call) {
+      HInstruction* receiver = LoadLocal(is_range ? register_index : args[0], Primitive::kPrimNot);
+      current_block_->AddInstruction(new (arena_) HNullCheck(receiver, GetCheckDexPc(dex_offset)));
+    }
+    return true;
+  }
+
+  if (code_item == nullptr
+      || code_item->insns_size_in_code_units_ > kMaxInlineCodeUnits
+      || outermost_->number_of_inlined_code_units_ + code_item->insns_size_in_code_units_
+             > kMaxInlinedCodeUnits
+      || outermost_->number_of_inlined_vregs_ + code_item->registers_size_ + 2 > kMaxInlinedVRegs) {
+    return false;
+  }
+  // Methods that did not pass verification are not inlined.
+  const VerifiedMethod* verified_method =
+      compiler_driver_->GetVerifiedMethod(dex_file_, callee_method_idx);
+  if (verified_method == nullptr) {
+    return false;
+  }
+
+  const char* shorty = dex_file_->GetMethodShorty(dex_file_->GetMethodId(callee_method_idx));
+  DCHECK_EQ(code_item->ins_size_, number_of_vreg_arguments);
+  uint32_t shorty_index = 1;
+  for (size_t i = is_instance_call ? 1 : 0; i < number_of_vreg_arguments; i++) {
+    Primitive::Type type = Primitive::GetType(shorty[shorty_index++]);
+    if (!IsTypeSupported(type)) {
+      return false;
+    }
+    if (type == Primitive::kPrimLong) {
+      if (!is_range && args[i] + 1 != args[i + 1]) {
+        return false;
+      }
+      i++;
+    }
+  }
+  Primitive::Type return_type = Primitive::GetType(shorty[0]);
+  if (!IsTypeSupported(return_type)) {
+    return false;
+  }
+
+  // Build the callee, undoing the allocations of inlined registers if it cannot be built.
+  size_t number_of_inlined_vregs = outermost_->number_of_inlined_vregs_;
+  size_t number_of_inlined_code_units = outermost_->number_of_inlined_code_units_;
+  size_t number_of_invokes = outermost_->number_of_invokes_;
+  size_t number_of_inlined_invokes = outermost_->number_of_inlined_invokes_;
+  HLocal* result_local = nullptr;
+  if (return_type != Primitive::kPrimVoid) {
+    result_local = new (arena_) HLocal(
+        AllocateInlinedVRegs(return_type == Primitive::kPrimLong ? 2 : 1));
+  }
+  HBasicBlock* return_block = new (arena_) HBasicBlock(graph_);
+  DexCompilationUnit callee_unit(
+      nullptr, dex_compilation_unit_->GetClassLoader(), dex_compilation_unit_->GetClassLinker(),
+      *dex_file_, code_item, callee_class_def_idx, callee_method_idx, callee_access_flags,
+      verified_method);
+  HGraphBuilder callee_builder(this, &callee_unit, return_block, result_local,
+                               GetCheckDexPc(dex_offset));
+  if (!callee_builder.BuildInlinedCode(*code_item)) {
+    outermost_->number_of_inlined_vregs_ = number_of_inlined_vregs;
+    outermost_->number_of_inlined_code_units_ = number_of_inlined_code_units;
+    outermost_->number_of_invokes_ = number_of_invokes;
+    outermost_->number_of_inlined_invokes_ = number_of_inlined_invokes;
+    return false;
+  }
+  outermost_->number_of_inlined_code_units_ += code_item->insns_size_in_code_units_;
+
+  if (result_local != nullptr) {
+    AddToEntryBlock(result_local);
+  }
+  for (size_t i = 0; i < callee_builder.inlined_entry_instructions_.Size(); i++) {
+    AddToEntryBlock(callee_builder.inlined_entry_instructions_.Get(i));
+  }
+
+  // Store the arguments into the locals of the callee's parameters.
+  uint16_t parameter_index = code_item->registers_size_ - code_item->ins_size_;
+  size_t start_index = 0;
+  if (is_instance_call) {
+    HInstruction* receiver = LoadLocal(is_range ? register_index : args[0], Primitive::kPrimNot);
+    HNullCheck* null_check = new (arena_) HNullCheck(receiver, GetCheckDexPc(dex_offset));
+    current_block_->AddInstruction(null_check);
+    current_block_->AddInstruction(
+        new (arena_) HStoreLocal(callee_builder.GetLocalAt(parameter_index++), null_check));
+    start_index = 1;
+  }
+  shorty_index = 1;
+  for (size_t i = start_index; i < number_of_vreg_arguments; i++, parameter_index++) {
+    Primitive::Type type = GetLocalType(Primitive::GetType(shorty[shorty_index++]));
+    HInstruction* argument = LoadLocal(is_range ? register_index + i : args[i], type);
+    current_block_->AddInstruction(
+        new (arena_) HStoreLocal(callee_builder.GetLocalAt(parameter_index), argument));
+    if (type == Primitive::kPrimLong) {
+      i++;
+      parameter_index++;
+    }
+  }
+
+  // Jump to the callee's code, and continue after the invoke in the block its returns go to.
+  current_block_->AddInstruction(new (arena_) HGoto());
+  current_block_->AddSuccessor(callee_builder.FindBlockStartingAt(0));
+  for (size_t i = 0; i < callee_builder.inlined_blocks_.Size(); i++) {
+    AddBlock(callee_builder.inlined_blocks_.Get(i));
+  }
+  AddBlock(return_block);
+  current_block_ = return_block;
+  if (result_local != nullptr) {
+    // The returned value, for a following move-result.
+    current_block_->AddInstruction(new (arena_) HLoadLocal(result_local, GetLocalType(return_type)));
+  }
+
+  VLOG(compiler) << "Inlined " << PrettyMethod(callee_method_idx, *dex_file_) << " into "
+                 << PrettyMethod(outermost_->dex_compilation_unit_->GetDexMethodIndex(),
+                                 *dex_file_);
+  return true;
+}
+
 bool HGraphBuilder::BuildFieldAccess(const Instruction& instruction,
                                      uint32_t dex_offset,
                                      bool is_put) {
@@ -403,7 +731,7 @@ bool HGraphBuilder::BuildFieldAccess(const Instruction& instruction,
   }
 
   HInstruction* object = LoadLocal(obj_reg, Primitive::kPrimNot);
-  current_block_->AddInstruction(new (arena_) HNullCheck(object, dex_offset));
+  current_block_->AddInstruction(new (arena_) HNullCheck(object, GetCheckDexPc(dex_offset)));
   if (is_put) {
     Temporaries temps(graph_, 1);
     HInstruction* null_check = current_block_->GetLastInstruction();
@@ -439,7 +767,7 @@ void HGraphBuilder::BuildArrayAccess(const Instruction& instruction,
   Temporaries temps(graph_, 3);
 
   HInstruction* object = LoadLocal(array_reg, Primitive::kPrimNot);
-  object = new (arena_) HNullCheck(object, dex_offset);
+  object = new (arena_) HNullCheck(object, GetCheckDexPc(dex_offset));
   current_block_->AddInstruction(object);
   temps.Add(object);
 
@@ -447,13 +775,14 @@ void HGraphBuilder::BuildArrayAccess(const Instruction& instruction,
   current_block_->AddInstruction(length);
   temps.Add(length);
   HInstruction* index = LoadLocal(index_reg, Primitive::kPrimInt);
-  index = new (arena_) HBoundsCheck(index, length, dex_offset);
+  index = new (arena_) HBoundsCheck(index, length, GetCheckDexPc(dex_offset));
   current_block_->AddInstruction(index);
   temps.Add(index);
   if (is_put) {
     HInstruction* value = LoadLocal(source_or_dest_reg, anticipated_type);
     // TODO: Insert a type check node if the type is Object.
-    current_block_->AddInstruction(new (arena_) HArraySet(object, index, value, dex_offset));
+    current_block_->AddInstruction(
+        new (arena_) HArraySet(object, index, value, GetCheckDexPc(dex_offset)));
   } else {
     current_block_->AddInstruction(new (arena_) HArrayGet(object, index, anticipated_type));
     UpdateLocal(source_or_dest_reg, current_block_->GetLastInstruction());
@@ -602,7 +931,8 @@ bool HGraphBuilder::AnalyzeDexInstruction(const Instruction& instruction, int32_
     }
 
     case Instruction::INVOKE_STATIC:
-    case Instruction::INVOKE_DIRECT: {
+    case Instruction::INVOKE_DIRECT:
+    case Instruction::INVOKE_VIRTUAL: {
       uint32_t method_idx = instruction.VRegB_35c();
       uint32_t number_of_vreg_arguments = instruction.VRegA_35c();
       uint32_t args[5];
@@ -614,7 +944,8 @@ bool HGraphBuilder::AnalyzeDexInstruction(const Instruction& instruction, int32_
     }
 
     case Instruction::INVOKE_STATIC_RANGE:
-    case Instruction::INVOKE_DIRECT_RANGE: {
+    case Instruction::INVOKE_DIRECT_RANGE:
+    case Instruction::INVOKE_VIRTUAL_RANGE: {
       uint32_t method_idx = instruction.VRegB_3rc();
       uint32_t number_of_vreg_arguments = instruction.VRegA_3rc();
       uint32_t register_index = instruction.VRegC();
@@ -686,6 +1017,10 @@ bool HGraphBuilder::AnalyzeDexInstruction(const Instruction& instruction, int32_
     }
 
     case Instruction::NEW_INSTANCE: {
+      if (IsInlining()) {
+        // Allocations are GC points, see BuildInvoke.
+        return false;
+      }
       current_block_->AddInstruction(
           new (arena_) HNewInstance(dex_offset, instruction.VRegB_21c()));
       UpdateLocal(instruction.VRegA(), current_block_->GetLastInstruction());
@@ -761,7 +1096,7 @@ HIntConstant* HGraphBuilder::GetIntConstant0() {
     return constant0_;
   }
   constant0_ = new(arena_) HIntConstant(0);
-  entry_block_->AddInstruction(constant0_);
+  AddToEntryBlock(constant0_);
   return constant0_;
 }
 
@@ -770,7 +1105,7 @@ HIntConstant* HGraphBuilder::GetIntConstant1() {
     return constant1_;
   }
   constant1_ = new(arena_) HIntConstant(1);
-  entry_block_->AddInstruction(constant1_);
+  AddToEntryBlock(constant1_);
   return constant1_;
 }
 
@@ -780,7 +1115,7 @@ HIntConstant* HGraphBuilder::GetIntConstant(int32_t constant) {
     case 1: return GetIntConstant1();
     default: {
       HIntConstant* instruction = new (arena_) HIntConstant(constant);
-      entry_block_->AddInstruction(instruction);
+      AddToEntryBlock(instruction);
       return instruction;
     }
   }
@@ -788,7 +1123,7 @@ HIntConstant* HGraphBuilder::GetIntConstant(int32_t constant) {
 
 HLongConstant* HGraphBuilder::GetLongConstant(int64_t constant) {
   HLongConstant* instruction = new (arena_) HLongConstant(constant);
-  entry_block_->AddInstruction(instruction);
+  AddToEntryBlock(instruction);
   return instruction;
 }
 
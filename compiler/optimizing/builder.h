@@ -46,11 +46,105 @@ class HGraphBuilder : public ValueObject {
         constant1_(nullptr),
         dex_file_(dex_file),
         dex_compilation_unit_(dex_compilation_unit),
-        compiler_driver_(driver) {}
+        compiler_driver_(driver),
+        caller_(nullptr),
+        outermost_(this),
+        inlining_depth_(0),
+        invoke_dex_pc_(0),
+        result_local_(nullptr),
+        number_of_returns_(0),
+        inlined_blocks_(arena, 0),
+        inlined_entry_instructions_(arena, 0),
+        number_of_inlined_vregs_(0),
+        number_of_inlined_code_units_(0),
+        number_of_invokes_(0),
+        number_of_inlined_invokes_(0) {}
 
   HGraph* BuildGraph(const DexFile::CodeItem& code);
 
+  // The invokes of the graph built, including the ones of inlined methods, and how many of
+  // them were inlined.
+  size_t GetNumberOfInvokes() const { return number_of_invokes_; }
+  size_t GetNumberOfInlinedInvokes() const { return number_of_inlined_invokes_; }
+
  private:
+  // Builder for the code of a method inlined at an invoke of `caller`. Returns go to
+  // `return_block` and store the returned value into `result_local`.
+  HGraphBuilder(HGraphBuilder* caller,
+                DexCompilationUnit* dex_compilation_unit,
+                HBasicBlock* return_block,
+                HLocal* result_local,
+                uint32_t invoke_dex_pc)
+      : arena_(caller->arena_),
+        branch_targets_(caller->arena_, 0),
+        locals_(caller->arena_, 0),
+        entry_block_(caller->entry_block_),
+        exit_block_(return_block),
+        current_block_(nullptr),
+        graph_(caller->graph_),
+        constant0_(nullptr),
+        constant1_(nullptr),
+        dex_file_(caller->dex_file_),
+        dex_compilation_unit_(dex_compilation_unit),
+        compiler_driver_(caller->compiler_driver_),
+        caller_(caller),
+        outermost_(caller->outermost_),
+        inlining_depth_(caller->inlining_depth_ + 1),
+        invoke_dex_pc_(invoke_dex_pc),
+        result_local_(result_local),
+        number_of_returns_(0),
+        inlined_blocks_(caller->arena_, 0),
+        inlined_entry_instructions_(caller->arena_, 0),
+        number_of_inlined_vregs_(0),
+        number_of_inlined_code_units_(0),
+        number_of_invokes_(0),
+        number_of_inlined_invokes_(0) {}
+
+  bool IsInlining() const { return caller_ != nullptr; }
+
+  // Builds the code of an inlined method into blocks that are not yet part of the graph.
+  // Returns whether the whole method could be built.
+  bool BuildInlinedCode(const DexFile::CodeItem& code);
+
+  // Builds the HInstructions for the dex instructions of `code`.
+  bool BuildInstructions(const DexFile::CodeItem& code);
+
+  // Adds `block` to the graph. The blocks of an inlined method are only added once the
+  // whole method has been built.
+  void AddBlock(HBasicBlock* block);
+
+  // Adds `instruction` to the entry block of the graph. Locals and constants of an inlined
+  // method are only added once the whole method has been built.
+  void AddToEntryBlock(HInstruction* instruction);
+
+  // Runtime checks in an inlined method report the dex pc of the invoke in the method
+  // being compiled.
+  uint32_t GetCheckDexPc(uint32_t dex_offset) const {
+    return IsInlining() ? invoke_dex_pc_ : dex_offset;
+  }
+
+  // Reserves `count` virtual registers for the locals of inlined methods and returns the
+  // first one.
+  uint16_t AllocateInlinedVRegs(size_t count);
+
+  static InvokeType GetInvokeType(const Instruction& instruction);
+
+  // Returns whether the invoke at `dex_offset` always calls the same method, and updates
+  // `target_method` to that method.
+  bool CanInvokeDirectly(uint32_t dex_offset,
+                         InvokeType invoke_type,
+                         MethodReference* target_method);
+
+  // Replaces the invoke by the code of the callee if it is a small enough static, direct
+  // or final method. Returns whether the invoke was inlined.
+  bool TryInline(const Instruction& instruction,
+                 uint32_t dex_offset,
+                 uint32_t method_idx,
+                 uint32_t number_of_vreg_arguments,
+                 bool is_range,
+                 uint32_t* args,
+                 uint32_t register_index);
+
   // Analyzes the dex instruction and adds HInstruction to the graph
   // to execute that instruction. Returns whether the instruction can
   // be handled.
@@ -128,6 +222,34 @@ class HGraphBuilder : public ValueObject {
   DexCompilationUnit* const dex_compilation_unit_;
   CompilerDriver* const compiler_driver_;
 
+  // The builder of the method invoking the inlined method, null when building the method
+  // being compiled.
+  HGraphBuilder* const caller_;
+
+  // The builder of the method being compiled.
+  HGraphBuilder* const outermost_;
+
+  const size_t inlining_depth_;
+
+  // The dex pc of the invoke being inlined, in the method being compiled.
+  const uint32_t invoke_dex_pc_;
+
+  // The local receiving the value returned by an inlined method, null for void methods.
+  HLocal* const result_local_;
+  size_t number_of_returns_;
+
+  // Blocks and entry block instructions of an inlined method, added to the graph by the
+  // caller once the whole method has been built.
+  GrowableArray<HBasicBlock*> inlined_blocks_;
+  GrowableArray<HInstruction*> inlined_entry_instructions_;
+
+  // The virtual registers and dex code units used by inlined methods, and the invokes
+  // seen and inlined. Only updated in the builder of the method being compiled.
+  size_t number_of_inlined_vregs_;
+  size_t number_of_inlined_code_units_;
+  size_t number_of_invokes_;
+  size_t number_of_inlined_invokes_;
+
   DISALLOW_COPY_AND_ASSIGN(HGraphBuilder);
 };
 
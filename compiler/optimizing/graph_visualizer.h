@@ -26,6 +26,8 @@ class DexCompilationUnit;
 class HGraph;
 
 static const char* kLivenessPassName = "liveness";
+static const char* kGvnPassName = "gvn";
+static const char* kScalarReplacementPassName = "scalar_replacement";
 static const char* kRegisterAllocatorPassName = "register";
 
 /**
@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gvn.h"
+
+namespace art {
+
+void ValueSet::Add(HInstruction* instruction) {
+  DCHECK(Lookup(instruction) == nullptr);
+  size_t hash_code = instruction->ComputeHashCode();
+  size_t index = BucketIndex(hash_code);
+  buckets_[index] = new (allocator_) ValueSetNode(instruction, hash_code, buckets_[index]);
+  ++number_of_entries_;
+}
+
+HInstruction* ValueSet::Lookup(HInstruction* instruction) const {
+  size_t hash_code = instruction->ComputeHashCode();
+  for (ValueSetNode* node = buckets_[BucketIndex(hash_code)];
+       node != nullptr;
+       node = node->GetNext()) {
+    if (node->GetHashCode() == hash_code && node->GetInstruction()->Equals(instruction)) {
+      return node->GetInstruction();
+    }
+  }
+  return nullptr;
+}
+
+bool ValueSet::Contains(HInstruction* instruction) const {
+  size_t hash_code = instruction->ComputeHashCode();
+  for (ValueSetNode* node = buckets_[BucketIndex(hash_code)];
+       node != nullptr;
+       node = node->GetNext()) {
+    if (node->GetInstruction() == instruction) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void ValueSet::Kill(SideEffects side_effects) {
+  if (!side_effects.HasSideEffects()) {
+    return;
+  }
+  for (size_t i = 0; i < kNumberOfBuckets; ++i) {
+    ValueSetNode* previous = nullptr;
+    for (ValueSetNode* node = buckets_[i]; node != nullptr; node = node->GetNext()) {
+      if (node->GetInstruction()->GetSideEffects().MayDependOn(side_effects)) {
+        RemoveNode(i, previous, node);
+      } else {
+        previous = node;
+      }
+    }
+  }
+}
+
+void ValueSet::IntersectWith(const ValueSet& other) {
+  for (size_t i = 0; i < kNumberOfBuckets; ++i) {
+    ValueSetNode* previous = nullptr;
+    for (ValueSetNode* node = buckets_[i]; node != nullptr; node = node->GetNext()) {
+      if (!other.Contains(node->GetInstruction())) {
+        RemoveNode(i, previous, node);
+      } else {
+        previous = node;
+      }
+    }
+  }
+}
+
+void ValueSet::RemoveNode(size_t bucket, ValueSetNode* previous, ValueSetNode* node) {
+  if (previous == nullptr) {
+    buckets_[bucket] = node->GetNext();
+  } else {
+    previous->SetNext(node->GetNext());
+  }
+  --number_of_entries_;
+}
+
+ValueSet* ValueSet::Copy() const {
+  ValueSet* copy = new (allocator_) ValueSet(allocator_);
+  for (size_t i = 0; i < kNumberOfBuckets; ++i) {
+    // Append the copied nodes so that the copy keeps the order of the collision lists.
+    ValueSetNode* last = nullptr;
+    for (ValueSetNode* node = buckets_[i]; node != nullptr; node = node->GetNext()) {
+      ValueSetNode* node_copy =
+          new (allocator_) ValueSetNode(node->GetInstruction(), node->GetHashCode(), nullptr);
+      if (last == nullptr) {
+        copy->buckets_[i] = node_copy;
+      } else {
+        last->SetNext(node_copy);
+      }
+      last = node_copy;
+    }
+  }
+  copy->number_of_entries_ = number_of_entries_;
+  return copy;
+}
+
+void GlobalValueNumberer::Run() {
+  sets_.SetSize(graph_->GetBlocks().Size());
+  for (size_t i = 0, e = graph_->GetBlocks().Size(); i < e; ++i) {
+    sets_.Put(i, nullptr);
+  }
+
+  // Visit blocks in reverse post order, so that the dominator and the forward
+  // predecessors of a block are visited before it.
+  for (HReversePostOrderIterator it(*graph_); !it.Done(); it.Advance()) {
+    VisitBasicBlock(it.Current());
+  }
+}
+
+void GlobalValueNumberer::VisitBasicBlock(HBasicBlock* block) {
+  ValueSet* set = nullptr;
+  const GrowableArray<HBasicBlock*>& predecessors = block->GetPredecessors();
+  if (predecessors.Size() == 0) {
+    // The entry block.
+    set = new (allocator_) ValueSet(allocator_);
+  } else {
+    // The instructions available in `block` are the ones available at the end of its
+    // dominator that are not killed on the way to `block`.
+    HBasicBlock* dominator = block->GetDominator();
+    set = sets_.Get(dominator->GetBlockId())->Copy();
+    if (block->IsLoopHeader()) {
+      // The back edge has not been visited yet, kill what the loop may change.
+      DCHECK_EQ(dominator, block->GetLoopInformation()->GetPreHeader());
+      set->Kill(side_effects_.GetLoopEffects(block));
+    } else if (predecessors.Size() > 1) {
+      for (size_t i = 0, e = predecessors.Size(); i < e && !set->IsEmpty(); ++i) {
+        set->IntersectWith(*sets_.Get(predecessors.Get(i)->GetBlockId()));
+      }
+    }
+  }
+
+  sets_.Put(block->GetBlockId(), set);
+
+  HInstruction* current = block->GetFirstInstruction();
+  while (current != nullptr) {
+    set->Kill(current->GetSideEffects());
+    // Save the next instruction in case `current` is removed from the graph.
+    HInstruction* next = current->GetNext();
+    if (current->CanBeMoved()) {
+      HInstruction* existing = set->Lookup(current);
+      if (existing != nullptr) {
+        current->ReplaceWith(existing);
+        current->GetBlock()->RemoveInstruction(current);
+        ++number_of_replaced_instructions_;
+      } else {
+        set->Add(current);
+      }
+    }
+    current = next;
+  }
+}
+
+}  // namespace art
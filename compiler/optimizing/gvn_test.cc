@@ -0,0 +1,367 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gvn.h"
+#include "nodes.h"
+#include "side_effects_analysis.h"
+#include "utils/arena_allocator.h"
+
+#include "gtest/gtest.h"
+
+namespace art {
+
+static HBasicBlock* CreateBlock(HGraph* graph, ArenaAllocator* allocator) {
+  HBasicBlock* block = new (allocator) HBasicBlock(graph);
+  graph->AddBlock(block);
+  return block;
+}
+
+static HInstruction* AddFieldGet(HBasicBlock* block,
+                                 ArenaAllocator* allocator,
+                                 HInstruction* object,
+                                 size_t offset) {
+  HInstruction* get =
+      new (allocator) HInstanceFieldGet(object, Primitive::kPrimNot, MemberOffset(offset));
+  block->AddInstruction(get);
+  return get;
+}
+
+static void AddFieldSet(HBasicBlock* block,
+                        ArenaAllocator* allocator,
+                        HInstruction* object,
+                        size_t offset) {
+  block->AddInstruction(
+      new (allocator) HInstanceFieldSet(object, object, MemberOffset(offset)));
+}
+
+static void RunGvn(HGraph* graph) {
+  graph->BuildDominatorTree();
+  graph->FindNaturalLoops();
+  SideEffectsAnalysis side_effects(graph);
+  side_effects.Run();
+  GlobalValueNumberer(graph->GetArena(), graph, side_effects).Run();
+}
+
+TEST(GVNTest, LocalFieldElimination) {
+  ArenaPool pool;
+  ArenaAllocator allocator(&pool);
+
+  HGraph* graph = new (&allocator) HGraph(&allocator);
+  HBasicBlock* entry = CreateBlock(graph, &allocator);
+  graph->SetEntryBlock(entry);
+  HInstruction* parameter = new (&allocator) HParameterValue(0, Primitive::kPrimNot);
+  entry->AddInstruction(parameter);
+  entry->AddInstruction(new (&allocator) HGoto());
+
+  HBasicBlock* block = CreateBlock(graph, &allocator);
+  entry->AddSuccessor(block);
+  HInstruction* first_get = AddFieldGet(block, &allocator, parameter, 42);
+  HInstruction* same_get = AddFieldGet(block, &allocator, parameter, 42);
+  HInstruction* other_field_get = AddFieldGet(block, &allocator, parameter, 43);
+  HInstruction* other_object_get = AddFieldGet(block, &allocator, first_get, 42);
+  AddFieldSet(block, &allocator, parameter, 43);
+  HInstruction* get_after_set = AddFieldGet(block, &allocator, parameter, 42);
+  HInstruction* same_get_after_set = AddFieldGet(block, &allocator, parameter, 42);
+  block->AddInstruction(new (&allocator) HReturn(same_get_after_set));
+
+  HBasicBlock* exit = CreateBlock(graph, &allocator);
+  block->AddSuccessor(exit);
+  exit->AddInstruction(new (&allocator) HExit());
+
+  RunGvn(graph);
+
+  ASSERT_EQ(first_get->GetBlock(), block);
+  ASSERT_EQ(same_get->GetBlock(), nullptr);
+  ASSERT_EQ(other_field_get->GetBlock(), block);
+  ASSERT_EQ(other_object_get->GetBlock(), block);
+  // The field set may write to the same object.
+  ASSERT_EQ(get_after_set->GetBlock(), block);
+  ASSERT_EQ(same_get_after_set->GetBlock(), nullptr);
+  ASSERT_EQ(block->GetLastInstruction()->InputAt(0), get_after_set);
+}
+
+TEST(GVNTest, GlobalFieldElimination) {
+  ArenaPool pool;
+  ArenaAllocator allocator(&pool);
+
+  HGraph* graph = new (&allocator) HGraph(&allocator);
+  HBasicBlock* entry = CreateBlock(graph, &allocator);
+  graph->SetEntryBlock(entry);
+  HInstruction* parameter = new (&allocator) HParameterValue(0, Primitive::kPrimNot);
+  entry->AddInstruction(parameter);
+  entry->AddInstruction(new (&allocator) HGoto());
+
+  HBasicBlock* block = CreateBlock(graph, &allocator);
+  entry->AddSuccessor(block);
+  HInstruction* get = AddFieldGet(block, &allocator, parameter, 42);
+  block->AddInstruction(new (&allocator) HIf(get));
+
+  HBasicBlock* then = CreateBlock(graph, &allocator);
+  HBasicBlock* else_ = CreateBlock(graph, &allocator);
+  HBasicBlock* join = CreateBlock(graph, &allocator);
+  block->AddSuccessor(then);
+  block->AddSuccessor(else_);
+  then->AddSuccessor(join);
+  else_->AddSuccessor(join);
+
+  HInstruction* then_get = AddFieldGet(then, &allocator, parameter, 42);
+  then->AddInstruction(new (&allocator) HGoto());
+  HInstruction* else_get = AddFieldGet(else_, &allocator, parameter, 42);
+  else_->AddInstruction(new (&allocator) HGoto());
+  HInstruction* join_get = AddFieldGet(join, &allocator, parameter, 42);
+  join->AddInstruction(new (&allocator) HReturnVoid());
+
+  HBasicBlock* exit = CreateBlock(graph, &allocator);
+  join->AddSuccessor(exit);
+  exit->AddInstruction(new (&allocator) HExit());
+
+  RunGvn(graph);
+
+  ASSERT_EQ(get->GetBlock(), block);
+  ASSERT_EQ(then_get->GetBlock(), nullptr);
+  ASSERT_EQ(else_get->GetBlock(), nullptr);
+  ASSERT_EQ(join_get->GetBlock(), nullptr);
+}
+
+TEST(GVNTest, DiamondWithFieldSet) {
+  ArenaPool pool;
+  ArenaAllocator allocator(&pool);
+
+  HGraph* graph = new (&allocator) HGraph(&allocator);
+  HBasicBlock* entry = CreateBlock(graph, &allocator);
+  graph->SetEntryBlock(entry);
+  HInstruction* parameter = new (&allocator) HParameterValue(0, Primitive::kPrimNot);
+  entry->AddInstruction(parameter);
+  entry->AddInstruction(new (&allocator) HGoto());
+
+  HBasicBlock* block = CreateBlock(graph, &allocator);
+  entry->AddSuccessor(block);
+  HInstruction* get = AddFieldGet(block, &allocator, parameter, 42);
+  block->AddInstruction(new (&allocator) HIf(get));
+
+  HBasicBlock* then = CreateBlock(graph, &allocator);
+  HBasicBlock* else_ = CreateBlock(graph, &allocator);
+  HBasicBlock* join = CreateBlock(graph, &allocator);
+  block->AddSuccessor(then);
+  block->AddSuccessor(else_);
+  then->AddSuccessor(join);
+  else_->AddSuccessor(join);
+
+  AddFieldSet(then, &allocator, parameter, 42);
+  HInstruction* then_get = AddFieldGet(then, &allocator, parameter, 42);
+  then->AddInstruction(new (&allocator) HGoto());
+  HInstruction* else_get = AddFieldGet(else_, &allocator, parameter, 42);
+  else_->AddInstruction(new (&allocator) HGoto());
+  HInstruction* join_get = AddFieldGet(join, &allocator, parameter, 42);
+  join->AddInstruction(new (&allocator) HReturnVoid());
+
+  HBasicBlock* exit = CreateBlock(graph, &allocator);
+  join->AddSuccessor(exit);
+  exit->AddInstruction(new (&allocator) HExit());
+
+  RunGvn(graph);
+
+  ASSERT_EQ(get->GetBlock(), block);
+  ASSERT_EQ(then_get->GetBlock(), then);
+  ASSERT_EQ(else_get->GetBlock(), nullptr);
+  // The value of the field depends on the path taken.
+  ASSERT_EQ(join_get->GetBlock(), join);
+}
+
+TEST(GVNTest, LoopFieldElimination) {
+  ArenaPool pool;
+  ArenaAllocator allocator(&pool);
+
+  HGraph* graph = new (&allocator) HGraph(&allocator);
+  HBasicBlock* entry = CreateBlock(graph, &allocator);
+  graph->SetEntryBlock(entry);
+  HInstruction* parameter = new (&allocator) HParameterValue(0, Primitive::kPrimNot);
+  entry->AddInstruction(parameter);
+  entry->AddInstruction(new (&allocator) HGoto());
+
+  HBasicBlock* block = CreateBlock(graph, &allocator);
+  entry->AddSuccessor(block);
+  HInstruction* get = AddFieldGet(block, &allocator, parameter, 42);
+  HInstruction* other_get = AddFieldGet(block, &allocator, parameter, 43);
+  block->AddInstruction(new (&allocator) HGoto());
+
+  HBasicBlock* loop_header = CreateBlock(graph, &allocator);
+  HBasicBlock* loop_body = CreateBlock(graph, &allocator);
+  HBasicBlock* exit_block = CreateBlock(graph, &allocator);
+  block->AddSuccessor(loop_header);
+  loop_header->AddSuccessor(loop_body);
+  loop_header->AddSuccessor(exit_block);
+  loop_body->AddSuccessor(loop_header);
+
+  HInstruction* header_get = AddFieldGet(loop_header, &allocator, parameter, 42);
+  HInstruction* header_other_get = AddFieldGet(loop_header, &allocator, parameter, 43);
+  loop_header->AddInstruction(new (&allocator) HIf(header_get));
+
+  // The loop only writes to the field at offset 42.
+  HInstruction* body_get = AddFieldGet(loop_body, &allocator, parameter, 42);
+  AddFieldSet(loop_body, &allocator, parameter, 42);
+  HInstruction* body_get_after_set = AddFieldGet(loop_body, &allocator, parameter, 42);
+  loop_body->AddInstruction(new (&allocator) HGoto());
+
+  HInstruction* exit_get = AddFieldGet(exit_block, &allocator, parameter, 42);
+  exit_block->AddInstruction(new (&allocator) HReturnVoid());
+
+  HBasicBlock* exit = CreateBlock(graph, &allocator);
+  exit_block->AddSuccessor(exit);
+  exit->AddInstruction(new (&allocator) HExit());
+
+  RunGvn(graph);
+
+  ASSERT_EQ(get->GetBlock(), block);
+  ASSERT_EQ(other_get->GetBlock(), block);
+  // Side effects are tracked per kind of memory, not per field: the field set in the
+  // loop kills all the field values computed before the loop.
+  ASSERT_EQ(header_get->GetBlock(), loop_header);
+  ASSERT_EQ(header_other_get->GetBlock(), loop_header);
+  ASSERT_EQ(body_get->GetBlock(), nullptr);
+  ASSERT_EQ(body_get_after_set->GetBlock(), loop_body);
+  ASSERT_EQ(exit_get->GetBlock(), nullptr);
+}
+
+TEST(GVNTest, LoopWithoutSideEffects) {
+  ArenaPool pool;
+  ArenaAllocator allocator(&pool);
+
+  HGraph* graph = new (&allocator) HGraph(&allocator);
+  HBasicBlock* entry = CreateBlock(graph, &allocator);
+  graph->SetEntryBlock(entry);
+  HInstruction* parameter = new (&allocator) HParameterValue(0, Primitive::kPrimNot);
+  HInstruction* array = new (&allocator) HParameterValue(1, Primitive::kPrimNot);
+  HInstruction* constant = new (&allocator) HIntConstant(3);
+  entry->AddInstruction(parameter);
+  entry->AddInstruction(array);
+  entry->AddInstruction(constant);
+  entry->AddInstruction(new (&allocator) HGoto());
+
+  HBasicBlock* block = CreateBlock(graph, &allocator);
+  entry->AddSuccessor(block);
+  HInstruction* get = AddFieldGet(block, &allocator, parameter, 42);
+  HInstruction* array_get = new (&allocator) HArrayGet(array, constant, Primitive::kPrimInt);
+  block->AddInstruction(array_get);
+  block->AddInstruction(new (&allocator) HGoto());
+
+  HBasicBlock* loop_header = CreateBlock(graph, &allocator);
+  HBasicBlock* loop_body = CreateBlock(graph, &allocator);
+  HBasicBlock* exit_block = CreateBlock(graph, &allocator);
+  block->AddSuccessor(loop_header);
+  loop_header->AddSuccessor(loop_body);
+  loop_header->AddSuccessor(exit_block);
+  loop_body->AddSuccessor(loop_header);
+
+  HInstruction* header_get = AddFieldGet(loop_header, &allocator, parameter, 42);
+  loop_header->AddInstruction(new (&allocator) HIf(header_get));
+
+  // The loop writes to an array, which does not change the fields.
+  HInstruction* body_array_get = new (&allocator) HArrayGet(array, constant, Primitive::kPrimInt);
+  loop_body->AddInstruction(body_array_get);
+  loop_body->AddInstruction(new (&allocator) HArraySet(array, constant, constant, 0));
+  HInstruction* body_get = AddFieldGet(loop_body, &allocator, parameter, 42);
+  loop_body->AddInstruction(new (&allocator) HGoto());
+
+  exit_block->AddInstruction(new (&allocator) HReturnVoid());
+  HBasicBlock* exit = CreateBlock(graph, &allocator);
+  exit_block->AddSuccessor(exit);
+  exit->AddInstruction(new (&allocator) HExit());
+
+  RunGvn(graph);
+
+  ASSERT_EQ(get->GetBlock(), block);
+  ASSERT_EQ(header_get->GetBlock(), nullptr);
+  ASSERT_EQ(body_get->GetBlock(), nullptr);
+  ASSERT_EQ(loop_header->GetLastInstruction()->InputAt(0), get);
+  // The array set in the loop kills the array values computed before the loop.
+  ASSERT_EQ(array_get->GetBlock(), block);
+  ASSERT_EQ(body_array_get->GetBlock(), loop_body);
+}
+
+TEST(GVNTest, InvokeKillsEverything) {
+  ArenaPool pool;
+  ArenaAllocator allocator(&pool);
+
+  HGraph* graph = new (&allocator) HGraph(&allocator);
+  HBasicBlock* entry = CreateBlock(graph, &allocator);
+  graph->SetEntryBlock(entry);
+  HInstruction* parameter = new (&allocator) HParameterValue(0, Primitive::kPrimInt);
+  HInstruction* array = new (&allocator) HParameterValue(1, Primitive::kPrimNot);
+  entry->AddInstruction(parameter);
+  entry->AddInstruction(array);
+  entry->AddInstruction(new (&allocator) HGoto());
+
+  HBasicBlock* block = CreateBlock(graph, &allocator);
+  entry->AddSuccessor(block);
+  HInstruction* add = new (&allocator) HAdd(Primitive::kPrimInt, parameter, parameter);
+  HInstruction* array_get = new (&allocator) HArrayGet(array, parameter, Primitive::kPrimInt);
+  block->AddInstruction(add);
+  block->AddInstruction(array_get);
+  block->AddInstruction(new (&allocator) HInvokeStatic(&allocator, 0, Primitive::kPrimVoid, 0, 0));
+  HInstruction* same_add = new (&allocator) HAdd(Primitive::kPrimInt, parameter, parameter);
+  HInstruction* same_array_get =
+      new (&allocator) HArrayGet(array, parameter, Primitive::kPrimInt);
+  HInstruction* sub = new (&allocator) HSub(Primitive::kPrimInt, parameter, parameter);
+  block->AddInstruction(same_add);
+  block->AddInstruction(same_array_get);
+  block->AddInstruction(sub);
+  block->AddInstruction(new (&allocator) HReturnVoid());
+
+  HBasicBlock* exit = CreateBlock(graph, &allocator);
+  block->AddSuccessor(exit);
+  exit->AddInstruction(new (&allocator) HExit());
+
+  RunGvn(graph);
+
+  ASSERT_EQ(add->GetBlock(), block);
+  ASSERT_EQ(array_get->GetBlock(), block);
+  // Arithmetic does not depend on memory.
+  ASSERT_EQ(same_add->GetBlock(), nullptr);
+  ASSERT_EQ(same_array_get->GetBlock(), block);
+  ASSERT_EQ(sub->GetBlock(), block);
+}
+
+TEST(GVNTest, NewInstanceKillsFields) {
+  ArenaPool pool;
+  ArenaAllocator allocator(&pool);
+
+  HGraph* graph = new (&allocator) HGraph(&allocator);
+  HBasicBlock* entry = CreateBlock(graph, &allocator);
+  graph->SetEntryBlock(entry);
+  HInstruction* parameter = new (&allocator) HParameterValue(0, Primitive::kPrimNot);
+  entry->AddInstruction(parameter);
+  entry->AddInstruction(new (&allocator) HGoto());
+
+  HBasicBlock* block = CreateBlock(graph, &allocator);
+  entry->AddSuccessor(block);
+  HInstruction* get = AddFieldGet(block, &allocator, parameter, 42);
+  block->AddInstruction(new (&allocator) HNewInstance(0, 0));
+  HInstruction* same_get = AddFieldGet(block, &allocator, parameter, 42);
+  block->AddInstruction(new (&allocator) HReturn(same_get));
+
+  HBasicBlock* exit = CreateBlock(graph, &allocator);
+  block->AddSuccessor(exit);
+  exit->AddInstruction(new (&allocator) HExit());
+
+  RunGvn(graph);
+
+  ASSERT_EQ(get->GetBlock(), block);
+  // A class initializer run by the allocation may write the field.
+  ASSERT_EQ(same_get->GetBlock(), block);
+}
+
+}  // namespace art
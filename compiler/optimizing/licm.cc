@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "licm.h"
+
+namespace art {
+
+bool LICM::IsLoopInvariant(HInstruction* instruction,
+                           const HLoopInformation& loop_info,
+                           SideEffects loop_effects) const {
+  if (!instruction->CanBeMoved()
+      || instruction->CanThrow()
+      || instruction->NeedsEnvironment()
+      || instruction->GetSideEffects().MayDependOn(loop_effects)) {
+    return false;
+  }
+  // An input defined before the loop dominates the pre header, since it dominates
+  // `instruction`.
+  for (HInputIterator it(instruction); !it.Done(); it.Advance()) {
+    if (loop_info.Contains(*it.Current()->GetBlock())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void LICM::Run() {
+  // Visit loop headers in post order, so that inner loops are visited before their outer
+  // loops: instructions hoisted to the pre header of an inner loop can then be hoisted
+  // again out of the outer loop.
+  for (HPostOrderIterator it(*graph_); !it.Done(); it.Advance()) {
+    HBasicBlock* header = it.Current();
+    if (!header->IsLoopHeader()) {
+      continue;
+    }
+    HLoopInformation* loop_info = header->GetLoopInformation();
+    SideEffects loop_effects = side_effects_.GetLoopEffects(header);
+    HInstruction* cursor = loop_info->GetPreHeader()->GetLastInstruction();
+
+    // Visit the blocks of the loop in reverse post order, so that the inputs of an
+    // instruction are visited, and possibly hoisted, before it. Blocks of inner loops
+    // were already visited.
+    for (HReversePostOrderIterator block_it(*graph_); !block_it.Done(); block_it.Advance()) {
+      HBasicBlock* block = block_it.Current();
+      if (block->GetLoopInformation() != loop_info) {
+        continue;
+      }
+      for (HInstructionIterator inst_it(block->GetInstructions());
+           !inst_it.Done();
+           inst_it.Advance()) {
+        HInstruction* instruction = inst_it.Current();
+        if (IsLoopInvariant(instruction, *loop_info, loop_effects)) {
+          instruction->MoveBefore(cursor);
+          ++number_of_hoisted_instructions_;
+        }
+      }
+    }
+  }
+}
+
+}  // namespace art
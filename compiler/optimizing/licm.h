@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_COMPILER_OPTIMIZING_LICM_H_
+#define ART_COMPILER_OPTIMIZING_LICM_H_
+
+#include "nodes.h"
+#include "side_effects_analysis.h"
+
+namespace art {
+
+/**
+ * Optimization phase that moves loop invariant instructions to the pre header of their
+ * loop. An instruction is invariant when its inputs are defined before the loop and the
+ * loop does not change the memory it depends on. Instructions that can throw are not
+ * moved, as the loop may exit or throw another exception before them.
+ */
+class LICM : public ValueObject {
+ public:
+  LICM(HGraph* graph, const SideEffectsAnalysis& side_effects)
+      : graph_(graph), side_effects_(side_effects), number_of_hoisted_instructions_(0) {}
+
+  void Run();
+
+  size_t GetNumberOfHoistedInstructions() const { return number_of_hoisted_instructions_; }
+
+ private:
+  // Returns whether `instruction` can be moved to the pre header of `loop_info`.
+  bool IsLoopInvariant(HInstruction* instruction,
+                       const HLoopInformation& loop_info,
+                       SideEffects loop_effects) const;
+
+  HGraph* const graph_;
+  const SideEffectsAnalysis& side_effects_;
+  size_t number_of_hoisted_instructions_;
+
+  DISALLOW_COPY_AND_ASSIGN(LICM);
+};
+
+}  // namespace art
+
+#endif  // ART_COMPILER_OPTIMIZING_LICM_H_
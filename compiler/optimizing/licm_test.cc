@@ -0,0 +1,252 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "licm.h"
+#include "nodes.h"
+#include "side_effects_analysis.h"
+#include "utils/arena_allocator.h"
+
+#include "gtest/gtest.h"
+
+namespace art {
+
+static HBasicBlock* CreateBlock(HGraph* graph, ArenaAllocator* allocator) {
+  HBasicBlock* block = new (allocator) HBasicBlock(graph);
+  graph->AddBlock(block);
+  return block;
+}
+
+// Creates the blocks of a loop after `pre_header`. The header ends with an HIf on
+// `condition` branching to `body` or `exit_block`. The body is left empty, and the
+// back edge is left to the caller.
+static void CreateLoop(HGraph* graph,
+                       ArenaAllocator* allocator,
+                       HBasicBlock* pre_header,
+                       HInstruction* condition,
+                       HBasicBlock** header,
+                       HBasicBlock** body,
+                       HBasicBlock** exit_block) {
+  *header = CreateBlock(graph, allocator);
+  *body = CreateBlock(graph, allocator);
+  *exit_block = CreateBlock(graph, allocator);
+  pre_header->AddSuccessor(*header);
+  (*header)->AddSuccessor(*body);
+  (*header)->AddSuccessor(*exit_block);
+  (*header)->AddInstruction(new (allocator) HIf(condition));
+}
+
+static void RunLicm(HGraph* graph) {
+  graph->BuildDominatorTree();
+  graph->FindNaturalLoops();
+  SideEffectsAnalysis side_effects(graph);
+  side_effects.Run();
+  LICM(graph, side_effects).Run();
+}
+
+TEST(LICMTest, ArithmeticHoisting) {
+  ArenaPool pool;
+  ArenaAllocator allocator(&pool);
+
+  HGraph* graph = new (&allocator) HGraph(&allocator);
+  HBasicBlock* entry = CreateBlock(graph, &allocator);
+  graph->SetEntryBlock(entry);
+  HInstruction* parameter = new (&allocator) HParameterValue(0, Primitive::kPrimInt);
+  HInstruction* condition = new (&allocator) HParameterValue(1, Primitive::kPrimBoolean);
+  HInstruction* constant = new (&allocator) HIntConstant(1);
+  entry->AddInstruction(parameter);
+  entry->AddInstruction(condition);
+  entry->AddInstruction(constant);
+  entry->AddInstruction(new (&allocator) HGoto());
+
+  HBasicBlock* pre_header = CreateBlock(graph, &allocator);
+  entry->AddSuccessor(pre_header);
+  pre_header->AddInstruction(new (&allocator) HGoto());
+
+  HBasicBlock* header;
+  HBasicBlock* body;
+  HBasicBlock* exit_block;
+  CreateLoop(graph, &allocator, pre_header, condition, &header, &body, &exit_block);
+  body->AddSuccessor(header);
+
+  HPhi* phi = new (&allocator) HPhi(&allocator, 0, 0, Primitive::kPrimInt);
+  header->AddPhi(phi);
+  HInstruction* invariant = new (&allocator) HAdd(Primitive::kPrimInt, parameter, constant);
+  HInstruction* invariant_user = new (&allocator) HSub(Primitive::kPrimInt, invariant, constant);
+  HInstruction* variant = new (&allocator) HAdd(Primitive::kPrimInt, phi, invariant_user);
+  body->AddInstruction(invariant);
+  body->AddInstruction(invariant_user);
+  body->AddInstruction(variant);
+  body->AddInstruction(new (&allocator) HGoto());
+  phi->AddInput(constant);
+  phi->AddInput(variant);
+
+  exit_block->AddInstruction(new (&allocator) HReturn(phi));
+  HBasicBlock* exit = CreateBlock(graph, &allocator);
+  exit_block->AddSuccessor(exit);
+  exit->AddInstruction(new (&allocator) HExit());
+
+  RunLicm(graph);
+
+  // Instructions only using invariant instructions are invariant too.
+  ASSERT_EQ(invariant->GetBlock(), pre_header);
+  ASSERT_EQ(invariant_user->GetBlock(), pre_header);
+  ASSERT_EQ(invariant->GetNext(), invariant_user);
+  ASSERT_EQ(invariant_user->GetNext(), pre_header->GetLastInstruction());
+  ASSERT_TRUE(pre_header->GetLastInstruction()->IsGoto());
+  ASSERT_EQ(variant->GetBlock(), body);
+  ASSERT_EQ(body->GetFirstInstruction(), variant);
+}
+
+TEST(LICMTest, FieldHoisting) {
+  ArenaPool pool;
+  ArenaAllocator allocator(&pool);
+
+  HGraph* graph = new (&allocator) HGraph(&allocator);
+  HBasicBlock* entry = CreateBlock(graph, &allocator);
+  graph->SetEntryBlock(entry);
+  HInstruction* object = new (&allocator) HParameterValue(0, Primitive::kPrimNot);
+  HInstruction* array = new (&allocator) HParameterValue(1, Primitive::kPrimNot);
+  HInstruction* condition = new (&allocator) HParameterValue(2, Primitive::kPrimBoolean);
+  entry->AddInstruction(object);
+  entry->AddInstruction(array);
+  entry->AddInstruction(condition);
+  entry->AddInstruction(new (&allocator) HGoto());
+
+  HBasicBlock* pre_header = CreateBlock(graph, &allocator);
+  entry->AddSuccessor(pre_header);
+  pre_header->AddInstruction(new (&allocator) HGoto());
+
+  HBasicBlock* header;
+  HBasicBlock* body;
+  HBasicBlock* exit_block;
+  CreateLoop(graph, &allocator, pre_header, condition, &header, &body, &exit_block);
+  body->AddSuccessor(header);
+
+  // The loop writes to an array, which does not change the fields.
+  HInstruction* field_get =
+      new (&allocator) HInstanceFieldGet(object, Primitive::kPrimInt, MemberOffset(12));
+  HInstruction* array_get = new (&allocator) HArrayGet(array, field_get, Primitive::kPrimInt);
+  HInstruction* length = new (&allocator) HArrayLength(array);
+  body->AddInstruction(field_get);
+  body->AddInstruction(array_get);
+  body->AddInstruction(length);
+  body->AddInstruction(new (&allocator) HArraySet(array, field_get, length, 0));
+  body->AddInstruction(new (&allocator) HGoto());
+
+  exit_block->AddInstruction(new (&allocator) HReturnVoid());
+  HBasicBlock* exit = CreateBlock(graph, &allocator);
+  exit_block->AddSuccessor(exit);
+  exit->AddInstruction(new (&allocator) HExit());
+
+  RunLicm(graph);
+
+  ASSERT_EQ(field_get->GetBlock(), pre_header);
+  ASSERT_EQ(array_get->GetBlock(), body);
+  ASSERT_EQ(length->GetBlock(), pre_header);
+}
+
+TEST(LICMTest, NoHoistingAcrossSideEffects) {
+  ArenaPool pool;
+  ArenaAllocator allocator(&pool);
+
+  HGraph* graph = new (&allocator) HGraph(&allocator);
+  HBasicBlock* entry = CreateBlock(graph, &allocator);
+  graph->SetEntryBlock(entry);
+  HInstruction* object = new (&allocator) HParameterValue(0, Primitive::kPrimNot);
+  HInstruction* condition = new (&allocator) HParameterValue(1, Primitive::kPrimBoolean);
+  entry->AddInstruction(object);
+  entry->AddInstruction(condition);
+  entry->AddInstruction(new (&allocator) HGoto());
+
+  HBasicBlock* pre_header = CreateBlock(graph, &allocator);
+  entry->AddSuccessor(pre_header);
+  pre_header->AddInstruction(new (&allocator) HGoto());
+
+  HBasicBlock* header;
+  HBasicBlock* body;
+  HBasicBlock* exit_block;
+  CreateLoop(graph, &allocator, pre_header, condition, &header, &body, &exit_block);
+  body->AddSuccessor(header);
+
+  HInstruction* null_check = new (&allocator) HNullCheck(object, 0);
+  HInstruction* field_get =
+      new (&allocator) HInstanceFieldGet(object, Primitive::kPrimInt, MemberOffset(12));
+  body->AddInstruction(null_check);
+  body->AddInstruction(field_get);
+  body->AddInstruction(new (&allocator) HInvokeStatic(&allocator, 0, Primitive::kPrimVoid, 0, 0));
+  body->AddInstruction(new (&allocator) HGoto());
+
+  exit_block->AddInstruction(new (&allocator) HReturnVoid());
+  HBasicBlock* exit = CreateBlock(graph, &allocator);
+  exit_block->AddSuccessor(exit);
+  exit->AddInstruction(new (&allocator) HExit());
+
+  RunLicm(graph);
+
+  // Checks are not hoisted: the loop may not execute them.
+  ASSERT_EQ(null_check->GetBlock(), body);
+  // The invoke may write to the field.
+  ASSERT_EQ(field_get->GetBlock(), body);
+}
+
+TEST(LICMTest, NestedLoops) {
+  ArenaPool pool;
+  ArenaAllocator allocator(&pool);
+
+  HGraph* graph = new (&allocator) HGraph(&allocator);
+  HBasicBlock* entry = CreateBlock(graph, &allocator);
+  graph->SetEntryBlock(entry);
+  HInstruction* parameter = new (&allocator) HParameterValue(0, Primitive::kPrimInt);
+  HInstruction* condition = new (&allocator) HParameterValue(1, Primitive::kPrimBoolean);
+  entry->AddInstruction(parameter);
+  entry->AddInstruction(condition);
+  entry->AddInstruction(new (&allocator) HGoto());
+
+  HBasicBlock* pre_header = CreateBlock(graph, &allocator);
+  entry->AddSuccessor(pre_header);
+  pre_header->AddInstruction(new (&allocator) HGoto());
+
+  HBasicBlock* outer_header;
+  HBasicBlock* outer_body;
+  HBasicBlock* outer_exit;
+  CreateLoop(graph, &allocator, pre_header, condition, &outer_header, &outer_body, &outer_exit);
+
+  // The inner loop is between the outer body and the outer back edge.
+  HBasicBlock* inner_header;
+  HBasicBlock* inner_body;
+  HBasicBlock* outer_back_edge;
+  CreateLoop(graph, &allocator, outer_body, condition, &inner_header, &inner_body,
+             &outer_back_edge);
+  inner_body->AddSuccessor(inner_header);
+  outer_body->AddInstruction(new (&allocator) HGoto());
+  outer_back_edge->AddSuccessor(outer_header);
+  outer_back_edge->AddInstruction(new (&allocator) HGoto());
+
+  HInstruction* invariant = new (&allocator) HAdd(Primitive::kPrimInt, parameter, parameter);
+  inner_body->AddInstruction(invariant);
+  inner_body->AddInstruction(new (&allocator) HGoto());
+
+  outer_exit->AddInstruction(new (&allocator) HReturnVoid());
+  HBasicBlock* exit = CreateBlock(graph, &allocator);
+  outer_exit->AddSuccessor(exit);
+  exit->AddInstruction(new (&allocator) HExit());
+
+  RunLicm(graph);
+
+  ASSERT_EQ(invariant->GetBlock(), pre_header);
+}
+
+}  // namespace art
@@ -337,6 +337,15 @@ static void Remove(HInstructionList* instruction_list,
   for (size_t i = 0; i < instruction->InputCount(); i++) {
     instruction->InputAt(i)->RemoveUser(instruction, i);
   }
+  HEnvironment* environment = instruction->GetEnvironment();
+  if (environment != nullptr) {
+    GrowableArray<HInstruction*>* vregs = environment->GetVRegs();
+    for (size_t i = 0; i < vregs->Size(); i++) {
+      if (vregs->Get(i) != nullptr) {
+        vregs->Get(i)->RemoveEnvironmentUser(environment, i);
+      }
+    }
+  }
 }
 
 void HBasicBlock::RemoveInstruction(HInstruction* instruction) {
@@ -363,6 +372,31 @@ void HInstruction::RemoveUser(HInstruction* user, size_t input_index) {
   }
 }
 
+void HInstruction::RemoveEnvironmentUser(HEnvironment* user, size_t input_index) {
+  HUseListNode<HEnvironment>* previous = nullptr;
+  HUseListNode<HEnvironment>* current = env_uses_;
+  while (current != nullptr) {
+    if (current->GetUser() == user && current->GetIndex() == input_index) {
+      if (previous == nullptr) {
+        env_uses_ = current->GetTail();
+      } else {
+        previous->SetTail(current->GetTail());
+      }
+      return;
+    }
+    previous = current;
+    current = current->GetTail();
+  }
+}
+
+void HInstruction::ClearEnvironmentUses() {
+  for (HUseIterator<HEnvironment> it(GetEnvUses()); !it.Done(); it.Advance()) {
+    HUseListNode<HEnvironment>* current = it.Current();
+    current->GetUser()->SetRawEnvAt(current->GetIndex(), nullptr);
+  }
+  env_uses_ = nullptr;
+}
+
 void HInstructionList::AddInstruction(HInstruction* instruction) {
   if (first_instruction_ == nullptr) {
     DCHECK(last_instruction_ == nullptr);
@@ -414,6 +448,58 @@ void HInstruction::ReplaceWith(HInstruction* other) {
   env_uses_ = nullptr;
 }
 
+bool HInstruction::Equals(HInstruction* other) const {
+  if (!InstructionTypeEquals(other)) return false;
+  DCHECK_STREQ(DebugName(), other->DebugName());
+  if (!InstructionDataEquals(other)) return false;
+  if (GetType() != other->GetType()) return false;
+  if (InputCount() != other->InputCount()) return false;
+
+  for (size_t i = 0, e = InputCount(); i < e; ++i) {
+    if (InputAt(i) != other->InputAt(i)) return false;
+  }
+  DCHECK_EQ(ComputeHashCode(), other->ComputeHashCode());
+  return true;
+}
+
+size_t HInstruction::ComputeHashCode() const {
+  size_t result = InputCount();
+  for (size_t i = 0, e = InputCount(); i < e; ++i) {
+    result = (result * 31) + InputAt(i)->GetId();
+  }
+  return result;
+}
+
+void HInstruction::MoveBefore(HInstruction* cursor) {
+  DCHECK(!IsControlFlow());
+  DCHECK(!IsPhi());
+  DCHECK(!cursor->IsPhi());
+  DCHECK_NE(cursor, this);
+
+  // Unlink this instruction from its block. It is not the last instruction, which is
+  // a control flow instruction.
+  DCHECK_NE(block_->instructions_.last_instruction_, this);
+  next_->previous_ = previous_;
+  if (previous_ != nullptr) {
+    previous_->next_ = next_;
+  }
+  if (block_->instructions_.first_instruction_ == this) {
+    block_->instructions_.first_instruction_ = next_;
+  }
+
+  // Link it before `cursor`.
+  previous_ = cursor->previous_;
+  if (previous_ != nullptr) {
+    previous_->next_ = this;
+  }
+  next_ = cursor;
+  cursor->previous_ = this;
+  block_ = cursor->block_;
+  if (block_->instructions_.first_instruction_ == cursor) {
+    block_->instructions_.first_instruction_ = this;
+  }
+}
+
 void HPhi::AddInput(HInstruction* input) {
   DCHECK(input->GetBlock() != nullptr);
   inputs_.Add(input);
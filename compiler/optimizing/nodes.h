@@ -61,12 +61,55 @@ class HInstructionList {
   HInstruction* last_instruction_;
 
   friend class HBasicBlock;
+  friend class HInstruction;
   friend class HInstructionIterator;
   friend class HBackwardInstructionIterator;
 
   DISALLOW_COPY_AND_ASSIGN(HInstructionList);
 };
 
+/**
+ * The memory an instruction writes to, and the memory its result depends on.
+ * Field and array accesses are tracked separately, invokes write and read everything.
+ */
+class SideEffects : public ValueObject {
+ public:
+  SideEffects() : flags_(0) {}
+
+  static SideEffects None() { return SideEffects(0); }
+  static SideEffects All() { return SideEffects(kAllWrites | kAllReads); }
+  static SideEffects FieldWrites() { return SideEffects(kFieldWrite); }
+  static SideEffects FieldReads() { return SideEffects(kFieldRead); }
+  static SideEffects ArrayWrites() { return SideEffects(kArrayWrite); }
+  static SideEffects ArrayReads() { return SideEffects(kArrayRead); }
+
+  SideEffects Union(SideEffects other) const { return SideEffects(flags_ | other.flags_); }
+
+  bool HasSideEffects() const { return (flags_ & kAllWrites) != 0; }
+  bool HasDependencies() const { return (flags_ & kAllReads) != 0; }
+
+  // Returns whether an instruction with these side effects may compute a different value
+  // after an instruction with the `other` side effects.
+  bool MayDependOn(SideEffects other) const {
+    return (((flags_ & kAllReads) >> kReadShift) & other.flags_) != 0;
+  }
+
+  bool Equals(SideEffects other) const { return flags_ == other.flags_; }
+
+ private:
+  static constexpr uint32_t kFieldWrite = 1 << 0;
+  static constexpr uint32_t kArrayWrite = 1 << 1;
+  static constexpr uint32_t kAllWrites = kFieldWrite | kArrayWrite;
+  static constexpr size_t kReadShift = 2;
+  static constexpr uint32_t kFieldRead = kFieldWrite << kReadShift;
+  static constexpr uint32_t kArrayRead = kArrayWrite << kReadShift;
+  static constexpr uint32_t kAllReads = kFieldRead | kArrayRead;
+
+  explicit SideEffects(uint32_t flags) : flags_(flags) {}
+
+  uint32_t flags_;
+};
+
 // Control-flow graph of a method. Contains a list of basic blocks.
 class HGraph : public ArenaObject {
  public:
@@ -405,6 +448,8 @@ class HBasicBlock : public ArenaObject {
   size_t lifetime_start_;
   size_t lifetime_end_;
 
+  friend class HInstruction;
+
   DISALLOW_COPY_AND_ASSIGN(HBasicBlock);
 };
 
@@ -452,10 +497,13 @@ class HBasicBlock : public ArenaObject {
 FOR_EACH_INSTRUCTION(FORWARD_DECLARATION)
 #undef FORWARD_DECLARATION
 
-#define DECLARE_INSTRUCTION(type)                          \
-  virtual const char* DebugName() const { return #type; }  \
-  virtual H##type* As##type() { return this; }             \
-  virtual void Accept(HGraphVisitor* visitor)              \
+#define DECLARE_INSTRUCTION(type)                                         \
+  virtual const char* DebugName() const { return #type; }                 \
+  virtual H##type* As##type() { return this; }                            \
+  virtual bool InstructionTypeEquals(HInstruction* other) const {         \
+    return other->Is##type();                                             \
+  }                                                                       \
+  virtual void Accept(HGraphVisitor* visitor)                             \
 
 template <typename T>
 class HUseListNode : public ArenaObject {
@@ -479,7 +527,7 @@ class HUseListNode : public ArenaObject {
 
 class HInstruction : public ArenaObject {
  public:
-  HInstruction()
+  explicit HInstruction(SideEffects side_effects = SideEffects::None())
       : previous_(nullptr),
         next_(nullptr),
         block_(nullptr),
@@ -490,7 +538,8 @@ class HInstruction : public ArenaObject {
         environment_(nullptr),
         locations_(nullptr),
         live_interval_(nullptr),
-        lifetime_position_(kNoLifetime) {}
+        lifetime_position_(kNoLifetime),
+        side_effects_(side_effects) {}
 
   virtual ~HInstruction() {}
 
@@ -513,6 +562,29 @@ class HInstruction : public ArenaObject {
 
   virtual bool NeedsEnvironment() const { return false; }
   virtual bool IsControlFlow() const { return false; }
+  virtual bool CanThrow() const { return false; }
+
+  SideEffects GetSideEffects() const { return side_effects_; }
+
+  // Returns whether the instruction can be moved within the graph, as long as its
+  // inputs dominate it and its dependencies are not changed on the way.
+  virtual bool CanBeMoved() const { return false; }
+
+  // Returns whether the two instructions are of the same kind.
+  virtual bool InstructionTypeEquals(HInstruction* other) const { return false; }
+
+  // Returns whether any data encoded in the two instructions is equal.
+  // This method does not look at the inputs. Both instructions must be
+  // of the same type, otherwise the method has undefined behavior.
+  virtual bool InstructionDataEquals(HInstruction* other) const { return false; }
+
+  // Returns whether two instructions are equal, that is:
+  // 1) They have the same type and contain the same data,
+  // 2) Their inputs are identical.
+  bool Equals(HInstruction* other) const;
+
+  // The hash code of the instruction, equal instructions have the same hash code.
+  virtual size_t ComputeHashCode() const;
 
   void AddUseAt(HInstruction* user, size_t index) {
     uses_ = new (block_->GetGraph()->GetArena()) HUseListNode<HInstruction>(user, index, uses_);
@@ -524,6 +596,10 @@ class HInstruction : public ArenaObject {
   }
 
   void RemoveUser(HInstruction* user, size_t index);
+  void RemoveEnvironmentUser(HEnvironment* user, size_t index);
+
+  // Replaces this instruction by null in the environments using it.
+  void ClearEnvironmentUses();
 
   HUseListNode<HInstruction>* GetUses() const { return uses_; }
   HUseListNode<HEnvironment>* GetEnvUses() const { return env_uses_; }
@@ -558,6 +634,9 @@ class HInstruction : public ArenaObject {
 
   void ReplaceWith(HInstruction* instruction);
 
+  // Moves this instruction before `cursor`, which can be in another block.
+  void MoveBefore(HInstruction* cursor);
+
   bool HasOnlyOneUse() const {
     return uses_ != nullptr && uses_->GetTail() == nullptr;
   }
@@ -606,6 +685,8 @@ class HInstruction : public ArenaObject {
   // order of blocks where this instruction's live interval start.
   size_t lifetime_position_;
 
+  const SideEffects side_effects_;
+
   friend class HBasicBlock;
   friend class HInstructionList;
 
@@ -776,7 +857,8 @@ class EmbeddedArray<T, 0> {
 template<intptr_t N>
 class HTemplateInstruction: public HInstruction {
  public:
-  HTemplateInstruction<N>() : inputs_() {}
+  explicit HTemplateInstruction<N>(SideEffects side_effects = SideEffects::None())
+      : HInstruction(side_effects), inputs_() {}
   virtual ~HTemplateInstruction() {}
 
   virtual size_t InputCount() const { return N; }
@@ -796,7 +878,9 @@ class HTemplateInstruction: public HInstruction {
 template<intptr_t N>
 class HExpression: public HTemplateInstruction<N> {
  public:
-  explicit HExpression<N>(Primitive::Type type) : type_(type) {}
+  explicit HExpression<N>(Primitive::Type type,
+                          SideEffects side_effects = SideEffects::None())
+      : HTemplateInstruction<N>(side_effects), type_(type) {}
   virtual ~HExpression() {}
 
   virtual Primitive::Type GetType() const { return type_; }
@@ -909,6 +993,9 @@ class HBinaryOperation : public HExpression<2> {
 
   virtual bool IsCommutative() { return false; }
 
+  virtual bool CanBeMoved() const { return true; }
+  virtual bool InstructionDataEquals(HInstruction* other) const { return true; }
+
  private:
   DISALLOW_COPY_AND_ASSIGN(HBinaryOperation);
 };
@@ -921,6 +1008,10 @@ class HCondition : public HBinaryOperation {
   virtual bool IsCommutative() { return true; }
   bool NeedsMaterialization() const;
 
+  // Conditions stay next to the HIf using them, so that they do not need to be
+  // materialized.
+  virtual bool CanBeMoved() const { return false; }
+
   DECLARE_INSTRUCTION(Condition);
 
   virtual IfCondition GetCondition() const = 0;
@@ -1046,9 +1137,12 @@ class HLocal : public HTemplateInstruction<0> {
 
   uint16_t GetRegNumber() const { return reg_number_; }
 
+  // Used by the graph builder to make room for the locals of inlined methods.
+  void SetRegNumber(uint16_t reg_number) { reg_number_ = reg_number; }
+
  private:
   // The Dex register number.
-  const uint16_t reg_number_;
+  uint16_t reg_number_;
 
   DISALLOW_COPY_AND_ASSIGN(HLocal);
 };
@@ -1131,7 +1225,8 @@ class HInvoke : public HInstruction {
           uint32_t number_of_arguments,
           Primitive::Type return_type,
           uint32_t dex_pc)
-    : inputs_(arena, number_of_arguments),
+    : HInstruction(SideEffects::All()),
+      inputs_(arena, number_of_arguments),
       return_type_(return_type),
       dex_pc_(dex_pc) {
     inputs_.SetSize(number_of_arguments);
@@ -1187,8 +1282,10 @@ class HInvokeStatic : public HInvoke {
 
 class HNewInstance : public HExpression<0> {
  public:
-  HNewInstance(uint32_t dex_pc, uint16_t type_index) : HExpression(Primitive::kPrimNot),
-    dex_pc_(dex_pc), type_index_(type_index) {}
+  // The allocation may run a class initializer or a GC, which can read and write anything.
+  HNewInstance(uint32_t dex_pc, uint16_t type_index)
+      : HExpression(Primitive::kPrimNot, SideEffects::All()),
+        dex_pc_(dex_pc), type_index_(type_index) {}
 
   uint32_t GetDexPc() const { return dex_pc_; }
   uint16_t GetTypeIndex() const { return type_index_; }
@@ -1256,6 +1353,9 @@ class HNot : public HExpression<1> {
     SetRawInputAt(0, input);
   }
 
+  virtual bool CanBeMoved() const { return true; }
+  virtual bool InstructionDataEquals(HInstruction* other) const { return true; }
+
   DECLARE_INSTRUCTION(Not);
 
  private:
@@ -1309,7 +1409,11 @@ class HNullCheck : public HExpression<1> {
     SetRawInputAt(0, value);
   }
 
+  virtual bool CanBeMoved() const { return true; }
+  virtual bool InstructionDataEquals(HInstruction* other) const { return true; }
+
   virtual bool NeedsEnvironment() const { return true; }
+  virtual bool CanThrow() const { return true; }
 
   uint32_t GetDexPc() const { return dex_pc_; }
 
@@ -1337,10 +1441,20 @@ class HInstanceFieldGet : public HExpression<1> {
   HInstanceFieldGet(HInstruction* value,
                     Primitive::Type field_type,
                     MemberOffset field_offset)
-      : HExpression(field_type), field_info_(field_offset) {
+      : HExpression(field_type, SideEffects::FieldReads()), field_info_(field_offset) {
     SetRawInputAt(0, value);
   }
 
+  virtual bool CanBeMoved() const { return true; }
+  virtual bool InstructionDataEquals(HInstruction* other) const {
+    size_t other_offset = other->AsInstanceFieldGet()->GetFieldOffset().SizeValue();
+    return other_offset == GetFieldOffset().SizeValue();
+  }
+
+  virtual size_t ComputeHashCode() const {
+    return (HInstruction::ComputeHashCode() << 7) | GetFieldOffset().SizeValue();
+  }
+
   MemberOffset GetFieldOffset() const { return field_info_.GetFieldOffset(); }
 
   DECLARE_INSTRUCTION(InstanceFieldGet);
@@ -1356,7 +1470,7 @@ class HInstanceFieldSet : public HTemplateInstruction<2> {
   HInstanceFieldSet(HInstruction* object,
                     HInstruction* value,
                     MemberOffset field_offset)
-      : field_info_(field_offset) {
+      : HTemplateInstruction(SideEffects::FieldWrites()), field_info_(field_offset) {
     SetRawInputAt(0, object);
     SetRawInputAt(1, value);
   }
@@ -1374,11 +1488,14 @@ class HInstanceFieldSet : public HTemplateInstruction<2> {
 class HArrayGet : public HExpression<2> {
  public:
   HArrayGet(HInstruction* array, HInstruction* index, Primitive::Type type)
-      : HExpression(type) {
+      : HExpression(type, SideEffects::ArrayReads()) {
     SetRawInputAt(0, array);
     SetRawInputAt(1, index);
   }
 
+  virtual bool CanBeMoved() const { return true; }
+  virtual bool InstructionDataEquals(HInstruction* other) const { return true; }
+
   DECLARE_INSTRUCTION(ArrayGet);
 
  private:
@@ -1390,7 +1507,8 @@ class HArraySet : public HTemplateInstruction<3> {
   HArraySet(HInstruction* array,
             HInstruction* index,
             HInstruction* value,
-            uint32_t dex_pc) : dex_pc_(dex_pc) {
+            uint32_t dex_pc)
+      : HTemplateInstruction(SideEffects::ArrayWrites()), dex_pc_(dex_pc) {
     SetRawInputAt(0, array);
     SetRawInputAt(1, index);
     SetRawInputAt(2, value);
@@ -1418,6 +1536,9 @@ class HArrayLength : public HExpression<1> {
     SetRawInputAt(0, array);
   }
 
+  virtual bool CanBeMoved() const { return true; }
+  virtual bool InstructionDataEquals(HInstruction* other) const { return true; }
+
   DECLARE_INSTRUCTION(ArrayLength);
 
  private:
@@ -1433,7 +1554,11 @@ class HBoundsCheck : public HExpression<2> {
     SetRawInputAt(1, length);
   }
 
+  virtual bool CanBeMoved() const { return true; }
+  virtual bool InstructionDataEquals(HInstruction* other) const { return true; }
+
   virtual bool NeedsEnvironment() const { return true; }
+  virtual bool CanThrow() const { return true; }
 
   uint32_t GetDexPc() const { return dex_pc_; }
 
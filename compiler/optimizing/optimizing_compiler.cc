@@ -25,8 +25,12 @@
 #include "driver/compiler_driver.h"
 #include "driver/dex_compilation_unit.h"
 #include "graph_visualizer.h"
+#include "gvn.h"
+#include "licm.h"
 #include "nodes.h"
 #include "register_allocator.h"
+#include "scalar_replacement.h"
+#include "side_effects_analysis.h"
 #include "ssa_phi_elimination.h"
 #include "ssa_liveness_analysis.h"
 #include "utils/arena_allocator.h"
@@ -166,6 +170,16 @@ void OptimizingCompiler::InitCompilationUnit(CompilationUnit& cu) const {
   delegate_->InitCompilationUnit(cu);
 }
 
+// Transforms `graph` to SSA form, and returns whether all its loops are natural.
+static bool TransformToSsa(HGraph* graph) {
+  graph->BuildDominatorTree();
+  graph->TransformToSSA();
+  bool has_natural_loops = graph->FindNaturalLoops();
+  SsaRedundantPhiElimination(graph).Run();
+  SsaDeadPhiElimination(graph).Run();
+  return has_natural_loops;
+}
+
 CompiledMethod* OptimizingCompiler::TryCompile(const DexFile::CodeItem* code_item,
                                                uint32_t access_flags,
                                                InvokeType invoke_type,
@@ -196,8 +210,7 @@ CompiledMethod* OptimizingCompiler::TryCompile(const DexFile::CodeItem* code_ite
   bool shouldOptimize =
       dex_compilation_unit.GetSymbol().find("00024reg_00024") != std::string::npos;
 
-  ArenaPool pool;
-  ArenaAllocator arena(&pool);
+  ArenaAllocator arena(GetCompilerDriver()->GetArenaPool());
   HGraphBuilder builder(&arena, &dex_compilation_unit, &dex_file, GetCompilerDriver());
 
   HGraph* graph = builder.BuildGraph(*code_item);
@@ -207,6 +220,38 @@ CompiledMethod* OptimizingCompiler::TryCompile(const DexFile::CodeItem* code_ite
     }
     return nullptr;
   }
+  GetCompilerDriver()->ProcessedInlining(builder.GetNumberOfInvokes(),
+                                         builder.GetNumberOfInlinedInvokes());
+
+  // Allocations need an environment, which the register allocator does not support yet.
+  // Try to remove the ones that do not escape, which requires the SSA form.
+  bool can_allocate_registers = RegisterAllocator::CanAllocateRegistersFor(*graph, instruction_set);
+  bool is_ssa = false;
+  bool has_natural_loops = false;
+  if (!can_allocate_registers
+      && RegisterAllocator::Supports(instruction_set)
+      && ScalarReplacement::MayEliminateAllocations(*graph)) {
+    has_natural_loops = TransformToSsa(graph);
+    ScalarReplacement scalar_replacement(graph, GetCompilerDriver(), &dex_compilation_unit);
+    scalar_replacement.Run();
+    can_allocate_registers = RegisterAllocator::CanAllocateRegistersFor(*graph, instruction_set);
+    size_t eliminated = 0;
+    if (can_allocate_registers) {
+      is_ssa = true;
+      eliminated = scalar_replacement.GetNumberOfEliminatedAllocations();
+      VLOG(compiler) << "Eliminated " << eliminated << " of "
+                     << scalar_replacement.GetNumberOfAllocations() << " allocations in "
+                     << PrettyMethod(method_idx, dex_file);
+    } else {
+      // The baseline code generator needs the graph before the SSA transformation.
+      HGraphBuilder baseline_builder(&arena, &dex_compilation_unit, &dex_file,
+                                     GetCompilerDriver());
+      graph = baseline_builder.BuildGraph(*code_item);
+      DCHECK(graph != nullptr);
+    }
+    GetCompilerDriver()->ProcessedAllocations(scalar_replacement.GetNumberOfAllocations(),
+                                              eliminated);
+  }
 
   CodeGenerator* codegen = CodeGenerator::Create(&arena, graph, instruction_set);
   if (codegen == nullptr) {
@@ -218,18 +263,26 @@ CompiledMethod* OptimizingCompiler::TryCompile(const DexFile::CodeItem* code_ite
 
   HGraphVisualizer visualizer(
       visualizer_output_.get(), graph, kStringFilter, *codegen, dex_compilation_unit);
-  visualizer.DumpGraph("builder");
+  visualizer.DumpGraph(is_ssa ? kScalarReplacementPassName : "builder");
 
   CodeVectorAllocator allocator;
 
-  if (RegisterAllocator::CanAllocateRegistersFor(*graph, instruction_set)) {
-    graph->BuildDominatorTree();
-    graph->TransformToSSA();
-    visualizer.DumpGraph("ssa");
-    graph->FindNaturalLoops();
+  if (can_allocate_registers) {
+    if (!is_ssa) {
+      has_natural_loops = TransformToSsa(graph);
+      visualizer.DumpGraph("ssa");
+    }
 
-    SsaRedundantPhiElimination(graph).Run();
-    SsaDeadPhiElimination(graph).Run();
+    // The side effects of loops are only known when all loops are natural. Note that the
+    // register allocator does not support environments yet, so this only sees graphs without
+    // null checks, bounds checks, invokes or allocations left, and most loads stay.
+    if (has_natural_loops) {
+      SideEffectsAnalysis side_effects(graph);
+      side_effects.Run();
+      GlobalValueNumberer(graph->GetArena(), graph, side_effects).Run();
+      LICM(graph, side_effects).Run();
+      visualizer.DumpGraph(kGvnPassName);
+    }
 
     SsaLivenessAnalysis liveness(*graph, codegen);
     liveness.Analyze();
@@ -237,6 +290,13 @@ CompiledMethod* OptimizingCompiler::TryCompile(const DexFile::CodeItem* code_ite
 
     RegisterAllocator register_allocator(graph->GetArena(), codegen, liveness);
     register_allocator.AllocateRegisters();
+    if (GetCompilerDriver()->GetCompileStats() != nullptr) {
+      size_t spills;
+      size_t reloads;
+      register_allocator.CountSpillsAndReloads(&spills, &reloads);
+      GetCompilerDriver()->GetCompileStats()->RecordRegisterAllocation(
+          codegen->GetFrameSize(), register_allocator.GetNumberOfSpillSlots(), spills, reloads);
+    }
 
     visualizer.DumpGraph(kRegisterAllocatorPassName);
     codegen->CompileOptimized(&allocator);
@@ -265,6 +325,13 @@ CompiledMethod* OptimizingCompiler::TryCompile(const DexFile::CodeItem* code_ite
   std::vector<uint8_t> gc_map;
   codegen->BuildNativeGCMap(&gc_map, dex_compilation_unit);
 
+  CompileStats* compile_stats = GetCompilerDriver()->GetCompileStats();
+  if (compile_stats != nullptr) {
+    compile_stats->RecordArenaUsage(MethodReference(&dex_file, method_idx),
+                                    arena.BytesReserved(), arena.GetStats());
+    compile_stats->RecordBackend(CompileStats::kBackendOptimizing);
+  }
+
   return CompiledMethod::SwapAllocCompiledMethod(GetCompilerDriver(),
                                                  instruction_set,
                                                  ArrayRef<const uint8_t>(allocator.GetMemory()),
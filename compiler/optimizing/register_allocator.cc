@@ -158,7 +158,7 @@ void RegisterAllocator::AllocateRegistersInternal() {
         // Split before first register use.
         size_t first_register_use = current->FirstRegisterUse();
         if (first_register_use != kNoLifetime) {
-          LiveInterval* split = Split(current, first_register_use - 1);
+          LiveInterval* split = SplitBetween(current, current->GetStart(), first_register_use - 1);
           // Don't add direclty to `unhandled_`, it needs to be sorted and the start
           // of this new interval might be after intervals already in the list.
           AddToUnhandled(split);
@@ -385,20 +385,40 @@ bool RegisterAllocator::TryAllocateFreeReg(LiveInterval* current) {
     }
   }
 
+  // A first input that dies at the instruction defining `current` can give its register to
+  // `current`, which then starts just after the input's last use.
+  LiveInterval* hint = FindRegisterHint(current);
+  bool hint_dies_at_start = (hint != nullptr) && (hint->GetEnd() == current->GetStart() + 1);
+
   // For each active interval, set its register to not free.
   for (size_t i = 0, e = active_.Size(); i < e; ++i) {
     LiveInterval* interval = active_.Get(i);
     DCHECK(interval->HasRegister());
-    free_until[interval->GetRegister()] = 0;
+    if (interval != hint || !hint_dies_at_start) {
+      free_until[interval->GetRegister()] = 0;
+    }
   }
 
-  // Pick the register that is free the longest.
+  // Pick the hinted register if it is free for the whole interval, otherwise the register
+  // that is free the longest.
   int reg = -1;
-  for (size_t i = 0; i < number_of_registers_; ++i) {
-    if (IsBlocked(i)) continue;
-    if (reg == -1 || free_until[i] > free_until[reg]) {
-      reg = i;
-      if (free_until[i] == kMaxLifetimePosition) break;
+  if (hint != nullptr
+      && !IsBlocked(hint->GetRegister())
+      && current->IsDeadAt(free_until[hint->GetRegister()])) {
+    reg = hint->GetRegister();
+    if (hint_dies_at_start) {
+      current->SetFrom(current->GetStart() + 1);
+    }
+  } else {
+    if (hint_dies_at_start) {
+      free_until[hint->GetRegister()] = 0;
+    }
+    for (size_t i = 0; i < number_of_registers_; ++i) {
+      if (IsBlocked(i)) continue;
+      if (reg == -1 || free_until[i] > free_until[reg]) {
+        reg = i;
+        if (free_until[i] == kMaxLifetimePosition) break;
+      }
     }
   }
 
@@ -419,6 +439,48 @@ bool RegisterAllocator::TryAllocateFreeReg(LiveInterval* current) {
   return true;
 }
 
+// Returns the sibling of `interval` that covers `position`, or null if none does.
+static LiveInterval* FindSiblingAt(LiveInterval* interval, size_t position) {
+  for (LiveInterval* current = interval; current != nullptr; current = current->GetNextSibling()) {
+    if (current->Covers(position)) {
+      return current;
+    }
+  }
+  return nullptr;
+}
+
+LiveInterval* RegisterAllocator::FindRegisterHint(LiveInterval* current) const {
+  // Only the first sibling is hinted, the others start where allocating a register failed.
+  if (current->GetParent() != current) {
+    return nullptr;
+  }
+  HInstruction* defined_by = current->GetDefinedBy();
+  if (defined_by->IsPhi()) {
+    // The inputs coming from blocks before the phi in the linear order are already allocated.
+    HBasicBlock* block = defined_by->GetBlock();
+    for (size_t i = 0, e = defined_by->InputCount(); i < e; ++i) {
+      HBasicBlock* predecessor = block->GetPredecessors().Get(i);
+      size_t position = predecessor->GetLastInstruction()->GetLifetimePosition();
+      LiveInterval* input = FindSiblingAt(defined_by->InputAt(i)->GetLiveInterval(), position);
+      if (input != nullptr && input->HasRegister() && input->GetEnd() <= current->GetStart()) {
+        return input;
+      }
+    }
+  } else {
+    Location output = defined_by->GetLocations()->Out();
+    if (output.IsUnallocated() && output.GetPolicy() == Location::kSameAsFirstInput) {
+      LiveInterval* input = FindSiblingAt(defined_by->InputAt(0)->GetLiveInterval(),
+                                          defined_by->GetLifetimePosition());
+      if (input != nullptr
+          && input->HasRegister()
+          && ShouldProcess(processing_core_registers_, input)) {
+        return input;
+      }
+    }
+  }
+  return nullptr;
+}
+
 bool RegisterAllocator::IsBlocked(int reg) const {
   // TODO: This only works for core registers and needs to be adjusted for
   // floating point registers.
@@ -492,7 +554,7 @@ bool RegisterAllocator::AllocateBlockedReg(LiveInterval* current) {
     // If the first use of that instruction is after the last use of the found
     // register, we split this interval just before its first register use.
     AllocateSpillSlotFor(current);
-    LiveInterval* split = Split(current, first_register_use - 1);
+    LiveInterval* split = SplitBetween(current, current->GetStart(), first_register_use - 1);
     AddToUnhandled(split);
     return false;
   } else {
@@ -560,6 +622,36 @@ LiveInterval* RegisterAllocator::Split(LiveInterval* interval, size_t position)
   }
 }
 
+LiveInterval* RegisterAllocator::SplitBetween(LiveInterval* interval, size_t from, size_t to) {
+  if (interval->GetParent()->GetDefinedBy()->IsConstant()) {
+    // Constants are cheaper to materialize at their use than to keep in a register.
+    return Split(interval, to);
+  }
+
+  HBasicBlock* block_from = liveness_.GetBlockFromPosition(from / 2);
+  HBasicBlock* block_to = liveness_.GetBlockFromPosition(to / 2);
+  DCHECK_LE(block_from->GetLifetimeStart(), block_to->GetLifetimeStart());
+
+  // Find the outermost loop containing `to` whose header is after `from`. Blocks of a loop
+  // are contiguous in the linear order, so the value is live at the start of that header.
+  HBasicBlock* split_block = nullptr;
+  HLoopInformation* loop_info = block_to->GetLoopInformation();
+  while (loop_info != nullptr
+         && loop_info->GetHeader()->GetLifetimeStart() > block_from->GetLifetimeStart()) {
+    HBasicBlock* header = loop_info->GetHeader();
+    split_block = header;
+    // The enclosing loop, if any, contains the block dominating the header.
+    HLoopInformation* outer = header->GetDominator()->GetLoopInformation();
+    loop_info = (outer != nullptr && outer->Contains(*header)) ? outer : nullptr;
+  }
+
+  if (split_block == nullptr) {
+    return Split(interval, to);
+  }
+  // The resolution of the loop entry edge moves the value to its new location.
+  return Split(interval, split_block->GetLifetimeStart());
+}
+
 static bool NeedTwoSpillSlot(Primitive::Type type) {
   return type == Primitive::kPrimLong || type == Primitive::kPrimDouble;
 }
@@ -585,64 +677,84 @@ void RegisterAllocator::AllocateSpillSlotFor(LiveInterval* interval) {
     return;
   }
 
-  LiveInterval* last_sibling = interval;
-  while (last_sibling->GetNextSibling() != nullptr) {
-    last_sibling = last_sibling->GetNextSibling();
-  }
-  size_t end = last_sibling->GetEnd();
-
   if (NeedTwoSpillSlot(parent->GetType())) {
-    AllocateTwoSpillSlots(parent, end);
+    AllocateTwoSpillSlots(parent);
   } else {
-    AllocateOneSpillSlot(parent, end);
+    AllocateOneSpillSlot(parent);
   }
 }
 
-void RegisterAllocator::AllocateTwoSpillSlots(LiveInterval* parent, size_t end) {
-  // Find an available spill slot.
-  size_t slot = 0;
-  for (size_t e = spill_slots_.Size(); slot < e; ++slot) {
-    // We check if it is less rather than less or equal because the parallel move
-    // resolver does not work when a single spill slot needs to be exchanged with
-    // a double spill slot. The strict comparison avoids needing to exchange these
-    // locations at the same lifetime position.
-    if (spill_slots_.Get(slot) < parent->GetStart()
-        && (slot == (e - 1) || spill_slots_.Get(slot + 1) < parent->GetStart())) {
-      break;
+// Returns whether the lifetimes of `first` and `second`, over all their siblings, intersect.
+// If `include_adjacent`, ranges that only touch intersect too.
+static bool LifetimesIntersect(LiveInterval* first, LiveInterval* second, bool include_adjacent) {
+  AllRangesIterator first_it(first);
+  AllRangesIterator second_it(second);
+  while (!first_it.Done() && !second_it.Done()) {
+    LiveRange* first_range = first_it.CurrentRange();
+    LiveRange* second_range = second_it.CurrentRange();
+    size_t start = std::max(first_range->GetStart(), second_range->GetStart());
+    size_t end = std::min(first_range->GetEnd(), second_range->GetEnd());
+    if (start < end || (include_adjacent && start == end)) {
+      return true;
+    }
+    if (first_range->GetEnd() < second_range->GetEnd()) {
+      first_it.Advance();
+    } else {
+      second_it.Advance();
+    }
+  }
+  return false;
+}
+
+bool RegisterAllocator::IsSpillSlotFreeFor(size_t slot, LiveInterval* parent) const {
+  const GrowableArray<LiveInterval*>& intervals = *spill_slots_.Get(slot);
+  for (size_t i = 0, e = intervals.Size(); i < e; ++i) {
+    LiveInterval* other = intervals.Get(i);
+    // The parallel move resolver does not work when a single spill slot needs to be
+    // exchanged with a double spill slot. Requiring a gap between them avoids needing
+    // to exchange these locations at the same lifetime position.
+    bool include_adjacent =
+        NeedTwoSpillSlot(parent->GetType()) || NeedTwoSpillSlot(other->GetType());
+    if (LifetimesIntersect(parent, other, include_adjacent)) {
+      return false;
     }
   }
+  return true;
+}
 
+void RegisterAllocator::AddToSpillSlot(size_t slot, LiveInterval* parent) {
   if (slot == spill_slots_.Size()) {
     // We need a new spill slot.
-    spill_slots_.Add(end);
-    spill_slots_.Add(end);
-  } else if (slot == spill_slots_.Size() - 1) {
-    spill_slots_.Put(slot, end);
-    spill_slots_.Add(end);
-  } else {
-    spill_slots_.Put(slot, end);
-    spill_slots_.Put(slot + 1, end);
+    spill_slots_.Add(new (allocator_) GrowableArray<LiveInterval*>(allocator_, 1));
   }
-
-  parent->SetSpillSlot(slot * kVRegSize);
+  spill_slots_.Get(slot)->Add(parent);
 }
 
-void RegisterAllocator::AllocateOneSpillSlot(LiveInterval* parent, size_t end) {
-  // Find an available spill slot.
+void RegisterAllocator::AllocateTwoSpillSlots(LiveInterval* parent) {
+  // Find two consecutive spill slots whose intervals do not interfere with `parent`.
   size_t slot = 0;
   for (size_t e = spill_slots_.Size(); slot < e; ++slot) {
-    if (spill_slots_.Get(slot) <= parent->GetStart()) {
+    if (IsSpillSlotFreeFor(slot, parent)
+        && (slot == (e - 1) || IsSpillSlotFreeFor(slot + 1, parent))) {
       break;
     }
   }
 
-  if (slot == spill_slots_.Size()) {
-    // We need a new spill slot.
-    spill_slots_.Add(end);
-  } else {
-    spill_slots_.Put(slot, end);
+  AddToSpillSlot(slot, parent);
+  AddToSpillSlot(slot + 1, parent);
+  parent->SetSpillSlot(slot * kVRegSize);
+}
+
+void RegisterAllocator::AllocateOneSpillSlot(LiveInterval* parent) {
+  // Find a spill slot whose intervals do not interfere with `parent`.
+  size_t slot = 0;
+  for (size_t e = spill_slots_.Size(); slot < e; ++slot) {
+    if (IsSpillSlotFreeFor(slot, parent)) {
+      break;
+    }
   }
 
+  AddToSpillSlot(slot, parent);
   parent->SetSpillSlot(slot * kVRegSize);
 }
 
@@ -906,6 +1018,32 @@ static Location FindLocationAt(LiveInterval* interval, size_t position) {
   return ConvertToLocation(current);
 }
 
+void RegisterAllocator::CountSpillsAndReloads(size_t* spills, size_t* reloads) const {
+  *spills = 0;
+  *reloads = 0;
+  for (HLinearOrderIterator it(liveness_); !it.Done(); it.Advance()) {
+    for (HInstructionIterator inst_it(it.Current()->GetInstructions());
+         !inst_it.Done();
+         inst_it.Advance()) {
+      HParallelMove* move = inst_it.Current()->AsParallelMove();
+      if (move == nullptr) {
+        continue;
+      }
+      for (size_t i = 0, e = move->NumMoves(); i < e; ++i) {
+        Location source = move->MoveOperandsAt(i)->GetSource();
+        Location destination = move->MoveOperandsAt(i)->GetDestination();
+        bool source_on_stack = source.IsStackSlot() || source.IsDoubleStackSlot();
+        bool destination_on_stack = destination.IsStackSlot() || destination.IsDoubleStackSlot();
+        if (source.IsRegister() && destination_on_stack) {
+          ++*spills;
+        } else if (source_on_stack && destination.IsRegister()) {
+          ++*reloads;
+        }
+      }
+    }
+  }
+}
+
 void RegisterAllocator::Resolve() {
   codegen_->ComputeFrameSize(spill_slots_.Size());
 
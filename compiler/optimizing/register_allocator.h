@@ -18,6 +18,7 @@
 #define ART_COMPILER_OPTIMIZING_REGISTER_ALLOCATOR_H_
 
 #include "base/macros.h"
+#include "gtest/gtest_prod.h"
 #include "primitive.h"
 #include "utils/growable_array.h"
 
@@ -76,6 +77,10 @@ class RegisterAllocator {
     return spill_slots_.Size();
   }
 
+  // Counts the moves between registers and stack slots inserted in the graph. Moves to a
+  // stack slot are spills, moves from a stack slot are reloads.
+  void CountSpillsAndReloads(size_t* spills, size_t* reloads) const;
+
  private:
   // Main methods of the allocator.
   void LinearScan();
@@ -89,6 +94,16 @@ class RegisterAllocator {
   // Split `interval` at the position `at`. The new interval starts at `at`.
   LiveInterval* Split(LiveInterval* interval, size_t at);
 
+  // Split `interval` at a position between `from` and `to`. If `to` is in loops that do not
+  // contain `from`, the split happens at the header of the outermost one, so that the value
+  // is reloaded before the loop rather than in it. Constants are always split at `to`.
+  LiveInterval* SplitBetween(LiveInterval* interval, size_t from, size_t to);
+
+  // Returns an allocated interval whose register would make the moves of `current`
+  // redundant: a phi input, or the first input of an instruction whose output must be the
+  // same. Returns null if there is none.
+  LiveInterval* FindRegisterHint(LiveInterval* current) const;
+
   // Returns whether `reg` is blocked by the code generator.
   bool IsBlocked(int reg) const;
 
@@ -97,8 +112,12 @@ class RegisterAllocator {
 
   // Allocate a spill slot for the given interval.
   void AllocateSpillSlotFor(LiveInterval* interval);
-  void AllocateOneSpillSlot(LiveInterval* interval, size_t end);
-  void AllocateTwoSpillSlots(LiveInterval* interval, size_t end);
+  void AllocateOneSpillSlot(LiveInterval* interval);
+  void AllocateTwoSpillSlots(LiveInterval* interval);
+
+  // Returns whether `parent` can share spill slot `slot` with the intervals already in it.
+  bool IsSpillSlotFreeFor(size_t slot, LiveInterval* parent) const;
+  void AddToSpillSlot(size_t slot, LiveInterval* parent);
 
   // Connect adjacent siblings within blocks.
   void ConnectSiblings(LiveInterval* interval);
@@ -141,8 +160,9 @@ class RegisterAllocator {
   // where an instruction requires a specific register.
   GrowableArray<LiveInterval*> physical_register_intervals_;
 
-  // The spill slots allocated for live intervals.
-  GrowableArray<size_t> spill_slots_;
+  // The spill slots allocated for live intervals, with the intervals sharing each slot.
+  // Intervals whose lifetimes do not intersect can share a slot.
+  GrowableArray<GrowableArray<LiveInterval*>*> spill_slots_;
 
   // True if processing core registers. False if processing floating
   // point registers.
@@ -157,6 +177,9 @@ class RegisterAllocator {
   // Blocked registers, as decided by the code generator.
   bool* const blocked_registers_;
 
+  FRIEND_TEST(RegisterAllocatorTest, SplitBetweenLoopHeader);
+  FRIEND_TEST(RegisterAllocatorTest, SpillSlotLifetimeHoles);
+
   DISALLOW_COPY_AND_ASSIGN(RegisterAllocator);
 };
 
@@ -318,6 +318,149 @@ TEST(RegisterAllocatorTest, Loop3) {
   ASSERT_EQ(phi_interval->GetRegister(), ret->InputAt(0)->GetLiveInterval()->GetRegister());
 }
 
+TEST(RegisterAllocatorTest, Loop4) {
+  /*
+   * Test the following snippet:
+   *  int a = 0;
+   *  while (a != 5) {
+   *    a++;
+   *  }
+   *  return;
+   *
+   * The phi dies at a++, whose output must be in the register of its first input. The
+   * register allocator should give both the same register, so that neither the add nor the
+   * back edge need a move.
+   */
+
+  const uint16_t data[] = TWO_REGISTERS_CODE_ITEM(
+    Instruction::CONST_4 | 0 | 0,
+    Instruction::CONST_4 | 5 << 12 | 1 << 8,
+    Instruction::IF_EQ | 0 << 8 | 1 << 12, 5,
+    Instruction::ADD_INT_LIT8 | 0 << 8, 1 << 8,
+    Instruction::GOTO | 0xFC00,
+    Instruction::RETURN_VOID);
+
+  ArenaPool pool;
+  ArenaAllocator allocator(&pool);
+  HGraph* graph = BuildSSAGraph(data, &allocator);
+  CodeGenerator* codegen = CodeGenerator::Create(&allocator, graph, kX86);
+  SsaLivenessAnalysis liveness(*graph, codegen);
+  liveness.Analyze();
+  RegisterAllocator register_allocator(&allocator, codegen, liveness);
+  register_allocator.AllocateRegisters();
+  ASSERT_TRUE(register_allocator.Validate(false));
+
+  HPhi* phi = nullptr;
+  for (size_t i = 0, e = graph->GetBlocks().Size(); i < e; ++i) {
+    if (graph->GetBlocks().Get(i)->IsLoopHeader()) {
+      phi = graph->GetBlocks().Get(i)->GetFirstPhi()->AsPhi();
+    }
+  }
+  ASSERT_TRUE(phi != nullptr);
+  HInstruction* loop_update = phi->InputAt(1);
+  ASSERT_TRUE(loop_update->IsAdd());
+
+  LiveInterval* phi_interval = phi->GetLiveInterval();
+  ASSERT_TRUE(phi_interval->HasRegister());
+  ASSERT_EQ(phi_interval->GetRegister(), loop_update->GetLiveInterval()->GetRegister());
+
+  size_t spills;
+  size_t reloads;
+  register_allocator.CountSpillsAndReloads(&spills, &reloads);
+  ASSERT_EQ(0u, spills);
+  ASSERT_EQ(0u, reloads);
+}
+
+TEST(RegisterAllocatorTest, SplitBetweenLoopHeader) {
+  /*
+   * Test the following snippet:
+   *  int a = 0;
+   *  int b = a + 1;
+   *  while (a != b) {
+   *    a += b;
+   *  }
+   *  return;
+   *
+   * b is defined before the loop and used in it. Splitting it before its use in the loop
+   * should happen at the loop header, so that it is reloaded before the loop rather than in
+   * every iteration.
+   */
+
+  const uint16_t data[] = TWO_REGISTERS_CODE_ITEM(
+    Instruction::CONST_4 | 0 | 0,
+    Instruction::ADD_INT_LIT8 | 1 << 8, 1 << 8,
+    Instruction::IF_EQ | 0 << 8 | 1 << 12, 4,
+    Instruction::ADD_INT_2ADDR | 0 << 8 | 1 << 12,
+    Instruction::GOTO | 0xFD00,
+    Instruction::RETURN_VOID);
+
+  ArenaPool pool;
+  ArenaAllocator allocator(&pool);
+  HGraph* graph = BuildSSAGraph(data, &allocator);
+  CodeGenerator* codegen = CodeGenerator::Create(&allocator, graph, kX86);
+  SsaLivenessAnalysis liveness(*graph, codegen);
+  liveness.Analyze();
+  RegisterAllocator register_allocator(&allocator, codegen, liveness);
+
+  HBasicBlock* loop_header = nullptr;
+  for (size_t i = 0, e = graph->GetBlocks().Size(); i < e; ++i) {
+    if (graph->GetBlocks().Get(i)->IsLoopHeader()) {
+      loop_header = graph->GetBlocks().Get(i);
+    }
+  }
+  ASSERT_TRUE(loop_header != nullptr);
+  HInstruction* equal = loop_header->GetLastInstruction()->InputAt(0);
+  ASSERT_TRUE(equal->IsEqual());
+  HInstruction* b = equal->InputAt(1);
+  ASSERT_TRUE(b->IsAdd());
+  ASSERT_NE(b->GetBlock(), loop_header);
+
+  LiveInterval* interval = b->GetLiveInterval();
+  size_t use_position = equal->GetLifetimePosition();
+  ASSERT_LT(interval->GetStart(), loop_header->GetLifetimeStart());
+  LiveInterval* split = register_allocator.SplitBetween(
+      interval, interval->GetStart(), use_position - 1);
+  ASSERT_EQ(interval->GetNextSibling(), split);
+  ASSERT_EQ(split->GetStart(), loop_header->GetLifetimeStart());
+  ASSERT_EQ(interval->GetEnd(), loop_header->GetLifetimeStart());
+}
+
+TEST(RegisterAllocatorTest, SpillSlotLifetimeHoles) {
+  ArenaPool pool;
+  ArenaAllocator allocator(&pool);
+  HGraph* graph = new (&allocator) HGraph(&allocator);
+  CodeGenerator* codegen = CodeGenerator::Create(&allocator, graph, kX86);
+  SsaLivenessAnalysis liveness(*graph, codegen);
+  RegisterAllocator register_allocator(&allocator, codegen, liveness);
+
+  static constexpr size_t ranges1[][2] = {{0, 10}, {20, 30}};
+  LiveInterval* first = BuildInterval(ranges1, arraysize(ranges1), &allocator);
+  register_allocator.AllocateOneSpillSlot(first);
+  ASSERT_EQ(1u, register_allocator.GetNumberOfSpillSlots());
+
+  // An interval in the lifetime hole of the first one shares its slot.
+  static constexpr size_t ranges2[][2] = {{12, 18}};
+  LiveInterval* second = BuildInterval(ranges2, arraysize(ranges2), &allocator);
+  ASSERT_TRUE(register_allocator.IsSpillSlotFreeFor(0, second));
+  register_allocator.AllocateOneSpillSlot(second);
+  ASSERT_EQ(first->GetSpillSlot(), second->GetSpillSlot());
+  ASSERT_EQ(1u, register_allocator.GetNumberOfSpillSlots());
+
+  // An interval overlapping the second range of the first one does not.
+  static constexpr size_t ranges3[][2] = {{15, 25}};
+  LiveInterval* third = BuildInterval(ranges3, arraysize(ranges3), &allocator);
+  ASSERT_FALSE(register_allocator.IsSpillSlotFreeFor(0, third));
+  register_allocator.AllocateOneSpillSlot(third);
+  ASSERT_NE(first->GetSpillSlot(), third->GetSpillSlot());
+  ASSERT_EQ(2u, register_allocator.GetNumberOfSpillSlots());
+
+  // A long filling the rest of the hole only touches the other intervals, but single and
+  // double slots need a gap between them.
+  LiveInterval* wide = new (&allocator) LiveInterval(&allocator, Primitive::kPrimLong);
+  wide->AddRange(18, 20);
+  ASSERT_FALSE(register_allocator.IsSpillSlotFreeFor(0, wide));
+}
+
 TEST(RegisterAllocatorTest, FirstRegisterUse) {
   const uint16_t data[] = THREE_REGISTERS_CODE_ITEM(
     Instruction::CONST_4 | 0 | 0,
@@ -0,0 +1,256 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "scalar_replacement.h"
+
+#include "class_linker.h"
+#include "driver/compiler_driver.h"
+#include "driver/dex_compilation_unit.h"
+#include "mirror/class-inl.h"
+#include "mirror/dex_cache.h"
+#include "scoped_thread_state_change.h"
+#include "thread.h"
+
+namespace art {
+
+static bool Contains(const GrowableArray<HInstruction*>& instructions, HInstruction* instruction) {
+  for (size_t i = 0; i < instructions.Size(); i++) {
+    if (instructions.Get(i) == instruction) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Returns whether `block` is `start`, or is only reached from `start` through blocks with
+// a single predecessor. Instructions of such blocks execute at most once per execution
+// of `start`, after it.
+static bool IsInSinglePredecessorChain(HBasicBlock* block, HBasicBlock* start) {
+  while (block != start) {
+    if (block->GetPredecessors().Size() != 1) {
+      return false;
+    }
+    block = block->GetPredecessors().Get(0);
+  }
+  return true;
+}
+
+// Returns the last set of the field of `get` into the object of `aliases` that executes
+// before `get`, or null if the field was not set since the allocation, the first alias.
+static HInstanceFieldSet* FindLastSet(HInstanceFieldGet* get,
+                                      const GrowableArray<HInstruction*>& aliases) {
+  HInstruction* allocation = aliases.Get(0);
+  size_t offset = get->GetFieldOffset().SizeValue();
+  HBasicBlock* block = get->GetBlock();
+  for (HInstruction* current = get->GetPrevious(); current != allocation;) {
+    if (current == nullptr) {
+      block = block->GetPredecessors().Get(0);
+      current = block->GetLastInstruction();
+      continue;
+    }
+    HInstanceFieldSet* set = current->AsInstanceFieldSet();
+    if (set != nullptr
+        && set->GetFieldOffset().SizeValue() == offset
+        && Contains(aliases, set->InputAt(0))) {
+      return set;
+    }
+    current = current->GetPrevious();
+  }
+  return nullptr;
+}
+
+// Returns whether a field of `type` reads back `value` unchanged. Sets of the narrower
+// types only store the low bits of the value.
+static bool IsStoredUnchanged(HInstruction* value, Primitive::Type type) {
+  if (value->GetType() == type) {
+    return true;
+  }
+  HIntConstant* constant = value->AsIntConstant();
+  if (constant == nullptr) {
+    return false;
+  }
+  int32_t v = constant->GetValue();
+  switch (type) {
+    case Primitive::kPrimBoolean:
+      return v == 0 || v == 1;
+    case Primitive::kPrimByte:
+      return v == static_cast<int8_t>(v);
+    case Primitive::kPrimChar:
+      return v == static_cast<uint16_t>(v);
+    case Primitive::kPrimShort:
+      return v == static_cast<int16_t>(v);
+    case Primitive::kPrimInt:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool ScalarReplacement::MayEliminateAllocations(const HGraph& graph) {
+  bool has_allocations = false;
+  for (size_t i = 0, e = graph.GetBlocks().Size(); i < e; ++i) {
+    for (HInstructionIterator it(graph.GetBlocks().Get(i)->GetInstructions());
+         !it.Done();
+         it.Advance()) {
+      HInstruction* current = it.Current();
+      if (current->IsNewInstance()) {
+        has_allocations = true;
+      } else if (current->NeedsEnvironment() && !current->IsNullCheck()) {
+        return false;
+      }
+    }
+  }
+  return has_allocations;
+}
+
+bool ScalarReplacement::CanRemoveAllocation(HNewInstance* new_instance) const {
+  // compiler_driver_ is null only when unit testing.
+  if (compiler_driver_ == nullptr) {
+    return true;
+  }
+  const DexFile& dex_file = *dex_compilation_unit_->GetDexFile();
+  uint16_t type_index = new_instance->GetTypeIndex();
+  if (!compiler_driver_->CanAccessInstantiableTypeWithoutChecks(
+          dex_compilation_unit_->GetDexMethodIndex(), dex_file, type_index)) {
+    return false;
+  }
+  ScopedObjectAccess soa(Thread::Current());
+  mirror::Class* klass =
+      dex_compilation_unit_->GetClassLinker()->FindDexCache(dex_file)->GetResolvedType(type_index);
+  if (klass == nullptr || klass->IsFinalizable()) {
+    return false;
+  }
+  // The allocation initializes the class and its super classes, which must have no
+  // visible effect.
+  for (mirror::Class* current = klass; current != nullptr; current = current->GetSuperClass()) {
+    if (current->IsErroneous()
+        || (!current->IsInitialized() && current->FindClassInitializer() != nullptr)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ScalarReplacement::TryEliminate(HNewInstance* new_instance) {
+  ArenaAllocator* arena = graph_->GetArena();
+  HBasicBlock* allocation_block = new_instance->GetBlock();
+
+  // The allocated object, then the null checks of it. Their other users are the field
+  // accesses: the object escapes when it is the value of a set, or used by any other
+  // instruction.
+  GrowableArray<HInstruction*> aliases(arena, 4);
+  GrowableArray<HInstruction*> accesses(arena, 4);
+  aliases.Add(new_instance);
+  for (size_t i = 0; i < aliases.Size(); i++) {
+    for (HUseIterator<HInstruction> it(aliases.Get(i)->GetUses()); !it.Done(); it.Advance()) {
+      HInstruction* user = it.Current()->GetUser();
+      if (it.Current()->GetIndex() != 0
+          || !IsInSinglePredecessorChain(user->GetBlock(), allocation_block)) {
+        return false;
+      }
+      if (user->IsNullCheck()) {
+        aliases.Add(user);
+      } else if (user->IsInstanceFieldGet() || user->IsInstanceFieldSet()) {
+        accesses.Add(user);
+      } else {
+        return false;
+      }
+    }
+  }
+
+  // The set each get reads the value of, or null when the get reads the default value.
+  GrowableArray<HInstanceFieldSet*> sources(arena, accesses.Size());
+  for (size_t i = 0; i < accesses.Size(); i++) {
+    HInstanceFieldGet* get = accesses.Get(i)->AsInstanceFieldGet();
+    HInstanceFieldSet* source = nullptr;
+    if (get != nullptr) {
+      source = FindLastSet(get, aliases);
+      if (source == nullptr) {
+        // There is no null constant.
+        if (get->GetType() == Primitive::kPrimNot) {
+          return false;
+        }
+      } else if (!IsStoredUnchanged(source->InputAt(1), get->GetType())) {
+        return false;
+      }
+    }
+    sources.Add(source);
+  }
+
+  // The object does not escape. Replace the gets by the values, then remove the accesses
+  // and the aliases, users first. The value of a set is read when replacing, as it may be
+  // a get replaced before.
+  for (size_t i = 0; i < accesses.Size(); i++) {
+    HInstruction* access = accesses.Get(i);
+    if (access->IsInstanceFieldGet()) {
+      HInstanceFieldSet* source = sources.Get(i);
+      access->ReplaceWith(source == nullptr ? GetZero(access->GetType()) : source->InputAt(1));
+    }
+  }
+  for (size_t i = 0; i < accesses.Size(); i++) {
+    HInstruction* access = accesses.Get(i);
+    access->GetBlock()->RemoveInstruction(access);
+  }
+  for (size_t i = 0; i < aliases.Size(); i++) {
+    aliases.Get(i)->ClearEnvironmentUses();
+  }
+  for (size_t i = aliases.Size(); i > 0; i--) {
+    HInstruction* alias = aliases.Get(i - 1);
+    alias->GetBlock()->RemoveInstruction(alias);
+  }
+  return true;
+}
+
+HInstruction* ScalarReplacement::GetZero(Primitive::Type type) {
+  HBasicBlock* entry_block = graph_->GetEntryBlock();
+  if (type == Primitive::kPrimLong) {
+    if (long_zero_ == nullptr) {
+      long_zero_ = new (graph_->GetArena()) HLongConstant(0);
+      entry_block->InsertInstructionBefore(long_zero_, entry_block->GetLastInstruction());
+    }
+    return long_zero_;
+  }
+  if (int_zero_ == nullptr) {
+    int_zero_ = new (graph_->GetArena()) HIntConstant(0);
+    entry_block->InsertInstructionBefore(int_zero_, entry_block->GetLastInstruction());
+  }
+  return int_zero_;
+}
+
+void ScalarReplacement::Run() {
+  // Collect the allocations first, as eliminating one removes instructions.
+  GrowableArray<HNewInstance*> allocations(graph_->GetArena(), 4);
+  for (HReversePostOrderIterator it(*graph_); !it.Done(); it.Advance()) {
+    for (HInstructionIterator inst_it(it.Current()->GetInstructions());
+         !inst_it.Done();
+         inst_it.Advance()) {
+      HNewInstance* new_instance = inst_it.Current()->AsNewInstance();
+      if (new_instance != nullptr) {
+        allocations.Add(new_instance);
+      }
+    }
+  }
+
+  number_of_allocations_ = allocations.Size();
+  for (size_t i = 0; i < allocations.Size(); i++) {
+    HNewInstance* new_instance = allocations.Get(i);
+    if (CanRemoveAllocation(new_instance) && TryEliminate(new_instance)) {
+      number_of_eliminated_allocations_++;
+    }
+  }
+}
+
+}  // namespace art
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_COMPILER_OPTIMIZING_SCALAR_REPLACEMENT_H_
+#define ART_COMPILER_OPTIMIZING_SCALAR_REPLACEMENT_H_
+
+#include "nodes.h"
+
+namespace art {
+
+class CompilerDriver;
+class DexCompilationUnit;
+
+/**
+ * Optimization phase that removes the allocations that do not escape the method, and
+ * replaces the fields of the allocated objects by the values stored into them. An
+ * allocation does not escape when it is only null checked and used as the object of
+ * field accesses, which all execute after the allocation without a merge in the control
+ * flow, so that the value stored into a field by the last preceding set is known.
+ *
+ * The code generators do not support deoptimization, and the pass does not keep a
+ * description of the removed objects: environments that referred to them see a null
+ * value. Methods where the pass removes all the instructions that need an environment
+ * are then compiled with the register allocator.
+ */
+class ScalarReplacement : public ValueObject {
+ public:
+  // `compiler_driver` and `dex_compilation_unit` are null only when unit testing, in
+  // which case all the allocated classes are considered to have no side effects.
+  ScalarReplacement(HGraph* graph,
+                    CompilerDriver* compiler_driver,
+                    const DexCompilationUnit* dex_compilation_unit)
+      : graph_(graph),
+        compiler_driver_(compiler_driver),
+        dex_compilation_unit_(dex_compilation_unit),
+        int_zero_(nullptr),
+        long_zero_(nullptr),
+        number_of_allocations_(0),
+        number_of_eliminated_allocations_(0) {}
+
+  void Run();
+
+  size_t GetNumberOfAllocations() const { return number_of_allocations_; }
+  size_t GetNumberOfEliminatedAllocations() const { return number_of_eliminated_allocations_; }
+
+  // Returns whether the pass may make `graph`, which is not in SSA form yet, compilable
+  // with the register allocator: the graph has allocations, and they and null checks
+  // are the only instructions that need an environment.
+  static bool MayEliminateAllocations(const HGraph& graph);
+
+ private:
+  // Returns whether the allocation of `new_instance` can be removed when its object does
+  // not escape: the class is accessible, instantiable and not finalizable, and it is
+  // initialized or has no class initializer.
+  bool CanRemoveAllocation(HNewInstance* new_instance) const;
+
+  // Removes `new_instance` and its field accesses if its object does not escape.
+  bool TryEliminate(HNewInstance* new_instance);
+
+  // The value a field get of `type` returns when no set precedes it.
+  HInstruction* GetZero(Primitive::Type type);
+
+  HGraph* const graph_;
+  CompilerDriver* const compiler_driver_;
+  const DexCompilationUnit* const dex_compilation_unit_;
+  HIntConstant* int_zero_;
+  HLongConstant* long_zero_;
+  size_t number_of_allocations_;
+  size_t number_of_eliminated_allocations_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScalarReplacement);
+};
+
+}  // namespace art
+
+#endif  // ART_COMPILER_OPTIMIZING_SCALAR_REPLACEMENT_H_
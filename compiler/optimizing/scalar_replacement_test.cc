@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "nodes.h"
+#include "scalar_replacement.h"
+#include "utils/arena_allocator.h"
+
+#include "gtest/gtest.h"
+
+namespace art {
+
+static constexpr size_t kFirstFieldOffset = 8;
+static constexpr size_t kSecondFieldOffset = 12;
+
+static HBasicBlock* CreateBlock(HGraph* graph, ArenaAllocator* allocator) {
+  HBasicBlock* block = new (allocator) HBasicBlock(graph);
+  graph->AddBlock(block);
+  return block;
+}
+
+// Creates a graph whose entry block defines an int parameter and a boolean parameter, and
+// jumps to the returned block.
+static HBasicBlock* CreateEntryBlock(HGraph* graph,
+                                     ArenaAllocator* allocator,
+                                     HInstruction** parameter,
+                                     HInstruction** condition) {
+  HBasicBlock* entry = CreateBlock(graph, allocator);
+  graph->SetEntryBlock(entry);
+  *parameter = new (allocator) HParameterValue(0, Primitive::kPrimInt);
+  *condition = new (allocator) HParameterValue(1, Primitive::kPrimBoolean);
+  entry->AddInstruction(*parameter);
+  entry->AddInstruction(*condition);
+  entry->AddInstruction(new (allocator) HGoto());
+  HBasicBlock* block = CreateBlock(graph, allocator);
+  entry->AddSuccessor(block);
+  return block;
+}
+
+// Ends `block` with a return of `value`, and adds the exit block.
+static void AddReturn(HGraph* graph,
+                      ArenaAllocator* allocator,
+                      HBasicBlock* block,
+                      HInstruction* value) {
+  block->AddInstruction(new (allocator) HReturn(value));
+  HBasicBlock* exit = CreateBlock(graph, allocator);
+  block->AddSuccessor(exit);
+  exit->AddInstruction(new (allocator) HExit());
+  graph->SetExitBlock(exit);
+}
+
+static size_t RunScalarReplacement(HGraph* graph) {
+  graph->BuildDominatorTree();
+  ScalarReplacement scalar_replacement(graph, nullptr, nullptr);
+  scalar_replacement.Run();
+  return scalar_replacement.GetNumberOfEliminatedAllocations();
+}
+
+TEST(ScalarReplacementTest, FieldsReplaced) {
+  ArenaPool pool;
+  ArenaAllocator allocator(&pool);
+
+  HGraph* graph = new (&allocator) HGraph(&allocator);
+  HInstruction* parameter;
+  HInstruction* condition;
+  HBasicBlock* block = CreateEntryBlock(graph, &allocator, &parameter, &condition);
+
+  HInstruction* new_instance = new (&allocator) HNewInstance(0, 0);
+  HInstruction* set_check = new (&allocator) HNullCheck(new_instance, 0);
+  HInstruction* get_check = new (&allocator) HNullCheck(new_instance, 0);
+  HInstruction* first_get = new (&allocator) HInstanceFieldGet(
+      get_check, Primitive::kPrimInt, MemberOffset(kFirstFieldOffset));
+  HInstruction* second_get = new (&allocator) HInstanceFieldGet(
+      get_check, Primitive::kPrimInt, MemberOffset(kSecondFieldOffset));
+  HInstruction* sum = new (&allocator) HAdd(Primitive::kPrimInt, first_get, second_get);
+  block->AddInstruction(new_instance);
+  block->AddInstruction(set_check);
+  block->AddInstruction(new (&allocator) HInstanceFieldSet(
+      set_check, parameter, MemberOffset(kFirstFieldOffset)));
+  block->AddInstruction(get_check);
+  block->AddInstruction(first_get);
+  block->AddInstruction(second_get);
+  block->AddInstruction(sum);
+  AddReturn(graph, &allocator, block, sum);
+
+  // The environment of the null check refers to the allocated object.
+  GrowableArray<HInstruction*> locals(&allocator, 2);
+  locals.Add(new_instance);
+  locals.Add(parameter);
+  HEnvironment* environment = new (&allocator) HEnvironment(&allocator, locals.Size());
+  environment->Populate(locals);
+  get_check->SetEnvironment(environment);
+
+  ASSERT_EQ(RunScalarReplacement(graph), 1u);
+
+  // Only the sum of the stored value and of the default value of the other field remains.
+  ASSERT_EQ(block->GetFirstInstruction(), sum);
+  ASSERT_EQ(sum->InputAt(0), parameter);
+  ASSERT_TRUE(sum->InputAt(1)->IsIntConstant());
+  ASSERT_EQ(sum->InputAt(1)->AsIntConstant()->GetValue(), 0);
+  ASSERT_EQ(sum->InputAt(1)->GetBlock(), graph->GetEntryBlock());
+  ASSERT_EQ(new_instance->GetBlock(), nullptr);
+  ASSERT_FALSE(parameter->HasEnvironmentUses());
+}
+
+TEST(ScalarReplacementTest, ReturnedObjectEscapes) {
+  ArenaPool pool;
+  ArenaAllocator allocator(&pool);
+
+  HGraph* graph = new (&allocator) HGraph(&allocator);
+  HInstruction* parameter;
+  HInstruction* condition;
+  HBasicBlock* block = CreateEntryBlock(graph, &allocator, &parameter, &condition);
+
+  HInstruction* new_instance = new (&allocator) HNewInstance(0, 0);
+  HInstruction* null_check = new (&allocator) HNullCheck(new_instance, 0);
+  HInstruction* set = new (&allocator) HInstanceFieldSet(
+      null_check, parameter, MemberOffset(kFirstFieldOffset));
+  block->AddInstruction(new_instance);
+  block->AddInstruction(null_check);
+  block->AddInstruction(set);
+  AddReturn(graph, &allocator, block, new_instance);
+
+  ASSERT_EQ(RunScalarReplacement(graph), 0u);
+  ASSERT_EQ(new_instance->GetBlock(), block);
+  ASSERT_EQ(set->GetBlock(), block);
+}
+
+TEST(ScalarReplacementTest, StoredObjectEscapes) {
+  ArenaPool pool;
+  ArenaAllocator allocator(&pool);
+
+  HGraph* graph = new (&allocator) HGraph(&allocator);
+  HInstruction* parameter;
+  HInstruction* condition;
+  HBasicBlock* block = CreateEntryBlock(graph, &allocator, &parameter, &condition);
+
+  // The first object is stored into the second one, which escapes.
+  HInstruction* first = new (&allocator) HNewInstance(0, 0);
+  HInstruction* second = new (&allocator) HNewInstance(0, 0);
+  HInstruction* null_check = new (&allocator) HNullCheck(second, 0);
+  block->AddInstruction(first);
+  block->AddInstruction(second);
+  block->AddInstruction(null_check);
+  block->AddInstruction(new (&allocator) HInstanceFieldSet(
+      null_check, first, MemberOffset(kFirstFieldOffset)));
+  AddReturn(graph, &allocator, block, second);
+
+  ASSERT_EQ(RunScalarReplacement(graph), 0u);
+  ASSERT_EQ(first->GetBlock(), block);
+  ASSERT_EQ(second->GetBlock(), block);
+}
+
+TEST(ScalarReplacementTest, MergeNotSupported) {
+  ArenaPool pool;
+  ArenaAllocator allocator(&pool);
+
+  HGraph* graph = new (&allocator) HGraph(&allocator);
+  HInstruction* parameter;
+  HInstruction* condition;
+  HBasicBlock* block = CreateEntryBlock(graph, &allocator, &parameter, &condition);
+
+  // The field is only set in one branch, and read after the branches merge.
+  HInstruction* new_instance = new (&allocator) HNewInstance(0, 0);
+  block->AddInstruction(new_instance);
+  block->AddInstruction(new (&allocator) HIf(condition));
+  HBasicBlock* then_block = CreateBlock(graph, &allocator);
+  HBasicBlock* join = CreateBlock(graph, &allocator);
+  block->AddSuccessor(then_block);
+  block->AddSuccessor(join);
+  then_block->AddSuccessor(join);
+  HInstruction* set_check = new (&allocator) HNullCheck(new_instance, 0);
+  then_block->AddInstruction(set_check);
+  then_block->AddInstruction(new (&allocator) HInstanceFieldSet(
+      set_check, parameter, MemberOffset(kFirstFieldOffset)));
+  then_block->AddInstruction(new (&allocator) HGoto());
+  HInstruction* get_check = new (&allocator) HNullCheck(new_instance, 0);
+  HInstruction* get = new (&allocator) HInstanceFieldGet(
+      get_check, Primitive::kPrimInt, MemberOffset(kFirstFieldOffset));
+  join->AddInstruction(get_check);
+  join->AddInstruction(get);
+  AddReturn(graph, &allocator, join, get);
+
+  ASSERT_EQ(RunScalarReplacement(graph), 0u);
+  ASSERT_EQ(new_instance->GetBlock(), block);
+  ASSERT_EQ(get->GetBlock(), join);
+}
+
+}  // namespace art
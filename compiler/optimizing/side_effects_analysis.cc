@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "side_effects_analysis.h"
+
+namespace art {
+
+void SideEffectsAnalysis::Run() {
+  size_t number_of_blocks = graph_->GetBlocks().Size();
+  block_effects_.SetSize(number_of_blocks);
+  loop_effects_.SetSize(number_of_blocks);
+  for (size_t i = 0; i < number_of_blocks; ++i) {
+    block_effects_.Put(i, SideEffects::None());
+    loop_effects_.Put(i, SideEffects::None());
+  }
+
+  for (HReversePostOrderIterator it(*graph_); !it.Done(); it.Advance()) {
+    HBasicBlock* block = it.Current();
+    SideEffects effects = SideEffects::None();
+    for (HInstructionIterator it(block->GetInstructions()); !it.Done(); it.Advance()) {
+      effects = effects.Union(it.Current()->GetSideEffects());
+    }
+    block_effects_.Put(block->GetBlockId(), effects);
+
+    if (!block->IsInLoop()) {
+      continue;
+    }
+    // Add the effects of the block to all the loops containing it.
+    for (HReversePostOrderIterator loop_it(*graph_); !loop_it.Done(); loop_it.Advance()) {
+      HBasicBlock* header = loop_it.Current();
+      if (header->IsLoopHeader() && header->GetLoopInformation()->Contains(*block)) {
+        int id = header->GetBlockId();
+        loop_effects_.Put(id, loop_effects_.Get(id).Union(effects));
+      }
+    }
+  }
+}
+
+SideEffects SideEffectsAnalysis::GetBlockEffects(HBasicBlock* block) const {
+  return block_effects_.Get(block->GetBlockId());
+}
+
+SideEffects SideEffectsAnalysis::GetLoopEffects(HBasicBlock* block) const {
+  DCHECK(block->IsLoopHeader());
+  return loop_effects_.Get(block->GetBlockId());
+}
+
+}  // namespace art
@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_COMPILER_OPTIMIZING_SIDE_EFFECTS_ANALYSIS_H_
+#define ART_COMPILER_OPTIMIZING_SIDE_EFFECTS_ANALYSIS_H_
+
+#include "nodes.h"
+
+namespace art {
+
+/**
+ * Computes the side effects of the blocks and the loops of a graph. The natural
+ * loops of the graph must have been found.
+ */
+class SideEffectsAnalysis : public ValueObject {
+ public:
+  explicit SideEffectsAnalysis(HGraph* graph)
+      : graph_(graph),
+        block_effects_(graph->GetArena(), graph->GetBlocks().Size()),
+        loop_effects_(graph->GetArena(), graph->GetBlocks().Size()) {}
+
+  void Run();
+
+  // Returns the side effects of the instructions of `block`.
+  SideEffects GetBlockEffects(HBasicBlock* block) const;
+
+  // Returns the side effects of the instructions of the loop whose header is `block`,
+  // including the instructions of its inner loops.
+  SideEffects GetLoopEffects(HBasicBlock* block) const;
+
+ private:
+  HGraph* const graph_;
+
+  // Side effects of the blocks and the loops, indexed by block id. Only the entries of
+  // loop headers are meaningful in `loop_effects_`.
+  GrowableArray<SideEffects> block_effects_;
+  GrowableArray<SideEffects> loop_effects_;
+
+  DISALLOW_COPY_AND_ASSIGN(SideEffectsAnalysis);
+};
+
+}  // namespace art
+
+#endif  // ART_COMPILER_OPTIMIZING_SIDE_EFFECTS_ANALYSIS_H_
@@ -48,6 +48,7 @@ const char* const ArenaAllocatorStatsImpl<kCount>::kAllocNames[] = {
   "Data       ",
   "Preds      ",
   "STL        ",
+  "RefMaps    ",
 };
 
 template <bool kCount>
@@ -62,6 +63,14 @@ void ArenaAllocatorStatsImpl<kCount>::Copy(const ArenaAllocatorStatsImpl& other)
   std::copy(other.alloc_stats_, other.alloc_stats_ + arraysize(alloc_stats_), alloc_stats_);
 }
 
+template <bool kCount>
+void ArenaAllocatorStatsImpl<kCount>::Merge(const ArenaAllocatorStatsImpl& other) {
+  num_allocations_ += other.num_allocations_;
+  for (size_t i = 0; i != arraysize(alloc_stats_); ++i) {
+    alloc_stats_[i] += other.alloc_stats_[i];
+  }
+}
+
 template <bool kCount>
 void ArenaAllocatorStatsImpl<kCount>::RecordAlloc(size_t bytes, ArenaAllocKind kind) {
   alloc_stats_[kind] += bytes;
@@ -79,6 +88,11 @@ size_t ArenaAllocatorStatsImpl<kCount>::BytesAllocated() const {
   return std::accumulate(alloc_stats_, alloc_stats_ + arraysize(alloc_stats_), init);
 }
 
+template <bool kCount>
+size_t ArenaAllocatorStatsImpl<kCount>::BytesAllocatedByKind(ArenaAllocKind kind) const {
+  return alloc_stats_[kind];
+}
+
 template <bool kCount>
 void ArenaAllocatorStatsImpl<kCount>::Dump(std::ostream& os, const Arena* first,
                                            ssize_t lost_bytes_adjustment) const {
@@ -147,39 +161,96 @@ void Arena::Reset() {
   }
 }
 
-ArenaPool::ArenaPool()
-    : lock_("Arena pool lock"),
-      free_arenas_(nullptr) {
+constexpr size_t ArenaPool::kNumThreadCaches;
+constexpr size_t ArenaPool::kMaxArenasPerThreadCache;
+constexpr size_t ArenaPool::kNoReleaseWatermark;
+
+ArenaPool::ThreadCache::ThreadCache()
+    : lock("Arena pool thread cache lock"),
+      free_arenas(nullptr),
+      num_free_arenas(0u) {
 }
 
-ArenaPool::~ArenaPool() {
-  while (free_arenas_ != nullptr) {
-    auto* arena = free_arenas_;
-    free_arenas_ = free_arenas_->next_;
+ArenaPool::ArenaPool(size_t release_watermark)
+    : release_watermark_(release_watermark),
+      bytes_in_use_(0u),
+      peak_bytes_in_use_(0u),
+      lock_("Arena pool lock"),
+      free_arenas_(nullptr),
+      free_resident_bytes_(0u),
+      released_arenas_(nullptr) {
+}
+
+void ArenaPool::DeleteArenaChain(Arena* first) {
+  while (first != nullptr) {
+    Arena* arena = first;
+    first = first->next_;
     delete arena;
   }
 }
 
+ArenaPool::~ArenaPool() {
+  for (ThreadCache& cache : thread_caches_) {
+    DeleteArenaChain(cache.free_arenas);
+  }
+  DeleteArenaChain(free_arenas_);
+  DeleteArenaChain(released_arenas_);
+}
+
+ArenaPool::ThreadCache* ArenaPool::GetThreadCache(Thread* self) {
+  // Threads outside of the runtime, as in unit tests, share the first cache.
+  size_t index = (self != nullptr) ? self->GetThreadId() % kNumThreadCaches : 0u;
+  return &thread_caches_[index];
+}
+
 Arena* ArenaPool::AllocArena(size_t size) {
   Thread* self = Thread::Current();
   Arena* ret = nullptr;
   {
+    ThreadCache* cache = GetThreadCache(self);
+    MutexLock lock(self, cache->lock);
+    if (cache->free_arenas != nullptr && LIKELY(cache->free_arenas->Size() >= size)) {
+      ret = cache->free_arenas;
+      cache->free_arenas = ret->next_;
+      --cache->num_free_arenas;
+    }
+  }
+  if (ret == nullptr) {
     MutexLock lock(self, lock_);
     if (free_arenas_ != nullptr && LIKELY(free_arenas_->Size() >= size)) {
       ret = free_arenas_;
-      free_arenas_ = free_arenas_->next_;
+      free_arenas_ = ret->next_;
+      free_resident_bytes_ -= ret->Size();
+    } else if (released_arenas_ != nullptr && LIKELY(released_arenas_->Size() >= size)) {
+      ret = released_arenas_;
+      released_arenas_ = ret->next_;
     }
   }
   if (ret == nullptr) {
     ret = new Arena(size);
   }
   ret->Reset();
+  ret->next_ = nullptr;
+  size_t bytes_in_use =
+      bytes_in_use_.FetchAndAddSequentiallyConsistent(ret->Size()) + ret->Size();
+  size_t peak = peak_bytes_in_use_.LoadRelaxed();
+  while (bytes_in_use > peak &&
+         !peak_bytes_in_use_.CompareExchangeWeakRelaxed(peak, bytes_in_use)) {
+    peak = peak_bytes_in_use_.LoadRelaxed();
+  }
   return ret;
 }
 
 size_t ArenaPool::GetBytesAllocated() const {
   size_t total = 0;
-  MutexLock lock(Thread::Current(), lock_);
+  Thread* self = Thread::Current();
+  for (const ThreadCache& cache : thread_caches_) {
+    MutexLock lock(self, cache.lock);
+    for (Arena* arena = cache.free_arenas; arena != nullptr; arena = arena->next_) {
+      total += arena->GetBytesAllocated();
+    }
+  }
+  MutexLock lock(self, lock_);
   for (Arena* arena = free_arenas_; arena != nullptr; arena = arena->next_) {
     total += arena->GetBytesAllocated();
   }
@@ -192,22 +263,96 @@ void ArenaPool::FreeArenaChain(Arena* first) {
       VALGRIND_MAKE_MEM_UNDEFINED(arena->memory_, arena->bytes_allocated_);
     }
   }
+  if (first == nullptr) {
+    return;
+  }
+  size_t freed_bytes = 0u;
+  for (Arena* arena = first; arena != nullptr; arena = arena->next_) {
+    freed_bytes += arena->Size();
+  }
+  bytes_in_use_.FetchAndSubSequentiallyConsistent(freed_bytes);
+
+  // Fill the thread cache first, the two locks are never held together.
+  Thread* self = Thread::Current();
+  {
+    ThreadCache* cache = GetThreadCache(self);
+    MutexLock lock(self, cache->lock);
+    while (first != nullptr && cache->num_free_arenas < kMaxArenasPerThreadCache) {
+      Arena* arena = first;
+      first = first->next_;
+      arena->next_ = cache->free_arenas;
+      cache->free_arenas = arena;
+      ++cache->num_free_arenas;
+    }
+  }
   if (first != nullptr) {
     Arena* last = first;
+    size_t overflow_bytes = first->Size();
     while (last->next_ != nullptr) {
       last = last->next_;
+      overflow_bytes += last->Size();
     }
-    Thread* self = Thread::Current();
     MutexLock lock(self, lock_);
     last->next_ = free_arenas_;
     free_arenas_ = first;
+    free_resident_bytes_ += overflow_bytes;
+    if (free_resident_bytes_ > release_watermark_) {
+      ReleaseFreeArenasLocked();
+    }
+  }
+}
+
+void ArenaPool::ReleaseFreeArenasLocked() {
+  // Keep the most recently freed arenas, they are the most likely to be in the caches.
+  size_t kept_bytes = 0u;
+  Arena** link = &free_arenas_;
+  while (*link != nullptr && kept_bytes + (*link)->Size() <= release_watermark_) {
+    kept_bytes += (*link)->Size();
+    link = &(*link)->next_;
+  }
+  Arena* arena = *link;
+  *link = nullptr;
+  free_resident_bytes_ = kept_bytes;
+  while (arena != nullptr) {
+    Arena* next = arena->next_;
+    if (arena->map_ != nullptr) {
+      arena->map_->MadviseDontNeedAndZero();
+      arena->bytes_allocated_ = 0u;
+      arena->next_ = released_arenas_;
+      released_arenas_ = arena;
+    } else {
+      delete arena;
+    }
+    arena = next;
+  }
+}
+
+void ArenaPool::MergeStats(const ArenaAllocatorStats& stats) {
+  if (kArenaAllocatorCountAllocations) {
+    MutexLock lock(Thread::Current(), lock_);
+    stats_.Merge(stats);
   }
 }
 
+void ArenaPool::DumpStats(std::ostream& os) const {
+  os << "ArenaPool stats: in use: " << GetBytesInUse() << ", peak: " << GetPeakBytesInUse()
+     << "\n";
+  MutexLock lock(Thread::Current(), lock_);
+  stats_.Dump(os, nullptr, 0);
+}
+
 size_t ArenaAllocator::BytesAllocated() const {
   return ArenaAllocatorStats::BytesAllocated();
 }
 
+size_t ArenaAllocator::BytesReserved() const {
+  size_t total = 0u;
+  for (const Arena* arena = arena_head_; arena != nullptr; arena = arena->next_) {
+    total += arena->Size();
+  }
+  return total;
+}
+
 ArenaAllocator::ArenaAllocator(ArenaPool* pool)
   : pool_(pool),
     begin_(nullptr),
@@ -248,6 +393,7 @@ void* ArenaAllocator::AllocValgrind(size_t bytes, ArenaAllocKind kind) {
 ArenaAllocator::~ArenaAllocator() {
   // Reclaim all the arenas by giving them back to the thread pool.
   UpdateBytesAllocated();
+  pool_->MergeStats(GetStats());
   pool_->FreeArenaChain(arena_head_);
 }
 
@@ -20,6 +20,7 @@
 #include <stdint.h>
 #include <stddef.h>
 
+#include "atomic.h"
 #include "base/macros.h"
 #include "base/mutex.h"
 #include "mem_map.h"
@@ -72,9 +73,11 @@ class ArenaAllocatorStatsImpl<false> {
   ArenaAllocatorStatsImpl& operator = (const ArenaAllocatorStatsImpl& other) = delete;
 
   void Copy(const ArenaAllocatorStatsImpl& other) { UNUSED(other); }
+  void Merge(const ArenaAllocatorStatsImpl& other) { UNUSED(other); }
   void RecordAlloc(size_t bytes, ArenaAllocKind kind) { UNUSED(bytes); UNUSED(kind); }
   size_t NumAllocations() const { return 0u; }
   size_t BytesAllocated() const { return 0u; }
+  size_t BytesAllocatedByKind(ArenaAllocKind kind) const { UNUSED(kind); return 0u; }
   void Dump(std::ostream& os, const Arena* first, ssize_t lost_bytes_adjustment) const {
     UNUSED(os); UNUSED(first); UNUSED(lost_bytes_adjustment);
   }
@@ -88,9 +91,11 @@ class ArenaAllocatorStatsImpl {
   ArenaAllocatorStatsImpl& operator = (const ArenaAllocatorStatsImpl& other) = delete;
 
   void Copy(const ArenaAllocatorStatsImpl& other);
+  void Merge(const ArenaAllocatorStatsImpl& other);
   void RecordAlloc(size_t bytes, ArenaAllocKind kind);
   size_t NumAllocations() const;
   size_t BytesAllocated() const;
+  size_t BytesAllocatedByKind(ArenaAllocKind kind) const;
   void Dump(std::ostream& os, const Arena* first, ssize_t lost_bytes_adjustment) const;
 
  private:
@@ -143,17 +148,73 @@ class Arena {
   DISALLOW_COPY_AND_ASSIGN(Arena);
 };
 
+// Pool of arenas shared by the compiler threads.
+//
+// Freed arenas go to a small cache selected by the thread id, so a compiler thread usually gets
+// back the arenas it has just released without contending with the other threads. Arenas that
+// do not fit in the cache overflow to a global free list. When a release watermark is set, the
+// global list keeps at most that many bytes resident: arenas beyond it are madvised away when
+// memory mapped, or freed when malloc'ed.
 class ArenaPool {
  public:
-  ArenaPool();
+  // Number of thread caches, threads whose ids collide share a cache.
+  static constexpr size_t kNumThreadCaches = 16;
+  // Maximum number of arenas kept in one thread cache.
+  static constexpr size_t kMaxArenasPerThreadCache = 4;
+  // Watermark of a pool that never releases its free arenas.
+  static constexpr size_t kNoReleaseWatermark = static_cast<size_t>(-1);
+
+  explicit ArenaPool(size_t release_watermark = kNoReleaseWatermark);
   ~ArenaPool();
   Arena* AllocArena(size_t size) LOCKS_EXCLUDED(lock_);
   void FreeArenaChain(Arena* first) LOCKS_EXCLUDED(lock_);
   size_t GetBytesAllocated() const LOCKS_EXCLUDED(lock_);
 
+  // Returns the size of the arenas currently handed out to allocators, over all threads.
+  size_t GetBytesInUse() const {
+    return bytes_in_use_.LoadRelaxed();
+  }
+
+  // Returns the peak of GetBytesInUse() since the pool was created or the last call to
+  // ResetPeakBytesInUse().
+  size_t GetPeakBytesInUse() const {
+    return peak_bytes_in_use_.LoadRelaxed();
+  }
+
+  // Starts a new peak measurement, typically at the beginning of a compilation phase.
+  void ResetPeakBytesInUse() {
+    peak_bytes_in_use_.StoreRelaxed(bytes_in_use_.LoadRelaxed());
+  }
+
+  // Adds the allocation statistics of an allocator to the pool-wide ones. Thread-safe.
+  void MergeStats(const ArenaAllocatorStats& stats) LOCKS_EXCLUDED(lock_);
+  void DumpStats(std::ostream& os) const LOCKS_EXCLUDED(lock_);
+
  private:
+  struct ThreadCache {
+    ThreadCache();
+
+    mutable Mutex lock DEFAULT_MUTEX_ACQUIRED_AFTER;
+    Arena* free_arenas GUARDED_BY(lock);
+    size_t num_free_arenas GUARDED_BY(lock);
+  };
+
+  static void DeleteArenaChain(Arena* first);
+  ThreadCache* GetThreadCache(Thread* self);
+  void ReleaseFreeArenasLocked() EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  const size_t release_watermark_;
+  ThreadCache thread_caches_[kNumThreadCaches];
+  Atomic<size_t> bytes_in_use_;
+  Atomic<size_t> peak_bytes_in_use_;
+
   mutable Mutex lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
   Arena* free_arenas_ GUARDED_BY(lock_);
+  // Size of the arenas in free_arenas_ whose memory is still resident.
+  size_t free_resident_bytes_ GUARDED_BY(lock_);
+  // Memory mapped arenas released above the watermark, already zero.
+  Arena* released_arenas_ GUARDED_BY(lock_);
+  ArenaAllocatorStats stats_ GUARDED_BY(lock_);
   DISALLOW_COPY_AND_ASSIGN(ArenaPool);
 };
 
@@ -193,6 +254,13 @@ class ArenaAllocator : private DebugStackRefCounter, private ArenaAllocatorStats
   size_t BytesAllocated() const;
   MemStats GetMemStats() const;
 
+  const ArenaAllocatorStats& GetStats() const {
+    return *this;
+  }
+
+  // Returns the total size of the arenas obtained from the pool.
+  size_t BytesReserved() const;
+
  private:
   void UpdateBytesAllocated();
 
@@ -14,6 +14,8 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+
 #include "gtest/gtest.h"
 #include "utils/arena_allocator.h"
 #include "utils/arena_bit_vector.h"
@@ -30,4 +32,63 @@ TEST(ArenaAllocator, Test) {
   EXPECT_EQ(2U, bv.GetStorageSize());
 }
 
+TEST(ArenaAllocator, ReuseFreedArenas) {
+  ArenaPool pool;
+  Arena* arena1 = pool.AllocArena(Arena::kDefaultSize);
+  Arena* arena2 = pool.AllocArena(Arena::kDefaultSize);
+  EXPECT_EQ(2 * Arena::kDefaultSize, pool.GetBytesInUse());
+  EXPECT_EQ(2 * Arena::kDefaultSize, pool.GetPeakBytesInUse());
+  pool.FreeArenaChain(arena1);
+  pool.FreeArenaChain(arena2);
+  EXPECT_EQ(0U, pool.GetBytesInUse());
+  EXPECT_EQ(2 * Arena::kDefaultSize, pool.GetPeakBytesInUse());
+
+  // The thread cache hands back the most recently freed arena first.
+  EXPECT_EQ(arena2, pool.AllocArena(Arena::kDefaultSize));
+  EXPECT_EQ(arena1, pool.AllocArena(Arena::kDefaultSize));
+  pool.ResetPeakBytesInUse();
+  EXPECT_EQ(2 * Arena::kDefaultSize, pool.GetPeakBytesInUse());
+  pool.FreeArenaChain(arena1);
+  pool.FreeArenaChain(arena2);
+}
+
+TEST(ArenaAllocator, ReusedArenasAreZeroed) {
+  ArenaPool pool;
+  {
+    ArenaAllocator arena(&pool);
+    uint8_t* data = static_cast<uint8_t*>(arena.Alloc(64, kArenaAllocMisc));
+    std::fill_n(data, 64, 0xffu);
+  }
+  ArenaAllocator arena(&pool);
+  uint8_t* data = static_cast<uint8_t*>(arena.Alloc(64, kArenaAllocMisc));
+  for (size_t i = 0; i != 64; ++i) {
+    EXPECT_EQ(0U, data[i]);
+  }
+}
+
+TEST(ArenaAllocator, OverflowAndReleaseWatermark) {
+  static constexpr size_t kNumArenas = ArenaPool::kMaxArenasPerThreadCache + 3;
+  ArenaPool pool(Arena::kDefaultSize);
+  {
+    // Each allocation fills a whole arena.
+    ArenaAllocator arena(&pool);
+    for (size_t i = 0; i != kNumArenas; ++i) {
+      arena.Alloc(Arena::kDefaultSize, kArenaAllocMisc);
+    }
+    EXPECT_EQ(kNumArenas * Arena::kDefaultSize, pool.GetBytesInUse());
+  }
+  EXPECT_EQ(0U, pool.GetBytesInUse());
+  EXPECT_EQ(kNumArenas * Arena::kDefaultSize, pool.GetPeakBytesInUse());
+
+  // The arenas beyond the thread cache and the watermark are released, allocating them again
+  // must still give usable arenas.
+  for (size_t i = 0; i != kNumArenas; ++i) {
+    Arena* arena = pool.AllocArena(Arena::kDefaultSize);
+    ASSERT_TRUE(arena != nullptr);
+    EXPECT_EQ(Arena::kDefaultSize, arena->Size());
+    EXPECT_EQ(0U, arena->GetBytesAllocated());
+    pool.FreeArenaChain(arena);
+  }
+}
+
 }  // namespace art
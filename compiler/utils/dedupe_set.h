@@ -20,53 +20,64 @@
 #include <algorithm>
 #include <inttypes.h>
 #include <memory>
-#include <set>
+#include <sched.h>
 #include <string>
 
-#include "base/mutex.h"
-#include "base/stl_util.h"
+#include "atomic.h"
+#include "base/logging.h"
+#include "base/macros.h"
 #include "base/stringprintf.h"
+#include "utils.h"
 #include "utils/swap_space.h"
 
 namespace art {
 
+class Thread;
+
 // A set of Keys that support a HashFunc returning HashType. Used to find duplicates of Key in the
-// Add method. The data-structure is thread-safe through the use of internal locks, it also
-// supports the lock being sharded.
-template <typename InKey, typename StoreKey, typename HashType, typename HashFunc,
-          HashType kShard = 1>
+// Add method. The data-structure is thread-safe and lock-free on the fast path. Keys are spread
+// over shards by hash, each shard being an open addressing hash table with linear probing.
+//
+// A slot is claimed by a CAS of its hash from 0 and then published by storing its key; threads
+// looking for the same hash wait for the key to be published. A shard that reaches its maximum
+// load gets a new table of four times the size, chained after the old one. Old tables are only
+// searched; the first insertion into a new table waits for pending insertions into the previous
+// table, so that the same key is never added to two tables.
+template <typename InKey, typename StoreKey, typename HashType, typename HashFunc>
 class DedupeSet {
-  typedef std::pair<HashType, const InKey*> HashedInKey;
-  struct HashedKey {
-    StoreKey* store_ptr;
-    union {
-      HashType store_hash;        // Valid if store_ptr != nullptr.
-      const HashedInKey* in_key;  // Valid if store_ptr == nullptr.
-    };
-  };
-
-  class Comparator {
+  class Table {
    public:
-    bool operator()(const HashedKey& a, const HashedKey& b) const {
-      HashType a_hash = (a.store_ptr != nullptr) ? a.store_hash : a.in_key->first;
-      HashType b_hash = (b.store_ptr != nullptr) ? b.store_hash : b.in_key->first;
-      if (a_hash != b_hash) {
-        return a_hash < b_hash;
-      }
-      if (a.store_ptr != nullptr && b.store_ptr != nullptr) {
-        return std::lexicographical_compare(a.store_ptr->begin(), a.store_ptr->end(),
-                                            b.store_ptr->begin(), b.store_ptr->end());
-      } else if (a.store_ptr != nullptr && b.store_ptr == nullptr) {
-        return std::lexicographical_compare(a.store_ptr->begin(), a.store_ptr->end(),
-                                            b.in_key->second->begin(), b.in_key->second->end());
-      } else if (a.store_ptr == nullptr && b.store_ptr != nullptr) {
-        return std::lexicographical_compare(a.in_key->second->begin(), a.in_key->second->end(),
-                                            b.store_ptr->begin(), b.store_ptr->end());
-      } else {
-        return std::lexicographical_compare(a.in_key->second->begin(), a.in_key->second->end(),
-                                            b.in_key->second->begin(), b.in_key->second->end());
-      }
+    explicit Table(size_t capacity)
+        : capacity_(capacity),
+          hashes_(new Atomic<HashType>[capacity]),
+          keys_(new Atomic<StoreKey*>[capacity]),
+          size_(0u),
+          inserters_(0u),
+          sealed_(false),
+          next_(nullptr) {
+      DCHECK(IsPowerOfTwo(capacity));
+    }
+
+    ~Table() {
+      delete next_.LoadRelaxed();
     }
+
+    const size_t capacity_;
+    // Hash of the key in each slot, 0 for empty slots.
+    const std::unique_ptr<Atomic<HashType>[]> hashes_;
+    // Key in each slot, nullptr until published.
+    const std::unique_ptr<Atomic<StoreKey*>[]> keys_;
+    // Number of claimed slots.
+    Atomic<size_t> size_;
+    // Number of threads that may be claiming slots.
+    Atomic<size_t> inserters_;
+    // Set once next_ is non-null and no thread can claim slots anymore.
+    Atomic<bool> sealed_;
+    // The next larger table of the shard.
+    Atomic<Table*> next_;
+
+   private:
+    DISALLOW_COPY_AND_ASSIGN(Table);
   };
 
  public:
@@ -75,76 +86,206 @@ class DedupeSet {
     if (kIsDebugBuild) {
       hash_start = NanoTime();
     }
+    adds_.FetchAndAddSequentiallyConsistent(1u);
     HashType raw_hash = HashFunc()(key);
     if (kIsDebugBuild) {
       uint64_t hash_end = NanoTime();
-      hash_time_ += hash_end - hash_start;
-    }
-    HashType shard_hash = raw_hash / kShard;
-    HashType shard_bin = raw_hash % kShard;
-    HashedInKey hashed_in_key(shard_hash, &key);
-    HashedKey hashed_key;
-    hashed_key.store_ptr = nullptr;
-    hashed_key.in_key = &hashed_in_key;
-    MutexLock lock(self, *lock_[shard_bin]);
-    auto it = keys_[shard_bin].find(hashed_key);
-    if (it != keys_[shard_bin].end()) {
-      DCHECK(it->store_ptr != nullptr);
-      return it->store_ptr;
-    }
-    hashed_key.store_ptr = CreateStoreKey(key);
-    hashed_key.store_hash = shard_hash;
-    keys_[shard_bin].insert(hashed_key);
-    return hashed_key.store_ptr;
+      hash_time_.FetchAndAddSequentiallyConsistent(hash_end - hash_start);
+    }
+    // Slot hashes are never 0, that value marks empty slots.
+    HashType hash = (raw_hash != 0u) ? raw_hash : 1u;
+    size_t start = static_cast<size_t>(raw_hash / num_shards_);
+    Table* table = shards_[raw_hash % num_shards_].get();
+    while (true) {
+      if (table->next_.LoadSequentiallyConsistent() != nullptr) {
+        // Superseded table, nothing is added to it anymore.
+        WaitUntilSealed(table);
+        StoreKey* store_key = Find(table, hash, start, key);
+        if (store_key != nullptr) {
+          return store_key;
+        }
+        table = table->next_.LoadSequentiallyConsistent();
+        continue;
+      }
+      table->inserters_.FetchAndAddSequentiallyConsistent(1u);
+      if (table->next_.LoadSequentiallyConsistent() != nullptr) {
+        // Lost a race with Grow(), retry as a superseded table.
+        table->inserters_.FetchAndSubSequentiallyConsistent(1u);
+        continue;
+      }
+      StoreKey* store_key = FindOrInsert(table, hash, start, key);
+      table->inserters_.FetchAndSubSequentiallyConsistent(1u);
+      if (store_key != nullptr) {
+        return store_key;
+      }
+      Grow(table);
+    }
   }
 
-  explicit DedupeSet(const char* set_name, SwapAllocator<void>& alloc)
-      : allocator_(alloc), hash_time_(0) {
-    for (HashType i = 0; i < kShard; ++i) {
-      std::ostringstream oss;
-      oss << set_name << " lock " << i;
-      lock_name_[i] = oss.str();
-      lock_[i].reset(new Mutex(lock_name_[i].c_str()));
+  explicit DedupeSet(SwapAllocator<void>& alloc, size_t num_shards = 1u)
+      : num_shards_(num_shards),
+        shards_(new std::unique_ptr<Table>[num_shards]),
+        allocator_(alloc),
+        adds_(0u),
+        hash_time_(0u) {
+    CHECK_NE(num_shards, 0u);
+    for (size_t i = 0; i < num_shards; ++i) {
+      shards_[i].reset(new Table(kInitialTableCapacity));
     }
   }
 
   ~DedupeSet() {
     // Have to manually free all pointers.
-    for (auto& shard : keys_) {
-      for (const auto& hashed_key : shard) {
-        DCHECK(hashed_key.store_ptr != nullptr);
-        DeleteStoreKey(hashed_key.store_ptr);
+    for (size_t i = 0; i < num_shards_; ++i) {
+      for (Table* table = shards_[i].get(); table != nullptr;
+           table = table->next_.LoadRelaxed()) {
+        for (size_t slot = 0; slot < table->capacity_; ++slot) {
+          StoreKey* store_key = table->keys_[slot].LoadRelaxed();
+          if (store_key != nullptr) {
+            DeleteStoreKey(store_key);
+          }
+        }
       }
     }
   }
 
+  // Returns the number of calls to Add.
+  size_t GetNumAdds() const {
+    return adds_.LoadRelaxed();
+  }
+
+  // Returns the number of distinct keys. Not to be called concurrently with Add.
+  size_t GetNumKeys() const {
+    size_t num_keys = 0;
+    for (size_t i = 0; i < num_shards_; ++i) {
+      for (Table* table = shards_[i].get(); table != nullptr;
+           table = table->next_.LoadRelaxed()) {
+        num_keys += table->size_.LoadRelaxed();
+      }
+    }
+    return num_keys;
+  }
+
   std::string DumpStats() const {
+    size_t num_tables = 0;
+    size_t num_keys = 0;
     size_t collision_sum = 0;
-    size_t collision_max = 0;
-    for (HashType shard = 0; shard < kShard; ++shard) {
-      HashType last_hash = 0;
-      size_t collision_cur_max = 0;
-      for (const HashedKey& key : keys_[shard]) {
-        DCHECK(key.store_ptr != nullptr);
-        if (key.store_hash == last_hash) {
-          collision_cur_max++;
-          if (collision_cur_max > 1) {
-            collision_sum++;
-            if (collision_cur_max > collision_max) {
-              collision_max = collision_cur_max;
-            }
+    size_t max_probe_length = 0;
+    for (size_t i = 0; i < num_shards_; ++i) {
+      for (Table* table = shards_[i].get(); table != nullptr;
+           table = table->next_.LoadRelaxed()) {
+        ++num_tables;
+        size_t mask = table->capacity_ - 1u;
+        for (size_t slot = 0; slot < table->capacity_; ++slot) {
+          HashType hash = table->hashes_[slot].LoadRelaxed();
+          if (hash == 0u) {
+            continue;
+          }
+          ++num_keys;
+          size_t probe_length = (slot - static_cast<size_t>(hash / num_shards_)) & mask;
+          if (probe_length != 0u) {
+            ++collision_sum;
+            max_probe_length = std::max(max_probe_length, probe_length);
           }
-        } else {
-          collision_cur_max = 1;
-          last_hash = key.store_hash;
         }
       }
     }
-    return StringPrintf("%zu collisions, %zu max bucket size, %" PRIu64 " ns hash time",
-                        collision_sum, collision_max, hash_time_);
+    return StringPrintf("%zu keys from %zu adds in %zu tables over %zu shards, %zu collisions, "
+                        "%zu max probe length, %" PRIu64 " ns hash time",
+                        num_keys, adds_.LoadRelaxed(), num_tables, num_shards_, collision_sum,
+                        max_probe_length, hash_time_.LoadRelaxed());
   }
 
  private:
+  static constexpr size_t kInitialTableCapacity = 256u;
+  static constexpr size_t kTableGrowthFactor = 4u;
+
+  // Returns the key equal to "key" in a table that is no longer modified, or nullptr.
+  StoreKey* Find(Table* table, HashType hash, size_t start, const InKey& key) {
+    size_t mask = table->capacity_ - 1u;
+    for (size_t i = 0; i < table->capacity_; ++i) {
+      size_t slot = (start + i) & mask;
+      HashType slot_hash = table->hashes_[slot].LoadSequentiallyConsistent();
+      if (slot_hash == 0u) {
+        return nullptr;
+      }
+      if (slot_hash == hash) {
+        StoreKey* store_key = WaitForKey(table, slot);
+        if (Equals(*store_key, key)) {
+          return store_key;
+        }
+      }
+    }
+    return nullptr;
+  }
+
+  // Returns the key equal to "key" in the current table of a shard, adding it if necessary.
+  // Returns nullptr if the table is too full and needs to grow.
+  StoreKey* FindOrInsert(Table* table, HashType hash, size_t start, const InKey& key) {
+    size_t mask = table->capacity_ - 1u;
+    for (size_t i = 0; i < table->capacity_; ++i) {
+      size_t slot = (start + i) & mask;
+      HashType slot_hash = table->hashes_[slot].LoadSequentiallyConsistent();
+      if (slot_hash == 0u) {
+        if (table->size_.LoadRelaxed() >= table->capacity_ / 2u) {
+          return nullptr;
+        }
+        if (table->hashes_[slot].CompareExchangeStrongSequentiallyConsistent(0u, hash)) {
+          table->size_.FetchAndAddSequentiallyConsistent(1u);
+          StoreKey* store_key = CreateStoreKey(key);
+          table->keys_[slot].StoreSequentiallyConsistent(store_key);
+          return store_key;
+        }
+        // Another thread claimed the slot first.
+        slot_hash = table->hashes_[slot].LoadSequentiallyConsistent();
+      }
+      if (slot_hash == hash) {
+        StoreKey* store_key = WaitForKey(table, slot);
+        if (Equals(*store_key, key)) {
+          return store_key;
+        }
+      }
+    }
+    return nullptr;
+  }
+
+  // Chains a larger table after "table" unless another thread already did.
+  void Grow(Table* table) {
+    if (table->next_.LoadSequentiallyConsistent() != nullptr) {
+      return;
+    }
+    Table* next = new Table(table->capacity_ * kTableGrowthFactor);
+    if (!table->next_.CompareExchangeStrongSequentiallyConsistent(nullptr, next)) {
+      delete next;
+    }
+  }
+
+  // Waits for threads still claiming slots in a superseded table.
+  static void WaitUntilSealed(Table* table) {
+    if (table->sealed_.LoadSequentiallyConsistent()) {
+      return;
+    }
+    while (table->inserters_.LoadSequentiallyConsistent() != 0u) {
+      sched_yield();
+    }
+    table->sealed_.StoreSequentiallyConsistent(true);
+  }
+
+  // Waits for the thread that claimed a slot to publish its key.
+  static StoreKey* WaitForKey(Table* table, size_t slot) {
+    StoreKey* store_key = table->keys_[slot].LoadSequentiallyConsistent();
+    while (store_key == nullptr) {
+      sched_yield();
+      store_key = table->keys_[slot].LoadSequentiallyConsistent();
+    }
+    return store_key;
+  }
+
+  static bool Equals(const StoreKey& store_key, const InKey& key) {
+    return store_key.size() == key.size() &&
+        std::equal(key.begin(), key.end(), store_key.begin());
+  }
+
   StoreKey* CreateStoreKey(const InKey& key) {
     StoreKey* ret = allocator_.allocate(1);
     allocator_.construct(ret, key.begin(), key.end(), allocator_);
@@ -157,11 +298,11 @@ class DedupeSet {
     alloc.deallocate(key, 1);
   }
 
-  std::string lock_name_[kShard];
-  std::unique_ptr<Mutex> lock_[kShard];
-  std::set<HashedKey, Comparator> keys_[kShard];
+  const size_t num_shards_;
+  const std::unique_ptr<std::unique_ptr<Table>[]> shards_;
   SwapAllocator<StoreKey> allocator_;
-  uint64_t hash_time_;
+  Atomic<size_t> adds_;
+  Atomic<uint64_t> hash_time_;
 
   DISALLOW_COPY_AND_ASSIGN(DedupeSet);
 };
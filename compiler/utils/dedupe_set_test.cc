@@ -16,11 +16,17 @@
 
 #include "dedupe_set.h"
 
+#include <pthread.h>
+
 #include <algorithm>
 #include <cstdio>
+#include <iostream>
+#include <vector>
 
+#include "base/stringprintf.h"
 #include "gtest/gtest.h"
 #include "thread-inl.h"
+#include "utils.h"
 
 namespace art {
 
@@ -40,7 +46,7 @@ TEST(DedupeSetTest, Test) {
   Thread* self = Thread::Current();
   typedef std::vector<uint8_t> ByteArray;
   SwapAllocator<void> swap(nullptr);
-  DedupeSet<ByteArray, SwapVector<uint8_t>, size_t, DedupeHashFunc> deduplicator("test", swap);
+  DedupeSet<ByteArray, SwapVector<uint8_t>, size_t, DedupeHashFunc> deduplicator(swap);
   SwapVector<uint8_t>* array1;
   {
     ByteArray test1;
@@ -77,6 +83,80 @@ TEST(DedupeSetTest, Test) {
     ASSERT_NE(array3, nullptr);
     ASSERT_TRUE(std::equal(test1.begin(), test1.end(), array3->begin()));
   }
+
+  EXPECT_EQ(3u, deduplicator.GetNumAdds());
+  EXPECT_EQ(2u, deduplicator.GetNumKeys());
+}
+
+typedef DedupeSet<std::vector<uint8_t>, SwapVector<uint8_t>, size_t, DedupeHashFunc>
+    ByteArrayDedupeSet;
+
+struct DedupeSetBenchmarkArgs {
+  ByteArrayDedupeSet* deduplicator;
+  const std::vector<std::vector<uint8_t>>* keys;
+  size_t first_key;
+  std::vector<SwapVector<uint8_t>*> results;
+};
+
+static void* DedupeSetBenchmarkThread(void* arg) {
+  DedupeSetBenchmarkArgs* args = reinterpret_cast<DedupeSetBenchmarkArgs*>(arg);
+  const std::vector<std::vector<uint8_t>>& keys = *args->keys;
+  args->results.resize(keys.size());
+  // Every thread adds all keys, starting at a different one.
+  for (size_t i = 0; i != keys.size(); ++i) {
+    size_t index = (args->first_key + i) % keys.size();
+    args->results[index] = args->deduplicator->Add(nullptr, keys[index]);
+  }
+  return nullptr;
+}
+
+// Measures the insertion throughput with 1 to 32 threads adding the same keys concurrently and
+// checks that every thread sees the same stored key for each of them.
+TEST(DedupeSetTest, ConcurrentAddBenchmark) {
+  static constexpr size_t kNumKeys = 1 << 15;
+  std::vector<std::vector<uint8_t>> keys(kNumKeys);
+  for (size_t i = 0; i != kNumKeys; ++i) {
+    // Keys 2 * n and 2 * n + 1 have equal contents, half of the additions are duplicates.
+    size_t value = i / 2;
+    for (size_t j = 0, length = 4 + (value % 32); j != length; ++j) {
+      keys[i].push_back(static_cast<uint8_t>(value >> ((j % 4) * 8)));
+    }
+  }
+
+  SwapAllocator<void> swap(nullptr);
+  for (size_t num_threads = 1; num_threads <= 32; num_threads *= 2) {
+    ByteArrayDedupeSet deduplicator(swap, RoundUpToPowerOfTwo(num_threads * 4));
+    std::vector<DedupeSetBenchmarkArgs> args(num_threads);
+    std::vector<pthread_t> threads(num_threads);
+    uint64_t start_ns = NanoTime();
+    for (size_t t = 0; t != num_threads; ++t) {
+      args[t].deduplicator = &deduplicator;
+      args[t].keys = &keys;
+      args[t].first_key = t * kNumKeys / num_threads;
+      ASSERT_EQ(0, pthread_create(&threads[t], nullptr, DedupeSetBenchmarkThread, &args[t]));
+    }
+    for (size_t t = 0; t != num_threads; ++t) {
+      ASSERT_EQ(0, pthread_join(threads[t], nullptr));
+    }
+    uint64_t duration_ns = NanoTime() - start_ns;
+
+    for (size_t i = 0; i != kNumKeys; ++i) {
+      SwapVector<uint8_t>* stored = args[0].results[i];
+      ASSERT_NE(stored, nullptr);
+      ASSERT_TRUE(std::equal(keys[i].begin(), keys[i].end(), stored->begin()));
+      if ((i % 2) == 1) {
+        ASSERT_EQ(args[0].results[i - 1], stored);
+      }
+      for (size_t t = 1; t != num_threads; ++t) {
+        ASSERT_EQ(stored, args[t].results[i]) << "key " << i << " thread " << t;
+      }
+    }
+    size_t additions = num_threads * kNumKeys;
+    std::cout << StringPrintf("%zu threads: %zu additions in %s, %.0f additions/s\n",
+                              num_threads, additions, PrettyDuration(duration_ns).c_str(),
+                              additions * 1e9 / std::max<uint64_t>(duration_ns, 1u));
+    std::cout << deduplicator.DumpStats() << std::endl;
+  }
 }
 
 }  // namespace art
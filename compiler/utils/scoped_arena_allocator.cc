@@ -53,6 +53,14 @@ MemStats ArenaStack::GetPeakStats() const {
                   bottom_arena_);
 }
 
+size_t ArenaStack::BytesReserved() const {
+  size_t total = 0u;
+  for (const Arena* arena = bottom_arena_; arena != nullptr; arena = arena->next_) {
+    total += arena->Size();
+  }
+  return total;
+}
+
 uint8_t* ArenaStack::AllocateFromNextArena(size_t rounded_bytes) {
   UpdateBytesAllocated();
   size_t allocation_size = std::max(Arena::kDefaultSize, rounded_bytes);
@@ -45,6 +45,13 @@ class ArenaStack : private DebugStackRefCounter {
 
   MemStats GetPeakStats() const;
 
+  const ArenaAllocatorStats& GetPeakAllocatorStats() const {
+    return *static_cast<const TaggedStats<Peak>*>(&stats_and_pool_);
+  }
+
+  // Returns the total size of the arenas obtained from the pool.
+  size_t BytesReserved() const;
+
  private:
   struct Peak;
   struct Current;
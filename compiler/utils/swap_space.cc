@@ -18,6 +18,7 @@
 
 #include <algorithm>
 #include <numeric>
+#include <sstream>
 
 #include "base/logging.h"
 #include "base/macros.h"
@@ -29,6 +30,18 @@ namespace art {
 // The chunk size by which the swap file is increased and mapped.
 static constexpr size_t kMininumMapSize = 16 * MB;
 
+// The swap file grows by at least this fraction of its current size, to keep the number of
+// mappings logarithmic in the file size.
+static constexpr size_t kMapGrowthDivisor = 4;
+
+// Bytes of a size class moved between a thread cache and the central lists at once.
+static constexpr size_t kThreadCacheBatchBytes = 4 * KB;
+// Bytes of a size class a thread cache holds before it returns half of them.
+static constexpr size_t kThreadCacheMaxBytes = 16 * KB;
+
+// Number of freed large chunks collected before they are merged into the free maps.
+static constexpr size_t kMaxPendingFrees = 64;
+
 static constexpr bool kCheckFreeMaps = false;
 
 template <typename FreeBySizeSet>
@@ -66,17 +79,98 @@ static void InsertChunk(FreeByStartSet* free_by_start,
 SwapSpace::SwapSpace(int fd, size_t initial_size)
     : fd_(fd),
       size_(0),
+      lock_acquisitions_(0u),
+      lock_contentions_(0u),
+      lock_wait_ns_(0u),
       lock_("SwapSpace lock", static_cast<LockLevel>(LockLevel::kDefaultMutexLevel - 1)) {
   // Assume that the file is unlinked.
 
+  CHECK_PTHREAD_CALL(pthread_key_create, (&cache_key_, DestroyThreadCache), "swap cache key");
+  MutexLock lock(Thread::Current(), lock_);
   InsertChunk(&free_by_start_, &free_by_size_, NewFileChunk(initial_size));
 }
 
 SwapSpace::~SwapSpace() {
+  CHECK_PTHREAD_CALL(pthread_key_delete, (cache_key_), "swap cache key");
+  for (ThreadCache* cache : caches_) {
+    delete cache;
+  }
   // All arenas are backed by the same file. Just close the descriptor.
   close(fd_);
 }
 
+SwapSpace::ScopedSwapLock::ScopedSwapLock(Thread* self, SwapSpace* swap_space)
+    : self_(self), swap_space_(swap_space) {
+  if (!swap_space->lock_.ExclusiveTryLock(self)) {
+    uint64_t start_ns = NanoTime();
+    swap_space->lock_.ExclusiveLock(self);
+    swap_space->lock_wait_ns_ += NanoTime() - start_ns;
+    ++swap_space->lock_contentions_;
+  }
+  ++swap_space->lock_acquisitions_;
+}
+
+SwapSpace::ScopedSwapLock::~ScopedSwapLock() {
+  swap_space_->lock_.ExclusiveUnlock(self_);
+}
+
+SwapSpace::ThreadCache* SwapSpace::GetThreadCache() {
+  ThreadCache* cache = reinterpret_cast<ThreadCache*>(pthread_getspecific(cache_key_));
+  if (UNLIKELY(cache == nullptr)) {
+    cache = new ThreadCache(this);
+    {
+      MutexLock lock(Thread::Current(), lock_);
+      caches_.insert(cache);
+    }
+    CHECK_PTHREAD_CALL(pthread_setspecific, (cache_key_, cache), "swap cache");
+  }
+  return cache;
+}
+
+void SwapSpace::DestroyThreadCache(void* arg) {
+  ThreadCache* cache = reinterpret_cast<ThreadCache*>(arg);
+  cache->swap_space->ReleaseThreadCache(cache);
+}
+
+void SwapSpace::ReleaseThreadCache(ThreadCache* cache) {
+  ScopedSwapLock lock(Thread::Current(), this);
+  for (size_t index = 0; index != kNumSizeClasses; ++index) {
+    FlushThreadCache(cache, index, cache->free_lists[index].count);
+  }
+  caches_.erase(cache);
+  delete cache;
+}
+
+void SwapSpace::RefillThreadCache(ThreadCache* cache, size_t index) {
+  size_t object_size = SizeClassSize(index);
+  size_t count = std::max<size_t>(kThreadCacheBatchBytes / object_size, 1u);
+  FreeList* local = &cache->free_lists[index];
+  ScopedSwapLock lock(Thread::Current(), this);
+  FreeList* central = &free_lists_[index];
+  while (local->count != count && central->count != 0u) {
+    local->Push(central->Pop());
+  }
+  if (local->count == 0u) {
+    // Carve a new batch out of the free maps.
+    uint8_t* batch = reinterpret_cast<uint8_t*>(AllocLocked(count * object_size));
+    for (size_t i = count; i != 0u; --i) {
+      local->Push(batch + (i - 1u) * object_size);
+    }
+  }
+  cache->cached_bytes.StoreRelaxed(cache->cached_bytes.LoadRelaxed() + local->count * object_size);
+}
+
+void SwapSpace::FlushThreadCache(ThreadCache* cache, size_t index, size_t count) {
+  FreeList* local = &cache->free_lists[index];
+  FreeList* central = &free_lists_[index];
+  DCHECK_LE(count, local->count);
+  for (size_t i = 0; i != count; ++i) {
+    central->Push(local->Pop());
+  }
+  cache->cached_bytes.StoreRelaxed(cache->cached_bytes.LoadRelaxed() -
+                                   count * SizeClassSize(index));
+}
+
 template <typename FreeByStartSet, typename FreeBySizeSet>
 static size_t CollectFree(const FreeByStartSet& free_by_start, const FreeBySizeSet& free_by_size) {
   if (free_by_start.size() != free_by_size.size()) {
@@ -102,15 +196,32 @@ static size_t CollectFree(const FreeByStartSet& free_by_start, const FreeBySizeS
 }
 
 void* SwapSpace::Alloc(size_t size) {
-  MutexLock lock(Thread::Current(), lock_);
   size = RoundUp(size, 8U);
+  if (size <= kMaxSmallSize) {
+    size_t index = SizeClassIndex(size);
+    ThreadCache* cache = GetThreadCache();
+    if (cache->free_lists[index].count == 0u) {
+      RefillThreadCache(cache, index);
+    }
+    cache->cached_bytes.StoreRelaxed(cache->cached_bytes.LoadRelaxed() - SizeClassSize(index));
+    return cache->free_lists[index].Pop();
+  }
+  ScopedSwapLock lock(Thread::Current(), this);
+  return AllocLocked(size);
+}
 
+void* SwapSpace::AllocLocked(size_t size) {
   // Check the free list for something that fits.
   // TODO: Smarter implementation. Global biggest chunk, ...
   SpaceChunk old_chunk;
   auto it = free_by_start_.empty()
       ? free_by_size_.end()
       : free_by_size_.lower_bound(FreeBySizeEntry { size, free_by_start_.begin() });
+  if (it == free_by_size_.end() && !pending_frees_.empty()) {
+    // Merging the pending frees may create a big enough chunk.
+    CoalescePendingFreesLocked();
+    it = free_by_size_.lower_bound(FreeBySizeEntry { size, free_by_start_.begin() });
+  }
   if (it != free_by_size_.end()) {
     old_chunk = *it->second;
     RemoveChunk(&free_by_start_, &free_by_size_, it);
@@ -132,7 +243,9 @@ void* SwapSpace::Alloc(size_t size) {
 
 SpaceChunk SwapSpace::NewFileChunk(size_t min_size) {
 #if !defined(__APPLE__)
-  size_t next_part = std::max(RoundUp(min_size, kPageSize), RoundUp(kMininumMapSize, kPageSize));
+  size_t next_part = std::max(RoundUp(min_size, kPageSize),
+                              RoundUp(std::max(kMininumMapSize, size_ / kMapGrowthDivisor),
+                                      kPageSize));
   int result = TEMP_FAILURE_RETRY(ftruncate64(fd_, size_ + next_part));
   if (result != 0) {
     PLOG(FATAL) << "Unable to increase swap file.";
@@ -143,7 +256,6 @@ SpaceChunk SwapSpace::NewFileChunk(size_t min_size) {
     LOG(ERROR) << "Unable to mmap new swap file chunk.";
     LOG(ERROR) << "Current size: " << size_ << " requested: " << next_part << "/" << min_size;
     LOG(ERROR) << "Free list:";
-    MutexLock lock(Thread::Current(), lock_);
     DumpFreeMap(free_by_size_);
     LOG(ERROR) << "In free list: " << CollectFree(free_by_start_, free_by_size_);
     LOG(FATAL) << "Aborting...";
@@ -159,17 +271,54 @@ SpaceChunk SwapSpace::NewFileChunk(size_t min_size) {
 #endif
 }
 
-// TODO: Full coalescing.
 void SwapSpace::Free(void* ptrV, size_t size) {
-  MutexLock lock(Thread::Current(), lock_);
   size = RoundUp(size, 8U);
+  if (size <= kMaxSmallSize) {
+    size_t index = SizeClassIndex(size);
+    ThreadCache* cache = GetThreadCache();
+    size_t object_size = SizeClassSize(index);
+    cache->free_lists[index].Push(ptrV);
+    cache->cached_bytes.StoreRelaxed(cache->cached_bytes.LoadRelaxed() + object_size);
+    size_t count = cache->free_lists[index].count;
+    if (count * object_size > kThreadCacheMaxBytes) {
+      ScopedSwapLock lock(Thread::Current(), this);
+      FlushThreadCache(cache, index, count / 2u);
+    }
+    return;
+  }
+  ScopedSwapLock lock(Thread::Current(), this);
+  pending_frees_.push_back(SpaceChunk { reinterpret_cast<uint8_t*>(ptrV), size });
+  if (pending_frees_.size() >= kMaxPendingFrees) {
+    CoalescePendingFreesLocked();
+  }
+}
+
+void SwapSpace::CoalescePendingFreesLocked() {
+  // Merge adjacent pending chunks first, so that each run costs a single free map update.
+  std::sort(pending_frees_.begin(), pending_frees_.end(), SortChunkByPtr());
+  SpaceChunk run = pending_frees_[0];
+  for (size_t i = 1; i != pending_frees_.size(); ++i) {
+    const SpaceChunk& chunk = pending_frees_[i];
+    CHECK_LE(run.End(), chunk.Start());
+    if (run.End() == chunk.Start()) {
+      run.size += chunk.size;
+    } else {
+      InsertFreeChunkLocked(run);
+      run = chunk;
+    }
+  }
+  InsertFreeChunkLocked(run);
+  pending_frees_.clear();
+}
+
+void SwapSpace::InsertFreeChunkLocked(SpaceChunk chunk) {
+  size_t size = chunk.size;
 
   size_t free_before = 0;
   if (kCheckFreeMaps) {
     free_before = CollectFree(free_by_start_, free_by_size_);
   }
 
-  SpaceChunk chunk = { reinterpret_cast<uint8_t*>(ptrV), size };
   auto it = free_by_start_.lower_bound(chunk);
   if (it != free_by_start_.begin()) {
     auto prev = it;
@@ -208,4 +357,35 @@ void SwapSpace::Free(void* ptrV, size_t size) {
   }
 }
 
+std::string SwapSpace::DumpStats() const {
+  MutexLock lock(Thread::Current(), lock_);
+  size_t free_in_maps = 0;
+  for (const SpaceChunk& chunk : free_by_start_) {
+    free_in_maps += chunk.size;
+  }
+  for (const SpaceChunk& chunk : pending_frees_) {
+    free_in_maps += chunk.size;
+  }
+  size_t largest_free = free_by_size_.empty() ? 0u : free_by_size_.rbegin()->first;
+  size_t free_in_lists = 0;
+  for (size_t index = 0; index != kNumSizeClasses; ++index) {
+    free_in_lists += free_lists_[index].count * SizeClassSize(index);
+  }
+  for (const ThreadCache* cache : caches_) {
+    free_in_lists += cache->cached_bytes.LoadRelaxed();
+  }
+  // The file only grows, so its size is the peak size. Fragmentation is the part of the free
+  // space of the free maps that is not in the largest free chunk.
+  std::ostringstream oss;
+  oss << "Swap file size=" << PrettySize(size_) << " in " << maps_.size() << " mappings"
+      << ", free=" << PrettySize(free_in_maps + free_in_lists)
+      << " (" << PrettySize(free_in_lists) << " in size class lists)"
+      << ", fragmentation="
+      << (free_in_maps != 0u ? (free_in_maps - largest_free) * 100u / free_in_maps : 0u) << "%"
+      << ", lock acquisitions=" << lock_acquisitions_
+      << " contended=" << lock_contentions_
+      << " wait=" << PrettyDuration(lock_wait_ns_);
+  return oss.str();
+}
+
 }  // namespace art
@@ -19,10 +19,14 @@
 
 #include <cstdlib>
 #include <list>
+#include <pthread.h>
 #include <set>
 #include <stdint.h>
 #include <stddef.h>
+#include <string>
+#include <vector>
 
+#include "atomic.h"
 #include "base/logging.h"
 #include "base/macros.h"
 #include "base/mutex.h"
@@ -57,6 +61,11 @@ class SortChunkByPtr {
 };
 
 // An arena pool that creates arenas backed by an mmaped file.
+//
+// Small allocations are served from segregated size class free lists, cached per thread so that
+// most of them do not take the lock. Each thread cache exchanges objects with the central lists
+// in batches. Larger allocations come from a best fit free map. Frees of large chunks are
+// collected and coalesced with their neighbours in batches.
 class SwapSpace {
  public:
   SwapSpace(int fd, size_t initial_size);
@@ -68,8 +77,80 @@ class SwapSpace {
     return size_;
   }
 
+  // Returns the swap file size, the fraction of it that is free and the time spent waiting for
+  // the lock.
+  std::string DumpStats() const LOCKS_EXCLUDED(lock_);
+
  private:
-  SpaceChunk NewFileChunk(size_t min_size);
+  // Allocations up to this size use the size class free lists.
+  static constexpr size_t kMaxSmallSize = 512;
+  static constexpr size_t kSizeClassGranularity = 8;
+  static constexpr size_t kNumSizeClasses = kMaxSmallSize / kSizeClassGranularity;
+
+  // Objects of one size class free in a thread cache or in the central lists, linked through
+  // their first word.
+  struct FreeList {
+    FreeList() : head(nullptr), count(0) {}
+
+    void Push(void* ptr) {
+      *reinterpret_cast<void**>(ptr) = head;
+      head = ptr;
+      ++count;
+    }
+
+    void* Pop() {
+      void* ptr = head;
+      head = *reinterpret_cast<void**>(ptr);
+      --count;
+      return ptr;
+    }
+
+    void* head;
+    size_t count;
+  };
+
+  struct ThreadCache {
+    explicit ThreadCache(SwapSpace* space) : swap_space(space), cached_bytes(0u) {}
+
+    SwapSpace* const swap_space;
+    FreeList free_lists[kNumSizeClasses];
+    // Bytes in free_lists, written by the owning thread only.
+    Atomic<size_t> cached_bytes;
+  };
+
+  // Acquires lock_ and records the time spent waiting for it.
+  class ScopedSwapLock {
+   public:
+    ScopedSwapLock(Thread* self, SwapSpace* swap_space) EXCLUSIVE_LOCK_FUNCTION(swap_space->lock_);
+    ~ScopedSwapLock() UNLOCK_FUNCTION();
+
+   private:
+    Thread* const self_;
+    SwapSpace* const swap_space_;
+    DISALLOW_COPY_AND_ASSIGN(ScopedSwapLock);
+  };
+
+  // Zero sized allocations share the smallest size class.
+  static size_t SizeClassIndex(size_t size) {
+    return (size == 0u) ? 0u : size / kSizeClassGranularity - 1u;
+  }
+
+  static size_t SizeClassSize(size_t index) {
+    return (index + 1u) * kSizeClassGranularity;
+  }
+
+  ThreadCache* GetThreadCache() LOCKS_EXCLUDED(lock_);
+  static void DestroyThreadCache(void* arg);
+  void ReleaseThreadCache(ThreadCache* cache) LOCKS_EXCLUDED(lock_);
+
+  void RefillThreadCache(ThreadCache* cache, size_t index) LOCKS_EXCLUDED(lock_);
+  void FlushThreadCache(ThreadCache* cache, size_t index, size_t count)
+      EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  void* AllocLocked(size_t size) EXCLUSIVE_LOCKS_REQUIRED(lock_);
+  void InsertFreeChunkLocked(SpaceChunk chunk) EXCLUSIVE_LOCKS_REQUIRED(lock_);
+  void CoalescePendingFreesLocked() EXCLUSIVE_LOCKS_REQUIRED(lock_);
+  SpaceChunk NewFileChunk(size_t min_size) EXCLUSIVE_LOCKS_REQUIRED(lock_);
 
   int fd_;
   size_t size_;
@@ -95,6 +176,21 @@ class SwapSpace {
   typedef std::set<FreeBySizeEntry, FreeBySizeComparator> FreeBySizeSet;
   FreeBySizeSet free_by_size_ GUARDED_BY(lock_);
 
+  // Freed large chunks not yet merged into the free maps.
+  std::vector<SpaceChunk> pending_frees_ GUARDED_BY(lock_);
+
+  // Central free lists of the size classes.
+  FreeList free_lists_[kNumSizeClasses] GUARDED_BY(lock_);
+
+  // Key of the calling thread's ThreadCache, and all live caches.
+  pthread_key_t cache_key_;
+  std::set<ThreadCache*> caches_ GUARDED_BY(lock_);
+
+  // Lock statistics.
+  uint64_t lock_acquisitions_ GUARDED_BY(lock_);
+  uint64_t lock_contentions_ GUARDED_BY(lock_);
+  uint64_t lock_wait_ns_ GUARDED_BY(lock_);
+
   mutable Mutex lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
   DISALLOW_COPY_AND_ASSIGN(SwapSpace);
 };
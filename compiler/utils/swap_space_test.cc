@@ -17,9 +17,12 @@
 #include "utils/swap_space.h"
 
 #include <cstdio>
+#include <pthread.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <utility>
+#include <vector>
 #include "gtest/gtest.h"
 
 #include "base/unix_file/fd_file.h"
@@ -78,4 +81,60 @@ TEST_F(SwapSpaceTest, Swap) {
   SwapTest(true);
 }
 
+struct SwapThreadArgs {
+  SwapSpace* pool;
+  uint8_t id;
+};
+
+static void* SwapThreadMain(void* arg) {
+  SwapThreadArgs* args = reinterpret_cast<SwapThreadArgs*>(arg);
+  std::vector<std::pair<uint8_t*, size_t>> live;
+  uint32_t seed = args->id + 1u;
+  for (size_t i = 0; i < 20000; ++i) {
+    seed = seed * 1103515245u + 12345u;
+    if (live.empty() || (seed >> 16) % 3u != 0u) {
+      // Mostly small objects, some of them zero sized, and a few large chunks.
+      size_t size = ((seed >> 8) % 8u == 0u) ? (seed >> 4) % 16384u : (seed >> 4) % 600u;
+      uint8_t* ptr = reinterpret_cast<uint8_t*>(args->pool->Alloc(size));
+      memset(ptr, args->id, size);
+      live.push_back(std::make_pair(ptr, size));
+    } else {
+      size_t index = (seed >> 4) % live.size();
+      std::pair<uint8_t*, size_t> entry = live[index];
+      for (size_t j = 0; j < entry.second; ++j) {
+        EXPECT_EQ(args->id, entry.first[j]);
+      }
+      args->pool->Free(entry.first, entry.second);
+      live[index] = live.back();
+      live.pop_back();
+    }
+  }
+  for (const std::pair<uint8_t*, size_t>& entry : live) {
+    args->pool->Free(entry.first, entry.second);
+  }
+  return nullptr;
+}
+
+TEST_F(SwapSpaceTest, ConcurrentSmallAndLarge) {
+  ScratchFile scratch;
+  int fd = scratch.GetFd();
+  unlink(scratch.GetFilename().c_str());
+
+  SwapSpace pool(fd, 1 * MB);
+  static constexpr size_t kNumThreads = 8;
+  pthread_t threads[kNumThreads];
+  SwapThreadArgs args[kNumThreads];
+  for (size_t i = 0; i < kNumThreads; ++i) {
+    args[i].pool = &pool;
+    args[i].id = static_cast<uint8_t>(i + 1u);
+    ASSERT_EQ(0, pthread_create(&threads[i], nullptr, SwapThreadMain, &args[i]));
+  }
+  for (size_t i = 0; i < kNumThreads; ++i) {
+    ASSERT_EQ(0, pthread_join(threads[i], nullptr));
+  }
+  LOG(INFO) << pool.DumpStats();
+
+  scratch.Close();
+}
+
 }  // namespace art
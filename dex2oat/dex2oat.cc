@@ -43,8 +43,12 @@
 #include "dex/verification_results.h"
 #include "dex/quick_compiler_callbacks.h"
 #include "dex/quick/dex_file_to_method_inliner_map.h"
+#include "driver/compile_cache.h"
+#include "driver/compile_stats.h"
+#include "driver/compile_time_budget.h"
 #include "driver/compiler_driver.h"
 #include "driver/compiler_options.h"
+#include "driver/reusable_oat_file.h"
 #include "elf_fixup.h"
 #include "elf_patcher.h"
 #include "elf_stripper.h"
@@ -81,6 +85,52 @@ static std::string CommandLine() {
   return Join(command, ' ');
 }
 
+static void DumpStatsJson(const CompilerDriver& driver, const TimingLogger& timings,
+                          const std::string& filename) {
+  std::ofstream out(filename.c_str());
+  driver.DumpStatsJson(out, timings);
+  out.close();
+  if (out.fail()) {
+    LOG(WARNING) << "Failed to write compilation statistics to " << filename;
+  }
+}
+
+// Options that do not change the generated code, either because they only name inputs and
+// outputs or because they control diagnostics and resource usage.
+static const char* const kCompileCacheIgnoredOptions[] = {
+  "--android-root=", "--bitcode=", "--boot-image=", "--compile-cache-dir=",
+  "--compile-time-budget=", "--dex-file=", "--dex-location=", "--dump-cfg-passes=",
+  "--dump-passes", "--dump-stats", "--dump-timing", "--host", "--no-profile-file",
+  "--no-watch-dog", "--oat-fd=", "--oat-file=", "--oat-location=",
+  "--oat-symbols=", "--print-all-passes", "--print-pass-names", "--print-pass-options",
+  "--print-passes=", "--profile-code-layout", "--profile-file=", "--reuse-oat=", "--swap-fd=",
+  "--swap-file=", "--watch-dog", "--zip-fd=", "--zip-location=", "-j",
+};
+
+// Returns the command line options that may affect the generated code, used as part of the key
+// of every compile cache entry.
+static std::string CompileCacheOptions() {
+  std::vector<std::string> options;
+  for (int i = 1; i < original_argc; ++i) {
+    const StringPiece option(original_argv[i]);
+    if (option == "--runtime-arg") {
+      ++i;
+      continue;
+    }
+    bool ignored = false;
+    for (const char* ignored_option : kCompileCacheIgnoredOptions) {
+      if (option.starts_with(ignored_option)) {
+        ignored = true;
+        break;
+      }
+    }
+    if (!ignored) {
+      options.push_back(option.ToString());
+    }
+  }
+  return Join(options, ' ');
+}
+
 static void UsageErrorV(const char* fmt, va_list ap) {
   std::string error;
   StringAppendV(&error, fmt, ap);
@@ -210,6 +260,10 @@ static void Usage(const char* fmt, ...) {
   UsageError("");
   UsageError("  --dump-timing: display a breakdown of where time was spent");
   UsageError("");
+  UsageError("  --dump-stats-json=<file-name>: write the phase timings, the slowest methods,");
+  UsageError("      arena peaks, dedupe hit rates and backend counts to a JSON file.");
+  UsageError("      Example: --dump-stats-json=/tmp/dex2oat-stats.json");
+  UsageError("");
   UsageError("  --include-patch-information: Include patching information so the generated code");
   UsageError("      can have its base address moved without full recompilation.");
   UsageError("");
@@ -226,6 +280,10 @@ static void Usage(const char* fmt, ...) {
   UsageError("");
   UsageError("  --profile-file=<filename>: specify profiler output file to use for compilation.");
   UsageError("");
+  UsageError("  --profile-code-layout: place the code of the methods sampled in the profile at");
+  UsageError("      the start of the code section, hottest first, followed by the remaining code");
+  UsageError("      and finally the JNI stubs. Requires --profile-file.");
+  UsageError("");
   UsageError("  --print-pass-names: print a list of pass names");
 #ifndef HAVE_ANDROID_OS
   UsageError("");
@@ -241,6 +299,18 @@ static void Usage(const char* fmt, ...) {
   UsageError("  --swap-fd=<file-descriptor>:  specifies a file to use for swap (by descriptor).");
   UsageError("      Example: --swap-fd=10");
   UsageError("");
+  UsageError("  --reuse-oat=<file.oat>: specifies a previous oat file of the same dex files whose");
+  UsageError("      code is reused for methods that did not change. Must differ from --oat-file.");
+  UsageError("      Example: --reuse-oat=/data/tmp/previous.oat");
+  UsageError("");
+  UsageError("  --compile-cache-dir=<directory>: specifies a directory caching compiled methods");
+  UsageError("      across invocations, keyed by the code and everything it refers to.");
+  UsageError("      Example: --compile-cache-dir=/tmp/dex2oat-cache");
+  UsageError("");
+  UsageError("  --compile-time-budget=<milliseconds>: compiles hot and cheap methods first and");
+  UsageError("      leaves the remaining methods interpret-only once the budget is exhausted.");
+  UsageError("      Example: --compile-time-budget=60000");
+  UsageError("");
   UsageError("  --print-pass-options: print a list of passes that have configurable options along "
              "with the setting.");
   UsageError("      Will print default if no overridden setting exists.");
@@ -381,6 +451,10 @@ class Dex2Oat {
                                       CumulativeLogger& compiler_phases_timings,
                                       int swap_fd,
                                       std::string profile_file,
+                                      const std::string& reuse_oat_filename,
+                                      const std::string& compile_cache_dir,
+                                      int compile_time_budget_ms,
+                                      bool collect_compile_stats,
                                       SafeMap<std::string, std::string>* key_value_store) {
     CHECK(key_value_store != nullptr);
 
@@ -420,6 +494,44 @@ class Dex2Oat {
 
     driver->GetCompiler()->SetBitcodeFileName(*driver.get(), bitcode_filename);
 
+    if (!reuse_oat_filename.empty()) {
+      TimingLogger::ScopedTiming t("Opening reusable oat file", &timings);
+      const ImageHeader& image_header =
+          Runtime::Current()->GetHeap()->GetImageSpace()->GetImageHeader();
+      std::string error_msg;
+      ReusableOatFile* reusable_oat_file = ReusableOatFile::Open(reuse_oat_filename,
+                                                                 instruction_set_,
+                                                                 instruction_set_features_,
+                                                                 image_header.GetOatChecksum(),
+                                                                 &error_msg);
+      if (reusable_oat_file == nullptr) {
+        LOG(WARNING) << "Not reusing code from " << reuse_oat_filename << ": " << error_msg;
+      } else {
+        driver->SetReusableOatFile(reusable_oat_file);
+      }
+    }
+
+    if (!compile_cache_dir.empty()) {
+      const ImageHeader& image_header =
+          Runtime::Current()->GetHeap()->GetImageSpace()->GetImageHeader();
+      std::string configuration =
+          StringPrintf("oat %s isa %s features %s boot %08x ",
+                       reinterpret_cast<const char*>(OatHeader::kOatVersion),
+                       GetInstructionSetString(instruction_set_),
+                       instruction_set_features_.GetFeatureString().c_str(),
+                       image_header.GetOatChecksum());
+      configuration += CompileCacheOptions();
+      driver->SetCompileCache(new CompileCache(compile_cache_dir, configuration));
+    }
+
+    if (compile_time_budget_ms != 0) {
+      driver->SetCompileTimeBudget(new CompileTimeBudget(compile_time_budget_ms));
+    }
+
+    if (collect_compile_stats) {
+      driver->SetCompileStats(new CompileStats());
+    }
+
     driver->CompileAll(class_loader, dex_files, &timings);
 
     TimingLogger::ScopedTiming t2("dex2oat OatWriter", &timings);
@@ -888,6 +1000,7 @@ static int dex2oat(int argc, char** argv) {
       : Compiler::kQuick;
   const char* compiler_filter_string = nullptr;
   bool compile_pic = false;
+  bool profile_code_layout = false;
   int huge_method_threshold = CompilerOptions::kDefaultHugeMethodThreshold;
   int large_method_threshold = CompilerOptions::kDefaultLargeMethodThreshold;
   int small_method_threshold = CompilerOptions::kDefaultSmallMethodThreshold;
@@ -952,6 +1065,10 @@ static int dex2oat(int argc, char** argv) {
   // Swap file.
   std::string swap_file_name;
   int swap_fd = -1;  // No swap file descriptor;
+  std::string reuse_oat_filename;
+  std::string compile_cache_dir;
+  int compile_time_budget_ms = 0;
+  std::string dump_stats_json_filename;
 
   for (int i = 0; i < argc; i++) {
     const StringPiece option(argv[i]);
@@ -1110,6 +1227,8 @@ static int dex2oat(int argc, char** argv) {
       dump_passes = true;
     } else if (option == "--dump-stats") {
       dump_stats = true;
+    } else if (option.starts_with("--dump-stats-json=")) {
+      dump_stats_json_filename = option.substr(strlen("--dump-stats-json=")).data();
     } else if (option == "--include-debug-symbols" || option == "--no-strip-symbols") {
       include_debug_symbols = true;
     } else if (option == "--no-include-debug-symbols" || option == "--strip-symbols") {
@@ -1120,6 +1239,8 @@ static int dex2oat(int argc, char** argv) {
       VLOG(compiler) << "dex2oat: profile file is " << profile_file;
     } else if (option == "--no-profile-file") {
       // No profile
+    } else if (option == "--profile-code-layout") {
+      profile_code_layout = true;
     } else if (option.starts_with("--top-k-profile-threshold=")) {
       ParseDouble(option.data(), '=', 0.0, 100.0, &top_k_profile_threshold);
     } else if (option == "--use-selectivity-analysis") {
@@ -1151,6 +1272,18 @@ static int dex2oat(int argc, char** argv) {
       include_patch_information = false;
     } else if (option.starts_with("--swap-file=")) {
       swap_file_name = option.substr(strlen("--swap-file=")).data();
+    } else if (option.starts_with("--compile-cache-dir=")) {
+      compile_cache_dir = option.substr(strlen("--compile-cache-dir=")).data();
+    } else if (option.starts_with("--compile-time-budget=")) {
+      const char* budget = option.substr(strlen("--compile-time-budget=")).data();
+      if (!ParseInt(budget, &compile_time_budget_ms)) {
+        Usage("Failed to parse --compile-time-budget '%s' as an integer", budget);
+      }
+      if (compile_time_budget_ms <= 0) {
+        Usage("--compile-time-budget passed a non-positive value %d", compile_time_budget_ms);
+      }
+    } else if (option.starts_with("--reuse-oat=")) {
+      reuse_oat_filename = option.substr(strlen("--reuse-oat=")).data();
     } else if (option.starts_with("--swap-fd=")) {
       const char* swap_fd_str = option.substr(strlen("--swap-fd=")).data();
       if (!ParseInt(swap_fd_str, &swap_fd)) {
@@ -1257,6 +1390,40 @@ static int dex2oat(int argc, char** argv) {
     }
   }
 
+  if (!reuse_oat_filename.empty()) {
+    if (image) {
+      Usage("--reuse-oat should not be used with --image");
+    }
+    if (compile_pic) {
+      Usage("--reuse-oat should not be used with --compile-pic");
+    }
+    if (include_patch_information) {
+      Usage("--reuse-oat should not be used with --include-patch-information");
+    }
+    if (reuse_oat_filename == oat_filename) {
+      Usage("--reuse-oat should not be the same file as --oat-file");
+    }
+  }
+
+  if (profile_code_layout && profile_file.empty()) {
+    Usage("--profile-code-layout requires --profile-file");
+  }
+
+  if (!compile_cache_dir.empty()) {
+    if (image) {
+      Usage("--compile-cache-dir should not be used with --image");
+    }
+    if (compile_pic) {
+      Usage("--compile-cache-dir should not be used with --compile-pic");
+    }
+    if (include_patch_information) {
+      Usage("--compile-cache-dir should not be used with --include-patch-information");
+    }
+    if (!OS::DirectoryExists(compile_cache_dir.c_str())) {
+      Usage("--compile-cache-dir '%s' is not a directory", compile_cache_dir.c_str());
+    }
+  }
+
   std::string oat_stripped(oat_filename);
   std::string oat_unstripped;
   if (!oat_symbols.empty()) {
@@ -1354,7 +1521,8 @@ static int dex2oat(int argc, char** argv) {
                                                                         implicit_null_checks,
                                                                         implicit_so_checks,
                                                                         implicit_suspend_checks,
-                                                                        compile_pic
+                                                                        compile_pic,
+                                                                        profile_code_layout
 #ifdef ART_SEA_IR_MODE
                                                                         , compiler_options.sea_ir_ =
                                                                               true;
@@ -1622,6 +1790,7 @@ static int dex2oat(int argc, char** argv) {
     key_value_store->Put(OatHeader::kPicKey, compile_pic ? "true" : "false");
   }
 
+  const bool collect_compile_stats = !dump_stats_json_filename.empty();
   std::unique_ptr<const CompilerDriver> compiler(dex2oat->CreateOatFile(boot_image_option,
                                                                         android_root,
                                                                         is_host,
@@ -1638,6 +1807,10 @@ static int dex2oat(int argc, char** argv) {
                                                                         compiler_phases_timings,
                                                                         swap_fd,
                                                                         profile_file,
+                                                                        reuse_oat_filename,
+                                                                        compile_cache_dir,
+                                                                        compile_time_budget_ms,
+                                                                        collect_compile_stats,
                                                                         key_value_store.get()));
   if (compiler.get() == nullptr) {
     LOG(ERROR) << "Failed to create oat file: " << oat_location;
@@ -1723,10 +1896,19 @@ static int dex2oat(int argc, char** argv) {
     timings.EndTiming();
     if (dump_timing || (dump_slow_timing && timings.GetTotalNs() > MsToNs(1000))) {
       LOG(INFO) << Dumpable<TimingLogger>(timings);
+      if (compiler->GetCompileCache() != nullptr) {
+        LOG(INFO) << compiler->GetCompileCache()->DumpStats();
+      }
+      if (compiler->GetSwapSpace() != nullptr) {
+        LOG(INFO) << compiler->GetSwapSpace()->DumpStats();
+      }
     }
     if (dump_passes) {
       LOG(INFO) << Dumpable<CumulativeLogger>(*compiler.get()->GetTimingsLogger());
     }
+    if (!dump_stats_json_filename.empty()) {
+      DumpStatsJson(*compiler.get(), timings, dump_stats_json_filename);
+    }
     return EXIT_SUCCESS;
   }
 
@@ -1790,10 +1972,19 @@ static int dex2oat(int argc, char** argv) {
 
   if (dump_timing || (dump_slow_timing && timings.GetTotalNs() > MsToNs(1000))) {
     LOG(INFO) << Dumpable<TimingLogger>(timings);
+    if (compiler->GetCompileCache() != nullptr) {
+      LOG(INFO) << compiler->GetCompileCache()->DumpStats();
+    }
+    if (compiler->GetSwapSpace() != nullptr) {
+      LOG(INFO) << compiler->GetSwapSpace()->DumpStats();
+    }
   }
   if (dump_passes) {
     LOG(INFO) << Dumpable<CumulativeLogger>(compiler_phases_timings);
   }
+  if (!dump_stats_json_filename.empty()) {
+    DumpStatsJson(*compiler.get(), timings, dump_stats_json_filename);
+  }
 
   dex2oat->LogCompletionTime(compiler.get());
   // Everything was successfully written, do an explicit exit here to avoid running Runtime
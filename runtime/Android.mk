@@ -138,6 +138,7 @@ LIBART_COMMON_SRC_FILES := \
   primitive.cc \
   quick_exception_handler.cc \
   quick/inline_method_analyser.cc \
+  read_barrier.cc \
   reference_table.cc \
   reflection.cc \
   runtime.cc \
@@ -60,6 +60,7 @@ enum LockLevel {
   kThreadSuspendCountLock,
   kAbortLock,
   kJdwpSocketLock,
+  kMarkSweepMarkStackLock,
   kReferenceQueueSoftReferencesLock,
   kReferenceQueuePhantomReferencesLock,
   kReferenceQueueFinalizerReferencesLock,
@@ -72,7 +73,6 @@ enum LockLevel {
   kAllocSpaceLock,
   kDexFileMethodInlinerLock,
   kDexFileToMethodInlinerMapLock,
-  kMarkSweepMarkStackLock,
   kTransactionLogLock,
   kInternTableLock,
   kOatFileSecondaryLookupLock,
@@ -764,6 +764,26 @@ int32_t DexFile::FindCatchHandlerOffset(const CodeItem &code_item, uint32_t addr
   }
 }
 
+size_t DexFile::GetCodeItemBodySize(const CodeItem& code_item) {
+  const byte* begin = reinterpret_cast<const byte*>(code_item.insns_);
+  if (code_item.tries_size_ == 0) {
+    return code_item.insns_size_in_code_units_ * sizeof(uint16_t);
+  }
+  const byte* ptr = GetCatchHandlerData(code_item, 0);
+  uint32_t handlers_size = DecodeUnsignedLeb128(&ptr);
+  for (uint32_t i = 0; i != handlers_size; ++i) {
+    int32_t size = DecodeSignedLeb128(&ptr);
+    for (int32_t j = 0, e = (size < 0) ? -size : size; j != e; ++j) {
+      DecodeUnsignedLeb128(&ptr);  // Type index.
+      DecodeUnsignedLeb128(&ptr);  // Handler address.
+    }
+    if (size <= 0) {
+      DecodeUnsignedLeb128(&ptr);  // Catch-all handler address.
+    }
+  }
+  return ptr - begin;
+}
+
 void DexFile::DecodeDebugInfo0(const CodeItem* code_item, bool is_static, uint32_t method_idx,
                                DexDebugNewPositionCb position_cb, DexDebugNewLocalCb local_cb,
                                void* context, const byte* stream, LocalInfo* local_in_reg) const {
@@ -762,6 +762,10 @@ class DexFile {
   // Find the handler offset associated with the given address (ie dex pc). Returns -1 if none.
   static int32_t FindCatchHandlerOffset(const CodeItem &code_item, uint32_t address);
 
+  // Get the size in bytes of the instructions, try items and catch handlers of a code item, i.e.
+  // everything that follows the code item header.
+  static size_t GetCodeItemBodySize(const CodeItem& code_item);
+
   // Get the pointer to the start of the debugging data
   const byte* GetDebugInfoStream(const CodeItem* code_item) const {
     if (code_item->debug_info_off_ == 0) {
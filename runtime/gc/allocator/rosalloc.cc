@@ -22,8 +22,10 @@
 #include "thread_list.h"
 #include "rosalloc.h"
 
+#include <algorithm>
 #include <map>
 #include <list>
+#include <sched.h>
 #include <vector>
 
 namespace art {
@@ -48,17 +50,20 @@ RosAlloc::Run* RosAlloc::dedicated_full_run_ =
     reinterpret_cast<RosAlloc::Run*>(dedicated_full_run_storage_);
 
 RosAlloc::RosAlloc(void* base, size_t capacity, size_t max_capacity,
-                   PageReleaseMode page_release_mode, size_t page_release_size_threshold)
+                   PageReleaseMode page_release_mode, size_t page_release_size_threshold,
+                   size_t num_thread_local_size_brackets)
     : base_(reinterpret_cast<byte*>(base)), footprint_(capacity),
       capacity_(capacity), max_capacity_(max_capacity),
       lock_("rosalloc global lock", kRosAllocGlobalLock),
       bulk_free_lock_("rosalloc bulk free lock", kRosAllocBulkFreeLock),
+      num_thread_local_size_brackets_(num_thread_local_size_brackets),
       page_release_mode_(page_release_mode),
       page_release_size_threshold_(page_release_size_threshold) {
   DCHECK_EQ(RoundUp(capacity, kPageSize), capacity);
   DCHECK_EQ(RoundUp(max_capacity, kPageSize), max_capacity);
   CHECK_LE(capacity, max_capacity);
   CHECK(IsAligned<kPageSize>(page_release_size_threshold_));
+  CHECK_LE(num_thread_local_size_brackets_, kNumOfSizeBrackets);
   if (!initialized_) {
     Initialize();
   }
@@ -527,7 +532,34 @@ size_t RosAlloc::FreeInternal(Thread* self, void* ptr) {
   return FreeFromRun(self, ptr, run);
 }
 
+RosAlloc::Run* RosAlloc::GetRunUnlocked(void* ptr) {
+  DCHECK_LE(base_, ptr);
+  DCHECK_LT(ptr, base_ + footprint_);
+  size_t pm_idx = RoundDownToPageMapIndex(ptr);
+  byte page_map_entry = page_map_[pm_idx];
+  if (LIKELY(page_map_entry == kPageMapRunPart)) {
+    // Find the beginning of the run.
+    do {
+      --pm_idx;
+      DCHECK_LT(pm_idx, capacity_ / kPageSize);
+    } while (page_map_[pm_idx] != kPageMapRun);
+  } else if (page_map_entry != kPageMapRun) {
+    DCHECK_EQ(page_map_entry, kPageMapLargeObject);
+    return nullptr;
+  }
+  Run* run = reinterpret_cast<Run*>(base_ + pm_idx * kPageSize);
+  DCHECK_EQ(run->magic_num_, kMagicNum);
+  return run;
+}
+
 size_t RosAlloc::Free(Thread* self, void* ptr) {
+  // Freeing a slot of a thread-local run only marks the thread-local free bit map, which the
+  // owner thread merges when the run gets full. Do it without any lock so that the frees of
+  // the slots allocated by other threads don't contend with their allocations.
+  Run* run = GetRunUnlocked(ptr);
+  if (run != nullptr && run->TryMarkThreadLocalFreeBitMapUnlocked(ptr)) {
+    return bracketSizes[run->size_bracket_idx_];
+  }
   ReaderMutexLock rmu(self, bulk_free_lock_);
   return FreeInternal(self, ptr);
 }
@@ -547,7 +579,7 @@ RosAlloc::Run* RosAlloc::AllocRun(Thread* self, size_t idx) {
     DCHECK(!new_run->IsThreadLocal());
     DCHECK_EQ(new_run->first_search_vec_idx_, 0U);
     DCHECK(!new_run->to_be_bulk_freed_);
-    if (kUsePrefetchDuringAllocRun && idx < kNumThreadLocalSizeBrackets) {
+    if (kUsePrefetchDuringAllocRun && idx < num_thread_local_size_brackets_) {
       // Take ownership of the cache lines if we are likely to be thread local run.
       if (kPrefetchNewRunDataByZeroing) {
         // Zeroing the data is sometimes faster than prefetching but it increases memory usage
@@ -650,7 +682,7 @@ void* RosAlloc::AllocFromRun(Thread* self, size_t size, size_t* bytes_allocated)
 
   void* slot_addr;
 
-  if (LIKELY(idx < kNumThreadLocalSizeBrackets)) {
+  if (LIKELY(idx < num_thread_local_size_brackets_)) {
     // Use a thread-local run.
     Run* thread_local_run = reinterpret_cast<Run*>(self->GetRosAllocRun(idx));
     // Allow invalid since this will always fail the allocation.
@@ -686,16 +718,12 @@ void* RosAlloc::AllocFromRun(Thread* self, size_t size, size_t* bytes_allocated)
         DCHECK(thread_local_run->IsFull());
         if (thread_local_run != dedicated_full_run_) {
           thread_local_run->SetIsThreadLocal(false);
-          if (kIsDebugBuild) {
-            full_runs_[idx].insert(thread_local_run);
-            if (kTraceRosAlloc) {
-              LOG(INFO) << "RosAlloc::AllocFromRun() : Inserted run 0x" << std::hex
-                        << reinterpret_cast<intptr_t>(thread_local_run)
-                        << " into full_runs_[" << std::dec << idx << "]";
-            }
-          }
+          // Merge the slots that were freed without the lock since the merge above. The run
+          // is then full, unless one of these frees came in.
+          thread_local_run->MergeThreadLocalFreeBitMapToAllocBitMap(&is_all_free_after_merge);
           DCHECK(non_full_runs_[idx].find(thread_local_run) == non_full_runs_[idx].end());
-          DCHECK(full_runs_[idx].find(thread_local_run) != full_runs_[idx].end());
+          DCHECK(full_runs_[idx].find(thread_local_run) == full_runs_[idx].end());
+          RevokeRun(self, idx, thread_local_run);
         }
 
         thread_local_run = RefillRun(self, idx);
@@ -754,7 +782,7 @@ size_t RosAlloc::FreeFromRun(Thread* self, void* ptr, Run* run) {
   }
   if (LIKELY(run->IsThreadLocal())) {
     // It's a thread-local run. Just mark the thread-local free bit map and return.
-    DCHECK_LT(run->size_bracket_idx_, kNumThreadLocalSizeBrackets);
+    DCHECK_LT(run->size_bracket_idx_, num_thread_local_size_brackets_);
     DCHECK(non_full_runs_[idx].find(run) == non_full_runs_[idx].end());
     DCHECK(full_runs_[idx].find(run) == full_runs_[idx].end());
     run->MarkThreadLocalFreeBitMap(ptr);
@@ -878,7 +906,7 @@ inline void* RosAlloc::Run::AllocSlot() {
       return slot_addr;
     }
     const size_t num_words = RoundUp(numOfSlots[idx], 32) / 32;
-    if (first_search_vec_idx_ + 1 >= num_words) {
+    if (first_search_vec_idx_ + 1U >= num_words) {
       DCHECK(IsFull());
       // Already at the last word, return null.
       return nullptr;
@@ -904,7 +932,7 @@ void RosAlloc::Run::FreeSlot(void* ptr) {
   }
   size_t vec_off = slot_idx % 32;
   uint32_t* vec = &alloc_bit_map_[vec_idx];
-  first_search_vec_idx_ = std::min(first_search_vec_idx_, static_cast<uint32_t>(vec_idx));
+  first_search_vec_idx_ = std::min(first_search_vec_idx_, static_cast<uint16_t>(vec_idx));
   const uint32_t mask = 1U << vec_off;
   DCHECK_NE(*vec & mask, 0U);
   *vec &= ~mask;
@@ -919,7 +947,6 @@ void RosAlloc::Run::FreeSlot(void* ptr) {
 }
 
 inline bool RosAlloc::Run::MergeThreadLocalFreeBitMapToAllocBitMap(bool* is_all_free_after_out) {
-  DCHECK(IsThreadLocal());
   // Free slots in the alloc bit map based on the thread local free bit map.
   const size_t idx = size_bracket_idx_;
   const size_t num_of_slots = numOfSlots[idx];
@@ -929,15 +956,19 @@ inline bool RosAlloc::Run::MergeThreadLocalFreeBitMapToAllocBitMap(bool* is_all_
   uint32_t* tl_free_vecp = &ThreadLocalFreeBitMap()[0];
   bool is_all_free_after = true;
   for (size_t v = 0; v < num_vec; v++, vecp++, tl_free_vecp++) {
-    uint32_t tl_free_vec = *tl_free_vecp;
+    // Other threads may set bits without the lock, read and clear the word atomically.
+    Atomic<uint32_t>* atomic_tl_free_vecp = reinterpret_cast<Atomic<uint32_t>*>(tl_free_vecp);
+    uint32_t tl_free_vec = atomic_tl_free_vecp->LoadRelaxed();
+    if (tl_free_vec != 0) {
+      tl_free_vec = atomic_tl_free_vecp->FetchAndAndSequentiallyConsistent(0);
+    }
     uint32_t vec_before = *vecp;
     uint32_t vec_after;
     if (tl_free_vec != 0) {
-      first_search_vec_idx_ = std::min(first_search_vec_idx_, static_cast<uint32_t>(v));
+      first_search_vec_idx_ = std::min(first_search_vec_idx_, static_cast<uint16_t>(v));
       vec_after = vec_before & ~tl_free_vec;
       *vecp = vec_after;
       changed = true;
-      *tl_free_vecp = 0;  // clear the thread local free bit map.
     } else {
       vec_after = vec_before;
     }
@@ -950,7 +981,6 @@ inline bool RosAlloc::Run::MergeThreadLocalFreeBitMapToAllocBitMap(bool* is_all_
         is_all_free_after = false;
       }
     }
-    DCHECK_EQ(*tl_free_vecp, static_cast<uint32_t>(0));
   }
   *is_all_free_after_out = is_all_free_after;
   // Return true if there was at least a bit set in the thread-local
@@ -967,7 +997,7 @@ inline void RosAlloc::Run::MergeBulkFreeBitMapIntoAllocBitMap() {
   for (size_t v = 0; v < num_vec; v++, vecp++, free_vecp++) {
     uint32_t free_vec = *free_vecp;
     if (free_vec != 0) {
-      first_search_vec_idx_ = std::min(first_search_vec_idx_, static_cast<uint32_t>(v));
+      first_search_vec_idx_ = std::min(first_search_vec_idx_, static_cast<uint16_t>(v));
       *vecp &= ~free_vec;
       *free_vecp = 0;  // clear the bulk free bit map.
     }
@@ -984,7 +1014,8 @@ inline void RosAlloc::Run::UnionBulkFreeBitMapToThreadLocalFreeBitMap() {
   for (size_t v = 0; v < num_vec; v++, to_vecp++, from_vecp++) {
     uint32_t from_vec = *from_vecp;
     if (from_vec != 0) {
-      *to_vecp |= from_vec;
+      // Other threads may set bits of the thread local free bit map without the lock.
+      reinterpret_cast<Atomic<uint32_t>*>(to_vecp)->FetchAndOrSequentiallyConsistent(from_vec);
       *from_vecp = 0;  // clear the bulk free bit map.
     }
     DCHECK_EQ(*from_vecp, static_cast<uint32_t>(0));
@@ -993,15 +1024,42 @@ inline void RosAlloc::Run::UnionBulkFreeBitMapToThreadLocalFreeBitMap() {
 
 inline void RosAlloc::Run::MarkThreadLocalFreeBitMap(void* ptr) {
   DCHECK(IsThreadLocal());
-  MarkFreeBitMapShared(ptr, ThreadLocalFreeBitMap(), "MarkThreadLocalFreeBitMap");
+  MarkFreeBitMapShared(ptr, ThreadLocalFreeBitMap(), true, "MarkThreadLocalFreeBitMap");
+}
+
+bool RosAlloc::Run::TryMarkThreadLocalFreeBitMapUnlocked(void* ptr) {
+  Atomic<byte>* is_thread_local = reinterpret_cast<Atomic<byte>*>(&is_thread_local_);
+  if (is_thread_local->LoadRelaxed() == 0) {
+    // Not thread local, avoid the atomic operations below.
+    return false;
+  }
+  // Announce the free before checking that the run is thread-local. SetIsThreadLocal(false)
+  // clears the flag before waiting for the announced frees, so either this free sees the run
+  // as not thread-local, or the thread that clears the flag merges the bit set here.
+  Atomic<uint16_t>* unlocked_frees = reinterpret_cast<Atomic<uint16_t>*>(&unlocked_frees_);
+  unlocked_frees->FetchAndAddSequentiallyConsistent(1);
+  bool marked = is_thread_local->LoadSequentiallyConsistent() != 0;
+  if (marked) {
+    MarkFreeBitMapShared(ptr, ThreadLocalFreeBitMap(), true, "MarkThreadLocalFreeBitMapUnlocked");
+  }
+  unlocked_frees->FetchAndSubSequentiallyConsistent(1);
+  return marked;
+}
+
+void RosAlloc::Run::WaitForUnlockedFrees() {
+  Atomic<uint16_t>* unlocked_frees = reinterpret_cast<Atomic<uint16_t>*>(&unlocked_frees_);
+  // The frees only set a bit, they are not expected to take long.
+  while (unlocked_frees->LoadSequentiallyConsistent() != 0) {
+    sched_yield();
+  }
 }
 
 inline size_t RosAlloc::Run::MarkBulkFreeBitMap(void* ptr) {
-  return MarkFreeBitMapShared(ptr, BulkFreeBitMap(), "MarkFreeBitMap");
+  return MarkFreeBitMapShared(ptr, BulkFreeBitMap(), false, "MarkFreeBitMap");
 }
 
 inline size_t RosAlloc::Run::MarkFreeBitMapShared(void* ptr, uint32_t* free_bit_map_base,
-                                                  const char* caller_name) {
+                                                  bool atomic, const char* caller_name) {
   const byte idx = size_bracket_idx_;
   const size_t offset_from_slot_base = reinterpret_cast<byte*>(ptr)
       - (reinterpret_cast<byte*>(this) + headerSizes[idx]);
@@ -1018,9 +1076,17 @@ inline size_t RosAlloc::Run::MarkFreeBitMapShared(void* ptr, uint32_t* free_bit_
   size_t vec_off = slot_idx % 32;
   uint32_t* vec = &free_bit_map_base[vec_idx];
   const uint32_t mask = 1U << vec_off;
-  DCHECK_EQ(*vec & mask, 0U);
-  *vec |= mask;
-  DCHECK_NE(*vec & mask, 0U);
+  if (atomic) {
+    // The owner of the run may concurrently merge and clear the vector, only the value returned
+    // by the atomic operation is meaningful.
+    uint32_t old_vec =
+        reinterpret_cast<Atomic<uint32_t>*>(vec)->FetchAndOrSequentiallyConsistent(mask);
+    DCHECK_EQ(old_vec & mask, 0U);
+  } else {
+    DCHECK_EQ(*vec & mask, 0U);
+    *vec |= mask;
+    DCHECK_NE(*vec & mask, 0U);
+  }
   if (kTraceRosAlloc) {
     LOG(INFO) << "RosAlloc::Run::" << caller_name << "() : 0x" << std::hex
               << reinterpret_cast<intptr_t>(ptr)
@@ -1109,7 +1175,8 @@ inline void RosAlloc::Run::ZeroData() {
 inline void RosAlloc::Run::FillAllocBitMap() {
   size_t num_vec = NumberOfBitmapVectors();
   memset(alloc_bit_map_, 0xFF, sizeof(uint32_t) * num_vec);
-  first_search_vec_idx_ = num_vec - 1;  // No free bits in any of the bitmap words.
+  // No free bits in any of the bitmap words.
+  first_search_vec_idx_ = static_cast<uint16_t>(num_vec - 1);
 }
 
 void RosAlloc::Run::InspectAllSlots(void (*handler)(void* start, void* end, size_t used_bytes, void* callback_arg),
@@ -1153,21 +1220,27 @@ size_t RosAlloc::BulkFree(Thread* self, void** ptrs, size_t num_ptrs) {
     return freed_bytes;
   }
 
-  WriterMutexLock wmu(self, bulk_free_lock_);
+  // Concurrent bulk frees, such as those of the ranges of a parallel sweep, share the lock. The
+  // bulk free bit map of a run is only used with the lock of its size bracket held, so that a
+  // bulk free cannot free the run while another one still has slots to free in it.
+  ReaderMutexLock rmu(self, bulk_free_lock_);
 
-  // First mark slots to free in the bulk free bit map without locking the
-  // size bracket locks. On host, unordered_set is faster than vector + flag.
-#ifdef HAVE_ANDROID_OS
-  std::vector<Run*> runs;
-#else
-  std::unordered_set<Run*, hash_run, eq_run> runs;
-#endif
+  // Sort the slots so that those of a run are contiguous, each run is then locked once.
+  std::sort(ptrs, ptrs + num_ptrs);
+  Run* run = nullptr;
+  size_t run_begin = 0;
   for (size_t i = 0; i < num_ptrs; i++) {
     void* ptr = ptrs[i];
     DCHECK_LE(base_, ptr);
     DCHECK_LT(ptr, base_ + footprint_);
+    if (run != nullptr) {
+      if (ptr < run->End()) {
+        continue;
+      }
+      freed_bytes += BulkFreeRun(self, run, ptrs + run_begin, i - run_begin);
+      run = nullptr;
+    }
     size_t pm_idx = RoundDownToPageMapIndex(ptr);
-    Run* run = nullptr;
     if (kReadPageMapEntryWithoutLockInBulkFree) {
       // Read the page map entries without locking the lock.
       byte page_map_entry = page_map_[pm_idx];
@@ -1222,124 +1295,117 @@ size_t RosAlloc::BulkFree(Thread* self, void** ptrs, size_t num_ptrs) {
     }
     DCHECK(run != nullptr);
     DCHECK_EQ(run->magic_num_, kMagicNum);
-    // Set the bit in the bulk free bit map.
-    freed_bytes += run->MarkBulkFreeBitMap(ptr);
-#ifdef HAVE_ANDROID_OS
-    if (!run->to_be_bulk_freed_) {
-      run->to_be_bulk_freed_ = true;
-      runs.push_back(run);
-    }
-#else
-    runs.insert(run);
-#endif
-  }
-
-  // Now, iterate over the affected runs and update the alloc bit map
-  // based on the bulk free bit map (for non-thread-local runs) and
-  // union the bulk free bit map into the thread-local free bit map
-  // (for thread-local runs.)
-  for (Run* run : runs) {
-#ifdef HAVE_ANDROID_OS
-    DCHECK(run->to_be_bulk_freed_);
-    run->to_be_bulk_freed_ = false;
-#endif
-    size_t idx = run->size_bracket_idx_;
-    MutexLock mu(self, *size_bracket_locks_[idx]);
-    if (run->IsThreadLocal()) {
-      DCHECK_LT(run->size_bracket_idx_, kNumThreadLocalSizeBrackets);
-      DCHECK(non_full_runs_[idx].find(run) == non_full_runs_[idx].end());
-      DCHECK(full_runs_[idx].find(run) == full_runs_[idx].end());
-      run->UnionBulkFreeBitMapToThreadLocalFreeBitMap();
-      if (kTraceRosAlloc) {
-        LOG(INFO) << "RosAlloc::BulkFree() : Freed slot(s) in a thread local run 0x"
-                  << std::hex << reinterpret_cast<intptr_t>(run);
-      }
-      DCHECK(run->IsThreadLocal());
-      // A thread local run will be kept as a thread local even if
-      // it's become all free.
-    } else {
-      bool run_was_full = run->IsFull();
-      run->MergeBulkFreeBitMapIntoAllocBitMap();
-      if (kTraceRosAlloc) {
-        LOG(INFO) << "RosAlloc::BulkFree() : Freed slot(s) in a run 0x" << std::hex
-                  << reinterpret_cast<intptr_t>(run);
-      }
-      // Check if the run should be moved to non_full_runs_ or
-      // free_page_runs_.
-      std::set<Run*>* non_full_runs = &non_full_runs_[idx];
-      std::unordered_set<Run*, hash_run, eq_run>* full_runs =
-          kIsDebugBuild ? &full_runs_[idx] : NULL;
-      if (run->IsAllFree()) {
-        // It has just become completely free. Free the pages of the
-        // run.
-        bool run_was_current = run == current_runs_[idx];
-        if (run_was_current) {
-          DCHECK(full_runs->find(run) == full_runs->end());
-          DCHECK(non_full_runs->find(run) == non_full_runs->end());
-          // If it was a current run, reuse it.
-        } else if (run_was_full) {
-          // If it was full, remove it from the full run set (debug
-          // only.)
-          if (kIsDebugBuild) {
-            std::unordered_set<Run*, hash_run, eq_run>::iterator pos = full_runs->find(run);
-            DCHECK(pos != full_runs->end());
-            full_runs->erase(pos);
-            if (kTraceRosAlloc) {
-              LOG(INFO) << "RosAlloc::BulkFree() : Erased run 0x" << std::hex
-                        << reinterpret_cast<intptr_t>(run)
-                        << " from full_runs_";
-            }
-            DCHECK(full_runs->find(run) == full_runs->end());
-          }
-        } else {
-          // If it was in a non full run set, remove it from the set.
-          DCHECK(full_runs->find(run) == full_runs->end());
-          DCHECK(non_full_runs->find(run) != non_full_runs->end());
-          non_full_runs->erase(run);
+    run_begin = i;
+  }
+  if (run != nullptr) {
+    freed_bytes += BulkFreeRun(self, run, ptrs + run_begin, num_ptrs - run_begin);
+  }
+  return freed_bytes;
+}
+
+size_t RosAlloc::BulkFreeRun(Thread* self, Run* run, void** ptrs, size_t num_ptrs) {
+  size_t idx = run->size_bracket_idx_;
+  MutexLock mu(self, *size_bracket_locks_[idx]);
+  size_t freed_bytes = 0;
+  for (size_t i = 0; i < num_ptrs; i++) {
+    freed_bytes += run->MarkBulkFreeBitMap(ptrs[i]);
+  }
+  // Update the alloc bit map based on the bulk free bit map (for a non-thread-local run) or
+  // union the bulk free bit map into the thread-local free bit map (for a thread-local run.)
+  if (run->IsThreadLocal()) {
+    DCHECK_LT(run->size_bracket_idx_, num_thread_local_size_brackets_);
+    DCHECK(non_full_runs_[idx].find(run) == non_full_runs_[idx].end());
+    DCHECK(full_runs_[idx].find(run) == full_runs_[idx].end());
+    run->UnionBulkFreeBitMapToThreadLocalFreeBitMap();
+    if (kTraceRosAlloc) {
+      LOG(INFO) << "RosAlloc::BulkFree() : Freed slot(s) in a thread local run 0x"
+                << std::hex << reinterpret_cast<intptr_t>(run);
+    }
+    DCHECK(run->IsThreadLocal());
+    // A thread local run will be kept as a thread local even if
+    // it's become all free.
+  } else {
+    bool run_was_full = run->IsFull();
+    run->MergeBulkFreeBitMapIntoAllocBitMap();
+    if (kTraceRosAlloc) {
+      LOG(INFO) << "RosAlloc::BulkFree() : Freed slot(s) in a run 0x" << std::hex
+                << reinterpret_cast<intptr_t>(run);
+    }
+    // Check if the run should be moved to non_full_runs_ or
+    // free_page_runs_.
+    std::set<Run*>* non_full_runs = &non_full_runs_[idx];
+    std::unordered_set<Run*, hash_run, eq_run>* full_runs =
+        kIsDebugBuild ? &full_runs_[idx] : NULL;
+    if (run->IsAllFree()) {
+      // It has just become completely free. Free the pages of the
+      // run.
+      bool run_was_current = run == current_runs_[idx];
+      if (run_was_current) {
+        DCHECK(full_runs->find(run) == full_runs->end());
+        DCHECK(non_full_runs->find(run) == non_full_runs->end());
+        // If it was a current run, reuse it.
+      } else if (run_was_full) {
+        // If it was full, remove it from the full run set (debug
+        // only.)
+        if (kIsDebugBuild) {
+          std::unordered_set<Run*, hash_run, eq_run>::iterator pos = full_runs->find(run);
+          DCHECK(pos != full_runs->end());
+          full_runs->erase(pos);
           if (kTraceRosAlloc) {
             LOG(INFO) << "RosAlloc::BulkFree() : Erased run 0x" << std::hex
                       << reinterpret_cast<intptr_t>(run)
-                      << " from non_full_runs_";
+                      << " from full_runs_";
           }
-          DCHECK(non_full_runs->find(run) == non_full_runs->end());
-        }
-        if (!run_was_current) {
-          run->ZeroHeader();
-          MutexLock mu(self, lock_);
-          FreePages(self, run, true);
+          DCHECK(full_runs->find(run) == full_runs->end());
         }
       } else {
-        // It is not completely free. If it wasn't the current run or
-        // already in the non-full run set (i.e., it was full) insert
-        // it into the non-full run set.
-        if (run == current_runs_[idx]) {
-          DCHECK(non_full_runs->find(run) == non_full_runs->end());
-          DCHECK(full_runs->find(run) == full_runs->end());
-          // If it was a current run, keep it.
-        } else if (run_was_full) {
-          // If it was full, remove it from the full run set (debug
-          // only) and insert into the non-full run set.
-          DCHECK(full_runs->find(run) != full_runs->end());
-          DCHECK(non_full_runs->find(run) == non_full_runs->end());
-          if (kIsDebugBuild) {
-            full_runs->erase(run);
-            if (kTraceRosAlloc) {
-              LOG(INFO) << "RosAlloc::BulkFree() : Erased run 0x" << std::hex
-                        << reinterpret_cast<intptr_t>(run)
-                        << " from full_runs_";
-            }
-          }
-          non_full_runs->insert(run);
+        // If it was in a non full run set, remove it from the set.
+        DCHECK(full_runs->find(run) == full_runs->end());
+        DCHECK(non_full_runs->find(run) != non_full_runs->end());
+        non_full_runs->erase(run);
+        if (kTraceRosAlloc) {
+          LOG(INFO) << "RosAlloc::BulkFree() : Erased run 0x" << std::hex
+                    << reinterpret_cast<intptr_t>(run)
+                    << " from non_full_runs_";
+        }
+        DCHECK(non_full_runs->find(run) == non_full_runs->end());
+      }
+      if (!run_was_current) {
+        run->ZeroHeader();
+        MutexLock mu(self, lock_);
+        FreePages(self, run, true);
+      }
+    } else {
+      // It is not completely free. If it wasn't the current run or
+      // already in the non-full run set (i.e., it was full) insert
+      // it into the non-full run set.
+      if (run == current_runs_[idx]) {
+        DCHECK(non_full_runs->find(run) == non_full_runs->end());
+        DCHECK(full_runs->find(run) == full_runs->end());
+        // If it was a current run, keep it.
+      } else if (run_was_full) {
+        // If it was full, remove it from the full run set (debug
+        // only) and insert into the non-full run set.
+        DCHECK(full_runs->find(run) != full_runs->end());
+        DCHECK(non_full_runs->find(run) == non_full_runs->end());
+        if (kIsDebugBuild) {
+          full_runs->erase(run);
           if (kTraceRosAlloc) {
-            LOG(INFO) << "RosAlloc::BulkFree() : Inserted run 0x" << std::hex
+            LOG(INFO) << "RosAlloc::BulkFree() : Erased run 0x" << std::hex
                       << reinterpret_cast<intptr_t>(run)
-                      << " into non_full_runs_[" << std::dec << idx;
+                      << " from full_runs_";
           }
-        } else {
-          // If it was not full, so leave it in the non full run set.
-          DCHECK(full_runs->find(run) == full_runs->end());
-          DCHECK(non_full_runs->find(run) != non_full_runs->end());
         }
+        non_full_runs->insert(run);
+        if (kTraceRosAlloc) {
+          LOG(INFO) << "RosAlloc::BulkFree() : Inserted run 0x" << std::hex
+                    << reinterpret_cast<intptr_t>(run)
+                    << " into non_full_runs_[" << std::dec << idx;
+        }
+      } else {
+        // If it was not full, so leave it in the non full run set.
+        DCHECK(full_runs->find(run) == full_runs->end());
+        DCHECK(non_full_runs->find(run) != non_full_runs->end());
       }
     }
   }
@@ -1650,7 +1716,7 @@ void RosAlloc::RevokeThreadLocalRuns(Thread* thread) {
   Thread* self = Thread::Current();
   // Avoid race conditions on the bulk free bit maps with BulkFree() (GC).
   ReaderMutexLock wmu(self, bulk_free_lock_);
-  for (size_t idx = 0; idx < kNumThreadLocalSizeBrackets; idx++) {
+  for (size_t idx = 0; idx < num_thread_local_size_brackets_; idx++) {
     MutexLock mu(self, *size_bracket_locks_[idx]);
     Run* thread_local_run = reinterpret_cast<Run*>(thread->GetRosAllocRun(idx));
     CHECK(thread_local_run != nullptr);
@@ -1659,10 +1725,11 @@ void RosAlloc::RevokeThreadLocalRuns(Thread* thread) {
     if (thread_local_run != dedicated_full_run_) {
       thread->SetRosAllocRun(idx, dedicated_full_run_);
       DCHECK_EQ(thread_local_run->magic_num_, kMagicNum);
-      // Note the thread local run may not be full here.
+      // Note the thread local run may not be full here. Stop the frees without the lock
+      // before merging their bits.
+      thread_local_run->SetIsThreadLocal(false);
       bool dont_care;
       thread_local_run->MergeThreadLocalFreeBitMapToAllocBitMap(&dont_care);
-      thread_local_run->SetIsThreadLocal(false);
       thread_local_run->MergeBulkFreeBitMapIntoAllocBitMap();
       DCHECK(non_full_runs_[idx].find(thread_local_run) == non_full_runs_[idx].end());
       DCHECK(full_runs_[idx].find(thread_local_run) == full_runs_[idx].end());
@@ -1702,7 +1769,7 @@ void RosAlloc::RevokeRun(Thread* self, size_t idx, Run* run) {
 void RosAlloc::RevokeThreadUnsafeCurrentRuns() {
   // Revoke the current runs which share the same idx as thread local runs.
   Thread* self = Thread::Current();
-  for (size_t idx = 0; idx < kNumThreadLocalSizeBrackets; ++idx) {
+  for (size_t idx = 0; idx < num_thread_local_size_brackets_; ++idx) {
     MutexLock mu(self, *size_bracket_locks_[idx]);
     if (current_runs_[idx] != dedicated_full_run_) {
       RevokeRun(self, idx, current_runs_[idx]);
@@ -1728,7 +1795,7 @@ void RosAlloc::AssertThreadLocalRunsAreRevoked(Thread* thread) {
     Thread* self = Thread::Current();
     // Avoid race conditions on the bulk free bit maps with BulkFree() (GC).
     ReaderMutexLock wmu(self, bulk_free_lock_);
-    for (size_t idx = 0; idx < kNumThreadLocalSizeBrackets; idx++) {
+    for (size_t idx = 0; idx < num_thread_local_size_brackets_; idx++) {
       MutexLock mu(self, *size_bracket_locks_[idx]);
       Run* thread_local_run = reinterpret_cast<Run*>(thread->GetRosAllocRun(idx));
       DCHECK(thread_local_run == nullptr || thread_local_run == dedicated_full_run_);
@@ -1745,7 +1812,7 @@ void RosAlloc::AssertAllThreadLocalRunsAreRevoked() {
     for (Thread* t : thread_list) {
       AssertThreadLocalRunsAreRevoked(t);
     }
-    for (size_t idx = 0; idx < kNumThreadLocalSizeBrackets; ++idx) {
+    for (size_t idx = 0; idx < num_thread_local_size_brackets_; ++idx) {
       MutexLock mu(self, *size_bracket_locks_[idx]);
       CHECK_EQ(current_runs_[idx], dedicated_full_run_);
     }
@@ -1967,7 +2034,7 @@ void RosAlloc::Verify() {
   }
   std::list<Thread*> threads = Runtime::Current()->GetThreadList()->GetList();
   for (Thread* thread : threads) {
-    for (size_t i = 0; i < kNumThreadLocalSizeBrackets; ++i) {
+    for (size_t i = 0; i < num_thread_local_size_brackets_; ++i) {
       MutexLock mu(self, *size_bracket_locks_[i]);
       Run* thread_local_run = reinterpret_cast<Run*>(thread->GetRosAllocRun(i));
       CHECK(thread_local_run != nullptr);
@@ -2018,7 +2085,7 @@ void RosAlloc::Run::Verify(Thread* self, RosAlloc* rosalloc) {
     std::list<Thread*> thread_list = Runtime::Current()->GetThreadList()->GetList();
     for (auto it = thread_list.begin(); it != thread_list.end(); ++it) {
       Thread* thread = *it;
-      for (size_t i = 0; i < kNumThreadLocalSizeBrackets; i++) {
+      for (size_t i = 0; i < rosalloc->num_thread_local_size_brackets_; i++) {
         MutexLock mu(self, *rosalloc->size_bracket_locks_[i]);
         Run* thread_local_run = reinterpret_cast<Run*>(thread->GetRosAllocRun(i));
         if (thread_local_run == this) {
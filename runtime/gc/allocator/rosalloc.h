@@ -26,6 +26,7 @@
 #include <unordered_set>
 #include <vector>
 
+#include "atomic.h"
 #include "base/mutex.h"
 #include "base/logging.h"
 #include "globals.h"
@@ -153,16 +154,17 @@ class RosAlloc {
     byte magic_num_;                 // The magic number used for debugging.
     byte size_bracket_idx_;          // The index of the size bracket of this run.
     byte is_thread_local_;           // True if this run is used as a thread-local run.
-    byte to_be_bulk_freed_;          // Used within BulkFree() to flag a run that's involved with a bulk free.
-    uint32_t first_search_vec_idx_;  // The index of the first bitmap vector which may contain an available slot.
+    byte to_be_bulk_freed_;          // Unused, BulkFree() sorts the slots by run instead.
+    uint16_t first_search_vec_idx_;  // The index of the first bitmap vector which may contain an available slot.
+    uint16_t unlocked_frees_;        // The lock-free frees in progress into the run.
     uint32_t alloc_bit_map_[0];      // The bit map that allocates if each slot is in use.
 
     // bulk_free_bit_map_[] : The bit map that is used for GC to
-    // temporarily mark the slots to free without using a lock. After
-    // all the slots to be freed in a run are marked, all those slots
-    // get freed in bulk with one locking per run, as opposed to one
-    // locking per slot to minimize the lock contention. This is used
-    // within BulkFree().
+    // temporarily mark the slots to free. All the slots to be freed
+    // in a run are marked and then freed in bulk with one locking per
+    // run, as opposed to one locking per slot to minimize the lock
+    // contention. This is used within BulkFree(), with the size
+    // bracket lock held.
 
     // thread_local_free_bit_map_[] : The bit map that is used for GC
     // to temporarily mark the slots to free in a thread-local run
@@ -170,6 +172,9 @@ class RosAlloc {
     // owns the thread-local run.) When the thread-local run becomes
     // full, the thread will check this bit map and update the
     // allocation bit map of the run (that is, the slots get freed.)
+    // Frees by other threads also mark this bit map, with atomic
+    // operations and without the size bracket lock, so that they don't
+    // contend with the owner thread.
 
     // Returns the byte size of the header except for the bit maps.
     static size_t fixed_header_size() {
@@ -193,15 +198,22 @@ class RosAlloc {
     size_t NumberOfBitmapVectors() const {
       return RoundUp(numOfSlots[size_bracket_idx_], 32) / 32;
     }
+    // Requires the size bracket lock. When the run stops being thread-local, also waits for
+    // the frees that are marking the thread-local free bit map without the lock, so that the
+    // caller can merge all of their bits.
     void SetIsThreadLocal(bool is_thread_local) {
-      is_thread_local_  = is_thread_local ? 1 : 0;
+      reinterpret_cast<Atomic<byte>*>(&is_thread_local_)->StoreSequentiallyConsistent(
+          is_thread_local ? 1 : 0);
+      if (!is_thread_local) {
+        WaitForUnlockedFrees();
+      }
     }
     bool IsThreadLocal() const {
       return is_thread_local_ != 0;
     }
     // Frees slots in the allocation bit map with regard to the
     // thread-local free bit map. Used when a thread-local run becomes
-    // full.
+    // full, and when it stops being thread-local.
     bool MergeThreadLocalFreeBitMapToAllocBitMap(bool* is_all_free_after_out);
     // Frees slots in the allocation bit map with regard to the bulk
     // free bit map. Used in a bulk free.
@@ -221,6 +233,9 @@ class RosAlloc {
     size_t MarkBulkFreeBitMap(void* ptr);
     // Marks the slots to free in the thread-local free bit map.
     void MarkThreadLocalFreeBitMap(void* ptr);
+    // Marks the slot to free in the thread-local free bit map without the size bracket lock.
+    // Returns false, without marking the slot, if the run is not thread-local.
+    bool TryMarkThreadLocalFreeBitMapUnlocked(void* ptr);
     // Last word mask, all of the bits in the last word which aren't valid slots are set to
     // optimize allocation path.
     static uint32_t GetBitmapLastVectorMask(size_t num_slots, size_t num_vec);
@@ -251,8 +266,11 @@ class RosAlloc {
 
    private:
     // The common part of MarkFreeBitMap() and MarkThreadLocalFreeBitMap(). Returns the bracket
-    // size.
-    size_t MarkFreeBitMapShared(void* ptr, uint32_t* free_bit_map_base, const char* caller_name);
+    // size. The bit is set atomically if other threads may set bits of the bit map concurrently.
+    size_t MarkFreeBitMapShared(void* ptr, uint32_t* free_bit_map_base, bool atomic,
+                                const char* caller_name);
+    // Waits until no free is marking the thread-local free bit map without the lock.
+    void WaitForUnlockedFrees();
     // Turns the bit map into a string for debugging.
     static std::string BitMapToStr(uint32_t* bit_map_base, size_t num_vec);
   };
@@ -401,9 +419,10 @@ class RosAlloc {
   // The default value for page_release_size_threshold_.
   static constexpr size_t kDefaultPageReleaseSizeThreshold = 4 * MB;
 
-  // We use thread-local runs for the size Brackets whose indexes
-  // are less than this index. We use shared (current) runs for the rest.
-  static const size_t kNumThreadLocalSizeBrackets = 8;
+  // By default, we use thread-local runs for the size Brackets whose
+  // indexes are less than this index. We use shared (current) runs for
+  // the rest.
+  static constexpr size_t kDefaultNumThreadLocalSizeBrackets = 8;
 
  private:
   // The base address of the memory region that's managed by this allocator.
@@ -464,12 +483,15 @@ class RosAlloc {
   // The global lock. Used to guard the page map, the free page set,
   // and the footprint.
   Mutex lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
-  // The reader-writer lock to allow one bulk free at a time while
-  // allowing multiple individual frees at the same time. Also, this
-  // is used to avoid race conditions between BulkFree() and
-  // RevokeThreadLocalRuns() on the bulk free bitmaps.
+  // The reader-writer lock held shared by the individual and bulk
+  // frees, and by RevokeThreadLocalRuns(). Taken exclusively to wait
+  // for the frees in progress.
   ReaderWriterMutex bulk_free_lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
 
+  // We use thread-local runs for the size brackets whose indexes are
+  // less than this index. We use shared (current) runs for the rest.
+  const size_t num_thread_local_size_brackets_;
+
   // The page release mode.
   const PageReleaseMode page_release_mode_;
   // Under kPageReleaseModeSize(AndEnd), if the free page run size is
@@ -510,6 +532,14 @@ class RosAlloc {
   // The internal of non-bulk Free().
   size_t FreeInternal(Thread* self, void* ptr) LOCKS_EXCLUDED(lock_);
 
+  // Frees the slots of ptrs, all in run, with the size bracket lock held. Returns the bytes freed.
+  size_t BulkFreeRun(Thread* self, Run* run, void** ptrs, size_t num_ptrs) LOCKS_EXCLUDED(lock_);
+
+  // Returns the run of the slot ptr, or null if ptr is a large object. Reads the page map
+  // without the lock, which is safe since the page map entries of an allocated chunk don't
+  // change until it is freed.
+  Run* GetRunUnlocked(void* ptr);
+
   // Allocates large objects.
   void* AllocLargeObject(Thread* self, size_t size, size_t* bytes_allocated) LOCKS_EXCLUDED(lock_);
 
@@ -525,7 +555,8 @@ class RosAlloc {
  public:
   RosAlloc(void* base, size_t capacity, size_t max_capacity,
            PageReleaseMode page_release_mode,
-           size_t page_release_size_threshold = kDefaultPageReleaseSizeThreshold);
+           size_t page_release_size_threshold = kDefaultPageReleaseSizeThreshold,
+           size_t num_thread_local_size_brackets = kDefaultNumThreadLocalSizeBrackets);
   ~RosAlloc();
   // If kThreadUnsafe is true then the allocator may avoid acquiring some locks as an optimization.
   // If used, this may cause race conditions if multiple threads are allocating at the same time.
@@ -534,6 +565,7 @@ class RosAlloc {
       LOCKS_EXCLUDED(lock_);
   size_t Free(Thread* self, void* ptr)
       LOCKS_EXCLUDED(bulk_free_lock_);
+  // Frees the slots of ptrs, which it sorts. Several threads may bulk free at the same time.
   size_t BulkFree(Thread* self, void** ptrs, size_t num_ptrs)
       LOCKS_EXCLUDED(bulk_free_lock_);
   // Returns the size of the allocated slot for a given allocated memory chunk.
@@ -589,6 +621,10 @@ class RosAlloc {
     return page_release_mode_ == kPageReleaseModeAll;
   }
 
+  size_t GetNumThreadLocalSizeBrackets() const {
+    return num_thread_local_size_brackets_;
+  }
+
   // Verify for debugging.
   void Verify() EXCLUSIVE_LOCKS_REQUIRED(Locks::mutator_lock_);
 
@@ -16,10 +16,647 @@
 
 #include "concurrent_copying.h"
 
+#include <sched.h>
+
+#include <vector>
+
+#include "base/logging.h"
+#include "base/mutex-inl.h"
+#include "base/timing_logger.h"
+#include "closure.h"
+#include "gc/accounting/atomic_stack.h"
+#include "gc/accounting/mod_union_table.h"
+#include "gc/accounting/space_bitmap-inl.h"
+#include "gc/heap.h"
+#include "gc/reference_processor.h"
+#include "gc/space/bump_pointer_space.h"
+#include "gc/space/large_object_space.h"
+#include "gc/space/malloc_space.h"
+#include "gc/space/space-inl.h"
+#include "lock_word.h"
+#include "mirror/array-inl.h"
+#include "mirror/class-inl.h"
+#include "mirror/object-inl.h"
+#include "mirror/reference-inl.h"
+#include "read_barrier.h"
+#include "runtime.h"
+#include "scoped_thread_state_change.h"
+#include "thread-inl.h"
+#include "thread_list.h"
+
 namespace art {
 namespace gc {
 namespace collector {
 
+static constexpr bool kProtectFromSpace = true;
+
+ConcurrentCopying::ConcurrentCopying(Heap* heap, bool generational,
+                                     const std::string& name_prefix)
+    : GarbageCollector(heap,
+                       name_prefix + (name_prefix.empty() ? "" : " ") +
+                       "concurrent copying + mark sweep"),
+      from_space_(nullptr),
+      to_space_(nullptr),
+      non_moving_space_(nullptr),
+      mark_stack_lock_("concurrent copying mark stack lock", kMarkSweepMarkStackLock),
+      mark_stack_(nullptr),
+      gc_barrier_(new Barrier(0)),
+      copy_block_lock_("concurrent copying copy block lock", kMarkSweepMarkStackLock),
+      copy_block_pos_(nullptr),
+      copy_block_end_(nullptr),
+      copy_block_size_(0),
+      from_objects_(0),
+      from_bytes_(0),
+      copied_objects_(0),
+      copied_bytes_(0) {
+  UNUSED(generational);
+}
+
+void ConcurrentCopying::RunPhases() {
+  CHECK(kUseBakerReadBarrier) << "The concurrent copying collector requires the Baker read barrier";
+  Thread* self = Thread::Current();
+  Locks::mutator_lock_->AssertNotHeld(self);
+  {
+    ReaderMutexLock mu(self, *Locks::mutator_lock_);
+    InitializePhase();
+  }
+  FlipThreadRoots();
+  {
+    ReaderMutexLock mu(self, *Locks::mutator_lock_);
+    MarkingPhase();
+  }
+  {
+    ScopedPause pause(this);
+    PausePhase();
+  }
+  {
+    ReaderMutexLock mu(self, *Locks::mutator_lock_);
+    ReclaimPhase();
+    FinishPhase();
+  }
+}
+
+void ConcurrentCopying::BindBitmaps() {
+  TimingLogger::ScopedTiming t(__FUNCTION__, GetTimings());
+  WriterMutexLock mu(Thread::Current(), *Locks::heap_bitmap_lock_);
+  // Mark all of the spaces we never collect as immune.
+  for (const auto& space : GetHeap()->GetContinuousSpaces()) {
+    if (space->GetGcRetentionPolicy() == space::kGcRetentionPolicyNeverCollect ||
+        space->GetGcRetentionPolicy() == space::kGcRetentionPolicyFullCollect) {
+      CHECK(immune_region_.AddContinuousSpace(space)) << "Failed to add space " << *space;
+    }
+  }
+}
+
+void ConcurrentCopying::InitializePhase() {
+  TimingLogger::ScopedTiming t(__FUNCTION__, GetTimings());
+  CHECK(from_space_ != nullptr);
+  CHECK(to_space_ != nullptr);
+  CHECK(to_space_->IsEmpty()) << *to_space_;
+  {
+    MutexLock mu(Thread::Current(), mark_stack_lock_);
+    mark_stack_ = heap_->GetMarkStack();
+    CHECK(mark_stack_->IsEmpty());
+  }
+  immune_region_.Reset();
+  non_moving_space_ = heap_->GetNonMovingSpace();
+  copied_objects_.StoreRelaxed(0);
+  copied_bytes_.StoreRelaxed(0);
+  BindBitmaps();
+}
+
+// Flips the roots of a thread. Run by the thread itself when it becomes runnable, or by the
+// collector while the thread is suspended.
+class ConcurrentCopyingThreadFlipVisitor : public Closure {
+ public:
+  explicit ConcurrentCopyingThreadFlipVisitor(ConcurrentCopying* concurrent_copying)
+      : concurrent_copying_(concurrent_copying) {
+  }
+
+  virtual void Run(Thread* thread) OVERRIDE NO_THREAD_SAFETY_ANALYSIS {
+    // Note: self is not necessarily equal to thread since thread may be suspended.
+    Thread* self = Thread::Current();
+    CHECK(thread == self || thread->IsSuspended() || thread->GetState() == kWaitingPerformingGc)
+        << thread->GetState() << " thread " << thread << " self " << self;
+    thread->VisitRoots(ConcurrentCopying::MarkRootCallback, concurrent_copying_);
+    concurrent_copying_->GetBarrier().Pass(self);
+  }
+
+ private:
+  ConcurrentCopying* const concurrent_copying_;
+};
+
+// Flips the spaces, run with the threads suspended.
+class ConcurrentCopyingFlipCallback : public Closure {
+ public:
+  explicit ConcurrentCopyingFlipCallback(ConcurrentCopying* concurrent_copying)
+      : concurrent_copying_(concurrent_copying) {
+  }
+
+  virtual void Run(Thread* thread) OVERRIDE NO_THREAD_SAFETY_ANALYSIS {
+    UNUSED(thread);
+    concurrent_copying_->FlipSpaces();
+  }
+
+ private:
+  ConcurrentCopying* const concurrent_copying_;
+};
+
+void ConcurrentCopying::FlipThreadRoots() {
+  TimingLogger::ScopedTiming t(__FUNCTION__, GetTimings());
+  Thread* self = Thread::Current();
+  ConcurrentCopyingThreadFlipVisitor thread_flip_visitor(this);
+  ConcurrentCopyingFlipCallback flip_callback(this);
+  size_t barrier_count = Runtime::Current()->GetThreadList()->FlipThreadRoots(
+      &thread_flip_visitor, &flip_callback, this);
+  // Wait for all the threads to flip their roots.
+  ScopedThreadStateChange tsc(self, kWaitingForCheckPointsToRun);
+  gc_barrier_->Increment(self, barrier_count);
+}
+
+void ConcurrentCopying::FlipSpaces() {
+  TimingLogger::ScopedTiming t("(Paused)FlipSpaces", GetTimings());
+  Thread* self = Thread::Current();
+  Locks::mutator_lock_->AssertExclusiveHeld(self);
+  // The thread local buffers are in the from-space, and the objects allocated in the non-moving
+  // spaces until now are marked as live from the live stack.
+  heap_->RevokeAllThreadLocalBuffers();
+  heap_->RevokeAllThreadLocalAllocationStacks(self);
+  {
+    WriterMutexLock mu(self, *Locks::heap_bitmap_lock_);
+    heap_->SwapStacks(self);
+  }
+  // The mutators allocate in the to-space from now on.
+  heap_->SwapSemiSpaces();
+  from_objects_ = from_space_->GetObjectsAllocated();
+  from_bytes_ = from_space_->GetBytesAllocated();
+  // Carve the first copy block, the next ones are carved as the objects are copied. The to-space
+  // then has a block, after which blocks are carved without taking its block lock.
+  copy_block_size_ = std::min(kCopyBlockSize,
+                              RoundUp(from_bytes_, space::BumpPointerSpace::kAlignment));
+  byte* copy_block = nullptr;
+  if (copy_block_size_ != 0) {
+    copy_block = to_space_->AllocRegion(copy_block_size_);
+    CHECK(copy_block != nullptr) << "Failed to carve a copy block of "
+                                 << PrettySize(copy_block_size_) << " in " << *to_space_;
+  }
+  copy_block_pos_.StoreRelaxed(copy_block);
+  copy_block_end_.StoreRelaxed(copy_block == nullptr ? nullptr : copy_block + copy_block_size_);
+  ReadBarrier::SetMarking(true);
+}
+
+void ConcurrentCopying::MarkingPhase() {
+  TimingLogger::ScopedTiming t(__FUNCTION__, GetTimings());
+  Thread* self = Thread::Current();
+  {
+    WriterMutexLock mu(self, *Locks::heap_bitmap_lock_);
+    {
+      TimingLogger::ScopedTiming t2("MarkStackAsLive", GetTimings());
+      accounting::ObjectStack* live_stack = heap_->GetLiveStack();
+      heap_->MarkAllocStackAsLive(live_stack);
+      live_stack->Reset();
+    }
+    // Process dirty cards and add dirty cards to mod union tables.
+    heap_->ProcessCards(GetTimings(), false);
+    UpdateAndMarkModUnion();
+  }
+  {
+    TimingLogger::ScopedTiming t2("VisitNonThreadRoots", GetTimings());
+    Runtime::Current()->VisitNonThreadRoots(MarkRootCallback, this);
+  }
+  {
+    TimingLogger::ScopedTiming t2("VisitConcurrentRoots", GetTimings());
+    Runtime::Current()->VisitConcurrentRoots(MarkRootCallback, this);
+  }
+  ProcessMarkStackUntilStable();
+}
+
+void ConcurrentCopying::UpdateAndMarkModUnion() {
+  for (const auto& space : heap_->GetContinuousSpaces()) {
+    if (immune_region_.ContainsSpace(space)) {
+      const char* name = space->IsZygoteSpace() ? "UpdateAndMarkZygoteModUnionTable" :
+          "UpdateAndMarkImageModUnionTable";
+      TimingLogger::ScopedTiming t(name, GetTimings());
+      accounting::ModUnionTable* mod_union_table = heap_->FindModUnionTableFromSpace(space);
+      CHECK(mod_union_table != nullptr);
+      mod_union_table->UpdateAndMarkReferences(MarkHeapReferenceCallback, this);
+    }
+  }
+}
+
+void ConcurrentCopying::PausePhase() {
+  TimingLogger::ScopedTiming t("(Paused)PausePhase", GetTimings());
+  Locks::mutator_lock_->AssertExclusiveHeld(Thread::Current());
+  // Disallow new system weaks to prevent a race which occurs when someone adds a new system
+  // weak before we sweep them, and stop the mutators from marking objects through the system
+  // weaks.
+  Runtime::Current()->DisallowNewSystemWeaks();
+  // Enable the reference processing slow path, needs to be done with mutators paused since there
+  // is no lock in the GetReferent fast path.
+  GetHeap()->GetReferenceProcessor()->EnableSlowPath();
+}
+
+void ConcurrentCopying::ReclaimPhase() {
+  TimingLogger::ScopedTiming t(__FUNCTION__, GetTimings());
+  Thread* self = Thread::Current();
+  // Scan the objects the mutators marked through the system weaks before the pause, the marking
+  // is then complete.
+  ProcessMarkStackUntilStable();
+  ProcessReferences(self);
+  SweepSystemWeaks(self);
+  Runtime::Current()->AllowNewSystemWeaks();
+  // All the references the mutators can read are to-space references: disable the read barrier,
+  // then wait for the threads that are still marking an object to finish.
+  ReadBarrier::SetMarking(false);
+  IssueEmptyCheckpoint();
+  {
+    WriterMutexLock mu(self, *Locks::heap_bitmap_lock_);
+    // Reclaim unmarked objects.
+    Sweep(false);
+    // Swap the live and mark bitmaps for each space which we modified space. This is an
+    // optimization that enables us to not clear live bits inside of the sweep. Only swaps unbound
+    // bitmaps.
+    SwapBitmaps();
+    // Unbind the live and mark bitmaps.
+    GetHeap()->UnBindBitmaps();
+  }
+  {
+    TimingLogger::ScopedTiming t2("RecordFree", GetTimings());
+    const int32_t copied_objects = copied_objects_.LoadSequentiallyConsistent();
+    const int64_t copied_bytes = copied_bytes_.LoadSequentiallyConsistent();
+    to_space_->RecordCopied(copied_objects, copied_bytes);
+    // Each copy is of a distinct from-space object.
+    CHECK_LE(static_cast<uint64_t>(copied_objects), from_objects_);
+    CHECK_LE(static_cast<uint64_t>(copied_bytes), from_bytes_);
+    RecordFree(ObjectBytePair(from_objects_ - copied_objects, from_bytes_ - copied_bytes));
+    VLOG(heap) << "Copied " << copied_objects << " objects, " << PrettySize(copied_bytes);
+  }
+  // Release the memory used by the from space.
+  from_space_->Clear();
+  VLOG(heap) << "Protecting from_space_: " << *from_space_;
+  from_space_->GetMemMap()->Protect(kProtectFromSpace ? PROT_NONE : PROT_READ);
+}
+
+void ConcurrentCopying::FinishPhase() {
+  TimingLogger::ScopedTiming t(__FUNCTION__, GetTimings());
+  {
+    MutexLock mu(Thread::Current(), mark_stack_lock_);
+    CHECK(mark_stack_->IsEmpty());
+    mark_stack_->Reset();
+  }
+  from_space_ = nullptr;
+  to_space_ = nullptr;
+  copy_block_pos_.StoreRelaxed(nullptr);
+  copy_block_end_.StoreRelaxed(nullptr);
+  copy_block_size_ = 0;
+  WriterMutexLock mu(Thread::Current(), *Locks::heap_bitmap_lock_);
+  heap_->ClearMarkedObjects();
+}
+
+void ConcurrentCopying::RevokeAllThreadLocalBuffers() {
+  TimingLogger::ScopedTiming t(__FUNCTION__, GetTimings());
+  GetHeap()->RevokeAllThreadLocalBuffers();
+}
+
+// Passes the barrier, after which the thread is not in the middle of a Mark call.
+class ConcurrentCopyingEmptyCheckpoint : public Closure {
+ public:
+  explicit ConcurrentCopyingEmptyCheckpoint(ConcurrentCopying* concurrent_copying)
+      : concurrent_copying_(concurrent_copying) {
+  }
+
+  virtual void Run(Thread* thread) OVERRIDE NO_THREAD_SAFETY_ANALYSIS {
+    UNUSED(thread);
+    concurrent_copying_->GetBarrier().Pass(Thread::Current());
+  }
+
+ private:
+  ConcurrentCopying* const concurrent_copying_;
+};
+
+void ConcurrentCopying::IssueEmptyCheckpoint() {
+  TimingLogger::ScopedTiming t(__FUNCTION__, GetTimings());
+  Thread* self = Thread::Current();
+  ConcurrentCopyingEmptyCheckpoint check_point(this);
+  size_t barrier_count = Runtime::Current()->GetThreadList()->RunCheckpoint(&check_point);
+  // Release the mutator lock then wait for all mutator threads to pass the barrier.
+  Locks::mutator_lock_->SharedUnlock(self);
+  {
+    ScopedThreadStateChange tsc(self, kWaitingForCheckPointsToRun);
+    gc_barrier_->Increment(self, barrier_count);
+  }
+  Locks::mutator_lock_->SharedLock(self);
+}
+
+void ConcurrentCopying::PushOntoMarkStack(mirror::Object* obj) {
+  MutexLock mu(Thread::Current(), mark_stack_lock_);
+  if (UNLIKELY(mark_stack_->Size() >= mark_stack_->Capacity())) {
+    ResizeMarkStack(mark_stack_->Capacity() * 2);
+  }
+  mark_stack_->PushBack(obj);
+}
+
+bool ConcurrentCopying::PopMarkStack(mirror::Object** obj) {
+  MutexLock mu(Thread::Current(), mark_stack_lock_);
+  if (mark_stack_->IsEmpty()) {
+    return false;
+  }
+  *obj = mark_stack_->PopBack();
+  return true;
+}
+
+void ConcurrentCopying::ResizeMarkStack(size_t new_size) {
+  std::vector<mirror::Object*> temp(mark_stack_->Begin(), mark_stack_->End());
+  CHECK_LE(mark_stack_->Size(), new_size);
+  mark_stack_->Resize(new_size);
+  for (const auto& obj : temp) {
+    mark_stack_->PushBack(obj);
+  }
+}
+
+void ConcurrentCopying::ProcessMarkStack() {
+  mirror::Object* to_ref;
+  while (PopMarkStack(&to_ref)) {
+    Scan(to_ref);
+  }
+}
+
+void ConcurrentCopying::ProcessMarkStackUntilStable() {
+  TimingLogger::ScopedTiming t(__FUNCTION__, GetTimings());
+  while (true) {
+    ProcessMarkStack();
+    // The threads that are copying an object push it when done: wait for them, then scan the
+    // objects they pushed. Once no object is pushed across a checkpoint, all the references of
+    // the copied and marked objects are to-space references, and the mutators have no other way
+    // to reach a from-space object.
+    IssueEmptyCheckpoint();
+    MutexLock mu(Thread::Current(), mark_stack_lock_);
+    if (mark_stack_->IsEmpty()) {
+      break;
+    }
+  }
+}
+
+// Updates the reference field from expected to desired, unless another thread changed it.
+static void UpdateHeapReference(mirror::HeapReference<mirror::Object>* field,
+                                mirror::Object* expected, mirror::Object* desired)
+    SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+  reinterpret_cast<Atomic<uint32_t>*>(field)->CompareExchangeStrongSequentiallyConsistent(
+      mirror::HeapReference<mirror::Object>::FromMirrorPtr(expected).AsVRegValue(),
+      mirror::HeapReference<mirror::Object>::FromMirrorPtr(desired).AsVRegValue());
+}
+
+class ConcurrentCopyingRefFieldsVisitor {
+ public:
+  explicit ConcurrentCopyingRefFieldsVisitor(ConcurrentCopying* collector)
+      : collector_(collector) {
+  }
+
+  void operator()(mirror::Object* obj, MemberOffset offset, bool /* is_static */) const
+      ALWAYS_INLINE SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+    collector_->MarkField(obj, offset);
+  }
+
+  void operator()(mirror::Class* klass, mirror::Reference* ref) const
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) ALWAYS_INLINE {
+    collector_->DelayReferenceReferent(klass, ref);
+  }
+
+ private:
+  ConcurrentCopying* const collector_;
+};
+
+void ConcurrentCopying::Scan(mirror::Object* to_ref) {
+  ConcurrentCopyingRefFieldsVisitor visitor(this);
+  to_ref->VisitReferences<kMovingClasses>(visitor, visitor);
+}
+
+inline void ConcurrentCopying::MarkField(mirror::Object* obj, MemberOffset offset) {
+  mirror::HeapReference<mirror::Object>* field =
+      obj->GetFieldObjectReferenceAddr<kVerifyNone>(offset);
+  mirror::Object* from_ref = field->AsMirrorPtr();
+  mirror::Object* to_ref = Mark(from_ref);
+  if (to_ref != from_ref) {
+    UpdateHeapReference(field, from_ref, to_ref);
+  }
+}
+
+void ConcurrentCopying::DelayReferenceReferent(mirror::Class* klass,
+                                               mirror::Reference* reference) {
+  heap_->GetReferenceProcessor()->DelayReferenceReferent(klass, reference,
+                                                         &IsHeapReferenceMarkedCallback, this);
+}
+
+inline mirror::Object* ConcurrentCopying::GetForwardingAddress(mirror::Object* from_ref) {
+  while (true) {
+    LockWord lock_word = from_ref->GetLockWord(true);
+    if (lock_word.GetState() != LockWord::kForwardingAddress) {
+      return nullptr;
+    }
+    mirror::Object* to_ref = reinterpret_cast<mirror::Object*>(lock_word.ForwardingAddress());
+    if (LIKELY(to_ref != from_ref)) {
+      return to_ref;
+    }
+    // Another thread claimed the object and is copying it, the copy is short.
+    sched_yield();
+  }
+}
+
+mirror::Object* ConcurrentCopying::Mark(mirror::Object* from_ref) {
+  if (from_ref == nullptr) {
+    return nullptr;
+  }
+  if (from_space_->HasAddress(from_ref)) {
+    mirror::Object* to_ref = GetForwardingAddress(from_ref);
+    return to_ref != nullptr ? to_ref : Copy(from_ref);
+  }
+  if (to_space_->HasAddress(from_ref) || immune_region_.ContainsObject(from_ref)) {
+    return from_ref;
+  }
+  // An object of the non-moving or large object space.
+  if (!TestAndSetMarkBit(from_ref)) {
+    PushOntoMarkStack(from_ref);
+  }
+  return from_ref;
+}
+
+bool ConcurrentCopying::TestAndSetMarkBit(mirror::Object* ref) {
+  if (LIKELY(non_moving_space_->HasAddress(ref))) {
+    return non_moving_space_->GetMarkBitmap()->AtomicTestAndSet(ref);
+  }
+  space::LargeObjectSpace* large_object_space = heap_->GetLargeObjectsSpace();
+  CHECK(large_object_space != nullptr && large_object_space->GetMarkBitmap()->HasAddress(ref))
+      << "Invalid object " << ref;
+  return large_object_space->GetMarkBitmap()->AtomicTestAndSet(ref);
+}
+
+mirror::Object* ConcurrentCopying::AllocateInCopyBlock(size_t bytes) {
+  if (UNLIKELY(bytes > copy_block_size_)) {
+    // The object gets a block of its own.
+    return reinterpret_cast<mirror::Object*>(to_space_->AllocRegion(bytes));
+  }
+  while (true) {
+    // Load the position first: if the end is that of a newer block, the position has changed
+    // and the compare and swap fails.
+    byte* old_pos = copy_block_pos_.LoadSequentiallyConsistent();
+    byte* end = copy_block_end_.LoadSequentiallyConsistent();
+    byte* new_pos = old_pos + bytes;
+    if (LIKELY(new_pos <= end)) {
+      if (copy_block_pos_.CompareExchangeWeakSequentiallyConsistent(old_pos, new_pos)) {
+        return reinterpret_cast<mirror::Object*>(old_pos);
+      }
+      continue;
+    }
+    MutexLock mu(Thread::Current(), copy_block_lock_);
+    if (copy_block_end_.LoadRelaxed() != end) {
+      // Another thread carved a new block.
+      continue;
+    }
+    // The rest of the full block stays unused, like the end of a revoked TLAB.
+    byte* block = to_space_->AllocRegion(copy_block_size_);
+    if (block == nullptr) {
+      return nullptr;
+    }
+    copy_block_pos_.StoreSequentiallyConsistent(block + bytes);
+    copy_block_end_.StoreSequentiallyConsistent(block + copy_block_size_);
+    return reinterpret_cast<mirror::Object*>(block);
+  }
+}
+
+mirror::Object* ConcurrentCopying::Copy(mirror::Object* from_ref) {
+  // A from-space object forwarded to itself is being copied by the thread that claimed it.
+  const LockWord claimed_lock_word =
+      LockWord::FromForwardingAddress(reinterpret_cast<size_t>(from_ref));
+  LockWord old_lock_word;
+  while (true) {
+    old_lock_word = from_ref->GetLockWord(true);
+    if (old_lock_word.GetState() == LockWord::kForwardingAddress) {
+      // Another thread copied or is copying the object.
+      mirror::Object* to_ref = GetForwardingAddress(from_ref);
+      DCHECK(to_ref != nullptr);
+      return to_ref;
+    }
+    // Claim the object before allocating, so that only one copy of it is ever allocated.
+    if (from_ref->CasLockWordWeakSequentiallyConsistent(old_lock_word, claimed_lock_word)) {
+      break;
+    }
+    // The weak compare and swap failed spuriously, or the object was claimed: retry.
+  }
+  // The heap counts the bytes of the from-space as allocated until they are freed, which keeps
+  // room for the copies in the to-space.
+  const size_t object_size = from_ref->SizeOf();
+  const size_t bytes = RoundUp(object_size, space::BumpPointerSpace::kAlignment);
+  mirror::Object* to_ref = AllocateInCopyBlock(bytes);
+  CHECK(to_ref != nullptr) << "To-space full when copying a " << PrettySize(object_size)
+                           << " object " << from_ref << ", " << *to_space_;
+  // The from-space object only changes when it is forwarded: the copy is complete, except for
+  // the lock word replaced by the claim.
+  memcpy(to_ref, from_ref, object_size);
+  to_ref->SetLockWord(old_lock_word, false);
+  copied_objects_.FetchAndAddSequentiallyConsistent(1);
+  copied_bytes_.FetchAndAddSequentiallyConsistent(bytes);
+  // Publish the copy to the threads waiting for it.
+  from_ref->SetLockWord(LockWord::FromForwardingAddress(reinterpret_cast<size_t>(to_ref)), true);
+  PushOntoMarkStack(to_ref);
+  return to_ref;
+}
+
+mirror::Object* ConcurrentCopying::IsMarked(mirror::Object* from_ref) {
+  if (from_space_->HasAddress(from_ref)) {
+    return GetForwardingAddress(from_ref);
+  }
+  if (to_space_->HasAddress(from_ref) || immune_region_.ContainsObject(from_ref)) {
+    return from_ref;
+  }
+  bool is_marked;
+  bool is_live;
+  if (non_moving_space_->HasAddress(from_ref)) {
+    is_marked = non_moving_space_->GetMarkBitmap()->Test(from_ref);
+    is_live = non_moving_space_->GetLiveBitmap()->Test(from_ref);
+  } else {
+    space::LargeObjectSpace* large_object_space = heap_->GetLargeObjectsSpace();
+    is_marked = large_object_space->GetMarkBitmap()->Test(from_ref);
+    is_live = large_object_space->GetLiveBitmap()->Test(from_ref);
+  }
+  // The objects allocated since the flip are not in the live bitmaps yet, and are live.
+  return (is_marked || !is_live) ? from_ref : nullptr;
+}
+
+void ConcurrentCopying::MarkRootCallback(mirror::Object** root, void* arg,
+                                         const RootInfo& /*root_info*/) {
+  mirror::Object* from_ref = *root;
+  mirror::Object* to_ref = reinterpret_cast<ConcurrentCopying*>(arg)->Mark(from_ref);
+  if (to_ref != from_ref) {
+    // The mutators may update the root concurrently, only update it if it did not change.
+    reinterpret_cast<Atomic<mirror::Object*>*>(root)->CompareExchangeStrongSequentiallyConsistent(
+        from_ref, to_ref);
+  }
+}
+
+mirror::Object* ConcurrentCopying::MarkObjectCallback(mirror::Object* from_ref, void* arg) {
+  return reinterpret_cast<ConcurrentCopying*>(arg)->Mark(from_ref);
+}
+
+void ConcurrentCopying::MarkHeapReferenceCallback(mirror::HeapReference<mirror::Object>* field,
+                                                  void* arg) {
+  mirror::Object* from_ref = field->AsMirrorPtr();
+  mirror::Object* to_ref = reinterpret_cast<ConcurrentCopying*>(arg)->Mark(from_ref);
+  if (to_ref != from_ref) {
+    UpdateHeapReference(field, from_ref, to_ref);
+  }
+}
+
+void ConcurrentCopying::ProcessMarkStackCallback(void* arg) {
+  reinterpret_cast<ConcurrentCopying*>(arg)->ProcessMarkStack();
+}
+
+bool ConcurrentCopying::IsHeapReferenceMarkedCallback(
+    mirror::HeapReference<mirror::Object>* field, void* arg) {
+  mirror::Object* from_ref = field->AsMirrorPtr();
+  mirror::Object* to_ref = reinterpret_cast<ConcurrentCopying*>(arg)->IsMarked(from_ref);
+  if (to_ref == nullptr) {
+    return false;
+  }
+  if (to_ref != from_ref) {
+    UpdateHeapReference(field, from_ref, to_ref);
+  }
+  return true;
+}
+
+mirror::Object* ConcurrentCopying::IsMarkedCallback(mirror::Object* from_ref, void* arg) {
+  return reinterpret_cast<ConcurrentCopying*>(arg)->IsMarked(from_ref);
+}
+
+void ConcurrentCopying::ProcessReferences(Thread* self) {
+  TimingLogger::ScopedTiming t(__FUNCTION__, GetTimings());
+  ReaderMutexLock mu(self, *Locks::heap_bitmap_lock_);
+  GetHeap()->GetReferenceProcessor()->ProcessReferences(
+      true, GetTimings(), GetCurrentIteration()->GetClearSoftReferences(),
+      &IsHeapReferenceMarkedCallback, &MarkObjectCallback, &ProcessMarkStackCallback, this);
+}
+
+void ConcurrentCopying::SweepSystemWeaks(Thread* self) {
+  TimingLogger::ScopedTiming t(__FUNCTION__, GetTimings());
+  ReaderMutexLock mu(self, *Locks::heap_bitmap_lock_);
+  Runtime::Current()->SweepSystemWeaks(IsMarkedCallback, this);
+}
+
+void ConcurrentCopying::Sweep(bool swap_bitmaps) {
+  TimingLogger::ScopedTiming t(__FUNCTION__, GetTimings());
+  for (const auto& space : GetHeap()->GetContinuousSpaces()) {
+    if (!space->IsContinuousMemMapAllocSpace() || space == from_space_ || space == to_space_ ||
+        immune_region_.ContainsSpace(space)) {
+      continue;
+    }
+    space::ContinuousMemMapAllocSpace* alloc_space = space->AsContinuousMemMapAllocSpace();
+    TimingLogger::ScopedTiming split(
+        alloc_space->IsZygoteSpace() ? "SweepZygoteSpace" : "SweepAllocSpace", GetTimings());
+    RecordFree(alloc_space->Sweep(swap_bitmaps));
+  }
+  TimingLogger::ScopedTiming split("SweepLargeObjects", GetTimings());
+  RecordFreeLOS(heap_->GetLargeObjectsSpace()->Sweep(swap_bitmaps));
+}
+
 }  // namespace collector
 }  // namespace gc
 }  // namespace art
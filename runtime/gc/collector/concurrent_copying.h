@@ -17,32 +17,236 @@
 #ifndef ART_RUNTIME_GC_COLLECTOR_CONCURRENT_COPYING_H_
 #define ART_RUNTIME_GC_COLLECTOR_CONCURRENT_COPYING_H_
 
+#include <memory>
+
+#include "atomic.h"
+#include "barrier.h"
+#include "base/macros.h"
+#include "base/mutex.h"
 #include "garbage_collector.h"
+#include "gc_root.h"
+#include "immune_region.h"
+#include "mirror/object_reference.h"
+#include "object_callbacks.h"
+#include "offsets.h"
 
 namespace art {
+
+class Thread;
+
+namespace mirror {
+  class Class;
+  class Object;
+  class Reference;
+}  // namespace mirror
+
 namespace gc {
+
+class Heap;
+
+namespace accounting {
+  template <typename T> class AtomicStack;
+  typedef AtomicStack<mirror::Object*> ObjectStack;
+}  // namespace accounting
+
+namespace space {
+  class BumpPointerSpace;
+  class MallocSpace;
+}  // namespace space
+
 namespace collector {
 
+// A concurrent copying collector for the bump pointer spaces, which pauses the mutators only to
+// flip the spaces and their roots, and briefly before processing the references.
+//
+// At the flip, the bump pointer space becomes the from-space, the other one the to-space, and
+// each thread is given a flip function which copies the objects its roots refer to. The mutators
+// then only see to-space references: the read barrier (see ReadBarrier::Mark) copies the objects
+// they read from the from-space, and they allocate in the to-space. The collector copies the
+// objects reachable from the other roots, the immune spaces and the copied objects concurrently,
+// marks the objects of the non-moving and large object spaces in their mark bitmaps and sweeps
+// them. An object is copied once: the thread that copies it first claims it by forwarding it to
+// itself, the other threads that read it wait for the forwarding address of the copy.
+//
+// The compiled code and the stubs have no read barrier, so the runtime only runs the
+// interpreter with this collector. It requires the Baker read barrier to be enabled.
 class ConcurrentCopying : public GarbageCollector {
  public:
   explicit ConcurrentCopying(Heap* heap, bool generational = false,
-                             const std::string& name_prefix = "")
-      : GarbageCollector(heap,
-                         name_prefix + (name_prefix.empty() ? "" : " ") +
-                         "concurrent copying + mark sweep") {}
+                             const std::string& name_prefix = "");
 
   ~ConcurrentCopying() {}
 
-  virtual void RunPhases() OVERRIDE {}
+  virtual void RunPhases() OVERRIDE NO_THREAD_SAFETY_ANALYSIS;
+  void InitializePhase() SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+  void MarkingPhase() SHARED_LOCKS_REQUIRED(Locks::mutator_lock_)
+      LOCKS_EXCLUDED(Locks::heap_bitmap_lock_);
+  void PausePhase() EXCLUSIVE_LOCKS_REQUIRED(Locks::mutator_lock_);
+  void ReclaimPhase() SHARED_LOCKS_REQUIRED(Locks::mutator_lock_)
+      LOCKS_EXCLUDED(Locks::heap_bitmap_lock_);
+  void FinishPhase() SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
   virtual GcType GetGcType() const OVERRIDE {
     return kGcTypePartial;
   }
   virtual CollectorType GetCollectorType() const OVERRIDE {
     return kCollectorTypeCC;
   }
-  virtual void RevokeAllThreadLocalBuffers() OVERRIDE {}
+  virtual void RevokeAllThreadLocalBuffers() OVERRIDE;
+
+  // Set the space where we copy objects from.
+  void SetFromSpace(space::BumpPointerSpace* from_space) {
+    from_space_ = from_space;
+  }
+
+  // Set the space we copy objects to.
+  void SetToSpace(space::BumpPointerSpace* to_space) {
+    to_space_ = to_space;
+  }
+
+  // Returns the to-space reference of from_ref, copying the object if it is in the from-space
+  // and not yet copied, or marking it if it is in a non-moving space. Called by the read
+  // barrier while marking, from any thread.
+  mirror::Object* Mark(mirror::Object* from_ref) SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  Barrier& GetBarrier() {
+    return *gc_barrier_;
+  }
+
+  static void MarkRootCallback(mirror::Object** root, void* arg, const RootInfo& root_info)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  static mirror::Object* MarkObjectCallback(mirror::Object* from_ref, void* arg)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  static void MarkHeapReferenceCallback(mirror::HeapReference<mirror::Object>* field, void* arg)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  static void ProcessMarkStackCallback(void* arg)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  static bool IsHeapReferenceMarkedCallback(mirror::HeapReference<mirror::Object>* field,
+                                            void* arg)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_, Locks::heap_bitmap_lock_);
+
+  static mirror::Object* IsMarkedCallback(mirror::Object* from_ref, void* arg)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_, Locks::heap_bitmap_lock_);
+
+  // Marks and updates the reference field of obj at offset.
+  void MarkField(mirror::Object* obj, MemberOffset offset)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  // Schedules an unmarked object for reference processing.
+  void DelayReferenceReferent(mirror::Class* klass, mirror::Reference* reference)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
  private:
+  // Bind the live bits to the mark bits of the spaces that are never collected, and mark them as
+  // immune.
+  void BindBitmaps() SHARED_LOCKS_REQUIRED(Locks::mutator_lock_)
+      LOCKS_EXCLUDED(Locks::heap_bitmap_lock_);
+
+  // Suspend the threads to flip the spaces, then flip the roots of each thread.
+  void FlipThreadRoots() LOCKS_EXCLUDED(Locks::mutator_lock_);
+
+  // Flip the spaces and reserve the region of the to-space the objects are copied into.
+  // Called with the threads suspended.
+  void FlipSpaces() EXCLUSIVE_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  // Wait until the threads ran a checkpoint that does nothing, after which no thread is in the
+  // middle of a Mark call that started before.
+  void IssueEmptyCheckpoint() SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  // Scan the objects on the mark stack until it is empty.
+  void ProcessMarkStack() SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  // Scan the mark stack until it stays empty across a checkpoint, after which all the objects
+  // the mutators can reach are copied or marked.
+  void ProcessMarkStackUntilStable() SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  void Scan(mirror::Object* to_ref) SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  void PushOntoMarkStack(mirror::Object* obj) LOCKS_EXCLUDED(mark_stack_lock_);
+  bool PopMarkStack(mirror::Object** obj) LOCKS_EXCLUDED(mark_stack_lock_);
+
+  // Expand the mark stack to new_size, keeping its objects.
+  void ResizeMarkStack(size_t new_size) EXCLUSIVE_LOCKS_REQUIRED(mark_stack_lock_);
+
+  // Copy from_ref into a copy block, unless another thread claimed it first, and return the
+  // copy. Never allocates in the other spaces, so it is safe under the locks the read barrier
+  // may be called with.
+  mirror::Object* Copy(mirror::Object* from_ref) SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  // Allocate bytes in the current copy block, carving a new block from the to-space when it is
+  // full. Returns null if the to-space is full.
+  mirror::Object* AllocateInCopyBlock(size_t bytes) LOCKS_EXCLUDED(copy_block_lock_);
+
+  // Returns the forwarding address of from_ref, or null if it is not claimed yet. Waits for the
+  // copy if another thread is copying it.
+  mirror::Object* GetForwardingAddress(mirror::Object* from_ref)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  // Sets the mark bit of an object of a non-moving space, returns true if it was already set.
+  bool TestAndSetMarkBit(mirror::Object* ref) SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  // Returns null if from_ref is not marked, otherwise its to-space reference.
+  mirror::Object* IsMarked(mirror::Object* from_ref)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_, Locks::heap_bitmap_lock_);
+
+  // Mark the objects the immune spaces refer to, as recorded by their mod union tables.
+  void UpdateAndMarkModUnion()
+      EXCLUSIVE_LOCKS_REQUIRED(Locks::heap_bitmap_lock_)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  void ProcessReferences(Thread* self) SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  void SweepSystemWeaks(Thread* self) SHARED_LOCKS_REQUIRED(Locks::mutator_lock_)
+      LOCKS_EXCLUDED(Locks::heap_bitmap_lock_);
+
+  // Sweep the unmarked objects of the non-moving and large object spaces.
+  void Sweep(bool swap_bitmaps) EXCLUSIVE_LOCKS_REQUIRED(Locks::heap_bitmap_lock_)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  space::BumpPointerSpace* from_space_;
+  space::BumpPointerSpace* to_space_;
+
+  // The non-moving space, whose objects are marked in place.
+  space::MallocSpace* non_moving_space_;
+
+  // Immune region, every object inside the immune region is assumed to be marked.
+  ImmuneRegion immune_region_;
+
+  // The heap mark stack, shared by the collector and the mutators.
+  Mutex mark_stack_lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
+  accounting::ObjectStack* mark_stack_ GUARDED_BY(mark_stack_lock_);
+
+  // Barrier the threads pass after running their flip function or an empty checkpoint.
+  std::unique_ptr<Barrier> gc_barrier_;
+
+  // The size of the blocks carved from the to-space for the copies, like TLABs, so that the
+  // to-space is only used up by the objects which are actually copied.
+  static constexpr size_t kCopyBlockSize = 256 * KB;
+
+  // The block of the to-space the copies are allocated in, by bumping copy_block_pos_. The first
+  // block is carved at the flip, copy_block_lock_ is held to carve the next ones. A new block
+  // stores its position before its end, and the position only grows since the blocks are carved
+  // at the end of the to-space.
+  Mutex copy_block_lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
+  Atomic<byte*> copy_block_pos_;
+  Atomic<byte*> copy_block_end_;
+  // The size of the copy blocks of this collection, no larger than the from-space.
+  size_t copy_block_size_;
+
+  // The objects and bytes of the from-space at the flip.
+  uint64_t from_objects_;
+  uint64_t from_bytes_;
+
+  // The copies allocated in the copy blocks.
+  AtomicInteger copied_objects_;
+  Atomic<size_t> copied_bytes_;
+
+  friend class ConcurrentCopyingFlipCallback;
+  friend class ConcurrentCopyingThreadFlipVisitor;
   DISALLOW_COPY_AND_ASSIGN(ConcurrentCopying);
 };
 
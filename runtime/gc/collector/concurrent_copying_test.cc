@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "concurrent_copying.h"
+
+#include "atomic.h"
+#include "common_runtime_test.h"
+#include "gc/heap.h"
+#include "handle_scope-inl.h"
+#include "mirror/array-inl.h"
+#include "mirror/class-inl.h"
+#include "mirror/object-inl.h"
+#include "mirror/object_array-inl.h"
+#include "scoped_thread_state_change.h"
+#include "thread_pool.h"
+
+namespace art {
+namespace gc {
+namespace collector {
+
+// The collector requires the Baker read barrier (see read_barrier_c.h), the tests do nothing
+// without it.
+class ConcurrentCopyingTest : public CommonRuntimeTest {
+ protected:
+  void SetUpRuntimeOptions(RuntimeOptions* options) OVERRIDE {
+    if (kUseBakerReadBarrier) {
+      options->push_back(std::make_pair("-Xgc:CC", nullptr));
+    }
+  }
+
+  // Allocates an array of length int arrays, the one at index i holding i.
+  static mirror::ObjectArray<mirror::IntArray>* AllocIntArrays(Thread* self, int32_t length)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+    StackHandleScope<1> hs(self);
+    Handle<mirror::ObjectArray<mirror::IntArray>> arrays(hs.NewHandle(
+        mirror::ObjectArray<mirror::IntArray>::Alloc(
+            self, Runtime::Current()->GetClassLinker()->FindSystemClass(self, "[[I"), length)));
+    for (int32_t i = 0; i < length; ++i) {
+      mirror::IntArray* ints = mirror::IntArray::Alloc(self, 1);
+      ints->Set(0, i);
+      arrays->Set<false>(i, ints);
+    }
+    return arrays.Get();
+  }
+
+  // Returns how many int arrays do not hold their index.
+  static size_t CountBadIntArrays(mirror::ObjectArray<mirror::IntArray>* arrays)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+    size_t bad = 0;
+    for (int32_t i = 0; i < arrays->GetLength(); ++i) {
+      mirror::IntArray* ints = arrays->Get(i);
+      if (ints == nullptr || ints->GetLength() != 1 || ints->Get(0) != i) {
+        ++bad;
+      }
+    }
+    return bad;
+  }
+};
+
+TEST_F(ConcurrentCopyingTest, CopiesReachableObjects) {
+  if (!kUseBakerReadBarrier) {
+    return;
+  }
+  static constexpr int32_t kLength = 1000;
+  static constexpr size_t kGarbage = 2000;
+  Heap* heap = Runtime::Current()->GetHeap();
+  Thread* self = Thread::Current();
+  StackHandleScope<1> hs(self);
+  Handle<mirror::ObjectArray<mirror::IntArray>> arrays;
+  mirror::Object* old_arrays;
+  mirror::Object* old_first;
+  size_t objects_before;
+  {
+    ScopedObjectAccess soa(self);
+    arrays = hs.NewHandle(AllocIntArrays(self, kLength));
+    for (size_t i = 0; i < kGarbage; ++i) {
+      mirror::IntArray::Alloc(self, 16);
+    }
+    old_arrays = arrays.Get();
+    old_first = arrays->Get(0);
+    ASSERT_TRUE(heap->IsMovableObject(old_arrays));
+    objects_before = heap->GetObjectsAllocated();
+  }
+  heap->CollectGarbage(false);
+  ScopedObjectAccess soa(self);
+  // The handle and the references of the copies are updated to the copies.
+  EXPECT_NE(old_arrays, arrays.Get());
+  EXPECT_NE(old_first, arrays->Get(0));
+  EXPECT_TRUE(heap->IsMovableObject(arrays.Get()));
+  EXPECT_EQ(0u, CountBadIntArrays(arrays.Get()));
+  // The garbage is freed, and not the copied objects.
+  const Iteration* iteration = heap->GetCurrentGcIteration();
+  EXPECT_GE(iteration->GetFreedObjects(), kGarbage);
+  EXPECT_LE(iteration->GetFreedObjects(), objects_before - kLength - 1);
+  EXPECT_GT(iteration->GetFreedBytes(), 0);
+}
+
+// Reads the int arrays through the read barrier, racing with the other tasks to copy them.
+class ConcurrentCopyingReadTask : public Task {
+ public:
+  ConcurrentCopyingReadTask(jobject arrays, AtomicInteger* done, AtomicInteger* bad)
+      : arrays_(arrays), done_(done), bad_(bad) {
+  }
+
+  void Run(Thread* self) {
+    while (done_->LoadSequentiallyConsistent() == 0) {
+      // Let the collector suspend the thread and run its checkpoints between the passes.
+      ScopedObjectAccess soa(self);
+      mirror::ObjectArray<mirror::IntArray>* arrays =
+          soa.Decode<mirror::ObjectArray<mirror::IntArray>*>(arrays_);
+      for (int32_t i = 0; i < arrays->GetLength(); ++i) {
+        mirror::IntArray* ints = arrays->Get(i);
+        if (ints == nullptr || ints->GetLength() != 1 || ints->Get(0) != i) {
+          bad_->FetchAndAddSequentiallyConsistent(1);
+        }
+      }
+    }
+  }
+
+  void Finalize() {
+    delete this;
+  }
+
+ private:
+  const jobject arrays_;
+  AtomicInteger* const done_;
+  AtomicInteger* const bad_;
+};
+
+TEST_F(ConcurrentCopyingTest, ForwardingRace) {
+  if (!kUseBakerReadBarrier) {
+    return;
+  }
+  static constexpr size_t kThreads = 4;
+  static constexpr size_t kCollections = 10;
+  Thread* self = Thread::Current();
+  jobject arrays;
+  {
+    ScopedObjectAccess soa(self);
+    mirror::ObjectArray<mirror::IntArray>* local = AllocIntArrays(self, 10000);
+    arrays = soa.Env()->NewGlobalRef(soa.AddLocalReference<jobject>(local));
+  }
+  AtomicInteger done(0);
+  AtomicInteger bad(0);
+  ThreadPool thread_pool("Concurrent copying test thread pool", kThreads);
+  for (size_t i = 0; i < kThreads; ++i) {
+    thread_pool.AddTask(self, new ConcurrentCopyingReadTask(arrays, &done, &bad));
+  }
+  thread_pool.StartWorkers(self);
+  for (size_t i = 0; i < kCollections; ++i) {
+    Runtime::Current()->GetHeap()->CollectGarbage(false);
+  }
+  done.StoreSequentiallyConsistent(1);
+  thread_pool.Wait(self, false, false);
+  thread_pool.StopWorkers(self);
+  EXPECT_EQ(0, bad.LoadSequentiallyConsistent());
+  ScopedObjectAccess soa(self);
+  EXPECT_EQ(0u, CountBadIntArrays(soa.Decode<mirror::ObjectArray<mirror::IntArray>*>(arrays)));
+  soa.Env()->DeleteGlobalRef(arrays);
+}
+
+}  // namespace collector
+}  // namespace gc
+}  // namespace art
@@ -64,6 +64,15 @@ static constexpr bool kParallelRecursiveMark = true;
 // ProcessMarkStack with very small mark stacks.
 static constexpr size_t kMinimumParallelMarkStackSize = 128;
 static constexpr bool kParallelProcessMarkStack = true;
+static constexpr bool kParallelSweep = true;
+// How many ranges of a space each sweep thread gets, so that the threads stay busy when the
+// garbage is unevenly spread.
+static constexpr size_t kSweepTasksPerThread = 4;
+// The sweep ranges start at a multiple of the heap covered by a bitmap word, for both the
+// continuous and the large object space bitmaps, so that the tasks never share a bitmap word.
+static constexpr size_t kSweepRangeAlignment = kBitsPerWord * kPageSize;
+// Don't attempt to parallelize sweeping the allocation stack unless it has at least n elements.
+static constexpr size_t kMinimumParallelSweepArraySize = 4 * kSweepArrayChunkFreeSize;
 
 // Profiling and information flags.
 static constexpr bool kProfileLargeObjects = false;
@@ -100,9 +109,11 @@ MarkSweep::MarkSweep(Heap* heap, bool is_concurrent, const std::string& name_pre
       mark_stack_lock_("mark sweep mark stack lock", kMarkSweepMarkStackLock),
       is_concurrent_(is_concurrent), live_stack_freeze_size_(0) {
   std::string error_msg;
+  // One chunk free buffer per sweep thread.
   MemMap* mem_map = MemMap::MapAnonymous(
       "mark sweep sweep array free buffer", nullptr,
-      RoundUp(kSweepArrayChunkFreeSize * sizeof(mirror::Object*), kPageSize),
+      RoundUp(kSweepArrayChunkFreeSize * sizeof(mirror::Object*) *
+              (heap->GetSweepGCThreadCount() + 1), kPageSize),
       PROT_READ | PROT_WRITE, false, &error_msg);
   CHECK(mem_map != nullptr) << "Couldn't allocate sweep array free buffer: " << error_msg;
   sweep_array_free_buffer_mem_map_.reset(mem_map);
@@ -722,6 +733,13 @@ size_t MarkSweep::GetThreadCount(bool paused) const {
   }
 }
 
+size_t MarkSweep::GetSweepThreadCount() const {
+  if (heap_->GetThreadPool() == nullptr || !heap_->CareAboutPauseTimes()) {
+    return 1;
+  }
+  return heap_->GetSweepGCThreadCount() + 1;
+}
+
 void MarkSweep::ScanGrayObjects(bool paused, byte minimum_age) {
   accounting::CardTable* card_table = GetHeap()->GetCardTable();
   ThreadPool* thread_pool = GetHeap()->GetThreadPool();
@@ -996,35 +1014,48 @@ void MarkSweep::MarkRootsCheckpoint(Thread* self,
   Locks::heap_bitmap_lock_->ExclusiveLock(self);
 }
 
-void MarkSweep::SweepArray(accounting::ObjectStack* allocations, bool swap_bitmaps) {
-  TimingLogger::ScopedTiming t(__FUNCTION__, GetTimings());
-  Thread* self = Thread::Current();
-  mirror::Object** chunk_free_buffer = reinterpret_cast<mirror::Object**>(
-      sweep_array_free_buffer_mem_map_->BaseBegin());
-  size_t chunk_free_pos = 0;
-  ObjectBytePair freed;
-  ObjectBytePair freed_los;
-  // How many objects are left in the array, modified after each space is swept.
-  Object** objects = allocations->Begin();
-  size_t count = allocations->Size();
-  // Change the order to ensure that the non-moving space last swept as an optimization.
-  std::vector<space::ContinuousSpace*> sweep_spaces;
-  space::ContinuousSpace* non_moving_space = nullptr;
-  for (space::ContinuousSpace* space : heap_->GetContinuousSpaces()) {
-    if (space->IsAllocSpace() && !immune_region_.ContainsSpace(space) &&
-        space->GetLiveBitmap() != nullptr) {
-      if (space == heap_->GetNonMovingSpace()) {
-        non_moving_space = space;
-      } else {
-        sweep_spaces.push_back(space);
-      }
-    }
+// Sweeps a chunk of the allocation stack with a thread pool worker.
+class SweepArrayTask : public Task {
+ public:
+  SweepArrayTask(MarkSweep* mark_sweep, Object** objects, size_t count,
+                 const std::vector<space::ContinuousSpace*>* sweep_spaces, bool swap_bitmaps,
+                 Object** chunk_free_buffer, ObjectBytePair* freed, ObjectBytePair* freed_los,
+                 uint64_t* duration)
+      : mark_sweep_(mark_sweep), objects_(objects), count_(count), sweep_spaces_(sweep_spaces),
+        swap_bitmaps_(swap_bitmaps), chunk_free_buffer_(chunk_free_buffer), freed_(freed),
+        freed_los_(freed_los), duration_(duration) {
   }
-  // Unlikely to sweep a significant amount of non_movable objects, so we do these after the after
-  // the other alloc spaces as an optimization.
-  if (non_moving_space != nullptr) {
-    sweep_spaces.push_back(non_moving_space);
+
+  virtual void Run(Thread* self) NO_THREAD_SAFETY_ANALYSIS {
+    const uint64_t start_time = NanoTime();
+    mark_sweep_->SweepArrayChunk(objects_, count_, *sweep_spaces_, swap_bitmaps_,
+                                 chunk_free_buffer_, freed_, freed_los_, nullptr);
+    *duration_ = NanoTime() - start_time;
+  }
+
+  virtual void Finalize() {
+    delete this;
   }
+
+ private:
+  MarkSweep* const mark_sweep_;
+  Object** const objects_;
+  const size_t count_;
+  const std::vector<space::ContinuousSpace*>* const sweep_spaces_;
+  const bool swap_bitmaps_;
+  Object** const chunk_free_buffer_;
+  ObjectBytePair* const freed_;
+  ObjectBytePair* const freed_los_;
+  uint64_t* const duration_;
+};
+
+void MarkSweep::SweepArrayChunk(Object** objects, size_t count,
+                                const std::vector<space::ContinuousSpace*>& sweep_spaces,
+                                bool swap_bitmaps, Object** chunk_free_buffer,
+                                ObjectBytePair* freed, ObjectBytePair* freed_los,
+                                TimingLogger* timings) {
+  Thread* self = Thread::Current();
+  size_t chunk_free_pos = 0;
   // Start by sweeping the continuous spaces.
   for (space::ContinuousSpace* space : sweep_spaces) {
     space::AllocSpace* alloc_space = space->AsAllocSpace();
@@ -1044,10 +1075,15 @@ void MarkSweep::SweepArray(accounting::ObjectStack* allocations, bool swap_bitma
         // if needed.
         if (!mark_bitmap->Test(obj)) {
           if (chunk_free_pos >= kSweepArrayChunkFreeSize) {
-            TimingLogger::ScopedTiming t("FreeList", GetTimings());
-            freed.objects += chunk_free_pos;
-            freed.bytes += alloc_space->FreeList(self, chunk_free_pos, chunk_free_buffer);
+            if (timings != nullptr) {
+              timings->StartTiming("FreeList");
+            }
+            freed->objects += chunk_free_pos;
+            freed->bytes += alloc_space->FreeList(self, chunk_free_pos, chunk_free_buffer);
             chunk_free_pos = 0;
+            if (timings != nullptr) {
+              timings->EndTiming();
+            }
           }
           chunk_free_buffer[chunk_free_pos++] = obj;
         }
@@ -1056,10 +1092,15 @@ void MarkSweep::SweepArray(accounting::ObjectStack* allocations, bool swap_bitma
       }
     }
     if (chunk_free_pos > 0) {
-      TimingLogger::ScopedTiming t("FreeList", GetTimings());
-      freed.objects += chunk_free_pos;
-      freed.bytes += alloc_space->FreeList(self, chunk_free_pos, chunk_free_buffer);
+      if (timings != nullptr) {
+        timings->StartTiming("FreeList");
+      }
+      freed->objects += chunk_free_pos;
+      freed->bytes += alloc_space->FreeList(self, chunk_free_pos, chunk_free_buffer);
       chunk_free_pos = 0;
+      if (timings != nullptr) {
+        timings->EndTiming();
+      }
     }
     // All of the references which space contained are no longer in the allocation stack, update
     // the count.
@@ -1079,20 +1120,167 @@ void MarkSweep::SweepArray(accounting::ObjectStack* allocations, bool swap_bitma
       continue;
     }
     if (!large_mark_objects->Test(obj)) {
-      ++freed_los.objects;
-      freed_los.bytes += large_object_space->Free(self, obj);
+      ++freed_los->objects;
+      freed_los->bytes += large_object_space->Free(self, obj);
+    }
+  }
+}
+
+void MarkSweep::SweepArray(accounting::ObjectStack* allocations, bool swap_bitmaps) {
+  TimingLogger::ScopedTiming t(__FUNCTION__, GetTimings());
+  Thread* self = Thread::Current();
+  mirror::Object** chunk_free_buffer = reinterpret_cast<mirror::Object**>(
+      sweep_array_free_buffer_mem_map_->BaseBegin());
+  ObjectBytePair freed;
+  ObjectBytePair freed_los;
+  Object** objects = allocations->Begin();
+  size_t count = allocations->Size();
+  // Change the order to ensure that the non-moving space last swept as an optimization.
+  std::vector<space::ContinuousSpace*> sweep_spaces;
+  space::ContinuousSpace* non_moving_space = nullptr;
+  for (space::ContinuousSpace* space : heap_->GetContinuousSpaces()) {
+    if (space->IsAllocSpace() && !immune_region_.ContainsSpace(space) &&
+        space->GetLiveBitmap() != nullptr) {
+      if (space == heap_->GetNonMovingSpace()) {
+        non_moving_space = space;
+      } else {
+        sweep_spaces.push_back(space);
+      }
+    }
+  }
+  // Unlikely to sweep a significant amount of non_movable objects, so we do these after the after
+  // the other alloc spaces as an optimization.
+  if (non_moving_space != nullptr) {
+    sweep_spaces.push_back(non_moving_space);
+  }
+  const size_t thread_count = GetSweepThreadCount();
+  if (kParallelSweep && thread_count > 1 && count >= kMinimumParallelSweepArraySize) {
+    // Each task sweeps a chunk of the allocation stack with its own part of the free buffer.
+    TimingLogger::ScopedTiming t2("SweepArrayParallel", GetTimings());
+    ThreadPool* thread_pool = GetHeap()->GetThreadPool();
+    std::vector<ObjectBytePair> task_freed(thread_count);
+    std::vector<ObjectBytePair> task_freed_los(thread_count);
+    std::vector<uint64_t> task_durations(thread_count);
+    const size_t chunk_size = RoundUp(count, thread_count) / thread_count;
+    const uint64_t start_time = NanoTime();
+    for (size_t i = 0; i < thread_count; ++i) {
+      const size_t chunk_begin = std::min(count, i * chunk_size);
+      const size_t chunk_count = std::min(count - chunk_begin, chunk_size);
+      thread_pool->AddTask(self, new SweepArrayTask(
+          this, objects + chunk_begin, chunk_count, &sweep_spaces, swap_bitmaps,
+          chunk_free_buffer + i * kSweepArrayChunkFreeSize, &task_freed[i], &task_freed_los[i],
+          &task_durations[i]));
     }
+    thread_pool->SetMaxActiveWorkers(thread_count - 1);
+    thread_pool->StartWorkers(self);
+    thread_pool->Wait(self, true, true);
+    thread_pool->StopWorkers(self);
+    uint64_t total_duration = 0;
+    for (size_t i = 0; i < thread_count; ++i) {
+      freed.Add(task_freed[i]);
+      freed_los.Add(task_freed_los[i]);
+      total_duration += task_durations[i];
+    }
+    LogParallelSweep("SweepArray", thread_count, total_duration, NanoTime() - start_time);
+  } else {
+    SweepArrayChunk(objects, count, sweep_spaces, swap_bitmaps, chunk_free_buffer, &freed,
+                    &freed_los, GetTimings());
   }
   {
-    TimingLogger::ScopedTiming t("RecordFree", GetTimings());
+    TimingLogger::ScopedTiming t2("RecordFree", GetTimings());
     RecordFree(freed);
     RecordFreeLOS(freed_los);
-    t.NewTiming("ResetStack");
+    t2.NewTiming("ResetStack");
     allocations->Reset();
   }
   sweep_array_free_buffer_mem_map_->MadviseDontNeedAndZero();
 }
 
+// Sweeps a range of a continuous or large object space with a thread pool worker.
+template <typename SpaceType>
+class SweepRangeTask : public Task {
+ public:
+  SweepRangeTask(SpaceType* space, bool swap_bitmaps, uintptr_t begin, uintptr_t end,
+                 ObjectBytePair* freed, uint64_t* duration)
+      : space_(space), swap_bitmaps_(swap_bitmaps), begin_(begin), end_(end), freed_(freed),
+        duration_(duration) {
+  }
+
+  virtual void Run(Thread* self) NO_THREAD_SAFETY_ANALYSIS {
+    const uint64_t start_time = NanoTime();
+    *freed_ = space_->Sweep(swap_bitmaps_, begin_, end_);
+    *duration_ = NanoTime() - start_time;
+  }
+
+  virtual void Finalize() {
+    delete this;
+  }
+
+ private:
+  SpaceType* const space_;
+  const bool swap_bitmaps_;
+  const uintptr_t begin_;
+  const uintptr_t end_;
+  ObjectBytePair* const freed_;
+  uint64_t* const duration_;
+};
+
+template <typename SpaceType>
+ObjectBytePair MarkSweep::SweepSpace(SpaceType* space, bool swap_bitmaps, const char* name) {
+  const size_t thread_count = GetSweepThreadCount();
+  const uintptr_t space_begin = reinterpret_cast<uintptr_t>(space->Begin());
+  const uintptr_t space_end = reinterpret_cast<uintptr_t>(space->End());
+  // If the bitmaps are bound then sweeping the space won't do anything.
+  if (!kParallelSweep || thread_count == 1 || space_end <= space_begin + kSweepRangeAlignment ||
+      space->GetLiveBitmap() == space->GetMarkBitmap()) {
+    return space->Sweep(swap_bitmaps);
+  }
+  const size_t range_size = RoundUp((space_end - space_begin) /
+                                    (thread_count * kSweepTasksPerThread) + 1,
+                                    kSweepRangeAlignment);
+  Thread* self = Thread::Current();
+  ThreadPool* thread_pool = GetHeap()->GetThreadPool();
+  // The ranges end at a multiple of the alignment from the beginning of the bitmaps.
+  const uintptr_t bitmap_begin = space->GetLiveBitmap()->HeapBegin();
+  std::vector<std::pair<uintptr_t, uintptr_t>> ranges;
+  for (uintptr_t begin = space_begin; begin < space_end; ) {
+    const uintptr_t end = std::min(
+        bitmap_begin + RoundDown(begin - bitmap_begin, kSweepRangeAlignment) + range_size,
+        space_end);
+    ranges.push_back(std::make_pair(begin, end));
+    begin = end;
+  }
+  std::vector<ObjectBytePair> task_freed(ranges.size());
+  std::vector<uint64_t> task_durations(ranges.size());
+  const uint64_t start_time = NanoTime();
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    thread_pool->AddTask(self, new SweepRangeTask<SpaceType>(
+        space, swap_bitmaps, ranges[i].first, ranges[i].second, &task_freed[i],
+        &task_durations[i]));
+  }
+  thread_pool->SetMaxActiveWorkers(thread_count - 1);
+  thread_pool->StartWorkers(self);
+  thread_pool->Wait(self, true, true);
+  thread_pool->StopWorkers(self);
+  ObjectBytePair freed;
+  uint64_t total_duration = 0;
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    freed.Add(task_freed[i]);
+    total_duration += task_durations[i];
+  }
+  LogParallelSweep(name, thread_count, total_duration, NanoTime() - start_time);
+  return freed;
+}
+
+void MarkSweep::LogParallelSweep(const char* name, size_t thread_count, uint64_t total_duration,
+                                 uint64_t duration) {
+  // The time the tasks took together over the time they took in parallel, which is how much
+  // faster than a single thread the sweep was.
+  VLOG(heap) << GetName() << " " << name << " with " << thread_count << " threads took "
+             << PrettyDuration(duration) << ", speedup "
+             << static_cast<double>(total_duration) / std::max<uint64_t>(duration, 1);
+}
+
 void MarkSweep::Sweep(bool swap_bitmaps) {
   TimingLogger::ScopedTiming t(__FUNCTION__, GetTimings());
   // Ensure that nobody inserted items in the live stack after we swapped the stacks.
@@ -1109,9 +1297,9 @@ void MarkSweep::Sweep(bool swap_bitmaps) {
   for (const auto& space : GetHeap()->GetContinuousSpaces()) {
     if (space->IsContinuousMemMapAllocSpace()) {
       space::ContinuousMemMapAllocSpace* alloc_space = space->AsContinuousMemMapAllocSpace();
-      TimingLogger::ScopedTiming split(
-          alloc_space->IsZygoteSpace() ? "SweepZygoteSpace" : "SweepMallocSpace", GetTimings());
-      RecordFree(alloc_space->Sweep(swap_bitmaps));
+      const char* name = alloc_space->IsZygoteSpace() ? "SweepZygoteSpace" : "SweepMallocSpace";
+      TimingLogger::ScopedTiming split(name, GetTimings());
+      RecordFree(SweepSpace(alloc_space, swap_bitmaps, name));
     }
   }
   SweepLargeObjects(swap_bitmaps);
@@ -1119,7 +1307,7 @@ void MarkSweep::Sweep(bool swap_bitmaps) {
 
 void MarkSweep::SweepLargeObjects(bool swap_bitmaps) {
   TimingLogger::ScopedTiming split(__FUNCTION__, GetTimings());
-  RecordFreeLOS(heap_->GetLargeObjectsSpace()->Sweep(swap_bitmaps));
+  RecordFreeLOS(SweepSpace(heap_->GetLargeObjectsSpace(), swap_bitmaps, __FUNCTION__));
 }
 
 // Process the "referent" field in a java.lang.ref.Reference.  If the referent has not yet been
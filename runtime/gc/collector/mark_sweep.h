@@ -18,6 +18,7 @@
 #define ART_RUNTIME_GC_COLLECTOR_MARK_SWEEP_H_
 
 #include <memory>
+#include <vector>
 
 #include "atomic.h"
 #include "barrier.h"
@@ -50,6 +51,10 @@ namespace accounting {
   typedef AtomicStack<mirror::Object*> ObjectStack;
 }  // namespace accounting
 
+namespace space {
+  class ContinuousSpace;
+}  // namespace space
+
 namespace collector {
 
 class MarkSweep : public GarbageCollector {
@@ -146,6 +151,26 @@ class MarkSweep : public GarbageCollector {
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_)
       EXCLUSIVE_LOCKS_REQUIRED(Locks::heap_bitmap_lock_);
 
+  // Sweep the unmarked objects of a chunk of the allocation stack, in the sweep spaces then in
+  // the large object space, freeing them in batches through chunk_free_buffer. May run on a GC
+  // worker thread, while the collector holds the heap bitmap lock. The batches are timed in
+  // timings unless it is null, which it must be on a worker since the logger is not thread safe.
+  void SweepArrayChunk(mirror::Object** objects, size_t count,
+                       const std::vector<space::ContinuousSpace*>& sweep_spaces,
+                       bool swap_bitmaps, mirror::Object** chunk_free_buffer,
+                       ObjectBytePair* freed, ObjectBytePair* freed_los, TimingLogger* timings)
+      NO_THREAD_SAFETY_ANALYSIS;
+
+  // Sweep a continuous or the large object space, split in ranges across the sweep threads when
+  // there are several.
+  template <typename SpaceType>
+  ObjectBytePair SweepSpace(SpaceType* space, bool swap_bitmaps, const char* name)
+      EXCLUSIVE_LOCKS_REQUIRED(Locks::heap_bitmap_lock_);
+
+  // Log how long a parallel sweep took, and its speedup over the sum of its tasks' durations.
+  void LogParallelSweep(const char* name, size_t thread_count, uint64_t total_duration,
+                        uint64_t duration);
+
   // Blackens an object.
   void ScanObject(mirror::Object* obj)
       EXCLUSIVE_LOCKS_REQUIRED(Locks::heap_bitmap_lock_)
@@ -245,6 +270,9 @@ class MarkSweep : public GarbageCollector {
   // whether or not we care about pauses.
   size_t GetThreadCount(bool paused) const;
 
+  // Returns how many threads we should use for sweeping, which is never paused.
+  size_t GetSweepThreadCount() const;
+
   static void VerifyRootCallback(mirror::Object** root, void* arg, const RootInfo& root_info);
 
   void VerifyRoot(const mirror::Object* root, const RootInfo& root_info) NO_THREAD_SAFETY_ANALYSIS;
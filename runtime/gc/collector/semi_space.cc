@@ -92,6 +92,8 @@ SemiSpace::SemiSpace(Heap* heap, bool generational, const std::string& name_pref
       from_space_(nullptr),
       generational_(generational),
       last_gc_to_space_end_(nullptr),
+      promotion_age_(heap->GetPromotionAge()),
+      use_object_ages_(false),
       bytes_promoted_(0),
       bytes_promoted_since_last_whole_heap_collection_(0),
       large_object_bytes_allocated_at_last_whole_heap_collection_(0),
@@ -150,6 +152,8 @@ void SemiSpace::InitializePhase() {
   if (generational_) {
     promo_dest_space_ = GetHeap()->GetPrimaryFreeListSpace();
   }
+  use_object_ages_ = generational_ && promotion_age_ != 1 && from_space_->IsBumpPointerSpace() &&
+      to_space_->IsBumpPointerSpace();
   fallback_space_ = GetHeap()->GetNonMovingSpace();
 }
 
@@ -477,14 +481,21 @@ static inline size_t CopyAvoidingDirtyingPages(void* dest, const void* src, size
   return saved_bytes;
 }
 
+bool SemiSpace::ShouldPromote(const mirror::Object* obj) const {
+  if (use_object_ages_) {
+    return from_space_->AsBumpPointerSpace()->GetObjectAge(obj) >= promotion_age_;
+  }
+  // The objects below the end of the to-space of the last GC survived it.
+  return reinterpret_cast<const byte*>(obj) < last_gc_to_space_end_;
+}
+
 mirror::Object* SemiSpace::MarkNonForwardedObject(mirror::Object* obj) {
   const size_t object_size = obj->SizeOf();
   size_t bytes_allocated;
   mirror::Object* forward_address = nullptr;
-  if (generational_ && reinterpret_cast<byte*>(obj) < last_gc_to_space_end_) {
-    // If it's allocated before the last GC (older), move
-    // (pseudo-promote) it to the main free list space (as sort
-    // of an old generation.)
+  if (generational_ && ShouldPromote(obj)) {
+    // If it survived enough GCs (older), move (pseudo-promote) it
+    // to the main free list space (as sort of an old generation.)
     forward_address = promo_dest_space_->AllocThreadUnsafe(self_, object_size, &bytes_allocated,
                                                            nullptr);
     if (UNLIKELY(forward_address == nullptr)) {
@@ -539,6 +550,13 @@ mirror::Object* SemiSpace::MarkNonForwardedObject(mirror::Object* obj) {
       to_space_live_bitmap_->Set(forward_address);
     }
   }
+  if (use_object_ages_ && forward_address != nullptr && to_space_->HasAddress(forward_address)) {
+    // The object survived one more GC in the bump pointer spaces. This includes the objects
+    // which did not fit in the promotion destination space, they are promoted by a later GC.
+    const size_t age = from_space_->AsBumpPointerSpace()->GetObjectAge(obj) + 1;
+    to_space_->AsBumpPointerSpace()->SetObjectAge(forward_address,
+                                                  std::min(age, promotion_age_));
+  }
   // If it's still null, attempt to use the fallback space.
   if (UNLIKELY(forward_address == nullptr)) {
     forward_address = fallback_space_->AllocThreadUnsafe(self_, object_size, &bytes_allocated,
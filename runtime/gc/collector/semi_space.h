@@ -157,6 +157,10 @@ class SemiSpace : public GarbageCollector {
       SHARED_LOCKS_REQUIRED(Locks::heap_bitmap_lock_, Locks::mutator_lock_);
 
  protected:
+  // Used for the generational mode. Returns whether the from-space object survived enough
+  // collections to be promoted.
+  bool ShouldPromote(const mirror::Object* obj) const;
+
   // Returns null if the object is not marked, otherwise returns the forwarding address (same as
   // object for non movable things).
   mirror::Object* GetMarkedForwardAddress(mirror::Object* object) const
@@ -230,6 +234,15 @@ class SemiSpace : public GarbageCollector {
   // pointer space at the end of the last collection.
   byte* last_gc_to_space_end_;
 
+  // Used for the generational mode. How many collections an object survives before it is
+  // promoted, see Heap::GetPromotionAge.
+  const size_t promotion_age_;
+
+  // Used for the generational mode. When true, the ages of the objects are recorded in the bump
+  // pointer spaces, which is needed for the promotion ages other than 1. The age 1 objects are
+  // the ones below last_gc_to_space_end_.
+  bool use_object_ages_;
+
   // Used for the generational mode. During a collection, keeps track
   // of how many bytes of objects have been copied so far from the
   // bump pointer space to the non-moving space.
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "semi_space.h"
+
+#include "base/stringprintf.h"
+#include "common_runtime_test.h"
+#include "gc/heap.h"
+#include "gc/space/malloc_space.h"
+#include "handle_scope-inl.h"
+#include "mirror/array-inl.h"
+#include "mirror/object-inl.h"
+#include "scoped_thread_state_change.h"
+
+namespace art {
+namespace gc {
+namespace collector {
+
+// Runs the generational semi-space collector with the given -XX:PromotionAge.
+template <size_t kPromotionAge>
+class GenerationalSemiSpaceTest : public CommonRuntimeTest {
+ protected:
+  void SetUpRuntimeOptions(RuntimeOptions* options) OVERRIDE {
+    options->push_back(std::make_pair("-Xgc:GSS", nullptr));
+    options->push_back(std::make_pair(StringPrintf("-XX:PromotionAge=%zd", kPromotionAge),
+                                      nullptr));
+  }
+
+  // Collects until an object allocated in the bump pointer space is promoted to the main space,
+  // and returns how many collections it took.
+  size_t CollectUntilPromoted() {
+    Heap* heap = Runtime::Current()->GetHeap();
+    EXPECT_EQ(kPromotionAge, heap->GetPromotionAge());
+    space::MallocSpace* main_space = heap->GetPrimaryFreeListSpace();
+    Thread* self = Thread::Current();
+    StackHandleScope<1> hs(self);
+    Handle<mirror::IntArray> ints;
+    {
+      ScopedObjectAccess soa(self);
+      ints = hs.NewHandle(mirror::IntArray::Alloc(self, 4));
+      ints->Set(0, 42);
+      EXPECT_FALSE(main_space->Contains(ints.Get()));
+    }
+    for (size_t collections = 1; collections <= Heap::kMaxPromotionAge + 1; ++collections) {
+      heap->CollectGarbage(false);
+      ScopedObjectAccess soa(self);
+      EXPECT_EQ(42, ints->Get(0));
+      if (main_space->Contains(ints.Get())) {
+        return collections;
+      }
+    }
+    return 0;
+  }
+};
+
+typedef GenerationalSemiSpaceTest<0> PromotionAge0Test;
+typedef GenerationalSemiSpaceTest<Heap::kDefaultPromotionAge> DefaultPromotionAgeTest;
+typedef GenerationalSemiSpaceTest<3> PromotionAge3Test;
+
+TEST_F(PromotionAge0Test, PromotesOnFirstCollection) {
+  EXPECT_EQ(1u, CollectUntilPromoted());
+}
+
+TEST_F(DefaultPromotionAgeTest, PromotesOnSecondCollection) {
+  EXPECT_EQ(Heap::kDefaultPromotionAge + 1, CollectUntilPromoted());
+}
+
+TEST_F(PromotionAge3Test, PromotesOnFourthCollection) {
+  EXPECT_EQ(4u, CollectUntilPromoted());
+}
+
+}  // namespace collector
+}  // namespace gc
+}  // namespace art
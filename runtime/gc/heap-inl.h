@@ -246,7 +246,8 @@ inline mirror::Object* Heap::TryToAllocate(Thread* self, AllocatorType allocator
     case kAllocatorTypeTLAB: {
       DCHECK_ALIGNED(alloc_size, space::BumpPointerSpace::kAlignment);
       if (UNLIKELY(self->TlabSize() < alloc_size)) {
-        const size_t new_tlab_size = alloc_size + kDefaultTLABSize;
+        // The TLAB size of the thread adapts to its allocation rate.
+        const size_t new_tlab_size = alloc_size + self->GetTlabStats()->refill_size;
         if (UNLIKELY(IsOutOfMemoryOnAllocation<kGrow>(allocator_type, new_tlab_size))) {
           return nullptr;
         }
@@ -21,6 +21,7 @@
 
 #include <limits>
 #include <memory>
+#include <sstream>
 #include <vector>
 
 #include "base/allocator.h"
@@ -118,9 +119,10 @@ Heap::Heap(size_t initial_size, size_t growth_limit, size_t min_free, size_t max
            size_t capacity, size_t non_moving_space_capacity, const std::string& image_file_name,
            const InstructionSet image_instruction_set, CollectorType foreground_collector_type,
            CollectorType background_collector_type, size_t parallel_gc_threads,
-           size_t conc_gc_threads, bool low_memory_mode,
+           size_t conc_gc_threads, size_t sweep_gc_threads, bool low_memory_mode,
            size_t long_pause_log_threshold, size_t long_gc_log_threshold,
-           bool ignore_max_footprint, bool use_tlab,
+           bool ignore_max_footprint, bool use_tlab, size_t promotion_age,
+           size_t rosalloc_thread_local_size_brackets,
            bool verify_pre_gc_heap, bool verify_pre_sweeping_heap, bool verify_post_gc_heap,
            bool verify_pre_gc_rosalloc, bool verify_pre_sweeping_rosalloc,
            bool verify_post_gc_rosalloc, bool use_homogeneous_space_compaction_for_oom,
@@ -139,6 +141,7 @@ Heap::Heap(size_t initial_size, size_t growth_limit, size_t min_free, size_t max
       heap_trim_request_pending_(false),
       parallel_gc_threads_(parallel_gc_threads),
       conc_gc_threads_(conc_gc_threads),
+      sweep_gc_threads_(sweep_gc_threads),
       low_memory_mode_(low_memory_mode),
       long_pause_log_threshold_(long_pause_log_threshold),
       long_gc_log_threshold_(long_gc_log_threshold),
@@ -194,6 +197,8 @@ Heap::Heap(size_t initial_size, size_t growth_limit, size_t min_free, size_t max
       disable_moving_gc_count_(0),
       running_on_valgrind_(Runtime::Current()->RunningOnValgrind()),
       use_tlab_(use_tlab),
+      promotion_age_(promotion_age),
+      rosalloc_thread_local_size_brackets_(rosalloc_thread_local_size_brackets),
       main_space_backup_(nullptr),
       min_interval_homogeneous_space_compaction_by_oom_(
           min_interval_homogeneous_space_compaction_by_oom),
@@ -293,7 +298,8 @@ Heap::Heap(size_t initial_size, size_t growth_limit, size_t min_free, size_t max
   CHECK(main_mem_map_1.get() != nullptr) << error_str;
   if (support_homogeneous_space_compaction ||
       background_collector_type_ == kCollectorTypeSS ||
-      foreground_collector_type_ == kCollectorTypeSS) {
+      foreground_collector_type_ == kCollectorTypeSS ||
+      foreground_collector_type_ == kCollectorTypeCC) {
     main_mem_map_2.reset(MapAnonymousPreferredAddress(kMemMapSpaceName[1], main_mem_map_1->End(),
                                                       capacity_, PROT_READ | PROT_WRITE,
                                                       &error_str));
@@ -326,6 +332,10 @@ Heap::Heap(size_t initial_size, size_t growth_limit, size_t min_free, size_t max
     CHECK(temp_space_ != nullptr) << "Failed to create bump pointer space";
     AddSpace(temp_space_);
     CHECK(separate_non_moving_space);
+    if (foreground_collector_type_ == kCollectorTypeCC) {
+      // There is no transition to or from the concurrent copying collector.
+      CHECK_EQ(foreground_collector_type_, background_collector_type_);
+    }
   } else {
     CreateMainMallocSpace(main_mem_map_1.release(), initial_size, growth_limit_, capacity_);
     CHECK(main_space_ != nullptr);
@@ -472,7 +482,8 @@ space::MallocSpace* Heap::CreateMallocSpaceFromMemMap(MemMap* mem_map, size_t in
     // Create rosalloc space.
     malloc_space = space::RosAllocSpace::CreateFromMemMap(mem_map, name, kDefaultStartingSize,
                                                           initial_size, growth_limit, capacity,
-                                                          low_memory_mode_, can_move_objects);
+                                                          low_memory_mode_, can_move_objects,
+                                                          rosalloc_thread_local_size_brackets_);
   } else {
     malloc_space = space::DlMallocSpace::CreateFromMemMap(mem_map, name, kDefaultStartingSize,
                                                           initial_size, growth_limit, capacity,
@@ -695,7 +706,8 @@ void Heap::UpdateProcessState(ProcessState process_state) {
 }
 
 void Heap::CreateThreadPool() {
-  const size_t num_threads = std::max(parallel_gc_threads_, conc_gc_threads_);
+  const size_t num_threads =
+      std::max(std::max(parallel_gc_threads_, conc_gc_threads_), sweep_gc_threads_);
   if (num_threads != 0) {
     thread_pool_.reset(new ThreadPool("Heap thread pool", num_threads));
   }
@@ -870,9 +882,42 @@ void Heap::DumpGcPerformanceInfo(std::ostream& os) {
   }
   os << "Total mutator paused time: " << PrettyDuration(total_paused_time) << "\n";
   os << "Total time waiting for GC to complete: " << PrettyDuration(total_wait_time_) << "\n";
+  DumpTlabStats(os);
   BaseMutex::DumpAll(os);
 }
 
+void Heap::RecordExitedThreadTlabStats(const TlabStats& stats) {
+  exited_threads_tlab_refills_.FetchAndAddSequentiallyConsistent(stats.refills);
+  exited_threads_tlab_waste_bytes_.FetchAndAddSequentiallyConsistent(stats.waste_bytes);
+}
+
+void Heap::DumpTlabStats(std::ostream& os) {
+  uint64_t total_refills = exited_threads_tlab_refills_.LoadSequentiallyConsistent();
+  uint64_t total_waste_bytes = exited_threads_tlab_waste_bytes_.LoadSequentiallyConsistent();
+  std::ostringstream per_thread;
+  {
+    MutexLock mu(Thread::Current(), *Locks::thread_list_lock_);
+    for (Thread* thread : Runtime::Current()->GetThreadList()->GetList()) {
+      // The statistics of the other threads may be updated as we read them.
+      const TlabStats* stats = thread->GetTlabStats();
+      if (stats->refills == 0) {
+        continue;
+      }
+      std::string name;
+      thread->GetThreadName(name);
+      per_thread << "  " << name << " (tid " << thread->GetTid() << "): " << stats->refills
+                 << " refills, " << PrettySize(stats->waste_bytes) << " unused, next TLAB "
+                 << PrettySize(stats->refill_size) << "\n";
+      total_refills += stats->refills;
+      total_waste_bytes += stats->waste_bytes;
+    }
+  }
+  if (total_refills != 0) {
+    os << "Total TLAB refills " << total_refills << ", unused TLAB bytes "
+       << PrettySize(total_waste_bytes) << "\n" << per_thread.str();
+  }
+}
+
 Heap::~Heap() {
   VLOG(heap) << "Starting ~Heap()";
   STLDeleteElements(&garbage_collectors_);
@@ -1802,6 +1847,10 @@ void Heap::ChangeCollector(CollectorType collector_type) {
       // Don't allow mark compact unless support is compiled in.
       CHECK(kMarkCompactSupport);
     }
+    if (collector_type == kCollectorTypeCC) {
+      // The mutators only read the references of the heap through the Baker read barrier.
+      CHECK(kUseBakerReadBarrier);
+    }
     collector_type_ = collector_type;
     gc_plan_.clear();
     switch (collector_type_) {
@@ -1810,7 +1859,9 @@ void Heap::ChangeCollector(CollectorType collector_type) {
       case kCollectorTypeSS:  // Fall-through.
       case kCollectorTypeGSS: {
         gc_plan_.push_back(collector::kGcTypeFull);
-        if (use_tlab_) {
+        // The concurrent copying collector carves blocks of the to-space to copy the objects
+        // into, so the mutators allocate in blocks too.
+        if (use_tlab_ || collector_type_ == kCollectorTypeCC) {
           ChangeAllocator(kAllocatorTypeTLAB);
         } else {
           ChangeAllocator(kAllocatorTypeBumpPointer);
@@ -2191,6 +2242,8 @@ collector::GcType Heap::CollectGarbageInternal(collector::GcType gc_type, GcCaus
         collector = semi_space_collector_;
         break;
       case kCollectorTypeCC:
+        concurrent_copying_collector_->SetFromSpace(bump_pointer_space_);
+        concurrent_copying_collector_->SetToSpace(temp_space_);
         collector = concurrent_copying_collector_;
         break;
       case kCollectorTypeMC:
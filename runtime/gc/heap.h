@@ -48,6 +48,7 @@ class Mutex;
 class StackVisitor;
 class Thread;
 class TimingLogger;
+struct TlabStats;
 
 namespace mirror {
   class Class;
@@ -139,6 +140,12 @@ class Heap {
   static constexpr size_t kDefaultLongPauseLogThreshold = MsToNs(5);
   static constexpr size_t kDefaultLongGCLogThreshold = MsToNs(100);
   static constexpr size_t kDefaultTLABSize = 256 * KB;
+  // The generational semi-space collector promotes the objects which survived this many
+  // collections, an age of 0 promotes every surviving object.
+  static constexpr size_t kDefaultPromotionAge = 1;
+  static constexpr size_t kMaxPromotionAge = 15;
+  // The allocations of this many of the smallest RosAlloc size brackets use thread-local runs.
+  static constexpr size_t kDefaultRosAllocThreadLocalSizeBrackets = 8;
   static constexpr double kDefaultTargetUtilization = 0.5;
   static constexpr double kDefaultHeapGrowthMultiplier = 2.0;
 
@@ -160,9 +167,11 @@ class Heap {
                 const std::string& original_image_file_name,
                 InstructionSet image_instruction_set,
                 CollectorType foreground_collector_type, CollectorType background_collector_type,
-                size_t parallel_gc_threads, size_t conc_gc_threads, bool low_memory_mode,
+                size_t parallel_gc_threads, size_t conc_gc_threads, size_t sweep_gc_threads,
+                bool low_memory_mode,
                 size_t long_pause_threshold, size_t long_gc_threshold,
-                bool ignore_max_footprint, bool use_tlab,
+                bool ignore_max_footprint, bool use_tlab, size_t promotion_age,
+                size_t rosalloc_thread_local_size_brackets,
                 bool verify_pre_gc_heap, bool verify_pre_sweeping_heap, bool verify_post_gc_heap,
                 bool verify_pre_gc_rosalloc, bool verify_pre_sweeping_rosalloc,
                 bool verify_post_gc_rosalloc, bool use_homogeneous_space_compaction,
@@ -585,6 +594,15 @@ class Heap {
   size_t GetConcGCThreadCount() const {
     return conc_gc_threads_;
   }
+  size_t GetSweepGCThreadCount() const {
+    return sweep_gc_threads_;
+  }
+  size_t GetPromotionAge() const {
+    return promotion_age_;
+  }
+
+  // Add the TLAB statistics of an exiting thread to the totals of DumpGcPerformanceInfo.
+  void RecordExitedThreadTlabStats(const TlabStats& stats);
   accounting::ModUnionTable* FindModUnionTableFromSpace(space::Space* space);
   void AddModUnionTable(accounting::ModUnionTable* mod_union_table);
 
@@ -603,7 +621,14 @@ class Heap {
     return &reference_processor_;
   }
 
+  collector::ConcurrentCopying* ConcurrentCopyingCollector() {
+    return concurrent_copying_collector_;
+  }
+
  private:
+  // Dump the TLAB refills and the bytes they left unused, per live thread and in total.
+  void DumpTlabStats(std::ostream& os) LOCKS_EXCLUDED(Locks::thread_list_lock_);
+
   // Compact source space to target space.
   void Compact(space::ContinuousMemMapAllocSpace* target_space,
                space::ContinuousMemMapAllocSpace* source_space,
@@ -628,7 +653,8 @@ class Heap {
         allocator_type != kAllocatorTypeTLAB;
   }
   static ALWAYS_INLINE bool AllocatorMayHaveConcurrentGC(AllocatorType allocator_type) {
-    return AllocatorHasAllocationStack(allocator_type);
+    // The TLAB allocator is the one of the concurrent copying collector.
+    return allocator_type != kAllocatorTypeBumpPointer;
   }
   static bool IsMovingGc(CollectorType collector_type) {
     return collector_type == kCollectorTypeSS || collector_type == kCollectorTypeGSS ||
@@ -838,6 +864,9 @@ class Heap {
   // How many GC threads we may use for unpaused parts of garbage collection.
   const size_t conc_gc_threads_;
 
+  // How many GC threads we may use for sweeping, which is not paused.
+  const size_t sweep_gc_threads_;
+
   // Boolean for if we are in low memory mode.
   const bool low_memory_mode_;
 
@@ -1025,6 +1054,13 @@ class Heap {
   const bool running_on_valgrind_;
   const bool use_tlab_;
 
+  // How many collections the objects of the bump pointer spaces survive before the generational
+  // semi-space collector promotes them.
+  const size_t promotion_age_;
+
+  // How many of the smallest size brackets of the RosAlloc spaces use thread-local runs.
+  const size_t rosalloc_thread_local_size_brackets_;
+
   // Pointer to the space which becomes the new main space when we do homogeneous space compaction.
   // Use unique_ptr since the space is only added during the homogeneous compaction phase.
   std::unique_ptr<space::MallocSpace> main_space_backup_;
@@ -1047,9 +1083,14 @@ class Heap {
   // Count for performed homogeneous space compaction.
   Atomic<size_t> count_performed_homogeneous_space_compaction_;
 
+  // The TLAB refills and the bytes they left unused of the threads which exited.
+  Atomic<uint64_t> exited_threads_tlab_refills_;
+  Atomic<uint64_t> exited_threads_tlab_waste_bytes_;
+
   // Whether or not we use homogeneous space compaction to avoid OOM errors.
   bool use_homogeneous_space_compaction_for_oom_;
 
+  friend class collector::ConcurrentCopying;
   friend class collector::GarbageCollector;
   friend class collector::MarkCompact;
   friend class collector::MarkSweep;
@@ -49,11 +49,13 @@ void ReferenceProcessor::DisableSlowPath(Thread* self) {
 }
 
 mirror::Object* ReferenceProcessor::GetReferent(Thread* self, mirror::Reference* reference) {
-  mirror::Object* const referent = reference->GetReferent();
+  // Read the referent without the read barrier, which would mark a referent the concurrent
+  // copying collector may be clearing.
+  mirror::Object* const referent = reference->GetReferent<kWithoutReadBarrier>();
   // If the referent is null then it is already cleared, we can just return null since there is no
   // scenario where it becomes non-null during the reference processing phase.
   if (UNLIKELY(!SlowPathEnabled()) || referent == nullptr) {
-    return referent;
+    return kUseBakerReadBarrier ? reference->GetReferent() : referent;
   }
   MutexLock mu(self, *Locks::reference_processor_lock_);
   while (SlowPathEnabled()) {
@@ -15,15 +15,25 @@
  */
 
 #include "bump_pointer_space.h"
+
+#include <sched.h>
+
 #include "bump_pointer_space-inl.h"
 #include "mirror/object-inl.h"
 #include "mirror/class-inl.h"
+#include "thread-inl.h"
 #include "thread_list.h"
 
 namespace art {
 namespace gc {
 namespace space {
 
+// The TLABs of a thread are sized for it to allocate about kTlabRefillsPerGc of them between two
+// GCs: the threads which allocate a lot refill less often, the others leave less memory unused.
+static constexpr size_t kTlabRefillsPerGc = 16;
+static constexpr size_t kMinTlabSize = 16 * KB;
+static constexpr size_t kMaxTlabSize = 2 * MB;
+
 BumpPointerSpace* BumpPointerSpace::Create(const std::string& name, size_t capacity,
                                            byte* requested_begin) {
   capacity = RoundUp(capacity, kPageSize);
@@ -71,16 +81,48 @@ void BumpPointerSpace::Clear() {
   // Reset the end of the space back to the beginning, we move the end forward as we allocate
   // objects.
   SetEnd(Begin());
+  if (object_ages_.get() != nullptr) {
+    byte* ages_begin = object_ages_->Begin();
+    if (!kMadviseZeroes) {
+      memset(ages_begin, 0, object_ages_->Size());
+    }
+    CHECK_NE(madvise(ages_begin, object_ages_->Size(), MADV_DONTNEED), -1) << "madvise failed";
+  }
   objects_allocated_.StoreRelaxed(0);
   bytes_allocated_.StoreRelaxed(0);
   growth_end_ = Limit();
   {
     MutexLock mu(Thread::Current(), block_lock_);
-    num_blocks_ = 0;
+    num_blocks_.StoreRelaxed(0);
     main_block_size_ = 0;
   }
 }
 
+uint8_t BumpPointerSpace::GetObjectAge(const mirror::Object* obj) const {
+  DCHECK(HasAddress(obj));
+  if (object_ages_.get() == nullptr) {
+    return 0;
+  }
+  return object_ages_->Begin()[(reinterpret_cast<const byte*>(obj) - Begin()) / kAlignment];
+}
+
+void BumpPointerSpace::SetObjectAge(const mirror::Object* obj, uint8_t age) {
+  DCHECK(HasAddress(obj));
+  if (object_ages_.get() == nullptr) {
+    if (age == 0) {
+      return;
+    }
+    std::string name = std::string(GetName()) + " object ages";
+    std::string error_msg;
+    size_t size = RoundUp(static_cast<size_t>(Limit() - Begin()) / kAlignment, kPageSize);
+    object_ages_.reset(MemMap::MapAnonymous(name.c_str(), nullptr, size, PROT_READ | PROT_WRITE,
+                                            false, &error_msg));
+    CHECK(object_ages_.get() != nullptr) << "Failed to map the object ages of " << GetName()
+        << ": " << error_msg;
+  }
+  object_ages_->Begin()[(reinterpret_cast<const byte*>(obj) - Begin()) / kAlignment] = age;
+}
+
 void BumpPointerSpace::Dump(std::ostream& os) const {
   os << GetName() << " "
       << reinterpret_cast<void*>(Begin()) << "-" << reinterpret_cast<void*>(End()) << " - "
@@ -93,8 +135,18 @@ mirror::Object* BumpPointerSpace::GetNextObject(mirror::Object* obj) {
 }
 
 void BumpPointerSpace::RevokeThreadLocalBuffers(Thread* thread) {
-  MutexLock mu(Thread::Current(), block_lock_);
-  RevokeThreadLocalBuffersLocked(thread);
+  if (!thread->HasTlab()) {
+    // The thread did not allocate since its TLAB was last revoked, keep its TLAB size.
+    return;
+  }
+  RevokeTlab(thread);
+  // Move the TLAB size half way to the size for the allocation rate since the last revocation,
+  // which is usually the last GC.
+  TlabStats* stats = thread->GetTlabStats();
+  const size_t target_size = stats->bytes_since_gc / kTlabRefillsPerGc;
+  const size_t size = (stats->refill_size + target_size) / 2;
+  stats->refill_size = RoundUp(std::min(std::max(size, kMinTlabSize), kMaxTlabSize), kAlignment);
+  stats->bytes_since_gc = 0;
 }
 
 void BumpPointerSpace::RevokeAllThreadLocalBuffers() {
@@ -110,7 +162,6 @@ void BumpPointerSpace::RevokeAllThreadLocalBuffers() {
 
 void BumpPointerSpace::AssertThreadLocalBuffersAreRevoked(Thread* thread) {
   if (kIsDebugBuild) {
-    MutexLock mu(Thread::Current(), block_lock_);
     DCHECK(!thread->HasTlab());
   }
 }
@@ -129,27 +180,51 @@ void BumpPointerSpace::AssertAllThreadLocalBuffersAreRevoked() {
 }
 
 void BumpPointerSpace::UpdateMainBlock() {
-  DCHECK_EQ(num_blocks_, 0U);
+  DCHECK_EQ(num_blocks_.LoadRelaxed(), 0U);
   main_block_size_ = Size();
 }
 
 // Returns the start of the storage.
 byte* BumpPointerSpace::AllocBlock(size_t bytes) {
   bytes = RoundUp(bytes, kAlignment);
-  if (!num_blocks_) {
-    UpdateMainBlock();
+  if (UNLIKELY(num_blocks_.LoadSequentiallyConsistent() == 0)) {
+    // The first block ends the main block. The other threads only carve blocks without the lock
+    // once it is counted, so the end of the space doesn't move until the main block is updated.
+    MutexLock mu(Thread::Current(), block_lock_);
+    if (num_blocks_.LoadRelaxed() == 0) {
+      UpdateMainBlock();
+      return CarveBlock(bytes);
+    }
   }
+  return CarveBlock(bytes);
+}
+
+byte* BumpPointerSpace::CarveBlock(size_t bytes) {
+  DCHECK_NE(bytes, 0U);
   byte* storage = reinterpret_cast<byte*>(
       AllocNonvirtualWithoutAccounting(bytes + sizeof(BlockHeader)));
   if (LIKELY(storage != nullptr)) {
     BlockHeader* header = reinterpret_cast<BlockHeader*>(storage);
-    header->size_ = bytes;  // Write out the block header.
+    // Write out the block header. Walk may already have seen the new end, see ReadBlockSize.
+    header->size_.StoreSequentiallyConsistent(bytes);
     storage += sizeof(BlockHeader);
-    ++num_blocks_;
+    num_blocks_.FetchAndAddSequentiallyConsistent(1);
   }
   return storage;
 }
 
+size_t BumpPointerSpace::ReadBlockSize(BlockHeader* header) {
+  while (true) {
+    size_t block_size = header->size_.LoadSequentiallyConsistent();
+    if (LIKELY(block_size != 0U)) {
+      return block_size;
+    }
+    // The block is carved without the lock, its thread moved the end but has not written the
+    // header yet. It cannot be suspended in between, the write is imminent.
+    sched_yield();
+  }
+}
+
 void BumpPointerSpace::Walk(ObjectCallback* callback, void* arg) {
   byte* pos = Begin();
   byte* end = End();
@@ -158,11 +233,11 @@ void BumpPointerSpace::Walk(ObjectCallback* callback, void* arg) {
     MutexLock mu(Thread::Current(), block_lock_);
     // If we have 0 blocks then we need to update the main header since we have bump pointer style
     // allocation into an unbounded region (actually bounded by Capacity()).
-    if (num_blocks_ == 0) {
+    if (num_blocks_.LoadRelaxed() == 0) {
       UpdateMainBlock();
     }
     main_end = Begin() + main_block_size_;
-    if (num_blocks_ == 0) {
+    if (num_blocks_.LoadRelaxed() == 0) {
       // We don't have any other blocks, this means someone else may be allocating into the main
       // block. In this case, we don't want to try and visit the other blocks after the main block
       // since these could actually be part of the main block.
@@ -184,8 +259,7 @@ void BumpPointerSpace::Walk(ObjectCallback* callback, void* arg) {
   }
   // Walk the other blocks (currently only TLABs).
   while (pos < end) {
-    BlockHeader* header = reinterpret_cast<BlockHeader*>(pos);
-    size_t block_size = header->size_;
+    size_t block_size = ReadBlockSize(reinterpret_cast<BlockHeader*>(pos));
     pos += sizeof(BlockHeader);  // Skip the header so that we know where the objects
     mirror::Object* obj = reinterpret_cast<mirror::Object*>(pos);
     const mirror::Object* end = reinterpret_cast<const mirror::Object*>(pos + block_size);
@@ -212,10 +286,10 @@ uint64_t BumpPointerSpace::GetBytesAllocated() {
   MutexLock mu(self, *Locks::runtime_shutdown_lock_);
   MutexLock mu2(self, *Locks::thread_list_lock_);
   std::list<Thread*> thread_list = Runtime::Current()->GetThreadList()->GetList();
-  MutexLock mu3(Thread::Current(), block_lock_);
   // If we don't have any blocks, we don't have any thread local buffers. This check is required
-  // since there can exist multiple bump pointer spaces which exist at the same time.
-  if (num_blocks_ > 0) {
+  // since there can exist multiple bump pointer spaces which exist at the same time. The TLABs
+  // are revoked without a lock, the total is approximate while the mutators allocate.
+  if (num_blocks_.LoadSequentiallyConsistent() > 0) {
     for (Thread* thread : thread_list) {
       total += thread->GetThreadLocalBytesAllocated();
     }
@@ -230,10 +304,10 @@ uint64_t BumpPointerSpace::GetObjectsAllocated() {
   MutexLock mu(self, *Locks::runtime_shutdown_lock_);
   MutexLock mu2(self, *Locks::thread_list_lock_);
   std::list<Thread*> thread_list = Runtime::Current()->GetThreadList()->GetList();
-  MutexLock mu3(Thread::Current(), block_lock_);
   // If we don't have any blocks, we don't have any thread local buffers. This check is required
-  // since there can exist multiple bump pointer spaces which exist at the same time.
-  if (num_blocks_ > 0) {
+  // since there can exist multiple bump pointer spaces which exist at the same time. The TLABs
+  // are revoked without a lock, the total is approximate while the mutators allocate.
+  if (num_blocks_.LoadSequentiallyConsistent() > 0) {
     for (Thread* thread : thread_list) {
       total += thread->GetThreadLocalObjectsAllocated();
     }
@@ -241,23 +315,34 @@ uint64_t BumpPointerSpace::GetObjectsAllocated() {
   return total;
 }
 
-void BumpPointerSpace::RevokeThreadLocalBuffersLocked(Thread* thread) {
+void BumpPointerSpace::RevokeTlab(Thread* thread) {
+  thread->GetTlabStats()->waste_bytes += thread->TlabSize();
   objects_allocated_.FetchAndAddSequentiallyConsistent(thread->GetThreadLocalObjectsAllocated());
   bytes_allocated_.FetchAndAddSequentiallyConsistent(thread->GetThreadLocalBytesAllocated());
   thread->SetTlab(nullptr, nullptr);
 }
 
 bool BumpPointerSpace::AllocNewTlab(Thread* self, size_t bytes) {
-  MutexLock mu(Thread::Current(), block_lock_);
-  RevokeThreadLocalBuffersLocked(self);
+  RevokeTlab(self);
   byte* start = AllocBlock(bytes);
   if (start == nullptr) {
     return false;
   }
   self->SetTlab(start, start + bytes);
+  TlabStats* stats = self->GetTlabStats();
+  ++stats->refills;
+  stats->bytes_since_gc += bytes;
+  if (stats->bytes_since_gc > kTlabRefillsPerGc * stats->refill_size) {
+    // The thread allocates faster than its TLAB size was adapted to, don't wait for the next GC.
+    stats->refill_size = std::min(stats->refill_size * 2, kMaxTlabSize);
+  }
   return true;
 }
 
+byte* BumpPointerSpace::AllocRegion(size_t bytes) {
+  return AllocBlock(bytes);
+}
+
 void BumpPointerSpace::LogFragmentationAllocFailure(std::ostream& os,
                                                     size_t /* failed_alloc_bytes */) {
   size_t max_contiguous_allocation = Limit() - End();
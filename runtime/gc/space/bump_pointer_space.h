@@ -103,10 +103,12 @@ class BumpPointerSpace FINAL : public ContinuousMemMapAllocSpace {
 
   void Dump(std::ostream& os) const;
 
-  void RevokeThreadLocalBuffers(Thread* thread) LOCKS_EXCLUDED(block_lock_);
+  // Revoke the TLAB of the thread, which is the current thread or suspended, and adapt the size of
+  // its next TLAB to its allocation rate since the last revocation.
+  void RevokeThreadLocalBuffers(Thread* thread);
   void RevokeAllThreadLocalBuffers() LOCKS_EXCLUDED(Locks::runtime_shutdown_lock_,
                                                     Locks::thread_list_lock_);
-  void AssertThreadLocalBuffersAreRevoked(Thread* thread) LOCKS_EXCLUDED(block_lock_);
+  void AssertThreadLocalBuffersAreRevoked(Thread* thread);
   void AssertAllThreadLocalBuffersAreRevoked() LOCKS_EXCLUDED(Locks::runtime_shutdown_lock_,
                                                               Locks::thread_list_lock_);
 
@@ -132,8 +134,13 @@ class BumpPointerSpace FINAL : public ContinuousMemMapAllocSpace {
   static mirror::Object* GetNextObject(mirror::Object* obj)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
-  // Allocate a new TLAB, returns false if the allocation failed.
-  bool AllocNewTlab(Thread* self, size_t bytes);
+  // Allocate a new TLAB, returns false if the allocation failed. Except for the first block after
+  // the main block, the TLAB is carved from the end of the space without taking a lock.
+  bool AllocNewTlab(Thread* self, size_t bytes) LOCKS_EXCLUDED(block_lock_);
+
+  // Allocate a block the concurrent copying collector copies objects into, returns null if the
+  // allocation failed. The copied objects are accounted with RecordCopied.
+  byte* AllocRegion(size_t bytes) LOCKS_EXCLUDED(block_lock_);
 
   BumpPointerSpace* AsBumpPointerSpace() OVERRIDE {
     return this;
@@ -151,6 +158,18 @@ class BumpPointerSpace FINAL : public ContinuousMemMapAllocSpace {
     bytes_allocated_.FetchAndSubSequentiallyConsistent(bytes);
   }
 
+  // Record objects / bytes copied into a region.
+  void RecordCopied(int32_t objects, int32_t bytes) {
+    objects_allocated_.FetchAndAddSequentiallyConsistent(objects);
+    bytes_allocated_.FetchAndAddSequentiallyConsistent(bytes);
+  }
+
+  // The number of collections the object survived, which the generational semi-space collector
+  // records as it copies the objects. The objects allocated since the space was last cleared have
+  // age 0.
+  uint8_t GetObjectAge(const mirror::Object* obj) const;
+  void SetObjectAge(const mirror::Object* obj, uint8_t age);
+
   void LogFragmentationAllocFailure(std::ostream& os, size_t failed_alloc_bytes) OVERRIDE
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
@@ -161,8 +180,11 @@ class BumpPointerSpace FINAL : public ContinuousMemMapAllocSpace {
   BumpPointerSpace(const std::string& name, MemMap* mem_map);
 
   // Allocate a raw block of bytes.
-  byte* AllocBlock(size_t bytes) EXCLUSIVE_LOCKS_REQUIRED(block_lock_);
-  void RevokeThreadLocalBuffersLocked(Thread* thread) EXCLUSIVE_LOCKS_REQUIRED(block_lock_);
+  byte* AllocBlock(size_t bytes) LOCKS_EXCLUDED(block_lock_);
+  // Allocate a block past the end of the space and write its header.
+  byte* CarveBlock(size_t bytes);
+  // Record the objects and bytes allocated in the TLAB of the thread, and the bytes left unused.
+  void RevokeTlab(Thread* thread);
 
   // The main block is an unbounded block where objects go when there are no other blocks. This
   // enables us to maintain tightly packed objects when you are not using thread local buffers for
@@ -177,18 +199,27 @@ class BumpPointerSpace FINAL : public ContinuousMemMapAllocSpace {
   // have a header, this lets us walk empty spaces which are mprotected.
   size_t main_block_size_ GUARDED_BY(block_lock_);
   // The number of blocks in the space, if it is 0 then the space has one long continuous block
-  // which doesn't have an updated header.
-  size_t num_blocks_ GUARDED_BY(block_lock_);
+  // which doesn't have an updated header. Only the first block, which ends the main block, is
+  // allocated with block_lock_ held.
+  Atomic<size_t> num_blocks_;
+  // The object ages, one byte per kAlignment bytes of the space. Only mapped once an age is set,
+  // as the collectors which don't promote by age never set one.
+  std::unique_ptr<MemMap> object_ages_;
 
  private:
   struct BlockHeader {
-    size_t size_;  // Size of the block in bytes, does not include the header.
+    // Size of the block in bytes, does not include the header. Blocks are carved out of zeroed
+    // memory and published when the end of the space moves, the size is 0 until it is written.
+    Atomic<size_t> size_;
     size_t unused_;  // Ensures alignment of kAlignment.
   };
 
   COMPILE_ASSERT(sizeof(BlockHeader) % kAlignment == 0,
                  continuous_block_must_be_kAlignment_aligned);
 
+  // Returns the size of the block, waiting for the thread which carved it to write the header.
+  static size_t ReadBlockSize(BlockHeader* header);
+
   friend class collector::MarkSweep;
   DISALLOW_COPY_AND_ASSIGN(BumpPointerSpace);
 };
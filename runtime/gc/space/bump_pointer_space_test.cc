@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "space_test.h"
+#include "bump_pointer_space-inl.h"
+#include "thread-inl.h"
+
+namespace art {
+namespace gc {
+namespace space {
+
+class BumpPointerSpaceTest : public SpaceTest {
+};
+
+TEST_F(BumpPointerSpaceTest, ObjectAges) {
+  std::unique_ptr<BumpPointerSpace> space(BumpPointerSpace::Create("test", 1 * MB, nullptr));
+  ASSERT_TRUE(space.get() != nullptr);
+
+  static constexpr size_t kNumObjects = 16;
+  mirror::Object* objects[kNumObjects];
+  for (size_t i = 0; i < kNumObjects; ++i) {
+    objects[i] = space->AllocNonvirtual(BumpPointerSpace::kAlignment * (i + 1));
+    ASSERT_TRUE(objects[i] != nullptr);
+    // The ages are not mapped before one is set.
+    EXPECT_EQ(0U, space->GetObjectAge(objects[i]));
+  }
+  for (size_t i = 0; i < kNumObjects; ++i) {
+    space->SetObjectAge(objects[i], static_cast<uint8_t>(i));
+  }
+  for (size_t i = 0; i < kNumObjects; ++i) {
+    EXPECT_EQ(i, space->GetObjectAge(objects[i]));
+  }
+
+  // The objects allocated after the space is cleared are new.
+  space->Clear();
+  for (size_t i = 0; i < kNumObjects; ++i) {
+    mirror::Object* obj = space->AllocNonvirtual(BumpPointerSpace::kAlignment * (i + 1));
+    ASSERT_EQ(objects[i], obj);
+    EXPECT_EQ(0U, space->GetObjectAge(obj));
+  }
+}
+
+TEST_F(BumpPointerSpaceTest, TlabRefills) {
+  std::unique_ptr<BumpPointerSpace> space(BumpPointerSpace::Create("test", 16 * MB, nullptr));
+  ASSERT_TRUE(space.get() != nullptr);
+  Thread* self = Thread::Current();
+  TlabStats* stats = self->GetTlabStats();
+  const TlabStats saved_stats = *stats;
+  *stats = TlabStats();
+  static constexpr size_t kTlabSize = 64 * KB;
+  stats->refill_size = kTlabSize;
+
+  ASSERT_TRUE(space->AllocNewTlab(self, kTlabSize));
+  EXPECT_EQ(kTlabSize, self->TlabSize());
+  EXPECT_EQ(1U, stats->refills);
+  EXPECT_EQ(0U, stats->waste_bytes);
+
+  // The unused end of the TLAB is wasted by the refill.
+  self->AllocTlab(8 * KB);
+  ASSERT_TRUE(space->AllocNewTlab(self, kTlabSize));
+  EXPECT_EQ(2U, stats->refills);
+  EXPECT_EQ(kTlabSize - 8 * KB, stats->waste_bytes);
+
+  // A thread which refills often gets larger TLABs before the next GC.
+  size_t refills = 2;
+  while (stats->refill_size == kTlabSize) {
+    ASSERT_TRUE(space->AllocNewTlab(self, kTlabSize));
+    ++refills;
+  }
+  EXPECT_EQ(2 * kTlabSize, stats->refill_size);
+  EXPECT_EQ(refills, stats->refills);
+  EXPECT_EQ(refills * kTlabSize, space->GetBytesAllocated());
+
+  // The GC adapts the size to the allocation rate since the last GC.
+  space->RevokeThreadLocalBuffers(self);
+  EXPECT_FALSE(self->HasTlab());
+  EXPECT_EQ(0U, stats->bytes_since_gc);
+  EXPECT_LT(stats->refill_size, 2 * kTlabSize);
+  EXPECT_EQ(refills * kTlabSize, space->GetBytesAllocated());
+  // Without a TLAB, the size is kept.
+  const size_t refill_size = stats->refill_size;
+  space->RevokeThreadLocalBuffers(self);
+  EXPECT_EQ(refill_size, stats->refill_size);
+
+  *stats = saved_stats;
+}
+
+}  // namespace space
+}  // namespace gc
+}  // namespace art
@@ -492,7 +492,7 @@ void LargeObjectSpace::SweepCallback(size_t num_ptrs, mirror::Object** ptrs, voi
   SweepCallbackContext* context = static_cast<SweepCallbackContext*>(arg);
   space::LargeObjectSpace* space = context->space->AsLargeObjectSpace();
   Thread* self = context->self;
-  Locks::heap_bitmap_lock_->AssertExclusiveHeld(self);
+  // The callback may run on a GC worker thread, while the collector holds the heap bitmap lock.
   // If the bitmaps aren't swapped we need to clear the bits since the GC isn't going to re-swap
   // the bitmaps as an optimization.
   if (!context->swap_bitmaps) {
@@ -506,7 +506,14 @@ void LargeObjectSpace::SweepCallback(size_t num_ptrs, mirror::Object** ptrs, voi
 }
 
 collector::ObjectBytePair LargeObjectSpace::Sweep(bool swap_bitmaps) {
-  if (Begin() >= End()) {
+  Locks::heap_bitmap_lock_->AssertExclusiveHeld(Thread::Current());
+  return Sweep(swap_bitmaps, reinterpret_cast<uintptr_t>(Begin()),
+               reinterpret_cast<uintptr_t>(End()));
+}
+
+collector::ObjectBytePair LargeObjectSpace::Sweep(bool swap_bitmaps, uintptr_t sweep_begin,
+                                                  uintptr_t sweep_end) {
+  if (sweep_begin >= sweep_end) {
     return collector::ObjectBytePair(0, 0);
   }
   accounting::LargeObjectBitmap* live_bitmap = GetLiveBitmap();
@@ -515,9 +522,8 @@ collector::ObjectBytePair LargeObjectSpace::Sweep(bool swap_bitmaps) {
     std::swap(live_bitmap, mark_bitmap);
   }
   AllocSpace::SweepCallbackContext scc(swap_bitmaps, this);
-  accounting::LargeObjectBitmap::SweepWalk(*live_bitmap, *mark_bitmap,
-                                           reinterpret_cast<uintptr_t>(Begin()),
-                                           reinterpret_cast<uintptr_t>(End()), SweepCallback, &scc);
+  accounting::LargeObjectBitmap::SweepWalk(*live_bitmap, *mark_bitmap, sweep_begin, sweep_end,
+                                           SweepCallback, &scc);
   return scc.freed;
 }
 
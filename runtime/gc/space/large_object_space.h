@@ -66,7 +66,11 @@ class LargeObjectSpace : public DiscontinuousSpace, public AllocSpace {
   AllocSpace* AsAllocSpace() OVERRIDE {
     return this;
   }
-  collector::ObjectBytePair Sweep(bool swap_bitmaps);
+  collector::ObjectBytePair Sweep(bool swap_bitmaps)
+      EXCLUSIVE_LOCKS_REQUIRED(Locks::heap_bitmap_lock_);
+  // Sweep the objects between sweep_begin and sweep_end only, see
+  // ContinuousMemMapAllocSpace::Sweep.
+  collector::ObjectBytePair Sweep(bool swap_bitmaps, uintptr_t sweep_begin, uintptr_t sweep_end);
   virtual bool CanMoveObjects() const OVERRIDE {
     return false;
   }
@@ -28,6 +28,8 @@ class LargeObjectSpaceTest : public SpaceTest {
   static constexpr size_t kNumThreads = 10;
   static constexpr size_t kNumIterations = 1000;
   void RaceTest();
+
+  void SweepRangeTest();
 };
 
 
@@ -145,6 +147,43 @@ void LargeObjectSpaceTest::RaceTest() {
   }
 }
 
+// Sweeps the space in two ranges, as the parallel sweep tasks do.
+void LargeObjectSpaceTest::SweepRangeTest() {
+  Thread* self = Thread::Current();
+  LargeObjectSpace* los = space::FreeListSpace::Create("large object space", nullptr, 128 * MB);
+  static const size_t num_allocations = 64;
+  std::vector<mirror::Object*> objects;
+  for (size_t i = 0; i < num_allocations; ++i) {
+    size_t allocation_size = 0;
+    mirror::Object* obj = los->Alloc(self, 64 * KB, &allocation_size, nullptr);
+    ASSERT_TRUE(obj != nullptr);
+    los->GetLiveBitmap()->Set(obj);
+    // Keep every third object.
+    if (i % 3 == 0) {
+      los->GetMarkBitmap()->Set(obj);
+    }
+    objects.push_back(obj);
+  }
+  const uintptr_t begin = reinterpret_cast<uintptr_t>(los->Begin());
+  const uintptr_t end = reinterpret_cast<uintptr_t>(los->End());
+  // Split at a bitmap word.
+  const uintptr_t split = RoundUp(begin + (end - begin) / 2, kBitsPerWord * kPageSize);
+  ASSERT_LT(split, end);
+  collector::ObjectBytePair freed;
+  {
+    WriterMutexLock mu(self, *Locks::heap_bitmap_lock_);
+    freed.Add(los->Sweep(false, begin, split));
+    freed.Add(los->Sweep(false, split, end));
+  }
+  const size_t num_marked = (num_allocations + 2) / 3;
+  EXPECT_EQ(num_allocations - num_marked, freed.objects);
+  EXPECT_EQ(num_marked, los->GetObjectsAllocated());
+  for (size_t i = 0; i < num_allocations; ++i) {
+    EXPECT_EQ(i % 3 == 0, los->GetLiveBitmap()->Test(objects[i]));
+  }
+  delete los;
+}
+
 TEST_F(LargeObjectSpaceTest, LargeObjectTest) {
   LargeObjectTest();
 }
@@ -153,6 +192,10 @@ TEST_F(LargeObjectSpaceTest, RaceTest) {
   RaceTest();
 }
 
+TEST_F(LargeObjectSpaceTest, SweepRangeTest) {
+  SweepRangeTest();
+}
+
 }  // namespace space
 }  // namespace gc
 }  // namespace art
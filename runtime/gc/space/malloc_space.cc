@@ -232,7 +232,7 @@ void MallocSpace::SweepCallback(size_t num_ptrs, mirror::Object** ptrs, void* ar
   SweepCallbackContext* context = static_cast<SweepCallbackContext*>(arg);
   space::MallocSpace* space = context->space->AsMallocSpace();
   Thread* self = context->self;
-  Locks::heap_bitmap_lock_->AssertExclusiveHeld(self);
+  // The callback may run on a GC worker thread, while the collector holds the heap bitmap lock.
   // If the bitmaps aren't swapped we need to clear the bits since the GC isn't going to re-swap
   // the bitmaps as an optimization.
   if (!context->swap_bitmaps) {
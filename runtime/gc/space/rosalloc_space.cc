@@ -44,20 +44,24 @@ static constexpr bool kVerifyFreedBytes = false;
 RosAllocSpace::RosAllocSpace(const std::string& name, MemMap* mem_map,
                              art::gc::allocator::RosAlloc* rosalloc, byte* begin, byte* end,
                              byte* limit, size_t growth_limit, bool can_move_objects,
-                             size_t starting_size, size_t initial_size, bool low_memory_mode)
+                             size_t starting_size, size_t initial_size, bool low_memory_mode,
+                             size_t num_thread_local_size_brackets)
     : MallocSpace(name, mem_map, begin, end, limit, growth_limit, true, can_move_objects,
                   starting_size, initial_size),
-      rosalloc_(rosalloc), low_memory_mode_(low_memory_mode) {
+      rosalloc_(rosalloc), low_memory_mode_(low_memory_mode),
+      num_thread_local_size_brackets_(num_thread_local_size_brackets) {
   CHECK(rosalloc != nullptr);
 }
 
 RosAllocSpace* RosAllocSpace::CreateFromMemMap(MemMap* mem_map, const std::string& name,
                                                size_t starting_size, size_t initial_size,
                                                size_t growth_limit, size_t capacity,
-                                               bool low_memory_mode, bool can_move_objects) {
+                                               bool low_memory_mode, bool can_move_objects,
+                                               size_t num_thread_local_size_brackets) {
   DCHECK(mem_map != nullptr);
   allocator::RosAlloc* rosalloc = CreateRosAlloc(mem_map->Begin(), starting_size, initial_size,
-                                                 capacity, low_memory_mode);
+                                                 capacity, low_memory_mode,
+                                                 num_thread_local_size_brackets);
   if (rosalloc == NULL) {
     LOG(ERROR) << "Failed to initialize rosalloc for alloc space (" << name << ")";
     return NULL;
@@ -77,7 +81,8 @@ RosAllocSpace* RosAllocSpace::CreateFromMemMap(MemMap* mem_map, const std::strin
     LOG(FATAL) << "Unimplemented";
   } else {
     return new RosAllocSpace(name, mem_map, rosalloc, begin, end, begin + capacity, growth_limit,
-                             can_move_objects, starting_size, initial_size, low_memory_mode);
+                             can_move_objects, starting_size, initial_size, low_memory_mode,
+                             num_thread_local_size_brackets);
   }
 }
 
@@ -87,7 +92,8 @@ RosAllocSpace::~RosAllocSpace() {
 
 RosAllocSpace* RosAllocSpace::Create(const std::string& name, size_t initial_size,
                                      size_t growth_limit, size_t capacity, byte* requested_begin,
-                                     bool low_memory_mode, bool can_move_objects) {
+                                     bool low_memory_mode, bool can_move_objects,
+                                     size_t num_thread_local_size_brackets) {
   uint64_t start_time = 0;
   if (VLOG_IS_ON(heap) || VLOG_IS_ON(startup)) {
     start_time = NanoTime();
@@ -113,7 +119,7 @@ RosAllocSpace* RosAllocSpace::Create(const std::string& name, size_t initial_siz
 
   RosAllocSpace* space = CreateFromMemMap(mem_map, name, starting_size, initial_size,
                                           growth_limit, capacity, low_memory_mode,
-                                          can_move_objects);
+                                          can_move_objects, num_thread_local_size_brackets);
   // We start out with only the initial size possibly containing objects.
   if (VLOG_IS_ON(heap) || VLOG_IS_ON(startup)) {
     LOG(INFO) << "RosAllocSpace::Create exiting (" << PrettyDuration(NanoTime() - start_time)
@@ -124,7 +130,8 @@ RosAllocSpace* RosAllocSpace::Create(const std::string& name, size_t initial_siz
 
 allocator::RosAlloc* RosAllocSpace::CreateRosAlloc(void* begin, size_t morecore_start,
                                                    size_t initial_size,
-                                                   size_t maximum_size, bool low_memory_mode) {
+                                                   size_t maximum_size, bool low_memory_mode,
+                                                   size_t num_thread_local_size_brackets) {
   // clear errno to allow PLOG on error
   errno = 0;
   // create rosalloc using our backing storage starting at begin and
@@ -134,7 +141,9 @@ allocator::RosAlloc* RosAllocSpace::CreateRosAlloc(void* begin, size_t morecore_
       begin, morecore_start, maximum_size,
       low_memory_mode ?
           art::gc::allocator::RosAlloc::kPageReleaseModeAll :
-          art::gc::allocator::RosAlloc::kPageReleaseModeSizeAndEnd);
+          art::gc::allocator::RosAlloc::kPageReleaseModeSizeAndEnd,
+      art::gc::allocator::RosAlloc::kDefaultPageReleaseSizeThreshold,
+      num_thread_local_size_brackets);
   if (rosalloc != NULL) {
     rosalloc->SetFootprintLimit(initial_size);
   } else {
@@ -168,7 +177,7 @@ MallocSpace* RosAllocSpace::CreateInstance(const std::string& name, MemMap* mem_
                                            bool can_move_objects) {
   return new RosAllocSpace(name, mem_map, reinterpret_cast<allocator::RosAlloc*>(allocator),
                            begin, end, limit, growth_limit, can_move_objects, starting_size_,
-                           initial_size_, low_memory_mode_);
+                           initial_size_, low_memory_mode_, num_thread_local_size_brackets_);
 }
 
 size_t RosAllocSpace::Free(Thread* self, mirror::Object* ptr) {
@@ -352,7 +361,8 @@ void RosAllocSpace::Clear() {
   SetEnd(begin_ + starting_size_);
   delete rosalloc_;
   rosalloc_ = CreateRosAlloc(mem_map_->Begin(), starting_size_, initial_size_,
-                             NonGrowthLimitCapacity(), low_memory_mode_);
+                             NonGrowthLimitCapacity(), low_memory_mode_,
+                             num_thread_local_size_brackets_);
   SetFootprintLimit(footprint_limit);
 }
 
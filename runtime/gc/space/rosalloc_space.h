@@ -37,14 +37,18 @@ class RosAllocSpace : public MallocSpace {
   // Create a RosAllocSpace with the requested sizes. The requested
   // base address is not guaranteed to be granted, if it is required,
   // the caller should call Begin on the returned space to confirm the
-  // request was granted.
+  // request was granted. The allocations of the num_thread_local_size_brackets
+  // smallest size brackets use thread-local runs.
   static RosAllocSpace* Create(const std::string& name, size_t initial_size, size_t growth_limit,
                                size_t capacity, byte* requested_begin, bool low_memory_mode,
-                               bool can_move_objects);
+                               bool can_move_objects,
+                               size_t num_thread_local_size_brackets =
+                                   allocator::RosAlloc::kDefaultNumThreadLocalSizeBrackets);
   static RosAllocSpace* CreateFromMemMap(MemMap* mem_map, const std::string& name,
                                          size_t starting_size, size_t initial_size,
                                          size_t growth_limit, size_t capacity,
-                                         bool low_memory_mode, bool can_move_objects);
+                                         bool low_memory_mode, bool can_move_objects,
+                                         size_t num_thread_local_size_brackets);
 
   mirror::Object* AllocWithGrowth(Thread* self, size_t num_bytes, size_t* bytes_allocated,
                                   size_t* usable_size) OVERRIDE LOCKS_EXCLUDED(lock_);
@@ -127,7 +131,8 @@ class RosAllocSpace : public MallocSpace {
  protected:
   RosAllocSpace(const std::string& name, MemMap* mem_map, allocator::RosAlloc* rosalloc,
                 byte* begin, byte* end, byte* limit, size_t growth_limit, bool can_move_objects,
-                size_t starting_size, size_t initial_size, bool low_memory_mode);
+                size_t starting_size, size_t initial_size, bool low_memory_mode,
+                size_t num_thread_local_size_brackets);
 
  private:
   template<bool kThreadSafe = true>
@@ -136,10 +141,12 @@ class RosAllocSpace : public MallocSpace {
 
   void* CreateAllocator(void* base, size_t morecore_start, size_t initial_size,
                         size_t maximum_size, bool low_memory_mode) OVERRIDE {
-    return CreateRosAlloc(base, morecore_start, initial_size, maximum_size, low_memory_mode);
+    return CreateRosAlloc(base, morecore_start, initial_size, maximum_size, low_memory_mode,
+                          num_thread_local_size_brackets_);
   }
   static allocator::RosAlloc* CreateRosAlloc(void* base, size_t morecore_start, size_t initial_size,
-                                             size_t maximum_size, bool low_memory_mode);
+                                             size_t maximum_size, bool low_memory_mode,
+                                             size_t num_thread_local_size_brackets);
 
   void InspectAllRosAlloc(void (*callback)(void *start, void *end, size_t num_bytes, void* callback_arg),
                           void* arg, bool do_null_callback_at_end)
@@ -154,6 +161,8 @@ class RosAllocSpace : public MallocSpace {
 
   const bool low_memory_mode_;
 
+  const size_t num_thread_local_size_brackets_;
+
   friend class collector::MarkSweep;
 
   DISALLOW_COPY_AND_ASSIGN(RosAllocSpace);
@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "space_test.h"
+
+#include "atomic.h"
+#include "gc/allocator/rosalloc-inl.h"
+#include "thread_pool.h"
+
+namespace art {
+namespace gc {
+namespace space {
+
+static constexpr size_t kAllocationsPerThread = 20000;
+// The size of the largest size bracket.
+static constexpr size_t kMaxObjectSize = 2 * KB;
+// The objects each thread keeps, and frees itself.
+static constexpr size_t kLocalObjects = 64;
+// The objects which are handed over between the threads, and freed by the thread which takes
+// them over.
+static constexpr size_t kSharedObjects = 256;
+
+// Allocates and frees objects of all the size brackets. Half of the objects are exchanged with
+// the shared objects, freeing the object exchanged, which another thread likely allocated.
+class AllocAndFreeTask : public Task {
+ public:
+  AllocAndFreeTask(allocator::RosAlloc* rosalloc, Atomic<void*>* shared_objects, size_t seed)
+      : rosalloc_(rosalloc), shared_objects_(shared_objects), seed_(seed) {
+  }
+
+  void Run(Thread* self) {
+    rosalloc_->AssertThreadLocalRunsAreRevoked(self);
+    void* local_objects[kLocalObjects] = { };
+    for (size_t i = 0; i < kAllocationsPerThread; ++i) {
+      size_t size = sizeof(void*) + test_rand(&seed_) % (kMaxObjectSize - sizeof(void*) + 1);
+      size_t bytes_allocated = 0;
+      void* obj = rosalloc_->Alloc(self, size, &bytes_allocated);
+      ASSERT_TRUE(obj != nullptr);
+      ASSERT_GE(bytes_allocated, size);
+      // Tag the object to catch the slots allocated twice.
+      *reinterpret_cast<void**>(obj) = obj;
+      void* old_obj;
+      if (i % 2 == 0) {
+        Atomic<void*>* shared_obj = &shared_objects_[test_rand(&seed_) % kSharedObjects];
+        do {
+          old_obj = shared_obj->LoadRelaxed();
+        } while (!shared_obj->CompareExchangeWeakSequentiallyConsistent(old_obj, obj));
+      } else {
+        old_obj = local_objects[i / 2 % kLocalObjects];
+        local_objects[i / 2 % kLocalObjects] = obj;
+      }
+      if (old_obj != nullptr) {
+        ASSERT_EQ(*reinterpret_cast<void**>(old_obj), old_obj);
+        rosalloc_->Free(self, old_obj);
+      }
+    }
+    for (void* obj : local_objects) {
+      if (obj != nullptr) {
+        rosalloc_->Free(self, obj);
+      }
+    }
+    // The other threads may still free slots of the thread-local runs.
+    rosalloc_->RevokeThreadLocalRuns(self);
+  }
+
+  void Finalize() {
+    delete this;
+  }
+
+ private:
+  allocator::RosAlloc* const rosalloc_;
+  Atomic<void*>* const shared_objects_;
+  size_t seed_;
+};
+
+class RosAllocSpaceThreadsTest : public SpaceTest {
+ public:
+  // Creates a space where the num_thread_local_size_brackets smallest size brackets use
+  // thread-local runs.
+  RosAllocSpace* CreateSpace(size_t num_thread_local_size_brackets) {
+    size_t capacity = 64 * MB;
+    RosAllocSpace* space = RosAllocSpace::Create("test", capacity, capacity, capacity, nullptr,
+                                                 false, false, num_thread_local_size_brackets);
+    EXPECT_TRUE(space != nullptr);
+    EXPECT_EQ(space->GetRosAlloc()->GetNumThreadLocalSizeBrackets(),
+              num_thread_local_size_brackets);
+    // Make space findable to the heap, will also delete space when runtime is cleaned up. The
+    // space isn't the default one, the runtime doesn't allocate in it.
+    Runtime::Current()->GetHeap()->AddSpace(space);
+    return space;
+  }
+
+  // Returns the allocations per second of num_threads threads allocating and freeing objects
+  // in space.
+  double AllocAndFreeThroughput(RosAllocSpace* space, size_t num_threads) {
+    Thread* self = Thread::Current();
+    allocator::RosAlloc* rosalloc = space->GetRosAlloc();
+    std::unique_ptr<Atomic<void*>[]> shared_objects(new Atomic<void*>[kSharedObjects]);
+
+    ThreadPool thread_pool("RosAlloc space threads test thread pool", num_threads);
+    for (size_t i = 0; i < num_threads; ++i) {
+      thread_pool.AddTask(self, new AllocAndFreeTask(rosalloc, shared_objects.get(), i + 1));
+    }
+    uint64_t start_time = NanoTime();
+    thread_pool.StartWorkers(self);
+    // Only the workers allocate, they revoke their thread-local runs when done.
+    thread_pool.Wait(self, false, false);
+    uint64_t duration = NanoTime() - start_time;
+
+    for (size_t i = 0; i < kSharedObjects; ++i) {
+      void* obj = shared_objects[i].LoadRelaxed();
+      if (obj != nullptr) {
+        rosalloc->Free(self, obj);
+      }
+    }
+    // No slot leaked, even those freed while their runs stopped being thread-local.
+    size_t bytes_allocated = 0;
+    rosalloc->InspectAll(allocator::RosAlloc::BytesAllocatedCallback, &bytes_allocated);
+    EXPECT_EQ(bytes_allocated, 0U);
+    return num_threads * kAllocationsPerThread * 1e9 / duration;
+  }
+};
+
+TEST_F(RosAllocSpaceThreadsTest, AllocAndFree) {
+  static const size_t kNumThreads[] = { 1, 2, 4, 8, 16, 32 };
+  RosAllocSpace* default_space =
+      CreateSpace(allocator::RosAlloc::kDefaultNumThreadLocalSizeBrackets);
+  RosAllocSpace* all_brackets_space = CreateSpace(kNumRosAllocThreadLocalSizeBrackets);
+  ASSERT_TRUE(default_space != nullptr);
+  ASSERT_TRUE(all_brackets_space != nullptr);
+  for (size_t num_threads : kNumThreads) {
+    double default_throughput = AllocAndFreeThroughput(default_space, num_threads);
+    double all_brackets_throughput = AllocAndFreeThroughput(all_brackets_space, num_threads);
+    LOG(INFO) << num_threads << " threads: "
+              << static_cast<uint64_t>(default_throughput) << " allocations/s with "
+              << allocator::RosAlloc::kDefaultNumThreadLocalSizeBrackets
+              << " thread-local size brackets, "
+              << static_cast<uint64_t>(all_brackets_throughput) << " allocations/s with "
+              << kNumRosAllocThreadLocalSizeBrackets;
+  }
+}
+
+}  // namespace space
+}  // namespace gc
+}  // namespace art
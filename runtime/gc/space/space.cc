@@ -82,6 +82,14 @@ DiscontinuousSpace::DiscontinuousSpace(const std::string& name,
 }
 
 collector::ObjectBytePair ContinuousMemMapAllocSpace::Sweep(bool swap_bitmaps) {
+  Locks::heap_bitmap_lock_->AssertExclusiveHeld(Thread::Current());
+  return Sweep(swap_bitmaps, reinterpret_cast<uintptr_t>(Begin()),
+               reinterpret_cast<uintptr_t>(End()));
+}
+
+collector::ObjectBytePair ContinuousMemMapAllocSpace::Sweep(bool swap_bitmaps,
+                                                            uintptr_t sweep_begin,
+                                                            uintptr_t sweep_end) {
   accounting::ContinuousSpaceBitmap* live_bitmap = GetLiveBitmap();
   accounting::ContinuousSpaceBitmap* mark_bitmap = GetMarkBitmap();
   // If the bitmaps are bound then sweeping this space clearly won't do anything.
@@ -94,8 +102,8 @@ collector::ObjectBytePair ContinuousMemMapAllocSpace::Sweep(bool swap_bitmaps) {
   }
   // Bitmaps are pre-swapped for optimization which enables sweeping with the heap unlocked.
   accounting::ContinuousSpaceBitmap::SweepWalk(
-      *live_bitmap, *mark_bitmap, reinterpret_cast<uintptr_t>(Begin()),
-      reinterpret_cast<uintptr_t>(End()), GetSweepCallback(), reinterpret_cast<void*>(&scc));
+      *live_bitmap, *mark_bitmap, sweep_begin, sweep_end, GetSweepCallback(),
+      reinterpret_cast<void*>(&scc));
   return scc.freed;
 }
 
@@ -417,7 +417,12 @@ class ContinuousMemMapAllocSpace : public MemMapSpace, public AllocSpace {
     return mark_bitmap_.get();
   }
 
-  collector::ObjectBytePair Sweep(bool swap_bitmaps);
+  collector::ObjectBytePair Sweep(bool swap_bitmaps)
+      EXCLUSIVE_LOCKS_REQUIRED(Locks::heap_bitmap_lock_);
+  // Sweep the objects between sweep_begin and sweep_end only. Used by the parallel sweep tasks,
+  // whose ranges must not share a word of the bitmaps, while the thread waiting for them holds
+  // the heap bitmap lock.
+  collector::ObjectBytePair Sweep(bool swap_bitmaps, uintptr_t sweep_begin, uintptr_t sweep_end);
   virtual accounting::ContinuousSpaceBitmap::SweepCallback* GetSweepCallback() = 0;
 
  protected:
@@ -54,6 +54,10 @@ class MANAGED String FINAL : public Object {
     return OFFSET_OF_OBJECT_MEMBER(String, offset_);
   }
 
+  static MemberOffset HashCodeOffset() {
+    return OFFSET_OF_OBJECT_MEMBER(String, hash_code_);
+  }
+
   CharArray* GetCharArray() SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
   int32_t GetOffset() SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
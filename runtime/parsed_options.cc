@@ -25,6 +25,7 @@
 #include "gc/heap.h"
 #include "monitor.h"
 #include "runtime.h"
+#include "thread.h"
 #include "trace.h"
 #include "utils.h"
 
@@ -190,6 +191,10 @@ bool ParsedOptions::Parse(const RuntimeOptions& options, bool ignore_unrecognize
   parallel_gc_threads_ = sysconf(_SC_NPROCESSORS_CONF) - 1;
   // Only the main GC thread, no workers.
   conc_gc_threads_ = 0;
+  // Sweep with the main GC thread only, like the other unpaused phases.
+  sweep_gc_threads_ = 0;
+  promotion_age_ = gc::Heap::kDefaultPromotionAge;
+  rosalloc_thread_local_size_brackets_ = gc::Heap::kDefaultRosAllocThreadLocalSizeBrackets;
   // The default GC type is set in makefiles.
 #if ART_DEFAULT_GC_TYPE_IS_CMS
   collector_type_ = gc::kCollectorTypeCMS;
@@ -382,6 +387,27 @@ bool ParsedOptions::Parse(const RuntimeOptions& options, bool ignore_unrecognize
       if (!ParseUnsignedInteger(option, '=', &conc_gc_threads_)) {
         return false;
       }
+    } else if (StartsWith(option, "-XX:SweepGCThreads=")) {
+      if (!ParseUnsignedInteger(option, '=', &sweep_gc_threads_)) {
+        return false;
+      }
+    } else if (StartsWith(option, "-XX:PromotionAge=")) {
+      if (!ParseUnsignedInteger(option, '=', &promotion_age_)) {
+        return false;
+      }
+      if (promotion_age_ > gc::Heap::kMaxPromotionAge) {
+        Usage("-XX:PromotionAge must be at most %zd\n", gc::Heap::kMaxPromotionAge);
+        return false;
+      }
+    } else if (StartsWith(option, "-XX:RosAllocThreadLocalSizeBrackets=")) {
+      if (!ParseUnsignedInteger(option, '=', &rosalloc_thread_local_size_brackets_)) {
+        return false;
+      }
+      if (rosalloc_thread_local_size_brackets_ > kNumRosAllocThreadLocalSizeBrackets) {
+        Usage("-XX:RosAllocThreadLocalSizeBrackets must be at most %zd\n",
+              kNumRosAllocThreadLocalSizeBrackets);
+        return false;
+      }
     } else if (StartsWith(option, "-Xss")) {
       size_t size = ParseMemoryOption(option.substr(strlen("-Xss")).c_str(), 1);
       if (size == 0) {
@@ -600,6 +626,8 @@ bool ParsedOptions::Parse(const RuntimeOptions& options, bool ignore_unrecognize
       if (!ParseUnsignedInteger(option, ':', &profiler_options_.max_stack_depth_)) {
         return false;
       }
+    } else if (option == "-Xprofile-receivers") {
+      profiler_options_.profile_receivers_ = true;
     } else if (StartsWith(option, "-Xcompiler:")) {
       if (!ParseStringAfterChar(option, ':', &compiler_executable_)) {
         return false;
@@ -676,16 +704,23 @@ bool ParsedOptions::Parse(const RuntimeOptions& options, bool ignore_unrecognize
     }
   }
   // If not set, background collector type defaults to homogeneous compaction.
-  // If foreground is GSS, use GSS as background collector.
+  // If foreground is GSS or CC, use it as background collector.
   // If not low memory mode, semispace otherwise.
   if (background_collector_type_ == gc::kCollectorTypeNone) {
-    if (collector_type_ != gc::kCollectorTypeGSS) {
+    if (collector_type_ != gc::kCollectorTypeGSS && collector_type_ != gc::kCollectorTypeCC) {
       background_collector_type_ = low_memory_mode_ ?
           gc::kCollectorTypeSS : gc::kCollectorTypeHomogeneousSpaceCompact;
     } else {
       background_collector_type_ = collector_type_;
     }
   }
+  // The heap cannot transition to or from the concurrent copying collector, which only runs the
+  // interpreter.
+  if ((collector_type_ == gc::kCollectorTypeCC) !=
+      (background_collector_type_ == gc::kCollectorTypeCC)) {
+    Usage("-Xgc:CC and -XX:BackgroundGC=CC must be used together\n");
+    return false;
+  }
 
   // If a reference to the dalvik core.jar snuck in, replace it with
   // the art specific version. This can happen with on device
@@ -791,6 +826,9 @@ void ParsedOptions::Usage(const char* fmt, ...) {
   UsageMessage(stream, "  -Ximage:filename\n");
   UsageMessage(stream, "  -XX:ParallelGCThreads=integervalue\n");
   UsageMessage(stream, "  -XX:ConcGCThreads=integervalue\n");
+  UsageMessage(stream, "  -XX:SweepGCThreads=integervalue\n");
+  UsageMessage(stream, "  -XX:PromotionAge=integervalue\n");
+  UsageMessage(stream, "  -XX:RosAllocThreadLocalSizeBrackets=integervalue\n");
   UsageMessage(stream, "  -XX:MaxSpinsBeforeThinLockInflation=integervalue\n");
   UsageMessage(stream, "  -XX:LongPauseLogThreshold=integervalue\n");
   UsageMessage(stream, "  -XX:LongGCLogThreshold=integervalue\n");
@@ -812,6 +850,7 @@ void ParsedOptions::Usage(const char* fmt, ...) {
   UsageMessage(stream, "  -Xprofile-top-k-change-threshold:doublevalue\n");
   UsageMessage(stream, "  -Xprofile-type:{method,stack}\n");
   UsageMessage(stream, "  -Xprofile-max-stack-depth:integervalue\n");
+  UsageMessage(stream, "  -Xprofile-receivers\n");
   UsageMessage(stream, "  -Xcompiler:filename\n");
   UsageMessage(stream, "  -Xcompiler-option dex2oat-option\n");
   UsageMessage(stream, "  -Ximage-compiler-option dex2oat-option\n");
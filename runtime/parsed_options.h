@@ -76,6 +76,9 @@ class ParsedOptions {
   double foreground_heap_growth_multiplier_;
   unsigned int parallel_gc_threads_;
   unsigned int conc_gc_threads_;
+  unsigned int sweep_gc_threads_;
+  unsigned int promotion_age_;
+  unsigned int rosalloc_thread_local_size_brackets_;
   gc::CollectorType collector_type_;
   gc::CollectorType background_collector_type_;
   size_t stack_size_;
@@ -22,7 +22,23 @@
 
 namespace art {
 
-class ParsedOptionsTest : public CommonRuntimeTest {};
+class ParsedOptionsTest : public CommonRuntimeTest {
+ protected:
+  // Parses the options with hooks that drop the usage messages and do not exit.
+  static ParsedOptions* ParseQuietly(RuntimeOptions* options) {
+    options->push_back(std::make_pair("vfprintf", reinterpret_cast<void*>(&QuietVfprintf)));
+    options->push_back(std::make_pair("exit", reinterpret_cast<void*>(&IgnoreExit)));
+    return ParsedOptions::Create(*options, false);
+  }
+
+ private:
+  static jint QuietVfprintf(FILE* /* stream */, const char* /* format */, va_list /* ap */) {
+    return 0;
+  }
+
+  static void IgnoreExit(jint /* status */) {
+  }
+};
 
 TEST_F(ParsedOptionsTest, ParsedOptions) {
   void* test_vfprintf = reinterpret_cast<void*>(0xa);
@@ -83,4 +99,40 @@ TEST_F(ParsedOptionsTest, ParsedOptions) {
   EXPECT_EQ("baz=qux", parsed->properties_[1]);
 }
 
+TEST_F(ParsedOptionsTest, ConcurrentCopyingCollector) {
+  void* null = reinterpret_cast<void*>(NULL);
+  {
+    // The concurrent copying collector is also the default background collector.
+    RuntimeOptions options;
+    options.push_back(std::make_pair("-Xgc:CC", null));
+    std::unique_ptr<ParsedOptions> parsed(ParseQuietly(&options));
+    ASSERT_TRUE(parsed.get() != NULL);
+    EXPECT_EQ(gc::kCollectorTypeCC, parsed->collector_type_);
+    EXPECT_EQ(gc::kCollectorTypeCC, parsed->background_collector_type_);
+  }
+  {
+    RuntimeOptions options;
+    options.push_back(std::make_pair("-Xgc:CC", null));
+    options.push_back(std::make_pair("-XX:BackgroundGC=CC", null));
+    std::unique_ptr<ParsedOptions> parsed(ParseQuietly(&options));
+    ASSERT_TRUE(parsed.get() != NULL);
+    EXPECT_EQ(gc::kCollectorTypeCC, parsed->background_collector_type_);
+  }
+  {
+    // There is no transition to or from the concurrent copying collector.
+    RuntimeOptions options;
+    options.push_back(std::make_pair("-Xgc:CC", null));
+    options.push_back(std::make_pair("-XX:BackgroundGC=SS", null));
+    std::unique_ptr<ParsedOptions> parsed(ParseQuietly(&options));
+    EXPECT_TRUE(parsed.get() == NULL);
+  }
+  {
+    RuntimeOptions options;
+    options.push_back(std::make_pair("-Xgc:CMS", null));
+    options.push_back(std::make_pair("-XX:BackgroundGC=CC", null));
+    std::unique_ptr<ParsedOptions> parsed(ParseQuietly(&options));
+    EXPECT_TRUE(parsed.get() == NULL);
+  }
+}
+
 }  // namespace art
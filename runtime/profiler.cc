@@ -16,16 +16,20 @@
 
 #include "profiler.h"
 
+#include <algorithm>
 #include <fstream>
+#include <limits>
 #include <sys/uio.h>
 #include <sys/file.h>
 
+#include "arch/context.h"
 #include "base/stl_util.h"
 #include "base/unix_file/fd_file.h"
 #include "class_linker.h"
 #include "common_throws.h"
 #include "debugger.h"
 #include "dex_file-inl.h"
+#include "dex_instruction-inl.h"
 #include "instrumentation.h"
 #include "mirror/art_method-inl.h"
 #include "mirror/class-inl.h"
@@ -86,6 +90,65 @@ class BoundedStackVisitor : public StackVisitor {
   uint32_t depth_;
 };
 
+// Find the receiver of the method on top of the Java stack in the frame of its caller. The
+// caller must be at an invoke-virtual or invoke-interface, whose first argument register still
+// holds the receiver: the frame of the callee may have overwritten its own copy.
+class ReceiverVisitor : public StackVisitor {
+ public:
+  ReceiverVisitor(Thread* thread, Context* context)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_)
+      : StackVisitor(thread, context), callee_(nullptr), caller_(nullptr),
+        dex_pc_(DexFile::kDexNoIndex), receiver_class_(nullptr) {
+  }
+
+  bool VisitFrame() SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+    mirror::ArtMethod* m = GetMethod();
+    if (m->IsRuntimeMethod()) {
+      return true;
+    }
+    if (callee_ == nullptr) {
+      callee_ = m;
+      // Static methods have no receiver.
+      return !m->IsStatic();
+    }
+    const DexFile::CodeItem* code_item = m->GetCodeItem();
+    uint32_t dex_pc = GetDexPc();
+    if (code_item == nullptr || dex_pc == DexFile::kDexNoIndex) {
+      return false;
+    }
+    const Instruction* inst = Instruction::At(code_item->insns_ + dex_pc);
+    switch (inst->Opcode()) {
+      case Instruction::INVOKE_VIRTUAL:
+      case Instruction::INVOKE_VIRTUAL_RANGE:
+      case Instruction::INVOKE_VIRTUAL_QUICK:
+      case Instruction::INVOKE_VIRTUAL_RANGE_QUICK:
+      case Instruction::INVOKE_INTERFACE:
+      case Instruction::INVOKE_INTERFACE_RANGE: {
+        uint32_t value;
+        if (GetVReg(m, inst->VRegC(), kReferenceVReg, &value) && value != 0) {
+          caller_ = m;
+          dex_pc_ = dex_pc;
+          receiver_class_ = reinterpret_cast<mirror::Object*>(value)->GetClass();
+        }
+        break;
+      }
+      default:
+        break;
+    }
+    return false;
+  }
+
+  mirror::ArtMethod* GetCaller() const { return caller_; }
+  uint32_t GetCallerDexPc() const { return dex_pc_; }
+  mirror::Class* GetReceiverClass() const { return receiver_class_; }
+
+ private:
+  mirror::ArtMethod* callee_;
+  mirror::ArtMethod* caller_;
+  uint32_t dex_pc_;
+  mirror::Class* receiver_class_;
+};
+
 // This is called from either a thread list traversal or from a checkpoint.  Regardless
 // of which caller, the mutator lock must be held.
 static void GetSample(Thread* thread, void* arg) SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
@@ -116,6 +179,15 @@ static void GetSample(Thread* thread, void* arg) SHARED_LOCKS_REQUIRED(Locks::mu
     default:
       LOG(INFO) << "This profile type is not implemented.";
   }
+  if (profile_options.GetProfileReceivers()) {
+    std::unique_ptr<Context> context(Context::Create());
+    ReceiverVisitor receiver_visitor(thread, context.get());
+    receiver_visitor.WalkStack();
+    if (receiver_visitor.GetCaller() != nullptr) {
+      profiler->RecordReceiver(receiver_visitor.GetCaller(), receiver_visitor.GetCallerDexPc(),
+                               receiver_visitor.GetReceiverClass());
+    }
+  }
 }
 
 // A closure that is called by the thread checkpoint code.
@@ -457,6 +529,15 @@ void BackgroundMethodSamplingProfiler::RecordStack(const std::vector<Instruction
   }
 }
 
+// Record the class of the receiver of the invoke at dex_pc of a caller. Call sites in the boot
+// path are not recorded, as the boot methods are already compiled.
+void BackgroundMethodSamplingProfiler::RecordReceiver(mirror::ArtMethod* caller, uint32_t dex_pc,
+                                                      mirror::Class* receiver_class) {
+  if (caller->GetDeclaringClass()->GetClassLoader() != nullptr) {
+    profile_table_.PutReceiver(caller, dex_pc, receiver_class);
+  }
+}
+
 // Clean out any recordings for the method traces.
 void BackgroundMethodSamplingProfiler::CleanProfile() {
   profile_table_.Clear();
@@ -564,6 +645,13 @@ void ProfileSampleResults::PutStack(const std::vector<InstructionLocation>& stac
   num_samples_++;
 }
 
+// Add a receiver class of a call site to the profile table.
+void ProfileSampleResults::PutReceiver(mirror::ArtMethod* caller, uint32_t dex_pc,
+                                       mirror::Class* receiver_class) {
+  MutexLock mu(Thread::Current(), lock_);
+  ++receivers_[std::make_pair(caller, dex_pc)][receiver_class];
+}
+
 // Write the profile table to the output stream.  Also merge with the previous profile.
 uint32_t ProfileSampleResults::Write(std::ostream& os, ProfileDataType type) {
   ScopedObjectAccess soa(Thread::Current());
@@ -683,9 +771,43 @@ uint32_t ProfileSampleResults::Write(std::ostream& os, ProfileDataType type) {
     }
     ++num_methods;
   }
+
+  // The receiver classes of the call sites follow the methods, in lines of the format
+  // "@method/pc/class_1:count_1#class_2:count_2#...".
+  for (const auto &site_iter : receivers_) {
+    std::pair<std::string, uint32_t> site(PrettyMethod(site_iter.first.first),
+                                          site_iter.first.second);
+    PreviousReceiverCountMap counts;
+    for (const auto &class_iter : site_iter.second) {
+      counts[PrettyDescriptor(class_iter.first)] += class_iter.second;
+    }
+    PreviousReceiverMap::iterator pi = previous_receivers_.find(site);
+    if (pi != previous_receivers_.end()) {
+      for (const auto &class_iter : pi->second) {
+        counts[class_iter.first] += class_iter.second;
+      }
+      previous_receivers_.erase(pi);
+    }
+    WriteReceiverLine(os, site, counts);
+  }
+  for (const auto &pi : previous_receivers_) {
+    WriteReceiverLine(os, pi.first, pi.second);
+  }
   return num_methods;
 }
 
+void ProfileSampleResults::WriteReceiverLine(std::ostream& os,
+                                             const std::pair<std::string, uint32_t>& site,
+                                             const PreviousReceiverCountMap& counts) {
+  std::vector<std::string> class_count_vector;
+  for (const auto &class_iter : counts) {
+    class_count_vector.push_back(StringPrintf("%s:%u", class_iter.first.c_str(),
+                                              class_iter.second));
+  }
+  os << StringPrintf("@%s/%u/%s\n", site.first.c_str(), site.second,
+                     Join(class_count_vector, '#').c_str());
+}
+
 void ProfileSampleResults::Clear() {
   num_samples_ = 0;
   num_null_methods_ = 0;
@@ -710,6 +832,8 @@ void ProfileSampleResults::Clear() {
     }
   }
   previous_.clear();
+  receivers_.clear();
+  previous_receivers_.clear();
 }
 
 uint32_t ProfileSampleResults::Hash(mirror::ArtMethod* method) {
@@ -734,6 +858,50 @@ static bool ReadProfileLine(int fd, std::string& line) {
   return true;
 }
 
+// Parse a count or a dex pc of a receiver line, which must be a decimal number that makes up
+// the whole string.
+static bool ParseReceiverNumber(const std::string& s, uint32_t* value) {
+  // strtoul() would accept leading white space and a sign.
+  if (s.empty() || !isdigit(s[0])) {
+    return false;
+  }
+  char* end;
+  errno = 0;
+  unsigned long result = strtoul(s.c_str(), &end, 10);  // NOLINT(runtime/int)
+  if (*end != '\0' || errno == ERANGE || result > std::numeric_limits<uint32_t>::max()) {
+    return false;
+  }
+  *value = static_cast<uint32_t>(result);
+  return true;
+}
+
+bool ProfileFile::ParseReceiverLine(const std::string& line, std::string* method_name,
+                                    uint32_t* dex_pc,
+                                    std::vector<std::pair<std::string, uint32_t>>* class_counts) {
+  class_counts->clear();
+  if (line.empty() || line[0] != '@') {
+    return false;
+  }
+  std::vector<std::string> info;
+  Split(line.substr(1), '/', info);
+  if (info.size() != 3 || !ParseReceiverNumber(info[1], dex_pc)) {
+    return false;
+  }
+  *method_name = info[0];
+  std::vector<std::string> class_count_pairs;
+  Split(info[2], '#', class_count_pairs);
+  for (const std::string& pair : class_count_pairs) {
+    size_t colon = pair.rfind(':');
+    uint32_t count;
+    if (colon == std::string::npos || colon == 0u ||
+        !ParseReceiverNumber(pair.substr(colon + 1), &count)) {
+      return false;
+    }
+    class_counts->push_back(std::make_pair(pair.substr(0, colon), count));
+  }
+  return !class_counts->empty();
+}
+
 void ProfileSampleResults::ReadPrevious(int fd, ProfileDataType type) {
   // Reset counters.
   previous_num_samples_ = previous_num_null_methods_ = previous_num_boot_methods_ = 0;
@@ -759,6 +927,21 @@ void ProfileSampleResults::ReadPrevious(int fd, ProfileDataType type) {
     if (!ReadProfileLine(fd, line)) {
       break;
     }
+    if (!line.empty() && line[0] == '@') {
+      std::string method_name;
+      uint32_t dex_pc;
+      std::vector<std::pair<std::string, uint32_t>> class_counts;
+      if (!ProfileFile::ParseReceiverLine(line, &method_name, &dex_pc, &class_counts)) {
+        // Malformed.
+        break;
+      }
+      PreviousReceiverCountMap& counts =
+          previous_receivers_[std::make_pair(method_name, dex_pc)];
+      for (const auto &class_count : class_counts) {
+        counts[class_count.first] += class_count.second;
+      }
+      continue;
+    }
     std::vector<std::string> info;
     Split(line, '/', info);
     if (info.size() != 3 && info.size() != 4) {
@@ -839,6 +1022,21 @@ bool ProfileFile::LoadFile(const std::string& fileName) {
     if (in.eof()) {
       break;
     }
+    if (!line.empty() && line[0] == '@') {
+      std::string method_name;
+      uint32_t dex_pc;
+      std::vector<std::pair<std::string, uint32_t>> class_counts;
+      if (!ParseReceiverLine(line, &method_name, &dex_pc, &class_counts)) {
+        // Malformed.
+        return false;
+      }
+      ReceiverCounts& counts = receiver_map_[std::make_pair(method_name, dex_pc)];
+      for (const auto &class_count : class_counts) {
+        counts.push_back(std::make_pair(DotToDescriptor(class_count.first.c_str()),
+                                        class_count.second));
+      }
+      continue;
+    }
     std::vector<std::string> info;
     Split(line, '/', info);
     if (info.size() != 3 && info.size() != 4) {
@@ -869,11 +1067,28 @@ bool ProfileFile::LoadFile(const std::string& fileName) {
     profile_map_[methodname] = curData;
     prevData = &curData;
   }
+
+  // Order the receiver classes of each call site by decreasing counts.
+  for (auto &site_iter : receiver_map_) {
+    std::sort(site_iter.second.begin(), site_iter.second.end(), CompareReceiverCounts);
+  }
   return true;
 }
 
-bool ProfileFile::GetProfileData(ProfileFile::ProfileData* data, const std::string& method_name) {
-  ProfileMap::iterator i = profile_map_.find(method_name);
+bool ProfileFile::CompareReceiverCounts(const std::pair<std::string, uint32_t>& lhs,
+                                        const std::pair<std::string, uint32_t>& rhs) {
+  return (lhs.second != rhs.second) ? lhs.second > rhs.second : lhs.first < rhs.first;
+}
+
+const ProfileFile::ReceiverCounts* ProfileFile::GetReceiverCounts(const std::string& method_name,
+                                                                  uint32_t dex_pc) const {
+  ReceiverMap::const_iterator i = receiver_map_.find(std::make_pair(method_name, dex_pc));
+  return (i == receiver_map_.end()) ? nullptr : &i->second;
+}
+
+bool ProfileFile::GetProfileData(ProfileFile::ProfileData* data,
+                                 const std::string& method_name) const {
+  ProfileMap::const_iterator i = profile_map_.find(method_name);
   if (i == profile_map_.end()) {
     return false;
   }
@@ -106,6 +106,7 @@ class ProfileSampleResults {
 
   void Put(mirror::ArtMethod* method);
   void PutStack(const std::vector<InstructionLocation>& stack_dump);
+  void PutReceiver(mirror::ArtMethod* caller, uint32_t dex_pc, mirror::Class* receiver_class);
   uint32_t Write(std::ostream &os, ProfileDataType type);
   void ReadPrevious(int fd, ProfileDataType type);
   void Clear();
@@ -114,6 +115,10 @@ class ProfileSampleResults {
   void BootMethod() { ++num_boot_methods_; }
 
  private:
+  typedef std::map<std::string, uint32_t> PreviousReceiverCountMap;
+  static void WriteReceiverLine(std::ostream& os, const std::pair<std::string, uint32_t>& site,
+                                const PreviousReceiverCountMap& counts);
+
   uint32_t Hash(mirror::ArtMethod* method);
   static constexpr int kHashSize = 17;
   Mutex& lock_;                  // Reference to the main profiler lock - we don't need two of them.
@@ -141,8 +146,16 @@ class ProfileSampleResults {
     PreviousContextMap* context_map_;
   };
 
+  // Map of call site, the caller and the dex pc of an invoke, vs the counts of the classes of
+  // the receivers sampled there.
+  typedef std::map<InstructionLocation, std::map<mirror::Class*, uint32_t>> ReceiverMap;
+  ReceiverMap receivers_;
+
   typedef std::map<std::string, PreviousValue> PreviousProfile;
   PreviousProfile previous_;
+  // Map from <method name, pc> of the call sites to the counts of the receiver class names.
+  typedef std::map<std::pair<std::string, uint32_t>, PreviousReceiverCountMap> PreviousReceiverMap;
+  PreviousReceiverMap previous_receivers_;
   uint32_t previous_num_samples_;
   uint32_t previous_num_null_methods_;     // Number of samples where can don't know the method.
   uint32_t previous_num_boot_methods_;     // Number of samples in the boot path.
@@ -178,6 +191,8 @@ class BackgroundMethodSamplingProfiler {
 
   void RecordMethod(mirror::ArtMethod *method) SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
   void RecordStack(const std::vector<InstructionLocation>& stack) SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+  void RecordReceiver(mirror::ArtMethod* caller, uint32_t dex_pc, mirror::Class* receiver_class)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
   bool ProcessMethod(mirror::ArtMethod* method) SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
   const ProfilerOptions& GetProfilerOptions() const { return options_; }
 
@@ -271,12 +286,33 @@ class ProfileFile {
 
   // If the given method has an entry in the profile table it updates the data
   // and returns true. Otherwise returns false and leaves the data unchanged.
-  bool GetProfileData(ProfileData* data, const std::string& method_name);
+  bool GetProfileData(ProfileData* data, const std::string& method_name) const;
+
+  // The classes of the receivers sampled at a call site, as descriptors with their number of
+  // samples, in decreasing order of the number of samples.
+  typedef std::vector<std::pair<std::string, uint32_t>> ReceiverCounts;
+
+  // Returns the receiver classes sampled at the invoke at dex_pc of the given method, or
+  // nullptr if the profile has none.
+  const ReceiverCounts* GetReceiverCounts(const std::string& method_name, uint32_t dex_pc) const;
+
+  // Parses a line with the receiver classes of a call site, of the format
+  // "@method/pc/class_1:count_1#class_2:count_2#...", where the classes are pretty descriptors.
+  // Returns false if the line is malformed.
+  static bool ParseReceiverLine(const std::string& line, std::string* method_name,
+                                uint32_t* dex_pc,
+                                std::vector<std::pair<std::string, uint32_t>>* class_counts);
 
  private:
+  static bool CompareReceiverCounts(const std::pair<std::string, uint32_t>& lhs,
+                                    const std::pair<std::string, uint32_t>& rhs);
+
   // Profile data is stored in a map, indexed by the full method name.
   typedef std::map<std::string, ProfileData> ProfileMap;
   ProfileMap profile_map_;
+  // Receiver classes are indexed by the full method name and the dex pc of the call site.
+  typedef std::map<std::pair<std::string, uint32_t>, ReceiverCounts> ReceiverMap;
+  ReceiverMap receiver_map_;
 };
 
 }  // namespace art
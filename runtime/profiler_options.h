@@ -39,6 +39,7 @@ class ProfilerOptions {
   static constexpr double kDefaultChangeInTopKThreshold = 10.0;
   static constexpr ProfileDataType kDefaultProfileData = kProfilerMethod;
   static constexpr uint32_t kDefaultMaxStackDepth = 3;
+  static constexpr bool kDefaultProfileReceivers = false;
 
   ProfilerOptions() :
     enabled_(kDefaultEnabled),
@@ -50,7 +51,8 @@ class ProfilerOptions {
     top_k_threshold_(kDefaultTopKThreshold),
     top_k_change_threshold_(kDefaultChangeInTopKThreshold),
     profile_type_(kDefaultProfileData),
-    max_stack_depth_(kDefaultMaxStackDepth) {}
+    max_stack_depth_(kDefaultMaxStackDepth),
+    profile_receivers_(kDefaultProfileReceivers) {}
 
   ProfilerOptions(bool enabled,
                  uint32_t period_s,
@@ -61,7 +63,8 @@ class ProfilerOptions {
                  double top_k_threshold,
                  double top_k_change_threshold,
                  ProfileDataType profile_type,
-                 uint32_t max_stack_depth):
+                 uint32_t max_stack_depth,
+                 bool profile_receivers):
     enabled_(enabled),
     period_s_(period_s),
     duration_s_(duration_s),
@@ -71,7 +74,8 @@ class ProfilerOptions {
     top_k_threshold_(top_k_threshold),
     top_k_change_threshold_(top_k_change_threshold),
     profile_type_(profile_type),
-    max_stack_depth_(max_stack_depth) {}
+    max_stack_depth_(max_stack_depth),
+    profile_receivers_(profile_receivers) {}
 
   bool IsEnabled() const {
     return enabled_;
@@ -113,6 +117,10 @@ class ProfilerOptions {
     return max_stack_depth_;
   }
 
+  bool GetProfileReceivers() const {
+    return profile_receivers_;
+  }
+
  private:
   friend std::ostream & operator<<(std::ostream &os, const ProfilerOptions& po) {
     os << "enabled=" << po.enabled_
@@ -124,7 +132,8 @@ class ProfilerOptions {
        << ", top_k_threshold=" << po.top_k_threshold_
        << ", top_k_change_threshold=" << po.top_k_change_threshold_
        << ", profile_type=" << po.profile_type_
-       << ", max_stack_depth=" << po.max_stack_depth_;
+       << ", max_stack_depth=" << po.max_stack_depth_
+       << ", profile_receivers=" << po.profile_receivers_;
     return os;
   }
 
@@ -150,6 +159,8 @@ class ProfilerOptions {
   ProfileDataType profile_type_;
   // The max depth of the stack collected by the profiler
   uint32_t max_stack_depth_;
+  // Whether the receiver classes of the sampled methods are recorded for their call sites.
+  bool profile_receivers_;
 };
 
 }  // namespace art
@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "profiler.h"
+
+#include "base/unix_file/fd_file.h"
+#include "common_runtime_test.h"
+#include "os.h"
+
+namespace art {
+
+class ProfilerTest : public CommonRuntimeTest {
+ protected:
+  // Writes the contents to a profile file and loads it.
+  bool LoadProfile(const std::string& contents, ProfileFile* profile_file) {
+    ScratchFile file;
+    if (!file.GetFile()->WriteFully(contents.data(), contents.size())) {
+      return false;
+    }
+    return profile_file->LoadFile(file.GetFilename());
+  }
+};
+
+TEST_F(ProfilerTest, ParseReceiverLine) {
+  std::string method_name;
+  uint32_t dex_pc;
+  std::vector<std::pair<std::string, uint32_t>> class_counts;
+
+  ASSERT_TRUE(ProfileFile::ParseReceiverLine("@int Main.area(Main$Shape)/3/Main$Square:17",
+                                             &method_name, &dex_pc, &class_counts));
+  EXPECT_EQ("int Main.area(Main$Shape)", method_name);
+  EXPECT_EQ(3u, dex_pc);
+  ASSERT_EQ(1u, class_counts.size());
+  EXPECT_EQ("Main$Square", class_counts[0].first);
+  EXPECT_EQ(17u, class_counts[0].second);
+
+  // A polymorphic site keeps the classes in the order of the line.
+  ASSERT_TRUE(ProfileFile::ParseReceiverLine(
+      "@int Main.next(Main$Counter, int)/12/Main$Incrementer:5#Main$Doubler:40#Main$Halver:1",
+      &method_name, &dex_pc, &class_counts));
+  EXPECT_EQ("int Main.next(Main$Counter, int)", method_name);
+  EXPECT_EQ(12u, dex_pc);
+  ASSERT_EQ(3u, class_counts.size());
+  EXPECT_EQ("Main$Incrementer", class_counts[0].first);
+  EXPECT_EQ(5u, class_counts[0].second);
+  EXPECT_EQ("Main$Doubler", class_counts[1].first);
+  EXPECT_EQ(40u, class_counts[1].second);
+  EXPECT_EQ("Main$Halver", class_counts[2].first);
+  EXPECT_EQ(1u, class_counts[2].second);
+}
+
+TEST_F(ProfilerTest, ParseMalformedReceiverLine) {
+  static const char* const kMalformedLines[] = {
+      "",
+      "@",
+      "int Main.area(Main$Shape)/3/Main$Square:17",    // Not a receiver line.
+      "@int Main.area(Main$Shape)/3",                  // No classes.
+      "@int Main.area(Main$Shape)/3/",
+      "@int Main.area(Main$Shape)/3/Main$Square:17/1",
+      "@int Main.area(Main$Shape)/pc/Main$Square:17",  // Bad dex pc.
+      "@int Main.area(Main$Shape)/-3/Main$Square:17",
+      "@int Main.area(Main$Shape)/3x/Main$Square:17",
+      "@int Main.area(Main$Shape)/3/Main$Square",      // Bad counts.
+      "@int Main.area(Main$Shape)/3/Main$Square:",
+      "@int Main.area(Main$Shape)/3/Main$Square: 17",
+      "@int Main.area(Main$Shape)/3/Main$Square:+17",
+      "@int Main.area(Main$Shape)/3/Main$Square:17x",
+      "@int Main.area(Main$Shape)/3/Main$Square:4294967296",
+      "@int Main.area(Main$Shape)/3/:17",              // No class.
+      "@int Main.area(Main$Shape)/3/Main$Square:17#Main$Circle",
+  };
+  for (const char* line : kMalformedLines) {
+    std::string method_name;
+    uint32_t dex_pc;
+    std::vector<std::pair<std::string, uint32_t>> class_counts;
+    EXPECT_FALSE(ProfileFile::ParseReceiverLine(line, &method_name, &dex_pc, &class_counts))
+        << line;
+  }
+}
+
+TEST_F(ProfilerTest, GetReceiverCounts) {
+  ProfileFile profile_file;
+  ASSERT_TRUE(LoadProfile(
+      "100/0/0\n"
+      "int Main.area(Main$Shape)/60/12\n"
+      "int Main.next(Main$Counter, int)/40/10\n"
+      "@int Main.area(Main$Shape)/3/Main$Rectangle:20#Main$Square:30#Main$Circle:20\n"
+      "@int Main.area(Main$Shape)/9/Main$Square:2\n"
+      "@int Main.next(Main$Counter, int)/4/Main$Incrementer:7\n",
+      &profile_file));
+
+  // The classes are descriptors, in decreasing order of their counts and then by name.
+  const ProfileFile::ReceiverCounts* counts =
+      profile_file.GetReceiverCounts("int Main.area(Main$Shape)", 3u);
+  ASSERT_TRUE(counts != nullptr);
+  ASSERT_EQ(3u, counts->size());
+  EXPECT_EQ("LMain$Square;", (*counts)[0].first);
+  EXPECT_EQ(30u, (*counts)[0].second);
+  EXPECT_EQ("LMain$Circle;", (*counts)[1].first);
+  EXPECT_EQ(20u, (*counts)[1].second);
+  EXPECT_EQ("LMain$Rectangle;", (*counts)[2].first);
+  EXPECT_EQ(20u, (*counts)[2].second);
+
+  counts = profile_file.GetReceiverCounts("int Main.area(Main$Shape)", 9u);
+  ASSERT_TRUE(counts != nullptr);
+  ASSERT_EQ(1u, counts->size());
+  EXPECT_EQ("LMain$Square;", (*counts)[0].first);
+  EXPECT_EQ(2u, (*counts)[0].second);
+
+  counts = profile_file.GetReceiverCounts("int Main.next(Main$Counter, int)", 4u);
+  ASSERT_TRUE(counts != nullptr);
+  ASSERT_EQ(1u, counts->size());
+  EXPECT_EQ("LMain$Incrementer;", (*counts)[0].first);
+
+  EXPECT_TRUE(profile_file.GetReceiverCounts("int Main.area(Main$Shape)", 4u) == nullptr);
+  EXPECT_TRUE(profile_file.GetReceiverCounts("int Main.size(Main$Shape)", 3u) == nullptr);
+
+  // The methods are still read around the receiver lines.
+  ProfileFile::ProfileData data;
+  ASSERT_TRUE(profile_file.GetProfileData(&data, "int Main.area(Main$Shape)"));
+  EXPECT_EQ(60u, data.GetCount());
+  ASSERT_TRUE(profile_file.GetProfileData(&data, "int Main.next(Main$Counter, int)"));
+  EXPECT_EQ(40u, data.GetCount());
+}
+
+TEST_F(ProfilerTest, LoadMalformedReceiverLine) {
+  ProfileFile profile_file;
+  EXPECT_FALSE(LoadProfile(
+      "100/0/0\n"
+      "int Main.area(Main$Shape)/100/12\n"
+      "@int Main.area(Main$Shape)/3/Main$Square\n",
+      &profile_file));
+}
+
+}  // namespace art
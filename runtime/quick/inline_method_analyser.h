@@ -82,6 +82,10 @@ enum InlineMethodOpcode : uint16_t {
   kIntrinsicUnsafeGet,
   kIntrinsicUnsafePut,
   kIntrinsicSystemArrayCopyCharArray,
+  kIntrinsicStringEquals,
+  kIntrinsicStringHashCode,
+  kIntrinsicArraysEquals,
+  kIntrinsicArraysFill,
 
   kInlineOpNop,
   kInlineOpReturnArg,
@@ -29,11 +29,15 @@ inline MirrorType* ReadBarrier::Barrier(
   // Unused for now.
   UNUSED(obj);
   UNUSED(offset);
-  UNUSED(ref_addr);
   const bool with_read_barrier = kReadBarrierOption == kWithReadBarrier;
   if (with_read_barrier && kUseBakerReadBarrier) {
-    // To be implemented.
-    return ref_addr->AsMirrorPtr();
+    // Baker's barrier: while the collector is marking, the objects that are not yet in the
+    // to-space are copied as they are read, so that the mutators only see to-space references.
+    MirrorType* ref = ref_addr->AsMirrorPtr();
+    if (UNLIKELY(IsMarking()) && ref != nullptr) {
+      ref = reinterpret_cast<MirrorType*>(Mark(ref));
+    }
+    return ref;
   } else if (with_read_barrier && kUseBrooksReadBarrier) {
     // To be implemented.
     return ref_addr->AsMirrorPtr();
@@ -48,7 +52,9 @@ inline MirrorType* ReadBarrier::BarrierForRoot(MirrorType** root) {
   MirrorType* ref = *root;
   const bool with_read_barrier = kReadBarrierOption == kWithReadBarrier;
   if (with_read_barrier && kUseBakerReadBarrier) {
-    // To be implemented.
+    if (UNLIKELY(IsMarking()) && ref != nullptr) {
+      ref = reinterpret_cast<MirrorType*>(Mark(ref));
+    }
     return ref;
   } else if (with_read_barrier && kUseBrooksReadBarrier) {
     // To be implemented.
@@ -17,6 +17,7 @@
 #ifndef ART_RUNTIME_READ_BARRIER_H_
 #define ART_RUNTIME_READ_BARRIER_H_
 
+#include "atomic.h"
 #include "base/mutex.h"
 #include "base/macros.h"
 #include "offsets.h"
@@ -45,6 +46,23 @@ class ReadBarrier {
   template <typename MirrorType, ReadBarrierOption kReadBarrierOption = kWithReadBarrier>
   ALWAYS_INLINE static MirrorType* BarrierForRoot(MirrorType** root)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  // Whether the concurrent copying collector is marking, in which case the barriers return the
+  // to-space references of the references they read.
+  ALWAYS_INLINE static bool IsMarking() {
+    return is_marking_.LoadRelaxed();
+  }
+
+  static void SetMarking(bool is_marking) {
+    is_marking_.StoreSequentiallyConsistent(is_marking);
+  }
+
+  // The slow path of the barriers: returns the to-space reference of ref, copying the object
+  // if it is not yet.
+  static mirror::Object* Mark(mirror::Object* ref) SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+ private:
+  static Atomic<bool> is_marking_;
 };
 
 }  // namespace art
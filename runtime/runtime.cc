@@ -717,7 +717,9 @@ bool Runtime::Init(const RuntimeOptions& raw_options, bool ignore_unrecognized)
   verify_ = options->verify_;
   continue_without_dex_ = options->continue_without_dex_;
 
-  if (options->interpreter_only_) {
+  // The compiled code has no read barrier, which the concurrent copying collector needs.
+  // The option parsing only accepts it as both the foreground and the background collector.
+  if (options->interpreter_only_ || options->collector_type_ == gc::kCollectorTypeCC) {
     GetInstrumentation()->ForceInterpretOnly();
   }
 
@@ -735,11 +737,14 @@ bool Runtime::Init(const RuntimeOptions& raw_options, bool ignore_unrecognized)
                        options->background_collector_type_,
                        options->parallel_gc_threads_,
                        options->conc_gc_threads_,
+                       options->sweep_gc_threads_,
                        options->low_memory_mode_,
                        options->long_pause_log_threshold_,
                        options->long_gc_log_threshold_,
                        options->ignore_max_footprint_,
                        options->use_tlab_,
+                       options->promotion_age_,
+                       options->rosalloc_thread_local_size_brackets_,
                        options->verify_pre_gc_heap_,
                        options->verify_pre_sweeping_heap_,
                        options->verify_post_gc_heap_,
@@ -23,6 +23,7 @@
 
 #include "base/casts.h"
 #include "base/mutex-inl.h"
+#include "closure.h"
 #include "gc/heap.h"
 #include "jni_internal.h"
 
@@ -149,6 +150,14 @@ inline ThreadState Thread::TransitionFromSuspendedToRunnable() {
       // Failed to transition to Runnable. Release shared mutator_lock_ access and try again.
       Locks::mutator_lock_->SharedUnlock(this);
     } else {
+      // Run the flip function the concurrent copying collector installed while the thread was
+      // suspended, so that the thread flips its roots before it uses them.
+      if (UNLIKELY(tlsPtr_.flip_function != nullptr)) {
+        Closure* flip_function = GetFlipFunction();
+        if (flip_function != nullptr) {
+          flip_function->Run(this);
+        }
+      }
       return static_cast<ThreadState>(old_state);
     }
   } while (true);
@@ -95,6 +95,21 @@ enum ThreadFlag {
 
 static constexpr size_t kNumRosAllocThreadLocalSizeBrackets = 34;
 
+// Statistics of the thread-local allocation buffers (TLABs) of a thread, which also drive the
+// size of its next TLAB. Only the thread itself updates them, or the GC while it is suspended.
+struct TlabStats {
+  TlabStats() : refill_size(0), bytes_since_gc(0), refills(0), waste_bytes(0) {}
+
+  // The size of the next TLAB, not including the allocation which needs it.
+  size_t refill_size;
+  // The size of the TLABs allocated since the GC last revoked the TLAB of the thread.
+  size_t bytes_since_gc;
+  // The number of TLABs allocated.
+  uint64_t refills;
+  // The bytes left unused at the end of the retired TLABs.
+  uint64_t waste_bytes;
+};
+
 // Thread's stack layout for implicit stack overflow checks:
 //
 //   +---------------------+  <- highest address of stack memory
@@ -207,6 +222,12 @@ class Thread {
   bool RequestCheckpoint(Closure* function)
       EXCLUSIVE_LOCKS_REQUIRED(Locks::thread_suspend_count_lock_);
 
+  // Set the function the thread runs to flip its roots when it next becomes runnable, see
+  // ThreadList::FlipThreadRoots.
+  void SetFlipFunction(Closure* function);
+  // Atomically take the flip function of the thread, returns null if it has none.
+  Closure* GetFlipFunction();
+
   // Called when thread detected that the thread_suspend_count_ was non-zero. Gives up share of
   // mutator_lock_ and waits until it is resumed and thread_suspend_count_ is zero.
   void FullSuspendCheck()
@@ -308,6 +329,10 @@ class Thread {
     return &tls64_.stats;
   }
 
+  TlabStats* GetTlabStats() {
+    return &tlab_stats_;
+  }
+
   bool IsStillStarting() const;
 
   bool IsExceptionPending() const {
@@ -1029,7 +1054,8 @@ class Thread {
       deoptimization_shadow_frame(nullptr), shadow_frame_under_construction(nullptr), name(nullptr),
       pthread_self(0), last_no_thread_suspension_cause(nullptr), thread_local_start(nullptr),
       thread_local_pos(nullptr), thread_local_end(nullptr), thread_local_objects(0),
-      thread_local_alloc_stack_top(nullptr), thread_local_alloc_stack_end(nullptr) {
+      thread_local_alloc_stack_top(nullptr), thread_local_alloc_stack_end(nullptr),
+      flip_function(nullptr) {
     }
 
     // The biased card table, see CardTable for details.
@@ -1132,7 +1158,8 @@ class Thread {
     byte* thread_local_end;
     size_t thread_local_objects;
 
-    // There are RosAlloc::kNumThreadLocalSizeBrackets thread-local size brackets per thread.
+    // The RosAlloc thread-local runs, one per size bracket. Only the first
+    // RosAlloc::GetNumThreadLocalSizeBrackets() of them are used.
     void* rosalloc_runs[kNumRosAllocThreadLocalSizeBrackets];
 
     // Thread-local allocation stack data/routines.
@@ -1144,6 +1171,9 @@ class Thread {
 
     // Recorded thread state for nested signals.
     jmp_buf* nested_signal_state;
+
+    // The function used for the thread flip of the concurrent copying collector.
+    Closure* flip_function;
   } tlsPtr_;
 
   // Guards the 'interrupted_' and 'wait_monitor_' members.
@@ -1157,6 +1187,9 @@ class Thread {
   // Thread "interrupted" status; stays raised until queried or thrown.
   bool interrupted_ GUARDED_BY(wait_mutex_);
 
+  // The statistics and size of the TLABs of the thread.
+  TlabStats tlab_stats_;
+
   friend class Dbg;  // For SetStateUnsafe.
   friend class gc::collector::SemiSpace;  // For getting stack traces.
   friend class Runtime;  // For CreatePeer.
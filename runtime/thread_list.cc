@@ -24,11 +24,13 @@
 #include <ScopedUtfChars.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <vector>
 
 #include "base/mutex.h"
 #include "base/mutex-inl.h"
 #include "base/timing_logger.h"
 #include "debugger.h"
+#include "gc/collector/garbage_collector.h"
 #include "jni_internal.h"
 #include "lock_word.h"
 #include "monitor.h"
@@ -363,6 +365,72 @@ void ThreadList::SuspendAll() {
   }
 }
 
+size_t ThreadList::FlipThreadRoots(Closure* thread_flip_visitor, Closure* flip_callback,
+                                   gc::collector::GarbageCollector* collector) {
+  TimingLogger::ScopedTiming split("ThreadListFlip", collector->GetTimings());
+  Thread* self = Thread::Current();
+  Locks::mutator_lock_->AssertNotHeld(self);
+  Locks::thread_list_lock_->AssertNotHeld(self);
+  Locks::thread_suspend_count_lock_->AssertNotHeld(self);
+  CHECK_NE(self->GetState(), kRunnable);
+
+  const uint64_t suspend_start_time = NanoTime();
+  SuspendAll();
+
+  // Run the flip callback, then install the flip function of the other threads. No roots are
+  // visited while the threads are suspended.
+  flip_callback->Run(self);
+
+  // Resume the threads that were suspended at a suspend check, they run their flip function as
+  // they become runnable. Keep the others suspended until their flip function has run, since
+  // they may become runnable without passing through a suspend check.
+  std::vector<Thread*> flipping_threads;
+  std::vector<Thread*> other_threads;
+  Locks::mutator_lock_->ExclusiveUnlock(self);
+  {
+    MutexLock mu(self, *Locks::thread_list_lock_);
+    MutexLock mu2(self, *Locks::thread_suspend_count_lock_);
+    --suspend_all_count_;
+    for (const auto& thread : list_) {
+      if (thread == self) {
+        continue;
+      }
+      thread->SetFlipFunction(thread_flip_visitor);
+      if (thread->GetState() == kSuspended && thread->GetSuspendCount() == 1) {
+        thread->ModifySuspendCount(self, -1, false);
+        flipping_threads.push_back(thread);
+      } else {
+        other_threads.push_back(thread);
+      }
+    }
+    Thread::resume_cond_->Broadcast(self);
+  }
+  collector->RegisterPause(NanoTime() - suspend_start_time);
+  ATRACE_END();
+
+  // Run the flip function of the other threads on their behalf, and the one of this thread.
+  {
+    ReaderMutexLock mu(self, *Locks::mutator_lock_);
+    for (Thread* thread : other_threads) {
+      Closure* flip_function = thread->GetFlipFunction();
+      if (flip_function != nullptr) {
+        flip_function->Run(thread);
+      }
+    }
+    thread_flip_visitor->Run(self);
+  }
+
+  // Resume the other threads.
+  {
+    MutexLock mu(self, *Locks::thread_suspend_count_lock_);
+    for (Thread* thread : other_threads) {
+      thread->ModifySuspendCount(self, -1, false);
+    }
+    Thread::resume_cond_->Broadcast(self);
+  }
+  return flipping_threads.size() + other_threads.size() + 1;
+}
+
 void ThreadList::ResumeAll() {
   Thread* self = Thread::Current();
 
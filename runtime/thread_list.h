@@ -26,6 +26,11 @@
 #include <list>
 
 namespace art {
+namespace gc {
+namespace collector {
+  class GarbageCollector;
+}  // namespace collector
+}  // namespace gc
 class Closure;
 class Thread;
 class TimingLogger;
@@ -94,6 +99,17 @@ class ThreadList {
   size_t RunCheckpointOnRunnableThreads(Closure* checkpoint_function)
       LOCKS_EXCLUDED(Locks::thread_list_lock_, Locks::thread_suspend_count_lock_);
 
+  // Suspend all threads, run flip_callback and install thread_flip_visitor as the flip function
+  // of the other threads, then resume them. The threads suspended at a suspend check run their
+  // flip function when they become runnable, the calling thread runs it for the others and for
+  // itself before resuming them. The pause is independent of the size of the roots. Returns how
+  // many flip functions run, the caller waits for them with the barrier they pass.
+  size_t FlipThreadRoots(Closure* thread_flip_visitor, Closure* flip_callback,
+                         gc::collector::GarbageCollector* collector)
+      LOCKS_EXCLUDED(Locks::mutator_lock_,
+                     Locks::thread_list_lock_,
+                     Locks::thread_suspend_count_lock_);
+
   // Suspends all threads
   void SuspendAllForDebugger()
       LOCKS_EXCLUDED(Locks::mutator_lock_,
@@ -0,0 +1,272 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Tests loops that the compiler may vectorize. The reference results are computed by loops
+// counting down, which are never vectorized.
+
+public class Main {
+  static final int kBenchmarkLength = 4096;
+  static final int kBenchmarkIterations = 2000;
+
+  public static void main(String[] args) {
+    boolean timing = (args.length >= 1) && args[0].equals("--timing");
+
+    for (int length = 0; length <= 40; length++) {
+      testSum(length);
+      testSaxpy(length);
+      testFloatSaxpy(length);
+      testByteXor(length);
+      testCharShift(length);
+      testShortMulSub(length);
+      testLiveAfterLoop(length);
+    }
+    testBounds();
+    testExceptions();
+    System.out.println("Results are correct.");
+
+    benchmark(timing);
+  }
+
+  static int sum(int[] a) {
+    int sum = 0;
+    for (int i = 0; i < a.length; i++) {
+      sum += a[i];
+    }
+    return sum;
+  }
+
+  static void saxpy(int alpha, int[] x, int[] y) {
+    for (int i = 0; i < y.length; i++) {
+      y[i] = alpha * x[i] + y[i];
+    }
+  }
+
+  static void floatSaxpy(float alpha, float[] x, float[] y) {
+    for (int i = 0; i < y.length; i++) {
+      y[i] += alpha * x[i];
+    }
+  }
+
+  static void byteXor(byte[] a, byte[] b, byte[] c) {
+    for (int i = 0; i < c.length; i++) {
+      c[i] = (byte) (a[i] ^ b[i]);
+    }
+  }
+
+  static void charShift(char[] a, char[] b) {
+    for (int i = 0; i < b.length; i++) {
+      b[i] = (char) ((a[i] << 3) | 5);
+    }
+  }
+
+  static void shortMulSub(short[] a, short[] b, int k) {
+    for (int i = 0; i < b.length; i++) {
+      b[i] = (short) (a[i] * 7 - k);
+    }
+  }
+
+  // The temporary is live after the loop, which must not be vectorized as it only keeps the sum
+  // registers of reductions up to date.
+  static int storeDoubled(int[] a, int[] b) {
+    int x = -1;
+    for (int i = 0; i < b.length; i++) {
+      x = a[i] * 2;
+      b[i] = x;
+    }
+    return x;
+  }
+
+  // Copies "src[start .. end)" plus one into "dst", the bound does not come from an array.
+  static void copyPlusOne(int[] src, int[] dst, int start, int end) {
+    for (int i = start; i < end; i++) {
+      dst[i] = src[i] + 1;
+    }
+  }
+
+  static int[] intData(int length, int seed) {
+    int[] data = new int[length];
+    for (int i = length - 1; i >= 0; i--) {
+      data[i] = (i * 0x9e3779b1 + seed) ^ (i << 17);
+    }
+    return data;
+  }
+
+  static void testSum(int length) {
+    int[] a = intData(length, 1);
+    int expected = 0;
+    for (int i = length - 1; i >= 0; i--) {
+      expected += a[i];
+    }
+    expectEquals(expected, sum(a), "sum", length);
+  }
+
+  static void testSaxpy(int length) {
+    int[] x = intData(length, 2);
+    int[] y = intData(length, 3);
+    int[] expected = new int[length];
+    for (int i = length - 1; i >= 0; i--) {
+      expected[i] = -3 * x[i] + y[i];
+    }
+    saxpy(-3, x, y);
+    for (int i = length - 1; i >= 0; i--) {
+      expectEquals(expected[i], y[i], "saxpy", length);
+    }
+  }
+
+  static void testFloatSaxpy(int length) {
+    float[] x = new float[length];
+    float[] y = new float[length];
+    float[] expected = new float[length];
+    for (int i = length - 1; i >= 0; i--) {
+      x[i] = i * 0.37f - 2.5f;
+      y[i] = 1.0f / (i + 1);
+      expected[i] = y[i] + 1.75f * x[i];
+    }
+    floatSaxpy(1.75f, x, y);
+    for (int i = length - 1; i >= 0; i--) {
+      expectEquals(Float.floatToRawIntBits(expected[i]), Float.floatToRawIntBits(y[i]),
+                   "floatSaxpy", length);
+    }
+  }
+
+  static void testByteXor(int length) {
+    byte[] a = new byte[length];
+    byte[] b = new byte[length];
+    byte[] c = new byte[length];
+    for (int i = length - 1; i >= 0; i--) {
+      a[i] = (byte) (i * 37);
+      b[i] = (byte) (i * -91 + 13);
+    }
+    byteXor(a, b, c);
+    for (int i = length - 1; i >= 0; i--) {
+      expectEquals((byte) (a[i] ^ b[i]), c[i], "byteXor", length);
+    }
+  }
+
+  static void testCharShift(int length) {
+    char[] a = new char[length];
+    char[] b = new char[length];
+    for (int i = length - 1; i >= 0; i--) {
+      a[i] = (char) (i * 4099 + 0x8000);
+    }
+    charShift(a, b);
+    for (int i = length - 1; i >= 0; i--) {
+      expectEquals((char) ((a[i] << 3) | 5), b[i], "charShift", length);
+    }
+  }
+
+  static void testShortMulSub(int length) {
+    short[] a = new short[length];
+    short[] b = new short[length];
+    for (int i = length - 1; i >= 0; i--) {
+      a[i] = (short) (i * -1237 + 17);
+    }
+    shortMulSub(a, b, 1000);
+    for (int i = length - 1; i >= 0; i--) {
+      expectEquals((short) (a[i] * 7 - 1000), b[i], "shortMulSub", length);
+    }
+  }
+
+  static void testLiveAfterLoop(int length) {
+    int[] a = intData(length, 8);
+    int[] b = new int[length];
+    int expected = (length == 0) ? -1 : a[length - 1] * 2;
+    expectEquals(expected, storeDoubled(a, b), "storeDoubled", length);
+    for (int i = length - 1; i >= 0; i--) {
+      expectEquals(a[i] * 2, b[i], "storeDoubled", length);
+    }
+  }
+
+  static void testBounds() {
+    int[] src = intData(37, 4);
+    for (int start = 0; start <= 9; start++) {
+      for (int end = start; end <= 37; end++) {
+        int[] dst = new int[37];
+        copyPlusOne(src, dst, start, end);
+        for (int i = 36; i >= 0; i--) {
+          int expected = (i >= start && i < end) ? src[i] + 1 : 0;
+          expectEquals(expected, dst[i], "copyPlusOne", end);
+        }
+      }
+    }
+  }
+
+  static void testExceptions() {
+    // The elements before the failing index must have been written.
+    int[] src = intData(37, 5);
+    int[] dst = new int[21];
+    try {
+      copyPlusOne(src, dst, 0, 37);
+      System.out.println("Missing ArrayIndexOutOfBoundsException");
+    } catch (ArrayIndexOutOfBoundsException expected) {
+      for (int i = 20; i >= 0; i--) {
+        expectEquals(src[i] + 1, dst[i], "copyPlusOne throwing", i);
+      }
+    }
+
+    dst = new int[37];
+    try {
+      copyPlusOne(src, dst, -2, 37);
+      System.out.println("Missing ArrayIndexOutOfBoundsException");
+    } catch (ArrayIndexOutOfBoundsException expected) {
+      for (int i = 36; i >= 0; i--) {
+        expectEquals(0, dst[i], "copyPlusOne negative start", i);
+      }
+    }
+
+    try {
+      copyPlusOne(src, null, 0, 37);
+      System.out.println("Missing NullPointerException");
+    } catch (NullPointerException expected) {
+    }
+  }
+
+  static void benchmark(boolean timing) {
+    int[] a = intData(kBenchmarkLength, 6);
+    int[] b = intData(kBenchmarkLength, 7);
+    byte[] c = new byte[kBenchmarkLength];
+    byte[] d = new byte[kBenchmarkLength];
+    byte[] e = new byte[kBenchmarkLength];
+
+    long time0 = System.nanoTime();
+    int total = 0;
+    for (int i = 0; i < kBenchmarkIterations; i++) {
+      total += sum(a);
+    }
+    long time1 = System.nanoTime();
+    for (int i = 0; i < kBenchmarkIterations; i++) {
+      saxpy(3, a, b);
+    }
+    long time2 = System.nanoTime();
+    for (int i = 0; i < kBenchmarkIterations; i++) {
+      byteXor(c, d, e);
+    }
+    long time3 = System.nanoTime();
+
+    if (timing) {
+      System.out.println("sum: " + (time1 - time0) / kBenchmarkIterations + " ns " + total);
+      System.out.println("saxpy: " + (time2 - time1) / kBenchmarkIterations + " ns");
+      System.out.println("byteXor: " + (time3 - time2) / kBenchmarkIterations + " ns");
+    }
+  }
+
+  static void expectEquals(int expected, int actual, String test, int length) {
+    if (expected != actual) {
+      throw new Error(test + " with length " + length + ": expected " + expected + ", got " +
+                      actual);
+    }
+  }
+}
@@ -0,0 +1,311 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+import java.util.Arrays;
+
+// Tests methods that the compiler may replace with intrinsics. The reference results are
+// computed by plain loops, which are never replaced.
+
+public class Main {
+  static final int kBenchmarkLength = 4096;
+  static final int kBenchmarkIterations = 2000;
+
+  public static void main(String[] args) {
+    boolean timing = (args.length >= 1) && args[0].equals("--timing");
+
+    for (int length = 0; length <= 40; length++) {
+      testStringEquals(length);
+      testStringHashCode(length);
+      testArraysEquals(length);
+      testArraysFill(length);
+      testArrayCopy(length);
+    }
+    testStringEqualsSpecialCases();
+    testArrayCopyExceptions();
+    System.out.println("Results are correct.");
+
+    benchmark(timing);
+  }
+
+  static char[] charData(int length, int seed) {
+    char[] data = new char[length];
+    for (int i = length - 1; i >= 0; i--) {
+      data[i] = (char) (i * 4099 + seed * 0x8001);
+    }
+    return data;
+  }
+
+  static byte[] byteData(int length, int seed) {
+    byte[] data = new byte[length];
+    for (int i = length - 1; i >= 0; i--) {
+      data[i] = (byte) (i * 37 + seed * -91);
+    }
+    return data;
+  }
+
+  static int[] intData(int length, int seed) {
+    int[] data = new int[length];
+    for (int i = length - 1; i >= 0; i--) {
+      data[i] = (i * 0x9e3779b1 + seed) ^ (i << 17);
+    }
+    return data;
+  }
+
+  static int referenceHashCode(char[] data, int offset, int count) {
+    int hash = 0;
+    for (int i = offset; i < offset + count; i++) {
+      hash = 31 * hash + data[i];
+    }
+    return hash;
+  }
+
+  static boolean referenceEquals(char[] a, char[] b) {
+    if (a.length != b.length) {
+      return false;
+    }
+    for (int i = a.length - 1; i >= 0; i--) {
+      if (a[i] != b[i]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  static void testStringEquals(int length) {
+    char[] data = charData(length, 1);
+    String s = new String(data);
+    String t = new String(data);
+    expectEquals(true, s.equals(t), "equals", length);
+    expectEquals(true, t.equals(s), "equals", length);
+    expectEquals(length == 0, s.equals(new String(charData(length + 1, 1), 0, 0)),
+                 "equals empty", length);
+    for (int i = length - 1; i >= 0; i--) {
+      char[] other = charData(length, 1);
+      other[i] ^= 0x100;
+      expectEquals(false, s.equals(new String(other)), "equals mismatch", i);
+      other[i] ^= 0x101;
+      expectEquals(false, s.equals(new String(other)), "equals mismatch", i);
+    }
+    // Substrings share the char array of the original string at an offset.
+    String longer = new String(charData(length + 3, 2));
+    String sub = longer.substring(2, length + 2);
+    char[] subData = new char[length];
+    longer.getChars(2, length + 2, subData, 0);
+    expectEquals(true, sub.equals(new String(subData)), "equals substring", length);
+    expectEquals(true, new String(subData).equals(sub), "equals substring", length);
+    expectEquals(referenceEquals(subData, data), sub.equals(s), "equals substring", length);
+  }
+
+  static void testStringEqualsSpecialCases() {
+    String s = new String(charData(7, 3));
+    expectEquals(true, s.equals(s), "equals self", 7);
+    expectEquals(false, s.equals(null), "equals null", 7);
+    expectEquals(false, s.equals(new StringBuilder(s)), "equals StringBuilder", 7);
+    expectEquals(false, s.equals(charData(7, 3)), "equals char[]", 7);
+    String nullString = null;
+    try {
+      nullString.equals(s);
+      System.out.println("Missing NullPointerException");
+    } catch (NullPointerException expected) {
+    }
+    try {
+      nullString.equals(null);
+      System.out.println("Missing NullPointerException");
+    } catch (NullPointerException expected) {
+    }
+  }
+
+  static void testStringHashCode(int length) {
+    char[] data = charData(length, 4);
+    String s = new String(data);
+    int expected = referenceHashCode(data, 0, length);
+    expectEquals(expected, s.hashCode(), "hashCode", length);
+    // The second call returns the cached value.
+    expectEquals(expected, s.hashCode(), "hashCode cached", length);
+    String longer = new String(charData(length + 5, 5));
+    char[] longerData = new char[length + 5];
+    longer.getChars(0, length + 5, longerData, 0);
+    String sub = longer.substring(3, length + 3);
+    expectEquals(referenceHashCode(longerData, 3, length), sub.hashCode(), "hashCode substring",
+                 length);
+  }
+
+  static void testArraysEquals(int length) {
+    byte[] b1 = byteData(length, 6);
+    byte[] b2 = byteData(length, 6);
+    char[] c1 = charData(length, 6);
+    char[] c2 = charData(length, 6);
+    int[] i1 = intData(length, 6);
+    int[] i2 = intData(length, 6);
+    expectEquals(true, Arrays.equals(b1, b2), "byte equals", length);
+    expectEquals(true, Arrays.equals(c1, c2), "char equals", length);
+    expectEquals(true, Arrays.equals(i1, i2), "int equals", length);
+    expectEquals(true, Arrays.equals(b1, b1), "byte equals self", length);
+    expectEquals(false, Arrays.equals(b1, null), "byte equals null", length);
+    expectEquals(false, Arrays.equals(null, c1), "char equals null", length);
+    expectEquals(false, Arrays.equals(i1, intData(length + 1, 6)), "int equals longer", length);
+    for (int i = length - 1; i >= 0; i--) {
+      b2[i] ^= 0x80;
+      c2[i] ^= 0x8000;
+      i2[i] ^= 0x80000000;
+      expectEquals(false, Arrays.equals(b1, b2), "byte equals mismatch", i);
+      expectEquals(false, Arrays.equals(c1, c2), "char equals mismatch", i);
+      expectEquals(false, Arrays.equals(i1, i2), "int equals mismatch", i);
+      b2[i] ^= 0x80;
+      c2[i] ^= 0x8000;
+      i2[i] ^= 0x80000000;
+    }
+  }
+
+  static void testArraysFill(int length) {
+    byte[] b = byteData(length, 7);
+    char[] c = charData(length, 7);
+    int[] n = intData(length, 7);
+    Arrays.fill(b, (byte) -3);
+    Arrays.fill(c, (char) 0xfedc);
+    Arrays.fill(n, 0x89abcdef);
+    for (int i = length - 1; i >= 0; i--) {
+      expectEquals(-3, b[i], "byte fill", length);
+      expectEquals(0xfedc, c[i], "char fill", length);
+      expectEquals(0x89abcdef, n[i], "int fill", length);
+    }
+    byte[] nullBytes = null;
+    try {
+      Arrays.fill(nullBytes, (byte) 0);
+      System.out.println("Missing NullPointerException");
+    } catch (NullPointerException expected) {
+    }
+  }
+
+  // Only System.arraycopy(char[], int, char[], int, int) is declared by libcore and replaced,
+  // the other primitive arrays go through arraycopy(Object, int, Object, int, int).
+  static void testArrayCopy(int length) {
+    for (int srcPos = 0; srcPos <= 3; srcPos++) {
+      for (int dstPos = 0; dstPos <= 3; dstPos++) {
+        char[] src = charData(length + srcPos, 8);
+        char[] dst = new char[length + dstPos + 1];
+        System.arraycopy(src, srcPos, dst, dstPos, length);
+        for (int i = dst.length - 1; i >= 0; i--) {
+          boolean copied = (i >= dstPos) && (i < dstPos + length);
+          expectEquals(copied ? src[i - dstPos + srcPos] : 0, dst[i], "char arraycopy", length);
+        }
+      }
+    }
+    // Overlapping copies within one array.
+    char[] overlap = charData(length + 2, 9);
+    char[] expected = charData(length + 2, 9);
+    System.arraycopy(overlap, 0, overlap, 2, length);
+    for (int i = length - 1; i >= 0; i--) {
+      expectEquals(expected[i], overlap[i + 2], "char arraycopy overlap", length);
+    }
+  }
+
+  static void testArrayCopyExceptions() {
+    char[] c = new char[8];
+    try {
+      System.arraycopy(c, 4, c, 0, 5);
+      System.out.println("Missing ArrayIndexOutOfBoundsException");
+    } catch (ArrayIndexOutOfBoundsException expected) {
+    }
+    try {
+      System.arraycopy(c, 0, c, -1, 2);
+      System.out.println("Missing ArrayIndexOutOfBoundsException");
+    } catch (ArrayIndexOutOfBoundsException expected) {
+    }
+    try {
+      System.arraycopy(c, 0, new char[8], 0, -1);
+      System.out.println("Missing ArrayIndexOutOfBoundsException");
+    } catch (ArrayIndexOutOfBoundsException expected) {
+    }
+    try {
+      System.arraycopy((char[]) null, 0, c, 0, 1);
+      System.out.println("Missing NullPointerException");
+    } catch (NullPointerException expected) {
+    }
+    // Longer than the inlined copies handle.
+    char[] src = charData(1000, 10);
+    char[] dst = new char[1000];
+    System.arraycopy(src, 0, dst, 0, 1000);
+    for (int i = 999; i >= 0; i--) {
+      expectEquals(src[i], dst[i], "char arraycopy long", 1000);
+    }
+  }
+
+  static void benchmark(boolean timing) {
+    char[] data = charData(kBenchmarkLength, 11);
+    String s = new String(data);
+    String t = new String(data);
+    byte[] b1 = byteData(kBenchmarkLength, 11);
+    byte[] b2 = byteData(kBenchmarkLength, 11);
+
+    long time0 = System.nanoTime();
+    int total = 0;
+    for (int i = 0; i < kBenchmarkIterations; i++) {
+      total += s.equals(t) ? 1 : 0;
+    }
+    long time1 = System.nanoTime();
+    for (int i = 0; i < kBenchmarkIterations; i++) {
+      total += referenceEquals(data, data) ? 1 : 0;
+    }
+    long time2 = System.nanoTime();
+    for (int i = 0; i < kBenchmarkIterations; i++) {
+      total += new String(data, 0, 256).hashCode();
+    }
+    long time3 = System.nanoTime();
+    for (int i = 0; i < kBenchmarkIterations; i++) {
+      total += referenceHashCode(data, 0, 256);
+    }
+    long time4 = System.nanoTime();
+    for (int i = 0; i < kBenchmarkIterations; i++) {
+      total += Arrays.equals(b1, b2) ? 1 : 0;
+    }
+    long time5 = System.nanoTime();
+    for (int i = 0; i < kBenchmarkIterations; i++) {
+      Arrays.fill(b1, (byte) i);
+    }
+    long time6 = System.nanoTime();
+    for (int i = 0; i < kBenchmarkIterations; i++) {
+      for (int j = 0; j < b2.length; j++) {
+        b2[j] = (byte) i;
+      }
+    }
+    long time7 = System.nanoTime();
+
+    if (timing) {
+      System.out.println("String.equals: " + (time1 - time0) / kBenchmarkIterations + " ns");
+      System.out.println("equals loop: " + (time2 - time1) / kBenchmarkIterations + " ns");
+      System.out.println("String.hashCode: " + (time3 - time2) / kBenchmarkIterations + " ns");
+      System.out.println("hashCode loop: " + (time4 - time3) / kBenchmarkIterations + " ns");
+      System.out.println("Arrays.equals: " + (time5 - time4) / kBenchmarkIterations + " ns");
+      System.out.println("Arrays.fill: " + (time6 - time5) / kBenchmarkIterations + " ns");
+      System.out.println("fill loop: " + (time7 - time6) / kBenchmarkIterations + " ns " + total);
+    }
+  }
+
+  static void expectEquals(boolean expected, boolean actual, String test, int length) {
+    if (expected != actual) {
+      throw new Error(test + " with length " + length + ": expected " + expected + ", got " +
+                      actual);
+    }
+  }
+
+  static void expectEquals(int expected, int actual, String test, int length) {
+    if (expected != actual) {
+      throw new Error(test + " with length " + length + ": expected " + expected + ", got " +
+                      actual);
+    }
+  }
+}
@@ -0,0 +1,257 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Tests invoke-interface and invoke-virtual sites with one, two and many receiver classes.
+// The expected results are computed without calls.
+
+public class Main {
+  static final int kBenchmarkLength = 1024;
+  static final int kBenchmarkIterations = 1000;
+
+  interface Shape {
+    int area();
+  }
+
+  static class Square implements Shape {
+    final int side;
+
+    Square(int side) {
+      this.side = side;
+    }
+
+    public int area() {
+      return side * side;
+    }
+  }
+
+  static class Rectangle implements Shape {
+    final int width;
+    final int height;
+
+    Rectangle(int width, int height) {
+      this.width = width;
+      this.height = height;
+    }
+
+    public int area() {
+      return width * height;
+    }
+  }
+
+  // Inherits area() from Rectangle: the guard is on the class of the receiver, not on the
+  // class declaring the method.
+  static class Strip extends Rectangle {
+    Strip(int width) {
+      super(width, 1);
+    }
+  }
+
+  static class Triangle implements Shape {
+    final int base;
+    final int height;
+
+    Triangle(int base, int height) {
+      this.base = base;
+      this.height = height;
+    }
+
+    public int area() {
+      return base * height / 2;
+    }
+  }
+
+  static abstract class Counter {
+    abstract int next(int value);
+  }
+
+  static class Incrementer extends Counter {
+    int next(int value) {
+      return value + 1;
+    }
+  }
+
+  static class Doubler extends Counter {
+    int next(int value) {
+      return value * 2;
+    }
+  }
+
+  public static void main(String[] args) {
+    boolean timing = (args.length >= 1) && args[0].equals("--timing");
+
+    // The run script first runs the test with the profiler recording the receivers of the sites,
+    // and then compiles it with that profile.
+    long warmUpMs = Long.getLong("profiled.dispatch.warmup.ms", 0L);
+    if (warmUpMs > 0L) {
+      warmUp(warmUpMs);
+    }
+
+    Shape[] squares = shapes(100, 1);
+    Shape[] twoKinds = shapes(100, 2);
+    Shape[] allKinds = shapes(100, 4);
+    expectEquals(expectedArea(100, 1), sumSquareAreas(squares), "monomorphic");
+    expectEquals(expectedArea(100, 2), sumTwoKindAreas(twoKinds), "bimorphic");
+    expectEquals(expectedArea(100, 4), sumAreas(allKinds), "megamorphic");
+    // The sites see classes they were not profiled with.
+    expectEquals(expectedArea(100, 4), sumSquareAreas(allKinds), "monomorphic miss");
+    expectEquals(expectedArea(100, 4), sumTwoKindAreas(allKinds), "bimorphic miss");
+    // The site sees the classes in another order.
+    expectEquals(expectedArea(100, 4), sumAreas(allKinds), "megamorphic again");
+    expectEquals(expectedArea(100, 1), sumAreas(squares), "megamorphic with squares");
+
+    expectEquals(10, count(new Incrementer(), 0, 10), "incrementer");
+    expectEquals(1024, count(new Doubler(), 1, 10), "doubler");
+    expectEquals(11, count(new Incrementer(), 1, 10), "incrementer again");
+
+    try {
+      sumSquareAreas(new Shape[] { new Square(1), null });
+      System.out.println("Missing NullPointerException");
+    } catch (NullPointerException expected) {
+    }
+    try {
+      count(null, 0, 1);
+      System.out.println("Missing NullPointerException");
+    } catch (NullPointerException expected) {
+    }
+    System.out.println("Results are correct.");
+
+    benchmark(timing);
+  }
+
+  // Returns shapes of the first `kinds` classes in turn.
+  static Shape[] shapes(int length, int kinds) {
+    Shape[] shapes = new Shape[length];
+    for (int i = 0; i < length; i++) {
+      switch (i % kinds) {
+        case 0:
+          shapes[i] = new Square(i);
+          break;
+        case 1:
+          shapes[i] = new Rectangle(i, 3);
+          break;
+        case 2:
+          shapes[i] = new Strip(i);
+          break;
+        default:
+          shapes[i] = new Triangle(i, 4);
+          break;
+      }
+    }
+    return shapes;
+  }
+
+  static int expectedArea(int length, int kinds) {
+    int sum = 0;
+    for (int i = 0; i < length; i++) {
+      switch (i % kinds) {
+        case 0:
+          sum += i * i;
+          break;
+        case 1:
+          sum += i * 3;
+          break;
+        case 2:
+          sum += i;
+          break;
+        default:
+          sum += i * 4 / 2;
+          break;
+      }
+    }
+    return sum;
+  }
+
+  // The sites of sumSquareAreas(), sumTwoKindAreas() and sumAreas() are warmed up with one, two
+  // and four classes of receivers.
+  static int sumSquareAreas(Shape[] shapes) {
+    int sum = 0;
+    for (int i = 0; i < shapes.length; i++) {
+      sum += shapes[i].area();
+    }
+    return sum;
+  }
+
+  static int sumTwoKindAreas(Shape[] shapes) {
+    int sum = 0;
+    for (int i = 0; i < shapes.length; i++) {
+      sum += shapes[i].area();
+    }
+    return sum;
+  }
+
+  static int sumAreas(Shape[] shapes) {
+    int sum = 0;
+    for (int i = 0; i < shapes.length; i++) {
+      sum += shapes[i].area();
+    }
+    return sum;
+  }
+
+  static void warmUp(long ms) {
+    Shape[] squares = shapes(kBenchmarkLength, 1);
+    Shape[] twoKinds = shapes(kBenchmarkLength, 2);
+    Shape[] allKinds = shapes(kBenchmarkLength, 4);
+    Counter incrementer = new Incrementer();
+    long end = System.currentTimeMillis() + ms;
+    while (System.currentTimeMillis() < end) {
+      sumSquareAreas(squares);
+      sumTwoKindAreas(twoKinds);
+      sumAreas(allKinds);
+      count(incrementer, 0, kBenchmarkLength);
+    }
+  }
+
+  static int count(Counter counter, int value, int steps) {
+    for (int i = 0; i < steps; i++) {
+      value = counter.next(value);
+    }
+    return value;
+  }
+
+  static void benchmark(boolean timing) {
+    Shape[] squares = shapes(kBenchmarkLength, 1);
+    Shape[] twoKinds = shapes(kBenchmarkLength, 2);
+    Shape[] allKinds = shapes(kBenchmarkLength, 4);
+
+    long time0 = System.nanoTime();
+    int total = 0;
+    for (int i = 0; i < kBenchmarkIterations; i++) {
+      total += sumSquareAreas(squares);
+    }
+    long time1 = System.nanoTime();
+    for (int i = 0; i < kBenchmarkIterations; i++) {
+      total += sumTwoKindAreas(twoKinds);
+    }
+    long time2 = System.nanoTime();
+    for (int i = 0; i < kBenchmarkIterations; i++) {
+      total += sumAreas(allKinds);
+    }
+    long time3 = System.nanoTime();
+
+    if (timing) {
+      long calls = (long) kBenchmarkIterations * kBenchmarkLength;
+      System.out.println("monomorphic: " + (time1 - time0) / calls + " ns");
+      System.out.println("bimorphic: " + (time2 - time1) / calls + " ns");
+      System.out.println("megamorphic: " + (time3 - time2) / calls + " ns " + total);
+    }
+  }
+
+  static void expectEquals(int expected, int actual, String test) {
+    if (expected != actual) {
+      throw new Error(test + ": expected " + expected + ", got " + actual);
+    }
+  }
+}
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+public class Main {
+  static final int kThreads = 4;
+  static final int kIterations = 2000;
+  static final int kListLength = 100;
+  static final int kSmallLiveNodes = 1000;
+  static final int kLargeLiveNodes = 200000;
+
+  static final class Node {
+    final int value;
+    final Node next;
+    final int[] data;
+
+    Node(int value, Node next) {
+      this.value = value;
+      this.next = next;
+      this.data = new int[] { value, -value };
+    }
+  }
+
+  static volatile boolean done;
+
+  static final class Allocator extends Thread {
+    final int seed;
+    long maxStallNanos;
+    Throwable failure;
+
+    Allocator(int seed) {
+      this.seed = seed;
+    }
+
+    public void run() {
+      try {
+        long last = System.nanoTime();
+        for (int i = 0; i < kIterations; i++) {
+          Node list = buildList(seed + i, kListLength);
+          checkList(list, seed + i, kListLength);
+          long now = System.nanoTime();
+          maxStallNanos = Math.max(maxStallNanos, now - last);
+          last = now;
+        }
+      } catch (Throwable t) {
+        failure = t;
+      }
+    }
+  }
+
+  public static void main(String[] args) throws Exception {
+    boolean timing = (args.length >= 1) && args[0].equals("--timing");
+
+    long smallStall = run(kSmallLiveNodes);
+    long largeStall = run(kLargeLiveNodes);
+    System.out.println("Results are correct.");
+
+    if (timing) {
+      System.out.println("max stall with " + kSmallLiveNodes + " live nodes: " +
+                         smallStall / 1000 + " us");
+      System.out.println("max stall with " + kLargeLiveNodes + " live nodes: " +
+                         largeStall / 1000 + " us");
+    }
+  }
+
+  // Allocates from several threads while the main thread collects the heap, which keeps
+  // liveNodes nodes alive. Returns the longest stall of an allocating thread.
+  static long run(int liveNodes) throws Exception {
+    Node live = buildList(-liveNodes, liveNodes);
+    done = false;
+    Allocator[] allocators = new Allocator[kThreads];
+    for (int i = 0; i < kThreads; i++) {
+      allocators[i] = new Allocator(i * kIterations);
+      allocators[i].start();
+    }
+    Thread collector = new Thread() {
+      public void run() {
+        while (!done) {
+          System.gc();
+        }
+      }
+    };
+    collector.start();
+    long maxStallNanos = 0;
+    for (Allocator allocator : allocators) {
+      allocator.join();
+      if (allocator.failure != null) {
+        throw new Error(allocator.failure);
+      }
+      maxStallNanos = Math.max(maxStallNanos, allocator.maxStallNanos);
+    }
+    done = true;
+    collector.join();
+    checkList(live, -liveNodes, liveNodes);
+    return maxStallNanos;
+  }
+
+  // Returns the list of the values first to first + length - 1.
+  static Node buildList(int first, int length) {
+    Node list = null;
+    for (int i = length - 1; i >= 0; i--) {
+      list = new Node(first + i, list);
+    }
+    return list;
+  }
+
+  static void checkList(Node list, int first, int length) {
+    int count = 0;
+    for (Node node = list; node != null; node = node.next) {
+      int expected = first + count;
+      if (node.value != expected || node.data[0] != expected || node.data[1] != -expected) {
+        throw new Error("Node " + count + ": expected " + expected + ", got " + node.value +
+                        " " + node.data[0] + " " + node.data[1]);
+      }
+      count++;
+    }
+    if (count != length) {
+      throw new Error("Expected " + length + " nodes, got " + count);
+    }
+  }
+}
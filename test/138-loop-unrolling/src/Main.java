@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Tests loops that the compiler may unroll. The reference results are computed by loops
+// counting down, which are never unrolled.
+
+public class Main {
+  public static void main(String[] args) {
+    for (int length = 0; length <= 20; length++) {
+      testSquares(length);
+      testLastElement(length);
+      testSumLength(length);
+    }
+    testBounds();
+    testExceptions();
+    System.out.println("Results are correct.");
+  }
+
+  static void squares(int[] a, int[] b) {
+    for (int i = 0; i < b.length; i++) {
+      b[i] = a[i] * a[i];
+    }
+  }
+
+  // The last element read is live after the loop.
+  static int lastElement(int[] a) {
+    int x = -1;
+    for (int i = 0; i < a.length; i++) {
+      x = a[i];
+    }
+    return x;
+  }
+
+  // The body reads the array length computed by the loop condition.
+  static int sumLength(int[] a) {
+    int sum = 0;
+    int n;
+    for (int i = 0; i < (n = a.length); i++) {
+      sum += n;
+    }
+    return sum;
+  }
+
+  // Divides "a[start .. end)" by "d" into "q", the bound does not come from an array. Returns
+  // the index the loop stopped at.
+  static int divide(int[] a, int[] d, int[] q, int start, int end) {
+    int i;
+    for (i = start; i < end; i++) {
+      q[i] = a[i] / d[i];
+    }
+    return i;
+  }
+
+  static int[] intData(int length, int seed) {
+    int[] data = new int[length];
+    for (int i = length - 1; i >= 0; i--) {
+      data[i] = (i * 0x9e3779b1 + seed) ^ (i << 17);
+    }
+    return data;
+  }
+
+  static int[] nonZeroData(int length) {
+    int[] data = new int[length];
+    for (int i = length - 1; i >= 0; i--) {
+      data[i] = (i % 7) + 1;
+    }
+    return data;
+  }
+
+  static void testSquares(int length) {
+    int[] a = intData(length, 1);
+    int[] b = new int[length];
+    squares(a, b);
+    for (int i = length - 1; i >= 0; i--) {
+      expectEquals(a[i] * a[i], b[i], "squares", length);
+    }
+  }
+
+  static void testLastElement(int length) {
+    int[] a = intData(length, 2);
+    int expected = (length == 0) ? -1 : a[length - 1];
+    expectEquals(expected, lastElement(a), "lastElement", length);
+  }
+
+  static void testSumLength(int length) {
+    expectEquals(length * length, sumLength(new int[length]), "sumLength", length);
+  }
+
+  static void testBounds() {
+    int[] a = intData(23, 3);
+    int[] d = nonZeroData(23);
+    for (int start = 0; start <= 5; start++) {
+      for (int end = start; end <= 23; end++) {
+        int[] q = new int[23];
+        expectEquals(end, divide(a, d, q, start, end), "divide index", end);
+        for (int i = 22; i >= 0; i--) {
+          int expected = (i >= start && i < end) ? a[i] / d[i] : 0;
+          expectEquals(expected, q[i], "divide", end);
+        }
+      }
+    }
+  }
+
+  static void testExceptions() {
+    // The elements before the failing index must have been written, and not the others.
+    int[] a = intData(23, 4);
+    int[] d = nonZeroData(23);
+    for (int zero = 0; zero < 23; zero++) {
+      d[zero] = 0;
+      int[] q = new int[23];
+      try {
+        divide(a, d, q, 0, 23);
+        System.out.println("Missing ArithmeticException");
+      } catch (ArithmeticException expected) {
+        for (int i = 22; i >= 0; i--) {
+          expectEquals((i < zero) ? a[i] / d[i] : 0, q[i], "divide by zero", zero);
+        }
+      }
+      d[zero] = (zero % 7) + 1;
+    }
+
+    int[] q = new int[13];
+    try {
+      divide(a, d, q, 0, 23);
+      System.out.println("Missing ArrayIndexOutOfBoundsException");
+    } catch (ArrayIndexOutOfBoundsException expected) {
+      for (int i = 12; i >= 0; i--) {
+        expectEquals(a[i] / d[i], q[i], "divide out of bounds", i);
+      }
+    }
+
+    q = new int[23];
+    try {
+      divide(a, d, q, -2, 23);
+      System.out.println("Missing ArrayIndexOutOfBoundsException");
+    } catch (ArrayIndexOutOfBoundsException expected) {
+      for (int i = 22; i >= 0; i--) {
+        expectEquals(0, q[i], "divide negative start", i);
+      }
+    }
+
+    try {
+      divide(a, d, null, 0, 23);
+      System.out.println("Missing NullPointerException");
+    } catch (NullPointerException expected) {
+    }
+  }
+
+  static void expectEquals(int expected, int actual, String test, int length) {
+    if (expected != actual) {
+      throw new Error(test + " with length " + length + ": expected " + expected + ", got " +
+                      actual);
+    }
+  }
+}
@@ -0,0 +1,215 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Note that $opt$ is a marker for the optimizing compiler to ensure
+// it does compile the method. The $opt$ methods only call methods the
+// optimizing compiler can either inline or invoke.
+
+public class Main {
+  static final int kBenchmarkIterations = 1000000;
+
+  static final class Node {
+    Node next;
+    int value;
+    long wide;
+
+    Node(Node next, int value) {
+      this.next = next;
+      this.value = value;
+      this.wide = value + 0x100000000L;
+    }
+
+    final Node getNext() {
+      return next;
+    }
+
+    final int getValue() {
+      return value;
+    }
+
+    final long getWide() {
+      return wide;
+    }
+
+    final int getValue1() {
+      return getNext().getValue();
+    }
+
+    final int getValue2() {
+      return getNext().getValue1();
+    }
+
+    final int getValue3() {
+      return getNext().getValue2();
+    }
+
+    private int getValuePlus(int delta) {
+      return value + delta;
+    }
+
+    final int getValuePlusNext(int delta) {
+      return getValuePlus(delta) + getNext().getValuePlus(delta);
+    }
+  }
+
+  public static void main(String[] args) {
+    boolean timing = (args.length >= 1) && args[0].equals("--timing");
+
+    Node list = new Node(new Node(new Node(new Node(null, 4), 3), 2), 1);
+    expectEquals(4, $opt$getValue3(list), "getValue3");
+    expectEquals(3 + 4, $opt$getValue2Twice(list.next), "getValue2Twice");
+    expectEquals(1 + 10 + 2 + 10, $opt$getValuePlusNext(list, 10), "getValuePlusNext");
+    expectEquals(2 + 0x100000000L, $opt$getNextWide(list), "getNextWide");
+    expectEquals(list.next.next, $opt$getNextNext(list), "getNextNext");
+    expectEquals(7, $opt$add(3, 4), "add");
+    expectEquals(-5, $opt$max(-5, -9), "max");
+    expectEquals(12, $opt$max(3, 12), "max");
+    expectEquals(9, $opt$clamp(9, 0, 10), "clamp");
+    expectEquals(0, $opt$clamp(-3, 0, 10), "clamp");
+    expectEquals(10, $opt$clamp(13, 0, 10), "clamp");
+    expectEquals(5 + 6 - 1, $opt$addLong(5L, 6L), "addLong");
+    expectEquals(20, $opt$countDown(20), "countDown");
+    testExceptions(list);
+    System.out.println("Results are correct.");
+
+    benchmark(list, timing);
+  }
+
+  static int $opt$getValue3(Node node) {
+    return node.getValue3();
+  }
+
+  static int $opt$getValue2Twice(Node node) {
+    return node.getValue1() + node.getValue2();
+  }
+
+  static int $opt$getValuePlusNext(Node node, int delta) {
+    return node.getValuePlusNext(delta);
+  }
+
+  static long $opt$getNextWide(Node node) {
+    return node.getNext().getWide();
+  }
+
+  static Node $opt$getNextNext(Node node) {
+    return node.getNext().getNext();
+  }
+
+  static int add(int a, int b) {
+    return a + b;
+  }
+
+  static int max(int a, int b) {
+    if (a > b) {
+      return a;
+    }
+    return b;
+  }
+
+  static int min(int a, int b) {
+    return a < b ? a : b;
+  }
+
+  static long addLong(long a, long b) {
+    return a + b;
+  }
+
+  static int $opt$add(int a, int b) {
+    return add(a, b);
+  }
+
+  static int $opt$max(int a, int b) {
+    return max(a, b);
+  }
+
+  static int $opt$clamp(int value, int low, int high) {
+    return min(max(value, low), high);
+  }
+
+  static long $opt$addLong(long a, long b) {
+    return addLong(a, b) - 1;
+  }
+
+  // Recursive methods are only inlined to a limited depth, the call remains.
+  static int countDown(int n) {
+    if (n == 0) {
+      return 0;
+    }
+    return countDown(n - 1) + 1;
+  }
+
+  static int $opt$countDown(int n) {
+    return countDown(n);
+  }
+
+  static void testExceptions(Node list) {
+    Node last = list.next.next.next;
+    try {
+      $opt$getValue3(last);
+      System.out.println("Missing NullPointerException");
+    } catch (NullPointerException expected) {
+    }
+
+    try {
+      $opt$getValue3(null);
+      System.out.println("Missing NullPointerException");
+    } catch (NullPointerException expected) {
+    }
+
+    try {
+      $opt$getNextWide(last);
+      System.out.println("Missing NullPointerException");
+    } catch (NullPointerException expected) {
+    }
+  }
+
+  static int $opt$sumChains(Node node, int iterations) {
+    int sum = 0;
+    for (int i = 0; i < iterations; i++) {
+      sum = sum + node.getValue3() + node.getValue1();
+    }
+    return sum;
+  }
+
+  static void benchmark(Node list, boolean timing) {
+    long time0 = System.nanoTime();
+    int sum = $opt$sumChains(list, kBenchmarkIterations);
+    long time1 = System.nanoTime();
+    expectEquals((4 + 2) * kBenchmarkIterations, sum, "sumChains");
+
+    if (timing) {
+      System.out.println("sumChains: " + (time1 - time0) / kBenchmarkIterations + " ns");
+    }
+  }
+
+  static void expectEquals(int expected, int actual, String test) {
+    if (expected != actual) {
+      throw new Error(test + ": expected " + expected + ", got " + actual);
+    }
+  }
+
+  static void expectEquals(long expected, long actual, String test) {
+    if (expected != actual) {
+      throw new Error(test + ": expected " + expected + ", got " + actual);
+    }
+  }
+
+  static void expectEquals(Object expected, Object actual, String test) {
+    if (expected != actual) {
+      throw new Error(test + ": expected " + expected + ", got " + actual);
+    }
+  }
+}
@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Note that $opt$ is a marker for the optimizing compiler to ensure
+// it does compile the method, and that $reg$ is a marker to ensure it
+// compiles the method with the register allocator, which requires all the
+// allocations of the method to be removed.
+
+public class Main {
+  static final int kBenchmarkIterations = 1000000;
+
+  static final class Point {
+    int x;
+    int y;
+
+    Point(int x, int y) {
+      this.x = x;
+      this.y = y;
+    }
+  }
+
+  static final class Counter {
+    int count;
+    byte small;
+  }
+
+  static final class Wide {
+    long value;
+
+    Wide(long value) {
+      this.value = value;
+    }
+  }
+
+  public static void main(String[] args) {
+    boolean timing = (args.length >= 1) && args[0].equals("--timing");
+
+    expectEquals(3 * 3 + 4 * 4, $opt$reg$distanceSquared(3, 4), "distanceSquared");
+    expectEquals(-7, $opt$reg$count(-7), "count");
+    expectEquals(100, $opt$reg$smallField(), "smallField");
+    expectEquals(9, $opt$reg$larger(9, 2), "larger");
+    expectEquals(5, $opt$reg$larger(-1, 5), "larger");
+    expectEquals(4 * 5 / 2 + 5 * 10, $opt$reg$sumPoints(5, 10), "sumPoints");
+    expectEquals(0, $opt$reg$sumPoints(0, 10), "sumPoints");
+    expectEquals(0x100000001L, $opt$wide(0x100000000L), "wide");
+    expectEquals(6, $opt$escapes(6).y, "escapes");
+    expectEquals(8, $opt$setInBranch(8, true), "setInBranch");
+    expectEquals(0, $opt$setInBranch(8, false), "setInBranch");
+    System.out.println("Results are correct.");
+
+    benchmark(timing);
+  }
+
+  static int $opt$reg$distanceSquared(int x, int y) {
+    Point p = new Point(x, y);
+    return p.x * p.x + p.y * p.y;
+  }
+
+  // The field read first has its default value.
+  static int $opt$reg$count(int delta) {
+    Counter counter = new Counter();
+    counter.count += delta;
+    return counter.count;
+  }
+
+  static int $opt$reg$smallField() {
+    Counter counter = new Counter();
+    counter.small = 100;
+    return counter.small;
+  }
+
+  // The fields are read in blocks following the allocation.
+  static int $opt$reg$larger(int a, int b) {
+    Point p = new Point(a, b);
+    if (a > b) {
+      return p.x;
+    }
+    return p.y;
+  }
+
+  static int $opt$reg$sumPoints(int n, int y) {
+    int sum = 0;
+    for (int i = 0; i < n; i++) {
+      Point p = new Point(i, y);
+      sum = sum + p.x + p.y;
+    }
+    return sum;
+  }
+
+  static long $opt$wide(long value) {
+    Wide wide = new Wide(value);
+    return wide.value + 1;
+  }
+
+  // The returned object escapes, its allocation remains.
+  static Point $opt$escapes(int y) {
+    Point p = new Point(0, 0);
+    p.y = y;
+    return p;
+  }
+
+  // The field read after the branches merge is only set in one of them: the allocation
+  // remains.
+  static int $opt$setInBranch(int value, boolean set) {
+    Point p = new Point(0, 0);
+    if (set) {
+      p.x = value;
+    }
+    return p.x;
+  }
+
+  static void benchmark(boolean timing) {
+    long time0 = System.nanoTime();
+    int sum = $opt$reg$sumPoints(kBenchmarkIterations, 1);
+    long time1 = System.nanoTime();
+    expectEquals((int) ((long) kBenchmarkIterations * (kBenchmarkIterations - 1) / 2
+                        + kBenchmarkIterations), sum, "sumPoints");
+
+    if (timing) {
+      System.out.println("sumPoints: " + (time1 - time0) / kBenchmarkIterations + " ns");
+    }
+  }
+
+  static void expectEquals(int expected, int actual, String test) {
+    if (expected != actual) {
+      throw new Error(test + ": expected " + expected + ", got " + actual);
+    }
+  }
+
+  static void expectEquals(long expected, long actual, String test) {
+    if (expected != actual) {
+      throw new Error(test + ": expected " + expected + ", got " + actual);
+    }
+  }
+}
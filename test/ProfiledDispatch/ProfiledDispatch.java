@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Call sites whose targets are computed from the receiver classes of a profile. The invokes
+// are the first instructions of area() and next(), at dex pc 0.
+class ProfiledDispatch {
+  static int area(Shape shape) {
+    return shape.area();
+  }
+
+  static int next(Counter counter, int value) {
+    return counter.next(value);
+  }
+}
+
+interface Shape {
+  int area();
+}
+
+class Square implements Shape {
+  public int area() {
+    return 4;
+  }
+}
+
+class Circle implements Shape {
+  public int area() {
+    return 3;
+  }
+}
+
+// Inherits area() from Square.
+class Tile extends Square {
+}
+
+abstract class Counter {
+  abstract int next(int value);
+}
+
+class Incrementer extends Counter {
+  int next(int value) {
+    return value + 1;
+  }
+}